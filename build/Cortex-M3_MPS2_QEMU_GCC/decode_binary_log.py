@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+#
+# Decode the output of a build with LOG_BINARY set to 1 in logging_config.h.
+#
+# The format strings of the log messages are read from the .log_formats
+# section of the image, which is not loaded onto the target.  Binary log
+# records read from the UART output are formatted with them; any other output
+# is passed through unchanged.  For example:
+#
+#   qemu-system-arm ... -kernel ./output/RTOSDemo.elf -serial stdio ... | \
+#       python3 decode_binary_log.py ./output/RTOSDemo.elf
+#
+# or, to decode a saved capture:
+#
+#   python3 decode_binary_log.py ./output/RTOSDemo.elf capture.bin
+#
+# See vLoggingPrintBinary() in logging-tools/logging_ring.c for the record layout.
+
+import re
+import struct
+import sys
+
+# Must match logbinaryRECORD_MARKER in logging_binary.h.
+RECORD_MARKER = 0xA5
+
+# Length of the fixed part of a record - dlBINARY_HEADER_LENGTH.
+HEADER_LENGTH = 18
+
+LEVEL_NAMES = {1: 'ERROR', 2: 'WARN', 3: 'INFO', 4: 'DEBUG'}
+
+CONVERSION = re.compile(
+    r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?([diouxXcsp%])')
+
+
+def read_format_section(elf_path):
+    with open(elf_path, 'rb') as elf_file:
+        elf = elf_file.read()
+
+    if elf[:4] != b'\x7fELF' or elf[4] != 1 or elf[5] != 1:
+        raise ValueError('%s is not a little endian 32-bit ELF file' % elf_path)
+
+    section_offset, = struct.unpack_from('<I', elf, 0x20)
+    header_size, header_count, names_index = struct.unpack_from('<HHH', elf, 0x2E)
+
+    headers = []
+    for index in range(header_count):
+        name, _, _, address, offset, size = struct.unpack_from(
+            '<IIIIII', elf, section_offset + (index * header_size))
+        headers.append((name, address, offset, size))
+
+    names_offset = headers[names_index][2]
+    for name, address, offset, size in headers:
+        end = elf.index(b'\0', names_offset + name)
+        if elf[names_offset + name:end] == b'.log_formats':
+            return address, elf[offset:offset + size]
+
+    raise ValueError('%s has no .log_formats section - was it built with '
+                     'LOG_BINARY set to 1?' % elf_path)
+
+
+def format_message(format_string, arguments):
+    """Format a message the way the target's printf would have."""
+    remaining = list(arguments)
+
+    def next_argument():
+        return remaining.pop(0) if remaining else 0
+
+    def to_signed(value):
+        return value - (1 << 32) if value & 0x80000000 else value
+
+    def convert(match):
+        flags, width, precision, _, conversion = match.groups()
+
+        if conversion == '%':
+            return '%'
+
+        if width == '*':
+            width = str(to_signed(next_argument()))
+            if width.startswith('-'):
+                flags += '-'
+                width = width[1:]
+        if precision == '*':
+            precision = str(to_signed(next_argument()))
+            if precision.startswith('-'):
+                precision = None
+
+        value = next_argument()
+        specification = '%' + flags + (width or '')
+        if precision is not None:
+            specification += '.' + (precision or '0')
+
+        if conversion == 's':
+            if not isinstance(value, str):
+                value = '<0x%08x>' % value
+            return (specification + 's') % value
+        if isinstance(value, str):
+            value = 0
+        if conversion in 'di':
+            return (specification + 'd') % to_signed(value)
+        if conversion == 'u':
+            return (specification + 'd') % value
+        if conversion == 'c':
+            return (specification + 'c') % chr(value & 0xFF)
+        if conversion == 'p':
+            return (specification + 's') % ('0x%x' % value)
+        return (specification + conversion) % value
+
+    return CONVERSION.sub(convert, format_string)
+
+
+def decode_record(record, formats):
+    """Return the text of a binary record."""
+    level, argument_count, _ = struct.unpack_from('<BBB', record, 1)
+    format_id, message_number, tick = struct.unpack_from('<III', record, 4)
+    formats_address, formats_data = formats
+
+    offset = format_id - formats_address
+    if 0 <= offset < len(formats_data):
+        end = formats_data.find(b'\0', offset)
+        format_string = formats_data[offset:end].decode('utf-8', 'replace')
+    else:
+        format_string = '<unknown format 0x%08x>' % format_id
+
+    string_mask, = struct.unpack_from('<H', record, 16)
+
+    arguments = []
+    cursor = HEADER_LENGTH
+    for position in range(argument_count):
+        if string_mask & (1 << position):
+            length = record[cursor]
+            arguments.append(
+                record[cursor + 1:cursor + 1 + length].decode('utf-8', 'replace'))
+            cursor += 1 + length
+        else:
+            arguments.append(struct.unpack_from('<I', record, cursor)[0])
+            cursor += 4
+
+    return '%s: %u %u --- %s\r\n' % (LEVEL_NAMES.get(level, str(level)),
+                                      message_number, tick,
+                                      format_message(format_string, arguments))
+
+
+def decode_stream(stream, output, formats):
+    while True:
+        byte = stream.read(1)
+        if not byte:
+            break
+
+        if byte[0] != RECORD_MARKER:
+            output.write(byte.decode('latin-1'))
+            continue
+
+        header = byte + stream.read(3)
+        if len(header) < 4:
+            break
+        record = header + stream.read(header[3] - 4)
+        if len(record) < max(header[3], HEADER_LENGTH):
+            break
+
+        output.write(decode_record(record, formats))
+        output.flush()
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.stderr.write('usage: %s <image.elf> [capture]\n' % sys.argv[0])
+        sys.exit(1)
+
+    formats = read_format_section(sys.argv[1])
+
+    if len(sys.argv) == 3:
+        with open(sys.argv[2], 'rb') as capture:
+            decode_stream(capture, sys.stdout, formats)
+    else:
+        decode_stream(sys.stdin.buffer, sys.stdout, formats)
+
+
+if __name__ == '__main__':
+    main()
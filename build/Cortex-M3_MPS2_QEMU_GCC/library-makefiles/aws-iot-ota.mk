@@ -18,3 +18,10 @@ INCLUDE_DIRS += -I$(OTA_DIR)/include \
 				-I$(OTA_DIR)/portable/os
 SOURCE_FILES += $(wildcard $(OTA_DIR)/*.c) \
 			    ($(OTA_DIR)/portable/os/ota_os_freertos.c
+
+#In-process stand-in for the AWS IoT Jobs and Streams services, only used by
+#the OTA demo when democonfigOTA_USE_STREAM_SIMULATOR is set to 1.
+OTA_SIMULATOR_DIR += ./../../source/ota-simulator
+VPATH += $(OTA_SIMULATOR_DIR)
+INCLUDE_DIRS += -I$(OTA_SIMULATOR_DIR)
+SOURCE_FILES += $(wildcard $(OTA_SIMULATOR_DIR)/*.c)
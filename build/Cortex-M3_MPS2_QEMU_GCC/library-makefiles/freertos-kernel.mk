@@ -12,5 +12,15 @@ SOURCE_FILES += $(KERNEL_DIR)/queue.c
 SOURCE_FILES += $(KERNEL_DIR)/timers.c
 SOURCE_FILES += $(KERNEL_DIR)/event_groups.c
 SOURCE_FILES += $(KERNEL_DIR)/stream_buffer.c
+#Build with HEAP=tlsf to replace heap_4.c with the TLSF heap in
+#source/heap-tools.
+ifeq ($(HEAP),tlsf)
+SOURCE_FILES += ./../../source/heap-tools/heap_tlsf.c
+else
 SOURCE_FILES += $(KERNEL_DIR)/portable/MemMang/heap_4.c
+endif
 SOURCE_FILES += $(KERNEL_DIR)/portable/GCC/ARM_CM3/port.c
+
+#Account the task stacks and control blocks allocated by tasks.c to the tasks
+#heap tag, see source/heap-tools/heap_tags_redirect.h.
+$(OUTPUT_DIR)/tasks.o : CFLAGS += -DheaptagsREDIRECT_TAG=eHeapTagTasks -include heap_tags_redirect.h
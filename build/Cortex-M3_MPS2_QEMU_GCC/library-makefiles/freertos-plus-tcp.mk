@@ -13,6 +13,10 @@ SOURCE_FILES += $(wildcard $(FREERTOS_TCP_DIR)/tools/tcp_utilities/*.c)
 SOURCE_FILES += $(wildcard $(FREERTOS_TCP_DIR)/*.c)
 SOURCE_FILES += $(FREERTOS_TCP_DIR)/portable/BufferManagement/BufferAllocation_2.c
 
+#Account the network buffers to the network heap tag, see
+#source/heap-tools/heap_tags_redirect.h.
+$(OUTPUT_DIR)/BufferAllocation_2.o : CFLAGS += -DheaptagsREDIRECT_TAG=eHeapTagNetwork -include heap_tags_redirect.h
+
 
 #Ethernet driver files
 ETHERNET_DRIVER_DIR += ./../../lib/FreeRTOS/freertos-plus-tcp/portable/NetworkInterface/MPS2_AN385
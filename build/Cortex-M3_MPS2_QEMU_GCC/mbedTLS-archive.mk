@@ -19,6 +19,7 @@ INCLUDE_DIRS += -I./target-specific-source/CMSIS
 INCLUDE_DIRS += -I./../../source/configuration-files
 INCLUDE_DIRS += -I./../../lib/ThirdParty/mbedtls/include
 INCLUDE_DIRS += -I./../../lib/FreeRTOS/utilities/mbedtls_freertos
+INCLUDE_DIRS += -I./../../source/heap-tools
 INCLUDE_DIRS += -I./../../lib/FreeRTOS/freertos-plus-tcp/include
 INCLUDE_DIRS += -I./../../lib/FreeRTOS/freertos-plus-tcp/tools/tcp_utilities/include
 
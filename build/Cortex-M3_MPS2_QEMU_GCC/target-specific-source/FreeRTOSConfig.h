@@ -51,6 +51,23 @@
 #define configTICK_RATE_HZ                       ( ( TickType_t ) 1000 )
 #define configMINIMAL_STACK_SIZE                 ( ( unsigned short ) 500 )
 #define configTOTAL_HEAP_SIZE                    ( ( size_t ) ( 120000 ) )
+
+/* Only used when built with HEAP=tlsf.  The size classes of heap_tlsf.c only
+ * need to cover the 120000 byte heap. */
+#define heaptlsfMAX_BLOCK_SIZE_LOG2              17
+
+/* Heap accounting by subsystem, see source/heap-tools/heap_tags.h.  Set
+heaptagsTRACE_LENGTH to the number of allocations and frees to keep in the
+allocation trace, or 0 to disable the trace. */
+#define heaptagsENABLED                          1
+#define heaptagsTRACE_LENGTH                     0
+
+#if ( heaptagsTRACE_LENGTH > 0 )
+    void vHeapTagsTraceMalloc( void * pvAddress, size_t xSize );
+    void vHeapTagsTraceFree( void * pvAddress, size_t xSize );
+    #define traceMALLOC( pvAddress, uiSize )    vHeapTagsTraceMalloc( pvAddress, uiSize )
+    #define traceFREE( pvAddress, uiSize )      vHeapTagsTraceFree( pvAddress, uiSize )
+#endif
 #define configMAX_TASK_NAME_LEN                  ( 10 )
 #define configUSE_TRACE_FACILITY                 1
 #define configUSE_16_BIT_TICKS                   0
@@ -67,6 +84,18 @@
 #define configNUM_TX_DESCRIPTORS                15
 #define configSTREAM_BUFFER_TRIGGER_LEVEL_TEST_MARGIN 2
 
+/* logging_ring.c keeps the level of the message being logged by each
+task in thread local storage pointer 0. */
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS  1
+
+/* Run time stats gathering configuration options.  The time base is provided
+by run_time_stats_qemu.c. */
+void vConfigureTimerForRunTimeStats( void );
+uint32_t ulGetRunTimeCounterValue( void );
+#define configGENERATE_RUN_TIME_STATS            1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() vConfigureTimerForRunTimeStats()
+#define portGET_RUN_TIME_COUNTER_VALUE()         ulGetRunTimeCounterValue()
+
 /* Set the following definitions to 1 to include the API function, or zero
 to exclude the API function. */
 
@@ -0,0 +1,70 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file run_time_stats_qemu.c
+ * @brief Time base for the FreeRTOS run time stats on the MPS2 board emulated
+ * by QEMU.
+ *
+ * QEMU does not implement the DWT cycle counter, so the stats are clocked by
+ * CMSDK timer 0, which is not used for anything else.  The timer counts down
+ * from its reload value at the peripheral clock frequency, so the count is
+ * inverted to give a value that increases.  The 32-bit count wraps after a few
+ * minutes, which is fine as the kernel only accumulates differences between
+ * consecutive readings.
+ */
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Board includes. */
+#include "CMSIS/CMSDK_CM3.h"
+
+/* Reload value that makes the timer count through its full range. */
+#define rtstatsTIMER_RELOAD_VALUE    ( 0xFFFFFFFFUL )
+
+/*-----------------------------------------------------------*/
+
+void vConfigureTimerForRunTimeStats( void )
+{
+    CMSDK_TIMER0->CTRL = 0UL;
+    CMSDK_TIMER0->RELOAD = rtstatsTIMER_RELOAD_VALUE;
+    CMSDK_TIMER0->VALUE = rtstatsTIMER_RELOAD_VALUE;
+
+    /* Count the internal clock without generating interrupts. */
+    CMSDK_TIMER0->CTRL = CMSDK_TIMER_CTRL_EN_Msk;
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulGetRunTimeCounterValue( void )
+{
+    return rtstatsTIMER_RELOAD_VALUE - CMSDK_TIMER0->VALUE;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,28 @@
+#Intended to be included from the Makefile.  Builds the FreeRTOS kernel with
+#the POSIX port, which runs each task as a thread of the Linux process.
+
+KERNEL_DIR += ./../../lib/FreeRTOS/freertos-kernel
+KERNEL_PORT_DIR += $(KERNEL_DIR)/portable/ThirdParty/GCC/Posix
+INCLUDE_DIRS += -I$(KERNEL_DIR)/include \
+				-I$(KERNEL_PORT_DIR) \
+				-I$(KERNEL_PORT_DIR)/utils
+VPATH += $(KERNEL_DIR) $(KERNEL_PORT_DIR) $(KERNEL_PORT_DIR)/utils $(KERNEL_DIR)/portable/MemMang
+SOURCE_FILES += $(KERNEL_DIR)/tasks.c
+SOURCE_FILES += $(KERNEL_DIR)/list.c
+SOURCE_FILES += $(KERNEL_DIR)/queue.c
+SOURCE_FILES += $(KERNEL_DIR)/timers.c
+SOURCE_FILES += $(KERNEL_DIR)/event_groups.c
+SOURCE_FILES += $(KERNEL_DIR)/stream_buffer.c
+#Build with HEAP=tlsf to replace heap_4.c with the TLSF heap in
+#source/heap-tools.
+ifeq ($(HEAP),tlsf)
+SOURCE_FILES += ./../../source/heap-tools/heap_tlsf.c
+else
+SOURCE_FILES += $(KERNEL_DIR)/portable/MemMang/heap_4.c
+endif
+SOURCE_FILES += $(KERNEL_PORT_DIR)/port.c
+SOURCE_FILES += $(KERNEL_PORT_DIR)/utils/wait_for_event.c
+
+#Account the task stacks and control blocks allocated by tasks.c to the tasks
+#heap tag, see source/heap-tools/heap_tags_redirect.h.
+$(OUTPUT_DIR)/tasks.o : CFLAGS += -DheaptagsREDIRECT_TAG=eHeapTagTasks -include heap_tags_redirect.h
@@ -0,0 +1,18 @@
+#Intended to be included from the Makefile.  Builds the transport that connects
+#the coreMQTT library to the sockets of the host - the TLS transport if TLS is 1,
+#else the plaintext transport.
+
+NETWORK_TRANSPORT_COMMON_DIR += ./../../lib/FreeRTOS/network_transport/posix_sockets
+ifeq ($(TLS),1)
+NETWORK_TRANSPORT_DIR += $(NETWORK_TRANSPORT_COMMON_DIR)/using_mbedtls
+else
+NETWORK_TRANSPORT_DIR += $(NETWORK_TRANSPORT_COMMON_DIR)/using_plaintext
+endif
+INCLUDE_DIRS += -I$(NETWORK_TRANSPORT_COMMON_DIR) \
+				-I$(NETWORK_TRANSPORT_DIR)
+VPATH += $(NETWORK_TRANSPORT_COMMON_DIR) $(NETWORK_TRANSPORT_DIR)
+SOURCE_FILES += $(wildcard $(NETWORK_TRANSPORT_COMMON_DIR)/*.c)
+SOURCE_FILES += $(wildcard $(NETWORK_TRANSPORT_DIR)/*.c)
+
+#The sockets wrapper resolves host names with getaddrinfo_a(), from libanl.
+LDLIBS += -lanl
@@ -0,0 +1,151 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+/*-----------------------------------------------------------
+ * Application specific definitions.
+ *
+ * These definitions should be adjusted for your particular hardware and
+ * application requirements.
+ *
+ * THESE PARAMETERS ARE DESCRIBED WITHIN THE 'CONFIGURATION' SECTION OF THE
+ * FreeRTOS API DOCUMENTATION AVAILABLE ON THE FreeRTOS.org WEB SITE.
+ *
+ * See https://www.freertos.org/a00110.html
+ *
+ * This configuration is for the FreeRTOS POSIX port, which runs each task as
+ * a thread of a Linux process.  Only one task thread runs at a time, and the
+ * tick is generated from a host timer.
+ *----------------------------------------------------------*/
+
+#define configUSE_PREEMPTION                     1
+#define configUSE_TIME_SLICING                   1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION  0
+#define configCHECK_FOR_STACK_OVERFLOW           2
+
+#define configUSE_IDLE_HOOK                      0
+#define configUSE_TICK_HOOK                      0
+#define configUSE_DAEMON_TASK_STARTUP_HOOK       0
+#define configTICK_RATE_HZ                       ( ( TickType_t ) 1000 )
+
+/* The stack of each task is also the stack of its thread, so must be at least
+PTHREAD_STACK_MIN bytes, which is not a constant in recent versions of glibc.
+4096 words is 32K bytes, which also leaves room for the C library functions
+used by the logging. */
+#define configMINIMAL_STACK_SIZE                 ( ( unsigned short ) 4096 )
+
+/* The task stacks are allocated from the FreeRTOS heap. */
+#define configTOTAL_HEAP_SIZE                    ( ( size_t ) ( 4 * 1024 * 1024 ) )
+
+/* Only used when built with HEAP=tlsf.  The size classes of heap_tlsf.c need
+to cover the 4M byte heap. */
+#define heaptlsfMAX_BLOCK_SIZE_LOG2              23
+
+/* Heap accounting by subsystem, see source/heap-tools/heap_tags.h.  Set
+heaptagsTRACE_LENGTH to the number of allocations and frees to keep in the
+allocation trace, or 0 to disable the trace. */
+#define heaptagsENABLED                          1
+#define heaptagsTRACE_LENGTH                     0
+
+#if ( heaptagsTRACE_LENGTH > 0 )
+    void vHeapTagsTraceMalloc( void * pvAddress, size_t xSize );
+    void vHeapTagsTraceFree( void * pvAddress, size_t xSize );
+    #define traceMALLOC( pvAddress, uiSize )    vHeapTagsTraceMalloc( pvAddress, uiSize )
+    #define traceFREE( pvAddress, uiSize )      vHeapTagsTraceFree( pvAddress, uiSize )
+#endif
+#define configMAX_TASK_NAME_LEN                  ( 10 )
+#define configUSE_TRACE_FACILITY                 1
+#define configUSE_16_BIT_TICKS                   0
+#define configIDLE_SHOULD_YIELD                  0
+#define configUSE_CO_ROUTINES                    0
+
+#define configMAX_PRIORITIES                     ( 10 )
+#define configMAX_CO_ROUTINE_PRIORITIES          ( 2 )
+#define configTIMER_QUEUE_LENGTH                 20
+#define configTIMER_TASK_PRIORITY                ( configMAX_PRIORITIES - 1 )
+#define configUSE_COUNTING_SEMAPHORES            1
+#define configSUPPORT_DYNAMIC_ALLOCATION         1
+#define configSUPPORT_STATIC_ALLOCATION          1
+
+/* logging_ring.c keeps the level of the message being logged by each
+task in thread local storage pointer 0. */
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS  1
+
+/* The host logs much faster than QEMU, so the ring of log records is larger.
+Lines end with a line feed only. */
+#define loggingringRECORD_COUNT                  ( 256U )
+#define loggingringLINE_ENDING                   "\n"
+
+/* Run time stats gathering configuration options.  The time base is provided
+by run_time_stats_posix.c. */
+void vConfigureTimerForRunTimeStats( void );
+uint32_t ulGetRunTimeCounterValue( void );
+#define configGENERATE_RUN_TIME_STATS            1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() vConfigureTimerForRunTimeStats()
+#define portGET_RUN_TIME_COUNTER_VALUE()         ulGetRunTimeCounterValue()
+
+/* Set the following definitions to 1 to include the API function, or zero
+to exclude the API function. */
+
+#define configUSE_MALLOC_FAILED_HOOK            1
+#define configUSE_MUTEXES                       1
+#define configUSE_RECURSIVE_MUTEXES             1
+#define configUSE_TIMERS                        1
+#define configTIMER_TASK_STACK_DEPTH            ( configMINIMAL_STACK_SIZE * 2 )
+#define INCLUDE_vTaskPrioritySet                1
+#define INCLUDE_uxTaskPriorityGet               1
+#define INCLUDE_vTaskDelete                     1
+#define INCLUDE_vTaskCleanUpResources           0
+#define INCLUDE_vTaskSuspend                    1
+#define INCLUDE_vTaskDelayUntil                 1
+#define INCLUDE_vTaskDelay                      1
+#define INCLUDE_uxTaskGetStackHighWaterMark     1
+#define INCLUDE_uxTaskGetStackHighWaterMark2    1
+#define INCLUDE_xTaskGetSchedulerState          1
+#define INCLUDE_xTimerGetTimerDaemonTaskHandle  1
+#define INCLUDE_xTaskGetIdleTaskHandle          1
+#define INCLUDE_xTaskGetHandle                  1
+#define INCLUDE_eTaskGetState                   1
+#define INCLUDE_xSemaphoreGetMutexHolder        1
+#define INCLUDE_xTimerPendFunctionCall          1
+#define INCLUDE_xTaskAbortDelay                 1
+
+void vAssertCalled( const char * pcFile, uint32_t ulLine );
+#define configASSERT( x ) if( ( x ) == 0 ) vAssertCalled( __FILE__, __LINE__ )
+#define configQUEUE_REGISTRY_SIZE             0
+
+
+/* Application specific definitions follow. **********************************/
+
+/* The demo connects to the MQTT broker with the sockets of the host instead
+of FreeRTOS+TCP, see lib/FreeRTOS/network_transport/posix_sockets. */
+#define democonfigUSE_POSIX_SOCKETS           1
+
+#include "logging_config.h"
+
+#endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,56 @@
+/*
+ * Lab-Project-coreMQTT-Agent 201215
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ * 1 tab == 4 spaces!
+ */
+
+
+/*
+ * Writes the log records of logging_ring.c to the standard output.  The
+ * logging functions themselves, and the ring of records they share with the
+ * QEMU build, are in logging-tools/logging_ring.c.  FreeRTOSConfig.h makes the
+ * ring larger than in the QEMU build, as the host logs much faster, and ends
+ * lines with "\n" only.
+ */
+
+/* Standard includes. */
+#include <stddef.h>
+
+/* POSIX includes. */
+#include <unistd.h>
+
+/* Logging includes. */
+#include "logging_ring.h"
+
+#if ( LOG_BINARY == 1 )
+    #error Binary logging is only available in the QEMU build.
+#endif
+
+/*-----------------------------------------------------------*/
+
+void vLoggingOutputWrite( const char * pcBuffer,
+                          size_t xLength )
+{
+    ( void ) write( STDOUT_FILENO, pcBuffer, xLength );
+}
@@ -79,8 +79,28 @@
 /* Event group related definitions. */
 #define configUSE_EVENT_GROUPS                     1
 
-/* Run time stats gathering configuration options. */
-#define configGENERATE_RUN_TIME_STATS              0
+/* Run time stats gathering configuration options.  The time base is provided
+ * by run_time_stats_windows.c. */
+extern void vConfigureTimerForRunTimeStats( void );
+extern unsigned long ulGetRunTimeCounterValue( void );
+#define configGENERATE_RUN_TIME_STATS              1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()    vConfigureTimerForRunTimeStats()
+#define portGET_RUN_TIME_COUNTER_VALUE()            ulGetRunTimeCounterValue()
+
+/* Heap accounting by subsystem, see source/heap-tools/heap_tags.h.  Set
+ * heaptagsTRACE_LENGTH to the number of allocations and frees to keep in the
+ * allocation trace, or 0 to disable the trace. */
+#define heaptagsENABLED                            1
+#define heaptagsTRACE_LENGTH                       0
+
+#if ( heaptagsTRACE_LENGTH > 0 )
+    extern void vHeapTagsTraceMalloc( void * pvAddress,
+                                      size_t xSize );
+    extern void vHeapTagsTraceFree( void * pvAddress,
+                                    size_t xSize );
+    #define traceMALLOC( pvAddress, uiSize )    vHeapTagsTraceMalloc( pvAddress, uiSize )
+    #define traceFREE( pvAddress, uiSize )      vHeapTagsTraceFree( pvAddress, uiSize )
+#endif
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES                      0
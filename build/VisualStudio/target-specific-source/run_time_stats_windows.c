@@ -0,0 +1,86 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file run_time_stats_windows.c
+ * @brief Time base for the FreeRTOS run time stats in the Windows simulator.
+ *
+ * The stats are clocked by the Windows performance counter, scaled down to
+ * ticks of 10 microseconds.  Tasks run as Windows threads, so the values are a
+ * measure of elapsed time while each task was selected to run rather than of
+ * CPU cycles consumed.
+ */
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* Windows includes. */
+#include <windows.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Number of run time stats ticks per second. */
+#define rtstatsTICKS_PER_SECOND    ( 100000LL )
+
+/*-----------------------------------------------------------*/
+
+/* Performance counter value when the scheduler was started. */
+static LONGLONG llInitialRunTimeCounterValue = 0LL;
+
+/* Number of performance counter ticks per run time stats tick. */
+static LONGLONG llTicksPerRunTimeStatsTick = 1LL;
+
+/*-----------------------------------------------------------*/
+
+void vConfigureTimerForRunTimeStats( void )
+{
+    LARGE_INTEGER liPerformanceCounterFrequency, liInitialRunTimeValue;
+
+    /* The performance counter frequency is fixed at system boot and is
+     * at least 1 MHz on current versions of Windows. */
+    QueryPerformanceFrequency( &liPerformanceCounterFrequency );
+
+    if( liPerformanceCounterFrequency.QuadPart > rtstatsTICKS_PER_SECOND )
+    {
+        llTicksPerRunTimeStatsTick = liPerformanceCounterFrequency.QuadPart / rtstatsTICKS_PER_SECOND;
+    }
+
+    QueryPerformanceCounter( &liInitialRunTimeValue );
+    llInitialRunTimeCounterValue = liInitialRunTimeValue.QuadPart;
+}
+/*-----------------------------------------------------------*/
+
+unsigned long ulGetRunTimeCounterValue( void )
+{
+    LARGE_INTEGER liCurrentCount;
+
+    QueryPerformanceCounter( &liCurrentCount );
+
+    return ( unsigned long ) ( ( liCurrentCount.QuadPart - llInitialRunTimeCounterValue ) / llTicksPerRunTimeStatsTick );
+}
+/*-----------------------------------------------------------*/
@@ -25,9 +25,13 @@
 
 /* OTA PAL implementation for Windows platform. */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleOta
+
 #include <stdio.h>
 #include <stdlib.h>
 #include "FreeRTOS.h"
+#include "heap_tags.h"
 #include "ota_config.h"
 
 #include "iot_crypto.h"
@@ -272,7 +276,7 @@ static OtaPalMainStatus_t otaPal_CheckFileSignature( OtaFileContext_t * const C
 
             if( pucSignerCert != NULL )
             {
-                pucBuf = pvPortMalloc( OTA_PAL_WIN_BUF_SIZE ); /*lint !e9079 Allow conversion. */
+                pucBuf = heaptagsMALLOC( eHeapTagOta, OTA_PAL_WIN_BUF_SIZE ); /*lint !e9079 Allow conversion. */
 
                 if( pucBuf != NULL )
                 {
@@ -304,7 +308,7 @@ static OtaPalMainStatus_t otaPal_CheckFileSignature( OtaFileContext_t * const C
                     }
 
                     /* Free the temporary file page buffer. */
-                    vPortFree( pucBuf );
+                    heaptagsFREE( pucBuf );
                 }
                 else
                 {
@@ -313,7 +317,7 @@ static OtaPalMainStatus_t otaPal_CheckFileSignature( OtaFileContext_t * const C
                 }
 
                 /* Free the signer certificate that we now own after prvReadAndAssumeCertificate(). */
-                vPortFree( pucSignerCert );
+                heaptagsFREE( pucSignerCert );
             }
             else
             {
@@ -372,7 +376,7 @@ static uint8_t * otaPal_ReadAndAssumeCertificate( const uint8_t * const pucCertN
         if( lWindowsError == 0 )
         {
             /* Allocate memory for the signer certificate plus a terminating zero so we can load and return it to the caller. */
-            pucSignerCert = pvPortMalloc( lSize + 1 ); /*lint !e732 !e9034 !e9079 Allow conversion. */
+            pucSignerCert = heaptagsMALLOC( eHeapTagOta, lSize + 1 ); /*lint !e732 !e9034 !e9079 Allow conversion. */
         }
 
         if( pucSignerCert != NULL )
@@ -386,7 +390,7 @@ static uint8_t * otaPal_ReadAndAssumeCertificate( const uint8_t * const pucCertN
             }
             else
             {   /* There was a problem reading the certificate file so free the memory and abort. */
-                vPortFree( pucSignerCert );
+                heaptagsFREE( pucSignerCert );
                 pucSignerCert = NULL;
             }
         }
@@ -412,7 +416,7 @@ static uint8_t * otaPal_ReadAndAssumeCertificate( const uint8_t * const pucCertN
 
         /* Allocate memory for the signer certificate plus a terminating zero so we can copy it and return to the caller. */
         lSize = sizeof( signingcredentialSIGNING_CERTIFICATE_PEM );
-        pucSignerCert = pvPortMalloc( lSize );                           /*lint !e9029 !e9079 !e838 malloc proto requires void*. */
+        pucSignerCert = heaptagsMALLOC( eHeapTagOta, lSize );                 /*lint !e9029 !e9079 !e838 malloc proto requires void*. */
         pucCertData = ( uint8_t * ) signingcredentialSIGNING_CERTIFICATE_PEM; /*lint !e9005 we don't modify the cert but it could be set by PKCS11 so it's not const. */
 
         if( pucSignerCert != NULL )
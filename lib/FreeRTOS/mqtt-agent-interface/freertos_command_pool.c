@@ -29,73 +29,50 @@
  * @brief Implements functions to obtain and release commands.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleAgent
+
 /* Standard includes. */
 #include <string.h>
 #include <stdio.h>
 
 /* Kernel includes. */
 #include "FreeRTOS.h"
-#include "semphr.h"
 
 /* Header include. */
 #include "freertos_command_pool.h"
-#include "freertos_agent_message.h"
+
+/* Object pool include. */
+#include "object_pool.h"
 
 /*-----------------------------------------------------------*/
 
-#define QUEUE_NOT_INITIALIZED    ( 0U )
-#define QUEUE_INITIALIZED        ( 1U )
+#define POOL_NOT_INITIALIZED    ( 0U )
+#define POOL_INITIALIZED        ( 1U )
 
 /**
  * @brief The pool of command structures used to hold information on commands (such
  * as PUBLISH or SUBSCRIBE) between the command being created by an API call and
- * completion of the command by the execution of the command's callback.
- */
-static MQTTAgentCommand_t commandStructurePool[ MQTT_COMMAND_CONTEXTS_POOL_SIZE ];
-
-/**
- * @brief The message context used to guard the pool of MQTTAgentCommand_t structures.
- * For FreeRTOS, this is implemented with a queue. Structures may be
- * obtained by receiving a pointer from the queue, and returned by
- * sending the pointer back into it.
+ * completion of the command by the execution of the command's callback.  The pool
+ * is blocking, so a task can wait for a structure to be returned.
  */
-static MQTTAgentMessageContext_t commandStructMessageCtx;
+objectpoolDEFINE( commandStructurePool, MQTTAgentCommand_t, MQTT_COMMAND_CONTEXTS_POOL_SIZE );
 
 /**
- * @brief Initialization status of the queue.
+ * @brief Initialization status of the pool.
  */
-static volatile uint8_t initStatus = QUEUE_NOT_INITIALIZED;
+static volatile uint8_t initStatus = POOL_NOT_INITIALIZED;
 
 /*-----------------------------------------------------------*/
 
 void Agent_InitializePool( void )
 {
-    size_t i;
-    MQTTAgentCommand_t * pCommand;
-    static uint8_t staticQueueStorageArea[ MQTT_COMMAND_CONTEXTS_POOL_SIZE * sizeof( MQTTAgentCommand_t * ) ];
-    static StaticQueue_t staticQueueStructure;
-    bool commandAdded = false;
-
-    if( initStatus == QUEUE_NOT_INITIALIZED )
+    if( initStatus == POOL_NOT_INITIALIZED )
     {
-        memset( ( void * ) commandStructurePool, 0x00, sizeof( commandStructurePool ) );
-        commandStructMessageCtx.queue = xQueueCreateStatic( MQTT_COMMAND_CONTEXTS_POOL_SIZE,
-                                                       sizeof( MQTTAgentCommand_t * ),
-                                                       staticQueueStorageArea,
-                                                       &staticQueueStructure );
-        configASSERT( commandStructMessageCtx.queue );
-
-        /* Populate the queue. */
-        for( i = 0; i < MQTT_COMMAND_CONTEXTS_POOL_SIZE; i++ )
-        {
-            /* Store the address as a variable. */
-            pCommand = &commandStructurePool[ i ];
-            /* Send the pointer to the queue. */
-            commandAdded = Agent_MessageSend( &commandStructMessageCtx, &pCommand, 0U );
-            configASSERT( commandAdded );
-        }
-
-        initStatus = QUEUE_INITIALIZED;
+        memset( ( void * ) commandStructurePoolObjects, 0x00, sizeof( commandStructurePoolObjects ) );
+        objectpoolINIT( commandStructurePool, "commands", pdTRUE );
+
+        initStatus = POOL_INITIALIZED;
     }
 }
 
@@ -104,17 +81,21 @@ void Agent_InitializePool( void )
 MQTTAgentCommand_t * Agent_GetCommand( uint32_t blockTimeMs )
 {
     MQTTAgentCommand_t * structToUse = NULL;
-    bool structRetrieved = false;
+    ObjectPoolStats_t poolStats;
 
-    /* Check queue has been created. */
-    configASSERT( initStatus == QUEUE_INITIALIZED );
+    /* Check pool has been initialized. */
+    configASSERT( initStatus == POOL_INITIALIZED );
 
-    /* Retrieve a struct from the queue. */
-    structRetrieved = Agent_MessageReceive( &commandStructMessageCtx, &( structToUse ), blockTimeMs );
+    /* Retrieve a struct from the pool. */
+    structToUse = pvObjectPoolAcquire( &commandStructurePool, pdMS_TO_TICKS( blockTimeMs ) );
 
-    if( !structRetrieved )
+    if( structToUse == NULL )
     {
-        LogError( ( "No command structure available." ) );
+        vObjectPoolGetStats( &commandStructurePool, &poolStats );
+        LogError( ( "No command structure available. %lu of %lu in use, %lu failed requests.",
+                    ( unsigned long ) poolStats.ulInUse,
+                    ( unsigned long ) poolStats.ulObjectCount,
+                    ( unsigned long ) poolStats.ulFailures ) );
     }
 
     return structToUse;
@@ -126,19 +107,15 @@ bool Agent_ReleaseCommand( MQTTAgentCommand_t * pCommandToRelease )
 {
     bool structReturned = false;
 
-    configASSERT( initStatus == QUEUE_INITIALIZED );
+    configASSERT( initStatus == POOL_INITIALIZED );
 
-    /* See if the structure being returned is actually from the pool. */
-    if( ( pCommandToRelease >= commandStructurePool ) &&
-        ( pCommandToRelease < ( commandStructurePool + MQTT_COMMAND_CONTEXTS_POOL_SIZE ) ) )
+    /* The pool checks the structure being returned is actually from the pool,
+     * and has not already been returned. */
+    if( xObjectPoolRelease( &commandStructurePool, pCommandToRelease ) == pdPASS )
     {
-        structReturned = Agent_MessageSend( &commandStructMessageCtx, &pCommandToRelease, 0U );
-
-        /* The send should not fail as the queue was created to hold every command
-         * in the pool. */
-        configASSERT( structReturned );
+        structReturned = true;
         LogDebug( ( "Returned Command Context %d to pool",
-                    ( int ) ( pCommandToRelease - commandStructurePool ) ) );
+                    ( int ) lObjectPoolIndex( &commandStructurePool, pCommandToRelease ) ) );
     }
 
     return structReturned;
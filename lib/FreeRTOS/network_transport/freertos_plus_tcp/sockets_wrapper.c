@@ -24,6 +24,9 @@
  * @brief FreeRTOS Sockets connect and disconnect wrapper implementation.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleTransport
+
 /* Standard includes. */
 #include <string.h>
 
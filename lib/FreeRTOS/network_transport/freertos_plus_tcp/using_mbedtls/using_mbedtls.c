@@ -25,6 +25,9 @@
  * mbedTLS.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleTls
+
 /* Standard includes. */
 #include <string.h>
 
@@ -218,7 +221,12 @@ static void sslContextInit( SSLContext_t * pSslContext )
 
 #ifdef MBEDTLS_DEBUG_C
     mbedtls_ssl_conf_dbg( &( pSslContext->config ), vTLSDebugPrint, NULL );
-    mbedtls_debug_set_threshold( MBEDTLS_DEBUG_THRESHOLD );
+
+    /* mbedTLS formats its debug messages before passing them to
+     * vTLSDebugPrint(), so only enable them while the debug messages of the
+     * TLS module are enabled.  The runtime level is read when a connection is
+     * set up. */
+    mbedtls_debug_set_threshold( ( ucLoggingModuleLevels[ eLogModuleTls ] >= LOG_DEBUG ) ? MBEDTLS_DEBUG_THRESHOLD : 0 );
 #endif
 
     /* Prevent compiler warnings when LogDebug() is defined away. */
@@ -28,6 +28,9 @@
  * PKCS #11 when using TLS.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleTls
+
 /* Standard includes. */
 #include <string.h>
 
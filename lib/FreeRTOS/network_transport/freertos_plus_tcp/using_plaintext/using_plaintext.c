@@ -19,6 +19,9 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleTransport
+
 /* Standard includes. */
 #include <string.h>
 
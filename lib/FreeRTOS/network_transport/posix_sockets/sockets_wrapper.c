@@ -0,0 +1,631 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file sockets_wrapper.c
+ * @brief BSD sockets connect and disconnect wrapper implementation for the
+ * FreeRTOS POSIX port.
+ */
+
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleTransport
+
+/* For getaddrinfo_a(), which must be declared by the first include. */
+#define _GNU_SOURCE
+
+/* Standard includes. */
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+/* POSIX includes. */
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "sockets_wrapper.h"
+
+/*-----------------------------------------------------------*/
+
+/* Maximum number of times to call recv when initiating a graceful shutdown. */
+#ifndef POSIX_SOCKETS_WRAPPER_SHUTDOWN_LOOPS
+    #define POSIX_SOCKETS_WRAPPER_SHUTDOWN_LOOPS    ( 3 )
+#endif
+
+/* Set to 1 to disable Nagle's algorithm, so the small packets of MQTT are
+ * sent straight away instead of waiting for the acknowledgement of the data
+ * already sent. */
+#ifndef POSIX_SOCKETS_WRAPPER_TCP_NODELAY
+    #define POSIX_SOCKETS_WRAPPER_TCP_NODELAY    ( 1 )
+#endif
+
+/* The sizes of the send and receive buffers of a socket, in bytes, or 0 to
+ * use the defaults of the host. */
+#ifndef POSIX_SOCKETS_WRAPPER_SNDBUF_SIZE
+    #define POSIX_SOCKETS_WRAPPER_SNDBUF_SIZE    ( 0 )
+#endif
+
+#ifndef POSIX_SOCKETS_WRAPPER_RCVBUF_SIZE
+    #define POSIX_SOCKETS_WRAPPER_RCVBUF_SIZE    ( 0 )
+#endif
+
+/* The maximum number of sockets with a wakeup callback at any one time. */
+#ifndef POSIX_SOCKETS_WRAPPER_MAX_WAKEUP_SOCKETS
+    #define POSIX_SOCKETS_WRAPPER_MAX_WAKEUP_SOCKETS    ( 4 )
+#endif
+
+/* The priority of the task that calls the wakeup callbacks.  FreeRTOS+TCP
+ * calls them from the IP task, which normally runs at this priority. */
+#ifndef POSIX_SOCKETS_WRAPPER_WAKEUP_TASK_PRIORITY
+    #define POSIX_SOCKETS_WRAPPER_WAKEUP_TASK_PRIORITY    ( configMAX_PRIORITIES - 2 )
+#endif
+
+#ifndef POSIX_SOCKETS_WRAPPER_WAKEUP_TASK_STACK_SIZE
+    #define POSIX_SOCKETS_WRAPPER_WAKEUP_TASK_STACK_SIZE    ( configMINIMAL_STACK_SIZE )
+#endif
+
+/* A negative error code indicating a network failure. */
+#define POSIX_SOCKETS_WRAPPER_NETWORK_ERROR    ( -1 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A socket with a wakeup callback.
+ */
+typedef struct WakeupSocket
+{
+    Socket_t tcpSocket;
+    SocketsWakeupCallback_t callback;
+    void * pContext;
+} WakeupSocket_t;
+
+/**
+ * @brief The sockets with a wakeup callback.  Only accessed with the scheduler
+ * suspended.
+ */
+static WakeupSocket_t wakeupSockets[ POSIX_SOCKETS_WRAPPER_MAX_WAKEUP_SOCKETS ];
+
+/**
+ * @brief The epoll instance the sockets with a wakeup callback are registered
+ * with, created with the task that polls it when the first callback is set.
+ */
+static int wakeupEpoll = -1;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Set the options of a new socket that must be set before it connects.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ */
+static void setSocketOptions( Socket_t tcpSocket );
+
+/**
+ * @brief The task that polls the epoll instance every tick and calls the
+ * wakeup callbacks of the sockets that received data.
+ *
+ * The epoll instance cannot be waited on as a task of the POSIX port must not
+ * block in a system call, and a thread that is not a task cannot call the
+ * FreeRTOS API from the callbacks.
+ *
+ * @param[in] pvParameters Unused.
+ */
+static void wakeupTask( void * pvParameters );
+
+/**
+ * @brief Find the wakeup callback of a socket.  Must be called with the
+ * scheduler suspended.
+ *
+ * @param[in] tcpSocket The socket descriptor, or SOCKETS_INVALID_SOCKET to find
+ * an unused entry.
+ *
+ * @return The entry of the socket, or NULL if there is none.
+ */
+static WakeupSocket_t * findWakeupSocket( Socket_t tcpSocket );
+
+/**
+ * @brief Connect a non-blocking socket to one of the addresses of the server.
+ *
+ * @param[in] pAddressInfo The address to connect to.
+ * @param[in] connectTimeout The time to wait for the connection, in ticks.
+ *
+ * @return The connected socket, or SOCKETS_INVALID_SOCKET.
+ */
+static int connectToAddress( const struct addrinfo * pAddressInfo,
+                             TickType_t connectTimeout );
+
+/**
+ * @brief Resolve the addresses of the server.
+ *
+ * A DNS lookup made by getaddrinfo() can block for seconds, and a task of the
+ * POSIX port must not block in a system call.  The lookup is instead started
+ * with getaddrinfo_a(), which makes it in a thread of the C library, and its
+ * completion is polled every tick.  The request must stay valid until the
+ * lookup completes, so the lookup is not abandoned early - it is bounded by
+ * the timeouts of the resolver.
+ *
+ * @param[in] pHostName The host name of the server.
+ * @param[in] pPortString The port of the server, as a string.
+ * @param[in] pHints The kinds of addresses to return.
+ * @param[out] ppAddressList The addresses, to be freed with freeaddrinfo().
+ *
+ * @return 0 if the addresses are resolved, otherwise an error code of
+ * getaddrinfo().
+ */
+static int resolveAddress( const char * pHostName,
+                           const char * pPortString,
+                           const struct addrinfo * pHints,
+                           struct addrinfo ** ppAddressList );
+
+/*-----------------------------------------------------------*/
+
+static void setSocketOptions( Socket_t tcpSocket )
+{
+    int optionValue = POSIX_SOCKETS_WRAPPER_TCP_NODELAY;
+
+    /* The options only affect performance, so failing to set one is not an
+     * error. */
+    if( setsockopt( tcpSocket, IPPROTO_TCP, TCP_NODELAY, &optionValue, sizeof( optionValue ) ) != 0 )
+    {
+        LogWarn( ( "Failed to set TCP_NODELAY: errno=%d.", errno ) );
+    }
+
+    #if ( POSIX_SOCKETS_WRAPPER_SNDBUF_SIZE > 0 )
+        {
+            optionValue = POSIX_SOCKETS_WRAPPER_SNDBUF_SIZE;
+
+            if( setsockopt( tcpSocket, SOL_SOCKET, SO_SNDBUF, &optionValue, sizeof( optionValue ) ) != 0 )
+            {
+                LogWarn( ( "Failed to set SO_SNDBUF: errno=%d.", errno ) );
+            }
+        }
+    #endif
+
+    #if ( POSIX_SOCKETS_WRAPPER_RCVBUF_SIZE > 0 )
+        {
+            /* Set before connecting so the window scale offered to the peer
+             * allows for the size of the buffer. */
+            optionValue = POSIX_SOCKETS_WRAPPER_RCVBUF_SIZE;
+
+            if( setsockopt( tcpSocket, SOL_SOCKET, SO_RCVBUF, &optionValue, sizeof( optionValue ) ) != 0 )
+            {
+                LogWarn( ( "Failed to set SO_RCVBUF: errno=%d.", errno ) );
+            }
+        }
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+static WakeupSocket_t * findWakeupSocket( Socket_t tcpSocket )
+{
+    WakeupSocket_t * pWakeupSocket = NULL;
+    size_t i;
+
+    for( i = 0; ( i < POSIX_SOCKETS_WRAPPER_MAX_WAKEUP_SOCKETS ) && ( pWakeupSocket == NULL ); i++ )
+    {
+        /* The descriptor of an unused entry is not valid as the table is
+         * zero initialised, so unused entries are found by their callback. */
+        if( wakeupSockets[ i ].callback == NULL )
+        {
+            if( tcpSocket == SOCKETS_INVALID_SOCKET )
+            {
+                pWakeupSocket = &( wakeupSockets[ i ] );
+            }
+        }
+        else if( wakeupSockets[ i ].tcpSocket == tcpSocket )
+        {
+            pWakeupSocket = &( wakeupSockets[ i ] );
+        }
+    }
+
+    return pWakeupSocket;
+}
+
+/*-----------------------------------------------------------*/
+
+static void wakeupTask( void * pvParameters )
+{
+    struct epoll_event events[ POSIX_SOCKETS_WRAPPER_MAX_WAKEUP_SOCKETS ];
+    SocketsWakeupCallback_t callback;
+    void * pContext = NULL;
+    WakeupSocket_t * pWakeupSocket;
+    int eventCount;
+    int i;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        eventCount = epoll_wait( wakeupEpoll, events, POSIX_SOCKETS_WRAPPER_MAX_WAKEUP_SOCKETS, 0 );
+
+        for( i = 0; i < eventCount; i++ )
+        {
+            /* The callback may have been removed since the event was
+             * reported, so look it up rather than storing it in the event. */
+            vTaskSuspendAll();
+            {
+                pWakeupSocket = findWakeupSocket( events[ i ].data.fd );
+                callback = ( pWakeupSocket != NULL ) ? pWakeupSocket->callback : NULL;
+                pContext = ( pWakeupSocket != NULL ) ? pWakeupSocket->pContext : NULL;
+            }
+            ( void ) xTaskResumeAll();
+
+            if( callback != NULL )
+            {
+                callback( events[ i ].data.fd, pContext );
+            }
+        }
+
+        /* The sockets are registered edge triggered, so data that arrives
+         * before the next poll is reported then. */
+        vTaskDelay( 1U );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int connectToAddress( const struct addrinfo * pAddressInfo,
+                             TickType_t connectTimeout )
+{
+    int tcpSocket;
+    int socketError = 0;
+    socklen_t socketErrorLength = sizeof( socketError );
+
+    tcpSocket = socket( pAddressInfo->ai_family,
+                        pAddressInfo->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        pAddressInfo->ai_protocol );
+
+    if( tcpSocket >= 0 )
+    {
+        setSocketOptions( tcpSocket );
+    }
+
+    if( tcpSocket < 0 )
+    {
+        LogError( ( "Failed to create new socket: errno=%d.", errno ) );
+    }
+    else if( connect( tcpSocket, pAddressInfo->ai_addr, pAddressInfo->ai_addrlen ) == 0 )
+    {
+        /* Connected straight away, which can happen on the loopback
+         * interface. */
+    }
+    else if( ( errno != EINPROGRESS ) && ( errno != EINTR ) )
+    {
+        socketError = errno;
+    }
+    else if( Sockets_Wait( tcpSocket, POLLOUT, connectTimeout ) == pdFALSE )
+    {
+        socketError = ETIMEDOUT;
+    }
+    else if( getsockopt( tcpSocket, SOL_SOCKET, SO_ERROR, &socketError, &socketErrorLength ) != 0 )
+    {
+        socketError = errno;
+    }
+    else
+    {
+        /* socketError holds the result of the connection attempt. */
+    }
+
+    if( ( tcpSocket >= 0 ) && ( socketError != 0 ) )
+    {
+        LogDebug( ( "Connection attempt failed: errno=%d.", socketError ) );
+        ( void ) close( tcpSocket );
+        tcpSocket = SOCKETS_INVALID_SOCKET;
+    }
+
+    return tcpSocket;
+}
+
+/*-----------------------------------------------------------*/
+
+static int resolveAddress( const char * pHostName,
+                           const char * pPortString,
+                           const struct addrinfo * pHints,
+                           struct addrinfo ** ppAddressList )
+{
+    struct gaicb request = { 0 };
+    struct gaicb * pRequest = &request;
+    int dnsStatus;
+
+    request.ar_name = pHostName;
+    request.ar_service = pPortString;
+    request.ar_request = pHints;
+
+    dnsStatus = getaddrinfo_a( GAI_NOWAIT, &pRequest, 1, NULL );
+
+    if( dnsStatus == 0 )
+    {
+        for( dnsStatus = gai_error( &request ); dnsStatus == EAI_INPROGRESS; dnsStatus = gai_error( &request ) )
+        {
+            vTaskDelay( 1U );
+        }
+    }
+
+    if( dnsStatus == 0 )
+    {
+        *ppAddressList = request.ar_result;
+    }
+
+    return dnsStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Connect( Socket_t * pTcpSocket,
+                            const char * pHostName,
+                            uint16_t port,
+                            uint32_t connectTimeoutMs )
+{
+    int tcpSocket = SOCKETS_INVALID_SOCKET;
+    BaseType_t socketStatus = 0;
+    struct addrinfo hints = { 0 };
+    struct addrinfo * pAddressList = NULL;
+    const struct addrinfo * pAddressInfo;
+    char portString[ 6 ];
+    int dnsStatus;
+
+    /* Resolve both IPv4 and IPv6 addresses of the server. */
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    ( void ) snprintf( portString, sizeof( portString ), "%u", ( unsigned ) port );
+
+    dnsStatus = resolveAddress( pHostName, portString, &hints, &pAddressList );
+
+    if( dnsStatus != 0 )
+    {
+        LogError( ( "Failed to connect to server: DNS resolution failed: Hostname=%s, Error=%s.",
+                    pHostName,
+                    gai_strerror( dnsStatus ) ) );
+        socketStatus = POSIX_SOCKETS_WRAPPER_NETWORK_ERROR;
+    }
+    else
+    {
+        /* Establish connection, trying each address in turn. */
+        LogDebug( ( "Creating TCP Connection to %s.", pHostName ) );
+
+        for( pAddressInfo = pAddressList;
+             ( pAddressInfo != NULL ) && ( tcpSocket == SOCKETS_INVALID_SOCKET );
+             pAddressInfo = pAddressInfo->ai_next )
+        {
+            tcpSocket = connectToAddress( pAddressInfo, pdMS_TO_TICKS( connectTimeoutMs ) );
+        }
+
+        freeaddrinfo( pAddressList );
+
+        if( tcpSocket == SOCKETS_INVALID_SOCKET )
+        {
+            LogError( ( "Failed to connect to server: Hostname=%s, Port=%u.",
+                        pHostName,
+                        port ) );
+            socketStatus = POSIX_SOCKETS_WRAPPER_NETWORK_ERROR;
+        }
+    }
+
+    if( socketStatus == 0 )
+    {
+        /* Set the socket. */
+        *pTcpSocket = tcpSocket;
+        LogInfo( ( "Established TCP connection with %s.", pHostName ) );
+    }
+
+    return socketStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+void Sockets_Disconnect( Socket_t tcpSocket )
+{
+    BaseType_t waitForShutdownLoopCount = 0;
+    uint8_t pDummyBuffer[ 2 ];
+
+    if( tcpSocket != SOCKETS_INVALID_SOCKET )
+    {
+        /* The descriptor can be reused by the next socket, which must not
+         * inherit the callback. */
+        ( void ) Sockets_SetWakeupCallback( tcpSocket, NULL, NULL );
+
+        /* Initiate graceful shutdown. */
+        ( void ) shutdown( tcpSocket, SHUT_WR );
+
+        /* Give the peer a moment to close its side of the connection, which
+         * is indicated by recv() returning 0, before closing the socket. */
+        while( ( Sockets_Wait( tcpSocket, POLLIN, 1U ) == pdFALSE ) ||
+               ( recv( tcpSocket, pDummyBuffer, sizeof( pDummyBuffer ), MSG_DONTWAIT ) > 0 ) )
+        {
+            if( ++waitForShutdownLoopCount >= POSIX_SOCKETS_WRAPPER_SHUTDOWN_LOOPS )
+            {
+                break;
+            }
+        }
+
+        ( void ) close( tcpSocket );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Wait( Socket_t tcpSocket,
+                         short events,
+                         TickType_t timeout )
+{
+    struct pollfd pollDescriptor;
+    TimeOut_t timeOut;
+    BaseType_t ready = pdFALSE;
+    BaseType_t timedOut = pdFALSE;
+    int pollStatus;
+
+    pollDescriptor.fd = tcpSocket;
+    pollDescriptor.events = events;
+
+    vTaskSetTimeOutState( &timeOut );
+
+    while( ( ready == pdFALSE ) && ( timedOut == pdFALSE ) )
+    {
+        pollDescriptor.revents = 0;
+        pollStatus = poll( &pollDescriptor, 1, 0 );
+
+        if( ( pollStatus > 0 ) || ( ( pollStatus < 0 ) && ( errno != EINTR ) ) )
+        {
+            /* POLLERR and POLLHUP are reported whatever the events, and an
+             * error from poll() is left for the caller to find. */
+            ready = pdTRUE;
+        }
+        else if( xTaskCheckForTimeOut( &timeOut, &timeout ) == pdFALSE )
+        {
+            /* Poll again on the next tick. */
+            vTaskDelay( 1U );
+        }
+        else
+        {
+            timedOut = pdTRUE;
+        }
+    }
+
+    return ready;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetWakeupCallback( Socket_t tcpSocket,
+                                      SocketsWakeupCallback_t callback,
+                                      void * pContext )
+{
+    BaseType_t status = pdPASS;
+    WakeupSocket_t * pWakeupSocket;
+    struct epoll_event event = { 0 };
+    int operation;
+    int socketError = 0;
+
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.fd = tcpSocket;
+
+    /* Suspending the scheduler keeps the table consistent with the epoll
+     * instance, and the system calls do not block.  Errors are logged after
+     * the scheduler is resumed. */
+    vTaskSuspendAll();
+    {
+        if( ( callback != NULL ) && ( wakeupEpoll < 0 ) )
+        {
+            wakeupEpoll = epoll_create1( EPOLL_CLOEXEC );
+
+            if( wakeupEpoll < 0 )
+            {
+                socketError = errno;
+                status = pdFAIL;
+            }
+            else if( xTaskCreate( wakeupTask,
+                                  "SockWake",
+                                  POSIX_SOCKETS_WRAPPER_WAKEUP_TASK_STACK_SIZE,
+                                  NULL,
+                                  POSIX_SOCKETS_WRAPPER_WAKEUP_TASK_PRIORITY,
+                                  NULL ) != pdPASS )
+            {
+                ( void ) close( wakeupEpoll );
+                wakeupEpoll = -1;
+                socketError = ENOMEM;
+                status = pdFAIL;
+            }
+        }
+
+        pWakeupSocket = findWakeupSocket( tcpSocket );
+
+        if( status == pdFAIL )
+        {
+            /* Could not start polling the sockets. */
+        }
+        else if( callback == NULL )
+        {
+            /* Nothing to do if the socket has no callback. */
+            if( pWakeupSocket != NULL )
+            {
+                ( void ) epoll_ctl( wakeupEpoll, EPOLL_CTL_DEL, tcpSocket, NULL );
+                pWakeupSocket->tcpSocket = SOCKETS_INVALID_SOCKET;
+                pWakeupSocket->callback = NULL;
+                pWakeupSocket->pContext = NULL;
+            }
+        }
+        else
+        {
+            operation = ( pWakeupSocket != NULL ) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+            if( pWakeupSocket == NULL )
+            {
+                pWakeupSocket = findWakeupSocket( SOCKETS_INVALID_SOCKET );
+            }
+
+            if( pWakeupSocket == NULL )
+            {
+                /* All POSIX_SOCKETS_WRAPPER_MAX_WAKEUP_SOCKETS entries are in
+                 * use. */
+                socketError = ENOSPC;
+                status = pdFAIL;
+            }
+            else if( epoll_ctl( wakeupEpoll, operation, tcpSocket, &event ) != 0 )
+            {
+                socketError = errno;
+                status = pdFAIL;
+            }
+            else
+            {
+                pWakeupSocket->tcpSocket = tcpSocket;
+                pWakeupSocket->callback = callback;
+                pWakeupSocket->pContext = pContext;
+            }
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    if( status == pdFAIL )
+    {
+        LogError( ( "Failed to set the wakeup callback of socket %d: errno=%d.",
+                    tcpSocket,
+                    socketError ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t Sockets_RecvCount( Socket_t tcpSocket )
+{
+    int byteCount = 0;
+
+    if( ioctl( tcpSocket, FIONREAD, &byteCount ) != 0 )
+    {
+        byteCount = POSIX_SOCKETS_WRAPPER_NETWORK_ERROR;
+    }
+
+    return ( int32_t ) byteCount;
+}
+
+/*-----------------------------------------------------------*/
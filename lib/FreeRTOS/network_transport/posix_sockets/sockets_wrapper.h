@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file sockets_wrapper.h
+ * @brief BSD sockets connect and disconnect function wrapper for the FreeRTOS
+ * POSIX port.
+ *
+ * Tasks of the POSIX port are threads of which only one runs at a time, so a
+ * task must not block in a system call - the sockets are non-blocking and
+ * waiting for them is done by polling between task delays.
+ */
+
+#ifndef SOCKETS_WRAPPER_H
+#define SOCKETS_WRAPPER_H
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief A socket descriptor, named as in FreeRTOS+TCP so the application code
+ * that handles sockets does not depend on the TCP/IP stack.
+ */
+typedef int Socket_t;
+
+/**
+ * @brief The value of an invalid socket descriptor.
+ */
+#define SOCKETS_INVALID_SOCKET    ( -1 )
+
+/**
+ * @brief A function called when data arrives on a socket, see
+ * Sockets_SetWakeupCallback().
+ */
+typedef void ( * SocketsWakeupCallback_t )( Socket_t tcpSocket,
+                                          void * pContext );
+
+/**
+ * @brief Establish a connection to server.
+ *
+ * @param[out] pTcpSocket The output parameter to return the created socket descriptor.
+ * @param[in] pHostName Server hostname to connect to.
+ * @param[in] port Server port to connect to.
+ * @param[in] connectTimeoutMs Timeout (in milliseconds) for the connection to
+ * be established.
+ *
+ * @note The host name is resolved with getaddrinfo(), which blocks.  Nagle's
+ * algorithm is disabled by default, and the sizes of the socket buffers can be
+ * set, see POSIX_SOCKETS_WRAPPER_TCP_NODELAY in sockets_wrapper.c.
+ *
+ * @return Non-zero value on error, 0 on success.
+ */
+BaseType_t Sockets_Connect( Socket_t * pTcpSocket,
+                            const char * pHostName,
+                            uint16_t port,
+                            uint32_t connectTimeoutMs );
+
+/**
+ * @brief End connection to server.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ */
+void Sockets_Disconnect( Socket_t tcpSocket );
+
+/**
+ * @brief Wait for a socket to become readable or writable.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ * @param[in] events POLLIN to wait until the socket can be read, or POLLOUT
+ * to wait until it can be written.
+ * @param[in] timeout The time to wait, in ticks.  0 only checks the socket.
+ *
+ * @return pdTRUE if the socket is ready, or has an error or was closed by the
+ * peer, else pdFALSE.
+ */
+BaseType_t Sockets_Wait( Socket_t tcpSocket,
+                         short events,
+                         TickType_t timeout );
+
+/**
+ * @brief Set the function to call when data arrives on a socket, the
+ * equivalent of the FREERTOS_SO_WAKEUP_CALLBACK socket option of FreeRTOS+TCP.
+ *
+ * The sockets are registered with an epoll instance that a task polls every
+ * tick, so the callback runs in the context of that task and can call the
+ * FreeRTOS API, but must not block.  The callback is called once for each
+ * arrival of data, not while the data stays unread.
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ * @param[in] callback The function to call, or NULL to stop calling it.  The
+ * callback is removed when the socket is disconnected.
+ * @param[in] pContext Passed to the callback.
+ *
+ * @return pdPASS if the callback was set, else pdFAIL.
+ */
+BaseType_t Sockets_SetWakeupCallback( Socket_t tcpSocket,
+                                      SocketsWakeupCallback_t callback,
+                                      void * pContext );
+
+/**
+ * @brief Get the number of bytes that can be read from a socket without
+ * waiting, the equivalent of FreeRTOS_recvcount().
+ *
+ * @param[in] tcpSocket The socket descriptor.
+ *
+ * @return The number of bytes, or a negative value on error.
+ */
+int32_t Sockets_RecvCount( Socket_t tcpSocket );
+
+#endif /* ifndef SOCKETS_WRAPPER_H */
@@ -0,0 +1,881 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file tls_freertos.c
+ * @brief TLS transport interface implementations. This implementation uses
+ * mbedTLS over BSD sockets.
+ *
+ * The sockets are non-blocking, so mbedTLS returns MBEDTLS_ERR_SSL_WANT_READ
+ * or MBEDTLS_ERR_SSL_WANT_WRITE instead of blocking and the waiting is done
+ * here with Sockets_Wait().
+ */
+
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleTls
+
+/* Standard includes. */
+#include <string.h>
+
+/* POSIX includes. */
+#include <poll.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* TLS transport header. */
+#include "using_mbedtls.h"
+#include "mbedtls_config.h"
+#include "mbedtls/debug.h"
+
+/* Socket wrapper include. */
+#include "sockets_wrapper.h"
+
+/* mbedTLS util includes. */
+#include "mbedtls_error.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Represents string to be logged when mbedTLS returned error
+ * does not contain a high-level code.
+ */
+static const char * pNoHighLevelMbedTlsCodeStr = "<No-High-Level-Code>";
+
+/**
+ * @brief Represents string to be logged when mbedTLS returned error
+ * does not contain a low-level code.
+ */
+static const char * pNoLowLevelMbedTlsCodeStr = "<No-Low-Level-Code>";
+
+/**
+ * @brief Utility for converting the high-level code in an mbedTLS error to string,
+ * if the code-contains a high-level code; otherwise, using a default string.
+ */
+#define mbedtlsHighLevelCodeOrDefault( mbedTlsCode )        \
+    ( mbedtls_strerror_highlevel( mbedTlsCode ) != NULL ) ? \
+    mbedtls_strerror_highlevel( mbedTlsCode ) : pNoHighLevelMbedTlsCodeStr
+
+/**
+ * @brief Utility for converting the level-level code in an mbedTLS error to string,
+ * if the code-contains a level-level code; otherwise, using a default string.
+ */
+#define mbedtlsLowLevelCodeOrDefault( mbedTlsCode )        \
+    ( mbedtls_strerror_lowlevel( mbedTlsCode ) != NULL ) ? \
+    mbedtls_strerror_lowlevel( mbedTlsCode ) : pNoLowLevelMbedTlsCodeStr
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Initialize the mbed TLS structures in a network connection.
+ *
+ * @param[in] pSslContext The SSL context to initialize.
+ */
+static void sslContextInit( SSLContext_t * pSslContext );
+
+/**
+ * @brief Free the mbed TLS structures in a network connection.
+ *
+ * @param[in] pSslContext The SSL context to free.
+ */
+static void sslContextFree( SSLContext_t * pSslContext );
+
+/**
+ * @brief Add X509 certificate to the trusted list of root certificates.
+ *
+ * OpenSSL does not provide a single function for reading and loading certificates
+ * from files into stores, so the file API must be called. Start with the
+ * root certificate.
+ *
+ * @param[out] pSslContext SSL context to which the trusted server root CA is to be added.
+ * @param[in] pRootCa PEM-encoded string of the trusted server root CA.
+ * @param[in] rootCaSize Size of the trusted server root CA.
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+static int32_t setRootCa( SSLContext_t * pSslContext,
+                          const uint8_t * pRootCa,
+                          size_t rootCaSize );
+
+/**
+ * @brief Set X509 certificate as client certificate for the server to authenticate.
+ *
+ * @param[out] pSslContext SSL context to which the client certificate is to be set.
+ * @param[in] pClientCert PEM-encoded string of the client certificate.
+ * @param[in] clientCertSize Size of the client certificate.
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+static int32_t setClientCertificate( SSLContext_t * pSslContext,
+                                     const uint8_t * pClientCert,
+                                     size_t clientCertSize );
+
+/**
+ * @brief Set private key for the client's certificate.
+ *
+ * @param[out] pSslContext SSL context to which the private key is to be set.
+ * @param[in] pPrivateKey PEM-encoded string of the client private key.
+ * @param[in] privateKeySize Size of the client private key.
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+static int32_t setPrivateKey( SSLContext_t * pSslContext,
+                              const uint8_t * pPrivateKey,
+                              size_t privateKeySize );
+
+/**
+ * @brief Passes TLS credentials to the OpenSSL library.
+ *
+ * Provides the root CA certificate, client certificate, and private key to the
+ * OpenSSL library. If the client certificate or private key is not NULL, mutual
+ * authentication is used when performing the TLS handshake.
+ *
+ * @param[out] pSslContext SSL context to which the credentials are to be imported.
+ * @param[in] pNetworkCredentials TLS credentials to be imported.
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+static int32_t setCredentials( SSLContext_t * pSslContext,
+                               const NetworkCredentials_t * pNetworkCredentials );
+
+/**
+ * @brief Set optional configurations for the TLS connection.
+ *
+ * This function is used to set SNI and ALPN protocols.
+ *
+ * @param[in] pSslContext SSL context to which the optional configurations are to be set.
+ * @param[in] pHostName Remote host name, used for server name indication.
+ * @param[in] pNetworkCredentials TLS setup parameters.
+ */
+static void setOptionalConfigurations( SSLContext_t * pSslContext,
+                                       const char * pHostName,
+                                       const NetworkCredentials_t * pNetworkCredentials );
+
+/**
+ * @brief Setup TLS by initializing contexts and setting configurations.
+ *
+ * @param[in] pNetworkContext Network context.
+ * @param[in] pHostName Remote host name, used for server name indication.
+ * @param[in] pNetworkCredentials TLS setup parameters.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INSUFFICIENT_MEMORY, #TLS_TRANSPORT_INVALID_CREDENTIALS,
+ * or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
+                                      const char * pHostName,
+                                      const NetworkCredentials_t * pNetworkCredentials );
+
+/**
+ * @brief Perform the TLS handshake on a TCP connection.
+ *
+ * @param[in] pNetworkContext Network context.
+ * @param[in] pNetworkCredentials TLS setup parameters.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_HANDSHAKE_FAILED, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
+                                          const NetworkCredentials_t * pNetworkCredentials );
+
+/**
+ * @brief Initialize mbedTLS.
+ *
+ * @param[out] entropyContext mbed TLS entropy context for generation of random numbers.
+ * @param[out] ctrDrgbContext mbed TLS CTR DRBG context for generation of random numbers.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyContext,
+                                         mbedtls_ctr_drbg_context * pCtrDrgbContext );
+
+#ifdef MBEDTLS_DEBUG_C
+    /* Used to print mbedTLS log output. */
+    static void vTLSDebugPrint( void *ctx, int level, const char *file, int line, const char *str );
+#endif
+
+/*-----------------------------------------------------------*/
+
+static void sslContextInit( SSLContext_t * pSslContext )
+{
+    configASSERT( pSslContext != NULL );
+
+    mbedtls_ssl_config_init( &( pSslContext->config ) );
+    mbedtls_x509_crt_init( &( pSslContext->rootCa ) );
+    mbedtls_pk_init( &( pSslContext->privKey ) );
+    mbedtls_x509_crt_init( &( pSslContext->clientCert ) );
+    mbedtls_ssl_init( &( pSslContext->context ) );
+
+#ifdef MBEDTLS_DEBUG_C
+    mbedtls_ssl_conf_dbg( &( pSslContext->config ), vTLSDebugPrint, NULL );
+
+    /* mbedTLS formats its debug messages before passing them to
+     * vTLSDebugPrint(), so only enable them while the debug messages of the
+     * TLS module are enabled.  The runtime level is read when a connection is
+     * set up. */
+    mbedtls_debug_set_threshold( ( ucLoggingModuleLevels[ eLogModuleTls ] >= LOG_DEBUG ) ? MBEDTLS_DEBUG_THRESHOLD : 0 );
+#endif
+
+    /* Prevent compiler warnings when LogDebug() is defined away. */
+    ( void ) pNoLowLevelMbedTlsCodeStr;
+    ( void ) pNoHighLevelMbedTlsCodeStr;
+}
+/*-----------------------------------------------------------*/
+
+static void sslContextFree( SSLContext_t * pSslContext )
+{
+    configASSERT( pSslContext != NULL );
+
+    mbedtls_ssl_free( &( pSslContext->context ) );
+    mbedtls_x509_crt_free( &( pSslContext->rootCa ) );
+    mbedtls_x509_crt_free( &( pSslContext->clientCert ) );
+    mbedtls_pk_free( &( pSslContext->privKey ) );
+    mbedtls_entropy_free( &( pSslContext->entropyContext ) );
+    mbedtls_ctr_drbg_free( &( pSslContext->ctrDrgbContext ) );
+    mbedtls_ssl_config_free( &( pSslContext->config ) );
+}
+/*-----------------------------------------------------------*/
+
+static int32_t setRootCa( SSLContext_t * pSslContext,
+                          const uint8_t * pRootCa,
+                          size_t rootCaSize )
+{
+    int32_t mbedtlsError = -1;
+
+    configASSERT( pSslContext != NULL );
+    configASSERT( pRootCa != NULL );
+
+    /* Parse the server root CA certificate into the SSL context. */
+    mbedtlsError = mbedtls_x509_crt_parse( &( pSslContext->rootCa ),
+                                           pRootCa,
+                                           rootCaSize );
+
+    if( mbedtlsError != 0 )
+    {
+        LogError( ( "Failed to parse server root CA certificate: mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+    }
+    else
+    {
+        mbedtls_ssl_conf_ca_chain( &( pSslContext->config ),
+                                   &( pSslContext->rootCa ),
+                                   NULL );
+    }
+
+    return mbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t setClientCertificate( SSLContext_t * pSslContext,
+                                     const uint8_t * pClientCert,
+                                     size_t clientCertSize )
+{
+    int32_t mbedtlsError = -1;
+
+    configASSERT( pSslContext != NULL );
+    configASSERT( pClientCert != NULL );
+
+    /* Setup the client certificate. */
+    mbedtlsError = mbedtls_x509_crt_parse( &( pSslContext->clientCert ),
+                                           pClientCert,
+                                           clientCertSize );
+
+    if( mbedtlsError != 0 )
+    {
+        LogError( ( "Failed to parse the client certificate: mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+    }
+
+    return mbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t setPrivateKey( SSLContext_t * pSslContext,
+                              const uint8_t * pPrivateKeyPath,
+                              size_t privateKeySize )
+{
+    int32_t mbedtlsError = -1;
+
+    configASSERT( pSslContext != NULL );
+    configASSERT( pPrivateKeyPath != NULL );
+
+    /* Setup the client private key. */
+    mbedtlsError = mbedtls_pk_parse_key( &( pSslContext->privKey ),
+                                         pPrivateKeyPath,
+                                         privateKeySize,
+                                         NULL,
+                                         0 );
+
+    if( mbedtlsError != 0 )
+    {
+        LogError( ( "Failed to parse the client key: mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+    }
+
+    return mbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t setCredentials( SSLContext_t * pSslContext,
+                               const NetworkCredentials_t * pNetworkCredentials )
+{
+    int32_t mbedtlsError = -1;
+
+    configASSERT( pSslContext != NULL );
+    configASSERT( pNetworkCredentials != NULL );
+
+    /* Set up the certificate security profile, starting from the default value. */
+    pSslContext->certProfile = mbedtls_x509_crt_profile_default;
+
+    /* Set SSL authmode and the RNG context. */
+    mbedtls_ssl_conf_authmode( &( pSslContext->config ),
+                               MBEDTLS_SSL_VERIFY_REQUIRED );
+    mbedtls_ssl_conf_rng( &( pSslContext->config ),
+                          mbedtls_ctr_drbg_random,
+                          &( pSslContext->ctrDrgbContext ) );
+    mbedtls_ssl_conf_cert_profile( &( pSslContext->config ),
+                                   &( pSslContext->certProfile ) );
+
+    mbedtlsError = setRootCa( pSslContext,
+                              pNetworkCredentials->pRootCa,
+                              pNetworkCredentials->rootCaSize );
+
+    if( ( pNetworkCredentials->pClientCert != NULL ) &&
+        ( pNetworkCredentials->pPrivateKey != NULL ) )
+    {
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = setClientCertificate( pSslContext,
+                                                 pNetworkCredentials->pClientCert,
+                                                 pNetworkCredentials->clientCertSize );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = setPrivateKey( pSslContext,
+                                          pNetworkCredentials->pPrivateKey,
+                                          pNetworkCredentials->privateKeySize );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_ssl_conf_own_cert( &( pSslContext->config ),
+                                                      &( pSslContext->clientCert ),
+                                                      &( pSslContext->privKey ) );
+        }
+    }
+
+    return mbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
+static void setOptionalConfigurations( SSLContext_t * pSslContext,
+                                       const char * pHostName,
+                                       const NetworkCredentials_t * pNetworkCredentials )
+{
+    int32_t mbedtlsError = -1;
+
+    configASSERT( pSslContext != NULL );
+    configASSERT( pHostName != NULL );
+    configASSERT( pNetworkCredentials != NULL );
+
+    if( pNetworkCredentials->pAlpnProtos != NULL )
+    {
+        /* Include an application protocol list in the TLS ClientHello
+         * message. */
+        mbedtlsError = mbedtls_ssl_conf_alpn_protocols( &( pSslContext->config ),
+                                                        pNetworkCredentials->pAlpnProtos );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to configure ALPN protocol in mbed TLS: mbedTLSError= %s : %s.",
+                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        }
+    }
+
+    /* Enable SNI if requested. */
+    if( pNetworkCredentials->disableSni == pdFALSE )
+    {
+        mbedtlsError = mbedtls_ssl_set_hostname( &( pSslContext->context ),
+                                                 pHostName );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to set server name: mbedTLSError= %s : %s.",
+                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        }
+    }
+
+    /* Set Maximum Fragment Length if enabled. */
+    #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+
+        /* Enable the max fragment extension. 4096 bytes is currently the largest fragment size permitted.
+         * See RFC 8449 https://tools.ietf.org/html/rfc8449 for more information.
+         *
+         * Smaller values can be found in "mbedtls/include/ssl.h".
+         */
+        mbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pSslContext->config ), MBEDTLS_SSL_MAX_FRAG_LEN_4096 );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to maximum fragment length extension: mbedTLSError= %s : %s.",
+                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        }
+    #endif /* ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
+                                      const char * pHostName,
+                                      const NetworkCredentials_t * pNetworkCredentials )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    int32_t mbedtlsError = 0;
+
+    configASSERT( pNetworkContext != NULL );
+    configASSERT( pHostName != NULL );
+    configASSERT( pNetworkCredentials != NULL );
+    configASSERT( pNetworkCredentials->pRootCa != NULL );
+
+    /* Initialize the mbed TLS context structures. */
+    sslContextInit( &( pNetworkContext->sslContext ) );
+
+    mbedtlsError = mbedtls_ssl_config_defaults( &( pNetworkContext->sslContext.config ),
+                                                MBEDTLS_SSL_IS_CLIENT,
+                                                MBEDTLS_SSL_TRANSPORT_STREAM,
+                                                MBEDTLS_SSL_PRESET_DEFAULT );
+
+    if( mbedtlsError != 0 )
+    {
+        LogError( ( "Failed to set default SSL configuration: mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+
+        /* Per mbed TLS docs, mbedtls_ssl_config_defaults only fails on memory allocation. */
+        returnStatus = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+    }
+
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        mbedtlsError = setCredentials( &( pNetworkContext->sslContext ),
+                                       pNetworkCredentials );
+
+        if( mbedtlsError != 0 )
+        {
+            returnStatus = TLS_TRANSPORT_INVALID_CREDENTIALS;
+        }
+        else
+        {
+            /* Optionally set SNI and ALPN protocols. */
+            setOptionalConfigurations( &( pNetworkContext->sslContext ),
+                                       pHostName,
+                                       pNetworkCredentials );
+        }
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
+                                          const NetworkCredentials_t * pNetworkCredentials )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    int32_t mbedtlsError = 0;
+
+    configASSERT( pNetworkContext != NULL );
+    configASSERT( pNetworkCredentials != NULL );
+
+    /* Initialize the mbed TLS secured connection context. */
+    mbedtlsError = mbedtls_ssl_setup( &( pNetworkContext->sslContext.context ),
+                                      &( pNetworkContext->sslContext.config ) );
+
+    if( mbedtlsError != 0 )
+    {
+        LogError( ( "Failed to set up mbed TLS SSL context: mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+
+        returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+    }
+    else
+    {
+        /* Set the underlying IO for the TLS connection.  The callbacks are
+         * passed a pointer to the socket descriptor, as a descriptor can be
+         * 0. */
+        mbedtls_ssl_set_bio( &( pNetworkContext->sslContext.context ),
+                             &( pNetworkContext->tcpSocket ),
+                             mbedtls_platform_send,
+                             mbedtls_platform_recv,
+                             NULL );
+    }
+
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        /* Perform the TLS handshake, waiting for the socket whenever the
+         * handshake cannot progress.  A wait that times out ends the
+         * handshake with the WANT_READ or WANT_WRITE error. */
+        do
+        {
+            mbedtlsError = mbedtls_ssl_handshake( &( pNetworkContext->sslContext.context ) );
+        } while( ( ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) &&
+                   ( Sockets_Wait( pNetworkContext->tcpSocket, POLLIN, pNetworkContext->receiveTimeout ) != pdFALSE ) ) ||
+                 ( ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) &&
+                   ( Sockets_Wait( pNetworkContext->tcpSocket, POLLOUT, pNetworkContext->sendTimeout ) != pdFALSE ) ) );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to perform TLS handshake: mbedTLSError= %s : %s.",
+                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+
+            returnStatus = TLS_TRANSPORT_HANDSHAKE_FAILED;
+        }
+        else
+        {
+            LogInfo( ( "(Network connection %p) TLS handshake successful.",
+                       pNetworkContext ) );
+        }
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyContext,
+                                         mbedtls_ctr_drbg_context * pCtrDrgbContext )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    int32_t mbedtlsError = 0;
+
+    /* Set the mutex functions for mbed TLS thread safety. */
+    mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
+                               mbedtls_platform_mutex_free,
+                               mbedtls_platform_mutex_lock,
+                               mbedtls_platform_mutex_unlock );
+
+    /* Initialize contexts for random number generation. */
+    mbedtls_entropy_init( pEntropyContext );
+    mbedtls_ctr_drbg_init( pCtrDrgbContext );
+
+    /* Add a strong entropy source. At least one is required. */
+    mbedtlsError = mbedtls_entropy_add_source( pEntropyContext,
+                                               mbedtls_platform_entropy_poll,
+                                               NULL,
+                                               32,
+                                               MBEDTLS_ENTROPY_SOURCE_STRONG );
+
+    if( mbedtlsError != 0 )
+    {
+        LogError( ( "Failed to add entropy source: mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+    }
+
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        /* Seed the random number generator. */
+        mbedtlsError = mbedtls_ctr_drbg_seed( pCtrDrgbContext,
+                                              mbedtls_entropy_func,
+                                              pEntropyContext,
+                                              NULL,
+                                              0 );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to seed PRNG: mbedTLSError= %s : %s.",
+                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
+                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+    }
+
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        LogDebug( ( "Successfully initialized mbedTLS." ) );
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
+                                           const char * pHostName,
+                                           uint16_t port,
+                                           const NetworkCredentials_t * pNetworkCredentials,
+                                           uint32_t receiveTimeoutMs,
+                                           uint32_t sendTimeoutMs )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    BaseType_t socketStatus = 0;
+
+    if( ( pNetworkContext == NULL ) ||
+        ( pHostName == NULL ) ||
+        ( pNetworkCredentials == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pNetworkContext=%p, "
+                    "pHostName=%p, pNetworkCredentials=%p.",
+                    pNetworkContext,
+                    pHostName,
+                    pNetworkCredentials ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( ( pNetworkCredentials->pRootCa == NULL ) )
+    {
+        LogError( ( "pRootCa cannot be NULL." ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        pNetworkContext->tcpSocket = SOCKETS_INVALID_SOCKET;
+        pNetworkContext->receiveTimeout = pdMS_TO_TICKS( receiveTimeoutMs );
+        pNetworkContext->sendTimeout = pdMS_TO_TICKS( sendTimeoutMs );
+    }
+
+    /* Establish a TCP connection with the server. */
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        socketStatus = Sockets_Connect( &( pNetworkContext->tcpSocket ),
+                                        pHostName,
+                                        port,
+                                        receiveTimeoutMs );
+
+        if( socketStatus != 0 )
+        {
+            LogError( ( "Failed to connect to %s with error %d.",
+                        pHostName,
+                        ( int ) socketStatus ) );
+            returnStatus = TLS_TRANSPORT_CONNECT_FAILURE;
+        }
+    }
+
+    /* Initialize mbedtls. */
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        returnStatus = initMbedtls( &( pNetworkContext->sslContext.entropyContext ),
+                                    &( pNetworkContext->sslContext.ctrDrgbContext ) );
+    }
+
+    /* Initialize TLS contexts and set credentials. */
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        returnStatus = tlsSetup( pNetworkContext, pHostName, pNetworkCredentials );
+    }
+
+    /* Perform TLS handshake. */
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        returnStatus = tlsHandshake( pNetworkContext, pNetworkCredentials );
+    }
+
+    /* Clean up on failure. */
+    if( returnStatus != TLS_TRANSPORT_SUCCESS )
+    {
+        /* The network context is only initialized if the parameters are
+         * valid. */
+        if( returnStatus != TLS_TRANSPORT_INVALID_PARAMETER )
+        {
+            sslContextFree( &( pNetworkContext->sslContext ) );
+
+            if( pNetworkContext->tcpSocket != SOCKETS_INVALID_SOCKET )
+            {
+                Sockets_Disconnect( pNetworkContext->tcpSocket );
+            }
+        }
+    }
+    else
+    {
+        LogInfo( ( "(Network connection %p) Connection to %s established.",
+                   pNetworkContext,
+                   pHostName ) );
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+void TLS_FreeRTOS_Disconnect( NetworkContext_t * pNetworkContext )
+{
+    BaseType_t tlsStatus = 0;
+
+    if( pNetworkContext != NULL )
+    {
+        /* Attempting to terminate TLS connection. */
+        tlsStatus = ( BaseType_t ) mbedtls_ssl_close_notify( &( pNetworkContext->sslContext.context ) );
+
+        /* Ignore the WANT_READ and WANT_WRITE return values. */
+        if( ( tlsStatus != ( BaseType_t ) MBEDTLS_ERR_SSL_WANT_READ ) &&
+            ( tlsStatus != ( BaseType_t ) MBEDTLS_ERR_SSL_WANT_WRITE ) )
+        {
+            if( tlsStatus == 0 )
+            {
+                LogInfo( ( "(Network connection %p) TLS close-notify sent.",
+                           pNetworkContext ) );
+            }
+            else
+            {
+                LogError( ( "(Network connection %p) Failed to send TLS close-notify: mbedTLSError= %s : %s.",
+                            pNetworkContext,
+                            mbedtlsHighLevelCodeOrDefault( tlsStatus ),
+                            mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+            }
+        }
+        else
+        {
+            /* WANT_READ and WANT_WRITE can be ignored. Logging for debugging purposes. */
+#ifdef _RB_
+            LogInfo( ( "(Network connection %p) TLS close-notify sent; ",
+                       "received %s as the TLS status can be ignored for close-notify."
+                       ( tlsStatus == MBEDTLS_ERR_SSL_WANT_READ ) ? "WANT_READ" : "WANT_WRITE",
+                       pNetworkContext ) );
+#endif
+        }
+
+        /* Call socket shutdown function to close connection. */
+        Sockets_Disconnect( pNetworkContext->tcpSocket );
+
+        /* Free mbed TLS contexts. */
+        sslContextFree( &( pNetworkContext->sslContext ) );
+    }
+
+    /* Clear the mutex functions for mbed TLS thread safety. */
+    mbedtls_threading_free_alt();
+}
+/*-----------------------------------------------------------*/
+
+int32_t TLS_FreeRTOS_recv( NetworkContext_t * pNetworkContext,
+                           void * pBuffer,
+                           size_t bytesToRecv )
+{
+    int32_t tlsStatus = 0;
+
+    /* As in the plain text transport, a read of more than 1 byte is likely
+     * part way through a frame so waits up to the receive timeout for the
+     * bytes to arrive, unless mbedTLS already holds them. */
+    if( ( bytesToRecv > 1U ) &&
+        ( mbedtls_ssl_get_bytes_avail( &( pNetworkContext->sslContext.context ) ) == 0U ) &&
+        ( mbedtls_ssl_check_pending( &( pNetworkContext->sslContext.context ) ) == 0 ) )
+    {
+        ( void ) Sockets_Wait( pNetworkContext->tcpSocket, POLLIN, pNetworkContext->receiveTimeout );
+    }
+
+    tlsStatus = ( int32_t ) mbedtls_ssl_read( &( pNetworkContext->sslContext.context ),
+                                              pBuffer,
+                                              bytesToRecv );
+
+    if( ( tlsStatus == MBEDTLS_ERR_SSL_TIMEOUT ) ||
+        ( tlsStatus == MBEDTLS_ERR_SSL_WANT_READ ) ||
+        ( tlsStatus == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+    {
+        LogDebug( ( "Failed to read data. However, a read can be retried on this error. "
+                    "mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( tlsStatus ),
+                    mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+
+        /* Mark these set of errors as a timeout. The libraries may retry read
+         * on these errors. */
+        tlsStatus = 0;
+    }
+    else if( tlsStatus < 0 )
+    {
+        LogError( ( "Failed to read data: mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( tlsStatus ),
+                    mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return tlsStatus;
+}
+/*-----------------------------------------------------------*/
+
+int32_t TLS_FreeRTOS_send( NetworkContext_t * pNetworkContext,
+                           const void * pBuffer,
+                           size_t bytesToSend )
+{
+    int32_t tlsStatus = 0;
+
+    /* Wait for space in the socket send buffer, which the write would
+     * otherwise report as MBEDTLS_ERR_SSL_WANT_WRITE. */
+    ( void ) Sockets_Wait( pNetworkContext->tcpSocket, POLLOUT, pNetworkContext->sendTimeout );
+
+    tlsStatus = ( int32_t ) mbedtls_ssl_write( &( pNetworkContext->sslContext.context ),
+                                               pBuffer,
+                                               bytesToSend );
+
+    if( ( tlsStatus == MBEDTLS_ERR_SSL_TIMEOUT ) ||
+        ( tlsStatus == MBEDTLS_ERR_SSL_WANT_READ ) ||
+        ( tlsStatus == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+    {
+        LogDebug( ( "Failed to send data. However, send can be retried on this error. "
+                    "mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( tlsStatus ),
+                    mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+
+        /* Mark these set of errors as a timeout. The libraries may retry send
+         * on these errors. */
+        tlsStatus = 0;
+    }
+    else if( tlsStatus < 0 )
+    {
+        LogError( ( "Failed to send data:  mbedTLSError= %s : %s.",
+                    mbedtlsHighLevelCodeOrDefault( tlsStatus ),
+                    mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return tlsStatus;
+}
+/*-----------------------------------------------------------*/
+
+#ifdef MBEDTLS_DEBUG_C
+    static void vTLSDebugPrint( void *ctx, int level, const char *file, int line, const char *str )
+    {
+        const char *p, *basename;
+        (void) ctx;
+        ( void ) line;
+        ( void ) level;
+        ( void ) str;
+
+        /* Extract basename from file */
+        for( p = basename = file; *p != '\0'; p++ )
+        {
+            if( *p == '/' || *p == '\\')
+            {
+                basename = p + 1;
+            }
+        }
+
+        LogDebug( ( "%s:%04d: |%d| %s", basename, line, level, str ) );
+    }
+#endif
+
+
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleTransport
+
+/* Standard includes. */
+#include <string.h>
+#include <errno.h>
+
+/* POSIX includes. */
+#include <poll.h>
+#include <sys/socket.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Socket wrapper include. */
+#include "sockets_wrapper.h"
+
+/* Transport interface include. */
+#include "using_plaintext.h"
+
+/**
+ * @brief Translate the result of recv() or send() to the return value of the
+ * transport interface.
+ *
+ * @param[in] socketStatus The value returned by recv() or send().
+ *
+ * @return socketStatus if it is positive, 0 if the call would have blocked or
+ * was interrupted, else a negative value.
+ */
+static int32_t transportStatus( ssize_t socketStatus );
+
+static int32_t transportStatus( ssize_t socketStatus )
+{
+    int32_t status;
+
+    if( socketStatus > 0 )
+    {
+        status = ( int32_t ) socketStatus;
+    }
+    else if( ( socketStatus < 0 ) &&
+             ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) || ( errno == EINTR ) ) )
+    {
+        /* The signals used by the POSIX port to switch tasks can interrupt
+         * the call, which is not an error. */
+        status = 0;
+    }
+    else if( socketStatus == 0 )
+    {
+        /* recv() returns 0 when the peer closed the connection, which must be
+         * reported as an error so the application reconnects. */
+        LogDebug( ( "Connection closed by the peer." ) );
+        status = -1;
+    }
+    else
+    {
+        LogDebug( ( "Socket error: errno=%d.", errno ) );
+        status = -1;
+    }
+
+    return status;
+}
+
+PlaintextTransportStatus_t Plaintext_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
+                                                       const char * pHostName,
+                                                       uint16_t port,
+                                                       uint32_t receiveTimeoutMs,
+                                                       uint32_t sendTimeoutMs )
+{
+    PlaintextTransportStatus_t plaintextStatus = PLAINTEXT_TRANSPORT_SUCCESS;
+    BaseType_t socketStatus = 0;
+
+    if( ( pNetworkContext == NULL ) || ( pHostName == NULL ) )
+    {
+        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pNetworkContext=%p, "
+                    "pHostName=%p.",
+                    pNetworkContext,
+                    pHostName ) );
+        plaintextStatus = PLAINTEXT_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        pNetworkContext->tcpSocket = SOCKETS_INVALID_SOCKET;
+        pNetworkContext->receiveTimeout = pdMS_TO_TICKS( receiveTimeoutMs );
+        pNetworkContext->sendTimeout = pdMS_TO_TICKS( sendTimeoutMs );
+
+        /* Establish a TCP connection with the server. */
+        socketStatus = Sockets_Connect( &( pNetworkContext->tcpSocket ),
+                                        pHostName,
+                                        port,
+                                        receiveTimeoutMs );
+
+        /* A non zero status is an error. */
+        if( socketStatus != 0 )
+        {
+            LogError( ( "Failed to connect to %s with error %d.",
+                        pHostName,
+                        ( int ) socketStatus ) );
+            plaintextStatus = PLAINTEXT_TRANSPORT_CONNECT_FAILURE;
+        }
+    }
+
+    return plaintextStatus;
+}
+
+PlaintextTransportStatus_t Plaintext_FreeRTOS_Disconnect( const NetworkContext_t * pNetworkContext )
+{
+    PlaintextTransportStatus_t plaintextStatus = PLAINTEXT_TRANSPORT_SUCCESS;
+
+    if( pNetworkContext == NULL )
+    {
+        LogError( ( "pNetworkContext cannot be NULL." ) );
+        plaintextStatus = PLAINTEXT_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( pNetworkContext->tcpSocket == SOCKETS_INVALID_SOCKET )
+    {
+        LogError( ( "pNetworkContext->tcpSocket cannot be an invalid socket." ) );
+        plaintextStatus = PLAINTEXT_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* Call socket disconnect function to close connection. */
+        Sockets_Disconnect( pNetworkContext->tcpSocket );
+    }
+
+    return plaintextStatus;
+}
+
+int32_t Plaintext_FreeRTOS_recv( NetworkContext_t * pNetworkContext,
+                                 void * pBuffer,
+                                 size_t bytesToRecv )
+{
+    int32_t socketStatus = 0;
+
+    /* As in the FreeRTOS+TCP transport, a read of more than 1 byte is likely
+     * part way through a frame so waits up to the receive timeout for the
+     * bytes to arrive, whereas a read of 1 byte may be a speculative read for
+     * the start of a new frame so does not wait. */
+    if( ( bytesToRecv == 1U ) ||
+        ( Sockets_Wait( pNetworkContext->tcpSocket, POLLIN, pNetworkContext->receiveTimeout ) != pdFALSE ) )
+    {
+        socketStatus = transportStatus( recv( pNetworkContext->tcpSocket, pBuffer, bytesToRecv, MSG_DONTWAIT ) );
+    }
+
+    return socketStatus;
+}
+
+int32_t Plaintext_FreeRTOS_send( NetworkContext_t * pNetworkContext,
+                                 const void * pBuffer,
+                                 size_t bytesToSend )
+{
+    int32_t socketStatus = 0;
+
+    /* MSG_NOSIGNAL reports a connection closed by the peer as an error
+     * instead of raising SIGPIPE. */
+    if( Sockets_Wait( pNetworkContext->tcpSocket, POLLOUT, pNetworkContext->sendTimeout ) != pdFALSE )
+    {
+        socketStatus = transportStatus( send( pNetworkContext->tcpSocket, pBuffer, bytesToSend, MSG_DONTWAIT | MSG_NOSIGNAL ) );
+    }
+
+    /* Zero bytes sent because the socket send buffer is full is not
+     * necessarily an error that should cause a disconnect unless it
+     * persists. */
+    return socketStatus;
+}
@@ -27,17 +27,34 @@
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
-#include "FreeRTOS_Sockets.h"
+
+/* The Linux build defines democonfigUSE_POSIX_SOCKETS in FreeRTOSConfig.h to
+ * use the sockets of the host instead of FreeRTOS+TCP. */
+#if defined( democonfigUSE_POSIX_SOCKETS ) && ( democonfigUSE_POSIX_SOCKETS == 1 )
+    #include <errno.h>
+    #include <sys/socket.h>
+#else
+    #include "FreeRTOS_Sockets.h"
+#endif
+
+/* Heap accounting include. */
+#include "heap_tags.h"
 
 /* mbed TLS includes. */
 #include "mbedtls_config.h"
 #include "threading_alt.h"
 #include "mbedtls/entropy.h"
 
+#if defined( democonfigUSE_POSIX_SOCKETS ) && ( democonfigUSE_POSIX_SOCKETS == 1 )
+    #include "mbedtls/net_sockets.h"
+    #include "mbedtls/ssl.h"
+#endif
+
 /*-----------------------------------------------------------*/
 
 /**
- * @brief Allocates memory for an array of members.
+ * @brief Allocates memory for an array of members.  The memory is accounted to
+ * the TLS heap tag.
  *
  * @param[in] nmemb Number of members that need to be allocated.
  * @param[in] size Size of each member.
@@ -56,7 +73,7 @@ void * mbedtls_platform_calloc( size_t nmemb,
         /* Overflow check. */
         if( ( totalSize / size ) == nmemb )
         {
-            pBuffer = pvPortMalloc( totalSize );
+            pBuffer = heaptagsMALLOC( eHeapTagTls, totalSize );
 
             if( pBuffer != NULL )
             {
@@ -77,11 +94,104 @@ void * mbedtls_platform_calloc( size_t nmemb,
  */
 void mbedtls_platform_free( void * ptr )
 {
-    vPortFree( ptr );
+    heaptagsFREE( ptr );
 }
 
 /*-----------------------------------------------------------*/
 
+#if defined( democonfigUSE_POSIX_SOCKETS ) && ( democonfigUSE_POSIX_SOCKETS == 1 )
+
+/**
+ * @brief Sends data over a non-blocking BSD socket.
+ *
+ * @param[in] ctx Pointer to the socket descriptor.
+ * @param[in] buf Buffer containing the bytes to send.
+ * @param[in] len Number of bytes to send from the buffer.
+ *
+ * @return Number of bytes sent on success; MBEDTLS_ERR_SSL_WANT_WRITE if the
+ * socket send buffer is full; else a negative value.
+ */
+    int mbedtls_platform_send( void * ctx,
+                               const unsigned char * buf,
+                               size_t len )
+    {
+        ssize_t bytesSent;
+        int status;
+
+        configASSERT( ctx != NULL );
+        configASSERT( buf != NULL );
+
+        /* MSG_NOSIGNAL reports a connection closed by the peer as an error
+         * instead of raising SIGPIPE. */
+        bytesSent = send( *( const int * ) ctx, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL );
+
+        if( bytesSent >= 0 )
+        {
+            status = ( int ) bytesSent;
+        }
+        else if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) || ( errno == EINTR ) )
+        {
+            status = MBEDTLS_ERR_SSL_WANT_WRITE;
+        }
+        else if( ( errno == EPIPE ) || ( errno == ECONNRESET ) )
+        {
+            status = MBEDTLS_ERR_NET_CONN_RESET;
+        }
+        else
+        {
+            status = MBEDTLS_ERR_NET_SEND_FAILED;
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Receives data from a non-blocking BSD socket.
+ *
+ * @param[in] ctx Pointer to the socket descriptor.
+ * @param[out] buf Buffer to receive bytes into.
+ * @param[in] len Number of bytes to receive from the network.
+ *
+ * @return Number of bytes received if successful; 0 if the connection was
+ * closed by the peer; MBEDTLS_ERR_SSL_WANT_READ if no data is available; else
+ * a negative value.
+ */
+    int mbedtls_platform_recv( void * ctx,
+                               unsigned char * buf,
+                               size_t len )
+    {
+        ssize_t bytesReceived;
+        int status;
+
+        configASSERT( ctx != NULL );
+        configASSERT( buf != NULL );
+
+        bytesReceived = recv( *( const int * ) ctx, buf, len, MSG_DONTWAIT );
+
+        if( bytesReceived >= 0 )
+        {
+            status = ( int ) bytesReceived;
+        }
+        else if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) || ( errno == EINTR ) )
+        {
+            status = MBEDTLS_ERR_SSL_WANT_READ;
+        }
+        else if( ( errno == EPIPE ) || ( errno == ECONNRESET ) )
+        {
+            status = MBEDTLS_ERR_NET_CONN_RESET;
+        }
+        else
+        {
+            status = MBEDTLS_ERR_NET_RECV_FAILED;
+        }
+
+        return status;
+    }
+
+#else /* if defined( democonfigUSE_POSIX_SOCKETS ) && ( democonfigUSE_POSIX_SOCKETS == 1 ) */
+
 /**
  * @brief Sends data over FreeRTOS+TCP sockets.
  *
@@ -91,19 +201,19 @@ void mbedtls_platform_free( void * ptr )
  *
  * @return Number of bytes sent on success; else a negative value.
  */
-int mbedtls_platform_send( void * ctx,
-                           const unsigned char * buf,
-                           size_t len )
-{
-    Socket_t socket;
+    int mbedtls_platform_send( void * ctx,
+                               const unsigned char * buf,
+                               size_t len )
+    {
+        Socket_t socket;
 
-    configASSERT( ctx != NULL );
-    configASSERT( buf != NULL );
+        configASSERT( ctx != NULL );
+        configASSERT( buf != NULL );
 
-    socket = ( Socket_t ) ctx;
+        socket = ( Socket_t ) ctx;
 
-    return ( int ) FreeRTOS_send( socket, buf, len, 0 );
-}
+        return ( int ) FreeRTOS_send( socket, buf, len, 0 );
+    }
 
 /*-----------------------------------------------------------*/
 
@@ -116,19 +226,21 @@ int mbedtls_platform_send( void * ctx,
  *
  * @return Number of bytes received if successful; Negative value on error.
  */
-int mbedtls_platform_recv( void * ctx,
-                           unsigned char * buf,
-                           size_t len )
-{
-    Socket_t socket;
+    int mbedtls_platform_recv( void * ctx,
+                               unsigned char * buf,
+                               size_t len )
+    {
+        Socket_t socket;
 
-    configASSERT( ctx != NULL );
-    configASSERT( buf != NULL );
+        configASSERT( ctx != NULL );
+        configASSERT( buf != NULL );
 
-    socket = ( Socket_t ) ctx;
+        socket = ( Socket_t ) ctx;
 
-    return ( int ) FreeRTOS_recv( socket, buf, len, 0 );
-}
+        return ( int ) FreeRTOS_recv( socket, buf, len, 0 );
+    }
+
+#endif /* if defined( democonfigUSE_POSIX_SOCKETS ) && ( democonfigUSE_POSIX_SOCKETS == 1 ) */
 
 /*-----------------------------------------------------------*/
 
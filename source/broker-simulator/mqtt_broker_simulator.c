@@ -0,0 +1,1579 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file mqtt_broker_simulator.c
+ *
+ * @brief In-process stand-in for an MQTT 3.1.1 broker.
+ *
+ * The bytes sent by a client are decoded into packets in the context of the
+ * client's send call, or of the receive call that makes room for the response
+ * to a packet when the receive buffer of the client was full.  Each packet is
+ * stamped with the time it would reach a real broker - the time it finishes
+ * crossing the simulated uplink plus the latency - and the packets the broker
+ * sends in response are written into the receive buffer of the destination
+ * client, stamped with the time they would reach the client in the same way.
+ * A client can only receive the bytes of the packets whose time has passed.
+ * Times are read from the clock selected in clock_source.h, in microseconds so
+ * the transmission time of small packets is not rounded to a whole tick.
+ */
+
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleTransport
+
+/* Standard includes. */
+#include <stddef.h>
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "timers.h"
+
+/* Demo config. */
+#include "demo_config.h"
+#include "broker_simulator_config.h"
+
+/* Clock include. */
+#include "clock_source.h"
+
+/* Interface include. */
+#include "mqtt_broker_simulator.h"
+
+/**
+ * @brief MQTT control packet types, in the top four bits of the first byte of
+ * a packet.
+ */
+#define brokersimCONNECT                  ( 0x10U )
+#define brokersimCONNACK                  ( 0x20U )
+#define brokersimPUBLISH                  ( 0x30U )
+#define brokersimPUBACK                   ( 0x40U )
+#define brokersimPUBREC                   ( 0x50U )
+#define brokersimPUBREL                   ( 0x60U )
+#define brokersimPUBCOMP                  ( 0x70U )
+#define brokersimSUBSCRIBE                ( 0x80U )
+#define brokersimSUBACK                   ( 0x90U )
+#define brokersimUNSUBSCRIBE              ( 0xA0U )
+#define brokersimUNSUBACK                 ( 0xB0U )
+#define brokersimPINGREQ                  ( 0xC0U )
+#define brokersimPINGRESP                 ( 0xD0U )
+#define brokersimDISCONNECT               ( 0xE0U )
+
+/**
+ * @brief The flags MQTT 3.1.1 requires in the first byte of PUBREL, SUBSCRIBE
+ * and UNSUBSCRIBE packets.
+ */
+#define brokersimREQUIRED_FLAGS           ( 0x02U )
+
+/**
+ * @brief The SUBACK return code of a subscription that is refused.
+ */
+#define brokersimSUBACK_FAILURE           ( 0x80U )
+
+/**
+ * @brief The largest fixed header, a packet type byte followed by a four byte
+ * remaining length.
+ */
+#define brokersimMAX_FIXED_HEADER_SIZE    ( 5U )
+
+/**
+ * @brief The number of return codes a SUBACK can hold.  Each topic filter of a
+ * SUBSCRIBE takes at least three bytes.
+ */
+#define brokersimMAX_SUBACK_CODES         ( brokersimconfigMAX_PACKET_SIZE / 3U )
+
+#if ( brokersimconfigCONTROL_RESERVE_SIZE >= brokersimconfigRECEIVE_BUFFER_SIZE ) || ( brokersimconfigCONTROL_RESERVE_PACKETS >= brokersimconfigMAX_PENDING_PACKETS )
+    #error "The control reserve must leave room for forwarded publishes in the receive buffer and the pending packets."
+#endif
+
+/**
+ * @brief A topic filter subscribed to by a client.
+ */
+typedef struct BrokerSimulatorSubscription
+{
+    uint16_t usFilterLength; /**< 0 if the slot is free. */
+    uint8_t ucQoS;           /**< The granted QoS. */
+    char cFilter[ brokersimconfigMAX_TOPIC_FILTER_LENGTH ];
+} BrokerSimulatorSubscription_t;
+
+/**
+ * @brief A packet written into the receive buffer of a client.
+ */
+typedef struct BrokerSimulatorPacket
+{
+    uint32_t ulEnd;              /**< The value of ulWriteCount after the packet was written. */
+    uint64_t ullDeliveryTimeUs; /**< The time at which the client can receive the packet. */
+} BrokerSimulatorPacket_t;
+
+/**
+ * @brief Part of a packet sent by the broker, so the topic and payload of a
+ * publish can be copied straight from the packet being forwarded.
+ */
+typedef struct BrokerSimulatorSegment
+{
+    const uint8_t * pucData;
+    size_t xLength;
+} BrokerSimulatorSegment_t;
+
+/**
+ * @brief The state of one client connection.  The receive buffer is a ring
+ * indexed by the free running byte counts ulWriteCount and ulReadCount, and
+ * xPackets is a ring of the packets in it that the client has not finished
+ * reading.
+ */
+struct BrokerSimulatorConnection
+{
+    BaseType_t xInUse;
+    BaseType_t xConnected;      /**< A CONNECT packet has been accepted. */
+    BaseType_t xClosed;         /**< The broker closed the connection. */
+    uint16_t usNextPacketId;    /**< Identifier of the next QoS 1 or 2 publish forwarded to the client. */
+    uint64_t ullUplinkFreeUs;   /**< Time the last packet from the client finishes crossing the uplink. */
+    uint64_t ullDownlinkFreeUs; /**< Time the last packet to the client finishes crossing the downlink. */
+    size_t xAssembledLength;    /**< Bytes of incomplete packets in ucAssembly. */
+    uint8_t ucAssembly[ brokersimconfigMAX_PACKET_SIZE ];
+    uint32_t ulWriteCount;
+    uint32_t ulReadCount;
+    uint8_t ucReceiveBuffer[ brokersimconfigRECEIVE_BUFFER_SIZE ];
+    uint32_t ulFirstPacket;
+    uint32_t ulPacketCount;
+    BrokerSimulatorPacket_t xPackets[ brokersimconfigMAX_PENDING_PACKETS ];
+    BrokerSimulatorSubscription_t xSubscriptions[ brokersimconfigMAX_SUBSCRIPTIONS ];
+    BrokerSimulatorWakeupCallback_t pxWakeupCallback;
+    void * pvWakeupContext;
+    BaseType_t xWakeupPending; /**< xWakeupTimer is set to expire when the next packet is due. */
+    uint64_t ullWokenUs;       /**< The client has been woken for the packets due by this time. */
+    TimerHandle_t xWakeupTimer;
+    StaticTimer_t xWakeupTimerBuffer;
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return pdTRUE with a probability of ulPercent percent.  Uses its own
+ * xorshift generator, seeded with brokersimconfigRANDOM_SEED, so the sequence
+ * does not depend on the other users of a shared generator.
+ */
+static BaseType_t prvChance( uint32_t ulPercent );
+
+/**
+ * @brief Return the time taken to transmit xLength bytes at the simulated
+ * bandwidth.
+ */
+static uint64_t prvTransmitTimeUs( size_t xLength );
+
+/**
+ * @brief Decode the fixed header at the start of pucBuffer.
+ *
+ * @param[in] pucBuffer The received bytes.
+ * @param[in] xLength Number of bytes in pucBuffer.
+ * @param[out] pulRemainingLength The remaining length of the packet.
+ *
+ * @return The length of the fixed header; 0 if more bytes are needed to
+ * decode it; or -1 if the remaining length is malformed.
+ */
+static int32_t prvDecodeFixedHeader( const uint8_t * pucBuffer,
+                                     size_t xLength,
+                                     uint32_t * pulRemainingLength );
+
+/**
+ * @brief Encode a fixed header into pucBuffer, which must hold
+ * brokersimMAX_FIXED_HEADER_SIZE bytes.
+ *
+ * @return The length of the fixed header.
+ */
+static size_t prvEncodeFixedHeader( uint8_t * pucBuffer,
+                                    uint8_t ucFirstByte,
+                                    uint32_t ulRemainingLength );
+
+/**
+ * @brief Check that a topic filter is well formed - that wildcards occupy a
+ * whole level and '#' is the last level.
+ */
+static BaseType_t prvFilterIsValid( const char * pcFilter,
+                                    size_t xFilterLength );
+
+/**
+ * @brief Check whether a topic matches a topic filter.  A filter that starts
+ * with a wildcard does not match topics that start with '$'.
+ */
+static BaseType_t prvTopicMatches( const char * pcFilter,
+                                   size_t xFilterLength,
+                                   const char * pcTopic,
+                                   size_t xTopicLength );
+
+/**
+ * @brief Check whether a packet fits in the receive buffer of a client.
+ * Forwarded publishes cannot use the control reserve.
+ *
+ * @param[in] pxConnection The client.
+ * @param[in] xLength The length of the packet.
+ * @param[in] xIsPublish pdTRUE if the packet is a forwarded publish.
+ */
+static BaseType_t prvHasRoom( const BrokerSimulatorConnection_t * pxConnection,
+                              size_t xLength,
+                              BaseType_t xIsPublish );
+
+/**
+ * @brief Return the largest response the broker sends back to a client for a
+ * packet, or 0 if it sends none.
+ *
+ * @param[in] ucFirstByte The packet type and flags.
+ * @param[in] ulRemainingLength The remaining length of the packet.
+ */
+static size_t prvResponseLength( uint8_t ucFirstByte,
+                                 uint32_t ulRemainingLength );
+
+/**
+ * @brief Write a packet into the receive buffer of a client.
+ *
+ * @param[in] pxConnection The client.
+ * @param[in] ullSentTimeUs The time the broker sends the packet.
+ * @param[in] pxSegments The parts of the packet.
+ * @param[in] xSegmentCount The number of parts.
+ * @param[in] xIsPublish pdTRUE if the packet is a forwarded publish.
+ *
+ * @return pdPASS, or pdFAIL if the packet does not fit.
+ */
+static BaseType_t prvQueuePacket( BrokerSimulatorConnection_t * pxConnection,
+                                  uint64_t ullSentTimeUs,
+                                  const BrokerSimulatorSegment_t * pxSegments,
+                                  size_t xSegmentCount,
+                                  BaseType_t xIsPublish );
+
+/**
+ * @brief Send a four byte acknowledgement to a client.
+ */
+static void prvSendAck( BrokerSimulatorConnection_t * pxConnection,
+                        uint64_t ullSentTimeUs,
+                        uint8_t ucFirstByte,
+                        uint16_t usPacketId );
+
+/**
+ * @brief Set the wakeup timer of a client to expire when the first packet it
+ * has not been woken for is due, unless the timer is already set.
+ */
+static void prvScheduleWakeup( BrokerSimulatorConnection_t * pxConnection );
+
+/**
+ * @brief Return the number of bytes a client can receive at time ullNowUs.
+ */
+static uint32_t prvDueBytes( const BrokerSimulatorConnection_t * pxConnection,
+                             uint64_t ullNowUs );
+
+/**
+ * @brief Forward a publish to every client with a matching subscription.
+ */
+static void prvForwardPublish( uint64_t ullSentTimeUs,
+                               uint8_t ucQoS,
+                               const uint8_t * pucTopic,
+                               uint16_t usTopicLength,
+                               const uint8_t * pucPayload,
+                               size_t xPayloadLength );
+
+/**
+ * @brief Act on a packet received from a client.  The handlers return pdFAIL
+ * if the packet is malformed or unexpected, in which case the connection is
+ * closed.
+ *
+ * @param[in] pxConnection The client.
+ * @param[in] ullArrivalTimeUs The time the packet reaches the broker.
+ * @param[in] ucFirstByte The packet type and flags.
+ * @param[in] pucBody The variable header and payload of the packet.
+ * @param[in] ulBodyLength The remaining length of the packet.
+ */
+static BaseType_t prvHandlePacket( BrokerSimulatorConnection_t * pxConnection,
+                                   uint64_t ullArrivalTimeUs,
+                                   uint8_t ucFirstByte,
+                                   const uint8_t * pucBody,
+                                   uint32_t ulBodyLength );
+static BaseType_t prvHandlePublish( BrokerSimulatorConnection_t * pxConnection,
+                                    uint64_t ullArrivalTimeUs,
+                                    uint8_t ucFirstByte,
+                                    const uint8_t * pucBody,
+                                    uint32_t ulBodyLength );
+static BaseType_t prvHandleSubscribe( BrokerSimulatorConnection_t * pxConnection,
+                                      uint64_t ullArrivalTimeUs,
+                                      const uint8_t * pucBody,
+                                      uint32_t ulBodyLength );
+static BaseType_t prvHandleUnsubscribe( BrokerSimulatorConnection_t * pxConnection,
+                                        uint64_t ullArrivalTimeUs,
+                                        const uint8_t * pucBody,
+                                        uint32_t ulBodyLength );
+
+/**
+ * @brief Decode and act on the complete packets in the assembly buffer of a
+ * client, and move the bytes of the remaining packets to its start.  Stops at
+ * the first packet whose response does not fit in the receive buffer of the
+ * client.
+ *
+ * @return pdPASS, or pdFAIL if the connection is to be closed.
+ */
+static BaseType_t prvProcessAssembledPackets( BrokerSimulatorConnection_t * pxConnection );
+
+/**
+ * @brief Called by the timer service when the next packet for a client is due.
+ * Timer callbacks must not block, so if the mutex is held the timer is set to
+ * try again on the next tick.
+ */
+static void prvWakeupTimerCallback( TimerHandle_t xTimer );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The client connections.
+ */
+static BrokerSimulatorConnection_t xConnections[ brokersimconfigMAX_CONNECTIONS ];
+
+/**
+ * @brief Scratch buffer the return codes of a SUBACK are built in.
+ */
+static uint8_t ucSubackCodes[ brokersimMAX_SUBACK_CODES ];
+
+/**
+ * @brief Mutex protecting the connections, the link properties and the
+ * counters.
+ */
+static SemaphoreHandle_t xSimulatorMutex = NULL;
+
+/**
+ * @brief The simulated network properties.
+ */
+static BrokerSimulatorLink_t xLink =
+{
+    .ulLatencyMs      = brokersimconfigLATENCY_MS,
+    .ulBytesPerSecond = brokersimconfigBYTES_PER_SECOND,
+    .ulLossPercent    = brokersimconfigLOSS_PERCENT
+};
+
+/**
+ * @brief Counters returned by vBrokerSimulatorGetStats().
+ */
+static BrokerSimulatorStats_t xStats;
+
+/**
+ * @brief State of the generator used by prvChance().
+ */
+static uint32_t ulRandomState = brokersimconfigRANDOM_SEED;
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvChance( uint32_t ulPercent )
+{
+    ulRandomState ^= ulRandomState << 13;
+    ulRandomState ^= ulRandomState >> 17;
+    ulRandomState ^= ulRandomState << 5;
+
+    return ( ( ulRandomState % 100UL ) < ulPercent ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvTransmitTimeUs( size_t xLength )
+{
+    uint64_t ullTimeUs = 0;
+
+    if( xLink.ulBytesPerSecond > 0UL )
+    {
+        ullTimeUs = ( ( uint64_t ) xLength * 1000000ULL ) / xLink.ulBytesPerSecond;
+    }
+
+    return ullTimeUs;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvDecodeFixedHeader( const uint8_t * pucBuffer,
+                                     size_t xLength,
+                                     uint32_t * pulRemainingLength )
+{
+    int32_t lHeaderLength = 0;
+    uint32_t ulValue = 0, ulMultiplier = 1;
+    size_t i;
+
+    /* The remaining length is encoded in one to four bytes following the
+     * packet type, seven bits per byte, least significant first. */
+    for( i = 1; ( i < xLength ) && ( lHeaderLength == 0 ); i++ )
+    {
+        if( i > 4U )
+        {
+            lHeaderLength = -1;
+        }
+        else
+        {
+            ulValue += ( uint32_t ) ( pucBuffer[ i ] & 0x7FU ) * ulMultiplier;
+            ulMultiplier *= 128U;
+
+            if( ( pucBuffer[ i ] & 0x80U ) == 0U )
+            {
+                lHeaderLength = ( int32_t ) i + 1;
+                *pulRemainingLength = ulValue;
+            }
+        }
+    }
+
+    return lHeaderLength;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvEncodeFixedHeader( uint8_t * pucBuffer,
+                                    uint8_t ucFirstByte,
+                                    uint32_t ulRemainingLength )
+{
+    size_t xLength = 1;
+
+    pucBuffer[ 0 ] = ucFirstByte;
+
+    do
+    {
+        pucBuffer[ xLength ] = ( uint8_t ) ( ulRemainingLength & 0x7FU );
+        ulRemainingLength >>= 7;
+
+        if( ulRemainingLength > 0U )
+        {
+            pucBuffer[ xLength ] |= 0x80U;
+        }
+
+        xLength++;
+    } while( ulRemainingLength > 0U );
+
+    return xLength;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvFilterIsValid( const char * pcFilter,
+                                    size_t xFilterLength )
+{
+    BaseType_t xValid = ( xFilterLength > 0U ) ? pdTRUE : pdFALSE;
+    size_t i;
+
+    for( i = 0; ( i < xFilterLength ) && ( xValid == pdTRUE ); i++ )
+    {
+        if( ( pcFilter[ i ] == '+' ) || ( pcFilter[ i ] == '#' ) )
+        {
+            /* A wildcard must be the whole of its level, and '#' must be the
+             * last level. */
+            if( ( ( i > 0U ) && ( pcFilter[ i - 1U ] != '/' ) ) ||
+                ( ( i + 1U < xFilterLength ) && ( pcFilter[ i + 1U ] != '/' ) ) ||
+                ( ( pcFilter[ i ] == '#' ) && ( i + 1U != xFilterLength ) ) )
+            {
+                xValid = pdFALSE;
+            }
+        }
+    }
+
+    return xValid;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvTopicMatches( const char * pcFilter,
+                                   size_t xFilterLength,
+                                   const char * pcTopic,
+                                   size_t xTopicLength )
+{
+    BaseType_t xMatch = pdFALSE, xDone = pdFALSE;
+    size_t xFilterIndex = 0, xTopicIndex = 0;
+
+    if( ( xTopicLength > 0U ) && ( pcTopic[ 0 ] == '$' ) &&
+        ( ( pcFilter[ 0 ] == '+' ) || ( pcFilter[ 0 ] == '#' ) ) )
+    {
+        xDone = pdTRUE;
+    }
+
+    while( xDone == pdFALSE )
+    {
+        if( xFilterIndex == xFilterLength )
+        {
+            xMatch = ( xTopicIndex == xTopicLength ) ? pdTRUE : pdFALSE;
+            xDone = pdTRUE;
+        }
+        else if( pcFilter[ xFilterIndex ] == '#' )
+        {
+            xMatch = pdTRUE;
+            xDone = pdTRUE;
+        }
+        else if( pcFilter[ xFilterIndex ] == '+' )
+        {
+            while( ( xTopicIndex < xTopicLength ) && ( pcTopic[ xTopicIndex ] != '/' ) )
+            {
+                xTopicIndex++;
+            }
+
+            xFilterIndex++;
+        }
+        else if( xTopicIndex == xTopicLength )
+        {
+            /* "a/#" also matches the parent level "a". */
+            xMatch = ( ( xFilterLength - xFilterIndex == 2U ) &&
+                       ( pcFilter[ xFilterIndex ] == '/' ) &&
+                       ( pcFilter[ xFilterIndex + 1U ] == '#' ) ) ? pdTRUE : pdFALSE;
+            xDone = pdTRUE;
+        }
+        else if( pcFilter[ xFilterIndex ] == pcTopic[ xTopicIndex ] )
+        {
+            xFilterIndex++;
+            xTopicIndex++;
+        }
+        else
+        {
+            xDone = pdTRUE;
+        }
+    }
+
+    return xMatch;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHasRoom( const BrokerSimulatorConnection_t * pxConnection,
+                              size_t xLength,
+                              BaseType_t xIsPublish )
+{
+    size_t xFreeBytes = brokersimconfigRECEIVE_BUFFER_SIZE - ( pxConnection->ulWriteCount - pxConnection->ulReadCount );
+    uint32_t ulFreePackets = brokersimconfigMAX_PENDING_PACKETS - pxConnection->ulPacketCount;
+    BaseType_t xHasRoom = pdFALSE;
+
+    if( xIsPublish == pdFALSE )
+    {
+        xHasRoom = ( ( xLength <= xFreeBytes ) && ( ulFreePackets > 0U ) ) ? pdTRUE : pdFALSE;
+    }
+    else if( ( xFreeBytes > brokersimconfigCONTROL_RESERVE_SIZE ) && ( ulFreePackets > brokersimconfigCONTROL_RESERVE_PACKETS ) )
+    {
+        xHasRoom = ( xLength <= ( xFreeBytes - brokersimconfigCONTROL_RESERVE_SIZE ) ) ? pdTRUE : pdFALSE;
+    }
+    else
+    {
+        /* The space left is reserved for control packets. */
+    }
+
+    return xHasRoom;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvResponseLength( uint8_t ucFirstByte,
+                                 uint32_t ulRemainingLength )
+{
+    uint8_t ucType = ucFirstByte & 0xF0U;
+    size_t xLength = 0;
+
+    if( ( ucType == brokersimCONNECT ) || ( ucType == brokersimPUBREC ) ||
+        ( ucType == brokersimPUBREL ) || ( ucType == brokersimUNSUBSCRIBE ) ||
+        ( ( ucType == brokersimPUBLISH ) && ( ( ucFirstByte & 0x06U ) != 0U ) ) )
+    {
+        /* CONNACK, PUBREL, PUBCOMP, UNSUBACK, PUBACK or PUBREC. */
+        xLength = 4U;
+    }
+    else if( ucType == brokersimSUBSCRIBE )
+    {
+        /* A return code for each topic filter, which takes at least three
+         * bytes after the packet identifier. */
+        xLength = brokersimMAX_FIXED_HEADER_SIZE + 2U + ( ulRemainingLength / 3U );
+    }
+    else if( ucType == brokersimPINGREQ )
+    {
+        xLength = 2U;
+    }
+    else
+    {
+        /* No response. */
+    }
+
+    return xLength;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvQueuePacket( BrokerSimulatorConnection_t * pxConnection,
+                                  uint64_t ullSentTimeUs,
+                                  const BrokerSimulatorSegment_t * pxSegments,
+                                  size_t xSegmentCount,
+                                  BaseType_t xIsPublish )
+{
+    BaseType_t xReturn = pdFAIL;
+    BrokerSimulatorPacket_t * pxPacket;
+    uint64_t ullDeliveryTimeUs;
+    size_t xLength = 0, xIndex, xChunk, xCopied, i;
+
+    for( i = 0; i < xSegmentCount; i++ )
+    {
+        xLength += pxSegments[ i ].xLength;
+    }
+
+    if( prvHasRoom( pxConnection, xLength, xIsPublish ) == pdTRUE )
+    {
+        for( i = 0; i < xSegmentCount; i++ )
+        {
+            for( xCopied = 0; xCopied < pxSegments[ i ].xLength; xCopied += xChunk )
+            {
+                xIndex = pxConnection->ulWriteCount % brokersimconfigRECEIVE_BUFFER_SIZE;
+                xChunk = pxSegments[ i ].xLength - xCopied;
+
+                if( xChunk > ( brokersimconfigRECEIVE_BUFFER_SIZE - xIndex ) )
+                {
+                    xChunk = brokersimconfigRECEIVE_BUFFER_SIZE - xIndex;
+                }
+
+                memcpy( &( pxConnection->ucReceiveBuffer[ xIndex ] ), &( pxSegments[ i ].pucData[ xCopied ] ), xChunk );
+                pxConnection->ulWriteCount += ( uint32_t ) xChunk;
+            }
+        }
+
+        /* The packet starts to cross the downlink once the packets ahead of
+         * it have crossed. */
+        if( pxConnection->ullDownlinkFreeUs < ullSentTimeUs )
+        {
+            pxConnection->ullDownlinkFreeUs = ullSentTimeUs;
+        }
+
+        pxConnection->ullDownlinkFreeUs += prvTransmitTimeUs( xLength );
+        ullDeliveryTimeUs = pxConnection->ullDownlinkFreeUs + ( ( uint64_t ) xLink.ulLatencyMs * 1000ULL );
+
+        /* Keep the packets in order if the latency was reduced. */
+        if( pxConnection->ulPacketCount > 0U )
+        {
+            pxPacket = &( pxConnection->xPackets[ ( pxConnection->ulFirstPacket + pxConnection->ulPacketCount - 1U ) % brokersimconfigMAX_PENDING_PACKETS ] );
+
+            if( ullDeliveryTimeUs < pxPacket->ullDeliveryTimeUs )
+            {
+                ullDeliveryTimeUs = pxPacket->ullDeliveryTimeUs;
+            }
+        }
+
+        pxPacket = &( pxConnection->xPackets[ ( pxConnection->ulFirstPacket + pxConnection->ulPacketCount ) % brokersimconfigMAX_PENDING_PACKETS ] );
+        pxPacket->ulEnd = pxConnection->ulWriteCount;
+        pxPacket->ullDeliveryTimeUs = ullDeliveryTimeUs;
+        pxConnection->ulPacketCount++;
+
+        prvScheduleWakeup( pxConnection );
+        xReturn = pdPASS;
+    }
+    else
+    {
+        xStats.ulOverflows++;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSendAck( BrokerSimulatorConnection_t * pxConnection,
+                        uint64_t ullSentTimeUs,
+                        uint8_t ucFirstByte,
+                        uint16_t usPacketId )
+{
+    uint8_t ucPacket[ 4 ];
+    BrokerSimulatorSegment_t xSegment;
+
+    ucPacket[ 0 ] = ucFirstByte;
+    ucPacket[ 1 ] = 2U;
+    ucPacket[ 2 ] = ( uint8_t ) ( usPacketId >> 8 );
+    ucPacket[ 3 ] = ( uint8_t ) ( usPacketId & 0xFFU );
+
+    xSegment.pucData = ucPacket;
+    xSegment.xLength = sizeof( ucPacket );
+    ( void ) prvQueuePacket( pxConnection, ullSentTimeUs, &xSegment, 1U, pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+static void prvScheduleWakeup( BrokerSimulatorConnection_t * pxConnection )
+{
+    const BrokerSimulatorPacket_t * pxPacket;
+    uint64_t ullNowUs, ullWaitUs;
+    TickType_t xWait;
+    uint32_t i;
+
+    if( ( pxConnection->xWakeupPending == pdTRUE ) && ( xTimerIsTimerActive( pxConnection->xWakeupTimer ) == pdFALSE ) )
+    {
+        /* The timer callback could not take the mutex or set the timer
+         * again. */
+        pxConnection->xWakeupPending = pdFALSE;
+    }
+
+    if( ( pxConnection->pxWakeupCallback != NULL ) && ( pxConnection->xWakeupPending == pdFALSE ) )
+    {
+        ullNowUs = ullClockGetTimeUs();
+
+        for( i = 0; i < pxConnection->ulPacketCount; i++ )
+        {
+            pxPacket = &( pxConnection->xPackets[ ( pxConnection->ulFirstPacket + i ) % brokersimconfigMAX_PENDING_PACKETS ] );
+
+            if( pxPacket->ullDeliveryTimeUs > pxConnection->ullWokenUs )
+            {
+                ullWaitUs = ( pxPacket->ullDeliveryTimeUs > ullNowUs ) ? ( pxPacket->ullDeliveryTimeUs - ullNowUs ) : 0U;
+
+                /* A packet that is already due wakes the client on the next
+                 * tick, so the client is never called from its own send. */
+                xWait = xClockTicksFor( ullWaitUs );
+
+                if( xTimerChangePeriod( pxConnection->xWakeupTimer, xWait, 0U ) == pdPASS )
+                {
+                    pxConnection->xWakeupPending = pdTRUE;
+                }
+
+                break;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvDueBytes( const BrokerSimulatorConnection_t * pxConnection,
+                             uint64_t ullNowUs )
+{
+    const BrokerSimulatorPacket_t * pxPacket;
+    uint32_t ulEnd = pxConnection->ulReadCount, i;
+
+    for( i = 0; i < pxConnection->ulPacketCount; i++ )
+    {
+        pxPacket = &( pxConnection->xPackets[ ( pxConnection->ulFirstPacket + i ) % brokersimconfigMAX_PENDING_PACKETS ] );
+
+        if( pxPacket->ullDeliveryTimeUs > ullNowUs )
+        {
+            break;
+        }
+
+        ulEnd = pxPacket->ulEnd;
+    }
+
+    return ulEnd - pxConnection->ulReadCount;
+}
+/*-----------------------------------------------------------*/
+
+static void prvForwardPublish( uint64_t ullSentTimeUs,
+                               uint8_t ucQoS,
+                               const uint8_t * pucTopic,
+                               uint16_t usTopicLength,
+                               const uint8_t * pucPayload,
+                               size_t xPayloadLength )
+{
+    BrokerSimulatorConnection_t * pxConnection;
+    BrokerSimulatorSegment_t xSegments[ 4 ];
+    uint8_t ucHeader[ brokersimMAX_FIXED_HEADER_SIZE + 2U ];
+    uint8_t ucPacketId[ 2 ];
+    int32_t lGrantedQoS;
+    uint8_t ucForwardQoS;
+    size_t xHeaderLength;
+    uint32_t i, j;
+
+    for( i = 0; i < brokersimconfigMAX_CONNECTIONS; i++ )
+    {
+        pxConnection = &( xConnections[ i ] );
+        lGrantedQoS = -1;
+
+        if( ( pxConnection->xConnected == pdTRUE ) && ( pxConnection->xClosed == pdFALSE ) )
+        {
+            /* A client with overlapping subscriptions receives one copy, at
+             * the highest QoS granted by any of them. */
+            for( j = 0; j < brokersimconfigMAX_SUBSCRIPTIONS; j++ )
+            {
+                if( ( pxConnection->xSubscriptions[ j ].usFilterLength > 0U ) &&
+                    ( ( int32_t ) pxConnection->xSubscriptions[ j ].ucQoS > lGrantedQoS ) &&
+                    ( prvTopicMatches( pxConnection->xSubscriptions[ j ].cFilter,
+                                       pxConnection->xSubscriptions[ j ].usFilterLength,
+                                       ( const char * ) pucTopic,
+                                       usTopicLength ) == pdTRUE ) )
+                {
+                    lGrantedQoS = ( int32_t ) pxConnection->xSubscriptions[ j ].ucQoS;
+                }
+            }
+        }
+
+        if( lGrantedQoS < 0 )
+        {
+            /* No matching subscription. */
+        }
+        else if( prvChance( xLink.ulLossPercent ) == pdTRUE )
+        {
+            xStats.ulPublishesDropped++;
+        }
+        else
+        {
+            ucForwardQoS = ( ( int32_t ) ucQoS < lGrantedQoS ) ? ucQoS : ( uint8_t ) lGrantedQoS;
+
+            xHeaderLength = prvEncodeFixedHeader( ucHeader,
+                                                  ( uint8_t ) ( brokersimPUBLISH | ( ucForwardQoS << 1 ) ),
+                                                  ( uint32_t ) ( 2U + usTopicLength + ( ( ucForwardQoS > 0U ) ? 2U : 0U ) + xPayloadLength ) );
+            ucHeader[ xHeaderLength++ ] = ( uint8_t ) ( usTopicLength >> 8 );
+            ucHeader[ xHeaderLength++ ] = ( uint8_t ) ( usTopicLength & 0xFFU );
+
+            xSegments[ 0 ].pucData = ucHeader;
+            xSegments[ 0 ].xLength = xHeaderLength;
+            xSegments[ 1 ].pucData = pucTopic;
+            xSegments[ 1 ].xLength = usTopicLength;
+            xSegments[ 2 ].pucData = ucPacketId;
+            xSegments[ 2 ].xLength = 0U;
+            xSegments[ 3 ].pucData = pucPayload;
+            xSegments[ 3 ].xLength = xPayloadLength;
+
+            if( ucForwardQoS > 0U )
+            {
+                if( pxConnection->usNextPacketId == 0U )
+                {
+                    pxConnection->usNextPacketId = 1U;
+                }
+
+                ucPacketId[ 0 ] = ( uint8_t ) ( pxConnection->usNextPacketId >> 8 );
+                ucPacketId[ 1 ] = ( uint8_t ) ( pxConnection->usNextPacketId & 0xFFU );
+                xSegments[ 2 ].xLength = sizeof( ucPacketId );
+                pxConnection->usNextPacketId++;
+            }
+
+            if( prvQueuePacket( pxConnection, ullSentTimeUs, xSegments, 4U, pdTRUE ) == pdPASS )
+            {
+                xStats.ulPublishesForwarded++;
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandlePublish( BrokerSimulatorConnection_t * pxConnection,
+                                    uint64_t ullArrivalTimeUs,
+                                    uint8_t ucFirstByte,
+                                    const uint8_t * pucBody,
+                                    uint32_t ulBodyLength )
+{
+    BaseType_t xReturn = pdFAIL;
+    uint8_t ucQoS = ( uint8_t ) ( ( ucFirstByte >> 1 ) & 0x03U );
+    uint16_t usTopicLength = 0, usPacketId = 0;
+    uint32_t ulHeaderLength;
+
+    if( ulBodyLength >= 2U )
+    {
+        usTopicLength = ( uint16_t ) ( ( ( uint16_t ) pucBody[ 0 ] << 8 ) | pucBody[ 1 ] );
+    }
+
+    ulHeaderLength = 2U + usTopicLength + ( ( ucQoS > 0U ) ? 2U : 0U );
+
+    if( ( ucQoS < 3U ) && ( usTopicLength > 0U ) && ( ulBodyLength >= ulHeaderLength ) )
+    {
+        xStats.ulPublishesReceived++;
+
+        /* Retained messages are not stored, so the retain flag is ignored. */
+        prvForwardPublish( ullArrivalTimeUs,
+                           ucQoS,
+                           &( pucBody[ 2 ] ),
+                           usTopicLength,
+                           &( pucBody[ ulHeaderLength ] ),
+                           ulBodyLength - ulHeaderLength );
+
+        if( ucQoS > 0U )
+        {
+            usPacketId = ( uint16_t ) ( ( ( uint16_t ) pucBody[ 2U + usTopicLength ] << 8 ) | pucBody[ 3U + usTopicLength ] );
+            prvSendAck( pxConnection,
+                        ullArrivalTimeUs,
+                        ( ucQoS == 1U ) ? brokersimPUBACK : brokersimPUBREC,
+                        usPacketId );
+        }
+
+        xReturn = pdPASS;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandleSubscribe( BrokerSimulatorConnection_t * pxConnection,
+                                      uint64_t ullArrivalTimeUs,
+                                      const uint8_t * pucBody,
+                                      uint32_t ulBodyLength )
+{
+    BaseType_t xReturn = pdPASS;
+    BrokerSimulatorSubscription_t * pxSubscription, * pxFree;
+    BrokerSimulatorSegment_t xSegments[ 2 ];
+    uint8_t ucHeader[ brokersimMAX_FIXED_HEADER_SIZE + 2U ];
+    const char * pcFilter;
+    uint16_t usFilterLength;
+    uint32_t ulOffset = 2, ulCodeCount = 0, i;
+    size_t xHeaderLength;
+    uint8_t ucQoS;
+
+    if( ulBodyLength < 5U )
+    {
+        xReturn = pdFAIL;
+    }
+
+    while( ( xReturn == pdPASS ) && ( ulOffset < ulBodyLength ) )
+    {
+        if( ( ulBodyLength - ulOffset ) < 3U )
+        {
+            xReturn = pdFAIL;
+            break;
+        }
+
+        usFilterLength = ( uint16_t ) ( ( ( uint16_t ) pucBody[ ulOffset ] << 8 ) | pucBody[ ulOffset + 1U ] );
+        pcFilter = ( const char * ) &( pucBody[ ulOffset + 2U ] );
+        ulOffset += 2U + usFilterLength;
+
+        if( ( ulOffset >= ulBodyLength ) || ( pucBody[ ulOffset ] > 2U ) )
+        {
+            xReturn = pdFAIL;
+            break;
+        }
+
+        ucQoS = pucBody[ ulOffset ];
+        ulOffset++;
+        ucSubackCodes[ ulCodeCount ] = brokersimSUBACK_FAILURE;
+
+        if( ( usFilterLength <= brokersimconfigMAX_TOPIC_FILTER_LENGTH ) &&
+            ( prvFilterIsValid( pcFilter, usFilterLength ) == pdTRUE ) )
+        {
+            /* A subscription to a filter the client is already subscribed to
+             * replaces the existing one. */
+            pxFree = NULL;
+
+            for( i = 0; i < brokersimconfigMAX_SUBSCRIPTIONS; i++ )
+            {
+                pxSubscription = &( pxConnection->xSubscriptions[ i ] );
+
+                if( pxSubscription->usFilterLength == 0U )
+                {
+                    if( pxFree == NULL )
+                    {
+                        pxFree = pxSubscription;
+                    }
+                }
+                else if( ( pxSubscription->usFilterLength == usFilterLength ) &&
+                         ( memcmp( pxSubscription->cFilter, pcFilter, usFilterLength ) == 0 ) )
+                {
+                    pxFree = pxSubscription;
+                    break;
+                }
+            }
+
+            if( pxFree != NULL )
+            {
+                memcpy( pxFree->cFilter, pcFilter, usFilterLength );
+                pxFree->usFilterLength = usFilterLength;
+                pxFree->ucQoS = ucQoS;
+                ucSubackCodes[ ulCodeCount ] = ucQoS;
+            }
+        }
+
+        ulCodeCount++;
+    }
+
+    if( xReturn == pdPASS )
+    {
+        xHeaderLength = prvEncodeFixedHeader( ucHeader, brokersimSUBACK, 2U + ulCodeCount );
+        ucHeader[ xHeaderLength++ ] = pucBody[ 0 ];
+        ucHeader[ xHeaderLength++ ] = pucBody[ 1 ];
+
+        xSegments[ 0 ].pucData = ucHeader;
+        xSegments[ 0 ].xLength = xHeaderLength;
+        xSegments[ 1 ].pucData = ucSubackCodes;
+        xSegments[ 1 ].xLength = ulCodeCount;
+        ( void ) prvQueuePacket( pxConnection, ullArrivalTimeUs, xSegments, 2U, pdFALSE );
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandleUnsubscribe( BrokerSimulatorConnection_t * pxConnection,
+                                        uint64_t ullArrivalTimeUs,
+                                        const uint8_t * pucBody,
+                                        uint32_t ulBodyLength )
+{
+    BaseType_t xReturn = pdPASS;
+    BrokerSimulatorSubscription_t * pxSubscription;
+    uint16_t usFilterLength;
+    uint32_t ulOffset = 2, i;
+
+    if( ulBodyLength < 4U )
+    {
+        xReturn = pdFAIL;
+    }
+
+    while( ( xReturn == pdPASS ) && ( ulOffset < ulBodyLength ) )
+    {
+        if( ( ulBodyLength - ulOffset ) < 2U )
+        {
+            xReturn = pdFAIL;
+            break;
+        }
+
+        usFilterLength = ( uint16_t ) ( ( ( uint16_t ) pucBody[ ulOffset ] << 8 ) | pucBody[ ulOffset + 1U ] );
+        ulOffset += 2U;
+
+        if( ( ulBodyLength - ulOffset ) < usFilterLength )
+        {
+            xReturn = pdFAIL;
+            break;
+        }
+
+        for( i = 0; i < brokersimconfigMAX_SUBSCRIPTIONS; i++ )
+        {
+            pxSubscription = &( pxConnection->xSubscriptions[ i ] );
+
+            if( ( pxSubscription->usFilterLength == usFilterLength ) &&
+                ( memcmp( pxSubscription->cFilter, &( pucBody[ ulOffset ] ), usFilterLength ) == 0 ) )
+            {
+                pxSubscription->usFilterLength = 0U;
+            }
+        }
+
+        ulOffset += usFilterLength;
+    }
+
+    if( xReturn == pdPASS )
+    {
+        prvSendAck( pxConnection,
+                    ullArrivalTimeUs,
+                    brokersimUNSUBACK,
+                    ( uint16_t ) ( ( ( uint16_t ) pucBody[ 0 ] << 8 ) | pucBody[ 1 ] ) );
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvHandlePacket( BrokerSimulatorConnection_t * pxConnection,
+                                   uint64_t ullArrivalTimeUs,
+                                   uint8_t ucFirstByte,
+                                   const uint8_t * pucBody,
+                                   uint32_t ulBodyLength )
+{
+    BaseType_t xReturn = pdPASS;
+    uint8_t ucType = ucFirstByte & 0xF0U;
+    uint8_t ucConnack[ 4 ] = { brokersimCONNACK, 2U, 0U, 0U };
+    uint8_t ucPingresp[ 2 ] = { brokersimPINGRESP, 0U };
+    BrokerSimulatorSegment_t xSegment;
+    uint16_t usPacketId = 0;
+
+    xStats.ulPacketsReceived++;
+
+    if( ulBodyLength >= 2U )
+    {
+        usPacketId = ( uint16_t ) ( ( ( uint16_t ) pucBody[ 0 ] << 8 ) | pucBody[ 1 ] );
+    }
+
+    if( ( ( ucType == brokersimCONNECT ) && ( pxConnection->xConnected == pdTRUE ) ) ||
+        ( ( ucType != brokersimCONNECT ) && ( pxConnection->xConnected == pdFALSE ) ) )
+    {
+        /* The first packet must be CONNECT, and only the first. */
+        xReturn = pdFAIL;
+    }
+    else if( ucType == brokersimCONNECT )
+    {
+        /* Every connection starts a new session, so the session present flag
+         * of the CONNACK is always clear. */
+        if( ulBodyLength < 10U )
+        {
+            xReturn = pdFAIL;
+        }
+        else
+        {
+            pxConnection->xConnected = pdTRUE;
+            xStats.ulConnects++;
+
+            xSegment.pucData = ucConnack;
+            xSegment.xLength = sizeof( ucConnack );
+            ( void ) prvQueuePacket( pxConnection, ullArrivalTimeUs, &xSegment, 1U, pdFALSE );
+        }
+    }
+    else if( ucType == brokersimPUBLISH )
+    {
+        xReturn = prvHandlePublish( pxConnection, ullArrivalTimeUs, ucFirstByte, pucBody, ulBodyLength );
+    }
+    else if( ( ucType == brokersimPUBACK ) || ( ucType == brokersimPUBCOMP ) )
+    {
+        /* The broker does not retransmit, so has nothing to release. */
+        xReturn = ( ulBodyLength == 2U ) ? pdPASS : pdFAIL;
+    }
+    else if( ( ucType == brokersimPUBREC ) || ( ucFirstByte == ( brokersimPUBREL | brokersimREQUIRED_FLAGS ) ) )
+    {
+        /* Complete the second step of the QoS 2 flows. */
+        if( ulBodyLength == 2U )
+        {
+            prvSendAck( pxConnection,
+                        ullArrivalTimeUs,
+                        ( ucType == brokersimPUBREC ) ? ( brokersimPUBREL | brokersimREQUIRED_FLAGS ) : brokersimPUBCOMP,
+                        usPacketId );
+        }
+        else
+        {
+            xReturn = pdFAIL;
+        }
+    }
+    else if( ucFirstByte == ( brokersimSUBSCRIBE | brokersimREQUIRED_FLAGS ) )
+    {
+        xReturn = prvHandleSubscribe( pxConnection, ullArrivalTimeUs, pucBody, ulBodyLength );
+    }
+    else if( ucFirstByte == ( brokersimUNSUBSCRIBE | brokersimREQUIRED_FLAGS ) )
+    {
+        xReturn = prvHandleUnsubscribe( pxConnection, ullArrivalTimeUs, pucBody, ulBodyLength );
+    }
+    else if( ucFirstByte == brokersimPINGREQ )
+    {
+        xStats.ulPingsReceived++;
+
+        xSegment.pucData = ucPingresp;
+        xSegment.xLength = sizeof( ucPingresp );
+        ( void ) prvQueuePacket( pxConnection, ullArrivalTimeUs, &xSegment, 1U, pdFALSE );
+    }
+    else if( ucFirstByte == brokersimDISCONNECT )
+    {
+        pxConnection->xClosed = pdTRUE;
+    }
+    else
+    {
+        xReturn = pdFAIL;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvProcessAssembledPackets( BrokerSimulatorConnection_t * pxConnection )
+{
+    BaseType_t xReturn = pdPASS;
+    size_t xOffset = 0, xPacketLength;
+    uint32_t ulRemainingLength = 0;
+    uint64_t ullStartUs;
+    int32_t lHeaderLength;
+
+    while( ( xReturn == pdPASS ) && ( pxConnection->xClosed == pdFALSE ) )
+    {
+        lHeaderLength = prvDecodeFixedHeader( &( pxConnection->ucAssembly[ xOffset ] ),
+                                              pxConnection->xAssembledLength - xOffset,
+                                              &ulRemainingLength );
+
+        if( ( lHeaderLength < 0 ) ||
+            ( ( lHeaderLength > 0 ) && ( ulRemainingLength > ( brokersimconfigMAX_PACKET_SIZE - ( uint32_t ) lHeaderLength ) ) ) )
+        {
+            LogError( ( "Broker simulator received a malformed or oversized packet." ) );
+            xReturn = pdFAIL;
+        }
+        else if( ( lHeaderLength == 0 ) ||
+                 ( ( pxConnection->xAssembledLength - xOffset ) < ( ( size_t ) lHeaderLength + ulRemainingLength ) ) )
+        {
+            /* Wait for the rest of the packet. */
+            break;
+        }
+        else if( prvHasRoom( pxConnection,
+                             prvResponseLength( pxConnection->ucAssembly[ xOffset ], ulRemainingLength ),
+                             pdFALSE ) == pdFALSE )
+        {
+            /* Wait for the client to receive, so the response to the packet
+             * is not lost. */
+            break;
+        }
+        else
+        {
+            /* The packet reaches the broker once it has crossed the uplink,
+             * which it starts to do once the packets ahead of it have. */
+            xPacketLength = ( size_t ) lHeaderLength + ulRemainingLength;
+            ullStartUs = ullClockGetTimeUs();
+
+            if( pxConnection->ullUplinkFreeUs > ullStartUs )
+            {
+                ullStartUs = pxConnection->ullUplinkFreeUs;
+            }
+
+            pxConnection->ullUplinkFreeUs = ullStartUs + prvTransmitTimeUs( xPacketLength );
+
+            xReturn = prvHandlePacket( pxConnection,
+                                       pxConnection->ullUplinkFreeUs + ( ( uint64_t ) xLink.ulLatencyMs * 1000ULL ),
+                                       pxConnection->ucAssembly[ xOffset ],
+                                       &( pxConnection->ucAssembly[ xOffset + ( size_t ) lHeaderLength ] ),
+                                       ulRemainingLength );
+            xOffset += xPacketLength;
+        }
+    }
+
+    if( xOffset > 0U )
+    {
+        memmove( pxConnection->ucAssembly, &( pxConnection->ucAssembly[ xOffset ] ), pxConnection->xAssembledLength - xOffset );
+        pxConnection->xAssembledLength -= xOffset;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWakeupTimerCallback( TimerHandle_t xTimer )
+{
+    BrokerSimulatorConnection_t * pxConnection = ( BrokerSimulatorConnection_t * ) pvTimerGetTimerID( xTimer );
+    BrokerSimulatorWakeupCallback_t pxCallback = NULL;
+    void * pvContext = NULL;
+
+    if( xSemaphoreTake( xSimulatorMutex, 0U ) == pdPASS )
+    {
+        pxConnection->xWakeupPending = pdFALSE;
+        pxConnection->ullWokenUs = ullClockGetTimeUs();
+
+        if( prvDueBytes( pxConnection, pxConnection->ullWokenUs ) > 0U )
+        {
+            pxCallback = pxConnection->pxWakeupCallback;
+            pvContext = pxConnection->pvWakeupContext;
+        }
+
+        prvScheduleWakeup( pxConnection );
+        ( void ) xSemaphoreGive( xSimulatorMutex );
+    }
+    else
+    {
+        /* xWakeupPending stays set, so nothing else sets the timer.  If the
+         * timer command queue is full, prvScheduleWakeup() sets it once it
+         * finds it stopped. */
+        ( void ) xTimerChangePeriod( xTimer, 1U, 0U );
+    }
+
+    /* Called without the mutex held as the callback may receive. */
+    if( pxCallback != NULL )
+    {
+        pxCallback( pxConnection, pvContext );
+    }
+}
+/*-----------------------------------------------------------*/
+
+eBrokerSimulatorStatus eBrokerSimulatorInit( void )
+{
+    eBrokerSimulatorStatus eStatus = eBrokerSimulatorSuccess;
+    uint32_t i;
+
+    if( xSimulatorMutex == NULL )
+    {
+        memset( xConnections, 0x00, sizeof( xConnections ) );
+        memset( &xStats, 0x00, sizeof( xStats ) );
+
+        for( i = 0; i < brokersimconfigMAX_CONNECTIONS; i++ )
+        {
+            /* Cannot fail as the timer is statically allocated. */
+            xConnections[ i ].xWakeupTimer = xTimerCreateStatic( "BrokerSim",
+                                                                 1U,
+                                                                 pdFALSE,
+                                                                 &( xConnections[ i ] ),
+                                                                 prvWakeupTimerCallback,
+                                                                 &( xConnections[ i ].xWakeupTimerBuffer ) );
+        }
+
+        xSimulatorMutex = xSemaphoreCreateMutex();
+
+        if( xSimulatorMutex == NULL )
+        {
+            LogError( ( "Failed to create the broker simulator mutex." ) );
+            eStatus = eBrokerSimulatorInitFailed;
+        }
+        else
+        {
+            LogInfo( ( "Broker simulator started, latency %lu ms, bandwidth %lu bytes/s, loss %lu%%.",
+                       ( unsigned long ) xLink.ulLatencyMs,
+                       ( unsigned long ) xLink.ulBytesPerSecond,
+                       ( unsigned long ) xLink.ulLossPercent ) );
+        }
+    }
+
+    return eStatus;
+}
+/*-----------------------------------------------------------*/
+
+void vBrokerSimulatorSetLink( const BrokerSimulatorLink_t * pxLink )
+{
+    configASSERT( pxLink != NULL );
+    configASSERT( xSimulatorMutex != NULL );
+
+    ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+    {
+        xLink = *pxLink;
+    }
+    ( void ) xSemaphoreGive( xSimulatorMutex );
+}
+/*-----------------------------------------------------------*/
+
+eBrokerSimulatorStatus eBrokerSimulatorConnect( NetworkContext_t * pxNetworkContext,
+                                                uint32_t ulReceiveTimeoutMs )
+{
+    eBrokerSimulatorStatus eStatus = eBrokerSimulatorNoFreeConnection;
+    BrokerSimulatorConnection_t * pxConnection;
+    TimerHandle_t xWakeupTimer;
+    uint32_t i;
+
+    configASSERT( xSimulatorMutex != NULL );
+
+    if( pxNetworkContext == NULL )
+    {
+        LogError( ( "Invalid parameter. pxNetworkContext: %p", pxNetworkContext ) );
+        eStatus = eBrokerSimulatorBadParameter;
+    }
+    else
+    {
+        ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+        {
+            for( i = 0; i < brokersimconfigMAX_CONNECTIONS; i++ )
+            {
+                pxConnection = &( xConnections[ i ] );
+
+                if( pxConnection->xInUse == pdFALSE )
+                {
+                    /* Clear everything but the timer, which is reused. */
+                    xWakeupTimer = pxConnection->xWakeupTimer;
+                    memset( pxConnection, 0x00, offsetof( BrokerSimulatorConnection_t, xWakeupTimer ) );
+                    pxConnection->xWakeupTimer = xWakeupTimer;
+                    pxConnection->xInUse = pdTRUE;
+
+                    pxNetworkContext->pxConnection = pxConnection;
+                    pxNetworkContext->xReceiveTimeout = pdMS_TO_TICKS( ulReceiveTimeoutMs );
+                    eStatus = eBrokerSimulatorSuccess;
+                    break;
+                }
+            }
+        }
+        ( void ) xSemaphoreGive( xSimulatorMutex );
+
+        if( eStatus != eBrokerSimulatorSuccess )
+        {
+            LogError( ( "Broker simulator has no free connections." ) );
+        }
+    }
+
+    return eStatus;
+}
+/*-----------------------------------------------------------*/
+
+eBrokerSimulatorStatus eBrokerSimulatorDisconnect( NetworkContext_t * pxNetworkContext )
+{
+    eBrokerSimulatorStatus eStatus = eBrokerSimulatorBadParameter;
+    BrokerSimulatorConnection_t * pxConnection;
+
+    configASSERT( xSimulatorMutex != NULL );
+
+    if( ( pxNetworkContext != NULL ) && ( pxNetworkContext->pxConnection != NULL ) )
+    {
+        pxConnection = pxNetworkContext->pxConnection;
+
+        ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+        {
+            if( pxConnection->xInUse == pdTRUE )
+            {
+                /* The timer may still expire, but finds no callback to call. */
+                pxConnection->pxWakeupCallback = NULL;
+                pxConnection->xConnected = pdFALSE;
+                pxConnection->xInUse = pdFALSE;
+                eStatus = eBrokerSimulatorSuccess;
+            }
+        }
+        ( void ) xSemaphoreGive( xSimulatorMutex );
+
+        pxNetworkContext->pxConnection = NULL;
+    }
+
+    return eStatus;
+}
+/*-----------------------------------------------------------*/
+
+int32_t lBrokerSimulatorSend( NetworkContext_t * pxNetworkContext,
+                              const void * pvBuffer,
+                              size_t xBytesToSend )
+{
+    BrokerSimulatorConnection_t * pxConnection;
+    const uint8_t * pucBuffer = ( const uint8_t * ) pvBuffer;
+    size_t xSent = 0, xChunk;
+    BaseType_t xProtocolError = pdFALSE;
+    int32_t lReturn = -1;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pvBuffer != NULL );
+
+    pxConnection = pxNetworkContext->pxConnection;
+
+    ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+    {
+        if( ( pxConnection != NULL ) && ( pxConnection->xInUse == pdTRUE ) && ( pxConnection->xClosed == pdFALSE ) )
+        {
+            /* The assembly buffer holds the largest packet accepted, and
+             * complete packets are removed from it, so it is only full while
+             * a packet waits for room for its response. */
+            while( ( xSent < xBytesToSend ) && ( pxConnection->xClosed == pdFALSE ) )
+            {
+                xChunk = brokersimconfigMAX_PACKET_SIZE - pxConnection->xAssembledLength;
+
+                if( xChunk == 0U )
+                {
+                    break;
+                }
+
+                if( xChunk > ( xBytesToSend - xSent ) )
+                {
+                    xChunk = xBytesToSend - xSent;
+                }
+
+                memcpy( &( pxConnection->ucAssembly[ pxConnection->xAssembledLength ] ), &( pucBuffer[ xSent ] ), xChunk );
+                pxConnection->xAssembledLength += xChunk;
+                xSent += xChunk;
+
+                if( prvProcessAssembledPackets( pxConnection ) != pdPASS )
+                {
+                    xStats.ulProtocolErrors++;
+                    pxConnection->xClosed = pdTRUE;
+                    xProtocolError = pdTRUE;
+                }
+            }
+
+            /* A DISCONNECT packet closes the connection once it is sent. */
+            if( xProtocolError == pdFALSE )
+            {
+                lReturn = ( int32_t ) xSent;
+            }
+        }
+    }
+    ( void ) xSemaphoreGive( xSimulatorMutex );
+
+    return lReturn;
+}
+/*-----------------------------------------------------------*/
+
+int32_t lBrokerSimulatorRecv( NetworkContext_t * pxNetworkContext,
+                              void * pvBuffer,
+                              size_t xBytesToRecv )
+{
+    BrokerSimulatorConnection_t * pxConnection;
+    uint8_t * pucBuffer = ( uint8_t * ) pvBuffer;
+    TimeOut_t xTimeOut;
+    TickType_t xTicksToWait;
+    size_t xReceived = 0, xIndex, xChunk;
+    uint32_t ulDue;
+    int32_t lReturn = 0;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pvBuffer != NULL );
+
+    pxConnection = pxNetworkContext->pxConnection;
+    xTicksToWait = pxNetworkContext->xReceiveTimeout;
+    vTaskSetTimeOutState( &xTimeOut );
+
+    for( ; ; )
+    {
+        ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+        {
+            if( ( pxConnection == NULL ) || ( pxConnection->xInUse == pdFALSE ) || ( pxConnection->xClosed == pdTRUE ) )
+            {
+                lReturn = -1;
+            }
+            else
+            {
+                ulDue = prvDueBytes( pxConnection, ullClockGetTimeUs() );
+
+                while( ( xReceived < xBytesToRecv ) && ( ulDue > 0U ) )
+                {
+                    xIndex = pxConnection->ulReadCount % brokersimconfigRECEIVE_BUFFER_SIZE;
+                    xChunk = brokersimconfigRECEIVE_BUFFER_SIZE - xIndex;
+
+                    if( xChunk > ulDue )
+                    {
+                        xChunk = ulDue;
+                    }
+
+                    if( xChunk > ( xBytesToRecv - xReceived ) )
+                    {
+                        xChunk = xBytesToRecv - xReceived;
+                    }
+
+                    memcpy( &( pucBuffer[ xReceived ] ), &( pxConnection->ucReceiveBuffer[ xIndex ] ), xChunk );
+                    pxConnection->ulReadCount += ( uint32_t ) xChunk;
+                    xReceived += xChunk;
+                    ulDue -= ( uint32_t ) xChunk;
+                }
+
+                /* Forget the packets that have been read in full.  The byte
+                 * counts wrap, so compare their distance. */
+                while( ( pxConnection->ulPacketCount > 0U ) &&
+                       ( ( pxConnection->ulReadCount - pxConnection->xPackets[ pxConnection->ulFirstPacket ].ulEnd ) <= brokersimconfigRECEIVE_BUFFER_SIZE ) )
+                {
+                    pxConnection->ulFirstPacket = ( pxConnection->ulFirstPacket + 1U ) % brokersimconfigMAX_PENDING_PACKETS;
+                    pxConnection->ulPacketCount--;
+                }
+
+                /* Act on the packets that were waiting for the room just
+                 * made. */
+                if( ( xReceived > 0U ) && ( pxConnection->xAssembledLength > 0U ) &&
+                    ( prvProcessAssembledPackets( pxConnection ) != pdPASS ) )
+                {
+                    xStats.ulProtocolErrors++;
+                    pxConnection->xClosed = pdTRUE;
+                }
+
+                lReturn = ( int32_t ) xReceived;
+            }
+        }
+        ( void ) xSemaphoreGive( xSimulatorMutex );
+
+        if( ( lReturn != 0 ) || ( xTaskCheckForTimeOut( &xTimeOut, &xTicksToWait ) != pdFALSE ) )
+        {
+            break;
+        }
+
+        vTaskDelay( 1U );
+    }
+
+    return lReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vBrokerSimulatorSetWakeupCallback( BrokerSimulatorConnection_t * pxConnection,
+                                        BrokerSimulatorWakeupCallback_t pxCallback,
+                                        void * pvContext )
+{
+    configASSERT( pxConnection != NULL );
+
+    ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+    {
+        pxConnection->pxWakeupCallback = pxCallback;
+        pxConnection->pvWakeupContext = pvContext;
+        prvScheduleWakeup( pxConnection );
+    }
+    ( void ) xSemaphoreGive( xSimulatorMutex );
+}
+/*-----------------------------------------------------------*/
+
+int32_t lBrokerSimulatorRecvCount( BrokerSimulatorConnection_t * pxConnection )
+{
+    int32_t lCount = 0;
+
+    configASSERT( pxConnection != NULL );
+
+    ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+    {
+        if( pxConnection->xInUse == pdTRUE )
+        {
+            lCount = ( int32_t ) prvDueBytes( pxConnection, ullClockGetTimeUs() );
+        }
+    }
+    ( void ) xSemaphoreGive( xSimulatorMutex );
+
+    return lCount;
+}
+/*-----------------------------------------------------------*/
+
+void vBrokerSimulatorGetStats( BrokerSimulatorStats_t * pxOutStats )
+{
+    configASSERT( pxOutStats != NULL );
+    configASSERT( xSimulatorMutex != NULL );
+
+    ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+    {
+        *pxOutStats = xStats;
+    }
+    ( void ) xSemaphoreGive( xSimulatorMutex );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,226 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file mqtt_broker_simulator.h
+ *
+ * @brief In-process stand-in for an MQTT 3.1.1 broker, so the MQTT agent can
+ * be tested and benchmarked without a network or a broker.
+ *
+ * The simulator implements the transport interface used by coreMQTT.  Packets
+ * sent by a client are decoded by the simulated broker as soon as they are
+ * sent, and the packets the broker sends in response are queued for the
+ * clients after passing through a simulated network with configurable
+ * latency, bandwidth and loss.  Only forwarded publishes are ever dropped -
+ * a client that does not receive is made to wait by its sends returning
+ * short rather than losing the acknowledgements it waits for.  The broker
+ * supports CONNECT, SUBSCRIBE and UNSUBSCRIBE with wildcard topic filters,
+ * PUBLISH at QoS 0, 1 and 2, and PINGREQ.  Retained messages, wills and persistent sessions are not
+ * supported.  The network is only as deterministic as the scheduling of the
+ * tasks that use it, but the publishes it drops are the same on every run.
+ */
+
+#ifndef MQTT_BROKER_SIMULATOR_H_
+#define MQTT_BROKER_SIMULATOR_H_
+
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/* Transport interface include. */
+#include "transport_interface.h"
+
+/**
+ * @brief A connection to the simulated broker.
+ */
+typedef struct BrokerSimulatorConnection BrokerSimulatorConnection_t;
+
+/**
+ * @brief Network context definition for the simulated broker.
+ */
+struct NetworkContext
+{
+    BrokerSimulatorConnection_t * pxConnection;
+    TickType_t xReceiveTimeout; /**< Time lBrokerSimulatorRecv() waits for data. */
+};
+
+/**
+ * @brief Return codes from broker simulator APIs.
+ */
+typedef enum
+{
+    eBrokerSimulatorSuccess = 0,
+    eBrokerSimulatorBadParameter,
+    eBrokerSimulatorInitFailed,
+    eBrokerSimulatorNoFreeConnection
+} eBrokerSimulatorStatus;
+
+/**
+ * @brief The properties of the simulated network, initially those set in
+ * broker_simulator_config.h.
+ */
+typedef struct BrokerSimulatorLink
+{
+    uint32_t ulLatencyMs;      /**< One way latency. */
+    uint32_t ulBytesPerSecond; /**< Bandwidth in each direction of each connection, or 0 for no limit. */
+    uint32_t ulLossPercent;    /**< Percentage of the publishes forwarded to subscribers that are dropped. */
+} BrokerSimulatorLink_t;
+
+/**
+ * @brief Counters maintained by the simulator.
+ */
+typedef struct BrokerSimulatorStats
+{
+    uint32_t ulConnects;           /**< Number of CONNECT packets accepted. */
+    uint32_t ulPacketsReceived;    /**< Number of packets sent by the clients. */
+    uint32_t ulPublishesReceived;  /**< Number of PUBLISH packets sent by the clients. */
+    uint32_t ulPingsReceived;      /**< Number of PINGREQ packets sent by the clients. */
+    uint32_t ulPublishesForwarded; /**< Number of PUBLISH packets queued for subscribers. */
+    uint32_t ulPublishesDropped;   /**< Number of PUBLISH packets to subscribers discarded by the simulated loss. */
+    uint32_t ulOverflows;          /**< Number of forwarded publishes discarded because a receive buffer was full. */
+    uint32_t ulProtocolErrors;     /**< Number of connections closed because of a malformed or unexpected packet. */
+} BrokerSimulatorStats_t;
+
+/**
+ * @brief A function called when packets sent by the broker can be received,
+ * see vBrokerSimulatorSetWakeupCallback().
+ */
+typedef void ( * BrokerSimulatorWakeupCallback_t )( BrokerSimulatorConnection_t * pxConnection,
+                                                  void * pvContext );
+
+/**
+ * @brief Start the simulator.
+ *
+ * Creates the RTOS objects used by the simulator.  Must be called before
+ * connecting to the simulated broker.  Calling it again has no effect.
+ *
+ * @return #eBrokerSimulatorSuccess if the simulator is started;
+ * #eBrokerSimulatorInitFailed if the RTOS objects could not be created.
+ */
+eBrokerSimulatorStatus eBrokerSimulatorInit( void );
+
+/**
+ * @brief Change the properties of the simulated network.  The new properties
+ * apply to the packets sent from then on.
+ *
+ * @param[in] pxLink The new properties.
+ */
+void vBrokerSimulatorSetLink( const BrokerSimulatorLink_t * pxLink );
+
+/**
+ * @brief Open a connection to the simulated broker.  The client must then
+ * send a CONNECT packet, as it would to a real broker.
+ *
+ * @param[out] pxNetworkContext The network context to initialize.
+ * @param[in] ulReceiveTimeoutMs Time lBrokerSimulatorRecv() waits for data.
+ *
+ * @return #eBrokerSimulatorSuccess; #eBrokerSimulatorBadParameter if
+ * pxNetworkContext is NULL; #eBrokerSimulatorNoFreeConnection if
+ * brokersimconfigMAX_CONNECTIONS connections are already open.
+ */
+eBrokerSimulatorStatus eBrokerSimulatorConnect( NetworkContext_t * pxNetworkContext,
+                                                uint32_t ulReceiveTimeoutMs );
+
+/**
+ * @brief Close a connection to the simulated broker, and remove its
+ * subscriptions and the packets waiting for it.
+ *
+ * @param[in] pxNetworkContext The network context of the connection.
+ *
+ * @return #eBrokerSimulatorSuccess, or #eBrokerSimulatorBadParameter if the
+ * connection is not open.
+ */
+eBrokerSimulatorStatus eBrokerSimulatorDisconnect( NetworkContext_t * pxNetworkContext );
+
+/**
+ * @brief Send data to the simulated broker.  Never blocks.
+ *
+ * The broker stops accepting bytes while the receive buffer of the
+ * connection has no room for its response to the next packet, as a real
+ * broker stops reading from a socket it cannot write to.  The bytes are then
+ * accepted once the client has received.
+ *
+ * @param[in] pxNetworkContext The network context of the connection.
+ * @param[in] pvBuffer Buffer containing the bytes to send.
+ * @param[in] xBytesToSend Number of bytes to send from the buffer.
+ *
+ * @return The number of bytes accepted, which is less than xBytesToSend,
+ * possibly 0, if the broker stopped accepting them; or a negative value if
+ * the broker closed the connection.
+ */
+int32_t lBrokerSimulatorSend( NetworkContext_t * pxNetworkContext,
+                              const void * pvBuffer,
+                              size_t xBytesToSend );
+
+/**
+ * @brief Receive the data sent by the simulated broker that has crossed the
+ * simulated network, waiting up to the receive timeout of the network context
+ * for some to arrive.
+ *
+ * @param[in] pxNetworkContext The network context of the connection.
+ * @param[out] pvBuffer Buffer to receive bytes into.
+ * @param[in] xBytesToRecv Number of bytes to receive.
+ *
+ * @return Number of bytes received; 0 if no data arrived before the timeout;
+ * or a negative value if the broker closed the connection.
+ */
+int32_t lBrokerSimulatorRecv( NetworkContext_t * pxNetworkContext,
+                              void * pvBuffer,
+                              size_t xBytesToRecv );
+
+/**
+ * @brief Set the function to call when packets sent by the broker arrive at a
+ * connection, the equivalent of the FREERTOS_SO_WAKEUP_CALLBACK socket option
+ * of FreeRTOS+TCP.  The callback is called from the timer service task so must
+ * not block.
+ *
+ * @param[in] pxConnection The connection.
+ * @param[in] pxCallback The function to call, or NULL to stop calling it.
+ * @param[in] pvContext Passed to the callback.
+ */
+void vBrokerSimulatorSetWakeupCallback( BrokerSimulatorConnection_t * pxConnection,
+                                        BrokerSimulatorWakeupCallback_t pxCallback,
+                                        void * pvContext );
+
+/**
+ * @brief Get the number of bytes that can be received from a connection
+ * without waiting, the equivalent of FreeRTOS_recvcount().
+ *
+ * @param[in] pxConnection The connection.
+ *
+ * @return The number of bytes.
+ */
+int32_t lBrokerSimulatorRecvCount( BrokerSimulatorConnection_t * pxConnection );
+
+/**
+ * @brief Get a copy of the simulator counters.
+ *
+ * @param[out] pxOutStats The counters.
+ */
+void vBrokerSimulatorGetStats( BrokerSimulatorStats_t * pxOutStats );
+
+#endif /* MQTT_BROKER_SIMULATOR_H_ */
@@ -0,0 +1,239 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file clock_source.c
+ *
+ * @brief The clock the MQTT agent and the broker simulator measure time with.
+ * See clock_source.h.
+ */
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Demo config, which can override the defaults in clock_source.h. */
+#include "demo_config.h"
+
+#include "clock_source.h"
+
+/**
+ * @brief Microseconds in a second.
+ */
+#define clockUS_PER_SECOND    ( 1000000ULL )
+
+/**
+ * @brief The longest time a task is asked to block for, in ticks.
+ */
+#define clockMAX_TICKS        ( portMAX_DELAY - 1U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return the number of ticks since the scheduler was started, without
+ * wrapping.  The kernel counts the times the tick count has overflowed, so
+ * the count is extended from the time out state it records.
+ */
+static uint64_t prvGetTicks( void );
+
+/**
+ * @brief Return ullTicks as a block time, at least 1 and at most
+ * clockMAX_TICKS.
+ */
+static TickType_t prvClampTicks( uint64_t ullTicks );
+
+/**
+ * @brief pxGetTimeUs and pxTicksFor of xClockTickSource.
+ */
+static uint64_t prvTickGetTimeUs( void );
+static TickType_t prvTickTicksFor( uint64_t ullTimeUs );
+
+/**
+ * @brief pxGetTimeUs and pxTicksFor of xClockSimulatedSource.
+ */
+static uint64_t prvSimulatedGetTimeUs( void );
+static TickType_t prvSimulatedTicksFor( uint64_t ullTimeUs );
+
+/*-----------------------------------------------------------*/
+
+const ClockSource_t xClockTickSource =
+{
+    prvTickGetTimeUs,
+    prvTickTicksFor
+};
+
+const ClockSource_t xClockSimulatedSource =
+{
+    prvSimulatedGetTimeUs,
+    prvSimulatedTicksFor
+};
+
+/**
+ * @brief The selected source.
+ */
+static const ClockSource_t * pxClockSource = &xClockTickSource;
+
+/**
+ * @brief The time added to xClockSimulatedSource by
+ * vClockSimulatedAdvanceUs().  Only accessed in a critical section, as it
+ * cannot be read or written atomically on a 32-bit target.
+ */
+static uint64_t ullSimulatedOffsetUs = 0U;
+
+/*-----------------------------------------------------------*/
+
+static uint64_t prvGetTicks( void )
+{
+    TimeOut_t xTimeOut;
+
+    vTaskSetTimeOutState( &xTimeOut );
+
+    return ( ( uint64_t ) xTimeOut.xOverflowCount * ( ( uint64_t ) portMAX_DELAY + 1U ) ) +
+           ( uint64_t ) xTimeOut.xTimeOnEntering;
+}
+/*-----------------------------------------------------------*/
+
+static TickType_t prvClampTicks( uint64_t ullTicks )
+{
+    TickType_t xTicks;
+
+    if( ullTicks == 0U )
+    {
+        xTicks = 1U;
+    }
+    else if( ullTicks > ( uint64_t ) clockMAX_TICKS )
+    {
+        xTicks = clockMAX_TICKS;
+    }
+    else
+    {
+        xTicks = ( TickType_t ) ullTicks;
+    }
+
+    return xTicks;
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvTickGetTimeUs( void )
+{
+    return ( prvGetTicks() * clockUS_PER_SECOND ) / configTICK_RATE_HZ;
+}
+/*-----------------------------------------------------------*/
+
+static TickType_t prvTickTicksFor( uint64_t ullTimeUs )
+{
+    /* Round up, so the time has passed when the task wakes. */
+    return prvClampTicks( ( ( ullTimeUs * configTICK_RATE_HZ ) + ( clockUS_PER_SECOND - 1U ) ) / clockUS_PER_SECOND );
+}
+/*-----------------------------------------------------------*/
+
+static uint64_t prvSimulatedGetTimeUs( void )
+{
+    uint64_t ullTimeUs = prvGetTicks() * ( uint64_t ) clockconfigSIMULATED_US_PER_TICK;
+
+    taskENTER_CRITICAL();
+    {
+        ullTimeUs += ullSimulatedOffsetUs;
+    }
+    taskEXIT_CRITICAL();
+
+    return ullTimeUs;
+}
+/*-----------------------------------------------------------*/
+
+static TickType_t prvSimulatedTicksFor( uint64_t ullTimeUs )
+{
+    TickType_t xTicks;
+
+    #if ( clockconfigSIMULATED_US_PER_TICK == 0 )
+        {
+            /* Only the harness advances time, which it can do at any moment,
+             * so check again on the next tick. */
+            ( void ) ullTimeUs;
+            xTicks = 1U;
+        }
+    #else
+        {
+            xTicks = prvClampTicks( ( ullTimeUs + ( clockconfigSIMULATED_US_PER_TICK - 1U ) ) / clockconfigSIMULATED_US_PER_TICK );
+        }
+    #endif
+
+    return xTicks;
+}
+/*-----------------------------------------------------------*/
+
+void vClockSetSource( const ClockSource_t * pxSource )
+{
+    pxClockSource = ( pxSource != NULL ) ? pxSource : &xClockTickSource;
+}
+/*-----------------------------------------------------------*/
+
+uint64_t ullClockGetTimeUs( void )
+{
+    return pxClockSource->pxGetTimeUs();
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulClockGetTimeMs( void )
+{
+    return ( uint32_t ) ( pxClockSource->pxGetTimeUs() / 1000U );
+}
+/*-----------------------------------------------------------*/
+
+TickType_t xClockTicksFor( uint64_t ullTimeUs )
+{
+    return pxClockSource->pxTicksFor( ullTimeUs );
+}
+/*-----------------------------------------------------------*/
+
+void vClockDelayMs( uint32_t ulTimeMs )
+{
+    uint64_t ullEndUs, ullNowUs;
+
+    ullEndUs = ullClockGetTimeUs() + ( ( uint64_t ) ulTimeMs * 1000U );
+
+    /* Block again if the task wakes before the time has passed, which happens
+     * when the source does not advance at a constant rate. */
+    for( ullNowUs = ullClockGetTimeUs(); ullNowUs < ullEndUs; ullNowUs = ullClockGetTimeUs() )
+    {
+        vTaskDelay( xClockTicksFor( ullEndUs - ullNowUs ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vClockSimulatedAdvanceUs( uint64_t ullTimeUs )
+{
+    taskENTER_CRITICAL();
+    {
+        ullSimulatedOffsetUs += ullTimeUs;
+    }
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,145 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file clock_source.h
+ *
+ * @brief The clock the MQTT agent and the broker simulator measure time with.
+ *
+ * By default time is read from the kernel tick count, so it passes at the
+ * rate of the tick.  A build can select another source with vClockSetSource()
+ * before the scheduler is started.  xClockSimulatedSource is a virtual clock
+ * that advances by a fixed number of microseconds on every tick, and by any
+ * amount the test harness adds with vClockSimulatedAdvanceUs().  Setting the
+ * step above the real length of a tick runs keep-alive, MQTT timeouts and
+ * reconnect backoff faster than real time, so hours of them can be simulated
+ * in seconds.  Setting the step to 0 leaves the harness in sole control of
+ * time.
+ *
+ * Virtual time is a function of the tick count and of the calls made by the
+ * harness, so a run that makes the same calls on the same ticks sees the same
+ * times.  The order in which the scheduler runs tasks that become ready on
+ * the same tick is not controlled, so runs of several tasks are only
+ * repeatable to the extent that the tasks do not race.
+ *
+ * The virtual clock is only meaningful with a peer that measures time with
+ * it, such as the broker simulator.  A real broker would still disconnect a
+ * client whose keep-alive interval passed in real time.
+ */
+
+#ifndef CLOCK_SOURCE_H_
+#define CLOCK_SOURCE_H_
+
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief Microseconds that xClockSimulatedSource advances on every tick.
+ * Defaults to 100 ms, which runs a 1000 Hz tick a hundred times faster than
+ * real time.  Can be overridden in demo_config.h.
+ */
+#ifndef clockconfigSIMULATED_US_PER_TICK
+    #define clockconfigSIMULATED_US_PER_TICK    ( 100000U )
+#endif
+
+/**
+ * @brief A source of time.
+ */
+typedef struct ClockSource
+{
+    /**
+     * @brief Return the time in microseconds since the scheduler was started.
+     * Must never go backwards.
+     */
+    uint64_t ( * pxGetTimeUs )( void );
+
+    /**
+     * @brief Return the number of ticks to block for ullTimeUs microseconds of
+     * the source's time to pass, at least 1.  A task that blocks for fewer
+     * ticks than needed wakes early and blocks again.
+     */
+    TickType_t ( * pxTicksFor )( uint64_t ullTimeUs );
+} ClockSource_t;
+
+/**
+ * @brief The kernel tick count.  The default source.
+ */
+extern const ClockSource_t xClockTickSource;
+
+/**
+ * @brief A virtual clock advanced by clockconfigSIMULATED_US_PER_TICK on
+ * every tick and by vClockSimulatedAdvanceUs().
+ */
+extern const ClockSource_t xClockSimulatedSource;
+
+/**
+ * @brief Select the source of time.  Not thread safe - call before the
+ * scheduler is started.
+ *
+ * @param[in] pxSource The source, or NULL to select xClockTickSource.
+ */
+void vClockSetSource( const ClockSource_t * pxSource );
+
+/**
+ * @brief Return the time of the selected source in microseconds.
+ */
+uint64_t ullClockGetTimeUs( void );
+
+/**
+ * @brief Return the time of the selected source in milliseconds.  Wraps
+ * after about 49 days.
+ */
+uint32_t ulClockGetTimeMs( void );
+
+/**
+ * @brief Return the number of ticks to block for ullTimeUs microseconds of the
+ * selected source's time to pass, at least 1.
+ *
+ * @param[in] ullTimeUs The time to wait.
+ */
+TickType_t xClockTicksFor( uint64_t ullTimeUs );
+
+/**
+ * @brief Block the calling task until ulTimeMs milliseconds of the selected
+ * source's time have passed.
+ *
+ * @param[in] ulTimeMs The time to wait.
+ */
+void vClockDelayMs( uint32_t ulTimeMs );
+
+/**
+ * @brief Advance xClockSimulatedSource.  Called by the test harness to move
+ * time forward, for example straight to the next deadline, when it is not
+ * enough for time to advance with the tick.  See clock_skip_task.c.
+ *
+ * @param[in] ullTimeUs The time to add.
+ */
+void vClockSimulatedAdvanceUs( uint64_t ullTimeUs );
+
+#endif /* CLOCK_SOURCE_H_ */
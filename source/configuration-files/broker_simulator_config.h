@@ -0,0 +1,103 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file broker_simulator_config.h
+ * @brief Settings for the in-process MQTT broker simulator.
+ *
+ * The simulator replaces the connection to the MQTT broker when
+ * democonfigUSE_BROKER_SIMULATOR is set to 1 in demo_config.h.
+ */
+
+#ifndef BROKER_SIMULATOR_CONFIG_H_
+#define BROKER_SIMULATOR_CONFIG_H_
+
+/**
+ * @brief One way latency of the simulated network, applied to every packet
+ * sent to the broker and to every packet sent by the broker, so a request is
+ * answered after twice this time.
+ */
+#define brokersimconfigLATENCY_MS                   ( 0U )
+
+/**
+ * @brief Bandwidth of the simulated network in each direction of each
+ * connection, in bytes per second, or 0 for no limit.  Packets are delayed
+ * while the earlier packets of the same direction are being transmitted.
+ */
+#define brokersimconfigBYTES_PER_SECOND             ( 0UL )
+
+/**
+ * @brief Percentage (0 to 100) of the publishes forwarded to subscribers that
+ * are silently dropped.  Only forwarded publishes are dropped, so a client is
+ * never left waiting for an acknowledgement from the broker.
+ */
+#define brokersimconfigLOSS_PERCENT                 ( 0U )
+
+/**
+ * @brief Seed of the random number generator that selects the dropped
+ * publishes, so the same publishes are dropped on every run.
+ */
+#define brokersimconfigRANDOM_SEED                  ( 0x2545F491UL )
+
+/**
+ * @brief The number of clients that can be connected at any one time.
+ */
+#define brokersimconfigMAX_CONNECTIONS              ( 4U )
+
+/**
+ * @brief The number of topic filters each client can subscribe to, and the
+ * maximum length of a topic filter.
+ */
+#define brokersimconfigMAX_SUBSCRIPTIONS            ( 16U )
+#define brokersimconfigMAX_TOPIC_FILTER_LENGTH      ( 128U )
+
+/**
+ * @brief The largest packet a client can send to the broker.  A client that
+ * sends a larger packet is disconnected.
+ */
+#define brokersimconfigMAX_PACKET_SIZE              ( 5120U )
+
+/**
+ * @brief Size of the buffer holding the packets sent by the broker to each
+ * client, and the number of those packets that can be waiting for the client
+ * at any one time.  Publishes forwarded to a client that do not fit are
+ * dropped and counted as overflows.  The broker stops reading from a client
+ * while the response to its next packet does not fit, so the client's sends
+ * return short until it has received.
+ */
+#define brokersimconfigRECEIVE_BUFFER_SIZE          ( 16384U )
+#define brokersimconfigMAX_PENDING_PACKETS          ( 64U )
+
+/**
+ * @brief The part of the receive buffer, and of the pending packets, that
+ * forwarded publishes cannot use, so a client that is slow to receive the
+ * publishes it subscribed to still receives the acknowledgements it waits
+ * for.
+ */
+#define brokersimconfigCONTROL_RESERVE_SIZE         ( 1024U )
+#define brokersimconfigCONTROL_RESERVE_PACKETS      ( 16U )
+
+#endif /* BROKER_SIMULATOR_CONFIG_H_ */
@@ -37,16 +37,57 @@
 #define democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE       1
 #define democonfigSIMPLE_SUB_PUB_TASK_STACK_SIZE           ( configMINIMAL_STACK_SIZE )
 
+/* Set to 1 to run the simple sub pub tasks as a load generator that publishes
+ * at a fixed rate, with a mix of payload lengths and QoS, and logs the round
+ * trip time percentiles and the missing and reordered messages.  The load is
+ * configured by the mqttexampleLOAD_ constants in simple_sub_pub_demo.c. */
+#define democonfigSIMPLE_SUB_PUB_LOAD_MODE                 0
+
 #define democonfigCREATE_CODE_SIGNING_OTA_DEMO             0
 #define democonfigCODE_SIGNING_OTA_TASK_STACK_SIZE         ( configMINIMAL_STACK_SIZE )
 
+/* Set to 1 to have the OTA demo download a synthetic image from the in-process
+ * simulator in source/ota-simulator instead of the AWS IoT Jobs and Streams
+ * services, and log the time taken to download and verify it.  The simulator
+ * is configured in ota_simulator_config.h. */
+#define democonfigOTA_USE_STREAM_SIMULATOR                 0
+
 
 #define democonfigCREATE_DEFENDER_DEMO                     0
 #define democonfigDEFENDER_TASK_STACK_SIZE                 ( configMINIMAL_STACK_SIZE )
 
+/* Set to 1 to have the defender demo send CBOR encoded reports to the CBOR
+ * report topics instead of JSON reports to the JSON report topics. */
+#define democonfigDEFENDER_USE_CBOR_REPORTS                0
+
 #define democonfigCREATE_SHADOW_DEMO                       0
 #define democonfigSHADOW_TASK_STACK_SIZE                   ( configMINIMAL_STACK_SIZE )
 
+/* Set to 1 to create the task that lets the logging level of each module be
+ * changed at runtime by publishing to democonfigCLIENT_IDENTIFIER "/log/level".
+ * See log_control_task.c. */
+#define democonfigCREATE_LOG_CONTROL_TASK                  0
+#define democonfigLOG_CONTROL_TASK_STACK_SIZE              ( configMINIMAL_STACK_SIZE )
+
+/* Set to 1 to create the task that measures the time taken by pvPortMalloc()
+ * and vPortFree() and the fragmentation of the heap under a random workload.
+ * See heap_benchmark_task.c. */
+#define democonfigCREATE_HEAP_BENCHMARK_TASK               0
+#define democonfigHEAP_BENCHMARK_TASK_STACK_SIZE           ( configMINIMAL_STACK_SIZE )
+
+/* Set to 1 to create the task that simulates a fleet of devices, each with its
+ * own connection to the MQTT broker, to load test the broker.  Only available
+ * in the Linux build.  The fleet is configured in fleet_simulator_config.h. */
+#define democonfigCREATE_FLEET_SIMULATOR                   0
+#define democonfigFLEET_SIMULATOR_TASK_STACK_SIZE          ( configMINIMAL_STACK_SIZE * 4 )
+
+/* Set to 1 to create the task that moves the virtual clock forward past the
+ * keep-alive interval of the MQTT agent and checks that the agent keeps its
+ * connection to the broker simulator alive.  Requires
+ * democonfigUSE_SIMULATED_CLOCK.  See clock_skip_task.c. */
+#define democonfigCREATE_CLOCK_SKIP_TASK                   0
+#define democonfigCLOCK_SKIP_TASK_STACK_SIZE               ( configMINIMAL_STACK_SIZE )
+
 /**
  * @brief The MQTT client identifier used in this example.  Each client identifier
  * must be unique so edit as required to ensure no two clients connecting to the
@@ -73,8 +114,13 @@
  * Settings/Custom Endpoint, or using the describe-endpoint REST API (with
  * AWS CLI command line tool).
  *
+ * @note The Linux build sets the endpoint from the BROKER_ENDPOINT variable of
+ * its makefile.
+ *
  */
-#define democonfigMQTT_BROKER_ENDPOINT                     "...insert here..."
+#ifndef democonfigMQTT_BROKER_ENDPOINT
+    #define democonfigMQTT_BROKER_ENDPOINT                 "...insert here..."
+#endif
 
 /**
  * @brief The port to use for the demo.
@@ -89,7 +135,9 @@
  *
  * #define democonfigMQTT_BROKER_PORT    ( insert here. )
  */
-#define democonfigMQTT_BROKER_PORT                         ( 8883 )
+#ifndef democonfigMQTT_BROKER_PORT
+    #define democonfigMQTT_BROKER_PORT                     ( 8883 )
+#endif
 
 /**
  * @brief Server's root CA certificate.
@@ -225,7 +273,9 @@
  * current value is given as an example. Please update for your specific
  * hardware platform.
  */
-#define democonfigHARDWARE_PLATFORM_NAME    "WinSim"
+#ifndef democonfigHARDWARE_PLATFORM_NAME
+    #define democonfigHARDWARE_PLATFORM_NAME    "WinSim"
+#endif
 
 /**
  * @brief The name of the MQTT library used and its version, following an "@"
@@ -236,8 +286,50 @@
 /**
  * @brief Whether to use mutual authentication. If this macro is not set to 1
  * or not defined, then plaintext TCP will be used instead of TLS over TCP.
+ *
+ * @note The Linux build sets this from the TLS variable of its makefile.
+ */
+#ifndef democonfigUSE_TLS
+    #define democonfigUSE_TLS               1
+#endif
+
+/**
+ * @brief Set to 1 to connect to the MQTT broker with the sockets of the host
+ * instead of FreeRTOS+TCP.  Set by the FreeRTOSConfig.h of the Linux build,
+ * which runs on the FreeRTOS POSIX port.
+ */
+#ifndef democonfigUSE_POSIX_SOCKETS
+    #define democonfigUSE_POSIX_SOCKETS     0
+#endif
+
+/**
+ * @brief Set to 1 to connect the MQTT agent to the in-process broker simulator
+ * in source/broker-simulator instead of the MQTT broker, so the agent and the
+ * demo tasks can be run without a network.  The simulated network is
+ * configured in broker_simulator_config.h.  The simulator does not support TLS,
+ * so democonfigUSE_TLS must be set to 0.
+ *
+ * @note The Linux build sets this from the BROKER_SIMULATOR variable of its
+ * makefile.
  */
-#define democonfigUSE_TLS                   1
+#ifndef democonfigUSE_BROKER_SIMULATOR
+    #define democonfigUSE_BROKER_SIMULATOR    0
+#endif
+
+/**
+ * @brief Set to 1 to measure the time of the MQTT agent and the broker
+ * simulator with the virtual clock in source/clock-tools instead of the tick
+ * count, so keep-alive, timeouts and reconnect backoff run faster than real
+ * time and a test harness can move time forward.  The rate of the clock is
+ * set by clockconfigSIMULATED_US_PER_TICK.  A real broker keeps real time, so
+ * democonfigUSE_BROKER_SIMULATOR must be set to 1.
+ *
+ * @note The Linux build sets this from the SIMULATED_CLOCK variable of its
+ * makefile.
+ */
+#ifndef democonfigUSE_SIMULATED_CLOCK
+    #define democonfigUSE_SIMULATED_CLOCK    0
+#endif
 
 /**
  * @brief Set the stack size of the main demo task.
@@ -270,6 +362,28 @@
     #error  "Please define democonfigCLIENT_IDENTIFIER in demo_config.h to something unique for this device."
 #endif
 
+#if ( democonfigUSE_POSIX_SOCKETS == 1 )
+    #if ( democonfigCREATE_DEFENDER_DEMO != 0 )
+        #error "The defender demo collects its metrics from FreeRTOS+TCP so cannot be built with democonfigUSE_POSIX_SOCKETS set to 1."
+    #endif
+#endif
+
+#if ( democonfigCREATE_FLEET_SIMULATOR != 0 ) && ( democonfigUSE_POSIX_SOCKETS != 1 )
+    #error "The fleet simulator uses the sockets of the host so can only be built with democonfigUSE_POSIX_SOCKETS set to 1."
+#endif
+
+#if ( democonfigUSE_BROKER_SIMULATOR == 1 ) && defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
+    #error "The broker simulator does not support TLS so cannot be used with democonfigUSE_TLS set to 1."
+#endif
+
+#if ( democonfigUSE_SIMULATED_CLOCK == 1 ) && ( democonfigUSE_BROKER_SIMULATOR != 1 )
+    #error "The simulated clock does not pass at the rate of a real broker's clock so can only be used with democonfigUSE_BROKER_SIMULATOR set to 1."
+#endif
+
+#if ( democonfigCREATE_CLOCK_SKIP_TASK != 0 ) && ( democonfigUSE_SIMULATED_CLOCK != 1 )
+    #error "The clock skip task moves the simulated clock so can only be created with democonfigUSE_SIMULATED_CLOCK set to 1."
+#endif
+
 
 #if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
     #ifndef democonfigROOT_CA_PEM
@@ -0,0 +1,130 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file fleet_simulator_config.h
+ * @brief Settings for the device fleet simulator.
+ *
+ * The simulator is only started when democonfigCREATE_FLEET_SIMULATOR is set
+ * to 1 in demo_config.h, which needs the sockets of the host of the Linux
+ * build.
+ */
+
+#ifndef FLEET_SIMULATOR_CONFIG_H_
+#define FLEET_SIMULATOR_CONFIG_H_
+
+/**
+ * @brief The number of simulated devices.  Each device has a connection to the
+ * broker, so the limit on the number of open files of the process, see
+ * "ulimit -n", must be above this.
+ */
+#define fleetsimconfigDEVICE_COUNT                     ( 1000U )
+
+/**
+ * @brief The client identifier of each device is this prefix followed by the
+ * number of the device, which is also the name of the thing of its shadow.
+ */
+#define fleetsimconfigCLIENT_IDENTIFIER_PREFIX         "fleet-sim-"
+
+/**
+ * @brief The number of devices that start connecting to the broker each
+ * second, so the fleet ramps up rather than connecting all at once.  Devices
+ * that lose their connection reconnect with exponential backoff.
+ */
+#define fleetsimconfigCONNECTS_PER_SECOND              ( 100U )
+
+/**
+ * @brief Time to wait for the TCP connection and then the CONNACK.  Devices
+ * connect one at a time, so the event loop is paused while a device connects.
+ */
+#define fleetsimconfigCONNECT_TIMEOUT_MS               ( 2000U )
+
+/**
+ * @brief The MQTT keep-alive interval of each device.
+ */
+#define fleetsimconfigKEEP_ALIVE_SECONDS               ( 60U )
+
+/**
+ * @brief Average time between the telemetry messages of a device, and the
+ * percentage the time of each message is randomly moved by.  The first message
+ * of each device is sent at a random point in its interval, so the load is
+ * spread evenly over time.
+ */
+#define fleetsimconfigTELEMETRY_INTERVAL_MS            ( 10000U )
+#define fleetsimconfigTELEMETRY_JITTER_PERCENT         ( 10U )
+
+/**
+ * @brief QoS of the telemetry messages.  The round trip time of the QoS 1
+ * messages is measured until the PUBACK.
+ */
+#define fleetsimconfigTELEMETRY_QOS                    ( 1U )
+
+/**
+ * @brief Average time between changes to the state of a device, which are
+ * reported to its shadow, and the time changes are coalesced for before an
+ * update is sent.
+ */
+#define fleetsimconfigSHADOW_CHANGE_INTERVAL_MS        ( 60000U )
+#define fleetsimconfigSHADOW_COALESCING_WINDOW_MS      ( 1000U )
+
+/**
+ * @brief Time to wait for the response to a shadow update.  Brokers other
+ * than AWS IoT Core do not respond, so their updates time out.
+ */
+#define fleetsimconfigSHADOW_RESPONSE_TIMEOUT_MS       ( 5000U )
+
+/**
+ * @brief The number of QoS 1 publishes each device can have waiting for a
+ * PUBACK.  A telemetry message due while that many are waiting is skipped.
+ */
+#define fleetsimconfigMAX_OUTSTANDING_PUBLISHES        ( 4U )
+
+/**
+ * @brief Size of the buffer each device uses to serialize and deserialize MQTT
+ * packets, which limits the size of the packets it can receive.
+ */
+#define fleetsimconfigNETWORK_BUFFER_SIZE              ( 512U )
+
+/**
+ * @brief Size of the buffers that hold the bytes each device has received from
+ * its socket and not yet processed, and the bytes it has written and not yet
+ * sent.  The receive buffer must hold a whole packet.
+ */
+#define fleetsimconfigRECEIVE_BUFFER_SIZE              ( 1024U )
+#define fleetsimconfigSEND_BUFFER_SIZE                 ( 1024U )
+
+/**
+ * @brief The largest number of readable sockets returned by one poll.
+ */
+#define fleetsimconfigMAX_EVENTS_PER_POLL              ( 256U )
+
+/**
+ * @brief Time between the summaries logged by the simulator.
+ */
+#define fleetsimconfigREPORT_INTERVAL_MS               ( 10000U )
+
+#endif /* FLEET_SIMULATOR_CONFIG_H_ */
@@ -0,0 +1,146 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file logging_binary.h
+ * @brief Logging macros used when LOG_BINARY is set to 1 in logging_config.h.
+ *
+ * Instead of formatting text on the device, each call site records the
+ * identifier of its format string, the tick count and the raw values of its
+ * arguments.  The format strings are placed in the .log_formats section, which
+ * the linker script marks as not loaded, so they take no space in the image
+ * and the address of each string is its identifier.  The build extracts the
+ * section into a format table, and decode_binary_log.py uses the table to turn
+ * the records back into text on the host.
+ *
+ * Each argument is recorded as a 32-bit word, except that arguments whose
+ * type is char * or const char * are recorded as the characters of the string,
+ * truncated to logbinaryMAX_STRING_LENGTH characters.  Arguments wider than 32
+ * bits, such as 64-bit integers and floating point values, are not supported.
+ * At most logbinaryMAX_ARGUMENTS arguments can follow the format string.
+ *
+ * The macros use GCC extensions and C11 _Generic, so binary logging is only
+ * available in GCC builds.
+ */
+
+#ifndef LOGGING_BINARY_H
+#define LOGGING_BINARY_H
+
+#include <stdint.h>
+
+#ifndef __GNUC__
+    #error "LOG_BINARY requires a GCC build."
+#endif
+
+/**
+ * @brief Maximum number of arguments after the format string.
+ */
+#define logbinaryMAX_ARGUMENTS        10
+
+/**
+ * @brief Maximum number of characters recorded for a string argument.
+ */
+#define logbinaryMAX_STRING_LENGTH    24
+
+/**
+ * @brief First byte of every binary log record.  It is not a valid ASCII
+ * character, so the decoder can tell records from text written by other
+ * loggers.
+ */
+#define logbinaryRECORD_MARKER        0xA5
+
+/*
+ * Record a log message.  ulFormatId is the address of the format string in the
+ * .log_formats section.  Bit i of ulStringMask is set if argument i is a
+ * string.  The arguments follow as uint32_t values.
+ */
+void vLoggingPrintBinary( uint32_t ulLevel,
+                          uint32_t ulFormatId,
+                          uint32_t ulArgumentCount,
+                          uint32_t ulStringMask,
+                          ... );
+
+/* Split the parenthesised message passed to the logging macros into its
+ * format string and its arguments. */
+#define logbinaryFORMAT( pcFormat, ... )       pcFormat
+#define logbinaryARGUMENTS( pcFormat, ... )    __VA_ARGS__
+
+/* Number of arguments in a possibly empty argument list. */
+#define logbinaryCOUNT( ... )                  logbinaryNTH( _, ## __VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 )
+#define logbinaryNTH( _0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, N, ... )    N
+
+#define logbinaryCONCAT( a, b )                logbinaryCONCAT_( a, b )
+#define logbinaryCONCAT_( a, b )               a ## b
+
+/* An argument as a 32-bit word, and whether it is a string. */
+#define logbinaryWORD( x )                     , ( uint32_t ) ( uintptr_t ) ( x )
+#define logbinaryIS_STRING( x )                _Generic( ( x ), char * : 1U, const char * : 1U, default : 0U )
+
+/* Expand to the words of up to logbinaryMAX_ARGUMENTS arguments, each
+ * preceded by a comma. */
+#define logbinaryWORDS_0()
+#define logbinaryWORDS_1( a )                                   logbinaryWORD( a )
+#define logbinaryWORDS_2( a, b )                                logbinaryWORD( a ) logbinaryWORDS_1( b )
+#define logbinaryWORDS_3( a, b, c )                             logbinaryWORD( a ) logbinaryWORDS_2( b, c )
+#define logbinaryWORDS_4( a, b, c, d )                          logbinaryWORD( a ) logbinaryWORDS_3( b, c, d )
+#define logbinaryWORDS_5( a, b, c, d, e )                       logbinaryWORD( a ) logbinaryWORDS_4( b, c, d, e )
+#define logbinaryWORDS_6( a, b, c, d, e, f )                    logbinaryWORD( a ) logbinaryWORDS_5( b, c, d, e, f )
+#define logbinaryWORDS_7( a, b, c, d, e, f, g )                 logbinaryWORD( a ) logbinaryWORDS_6( b, c, d, e, f, g )
+#define logbinaryWORDS_8( a, b, c, d, e, f, g, h )              logbinaryWORD( a ) logbinaryWORDS_7( b, c, d, e, f, g, h )
+#define logbinaryWORDS_9( a, b, c, d, e, f, g, h, i )           logbinaryWORD( a ) logbinaryWORDS_8( b, c, d, e, f, g, h, i )
+#define logbinaryWORDS_10( a, b, c, d, e, f, g, h, i, j )       logbinaryWORD( a ) logbinaryWORDS_9( b, c, d, e, f, g, h, i, j )
+
+/* Expand to the string mask of up to logbinaryMAX_ARGUMENTS arguments. */
+#define logbinaryMASK_0()                                       0U
+#define logbinaryMASK_1( a )                                    ( logbinaryIS_STRING( a ) )
+#define logbinaryMASK_2( a, b )                                 ( logbinaryIS_STRING( a ) | ( logbinaryMASK_1( b ) << 1 ) )
+#define logbinaryMASK_3( a, b, c )                              ( logbinaryIS_STRING( a ) | ( logbinaryMASK_2( b, c ) << 1 ) )
+#define logbinaryMASK_4( a, b, c, d )                           ( logbinaryIS_STRING( a ) | ( logbinaryMASK_3( b, c, d ) << 1 ) )
+#define logbinaryMASK_5( a, b, c, d, e )                        ( logbinaryIS_STRING( a ) | ( logbinaryMASK_4( b, c, d, e ) << 1 ) )
+#define logbinaryMASK_6( a, b, c, d, e, f )                     ( logbinaryIS_STRING( a ) | ( logbinaryMASK_5( b, c, d, e, f ) << 1 ) )
+#define logbinaryMASK_7( a, b, c, d, e, f, g )                  ( logbinaryIS_STRING( a ) | ( logbinaryMASK_6( b, c, d, e, f, g ) << 1 ) )
+#define logbinaryMASK_8( a, b, c, d, e, f, g, h )               ( logbinaryIS_STRING( a ) | ( logbinaryMASK_7( b, c, d, e, f, g, h ) << 1 ) )
+#define logbinaryMASK_9( a, b, c, d, e, f, g, h, i )            ( logbinaryIS_STRING( a ) | ( logbinaryMASK_8( b, c, d, e, f, g, h, i ) << 1 ) )
+#define logbinaryMASK_10( a, b, c, d, e, f, g, h, i, j )        ( logbinaryIS_STRING( a ) | ( logbinaryMASK_9( b, c, d, e, f, g, h, i, j ) << 1 ) )
+
+#define logbinaryCALL( ulLevel, pcFormat, ... )                                                                      \
+    do {                                                                                                             \
+        static const char pcLogFormat[] __attribute__( ( section( ".log_formats" ) ) ) = pcFormat;                  \
+        vLoggingPrintBinary( ( ulLevel ),                                                                            \
+                             ( uint32_t ) ( uintptr_t ) pcLogFormat,                                                 \
+                             logbinaryCOUNT( __VA_ARGS__ ),                                                          \
+                             ( logbinaryCONCAT( logbinaryMASK_, logbinaryCOUNT( __VA_ARGS__ ) )( __VA_ARGS__ ) )     \
+                             logbinaryCONCAT( logbinaryWORDS_, logbinaryCOUNT( __VA_ARGS__ ) )( __VA_ARGS__ ) ); \
+    } while( 0 )
+
+/**
+ * @brief Record a message passed to one of the logging macros, for example
+ * logbinaryPRINT( LOG_INFO, ( "Value %d", lValue ) ).
+ */
+#define logbinaryPRINT( ulLevel, message )    logbinaryCALL( ulLevel, logbinaryFORMAT message, logbinaryARGUMENTS message )
+
+#endif /* LOGGING_BINARY_H */
@@ -41,10 +41,69 @@
 /**************************************************/
 
 /*
- * Change the following macro to set the demo logging level.
+ * Change the following macro to set the demo logging level.  Messages above
+ * this level are compiled out.  Messages at or below it can be enabled and
+ * disabled at runtime for each module - see below.
  */
 #define LOG_LEVEL    LOG_DEBUG
 
+/*
+ * The modules whose logging level can be changed at runtime, and the names
+ * used to select them with xLoggingSetLevels().  A source file logs as the
+ * module named by LOG_MODULE, which it defines before including any header,
+ * for example:
+ *
+ * #define LOG_MODULE    eLogModuleOta
+ *
+ * Files that do not define LOG_MODULE, such as the sources of the libraries
+ * included as submodules, log as eLogModuleDefault.  Every module starts at
+ * LOG_LEVEL.
+ */
+#define logMODULES( X )              \
+    X( Default, "default" )          \
+    X( Agent, "agent" )              \
+    X( Transport, "transport" )      \
+    X( Tls, "tls" )                  \
+    X( PubSub, "pubsub" )            \
+    X( Ota, "ota" )                  \
+    X( Shadow, "shadow" )            \
+    X( Defender, "defender" )        \
+    X( Fleet, "fleet" )
+
+#define logMODULE_ENUMERATOR( xName, pcName )    eLogModule ## xName,
+
+typedef enum
+{
+    logMODULES( logMODULE_ENUMERATOR )
+    eLogModuleCount
+} LogModule_t;
+
+#ifndef LOG_MODULE
+    #define LOG_MODULE    eLogModuleDefault
+#endif
+
+/*
+ * Set LOG_RATE_LIMIT to 1 to limit the rate of the messages logged by each
+ * call site with a token bucket.  A call site can log LOG_RATE_LIMIT_BURST
+ * messages in a row, then one more message every LOG_RATE_LIMIT_INTERVAL_MS
+ * milliseconds.  Messages above that rate are dropped before they are
+ * formatted, and the next message the call site logs is preceded by the number
+ * of messages dropped.
+ */
+#define LOG_RATE_LIMIT                1
+#define LOG_RATE_LIMIT_BURST          ( 10U )
+#define LOG_RATE_LIMIT_INTERVAL_MS    ( 200U )
+
+/*
+ * The token bucket of a call site.  Zero initialised, which is a full bucket.
+ */
+typedef struct LogRateLimit
+{
+    uint32_t ulLastRefillTime;
+    uint16_t usTokensUsed;
+    uint16_t usSuppressed;
+} LogRateLimit_t;
+
 /*
  * Logging configuration.
  *
@@ -53,7 +112,10 @@
  * the output port before outputting metadata about the log.  Second
  * vLoggingPrintf() writes the log message itself before releasing the mutex.
  * These are the prototypes of the functions and the definitions of the macros
- * that call them - there is one macro per severity level.
+ * that call them - there is one macro per severity level.  The QEMU and Linux
+ * builds do not use a mutex: xLoggingPrintMetadata() only records the level,
+ * and vLoggingPrintf() formats the message into a lock-free ring of log
+ * records that a low priority task writes to the UART or standard output.
  *
  * If you want to print out additional metadata then update the
  * xLoggingPrintMetadata() function prototype and implementation so it accepts
@@ -77,30 +139,103 @@ void vLoggingPrintf( const char * const pcFormatString,
 int32_t xLoggingPrintMetadata( const char * const pcLevel );
 void vLoggingInit( void );
 
+/*
+ * The runtime logging level of each module, indexed by LogModule_t.  Only read
+ * by the logging macros - use xLoggingSetLevels() to change it.
+ */
+extern uint8_t ucLoggingModuleLevels[ eLogModuleCount ];
+
+/*
+ * Take a token from the bucket of a call site.  Returns non-zero if the
+ * message can be logged, in which case *pulSuppressed is set to the number of
+ * messages from the call site dropped since it last logged.
+ */
+int32_t xLoggingRateLimit( LogRateLimit_t * pxRateLimit,
+                           uint32_t * pulSuppressed );
+
+/*
+ * Set the runtime logging level of modules from a list of comma separated
+ * module=level settings, for example "tls=debug,ota=warn".  The module is one
+ * of the names in logMODULES(), or "*" for every module.  The level is "none",
+ * "error", "warn", "info", "debug" or a number, and is reduced to LOG_LEVEL if
+ * it is above it.  Returns the number of settings applied, or -1 without
+ * changing any level if a setting is invalid.
+ */
+int32_t xLoggingSetLevels( const char * pcSettings,
+                           size_t xSettingsLength );
+
+/*
+ * Set LOG_BINARY to 1 to log in binary instead of text.  Each message is then
+ * recorded as the identifier of its format string, the tick count and the raw
+ * values of its arguments, and is formatted on the host by
+ * decode_binary_log.py using the format table extracted from the image - see
+ * logging_binary.h.  Binary logging is only available in the QEMU build.
+ */
+#define LOG_BINARY    0
+
 /* See comments immediately above for instructions on changing the verboseness
  * of the logging and adding data such as the function that called the logging
  * macro to the logged output.
  */
+#if ( LOG_BINARY == 1 )
+    #include "logging_binary.h"
+    #define logPRINT( ulLevel, pcLevel, message )    logbinaryPRINT( ulLevel, message )
+#else
+    #define logPRINT( ulLevel, pcLevel, message )    do { xLoggingPrintMetadata( pcLevel ); vLoggingPrintf message; } while( 0 )
+#endif
+
+/* A message whose level is disabled for the module of the call site costs a
+ * single comparison with the level of the module. */
+#if ( LOG_RATE_LIMIT == 1 )
+    #define logMESSAGE( ulLevel, pcLevel, message )                                                 \
+    do {                                                                                            \
+        if( ucLoggingModuleLevels[ LOG_MODULE ] >= ( ulLevel ) )                                    \
+        {                                                                                           \
+            static LogRateLimit_t xLogRateLimit;                                                    \
+            uint32_t ulLogSuppressed;                                                               \
+                                                                                                    \
+            if( xLoggingRateLimit( &xLogRateLimit, &ulLogSuppressed ) != 0 )                        \
+            {                                                                                       \
+                if( ulLogSuppressed != 0UL )                                                        \
+                {                                                                                   \
+                    logPRINT( ulLevel, pcLevel, ( "%lu messages from this call site were dropped.", \
+                                                  ( unsigned long ) ulLogSuppressed ) );            \
+                }                                                                                   \
+                                                                                                    \
+                logPRINT( ulLevel, pcLevel, message );                                              \
+            }                                                                                       \
+        }                                                                                           \
+    } while( 0 )
+#else
+    #define logMESSAGE( ulLevel, pcLevel, message )                      \
+    do {                                                                 \
+        if( ucLoggingModuleLevels[ LOG_MODULE ] >= ( ulLevel ) )         \
+        {                                                                \
+            logPRINT( ulLevel, pcLevel, message );                       \
+        }                                                                \
+    } while( 0 )
+#endif
+
 #if LOG_LEVEL >= LOG_ERROR
-    #define LogError( message )    do { xLoggingPrintMetadata( "ERROR" ); vLoggingPrintf message; } while( 0 )
+    #define LogError( message )    logMESSAGE( LOG_ERROR, "ERROR", message )
 #else
     #define LogError( message )
 #endif
 
 #if LOG_LEVEL >= LOG_WARN
-    #define LogWarn( message )    do { xLoggingPrintMetadata( "WARN" ); vLoggingPrintf message; } while( 0 )
+    #define LogWarn( message )    logMESSAGE( LOG_WARN, "WARN", message )
 #else
     #define LogWarn( message )
 #endif
 
 #if LOG_LEVEL >= LOG_INFO
-    #define LogInfo( message )    do { xLoggingPrintMetadata( "INFO" ); vLoggingPrintf message; } while( 0 )
+    #define LogInfo( message )    logMESSAGE( LOG_INFO, "INFO", message )
 #else
     #define LogInfo( message )
 #endif
 
 #if LOG_LEVEL >= LOG_DEBUG
-    #define LogDebug( message )    do { xLoggingPrintMetadata( "DEBUG" ); vLoggingPrintf message; } while( 0 )
+    #define LogDebug( message )    logMESSAGE( LOG_DEBUG, "DEBUG", message )
 #else
     #define LogDebug( message )
 #endif
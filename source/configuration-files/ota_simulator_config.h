@@ -0,0 +1,108 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file ota_simulator_config.h
+ * @brief Settings for the in-process OTA job and stream simulator.
+ *
+ * The simulator is only built into the OTA demo when
+ * democonfigOTA_USE_STREAM_SIMULATOR is set to 1 in demo_config.h.
+ */
+
+#ifndef OTA_SIMULATOR_CONFIG_H_
+#define OTA_SIMULATOR_CONFIG_H_
+
+/**
+ * @brief Size in bytes of the synthetic image served by the simulator.
+ */
+#define otasimconfigIMAGE_SIZE                  ( 64UL * 1024UL )
+
+/**
+ * @brief Path at which the OTA PAL stores the downloaded image.
+ */
+#define otasimconfigIMAGE_FILE_PATH             "ota_simulator_image.bin"
+
+/**
+ * @brief Path of the code signing certificate reported in the job document.
+ *
+ * The Windows PAL falls back to the certificate compiled in from
+ * aws_ota_codesigner_certificate.h when this file cannot be read.
+ */
+#define otasimconfigCERTIFICATE_FILE_PATH       "ota_simulator_signer.crt"
+
+/**
+ * @brief Base64 encoded ECDSA signature of the image placed in the job document.
+ *
+ * The default value is a well formed signature that does not match the
+ * synthetic image, so the download completes, the whole image is hashed and
+ * the signature check runs, but the job is reported as failed.  Replace it with
+ * the signature of the synthetic image (and the signer certificate with the
+ * matching one) to exercise the full activation path.
+ */
+#define otasimconfigIMAGE_SIGNATURE             "MEQCIEVDSeQi8FKXGR6tE+IdPbUg5avvUgVeSWS4L7IT9ZOhAiAEOnGHdMVyvYolrb6xv81cAlauEc7Pn5w/kl0OUr6viQ=="
+
+/**
+ * @brief Percentage (0 to 100) of stream blocks that are silently dropped.
+ */
+#define otasimconfigLOSS_PERCENT                ( 0U )
+
+/**
+ * @brief Percentage (0 to 100) of stream blocks that are held back by
+ * #otasimconfigREORDER_DELAY_MS so later blocks overtake them.
+ */
+#define otasimconfigREORDER_PERCENT             ( 0U )
+
+/**
+ * @brief Extra delay applied to blocks selected for reordering.
+ */
+#define otasimconfigREORDER_DELAY_MS            ( 50U )
+
+/**
+ * @brief Percentage (0 to 100) of stream blocks that are delivered twice.
+ */
+#define otasimconfigDUPLICATE_PERCENT           ( 0U )
+
+/**
+ * @brief Minimum and maximum one way latency applied to every message sent
+ * from the simulated service to the device.  The latency of each message is
+ * chosen at random between the two values.
+ */
+#define otasimconfigMIN_LATENCY_MS              ( 0U )
+#define otasimconfigMAX_LATENCY_MS              ( 0U )
+
+/**
+ * @brief The number of messages that can be waiting for delivery at any one
+ * time.  Responses that do not fit are dropped and counted as overflows.
+ */
+#define otasimconfigMAX_PENDING_MESSAGES        ( 8U )
+
+/**
+ * @brief Stack size and priority of the task that delivers simulated messages.
+ */
+#define otasimconfigTASK_STACK_SIZE             ( configMINIMAL_STACK_SIZE * 4 )
+#define otasimconfigTASK_PRIORITY               ( tskIDLE_PRIORITY + 1 )
+
+#endif /* OTA_SIMULATOR_CONFIG_H_ */
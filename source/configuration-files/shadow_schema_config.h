@@ -0,0 +1,50 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_schema_config.h
+ * @brief Properties of the device shadow used by the shadow demo tasks.
+ *
+ * The list is expanded by shadow_schema.h into the property indexes, the
+ * state structure, the document templates and the delta parser, so adding a
+ * property here is the only change needed to serialize and parse it.  Every
+ * property holds an unsigned 32-bit value; true and false are held as 1 and 0.
+ */
+
+#ifndef SHADOW_SCHEMA_CONFIG_H_
+#define SHADOW_SCHEMA_CONFIG_H_
+
+/**
+ * @brief The shadow properties.  Each entry is X( name ), where name is both
+ * the key in the shadow document and the C identifier of the property.
+ *
+ * At most shadowcacheMAX_PROPERTIES properties can be listed.
+ */
+#define shadowschemaPROPERTIES( X ) \
+    X( powerOn )
+
+#endif /* SHADOW_SCHEMA_CONFIG_H_ */
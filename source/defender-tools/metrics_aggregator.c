@@ -0,0 +1,217 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file metrics_aggregator.c
+ *
+ * @brief Implementation of the metric aggregation functions used by the
+ * defender demo.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/* Interface include. */
+#include "metrics_aggregator.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Open a new, empty window.
+ *
+ * @param[in] pxMetric The metric whose window is reset.
+ */
+static void prvResetWindow( AggregatedMetric_t * pxMetric );
+
+/**
+ * @brief Check whether a sample moves the metric across one of its
+ * thresholds, and record which side of the thresholds the metric is on.
+ *
+ * @param[in] pxMetric The metric the sample belongs to.
+ * @param[in] ulSample The sample.
+ *
+ * @return true if a threshold is crossed; false otherwise.
+ */
+static bool prvCrossesThreshold( AggregatedMetric_t * pxMetric,
+                                 uint32_t ulSample );
+
+/**
+ * @brief Check whether a sample differs sharply from the mean of the recent
+ * samples of the metric.
+ *
+ * @param[in] pxMetric The metric the sample belongs to.
+ * @param[in] ulSample The sample.
+ *
+ * @return true if the change is sharp; false otherwise.
+ */
+static bool prvIsSharpChange( const AggregatedMetric_t * pxMetric,
+                              uint32_t ulSample );
+
+/*-----------------------------------------------------------*/
+
+static void prvResetWindow( AggregatedMetric_t * pxMetric )
+{
+    ( void ) memset( &( pxMetric->xWindow ), 0, sizeof( MetricWindow_t ) );
+    pxMetric->ullWindowSum = 0ULL;
+}
+/*-----------------------------------------------------------*/
+
+static bool prvCrossesThreshold( AggregatedMetric_t * pxMetric,
+                                 uint32_t ulSample )
+{
+    bool xBelowLowThreshold = ( ulSample < pxMetric->xConfig.ulLowThreshold );
+    bool xAboveHighThreshold = ( ulSample > pxMetric->xConfig.ulHighThreshold );
+    bool xCrossed;
+
+    /* Only the transitions are significant, so a value that stays beyond a
+     * threshold does not keep flagging every sample. */
+    xCrossed = ( ( xBelowLowThreshold != pxMetric->xBelowLowThreshold ) ||
+                 ( xAboveHighThreshold != pxMetric->xAboveHighThreshold ) );
+
+    pxMetric->xBelowLowThreshold = xBelowLowThreshold;
+    pxMetric->xAboveHighThreshold = xAboveHighThreshold;
+
+    return xCrossed;
+}
+/*-----------------------------------------------------------*/
+
+static bool prvIsSharpChange( const AggregatedMetric_t * pxMetric,
+                              uint32_t ulSample )
+{
+    bool xSharpChange = false;
+    uint32_t ulMean, ulDifference;
+
+    if( ( pxMetric->xConfig.ulChangePercent != 0U ) && ( pxMetric->ulStoredSamples != 0U ) )
+    {
+        ulMean = ( uint32_t ) ( pxMetric->ullSampleSum / pxMetric->ulStoredSamples );
+        ulDifference = ( ulSample > ulMean ) ? ( ulSample - ulMean ) : ( ulMean - ulSample );
+
+        /* Compare in 64 bits so large values cannot overflow. */
+        xSharpChange = ( ( ulDifference >= pxMetric->xConfig.ulMinimumChange ) &&
+                         ( ( ( uint64_t ) ulDifference * 100ULL ) >
+                           ( ( uint64_t ) ulMean * pxMetric->xConfig.ulChangePercent ) ) );
+    }
+
+    return xSharpChange;
+}
+/*-----------------------------------------------------------*/
+
+void vMetricsAggregatorInit( AggregatedMetric_t * pxMetric,
+                             const AggregatedMetricConfig_t * pxConfig )
+{
+    configASSERT( pxMetric != NULL );
+    configASSERT( pxConfig != NULL );
+
+    ( void ) memset( pxMetric, 0, sizeof( AggregatedMetric_t ) );
+    pxMetric->xConfig = *pxConfig;
+    prvResetWindow( pxMetric );
+}
+/*-----------------------------------------------------------*/
+
+bool xMetricsAggregatorAddSample( AggregatedMetric_t * pxMetric,
+                                  uint32_t ulSample )
+{
+    bool xSignificant;
+    bool xCrossed;
+    MetricWindow_t * pxWindow;
+
+    configASSERT( pxMetric != NULL );
+
+    /* Evaluate both conditions so the threshold state is always updated. */
+    xCrossed = prvCrossesThreshold( pxMetric, ulSample );
+    xSignificant = ( prvIsSharpChange( pxMetric, ulSample ) || xCrossed );
+
+    /* Replace the oldest sample in the ring buffer once it is full, keeping
+     * the running sum in step. */
+    if( pxMetric->ulStoredSamples == metricsaggregatorSAMPLES_PER_METRIC )
+    {
+        pxMetric->ullSampleSum -= pxMetric->pulSamples[ pxMetric->ulNextSampleIndex ];
+    }
+    else
+    {
+        pxMetric->ulStoredSamples++;
+    }
+
+    pxMetric->pulSamples[ pxMetric->ulNextSampleIndex ] = ulSample;
+    pxMetric->ullSampleSum += ulSample;
+    pxMetric->ulNextSampleIndex = ( pxMetric->ulNextSampleIndex + 1U ) % metricsaggregatorSAMPLES_PER_METRIC;
+
+    /* Update the window. */
+    pxWindow = &( pxMetric->xWindow );
+
+    if( pxWindow->ulSampleCount == 0U )
+    {
+        pxWindow->ulMin = ulSample;
+        pxWindow->ulMax = ulSample;
+    }
+    else
+    {
+        if( ulSample < pxWindow->ulMin )
+        {
+            pxWindow->ulMin = ulSample;
+        }
+
+        if( ulSample > pxWindow->ulMax )
+        {
+            pxWindow->ulMax = ulSample;
+        }
+    }
+
+    pxWindow->ulLast = ulSample;
+    pxWindow->ulSampleCount++;
+    pxMetric->ullWindowSum += ulSample;
+
+    if( xSignificant == true )
+    {
+        pxWindow->xSignificantChange = true;
+    }
+
+    return xSignificant;
+}
+/*-----------------------------------------------------------*/
+
+void vMetricsAggregatorCloseWindow( AggregatedMetric_t * pxMetric,
+                                    MetricWindow_t * pxOutWindow )
+{
+    configASSERT( pxMetric != NULL );
+    configASSERT( pxOutWindow != NULL );
+
+    *pxOutWindow = pxMetric->xWindow;
+
+    if( pxOutWindow->ulSampleCount != 0U )
+    {
+        pxOutWindow->ulMean = ( uint32_t ) ( pxMetric->ullWindowSum / pxOutWindow->ulSampleCount );
+    }
+
+    prvResetWindow( pxMetric );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,136 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file metrics_aggregator.h
+ *
+ * @brief Functions used by the defender demo to sample metrics more often than
+ * reports are sent, so that peaks between reports are not lost.
+ *
+ * Each metric keeps its most recent samples in a fixed size ring buffer and
+ * the minimum, maximum, mean and last value of the samples added since its
+ * window was last closed.  A sample is flagged as significant when it moves
+ * the value across one of the configured thresholds, or when it differs
+ * sharply from the mean of the samples in the ring buffer.  No memory is
+ * allocated.
+ */
+
+#ifndef METRICS_AGGREGATOR_H_
+#define METRICS_AGGREGATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Number of recent samples kept for each metric.  Sharp changes are
+ * detected against the mean of these samples.  Can be overridden in
+ * demo_config.h.
+ */
+#ifndef metricsaggregatorSAMPLES_PER_METRIC
+    #define metricsaggregatorSAMPLES_PER_METRIC    ( 8U )
+#endif
+
+/**
+ * @brief Value of AggregatedMetricConfig_t.ulHighThreshold that disables the
+ * high threshold.
+ */
+#define metricsaggregatorNO_HIGH_THRESHOLD         ( UINT32_MAX )
+
+/**
+ * @brief Settings that decide which samples of a metric are significant.
+ */
+typedef struct AggregatedMetricConfig
+{
+    uint32_t ulLowThreshold;  /**< Crossing below this value is significant. 0 disables the low threshold. */
+    uint32_t ulHighThreshold; /**< Crossing above this value is significant. #metricsaggregatorNO_HIGH_THRESHOLD disables the high threshold. */
+    uint32_t ulChangePercent; /**< Differing from the mean of the recent samples by more than this percentage is significant. 0 disables change detection. */
+    uint32_t ulMinimumChange; /**< Smallest difference from the mean treated as a sharp change, so small values do not trigger on noise. */
+} AggregatedMetricConfig_t;
+
+/**
+ * @brief Summary of the samples added to a metric during one window.
+ */
+typedef struct MetricWindow
+{
+    uint32_t ulMin;           /**< Smallest sample in the window. */
+    uint32_t ulMax;           /**< Largest sample in the window. */
+    uint32_t ulMean;          /**< Mean of the samples in the window, rounded down. */
+    uint32_t ulLast;          /**< Most recent sample in the window. */
+    uint32_t ulSampleCount;   /**< Number of samples in the window. */
+    bool xSignificantChange;  /**< true if any sample in the window was significant. */
+} MetricWindow_t;
+
+/**
+ * @brief State of an aggregated metric.  Fields are private to
+ * metrics_aggregator.c and are exposed only so the structure can be allocated
+ * statically.
+ */
+typedef struct AggregatedMetric
+{
+    AggregatedMetricConfig_t xConfig;
+    uint32_t pulSamples[ metricsaggregatorSAMPLES_PER_METRIC ];
+    uint32_t ulNextSampleIndex;
+    uint32_t ulStoredSamples;
+    uint64_t ullSampleSum;
+    bool xBelowLowThreshold;
+    bool xAboveHighThreshold;
+    MetricWindow_t xWindow;
+    uint64_t ullWindowSum;
+} AggregatedMetric_t;
+
+/**
+ * @brief Initialize an aggregated metric and open its first window.
+ *
+ * @param[out] pxMetric The metric to initialize.
+ * @param[in] pxConfig Settings that decide which samples are significant.
+ */
+void vMetricsAggregatorInit( AggregatedMetric_t * pxMetric,
+                             const AggregatedMetricConfig_t * pxConfig );
+
+/**
+ * @brief Add a sample to a metric.
+ *
+ * @param[in] pxMetric The metric to add the sample to.
+ * @param[in] ulSample The sample.
+ *
+ * @return true if the sample is significant; false otherwise.
+ */
+bool xMetricsAggregatorAddSample( AggregatedMetric_t * pxMetric,
+                                  uint32_t ulSample );
+
+/**
+ * @brief Get the summary of the current window of a metric and open a new
+ * window.  The recent samples and threshold state are kept.
+ *
+ * @param[in] pxMetric The metric whose window is closed.
+ * @param[out] pxOutWindow The summary of the closed window.  All values are 0
+ * if no sample was added during the window.
+ */
+void vMetricsAggregatorCloseWindow( AggregatedMetric_t * pxMetric,
+                                    MetricWindow_t * pxOutWindow );
+
+#endif /* ifndef METRICS_AGGREGATOR_H_ */
@@ -32,6 +32,9 @@
  * is used to collect this metrics.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleDefender
+
 /* Standard includes. */
 #include <stdio.h>
 #include <ctype.h>
@@ -41,6 +44,7 @@
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 #include "FreeRTOS_IP.h"
 
 /* Demo config. */
@@ -48,44 +52,222 @@
 
 /* Interface include. */
 #include "metrics_collector.h"
+
+/**
+ * @brief Take a snapshot of the FreeRTOS+TCP metrics, or return the cached
+ * snapshot if it is younger than #metricscollectorSNAPSHOT_TTL_MS.
+ *
+ * @param[out] pxMetrics The snapshot.
+ *
+ * @return #eMetricsCollectorSuccess if the snapshot is obtained;
+ * #eMetricsCollectorCollectionFailed otherwise.
+ */
+static eMetricsCollectorStatus prvGetMetricsSnapshot( MetricsType_t * pxMetrics );
+
+/**
+ * @brief Fill the network stats from a snapshot.
+ */
+static void prvFillNetworkStats( const MetricsType_t * pxMetrics,
+                                 NetworkStats_t * pxOutNetworkStats );
+
+/**
+ * @brief Fill an array of ports from a list in a snapshot.
+ *
+ * @param[in] pusPortList The ports in the snapshot.
+ * @param[in] ulPortCount Number of ports in pusPortList.
+ * @param[out] pusOutPortsArray The array to write the ports into. Can be NULL.
+ * @param[in] ulPortsArrayLength Length of pusOutPortsArray.
+ *
+ * @return The number of ports written, or the total number of ports if
+ * pusOutPortsArray is NULL.
+ */
+static uint32_t prvFillPorts( const uint16_t * pusPortList,
+                              uint32_t ulPortCount,
+                              uint16_t * pusOutPortsArray,
+                              uint32_t ulPortsArrayLength );
+
+/**
+ * @brief Fill an array of established connections from a snapshot.
+ *
+ * @param[in] pxMetrics The snapshot.
+ * @param[out] pxOutConnectionsArray The array to write the connections into. Can be NULL.
+ * @param[in] ulConnectionsArrayLength Length of pxOutConnectionsArray.
+ *
+ * @return The number of connections written, or the total number of
+ * connections if pxOutConnectionsArray is NULL.
+ */
+static uint32_t prvFillConnections( const MetricsType_t * pxMetrics,
+                                    Connection_t * pxOutConnectionsArray,
+                                    uint32_t ulConnectionsArrayLength );
+
 /*-----------------------------------------------------------*/
 
-eMetricsCollectorStatus eGetNetworkStats( NetworkStats_t * pxOutNetworkStats )
+#if ( metricscollectorSNAPSHOT_TTL_MS > 0 )
+
+/**
+ * @brief The snapshot shared by all callers and the time at which it was taken.
+ */
+    static MetricsType_t xCachedMetrics;
+    static TickType_t xCachedMetricsTime = 0;
+    static BaseType_t xCachedMetricsValid = pdFALSE;
+#endif
+
+/*-----------------------------------------------------------*/
+
+static eMetricsCollectorStatus prvGetMetricsSnapshot( MetricsType_t * pxMetrics )
 {
     eMetricsCollectorStatus eStatus = eMetricsCollectorSuccess;
-
-    MetricsType_t xMetrics = { 0 };
     BaseType_t xMetricsStatus = 0;
+    BaseType_t xCacheHit = pdFALSE;
 
-    configASSERT( pxOutNetworkStats != NULL );
+    #if ( metricscollectorSNAPSHOT_TTL_MS > 0 )
+        /* The scheduler is suspended rather than a mutex taken so the cache
+         * needs no initialization. Only the copy is done with the scheduler
+         * suspended - vGetMetrics() is called with it running. */
+        vTaskSuspendAll();
+        {
+            if( ( xCachedMetricsValid == pdTRUE ) &&
+                ( ( xTaskGetTickCount() - xCachedMetricsTime ) < pdMS_TO_TICKS( metricscollectorSNAPSHOT_TTL_MS ) ) )
+            {
+                memcpy( pxMetrics, &xCachedMetrics, sizeof( MetricsType_t ) );
+                xCacheHit = pdTRUE;
+            }
+        }
+        ( void ) xTaskResumeAll();
+    #endif /* if ( metricscollectorSNAPSHOT_TTL_MS > 0 ) */
 
-    /* Start with everything as zero. */
-    memset( pxOutNetworkStats, 0, sizeof( NetworkStats_t ) );
+    if( xCacheHit == pdFALSE )
+    {
+        memset( pxMetrics, 0, sizeof( MetricsType_t ) );
 
-    /* Get metrics from FreeRTOS+TCP tcp_netstat utility. */
-    xMetricsStatus = vGetMetrics( &xMetrics );
+        /* Get metrics from FreeRTOS+TCP tcp_netstat utility. */
+        xMetricsStatus = vGetMetrics( pxMetrics );
 
-    if( xMetricsStatus != 0 )
+        if( xMetricsStatus != 0 )
+        {
+            LogError( ( "Failed to acquire metrics from FreeRTOS+TCP tcp_netstat utility. Status: %d.",
+                        ( int ) xMetricsStatus ) );
+            eStatus = eMetricsCollectorCollectionFailed;
+        }
+
+        #if ( metricscollectorSNAPSHOT_TTL_MS > 0 )
+            if( eStatus == eMetricsCollectorSuccess )
+            {
+                vTaskSuspendAll();
+                {
+                    memcpy( &xCachedMetrics, pxMetrics, sizeof( MetricsType_t ) );
+                    xCachedMetricsTime = xTaskGetTickCount();
+                    xCachedMetricsValid = pdTRUE;
+                }
+                ( void ) xTaskResumeAll();
+            }
+        #endif /* if ( metricscollectorSNAPSHOT_TTL_MS > 0 ) */
+    }
+
+    return eStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void prvFillNetworkStats( const MetricsType_t * pxMetrics,
+                                 NetworkStats_t * pxOutNetworkStats )
+{
+    LogDebug( ( "Network stats read. Bytes received: %u, packets received: %u, "
+                "bytes sent: %u, packets sent: %u.",
+                ( unsigned int ) pxMetrics->xInput.uxByteCount,
+                ( unsigned int ) pxMetrics->xInput.uxPacketCount,
+                ( unsigned int ) pxMetrics->xOutput.uxByteCount,
+                ( unsigned int ) pxMetrics->xOutput.uxPacketCount ) );
+
+    pxOutNetworkStats->ulBytesReceived = pxMetrics->xInput.uxByteCount;
+    pxOutNetworkStats->ulPacketsReceived = pxMetrics->xInput.uxPacketCount;
+    pxOutNetworkStats->ulBytesSent = pxMetrics->xOutput.uxByteCount;
+    pxOutNetworkStats->ulPacketsSent = pxMetrics->xOutput.uxPacketCount;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvFillPorts( const uint16_t * pusPortList,
+                              uint32_t ulPortCount,
+                              uint16_t * pusOutPortsArray,
+                              uint32_t ulPortsArrayLength )
+{
+    uint32_t ulCopyAmount = ulPortCount;
+
+    /* Fill the output array with as many ports as will fit in the given
+     * array. */
+    if( pusOutPortsArray != NULL )
     {
-        LogError( ( "Failed to acquire metrics from FreeRTOS+TCP tcp_netstat utility. Status: %d.",
-                    ( int ) xMetricsStatus ) );
-        eStatus = eMetricsCollectorCollectionFailed;
+        /* Limit the copied ports to what can fit in the output array. */
+        if( ulPortsArrayLength < ulPortCount )
+        {
+            LogWarn( ( "Ports returned truncated due to insufficient buffer size." ) );
+            ulCopyAmount = ulPortsArrayLength;
+        }
+
+        memcpy( pusOutPortsArray, pusPortList, ulCopyAmount * sizeof( uint16_t ) );
+    }
+
+    /* Return the number of elements copied to the array, or the total number
+     * of open ports if there is no array. */
+    return ulCopyAmount;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvFillConnections( const MetricsType_t * pxMetrics,
+                                    Connection_t * pxOutConnectionsArray,
+                                    uint32_t ulConnectionsArrayLength )
+{
+    uint32_t ulCopyAmount = pxMetrics->xTCPSocketList.uxCount;
+    uint32_t ulLocalIp = 0UL;
+    uint32_t i;
+
+    /* Fill the output array with as much TCP socket info as will fit in
+     * the given array. */
+    if( pxOutConnectionsArray != NULL )
+    {
+        /* Get local IP as the tcp_netstat utility does not give it. */
+        ulLocalIp = FreeRTOS_GetIPAddress();
+
+        /* Limit the outputted connections to what can fit in the output array. */
+        if( ulConnectionsArrayLength < pxMetrics->xTCPSocketList.uxCount )
+        {
+            LogWarn( ( "Ports returned truncated due to insufficient buffer size." ) );
+            ulCopyAmount = ulConnectionsArrayLength;
+        }
+
+        for( i = 0; i < ulCopyAmount; i++ )
+        {
+            pxOutConnectionsArray[ i ].ulLocalIp = ulLocalIp;
+            pxOutConnectionsArray[ i ].usLocalPort =
+                pxMetrics->xTCPSocketList.xTCPList[ i ].usLocalPort;
+            pxOutConnectionsArray[ i ].ulRemoteIp =
+                pxMetrics->xTCPSocketList.xTCPList[ i ].ulRemoteIP;
+            pxOutConnectionsArray[ i ].usRemotePort =
+                pxMetrics->xTCPSocketList.xTCPList[ i ].usRemotePort;
+        }
     }
 
+    /* Return the number of elements copied to the array, or the total number
+     * of established connections if there is no array. */
+    return ulCopyAmount;
+}
+/*-----------------------------------------------------------*/
+
+eMetricsCollectorStatus eGetNetworkStats( NetworkStats_t * pxOutNetworkStats )
+{
+    eMetricsCollectorStatus eStatus;
+    MetricsType_t xMetrics;
+
+    configASSERT( pxOutNetworkStats != NULL );
+
+    /* Start with everything as zero. */
+    memset( pxOutNetworkStats, 0, sizeof( NetworkStats_t ) );
+
+    eStatus = prvGetMetricsSnapshot( &xMetrics );
+
     /* Fill our response with values gotten from FreeRTOS+TCP. */
     if( eStatus == eMetricsCollectorSuccess )
     {
-        LogDebug( ( "Network stats read. Bytes received: %u, packets received: %u, "
-                    "bytes sent: %u, packets sent: %u.",
-                    ( unsigned int ) xMetrics.xInput.uxByteCount,
-                    ( unsigned int ) xMetrics.xInput.uxPacketCount,
-                    ( unsigned int ) xMetrics.xOutput.uxByteCount,
-                    ( unsigned int ) xMetrics.xOutput.uxPacketCount ) );
-
-        pxOutNetworkStats->ulBytesReceived = xMetrics.xInput.uxByteCount;
-        pxOutNetworkStats->ulPacketsReceived = xMetrics.xInput.uxPacketCount;
-        pxOutNetworkStats->ulBytesSent = xMetrics.xOutput.uxByteCount;
-        pxOutNetworkStats->ulPacketsSent = xMetrics.xOutput.uxPacketCount;
+        prvFillNetworkStats( &xMetrics, pxOutNetworkStats );
     }
 
     return eStatus;
@@ -96,50 +278,20 @@ eMetricsCollectorStatus eGetOpenTcpPorts( uint16_t * pusOutTcpPortsArray,
                                           uint32_t ulTcpPortsArrayLength,
                                           uint32_t * pulOutNumTcpOpenPorts )
 {
-    eMetricsCollectorStatus eStatus = eMetricsCollectorSuccess;
-
-    MetricsType_t xMetrics = { 0 };
-    BaseType_t xMetricsStatus = 0;
-    uint32_t ulCopyAmount = 0UL;
+    eMetricsCollectorStatus eStatus;
+    MetricsType_t xMetrics;
 
     /* pusOutTcpPortsArray can be NULL. */
     configASSERT( pulOutNumTcpOpenPorts != NULL );
 
-    /* Get metrics from FreeRTOS+TCP tcp_netstat utility. */
-    xMetricsStatus = vGetMetrics( &xMetrics );
-
-    if( xMetricsStatus != 0 )
-    {
-        LogError( ( "Failed to acquire metrics from FreeRTOS+TCP tcp_netstat utility. Status: %d.",
-                    ( int ) xMetricsStatus ) );
-        eStatus = eMetricsCollectorCollectionFailed;
-    }
+    eStatus = prvGetMetricsSnapshot( &xMetrics );
 
     if( eStatus == eMetricsCollectorSuccess )
     {
-        /* Fill the output array with as many TCP ports as will fit in the
-         * given array. */
-        if( pusOutTcpPortsArray != NULL )
-        {
-            ulCopyAmount = xMetrics.xTCPPortList.uxCount;
-
-            /* Limit the copied ports to what can fit in the output array. */
-            if( ulTcpPortsArrayLength < xMetrics.xTCPPortList.uxCount )
-            {
-                LogWarn( ( "Ports returned truncated due to insufficient buffer size." ) );
-                ulCopyAmount = ulTcpPortsArrayLength;
-            }
-
-            memcpy( pusOutTcpPortsArray, &xMetrics.xTCPPortList.usTCPPortList, ulCopyAmount * sizeof( uint16_t ) );
-
-            /* Return the number of elements copied to the array. */
-            *pulOutNumTcpOpenPorts = ulCopyAmount;
-        }
-        else
-        {
-            /* Return the total number of open ports. */
-            *pulOutNumTcpOpenPorts = xMetrics.xTCPPortList.uxCount;
-        }
+        *pulOutNumTcpOpenPorts = prvFillPorts( xMetrics.xTCPPortList.usTCPPortList,
+                                               xMetrics.xTCPPortList.uxCount,
+                                               pusOutTcpPortsArray,
+                                               ulTcpPortsArrayLength );
     }
 
     return eStatus;
@@ -150,119 +302,87 @@ eMetricsCollectorStatus eGetOpenUdpPorts( uint16_t * pusOutUdpPortsArray,
                                           uint32_t ulUdpPortsArrayLength,
                                           uint32_t * pulOutNumUdpOpenPorts )
 {
-    eMetricsCollectorStatus eStatus = eMetricsCollectorSuccess;
-
-    MetricsType_t xMetrics = { 0 };
-    BaseType_t xMetricsStatus = 0;
-    uint32_t ulCopyAmount = 0UL;
+    eMetricsCollectorStatus eStatus;
+    MetricsType_t xMetrics;
 
     /* pusOutUdpPortsArray can be NULL. */
     configASSERT( pulOutNumUdpOpenPorts != NULL );
 
-    /* Get metrics from FreeRTOS+TCP tcp_netstat utility. */
-    xMetricsStatus = vGetMetrics( &xMetrics );
-
-    if( xMetricsStatus != 0 )
-    {
-        LogError( ( "Failed to acquire metrics from FreeRTOS+TCP tcp_netstat utility. Status: %d.",
-                    ( int ) xMetricsStatus ) );
-        eStatus = eMetricsCollectorCollectionFailed;
-    }
+    eStatus = prvGetMetricsSnapshot( &xMetrics );
 
     if( eStatus == eMetricsCollectorSuccess )
     {
-        /* Fill the output array with as many UDP ports as will fit in the
-         * given array. */
-        if( pusOutUdpPortsArray != NULL )
-        {
-            ulCopyAmount = xMetrics.xUDPPortList.uxCount;
-
-            /* Limit the copied ports to what can fit in the output array. */
-            if( ulUdpPortsArrayLength < xMetrics.xUDPPortList.uxCount )
-            {
-                LogWarn( ( "Ports returned truncated due to insufficient buffer size." ) );
-                ulCopyAmount = ulUdpPortsArrayLength;
-            }
-
-            memcpy( pusOutUdpPortsArray, &xMetrics.xUDPPortList.usUDPPortList, ulCopyAmount * sizeof( uint16_t ) );
-
-            /* Return the number of elements copied to the array. */
-            *pulOutNumUdpOpenPorts = ulCopyAmount;
-        }
-        else
-        {
-            /* Return the total number of open ports. */
-            *pulOutNumUdpOpenPorts = xMetrics.xUDPPortList.uxCount;
-        }
+        *pulOutNumUdpOpenPorts = prvFillPorts( xMetrics.xUDPPortList.usUDPPortList,
+                                               xMetrics.xUDPPortList.uxCount,
+                                               pusOutUdpPortsArray,
+                                               ulUdpPortsArrayLength );
     }
 
     return eStatus;
 }
-
 /*-----------------------------------------------------------*/
 
 eMetricsCollectorStatus eGetEstablishedConnections( Connection_t * pxOutConnectionsArray,
                                                     uint32_t ulConnectionsArrayLength,
                                                     uint32_t * pulOutNumEstablishedConnections )
 {
-    eMetricsCollectorStatus eStatus = eMetricsCollectorSuccess;
-
-    MetricsType_t xMetrics = { 0 };
-    BaseType_t xMetricsStatus = 0;
-    uint32_t ulCopyAmount = 0UL;
-    uint32_t ulLocalIp = 0UL;
-    uint32_t i;
+    eMetricsCollectorStatus eStatus;
+    MetricsType_t xMetrics;
 
     /* pxOutConnectionsArray can be NULL. */
     configASSERT( pulOutNumEstablishedConnections != NULL );
 
-    /* Get metrics from FreeRTOS+TCP tcp_netstat utility. */
-    xMetricsStatus = vGetMetrics( &xMetrics );
+    eStatus = prvGetMetricsSnapshot( &xMetrics );
 
-    if( xMetricsStatus != 0 )
+    if( eStatus == eMetricsCollectorSuccess )
     {
-        LogError( ( "Failed to acquire metrics from FreeRTOS+TCP tcp_netstat utility. Status: %d.",
-                    ( int ) xMetricsStatus ) );
-        eStatus = eMetricsCollectorCollectionFailed;
+        *pulOutNumEstablishedConnections = prvFillConnections( &xMetrics,
+                                                               pxOutConnectionsArray,
+                                                               ulConnectionsArrayLength );
     }
 
-    if( eStatus == eMetricsCollectorSuccess )
-    {
-        /* Fill the output array with as much TCP socket info as will fit in
-         * the given array. */
-        if( pxOutConnectionsArray != NULL )
-        {
-            ulCopyAmount = xMetrics.xTCPSocketList.uxCount;
+    return eStatus;
+}
+/*-----------------------------------------------------------*/
 
-            /* Get local IP as the tcp_netstat utility does not give it. */
-            ulLocalIp = FreeRTOS_GetIPAddress();
+eMetricsCollectorStatus eCollectAllMetrics( AllMetrics_t * pxAllMetrics )
+{
+    eMetricsCollectorStatus eStatus;
+    MetricsType_t xMetrics;
 
-            /* Limit the outputted connections to what can fit in the output array. */
-            if( ulConnectionsArrayLength < xMetrics.xTCPSocketList.uxCount )
-            {
-                LogWarn( ( "Ports returned truncated due to insufficient buffer size." ) );
-                ulCopyAmount = ulConnectionsArrayLength;
-            }
+    configASSERT( pxAllMetrics != NULL );
 
-            for( i = 0; i < ulCopyAmount; i++ )
-            {
-                pxOutConnectionsArray[ i ].ulLocalIp = ulLocalIp;
-                pxOutConnectionsArray[ i ].usLocalPort =
-                    xMetrics.xTCPSocketList.xTCPList[ i ].usLocalPort;
-                pxOutConnectionsArray[ i ].ulRemoteIp =
-                    xMetrics.xTCPSocketList.xTCPList[ i ].ulRemoteIP;
-                pxOutConnectionsArray[ i ].usRemotePort =
-                    xMetrics.xTCPSocketList.xTCPList[ i ].usRemotePort;
-            }
+    pxAllMetrics->ulNumTcpOpenPorts = 0UL;
+    pxAllMetrics->ulNumUdpOpenPorts = 0UL;
+    pxAllMetrics->ulNumEstablishedConnections = 0UL;
 
-            /* Return the number of elements copied to the array. */
-            *pulOutNumEstablishedConnections = ulCopyAmount;
-        }
-        else
+    if( pxAllMetrics->pxNetworkStats != NULL )
+    {
+        memset( pxAllMetrics->pxNetworkStats, 0, sizeof( NetworkStats_t ) );
+    }
+
+    eStatus = prvGetMetricsSnapshot( &xMetrics );
+
+    if( eStatus == eMetricsCollectorSuccess )
+    {
+        if( pxAllMetrics->pxNetworkStats != NULL )
         {
-            /* Return the total number of established connections. */
-            *pulOutNumEstablishedConnections = xMetrics.xTCPSocketList.uxCount;
+            prvFillNetworkStats( &xMetrics, pxAllMetrics->pxNetworkStats );
         }
+
+        pxAllMetrics->ulNumTcpOpenPorts = prvFillPorts( xMetrics.xTCPPortList.usTCPPortList,
+                                                        xMetrics.xTCPPortList.uxCount,
+                                                        pxAllMetrics->pusTcpPortsArray,
+                                                        pxAllMetrics->ulTcpPortsArrayLength );
+
+        pxAllMetrics->ulNumUdpOpenPorts = prvFillPorts( xMetrics.xUDPPortList.usUDPPortList,
+                                                        xMetrics.xUDPPortList.uxCount,
+                                                        pxAllMetrics->pusUdpPortsArray,
+                                                        pxAllMetrics->ulUdpPortsArrayLength );
+
+        pxAllMetrics->ulNumEstablishedConnections = prvFillConnections( &xMetrics,
+                                                                        pxAllMetrics->pxConnectionsArray,
+                                                                        pxAllMetrics->ulConnectionsArrayLength );
     }
 
     return eStatus;
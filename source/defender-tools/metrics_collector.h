@@ -36,6 +36,18 @@
 
 #include <stdint.h>
 
+/**
+ * @brief Time for which a snapshot of the FreeRTOS+TCP metrics is reused.
+ *
+ * When non-zero, all the collection functions in this file share one
+ * snapshot, so several consumers calling them within this many milliseconds
+ * walk the TCP stack only once and see consistent values.  Set to 0 to take
+ * a fresh snapshot on every call.  Can be overridden in demo_config.h.
+ */
+#ifndef metricscollectorSNAPSHOT_TTL_MS
+    #define metricscollectorSNAPSHOT_TTL_MS    ( 0U )
+#endif
+
 /**
  * @brief Return codes from metrics collector APIs.
  */
@@ -68,6 +80,29 @@ typedef struct Connection
     uint16_t usRemotePort;
 } Connection_t;
 
+/**
+ * @brief Input and output parameters of eCollectAllMetrics().
+ *
+ * Each array pointer can be NULL, in which case the matching count returns the
+ * total number of items instead of the number written.
+ */
+typedef struct AllMetrics
+{
+    NetworkStats_t * pxNetworkStats;          /**< [out] Network stats. Can be NULL if not needed. */
+
+    uint16_t * pusTcpPortsArray;              /**< [out] Array to write the open TCP ports into. */
+    uint32_t ulTcpPortsArrayLength;           /**< [in] Length of pusTcpPortsArray. */
+    uint32_t ulNumTcpOpenPorts;               /**< [out] Number of open TCP ports. */
+
+    uint16_t * pusUdpPortsArray;              /**< [out] Array to write the open UDP ports into. */
+    uint32_t ulUdpPortsArrayLength;           /**< [in] Length of pusUdpPortsArray. */
+    uint32_t ulNumUdpOpenPorts;               /**< [out] Number of open UDP ports. */
+
+    Connection_t * pxConnectionsArray;        /**< [out] Array to write the established connections into. */
+    uint32_t ulConnectionsArrayLength;        /**< [in] Length of pxConnectionsArray. */
+    uint32_t ulNumEstablishedConnections;     /**< [out] Number of established connections. */
+} AllMetrics_t;
+
 /**
  * @brief Get network stats.
  *
@@ -146,4 +181,22 @@ eMetricsCollectorStatus eGetEstablishedConnections( Connection_t * pxOutConnecti
                                                     uint32_t ulConnectionsArrayLength,
                                                     uint32_t * pulOutNumEstablishedConnections );
 
+/**
+ * @brief Get the network stats, open ports and established connections from a
+ * single snapshot of the TCP stack.
+ *
+ * Equivalent to calling eGetNetworkStats(), eGetOpenTcpPorts(),
+ * eGetOpenUdpPorts() and eGetEstablishedConnections() in turn, except that the
+ * TCP stack is only walked once so the four views are consistent with each
+ * other.
+ *
+ * @param[in,out] pxAllMetrics The output arrays and their lengths, and the
+ * collected metrics.
+ *
+ * @return #eMetricsCollectorSuccess if the metrics are successfully obtained;
+ * #eMetricsCollectorBadParameter if invalid parameters are passed;
+ * #eMetricsCollectorCollectionFailed if the collection methods failed.
+ */
+eMetricsCollectorStatus eCollectAllMetrics( AllMetrics_t * pxAllMetrics );
+
 #endif /* ifndef METRICS_COLLECTOR_H_ */
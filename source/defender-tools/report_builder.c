@@ -24,8 +24,8 @@
  *
  */
 
+
 /* Standard includes. */
-#include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 
@@ -42,84 +42,164 @@
 /* Interface include. */
 #include "report_builder.h"
 
+/* Text formatting without printf. */
+#include "report_formatter.h"
+
+/* Payload template include. */
+#include "payload_template.h"
+
+/* Length of a string literal, excluding the terminating NULL character. */
+#define reportbuilderSTRING_LENGTH( str )           ( sizeof( str ) - 1U )
+
 /* Various JSON characters. */
 #define reportbuilderJSON_ARRAY_OPEN_MARKER         '['
 #define reportbuilderJSON_ARRAY_CLOSE_MARKER        ']'
 #define reportbuilderJSON_ARRAY_OBJECT_SEPARATOR    ','
+#define reportbuilderJSON_MEMBER_SEPARATOR          ','
+
+/* A JSON key followed by the name separator, as a string literal. */
+#define reportbuilderJSON_KEY( key )    "\"" key "\": "
+
+/* Fragments of the JSON report, in the order they are written. The values
+ * are written between the fragments. */
+#define reportbuilderJSON_PORT_OBJECT_START \
+    "{"                                     \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_PORT_KEY )
+
+#define reportbuilderJSON_CONNECTION_OBJECT_START \
+    "{"                                           \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_LOCAL_PORT_KEY )
 
-/* Helper macro to check if snprintf was successful. */
-#define reportbuilderSNPRINTF_SUCCESS( retVal, bufLen )    ( ( retVal > 0 ) && ( ( uint32_t ) retVal < bufLen ) )
+#define reportbuilderJSON_CONNECTION_OBJECT_REMOTE_ADDR \
+    ","                                                 \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_REMOTE_ADDR_KEY ) "\""
 
-/* Formats used to generate the JSON report. */
-#define reportbuilderJSON_PORT_OBJECT_FORMAT \
+#define reportbuilderJSON_CONNECTION_OBJECT_END \
+    "\""                                        \
+    "}"
+
+#define reportbuilderJSON_OBJECT_END    "}"
+
+#define reportbuilderJSON_REPORT_HEADER                 \
+    "{"                                                 \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_HEADER_KEY ) \
+    "{"                                                 \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_ID_KEY )
+
+#define reportbuilderJSON_REPORT_VERSION                 \
+    ","                                                  \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_VERSION_KEY ) \
+    "\""
+
+/* Pattern of the report header.  It is compiled once, after which only the
+ * numbers that changed are rewritten for each report. */
+#define reportbuilderJSON_HEADER_PATTERN \
+    reportbuilderJSON_REPORT_HEADER "%u" reportbuilderJSON_REPORT_VERSION "%u.%u"
+
+#define reportbuilderJSON_HEADER_MAX_LENGTH \
+    ( reportbuilderSTRING_LENGTH( reportbuilderJSON_HEADER_PATTERN ) + ( 3U * reportformatterMAX_UINT32_LENGTH ) )
+
+/* Slots of the report header pattern. */
+#define reportbuilderHEADER_SLOT_REPORT_ID       ( 0U )
+#define reportbuilderHEADER_SLOT_MAJOR_VERSION   ( 1U )
+#define reportbuilderHEADER_SLOT_MINOR_VERSION   ( 2U )
+
+#define reportbuilderJSON_REPORT_TCP_PORTS                           \
+    "\""                                                             \
+    "},"                                                             \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_METRICS_KEY )             \
+    "{"                                                              \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_TCP_LISTENING_PORTS_KEY ) \
+    "{"
+
+#define reportbuilderJSON_REPORT_PORTS_LIST \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_PORTS_KEY )
+
+#define reportbuilderJSON_REPORT_TOTAL \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_TOTAL_KEY )
+
+#define reportbuilderJSON_REPORT_UDP_PORTS                           \
+    "},"                                                             \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_UDP_LISTENING_PORTS_KEY ) \
+    "{"
+
+#define reportbuilderJSON_REPORT_BYTES_IN                      \
+    "},"                                                       \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_NETWORK_STATS_KEY ) \
+    "{"                                                        \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_BYTES_IN_KEY )
+
+#define reportbuilderJSON_REPORT_BYTES_OUT \
+    ","                                    \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_BYTES_OUT_KEY )
+
+#define reportbuilderJSON_REPORT_PKTS_IN \
+    ","                                  \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_PKTS_IN_KEY )
+
+#define reportbuilderJSON_REPORT_PKTS_OUT \
+    ","                                   \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_PKTS_OUT_KEY )
+
+#define reportbuilderJSON_REPORT_CONNECTIONS                                   \
+    "},"                                                                       \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_TCP_CONNECTIONS_KEY )               \
+    "{"                                                                        \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_ESTABLISHED_CONNECTIONS_KEY )       \
+    "{"
+
+#define reportbuilderJSON_REPORT_CONNECTIONS_LIST \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_CONNECTIONS_KEY )
+
+#define reportbuilderJSON_REPORT_STACK_HIGH_WATER_MARK          \
+    "}"                                                         \
+    "}"                                                         \
+    "},"                                                        \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_CUSTOM_METRICS_KEY ) \
+    "{"                                                         \
+    "\"" reportbuilderSTACK_HIGH_WATER_MARK_METRIC_NAME "\": ["  \
+    "{"                                                         \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_NUMBER_KEY )
+
+#define reportbuilderJSON_REPORT_CUSTOM_METRIC_END \
+    "}"                                            \
+    "]"
+
+/* Written before the name of each custom metric after the first. */
+#define reportbuilderJSON_CUSTOM_METRIC_NAME_START \
+    ","                                            \
+    "\""
+
+/* Written after the name of a custom metric, followed by the value. */
+#define reportbuilderJSON_CUSTOM_METRIC_NUMBER \
+    "\": ["                                  \
     "{"                                      \
-    "\"%s\": %u"                             \
-    "},"
-
-#define reportbuilderJSON_CONNECTION_OBJECT_FORMAT \
-    "{"                                            \
-    "\"%s\": %hu,"                                 \
-    "\"%s\": \"%lu.%lu.%lu.%lu:%hu\""              \
-    "},"
-
-#define reportbuilderJSON_REPORT_FORMAT_PART1 \
-    "{"                                       \
-    "\"%s\": {"                               \
-    "\"%s\": %lu,"                            \
-    "\"%s\": \"%lu.%lu\""                     \
-    "},"                                      \
-    "\"%s\": {"                               \
-    "\"%s\": {"                               \
-    "\"%s\": "
-
-#define reportbuilderJSON_REPORT_FORMAT_PART2 \
-    ","                                       \
-    "\"%s\": %lu"                             \
-    "},"                                      \
-    "\"%s\": {"                               \
-    "\"%s\": "
-
-#define reportbuilderJSON_REPORT_FORMAT_PART3 \
-    ","                                       \
-    "\"%s\": %lu"                             \
-    "},"                                      \
-    "\"%s\": {"                               \
-    "\"%s\": %lu,"                            \
-    "\"%s\": %lu,"                            \
-    "\"%s\": %lu,"                            \
-    "\"%s\": %lu"                             \
-    "},"                                      \
-    "\"%s\": {"                               \
-    "\"%s\": {"                               \
-    "\"%s\": "
-
-#define reportbuilderJSON_REPORT_FORMAT_PART4 \
-    ","                                       \
-    "\"%s\": %lu"                             \
-    "}"                                       \
-    "}"                                       \
-    "},"                                      \
-    "\"%s\": {"                               \
-    "\"stack_high_water_mark\": ["            \
-    "{"                                       \
-    "\"%s\": %lu"                             \
-    "}"                                       \
-    "],"                                      \
-    "\"task_numbers\": ["                     \
-    "{"                                       \
-    "\"%s\": "
-
-#define reportbuilderJSON_REPORT_FORMAT_PART5 \
-    "}"                                       \
-    "]"                                       \
-    "}"                                       \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_NUMBER_KEY )
+
+#define reportbuilderJSON_CUSTOM_METRIC_NUMBER_LIST \
+    "\": ["                                       \
+    "{"                                           \
+    reportbuilderJSON_KEY( DEFENDER_REPORT_NUMBER_LIST_KEY )
+
+#define reportbuilderJSON_REPORT_END \
+    "}"                              \
     "}"
 
 /*-----------------------------------------------------------*/
 
 /**
- * @brief Write ports array to the given buffer in the format expected by the
- * AWS IoT Device Defender Service.
+ * @brief The JSON report header, compiled from
+ * #reportbuilderJSON_HEADER_PATTERN by the first call to eGenerateJsonReport().
+ */
+static PayloadTemplate_t xJsonHeader;
+static char cJsonHeaderBuffer[ reportbuilderJSON_HEADER_MAX_LENGTH + 1U ];
+static bool xJsonHeaderCompiled = false;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Write ports array in the format expected by the AWS IoT Device
+ * Defender Service.
  *
  * This function writes an array of the following format:
  * [
@@ -131,24 +211,17 @@
  *    }
  * ]
  *
- * @param[in] pcBuffer The buffer to write the ports array.
- * @param[in] ulBufferLength The length of the buffer.
+ * @param[in] pxFormatter The formatter to write the ports array to.
  * @param[in] pusOpenPortsArray The array containing the open ports.
  * @param[in] ulOpenPortsArrayLength Length of the pusOpenPortsArray array.
- * @param[out] pulOutCharsWritten Number of characters written to the buffer.
- *
- * @return #ReportBuilderSuccess if the array is successfully written;
- * #ReportBuilderBufferTooSmall if the buffer cannot hold the full array.
  */
-static eReportBuilderStatus prvWritePortsArray( char * pcBuffer,
-                                                uint32_t ulBufferLength,
-                                                const uint16_t * pusOpenPortsArray,
-                                                uint32_t ulOpenPortsArrayLength,
-                                                uint32_t * pulOutCharsWritten );
+static void prvWritePortsArray( ReportFormatter_t * pxFormatter,
+                                const uint16_t * pusOpenPortsArray,
+                                uint32_t ulOpenPortsArrayLength );
 
 /**
- * @brief Write established connections array to the given buffer in the format
- * expected by the AWS IoT Device Defender Service.
+ * @brief Write established connections array in the format expected by the
+ * AWS IoT Device Defender Service.
  *
  * This function write array of the following format:
  * [
@@ -162,281 +235,178 @@ static eReportBuilderStatus prvWritePortsArray( char * pcBuffer,
  *     }
  * ]
  *
- * @param[in] pcBuffer The buffer to write the connections array.
- * @param[in] ulBufferLength The length of the buffer.
+ * @param[in] pxFormatter The formatter to write the connections array to.
  * @param[in] pxConnectionsArray The array containing the established connections.
  * @param[in] ulConnectionsArrayLength Length of the pxConnectionsArray array.
- * @param[out] pulOutCharsWritten Number of characters written to the buffer.
+ */
+static void prvWriteConnectionsArray( ReportFormatter_t * pxFormatter,
+                                      const Connection_t * pxConnectionsArray,
+                                      uint32_t ulConnectionsArrayLength );
+
+/**
+ * @brief Write an array of numbers as a JSON array.
+ *
+ * @param[in] pxFormatter The formatter to write the array to.
+ * @param[in] pulNumbersArray The array containing the numbers.
+ * @param[in] ulNumbersArrayLength Length of the pulNumbersArray array.
+ */
+static void prvWriteNumbersArray( ReportFormatter_t * pxFormatter,
+                                  const uint32_t * pulNumbersArray,
+                                  uint32_t ulNumbersArrayLength );
+
+/**
+ * @brief Write a number type custom metric which is not the first custom
+ * metric.
+ *
+ * This function writes a member of the following format:
+ * ,"heap_free_bytes": [{"number": 51200}]
  *
- * @return #ReportBuilderSuccess if the array is successfully written;
- * #ReportBuilderBufferTooSmall if the buffer cannot hold the full array.
+ * @param[in] pxFormatter The formatter to write the metric to.
+ * @param[in] pcName Name of the custom metric.
+ * @param[in] ulNameLength Length of the name.
+ * @param[in] ulValue Value of the custom metric.
  */
-static eReportBuilderStatus prvWriteConnectionsArray( char * pcBuffer,
-                                                      uint32_t ulBufferLength,
-                                                      const Connection_t * pxConnectionsArray,
-                                                      uint32_t ulConnectionsArrayLength,
-                                                      uint32_t * pulOutCharsWritten );
+static void prvWriteNumberMetric( ReportFormatter_t * pxFormatter,
+                                  const char * pcName,
+                                  uint32_t ulNameLength,
+                                  uint32_t ulValue );
 
 /**
- * @brief Write task ids array to the given buffer as a JSON array.
+ * @brief Write a number list type custom metric which is not the first custom
+ * metric.
  *
- * @param[in] pcBuffer The buffer to write the connections array.
- * @param[in] ulBufferLength The length of the buffer.
- * @param[in] pulTaskIdsArray The array containing the task ids.
- * @param[in] pulTaskIdsArrayLength Length of the pulTaskIdsArray array.
- * @param[out] pulOutCharsWritten Number of characters written to the buffer.
+ * This function writes a member of the following format:
+ * ,"task_numbers": [{"number_list": [1, 2, 3]}]
  *
- * @return #ReportBuilderSuccess if the array is successfully written;
- * #ReportBuilderBufferTooSmall if the buffer cannot hold the full array.
+ * @param[in] pxFormatter The formatter to write the metric to.
+ * @param[in] pcName Name of the custom metric.
+ * @param[in] ulNameLength Length of the name.
+ * @param[in] pulNumbersArray The array containing the numbers.
+ * @param[in] ulNumbersArrayLength Length of the pulNumbersArray array.
  */
-static eReportBuilderStatus prvWriteTaskIdsArray( char * pcBuffer,
-                                                  uint32_t ulBufferLength,
-                                                  const uint32_t * pulTaskIdsArray,
-                                                  uint32_t pulTaskIdsArrayLength,
-                                                  uint32_t * pulOutCharsWritten );
+static void prvWriteNumberListMetric( ReportFormatter_t * pxFormatter,
+                                      const char * pcName,
+                                      uint32_t ulNameLength,
+                                      const uint32_t * pulNumbersArray,
+                                      uint32_t ulNumbersArrayLength );
 /*-----------------------------------------------------------*/
 
-static eReportBuilderStatus prvWritePortsArray( char * pcBuffer,
-                                                uint32_t ulBufferLength,
-                                                const uint16_t * pusOpenPortsArray,
-                                                uint32_t ulOpenPortsArrayLength,
-                                                uint32_t * pulOutCharsWritten )
+static void prvWritePortsArray( ReportFormatter_t * pxFormatter,
+                                const uint16_t * pusOpenPortsArray,
+                                uint32_t ulOpenPortsArrayLength )
 {
-    char * pcCurrentWritePos = pcBuffer;
-    uint32_t i, ulRemainingBufferLength = ulBufferLength;
-    int32_t lCharactersWritten;
-    eReportBuilderStatus eStatus = eReportBuilderSuccess;
+    uint32_t i;
 
-    configASSERT( pcBuffer != NULL );
+    configASSERT( pxFormatter != NULL );
     configASSERT( pusOpenPortsArray != NULL );
-    configASSERT( pulOutCharsWritten != NULL );
 
-    /* Write the JSON array open marker. */
-    if( ulRemainingBufferLength > 1 )
-    {
-        *pcCurrentWritePos = reportbuilderJSON_ARRAY_OPEN_MARKER;
-        ulRemainingBufferLength -= 1;
-        pcCurrentWritePos += 1;
-    }
-    else
-    {
-        eStatus = eReportBuilderBufferTooSmall;
-    }
+    vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_OPEN_MARKER );
 
-    /* Write the array elements. */
-    for( i = 0; ( ( i < ulOpenPortsArrayLength ) && ( eStatus == eReportBuilderSuccess ) ); i++ )
+    for( i = 0; i < ulOpenPortsArrayLength; i++ )
     {
-        lCharactersWritten = snprintf( pcCurrentWritePos,
-                                       ulRemainingBufferLength,
-                                       reportbuilderJSON_PORT_OBJECT_FORMAT,
-                                       DEFENDER_REPORT_PORT_KEY,
-                                       pusOpenPortsArray[ i ] );
-
-        if( !reportbuilderSNPRINTF_SUCCESS( lCharactersWritten, ulRemainingBufferLength ) )
-        {
-            eStatus = eReportBuilderBufferTooSmall;
-            break;
-        }
-        else
+        if( i != 0 )
         {
-            ulRemainingBufferLength -= ( uint32_t ) lCharactersWritten;
-            pcCurrentWritePos += lCharactersWritten;
-        }
-    }
-
-    if( eStatus == eReportBuilderSuccess )
-    {
-        /* Discard the last comma. */
-        if( ulOpenPortsArrayLength > 0 )
-        {
-            pcCurrentWritePos -= 1;
-            ulRemainingBufferLength += 1;
+            vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_OBJECT_SEPARATOR );
         }
 
-        /* Write the JSON array close marker. */
-        if( ulRemainingBufferLength > 1 )
-        {
-            *pcCurrentWritePos = reportbuilderJSON_ARRAY_CLOSE_MARKER;
-            ulRemainingBufferLength -= 1;
-            pcCurrentWritePos += 1;
-        }
-        else
-        {
-            eStatus = eReportBuilderBufferTooSmall;
-        }
+        reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_PORT_OBJECT_START );
+        vReportFormatterAppendUInt32( pxFormatter, pusOpenPortsArray[ i ] );
+        reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_OBJECT_END );
     }
 
-    if( eStatus == eReportBuilderSuccess )
-    {
-        *pulOutCharsWritten = ulBufferLength - ulRemainingBufferLength;
-    }
-
-    return eStatus;
+    vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_CLOSE_MARKER );
 }
 /*-----------------------------------------------------------*/
 
-static eReportBuilderStatus prvWriteConnectionsArray( char * pcBuffer,
-                                                      uint32_t ulBufferLength,
-                                                      const Connection_t * pxConnectionsArray,
-                                                      uint32_t ulConnectionsArrayLength,
-                                                      uint32_t * pulOutCharsWritten )
+static void prvWriteConnectionsArray( ReportFormatter_t * pxFormatter,
+                                      const Connection_t * pxConnectionsArray,
+                                      uint32_t ulConnectionsArrayLength )
 {
-    char * pcCurrentWritePos = pcBuffer;
-    uint32_t i, ulRemainingBufferLength = ulBufferLength;
-    int32_t lCharactersWritten;
-    eReportBuilderStatus eStatus = eReportBuilderSuccess;
+    uint32_t i;
     const Connection_t * pxConn;
 
-    configASSERT( pcBuffer != NULL );
+    configASSERT( pxFormatter != NULL );
     configASSERT( pxConnectionsArray != NULL );
-    configASSERT( pulOutCharsWritten != NULL );
 
-    /* Write the JSON array open marker. */
-    if( ulRemainingBufferLength > 1 )
-    {
-        *pcCurrentWritePos = reportbuilderJSON_ARRAY_OPEN_MARKER;
-        ulRemainingBufferLength -= 1;
-        pcCurrentWritePos += 1;
-    }
-    else
-    {
-        eStatus = eReportBuilderBufferTooSmall;
-    }
+    vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_OPEN_MARKER );
 
-    /* Write the array elements. */
-    for( i = 0; ( ( i < ulConnectionsArrayLength ) && ( eStatus == eReportBuilderSuccess ) ); i++ )
+    for( i = 0; i < ulConnectionsArrayLength; i++ )
     {
         pxConn = &( pxConnectionsArray[ i ] );
-        lCharactersWritten = snprintf( pcCurrentWritePos,
-                                       ulRemainingBufferLength,
-                                       reportbuilderJSON_CONNECTION_OBJECT_FORMAT,
-                                       DEFENDER_REPORT_LOCAL_PORT_KEY,
-                                       pxConn->usLocalPort,
-                                       DEFENDER_REPORT_REMOTE_ADDR_KEY,
-                                       ( pxConn->ulRemoteIp >> 24 ) & 0xFFUL,
-                                       ( pxConn->ulRemoteIp >> 16 ) & 0xFFUL,
-                                       ( pxConn->ulRemoteIp >> 8 ) & 0xFFUL,
-                                       ( pxConn->ulRemoteIp ) & 0xFFUL,
-                                       pxConn->usRemotePort );
-
-        if( !reportbuilderSNPRINTF_SUCCESS( lCharactersWritten, ulRemainingBufferLength ) )
-        {
-            eStatus = eReportBuilderBufferTooSmall;
-            break;
-        }
-        else
-        {
-            ulRemainingBufferLength -= lCharactersWritten;
-            pcCurrentWritePos += lCharactersWritten;
-        }
-    }
 
-    if( eStatus == eReportBuilderSuccess )
-    {
-        /* Discard the last comma. */
-        if( ulConnectionsArrayLength > 0 )
+        if( i != 0 )
         {
-            pcCurrentWritePos -= 1;
-            ulRemainingBufferLength += 1;
+            vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_OBJECT_SEPARATOR );
         }
 
-        /* Write the JSON array close marker. */
-        if( ulRemainingBufferLength > 1 )
-        {
-            *pcCurrentWritePos = reportbuilderJSON_ARRAY_CLOSE_MARKER;
-            ulRemainingBufferLength -= 1;
-            pcCurrentWritePos += 1;
-        }
-        else
-        {
-            eStatus = eReportBuilderBufferTooSmall;
-        }
-    }
-
-    if( eStatus == eReportBuilderSuccess )
-    {
-        *pulOutCharsWritten = ulBufferLength - ulRemainingBufferLength;
+        reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_CONNECTION_OBJECT_START );
+        vReportFormatterAppendUInt32( pxFormatter, pxConn->usLocalPort );
+        reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_CONNECTION_OBJECT_REMOTE_ADDR );
+        vReportFormatterAppendIPv4( pxFormatter, pxConn->ulRemoteIp );
+        vReportFormatterAppendChar( pxFormatter, ':' );
+        vReportFormatterAppendUInt32( pxFormatter, pxConn->usRemotePort );
+        reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_CONNECTION_OBJECT_END );
     }
 
-    return eStatus;
+    vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_CLOSE_MARKER );
 }
 /*-----------------------------------------------------------*/
 
-static eReportBuilderStatus prvWriteTaskIdsArray( char * pcBuffer,
-                                                  uint32_t ulBufferLength,
-                                                  const uint32_t * pulTaskIdsArray,
-                                                  uint32_t pulTaskIdsArrayLength,
-                                                  uint32_t * pulOutCharsWritten )
+static void prvWriteNumbersArray( ReportFormatter_t * pxFormatter,
+                                  const uint32_t * pulNumbersArray,
+                                  uint32_t ulNumbersArrayLength )
 {
-    char * pcCurrentWritePos = pcBuffer;
-    uint32_t i, ulRemainingBufferLength = ulBufferLength;
-    int32_t lCharactersWritten;
-    eReportBuilderStatus eStatus = eReportBuilderSuccess;
-
-    configASSERT( pcBuffer != NULL );
-    configASSERT( pulTaskIdsArray != NULL );
-    configASSERT( pulOutCharsWritten != NULL );
-
-    /* Write the JSON array open marker. */
-    if( ulRemainingBufferLength > 1 )
-    {
-        *pcCurrentWritePos = reportbuilderJSON_ARRAY_OPEN_MARKER;
-        ulRemainingBufferLength -= 1;
-        pcCurrentWritePos += 1;
-    }
-    else
-    {
-        eStatus = eReportBuilderBufferTooSmall;
-    }
+    uint32_t i;
 
-    /* Write the array elements. */
-    for( i = 0; ( ( i < pulTaskIdsArrayLength ) && ( eStatus == eReportBuilderSuccess ) ); i++ )
-    {
-        lCharactersWritten = snprintf( pcCurrentWritePos,
-                                       ulRemainingBufferLength,
-                                       "%lu,",
-                                       pulTaskIdsArray[ i ] );
+    configASSERT( pxFormatter != NULL );
+    configASSERT( pulNumbersArray != NULL );
 
-        if( !reportbuilderSNPRINTF_SUCCESS( lCharactersWritten, ulRemainingBufferLength ) )
-        {
-            eStatus = eReportBuilderBufferTooSmall;
-            break;
-        }
-        else
-        {
-            ulRemainingBufferLength -= ( uint32_t ) lCharactersWritten;
-            pcCurrentWritePos += lCharactersWritten;
-        }
-    }
+    vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_OPEN_MARKER );
 
-    if( eStatus == eReportBuilderSuccess )
+    for( i = 0; i < ulNumbersArrayLength; i++ )
     {
-        /* Discard the last comma. */
-        if( pulTaskIdsArrayLength > 0 )
+        if( i != 0 )
         {
-            pcCurrentWritePos -= 1;
-            ulRemainingBufferLength += 1;
+            vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_OBJECT_SEPARATOR );
         }
 
-        /* Write the JSON array close marker. */
-        if( ulRemainingBufferLength > 1 )
-        {
-            *pcCurrentWritePos = reportbuilderJSON_ARRAY_CLOSE_MARKER;
-            ulRemainingBufferLength -= 1;
-            pcCurrentWritePos += 1;
-        }
-        else
-        {
-            eStatus = eReportBuilderBufferTooSmall;
-        }
+        vReportFormatterAppendUInt32( pxFormatter, pulNumbersArray[ i ] );
     }
 
-    if( eStatus == eReportBuilderSuccess )
-    {
-        *pulOutCharsWritten = ulBufferLength - ulRemainingBufferLength;
-    }
+    vReportFormatterAppendChar( pxFormatter, reportbuilderJSON_ARRAY_CLOSE_MARKER );
+}
+/*-----------------------------------------------------------*/
 
-    return eStatus;
+static void prvWriteNumberMetric( ReportFormatter_t * pxFormatter,
+                                  const char * pcName,
+                                  uint32_t ulNameLength,
+                                  uint32_t ulValue )
+{
+    configASSERT( pxFormatter != NULL );
+    configASSERT( pcName != NULL );
+
+    reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_CUSTOM_METRIC_NAME_START );
+    vReportFormatterAppendString( pxFormatter, pcName, ulNameLength );
+    reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_CUSTOM_METRIC_NUMBER );
+    vReportFormatterAppendUInt32( pxFormatter, ulValue );
+    reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_REPORT_CUSTOM_METRIC_END );
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteNumberListMetric( ReportFormatter_t * pxFormatter,
+                                      const char * pcName,
+                                      uint32_t ulNameLength,
+                                      const uint32_t * pulNumbersArray,
+                                      uint32_t ulNumbersArrayLength )
+{
+    configASSERT( pxFormatter != NULL );
+    configASSERT( pcName != NULL );
+
+    reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_CUSTOM_METRIC_NAME_START );
+    vReportFormatterAppendString( pxFormatter, pcName, ulNameLength );
+    reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_CUSTOM_METRIC_NUMBER_LIST );
+    prvWriteNumbersArray( pxFormatter, pulNumbersArray, ulNumbersArrayLength );
+    reportformatterAPPEND_LITERAL( pxFormatter, reportbuilderJSON_REPORT_CUSTOM_METRIC_END );
 }
 /*-----------------------------------------------------------*/
 
@@ -448,10 +418,10 @@ eReportBuilderStatus eGenerateJsonReport( char * pcBuffer,
                                           uint32_t ulReportId,
                                           uint32_t * pulOutReportLength )
 {
-    char * pcCurrentWritePos = pcBuffer;
-    uint32_t ulRemainingBufferLength = ulBufferLength, bufferWritten;
+    ReportFormatter_t xFormatter;
+    uint32_t ulReportLength;
+    uint32_t i;
     eReportBuilderStatus eStatus = eReportBuilderSuccess;
-    int32_t lCharactersWritten;
 
     configASSERT( pcBuffer != NULL );
     configASSERT( pxMetrics != NULL );
@@ -472,223 +442,159 @@ eReportBuilderStatus eGenerateJsonReport( char * pcBuffer,
         eStatus = eReportBuilderBadParameter;
     }
 
-    /* Write part1. */
-    if( eStatus == eReportBuilderSuccess )
-    {
-        lCharactersWritten = snprintf( pcCurrentWritePos,
-                                       ulRemainingBufferLength,
-                                       reportbuilderJSON_REPORT_FORMAT_PART1,
-                                       DEFENDER_REPORT_HEADER_KEY,
-                                       DEFENDER_REPORT_ID_KEY,
-                                       ulReportId,
-                                       DEFENDER_REPORT_VERSION_KEY,
-                                       ulMajorReportVersion,
-                                       ulMinorReportVersion,
-                                       DEFENDER_REPORT_METRICS_KEY,
-                                       DEFENDER_REPORT_TCP_LISTENING_PORTS_KEY,
-                                       DEFENDER_REPORT_PORTS_KEY
-                                       );
-
-        if( !reportbuilderSNPRINTF_SUCCESS( lCharactersWritten, ulRemainingBufferLength ) )
-        {
-            LogError( ( "Failed to write part 1." ) );
-            eStatus = eReportBuilderBufferTooSmall;
-        }
-        else
-        {
-            ulRemainingBufferLength -= lCharactersWritten;
-            pcCurrentWritePos += lCharactersWritten;
-        }
-    }
-
-    /* Write TCP ports array. */
-    if( eStatus == eReportBuilderSuccess )
-    {
-        eStatus = prvWritePortsArray( pcCurrentWritePos,
-                                      ulRemainingBufferLength,
-                                      pxMetrics->pusOpenTcpPortsArray,
-                                      pxMetrics->ulOpenTcpPortsArrayLength,
-                                      &( bufferWritten ) );
-
-        if( eStatus == eReportBuilderSuccess )
-        {
-            pcCurrentWritePos += bufferWritten;
-            ulRemainingBufferLength -= bufferWritten;
-        }
-        else
-        {
-            LogError( ( "Failed to write TCP ports array." ) );
-        }
-    }
-
-    /* Write part2. */
-    if( eStatus == eReportBuilderSuccess )
-    {
-        lCharactersWritten = snprintf( pcCurrentWritePos,
-                                       ulRemainingBufferLength,
-                                       reportbuilderJSON_REPORT_FORMAT_PART2,
-                                       DEFENDER_REPORT_TOTAL_KEY,
-                                       pxMetrics->ulOpenTcpPortsArrayLength,
-                                       DEFENDER_REPORT_UDP_LISTENING_PORTS_KEY,
-                                       DEFENDER_REPORT_PORTS_KEY
-                                       );
-
-        if( !reportbuilderSNPRINTF_SUCCESS( lCharactersWritten, ulRemainingBufferLength ) )
-        {
-            LogError( ( "Failed to write part 2." ) );
-            eStatus = eReportBuilderBufferTooSmall;
-        }
-        else
-        {
-            ulRemainingBufferLength -= lCharactersWritten;
-            pcCurrentWritePos += lCharactersWritten;
-        }
-    }
-
-    /* Write UDP ports array. */
-    if( eStatus == eReportBuilderSuccess )
-    {
-        eStatus = prvWritePortsArray( pcCurrentWritePos,
-                                      ulRemainingBufferLength,
-                                      pxMetrics->pusOpenUdpPortsArray,
-                                      pxMetrics->ulOpenUdpPortsArrayLength,
-                                      &( bufferWritten ) );
-
-        if( eStatus == eReportBuilderSuccess )
-        {
-            pcCurrentWritePos += bufferWritten;
-            ulRemainingBufferLength -= bufferWritten;
-        }
-        else
-        {
-            LogError( ( "Failed to write UDP ports array." ) );
-        }
-    }
-
-    /* Write part3. */
     if( eStatus == eReportBuilderSuccess )
     {
-        lCharactersWritten = snprintf( pcCurrentWritePos,
-                                       ulRemainingBufferLength,
-                                       reportbuilderJSON_REPORT_FORMAT_PART3,
-                                       DEFENDER_REPORT_TOTAL_KEY,
-                                       pxMetrics->ulOpenUdpPortsArrayLength,
-                                       DEFENDER_REPORT_NETWORK_STATS_KEY,
-                                       DEFENDER_REPORT_BYTES_IN_KEY,
-                                       pxMetrics->pxNetworkStats->ulBytesReceived,
-                                       DEFENDER_REPORT_BYTES_OUT_KEY,
-                                       pxMetrics->pxNetworkStats->ulBytesSent,
-                                       DEFENDER_REPORT_PKTS_IN_KEY,
-                                       pxMetrics->pxNetworkStats->ulPacketsReceived,
-                                       DEFENDER_REPORT_PKTS_OUT_KEY,
-                                       pxMetrics->pxNetworkStats->ulPacketsSent,
-                                       DEFENDER_REPORT_TCP_CONNECTIONS_KEY,
-                                       DEFENDER_REPORT_ESTABLISHED_CONNECTIONS_KEY,
-                                       DEFENDER_REPORT_CONNECTIONS_KEY
-                                       );
-
-        if( !reportbuilderSNPRINTF_SUCCESS( lCharactersWritten, ulRemainingBufferLength ) )
-        {
-            LogError( ( "Failed to write part 3." ) );
-            eStatus = eReportBuilderBufferTooSmall;
-        }
-        else
-        {
-            ulRemainingBufferLength -= lCharactersWritten;
-            pcCurrentWritePos += lCharactersWritten;
-        }
-    }
-
-    /* Write connections array. */
-    if( eStatus == eReportBuilderSuccess )
-    {
-        eStatus = prvWriteConnectionsArray( pcCurrentWritePos,
-                                            ulRemainingBufferLength,
-                                            pxMetrics->pxEstablishedConnectionsArray,
-                                            pxMetrics->ulEstablishedConnectionsArrayLength,
-                                            &( bufferWritten ) );
+        vReportFormatterInit( &( xFormatter ), pcBuffer, ulBufferLength );
 
-        if( eStatus == eReportBuilderSuccess )
-        {
-            pcCurrentWritePos += bufferWritten;
-            ulRemainingBufferLength -= bufferWritten;
-        }
-        else
+        /* Write the header.  It is patched in place from the previous report,
+         * which only rewrites the report ID unless the version changed. */
+        if( xJsonHeaderCompiled == false )
         {
-            LogError( ( "Failed to write established connections array." ) );
+            xJsonHeaderCompiled = ( ePayloadTemplateCompile( &( xJsonHeader ),
+                                                             reportbuilderJSON_HEADER_PATTERN,
+                                                             cJsonHeaderBuffer,
+                                                             sizeof( cJsonHeaderBuffer ) ) == ePayloadTemplateSuccess );
+            configASSERT( xJsonHeaderCompiled == true );
         }
-    }
 
-    /* Write part4. */
-    if( eStatus == eReportBuilderSuccess )
-    {
-        lCharactersWritten = snprintf( pcCurrentWritePos,
-                                       ulRemainingBufferLength,
-                                       reportbuilderJSON_REPORT_FORMAT_PART4,
-                                       DEFENDER_REPORT_TOTAL_KEY,
-                                       pxMetrics->ulEstablishedConnectionsArrayLength,
-                                       DEFENDER_REPORT_CUSTOM_METRICS_KEY,
-                                       DEFENDER_REPORT_NUMBER_KEY,
-                                       pxMetrics->ulStackHighWaterMark,
-                                       DEFENDER_REPORT_NUMBER_LIST_KEY
-                                       );
-
-        if( !reportbuilderSNPRINTF_SUCCESS( lCharactersWritten, ulRemainingBufferLength ) )
-        {
-            LogError( ( "Failed to write part 4." ) );
+        /* Variable length number slots accept every uint32_t. */
+        ( void ) ePayloadTemplateSetNumber( &( xJsonHeader ), reportbuilderHEADER_SLOT_REPORT_ID, ulReportId );
+        ( void ) ePayloadTemplateSetNumber( &( xJsonHeader ), reportbuilderHEADER_SLOT_MAJOR_VERSION, ulMajorReportVersion );
+        ( void ) ePayloadTemplateSetNumber( &( xJsonHeader ), reportbuilderHEADER_SLOT_MINOR_VERSION, ulMinorReportVersion );
+        vReportFormatterAppendString( &( xFormatter ), xJsonHeader.pcPayload, ( uint32_t ) xJsonHeader.xLength );
+
+        /* Write TCP ports. The list of ports is left out when unchanged. */
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_TCP_PORTS );
+
+        if( ( pxMetrics->ulUnchangedSections & reportbuilderUNCHANGED_TCP_PORTS ) == 0U )
+        {
+            reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_PORTS_LIST );
+            prvWritePortsArray( &( xFormatter ),
+                                pxMetrics->pusOpenTcpPortsArray,
+                                pxMetrics->ulOpenTcpPortsArrayLength );
+            vReportFormatterAppendChar( &( xFormatter ), reportbuilderJSON_MEMBER_SEPARATOR );
+        }
+
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_TOTAL );
+        vReportFormatterAppendUInt32( &( xFormatter ), pxMetrics->ulOpenTcpPortsArrayLength );
+
+        /* Write UDP ports. The list of ports is left out when unchanged. */
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_UDP_PORTS );
+
+        if( ( pxMetrics->ulUnchangedSections & reportbuilderUNCHANGED_UDP_PORTS ) == 0U )
+        {
+            reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_PORTS_LIST );
+            prvWritePortsArray( &( xFormatter ),
+                                pxMetrics->pusOpenUdpPortsArray,
+                                pxMetrics->ulOpenUdpPortsArrayLength );
+            vReportFormatterAppendChar( &( xFormatter ), reportbuilderJSON_MEMBER_SEPARATOR );
+        }
+
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_TOTAL );
+        vReportFormatterAppendUInt32( &( xFormatter ), pxMetrics->ulOpenUdpPortsArrayLength );
+
+        /* Write network stats. */
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_BYTES_IN );
+        vReportFormatterAppendUInt32( &( xFormatter ), pxMetrics->pxNetworkStats->ulBytesReceived );
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_BYTES_OUT );
+        vReportFormatterAppendUInt32( &( xFormatter ), pxMetrics->pxNetworkStats->ulBytesSent );
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_PKTS_IN );
+        vReportFormatterAppendUInt32( &( xFormatter ), pxMetrics->pxNetworkStats->ulPacketsReceived );
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_PKTS_OUT );
+        vReportFormatterAppendUInt32( &( xFormatter ), pxMetrics->pxNetworkStats->ulPacketsSent );
+
+        /* Write established connections. The list of connections is left
+         * out when unchanged. */
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_CONNECTIONS );
+
+        if( ( pxMetrics->ulUnchangedSections & reportbuilderUNCHANGED_CONNECTIONS ) == 0U )
+        {
+            reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_CONNECTIONS_LIST );
+            prvWriteConnectionsArray( &( xFormatter ),
+                                      pxMetrics->pxEstablishedConnectionsArray,
+                                      pxMetrics->ulEstablishedConnectionsArrayLength );
+            vReportFormatterAppendChar( &( xFormatter ), reportbuilderJSON_MEMBER_SEPARATOR );
+        }
+
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_TOTAL );
+        vReportFormatterAppendUInt32( &( xFormatter ), pxMetrics->ulEstablishedConnectionsArrayLength );
+
+        /* Write custom metrics. The task numbers are left out when
+         * unchanged, and the CPU usage when run time stats are not
+         * available. */
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_STACK_HIGH_WATER_MARK );
+        vReportFormatterAppendUInt32( &( xFormatter ), pxMetrics->ulStackHighWaterMark );
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_CUSTOM_METRIC_END );
+
+        if( ( pxMetrics->ulUnchangedSections & reportbuilderUNCHANGED_TASK_NUMBERS ) == 0U )
+        {
+            prvWriteNumberListMetric( &( xFormatter ),
+                                      reportbuilderTASK_NUMBERS_METRIC_NAME,
+                                      reportbuilderSTRING_LENGTH( reportbuilderTASK_NUMBERS_METRIC_NAME ),
+                                      pxMetrics->pulTaskIdsArray,
+                                      pxMetrics->ulTaskIdsArrayLength );
+        }
+
+        if( pxMetrics->pulTaskCpuPercentArray != NULL )
+        {
+            prvWriteNumberListMetric( &( xFormatter ),
+                                      reportbuilderTASK_CPU_PERCENT_METRIC_NAME,
+                                      reportbuilderSTRING_LENGTH( reportbuilderTASK_CPU_PERCENT_METRIC_NAME ),
+                                      pxMetrics->pulTaskCpuPercentArray,
+                                      pxMetrics->ulTaskIdsArrayLength );
+        }
+
+        prvWriteNumberListMetric( &( xFormatter ),
+                                  reportbuilderTASK_STACK_HIGH_WATER_MARKS_METRIC_NAME,
+                                  reportbuilderSTRING_LENGTH( reportbuilderTASK_STACK_HIGH_WATER_MARKS_METRIC_NAME ),
+                                  pxMetrics->pulTaskStackHighWaterMarkArray,
+                                  pxMetrics->ulTaskIdsArrayLength );
+        prvWriteNumberMetric( &( xFormatter ),
+                              reportbuilderHEAP_FREE_METRIC_NAME,
+                              reportbuilderSTRING_LENGTH( reportbuilderHEAP_FREE_METRIC_NAME ),
+                              pxMetrics->ulHeapFreeBytes );
+        prvWriteNumberMetric( &( xFormatter ),
+                              reportbuilderHEAP_MINIMUM_EVER_FREE_METRIC_NAME,
+                              reportbuilderSTRING_LENGTH( reportbuilderHEAP_MINIMUM_EVER_FREE_METRIC_NAME ),
+                              pxMetrics->ulHeapMinimumEverFreeBytes );
+        prvWriteNumberMetric( &( xFormatter ),
+                              reportbuilderHEAP_LARGEST_FREE_BLOCK_METRIC_NAME,
+                              reportbuilderSTRING_LENGTH( reportbuilderHEAP_LARGEST_FREE_BLOCK_METRIC_NAME ),
+                              pxMetrics->ulHeapLargestFreeBlockBytes );
+        prvWriteNumberMetric( &( xFormatter ),
+                              reportbuilderAGENT_QUEUE_DEPTH_METRIC_NAME,
+                              reportbuilderSTRING_LENGTH( reportbuilderAGENT_QUEUE_DEPTH_METRIC_NAME ),
+                              pxMetrics->ulAgentQueueDepth );
+        prvWriteNumberMetric( &( xFormatter ),
+                              reportbuilderAGENT_IN_FLIGHT_METRIC_NAME,
+                              reportbuilderSTRING_LENGTH( reportbuilderAGENT_IN_FLIGHT_METRIC_NAME ),
+                              pxMetrics->ulAgentInFlight );
+
+        for( i = 0; i < pxMetrics->ulNumberListMetricsArrayLength; i++ )
+        {
+            prvWriteNumberListMetric( &( xFormatter ),
+                                      pxMetrics->pxNumberListMetricsArray[ i ].pcName,
+                                      pxMetrics->pxNumberListMetricsArray[ i ].ulNameLength,
+                                      pxMetrics->pxNumberListMetricsArray[ i ].pulNumbersArray,
+                                      pxMetrics->pxNumberListMetricsArray[ i ].ulNumbersArrayLength );
+        }
+
+        reportformatterAPPEND_LITERAL( &( xFormatter ), reportbuilderJSON_REPORT_END );
+
+        /* The formatter ignores everything appended after the buffer fills up,
+         * so checking once at the end is enough. */
+        if( eReportFormatterFinish( &( xFormatter ), &( ulReportLength ) ) != eReportFormatterSuccess )
+        {
+            LogError( ( "Buffer of %u bytes is too small for the report.",
+                        ulBufferLength ) );
             eStatus = eReportBuilderBufferTooSmall;
         }
         else
         {
-            ulRemainingBufferLength -= lCharactersWritten;
-            pcCurrentWritePos += lCharactersWritten;
+            *pulOutReportLength = ulReportLength;
         }
     }
 
-    /* Write task ids array. */
-    if( eStatus == eReportBuilderSuccess )
-    {
-        eStatus = prvWriteTaskIdsArray( pcCurrentWritePos,
-                                        ulRemainingBufferLength,
-                                        pxMetrics->pulTaskIdsArray,
-                                        pxMetrics->ulTaskIdsArrayLength,
-                                        &( bufferWritten ) );
-
-        if( eStatus == eReportBuilderSuccess )
-        {
-            pcCurrentWritePos += bufferWritten;
-            ulRemainingBufferLength -= bufferWritten;
-        }
-        else
-        {
-            LogError( ( "Failed to write task ids array." ) );
-        }
-    }
-
-    /* Write part5. */
-    if( eStatus == eReportBuilderSuccess )
-    {
-        lCharactersWritten = snprintf( pcCurrentWritePos,
-                                       ulRemainingBufferLength,
-                                       reportbuilderJSON_REPORT_FORMAT_PART5 );
-
-        if( !reportbuilderSNPRINTF_SUCCESS( lCharactersWritten, ulRemainingBufferLength ) )
-        {
-            LogError( ( "Failed to write part 5." ) );
-            eStatus = eReportBuilderBufferTooSmall;
-        }
-        else
-        {
-            ulRemainingBufferLength -= lCharactersWritten;
-            pcCurrentWritePos += lCharactersWritten;
-        }
-    }
-
-    if( eStatus == eReportBuilderSuccess )
-    {
-        *pulOutReportLength = ulBufferLength - ulRemainingBufferLength;
-    }
-
     return eStatus;
 }
 /*-----------------------------------------------------------*/
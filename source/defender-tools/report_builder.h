@@ -30,6 +30,33 @@
 /* Metrics collector. */
 #include "metrics_collector.h"
 
+/**
+ * @brief Sections of the report that can be reduced when they have not
+ * changed since the last report, for use in ReportMetrics_t.ulUnchangedSections.
+ *
+ * Only the totals are written for unchanged port and connection sections, and
+ * unchanged task numbers are left out of the custom metrics.
+ */
+#define reportbuilderUNCHANGED_TCP_PORTS       ( 1UL << 0 )
+#define reportbuilderUNCHANGED_UDP_PORTS       ( 1UL << 1 )
+#define reportbuilderUNCHANGED_CONNECTIONS     ( 1UL << 2 )
+#define reportbuilderUNCHANGED_TASK_NUMBERS    ( 1UL << 3 )
+
+/**
+ * @brief Names of the custom metrics sent in the report.  A custom metric with
+ * each of these names must be defined in AWS IoT Device Defender for the
+ * service to accept the report.
+ */
+#define reportbuilderSTACK_HIGH_WATER_MARK_METRIC_NAME          "stack_high_water_mark"
+#define reportbuilderTASK_NUMBERS_METRIC_NAME                   "task_numbers"
+#define reportbuilderTASK_CPU_PERCENT_METRIC_NAME               "task_cpu_percent"
+#define reportbuilderTASK_STACK_HIGH_WATER_MARKS_METRIC_NAME    "task_stack_high_water_marks"
+#define reportbuilderHEAP_FREE_METRIC_NAME                      "heap_free_bytes"
+#define reportbuilderHEAP_MINIMUM_EVER_FREE_METRIC_NAME         "heap_minimum_ever_free_bytes"
+#define reportbuilderHEAP_LARGEST_FREE_BLOCK_METRIC_NAME        "heap_largest_free_block_bytes"
+#define reportbuilderAGENT_QUEUE_DEPTH_METRIC_NAME              "mqtt_agent_queue_depth"
+#define reportbuilderAGENT_IN_FLIGHT_METRIC_NAME                "mqtt_agent_in_flight"
+
 /**
  * @brief Return codes from report builder APIs.
  */
@@ -37,14 +64,28 @@ typedef enum
 {
     eReportBuilderSuccess = 0,
     eReportBuilderBadParameter,
-    eReportBuilderBufferTooSmall
+    eReportBuilderBufferTooSmall,
+    eReportBuilderEncodingFailed
 } eReportBuilderStatus;
 
+/**
+ * @brief A number list type custom metric whose name is chosen at run time.
+ */
+typedef struct ReportNumberListMetric
+{
+    const char * pcName;
+    uint32_t ulNameLength;
+    const uint32_t * pulNumbersArray;
+    uint32_t ulNumbersArrayLength;
+} ReportNumberListMetric_t;
+
 /**
  * @brief Represents metrics to be included in the report, including custom metrics.
  *
- * This demo demonstrates the use of the stack high water mark and list of
- * running task ids as custom metrics sent to AWS IoT Device Defender service.
+ * This demo demonstrates the use of the stack high water mark, the list of
+ * running task ids, per task CPU usage and stack high water marks, heap usage
+ * and the state of the MQTT agent as custom metrics sent to AWS IoT Device
+ * Defender service.
  *
  * For more information on custom metrics, refer to the following AWS document:
  * https://docs.aws.amazon.com/iot/latest/developerguide/dd-detect-custom-metrics.html
@@ -62,12 +103,33 @@ typedef struct ReportMetrics
     uint32_t ulStackHighWaterMark;
     uint32_t * pulTaskIdsArray;
     uint32_t ulTaskIdsArrayLength;
+    /* Percentage of CPU time used by each task in pulTaskIdsArray since the
+     * previous report, in the same order. NULL if run time stats are not
+     * available, in which case the metric is not sent. */
+    uint32_t * pulTaskCpuPercentArray;
+    /* Stack high water mark of each task in pulTaskIdsArray, in the same
+     * order. */
+    uint32_t * pulTaskStackHighWaterMarkArray;
+    uint32_t ulHeapFreeBytes;
+    uint32_t ulHeapMinimumEverFreeBytes;
+    uint32_t ulHeapLargestFreeBlockBytes;
+    uint32_t ulAgentQueueDepth;
+    uint32_t ulAgentInFlight;
+    /* Further number list custom metrics, written after all the above. Can be
+     * NULL if ulNumberListMetricsArrayLength is 0. */
+    const ReportNumberListMetric_t * pxNumberListMetricsArray;
+    uint32_t ulNumberListMetricsArrayLength;
+    /* Bitwise OR of reportbuilderUNCHANGED_* values, or 0 for a full report. */
+    uint32_t ulUnchangedSections;
 } ReportMetrics_t;
 
 /**
  * @brief Generate a report in the format expected by the AWS IoT Device Defender
  * Service.
  *
+ * The report header is kept between calls and patched for each report, so
+ * this function must not be called from more than one task at a time.
+ *
  * @param[in] pcBuffer The buffer to write the report into.
  * @param[in] ulBufferLength The length of the buffer.
  * @param[in] pxMetrics Metrics to write in the generated report.
@@ -88,4 +150,33 @@ eReportBuilderStatus eGenerateJsonReport( char * pcBuffer,
                                           uint32_t ulReportId,
                                           uint32_t * pulOutReportLength );
 
+/**
+ * @brief Generate a CBOR encoded report in the format expected by the AWS IoT
+ * Device Defender Service.
+ *
+ * The report contains the same metrics as the one generated by
+ * eGenerateJsonReport() and uses the key names selected by
+ * DEFENDER_USE_LONG_KEYS.  It must be published to the CBOR report topic.
+ *
+ * @param[in] pucBuffer The buffer to write the report into.
+ * @param[in] ulBufferLength The length of the buffer.
+ * @param[in] pxMetrics Metrics to write in the generated report.
+ * @param[in] ulMajorReportVersion Major version of the report.
+ * @param[in] ulMinorReportVersion Minor version of the report.
+ * @param[in] ulReportId Value to be used as the ulReportId in the generated report.
+ * @param[out] pulOutReportLength The length of the generated report.
+ *
+ * @return #ReportBuilderSuccess if the report is successfully generated;
+ * #ReportBuilderBadParameter if invalid parameters are passed;
+ * #ReportBuilderBufferTooSmall if the buffer cannot hold the full report;
+ * #eReportBuilderEncodingFailed if the CBOR encoder reports any other error.
+ */
+eReportBuilderStatus eGenerateCborReport( uint8_t * pucBuffer,
+                                          uint32_t ulBufferLength,
+                                          const ReportMetrics_t * pxMetrics,
+                                          uint32_t ulMajorReportVersion,
+                                          uint32_t ulMinorReportVersion,
+                                          uint32_t ulReportId,
+                                          uint32_t * pulOutReportLength );
+
 #endif /* ifndef REPORT_BUILDER_H_ */
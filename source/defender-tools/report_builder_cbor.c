@@ -0,0 +1,975 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file report_builder_cbor.c
+ *
+ * @brief Generates the device defender report in the CBOR format accepted by
+ * the AWS IoT Device Defender Service.
+ *
+ * The report has the same layout as the JSON report generated by
+ * eGenerateJsonReport() and is encoded with tinycbor, so no printf family
+ * function is used to build it.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/* Demo config. */
+#include "demo_config.h"
+
+/* Device Defender Client Library. */
+#include "defender.h"
+
+/* tinycbor include. */
+#include "cbor.h"
+
+/* Interface include. */
+#include "report_builder.h"
+
+/* Text formatting without printf. */
+#include "report_formatter.h"
+
+/* Length of a string literal, excluding the terminating NULL character. */
+#define reportbuilderSTRING_LENGTH( str )                   ( sizeof( str ) - 1U )
+
+/* Number of entries in the maps that make up the report. */
+#define reportbuilderREPORT_MAP_ITEM_COUNT                  ( 3U )
+#define reportbuilderHEADER_MAP_ITEM_COUNT                  ( 2U )
+#define reportbuilderMETRICS_MAP_ITEM_COUNT                 ( 4U )
+#define reportbuilderNETWORK_STATS_MAP_ITEM_COUNT           ( 4U )
+#define reportbuilderTCP_CONNECTIONS_MAP_ITEM_COUNT         ( 1U )
+#define reportbuilderCONNECTION_MAP_ITEM_COUNT              ( 2U )
+#define reportbuilderCUSTOM_METRICS_MAP_ITEM_COUNT          ( 9U )
+
+/* Number of entries in a ports or connections map, which holds the list and
+ * the total, or only the total when the list has not changed. */
+#define reportbuilderLIST_AND_TOTAL_MAP_ITEM_COUNT          ( 2U )
+#define reportbuilderTOTAL_ONLY_MAP_ITEM_COUNT              ( 1U )
+
+/* Size of the buffer used to format "a.b.c.d:port" and "major.minor" strings,
+ * including the NULL terminator written by the formatter. */
+#define reportbuilderMAX_FORMATTED_STRING_LENGTH            ( ( 2U * reportformatterMAX_UINT32_LENGTH ) + 2U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Encode a key and an unsigned integer value into a map.
+ *
+ * @param[in] pxMapEncoder The encoder of the map.
+ * @param[in] pcKey The key.
+ * @param[in] xKeyLength Length of the key.
+ * @param[in] ulValue The value.
+ *
+ * @return CborNoError if the entry is successfully encoded; the tinycbor error
+ * otherwise.
+ */
+static CborError prvEncodeUnsignedEntry( CborEncoder * pxMapEncoder,
+                                         const char * pcKey,
+                                         size_t xKeyLength,
+                                         uint32_t ulValue );
+
+/**
+ * @brief Encode the report header into the report map.
+ *
+ * This function encodes a map of the following format:
+ * "hed": {
+ *     "rid": 1530304554,
+ *     "v": "1.0"
+ * }
+ *
+ * @param[in] pxReportEncoder The encoder of the report map.
+ * @param[in] ulMajorReportVersion Major version of the report.
+ * @param[in] ulMinorReportVersion Minor version of the report.
+ * @param[in] ulReportId Value to be used as the report id.
+ *
+ * @return CborNoError if the header is successfully encoded; the tinycbor
+ * error otherwise.
+ */
+static CborError prvEncodeHeader( CborEncoder * pxReportEncoder,
+                                  uint32_t ulMajorReportVersion,
+                                  uint32_t ulMinorReportVersion,
+                                  uint32_t ulReportId );
+
+/**
+ * @brief Encode listening ports into the metrics map.
+ *
+ * This function encodes a map of the following format:
+ * "tp": {
+ *     "pts": [
+ *         { "pt": 44207 },
+ *         { "pt": 53 }
+ *     ],
+ *     "t": 2
+ * }
+ *
+ * @param[in] pxMetricsEncoder The encoder of the metrics map.
+ * @param[in] pcKey Key of the ports map, either the TCP or the UDP listening
+ * ports key.
+ * @param[in] xKeyLength Length of the key.
+ * @param[in] pusOpenPortsArray The array containing the open ports.
+ * @param[in] ulOpenPortsArrayLength Length of the pusOpenPortsArray array.
+ * @param[in] xIncludeList false to encode only the total number of ports.
+ *
+ * @return CborNoError if the ports are successfully encoded; the tinycbor
+ * error otherwise.
+ */
+static CborError prvEncodePorts( CborEncoder * pxMetricsEncoder,
+                                 const char * pcKey,
+                                 size_t xKeyLength,
+                                 const uint16_t * pusOpenPortsArray,
+                                 uint32_t ulOpenPortsArrayLength,
+                                 bool xIncludeList );
+
+/**
+ * @brief Encode network statistics into the metrics map.
+ *
+ * This function encodes a map of the following format:
+ * "ns": {
+ *     "bi": 29358693495,
+ *     "bo": 26485035,
+ *     "pi": 10013573555,
+ *     "po": 11382615
+ * }
+ *
+ * @param[in] pxMetricsEncoder The encoder of the metrics map.
+ * @param[in] pxNetworkStats The network statistics.
+ *
+ * @return CborNoError if the statistics are successfully encoded; the tinycbor
+ * error otherwise.
+ */
+static CborError prvEncodeNetworkStats( CborEncoder * pxMetricsEncoder,
+                                        const NetworkStats_t * pxNetworkStats );
+
+/**
+ * @brief Encode established connections into the metrics map.
+ *
+ * This function encodes a map of the following format:
+ * "tc": {
+ *     "ec": {
+ *         "cs": [
+ *             {
+ *                 "lp": 44207,
+ *                 "rad": "127.0.0.1:45148"
+ *             }
+ *         ],
+ *         "t": 1
+ *     }
+ * }
+ *
+ * @param[in] pxMetricsEncoder The encoder of the metrics map.
+ * @param[in] pxConnectionsArray The array containing the established connections.
+ * @param[in] ulConnectionsArrayLength Length of the pxConnectionsArray array.
+ * @param[in] xIncludeList false to encode only the total number of connections.
+ *
+ * @return CborNoError if the connections are successfully encoded; the
+ * tinycbor error otherwise.
+ */
+static CborError prvEncodeConnections( CborEncoder * pxMetricsEncoder,
+                                       const Connection_t * pxConnectionsArray,
+                                       uint32_t ulConnectionsArrayLength,
+                                       bool xIncludeList );
+
+/**
+ * @brief Encode the custom metrics into the report map.
+ *
+ * This function encodes a map of the following format:
+ * "cmet": {
+ *     "stack_high_water_mark": [
+ *         { "number": 180 }
+ *     ],
+ *     "task_numbers": [
+ *         { "number_list": [ 1, 2, 3 ] }
+ *     ],
+ *     "task_cpu_percent": [
+ *         { "number_list": [ 90, 2, 8 ] }
+ *     ],
+ *     ...
+ * }
+ *
+ * @param[in] pxReportEncoder The encoder of the report map.
+ * @param[in] pxMetrics Metrics containing the custom metrics.
+ *
+ * @return CborNoError if the custom metrics are successfully encoded; the
+ * tinycbor error otherwise.
+ */
+static CborError prvEncodeCustomMetrics( CborEncoder * pxReportEncoder,
+                                         const ReportMetrics_t * pxMetrics );
+
+/**
+ * @brief Encode a number type custom metric into the custom metrics map.
+ *
+ * This function encodes an entry of the following format:
+ * "heap_free_bytes": [
+ *     { "number": 51200 }
+ * ]
+ *
+ * @param[in] pxCustomMetricsEncoder The encoder of the custom metrics map.
+ * @param[in] pcName Name of the custom metric.
+ * @param[in] xNameLength Length of the name.
+ * @param[in] ulValue Value of the custom metric.
+ *
+ * @return CborNoError if the metric is successfully encoded; the tinycbor
+ * error otherwise.
+ */
+static CborError prvEncodeNumberMetric( CborEncoder * pxCustomMetricsEncoder,
+                                        const char * pcName,
+                                        size_t xNameLength,
+                                        uint32_t ulValue );
+
+/**
+ * @brief Encode a number list type custom metric into the custom metrics map.
+ *
+ * This function encodes an entry of the following format:
+ * "task_numbers": [
+ *     { "number_list": [ 1, 2, 3 ] }
+ * ]
+ *
+ * @param[in] pxCustomMetricsEncoder The encoder of the custom metrics map.
+ * @param[in] pcName Name of the custom metric.
+ * @param[in] xNameLength Length of the name.
+ * @param[in] pulNumbersArray The array containing the numbers.
+ * @param[in] ulNumbersArrayLength Length of the pulNumbersArray array.
+ *
+ * @return CborNoError if the metric is successfully encoded; the tinycbor
+ * error otherwise.
+ */
+static CborError prvEncodeNumberListMetric( CborEncoder * pxCustomMetricsEncoder,
+                                            const char * pcName,
+                                            size_t xNameLength,
+                                            const uint32_t * pulNumbersArray,
+                                            uint32_t ulNumbersArrayLength );
+/*-----------------------------------------------------------*/
+
+static CborError prvEncodeUnsignedEntry( CborEncoder * pxMapEncoder,
+                                         const char * pcKey,
+                                         size_t xKeyLength,
+                                         uint32_t ulValue )
+{
+    CborError xCborError;
+
+    xCborError = cbor_encode_text_string( pxMapEncoder, pcKey, xKeyLength );
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encode_uint( pxMapEncoder, ulValue );
+    }
+
+    return xCborError;
+}
+/*-----------------------------------------------------------*/
+
+static CborError prvEncodeHeader( CborEncoder * pxReportEncoder,
+                                  uint32_t ulMajorReportVersion,
+                                  uint32_t ulMinorReportVersion,
+                                  uint32_t ulReportId )
+{
+    CborEncoder xHeaderEncoder;
+    CborError xCborError;
+    ReportFormatter_t xFormatter;
+    char pcVersion[ reportbuilderMAX_FORMATTED_STRING_LENGTH ];
+    uint32_t ulVersionLength;
+
+    /* Format the version as "major.minor". The buffer is large enough for
+     * any version. */
+    vReportFormatterInit( &( xFormatter ), &( pcVersion[ 0 ] ), sizeof( pcVersion ) );
+    vReportFormatterAppendUInt32( &( xFormatter ), ulMajorReportVersion );
+    vReportFormatterAppendChar( &( xFormatter ), '.' );
+    vReportFormatterAppendUInt32( &( xFormatter ), ulMinorReportVersion );
+    ( void ) eReportFormatterFinish( &( xFormatter ), &( ulVersionLength ) );
+
+    xCborError = cbor_encode_text_string( pxReportEncoder,
+                                          DEFENDER_REPORT_HEADER_KEY,
+                                          reportbuilderSTRING_LENGTH( DEFENDER_REPORT_HEADER_KEY ) );
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_map( pxReportEncoder,
+                                              &( xHeaderEncoder ),
+                                              reportbuilderHEADER_MAP_ITEM_COUNT );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeUnsignedEntry( &( xHeaderEncoder ),
+                                             DEFENDER_REPORT_ID_KEY,
+                                             reportbuilderSTRING_LENGTH( DEFENDER_REPORT_ID_KEY ),
+                                             ulReportId );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encode_text_string( &( xHeaderEncoder ),
+                                              DEFENDER_REPORT_VERSION_KEY,
+                                              reportbuilderSTRING_LENGTH( DEFENDER_REPORT_VERSION_KEY ) );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encode_text_string( &( xHeaderEncoder ),
+                                              &( pcVersion[ 0 ] ),
+                                              ulVersionLength );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( pxReportEncoder, &( xHeaderEncoder ) );
+    }
+
+    return xCborError;
+}
+/*-----------------------------------------------------------*/
+
+static CborError prvEncodePorts( CborEncoder * pxMetricsEncoder,
+                                 const char * pcKey,
+                                 size_t xKeyLength,
+                                 const uint16_t * pusOpenPortsArray,
+                                 uint32_t ulOpenPortsArrayLength,
+                                 bool xIncludeList )
+{
+    CborEncoder xPortsEncoder, xArrayEncoder, xPortEncoder;
+    CborError xCborError;
+    uint32_t i;
+
+    configASSERT( pusOpenPortsArray != NULL );
+
+    xCborError = cbor_encode_text_string( pxMetricsEncoder, pcKey, xKeyLength );
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_map( pxMetricsEncoder,
+                                              &( xPortsEncoder ),
+                                              ( xIncludeList == true ) ? reportbuilderLIST_AND_TOTAL_MAP_ITEM_COUNT : reportbuilderTOTAL_ONLY_MAP_ITEM_COUNT );
+    }
+
+    /* Write the list of ports unless only the total is wanted. */
+    if( ( xCborError == CborNoError ) && ( xIncludeList == true ) )
+    {
+        xCborError = cbor_encode_text_string( &( xPortsEncoder ),
+                                              DEFENDER_REPORT_PORTS_KEY,
+                                              reportbuilderSTRING_LENGTH( DEFENDER_REPORT_PORTS_KEY ) );
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = cbor_encoder_create_array( &( xPortsEncoder ),
+                                                    &( xArrayEncoder ),
+                                                    ulOpenPortsArrayLength );
+        }
+
+        /* Write the array elements. */
+        for( i = 0; ( ( i < ulOpenPortsArrayLength ) && ( xCborError == CborNoError ) ); i++ )
+        {
+            xCborError = cbor_encoder_create_map( &( xArrayEncoder ), &( xPortEncoder ), 1U );
+
+            if( xCborError == CborNoError )
+            {
+                xCborError = prvEncodeUnsignedEntry( &( xPortEncoder ),
+                                                     DEFENDER_REPORT_PORT_KEY,
+                                                     reportbuilderSTRING_LENGTH( DEFENDER_REPORT_PORT_KEY ),
+                                                     pusOpenPortsArray[ i ] );
+            }
+
+            if( xCborError == CborNoError )
+            {
+                xCborError = cbor_encoder_close_container( &( xArrayEncoder ), &( xPortEncoder ) );
+            }
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = cbor_encoder_close_container( &( xPortsEncoder ), &( xArrayEncoder ) );
+        }
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeUnsignedEntry( &( xPortsEncoder ),
+                                             DEFENDER_REPORT_TOTAL_KEY,
+                                             reportbuilderSTRING_LENGTH( DEFENDER_REPORT_TOTAL_KEY ),
+                                             ulOpenPortsArrayLength );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( pxMetricsEncoder, &( xPortsEncoder ) );
+    }
+
+    return xCborError;
+}
+/*-----------------------------------------------------------*/
+
+static CborError prvEncodeNetworkStats( CborEncoder * pxMetricsEncoder,
+                                        const NetworkStats_t * pxNetworkStats )
+{
+    CborEncoder xNetworkStatsEncoder;
+    CborError xCborError;
+
+    configASSERT( pxNetworkStats != NULL );
+
+    xCborError = cbor_encode_text_string( pxMetricsEncoder,
+                                          DEFENDER_REPORT_NETWORK_STATS_KEY,
+                                          reportbuilderSTRING_LENGTH( DEFENDER_REPORT_NETWORK_STATS_KEY ) );
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_map( pxMetricsEncoder,
+                                              &( xNetworkStatsEncoder ),
+                                              reportbuilderNETWORK_STATS_MAP_ITEM_COUNT );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeUnsignedEntry( &( xNetworkStatsEncoder ),
+                                             DEFENDER_REPORT_BYTES_IN_KEY,
+                                             reportbuilderSTRING_LENGTH( DEFENDER_REPORT_BYTES_IN_KEY ),
+                                             pxNetworkStats->ulBytesReceived );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeUnsignedEntry( &( xNetworkStatsEncoder ),
+                                             DEFENDER_REPORT_BYTES_OUT_KEY,
+                                             reportbuilderSTRING_LENGTH( DEFENDER_REPORT_BYTES_OUT_KEY ),
+                                             pxNetworkStats->ulBytesSent );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeUnsignedEntry( &( xNetworkStatsEncoder ),
+                                             DEFENDER_REPORT_PKTS_IN_KEY,
+                                             reportbuilderSTRING_LENGTH( DEFENDER_REPORT_PKTS_IN_KEY ),
+                                             pxNetworkStats->ulPacketsReceived );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeUnsignedEntry( &( xNetworkStatsEncoder ),
+                                             DEFENDER_REPORT_PKTS_OUT_KEY,
+                                             reportbuilderSTRING_LENGTH( DEFENDER_REPORT_PKTS_OUT_KEY ),
+                                             pxNetworkStats->ulPacketsSent );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( pxMetricsEncoder, &( xNetworkStatsEncoder ) );
+    }
+
+    return xCborError;
+}
+/*-----------------------------------------------------------*/
+
+static CborError prvEncodeConnections( CborEncoder * pxMetricsEncoder,
+                                       const Connection_t * pxConnectionsArray,
+                                       uint32_t ulConnectionsArrayLength,
+                                       bool xIncludeList )
+{
+    CborEncoder xTcpConnectionsEncoder, xEstablishedEncoder, xArrayEncoder, xConnectionEncoder;
+    CborError xCborError;
+    const Connection_t * pxConn;
+    ReportFormatter_t xFormatter;
+    char pcRemoteAddress[ reportbuilderMAX_FORMATTED_STRING_LENGTH ];
+    uint32_t i, ulRemoteAddressLength;
+
+    configASSERT( pxConnectionsArray != NULL );
+
+    xCborError = cbor_encode_text_string( pxMetricsEncoder,
+                                          DEFENDER_REPORT_TCP_CONNECTIONS_KEY,
+                                          reportbuilderSTRING_LENGTH( DEFENDER_REPORT_TCP_CONNECTIONS_KEY ) );
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_map( pxMetricsEncoder,
+                                              &( xTcpConnectionsEncoder ),
+                                              reportbuilderTCP_CONNECTIONS_MAP_ITEM_COUNT );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encode_text_string( &( xTcpConnectionsEncoder ),
+                                              DEFENDER_REPORT_ESTABLISHED_CONNECTIONS_KEY,
+                                              reportbuilderSTRING_LENGTH( DEFENDER_REPORT_ESTABLISHED_CONNECTIONS_KEY ) );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_map( &( xTcpConnectionsEncoder ),
+                                              &( xEstablishedEncoder ),
+                                              ( xIncludeList == true ) ? reportbuilderLIST_AND_TOTAL_MAP_ITEM_COUNT : reportbuilderTOTAL_ONLY_MAP_ITEM_COUNT );
+    }
+
+    /* Write the list of connections unless only the total is wanted. */
+    if( ( xCborError == CborNoError ) && ( xIncludeList == true ) )
+    {
+        xCborError = cbor_encode_text_string( &( xEstablishedEncoder ),
+                                              DEFENDER_REPORT_CONNECTIONS_KEY,
+                                              reportbuilderSTRING_LENGTH( DEFENDER_REPORT_CONNECTIONS_KEY ) );
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = cbor_encoder_create_array( &( xEstablishedEncoder ),
+                                                    &( xArrayEncoder ),
+                                                    ulConnectionsArrayLength );
+        }
+
+        /* Write the array elements. */
+        for( i = 0; ( ( i < ulConnectionsArrayLength ) && ( xCborError == CborNoError ) ); i++ )
+        {
+            pxConn = &( pxConnectionsArray[ i ] );
+
+            /* Format the remote address as "a.b.c.d:port". The buffer is large
+             * enough for any address. */
+            vReportFormatterInit( &( xFormatter ), &( pcRemoteAddress[ 0 ] ), sizeof( pcRemoteAddress ) );
+            vReportFormatterAppendIPv4( &( xFormatter ), pxConn->ulRemoteIp );
+            vReportFormatterAppendChar( &( xFormatter ), ':' );
+            vReportFormatterAppendUInt32( &( xFormatter ), pxConn->usRemotePort );
+            ( void ) eReportFormatterFinish( &( xFormatter ), &( ulRemoteAddressLength ) );
+
+            xCborError = cbor_encoder_create_map( &( xArrayEncoder ),
+                                                  &( xConnectionEncoder ),
+                                                  reportbuilderCONNECTION_MAP_ITEM_COUNT );
+
+            if( xCborError == CborNoError )
+            {
+                xCborError = prvEncodeUnsignedEntry( &( xConnectionEncoder ),
+                                                     DEFENDER_REPORT_LOCAL_PORT_KEY,
+                                                     reportbuilderSTRING_LENGTH( DEFENDER_REPORT_LOCAL_PORT_KEY ),
+                                                     pxConn->usLocalPort );
+            }
+
+            if( xCborError == CborNoError )
+            {
+                xCborError = cbor_encode_text_string( &( xConnectionEncoder ),
+                                                      DEFENDER_REPORT_REMOTE_ADDR_KEY,
+                                                      reportbuilderSTRING_LENGTH( DEFENDER_REPORT_REMOTE_ADDR_KEY ) );
+            }
+
+            if( xCborError == CborNoError )
+            {
+                xCborError = cbor_encode_text_string( &( xConnectionEncoder ),
+                                                      &( pcRemoteAddress[ 0 ] ),
+                                                      ulRemoteAddressLength );
+            }
+
+            if( xCborError == CborNoError )
+            {
+                xCborError = cbor_encoder_close_container( &( xArrayEncoder ), &( xConnectionEncoder ) );
+            }
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = cbor_encoder_close_container( &( xEstablishedEncoder ), &( xArrayEncoder ) );
+        }
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeUnsignedEntry( &( xEstablishedEncoder ),
+                                             DEFENDER_REPORT_TOTAL_KEY,
+                                             reportbuilderSTRING_LENGTH( DEFENDER_REPORT_TOTAL_KEY ),
+                                             ulConnectionsArrayLength );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( &( xTcpConnectionsEncoder ), &( xEstablishedEncoder ) );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( pxMetricsEncoder, &( xTcpConnectionsEncoder ) );
+    }
+
+    return xCborError;
+}
+/*-----------------------------------------------------------*/
+
+static CborError prvEncodeNumberMetric( CborEncoder * pxCustomMetricsEncoder,
+                                        const char * pcName,
+                                        size_t xNameLength,
+                                        uint32_t ulValue )
+{
+    CborEncoder xMetricArrayEncoder, xMetricEncoder;
+    CborError xCborError;
+
+    xCborError = cbor_encode_text_string( pxCustomMetricsEncoder, pcName, xNameLength );
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_array( pxCustomMetricsEncoder, &( xMetricArrayEncoder ), 1U );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_map( &( xMetricArrayEncoder ), &( xMetricEncoder ), 1U );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeUnsignedEntry( &( xMetricEncoder ),
+                                             DEFENDER_REPORT_NUMBER_KEY,
+                                             reportbuilderSTRING_LENGTH( DEFENDER_REPORT_NUMBER_KEY ),
+                                             ulValue );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( &( xMetricArrayEncoder ), &( xMetricEncoder ) );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( pxCustomMetricsEncoder, &( xMetricArrayEncoder ) );
+    }
+
+    return xCborError;
+}
+/*-----------------------------------------------------------*/
+
+static CborError prvEncodeNumberListMetric( CborEncoder * pxCustomMetricsEncoder,
+                                            const char * pcName,
+                                            size_t xNameLength,
+                                            const uint32_t * pulNumbersArray,
+                                            uint32_t ulNumbersArrayLength )
+{
+    CborEncoder xMetricArrayEncoder, xMetricEncoder, xListEncoder;
+    CborError xCborError;
+    uint32_t i;
+
+    configASSERT( pulNumbersArray != NULL );
+
+    xCborError = cbor_encode_text_string( pxCustomMetricsEncoder, pcName, xNameLength );
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_array( pxCustomMetricsEncoder, &( xMetricArrayEncoder ), 1U );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_map( &( xMetricArrayEncoder ), &( xMetricEncoder ), 1U );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encode_text_string( &( xMetricEncoder ),
+                                              DEFENDER_REPORT_NUMBER_LIST_KEY,
+                                              reportbuilderSTRING_LENGTH( DEFENDER_REPORT_NUMBER_LIST_KEY ) );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_array( &( xMetricEncoder ),
+                                                &( xListEncoder ),
+                                                ulNumbersArrayLength );
+    }
+
+    for( i = 0; ( ( i < ulNumbersArrayLength ) && ( xCborError == CborNoError ) ); i++ )
+    {
+        xCborError = cbor_encode_uint( &( xListEncoder ), pulNumbersArray[ i ] );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( &( xMetricEncoder ), &( xListEncoder ) );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( &( xMetricArrayEncoder ), &( xMetricEncoder ) );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( pxCustomMetricsEncoder, &( xMetricArrayEncoder ) );
+    }
+
+    return xCborError;
+}
+/*-----------------------------------------------------------*/
+
+static CborError prvEncodeCustomMetrics( CborEncoder * pxReportEncoder,
+                                         const ReportMetrics_t * pxMetrics )
+{
+    CborEncoder xCustomMetricsEncoder;
+    CborError xCborError;
+    bool xIncludeTaskNumbers = ( ( pxMetrics->ulUnchangedSections & reportbuilderUNCHANGED_TASK_NUMBERS ) == 0U );
+    bool xIncludeTaskCpuPercent = ( pxMetrics->pulTaskCpuPercentArray != NULL );
+    size_t xItemCount = reportbuilderCUSTOM_METRICS_MAP_ITEM_COUNT + pxMetrics->ulNumberListMetricsArrayLength;
+    uint32_t i;
+
+    /* The fixed metrics are followed by the number list metrics passed in by
+     * the caller. The task numbers are left out when unchanged, and the CPU
+     * usage when run time stats are not available. */
+    if( xIncludeTaskNumbers == false )
+    {
+        xItemCount--;
+    }
+
+    if( xIncludeTaskCpuPercent == false )
+    {
+        xItemCount--;
+    }
+
+    xCborError = cbor_encode_text_string( pxReportEncoder,
+                                          DEFENDER_REPORT_CUSTOM_METRICS_KEY,
+                                          reportbuilderSTRING_LENGTH( DEFENDER_REPORT_CUSTOM_METRICS_KEY ) );
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_create_map( pxReportEncoder, &( xCustomMetricsEncoder ), xItemCount );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeNumberMetric( &( xCustomMetricsEncoder ),
+                                            reportbuilderSTACK_HIGH_WATER_MARK_METRIC_NAME,
+                                            reportbuilderSTRING_LENGTH( reportbuilderSTACK_HIGH_WATER_MARK_METRIC_NAME ),
+                                            pxMetrics->ulStackHighWaterMark );
+    }
+
+    if( ( xCborError == CborNoError ) && ( xIncludeTaskNumbers == true ) )
+    {
+        xCborError = prvEncodeNumberListMetric( &( xCustomMetricsEncoder ),
+                                                reportbuilderTASK_NUMBERS_METRIC_NAME,
+                                                reportbuilderSTRING_LENGTH( reportbuilderTASK_NUMBERS_METRIC_NAME ),
+                                                pxMetrics->pulTaskIdsArray,
+                                                pxMetrics->ulTaskIdsArrayLength );
+    }
+
+    if( ( xCborError == CborNoError ) && ( xIncludeTaskCpuPercent == true ) )
+    {
+        xCborError = prvEncodeNumberListMetric( &( xCustomMetricsEncoder ),
+                                                reportbuilderTASK_CPU_PERCENT_METRIC_NAME,
+                                                reportbuilderSTRING_LENGTH( reportbuilderTASK_CPU_PERCENT_METRIC_NAME ),
+                                                pxMetrics->pulTaskCpuPercentArray,
+                                                pxMetrics->ulTaskIdsArrayLength );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeNumberListMetric( &( xCustomMetricsEncoder ),
+                                                reportbuilderTASK_STACK_HIGH_WATER_MARKS_METRIC_NAME,
+                                                reportbuilderSTRING_LENGTH( reportbuilderTASK_STACK_HIGH_WATER_MARKS_METRIC_NAME ),
+                                                pxMetrics->pulTaskStackHighWaterMarkArray,
+                                                pxMetrics->ulTaskIdsArrayLength );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeNumberMetric( &( xCustomMetricsEncoder ),
+                                            reportbuilderHEAP_FREE_METRIC_NAME,
+                                            reportbuilderSTRING_LENGTH( reportbuilderHEAP_FREE_METRIC_NAME ),
+                                            pxMetrics->ulHeapFreeBytes );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeNumberMetric( &( xCustomMetricsEncoder ),
+                                            reportbuilderHEAP_MINIMUM_EVER_FREE_METRIC_NAME,
+                                            reportbuilderSTRING_LENGTH( reportbuilderHEAP_MINIMUM_EVER_FREE_METRIC_NAME ),
+                                            pxMetrics->ulHeapMinimumEverFreeBytes );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeNumberMetric( &( xCustomMetricsEncoder ),
+                                            reportbuilderHEAP_LARGEST_FREE_BLOCK_METRIC_NAME,
+                                            reportbuilderSTRING_LENGTH( reportbuilderHEAP_LARGEST_FREE_BLOCK_METRIC_NAME ),
+                                            pxMetrics->ulHeapLargestFreeBlockBytes );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeNumberMetric( &( xCustomMetricsEncoder ),
+                                            reportbuilderAGENT_QUEUE_DEPTH_METRIC_NAME,
+                                            reportbuilderSTRING_LENGTH( reportbuilderAGENT_QUEUE_DEPTH_METRIC_NAME ),
+                                            pxMetrics->ulAgentQueueDepth );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = prvEncodeNumberMetric( &( xCustomMetricsEncoder ),
+                                            reportbuilderAGENT_IN_FLIGHT_METRIC_NAME,
+                                            reportbuilderSTRING_LENGTH( reportbuilderAGENT_IN_FLIGHT_METRIC_NAME ),
+                                            pxMetrics->ulAgentInFlight );
+    }
+
+    for( i = 0; ( ( i < pxMetrics->ulNumberListMetricsArrayLength ) && ( xCborError == CborNoError ) ); i++ )
+    {
+        xCborError = prvEncodeNumberListMetric( &( xCustomMetricsEncoder ),
+                                                pxMetrics->pxNumberListMetricsArray[ i ].pcName,
+                                                pxMetrics->pxNumberListMetricsArray[ i ].ulNameLength,
+                                                pxMetrics->pxNumberListMetricsArray[ i ].pulNumbersArray,
+                                                pxMetrics->pxNumberListMetricsArray[ i ].ulNumbersArrayLength );
+    }
+
+    if( xCborError == CborNoError )
+    {
+        xCborError = cbor_encoder_close_container( pxReportEncoder, &( xCustomMetricsEncoder ) );
+    }
+
+    return xCborError;
+}
+/*-----------------------------------------------------------*/
+
+eReportBuilderStatus eGenerateCborReport( uint8_t * pucBuffer,
+                                          uint32_t ulBufferLength,
+                                          const ReportMetrics_t * pxMetrics,
+                                          uint32_t ulMajorReportVersion,
+                                          uint32_t ulMinorReportVersion,
+                                          uint32_t ulReportId,
+                                          uint32_t * pulOutReportLength )
+{
+    CborEncoder xEncoder, xReportEncoder, xMetricsEncoder;
+    CborError xCborError = CborNoError;
+    eReportBuilderStatus eStatus = eReportBuilderSuccess;
+
+    configASSERT( pucBuffer != NULL );
+    configASSERT( pxMetrics != NULL );
+    configASSERT( pulOutReportLength != NULL );
+    configASSERT( ulBufferLength != 0 );
+
+    if( ( pucBuffer == NULL ) ||
+        ( ulBufferLength == 0 ) ||
+        ( pxMetrics == NULL ) ||
+        ( pulOutReportLength == NULL ) )
+    {
+        LogError( ( "Invalid parameters. pucBuffer: %p, ulBufferLength: %u"
+                    " pMetrics: %p, pOutReportLength: %p.",
+                    pucBuffer,
+                    ulBufferLength,
+                    pxMetrics,
+                    pulOutReportLength ) );
+        eStatus = eReportBuilderBadParameter;
+    }
+
+    if( eStatus == eReportBuilderSuccess )
+    {
+        cbor_encoder_init( &( xEncoder ), pucBuffer, ulBufferLength, 0 );
+
+        xCborError = cbor_encoder_create_map( &( xEncoder ),
+                                              &( xReportEncoder ),
+                                              reportbuilderREPORT_MAP_ITEM_COUNT );
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = prvEncodeHeader( &( xReportEncoder ),
+                                          ulMajorReportVersion,
+                                          ulMinorReportVersion,
+                                          ulReportId );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = cbor_encode_text_string( &( xReportEncoder ),
+                                                  DEFENDER_REPORT_METRICS_KEY,
+                                                  reportbuilderSTRING_LENGTH( DEFENDER_REPORT_METRICS_KEY ) );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = cbor_encoder_create_map( &( xReportEncoder ),
+                                                  &( xMetricsEncoder ),
+                                                  reportbuilderMETRICS_MAP_ITEM_COUNT );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = prvEncodePorts( &( xMetricsEncoder ),
+                                         DEFENDER_REPORT_TCP_LISTENING_PORTS_KEY,
+                                         reportbuilderSTRING_LENGTH( DEFENDER_REPORT_TCP_LISTENING_PORTS_KEY ),
+                                         pxMetrics->pusOpenTcpPortsArray,
+                                         pxMetrics->ulOpenTcpPortsArrayLength,
+                                         ( ( pxMetrics->ulUnchangedSections & reportbuilderUNCHANGED_TCP_PORTS ) == 0U ) );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = prvEncodePorts( &( xMetricsEncoder ),
+                                         DEFENDER_REPORT_UDP_LISTENING_PORTS_KEY,
+                                         reportbuilderSTRING_LENGTH( DEFENDER_REPORT_UDP_LISTENING_PORTS_KEY ),
+                                         pxMetrics->pusOpenUdpPortsArray,
+                                         pxMetrics->ulOpenUdpPortsArrayLength,
+                                         ( ( pxMetrics->ulUnchangedSections & reportbuilderUNCHANGED_UDP_PORTS ) == 0U ) );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = prvEncodeNetworkStats( &( xMetricsEncoder ),
+                                                pxMetrics->pxNetworkStats );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = prvEncodeConnections( &( xMetricsEncoder ),
+                                               pxMetrics->pxEstablishedConnectionsArray,
+                                               pxMetrics->ulEstablishedConnectionsArrayLength,
+                                               ( ( pxMetrics->ulUnchangedSections & reportbuilderUNCHANGED_CONNECTIONS ) == 0U ) );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = cbor_encoder_close_container( &( xReportEncoder ), &( xMetricsEncoder ) );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = prvEncodeCustomMetrics( &( xReportEncoder ), pxMetrics );
+        }
+
+        if( xCborError == CborNoError )
+        {
+            xCborError = cbor_encoder_close_container( &( xEncoder ), &( xReportEncoder ) );
+        }
+
+        if( xCborError == CborErrorOutOfMemory )
+        {
+            LogError( ( "Buffer of %u bytes is too small for the CBOR report.",
+                        ulBufferLength ) );
+            eStatus = eReportBuilderBufferTooSmall;
+        }
+        else if( xCborError != CborNoError )
+        {
+            LogError( ( "Failed to encode the CBOR report. Error: %s.",
+                        cbor_error_string( xCborError ) ) );
+            eStatus = eReportBuilderEncodingFailed;
+        }
+        else
+        {
+            *pulOutReportLength = ( uint32_t ) cbor_encoder_get_buffer_size( &( xEncoder ), pucBuffer );
+        }
+    }
+
+    return eStatus;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,317 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file report_formatter.c
+ *
+ * @brief Implementation of the text formatting functions used by the report
+ * builders.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/* Interface include. */
+#include "report_formatter.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The decimal representation of every number from 0 to 99 as two
+ * characters, so integers can be converted two digits per division.
+ */
+static const char pcDigitPairs[ 200 ] =
+{
+    '0', '0', '0', '1', '0', '2', '0', '3', '0', '4', '0', '5', '0', '6', '0', '7', '0', '8', '0', '9',
+    '1', '0', '1', '1', '1', '2', '1', '3', '1', '4', '1', '5', '1', '6', '1', '7', '1', '8', '1', '9',
+    '2', '0', '2', '1', '2', '2', '2', '3', '2', '4', '2', '5', '2', '6', '2', '7', '2', '8', '2', '9',
+    '3', '0', '3', '1', '3', '2', '3', '3', '3', '4', '3', '5', '3', '6', '3', '7', '3', '8', '3', '9',
+    '4', '0', '4', '1', '4', '2', '4', '3', '4', '4', '4', '5', '4', '6', '4', '7', '4', '8', '4', '9',
+    '5', '0', '5', '1', '5', '2', '5', '3', '5', '4', '5', '5', '5', '6', '5', '7', '5', '8', '5', '9',
+    '6', '0', '6', '1', '6', '2', '6', '3', '6', '4', '6', '5', '6', '6', '6', '7', '6', '8', '6', '9',
+    '7', '0', '7', '1', '7', '2', '7', '3', '7', '4', '7', '5', '7', '6', '7', '7', '7', '8', '7', '9',
+    '8', '0', '8', '1', '8', '2', '8', '3', '8', '4', '8', '5', '8', '6', '8', '7', '8', '8', '8', '9',
+    '9', '0', '9', '1', '9', '2', '9', '3', '9', '4', '9', '5', '9', '6', '9', '7', '9', '8', '9', '9'
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the number of decimal digits in an unsigned integer.
+ *
+ * @param[in] ulValue The value.
+ *
+ * @return The number of digits, from 1 to 10.
+ */
+static uint32_t prvCountDigits( uint32_t ulValue );
+
+/**
+ * @brief Write the decimal digits of an unsigned integer, ending just before
+ * the given position.
+ *
+ * @param[in] pcEnd Position after the last digit. The caller must ensure
+ * prvCountDigits( ulValue ) characters before it are writable.
+ * @param[in] ulValue The value to write.
+ */
+static void prvWriteDigits( char * pcEnd,
+                            uint32_t ulValue );
+
+/**
+ * @brief Check that the given number of characters fit in the buffer.
+ *
+ * Marks the formatter as overflowed if they do not.
+ *
+ * @param[in] pxFormatter The formatter.
+ * @param[in] ulLength The number of characters to be appended.
+ *
+ * @return true if the characters can be appended; false otherwise.
+ */
+static bool prvReserve( ReportFormatter_t * pxFormatter,
+                        uint32_t ulLength );
+/*-----------------------------------------------------------*/
+
+static uint32_t prvCountDigits( uint32_t ulValue )
+{
+    uint32_t ulDigits;
+
+    if( ulValue < 10UL )
+    {
+        ulDigits = 1U;
+    }
+    else if( ulValue < 100UL )
+    {
+        ulDigits = 2U;
+    }
+    else if( ulValue < 1000UL )
+    {
+        ulDigits = 3U;
+    }
+    else if( ulValue < 10000UL )
+    {
+        ulDigits = 4U;
+    }
+    else if( ulValue < 100000UL )
+    {
+        ulDigits = 5U;
+    }
+    else if( ulValue < 1000000UL )
+    {
+        ulDigits = 6U;
+    }
+    else if( ulValue < 10000000UL )
+    {
+        ulDigits = 7U;
+    }
+    else if( ulValue < 100000000UL )
+    {
+        ulDigits = 8U;
+    }
+    else if( ulValue < 1000000000UL )
+    {
+        ulDigits = 9U;
+    }
+    else
+    {
+        ulDigits = 10U;
+    }
+
+    return ulDigits;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteDigits( char * pcEnd,
+                            uint32_t ulValue )
+{
+    uint32_t ulPairIndex;
+
+    /* Write two digits at a time, least significant first. */
+    while( ulValue >= 100UL )
+    {
+        ulPairIndex = ( ulValue % 100UL ) * 2U;
+        ulValue /= 100UL;
+        pcEnd -= 2;
+        pcEnd[ 0 ] = pcDigitPairs[ ulPairIndex ];
+        pcEnd[ 1 ] = pcDigitPairs[ ulPairIndex + 1U ];
+    }
+
+    /* Write the remaining one or two most significant digits. */
+    if( ulValue >= 10UL )
+    {
+        ulPairIndex = ulValue * 2U;
+        pcEnd -= 2;
+        pcEnd[ 0 ] = pcDigitPairs[ ulPairIndex ];
+        pcEnd[ 1 ] = pcDigitPairs[ ulPairIndex + 1U ];
+    }
+    else
+    {
+        pcEnd -= 1;
+        pcEnd[ 0 ] = ( char ) ( '0' + ulValue );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static bool prvReserve( ReportFormatter_t * pxFormatter,
+                        uint32_t ulLength )
+{
+    if( ( pxFormatter->xOverflowed == false ) &&
+        ( ulLength > ( pxFormatter->ulCapacity - pxFormatter->ulLength ) ) )
+    {
+        pxFormatter->xOverflowed = true;
+    }
+
+    return( pxFormatter->xOverflowed == false );
+}
+/*-----------------------------------------------------------*/
+
+void vReportFormatterInit( ReportFormatter_t * pxFormatter,
+                           char * pcBuffer,
+                           uint32_t ulBufferLength )
+{
+    configASSERT( pxFormatter != NULL );
+    configASSERT( pcBuffer != NULL );
+    configASSERT( ulBufferLength != 0 );
+
+    pxFormatter->pcBuffer = pcBuffer;
+    pxFormatter->ulCapacity = ulBufferLength - 1U;
+    pxFormatter->ulLength = 0U;
+    pxFormatter->xOverflowed = false;
+}
+/*-----------------------------------------------------------*/
+
+void vReportFormatterAppendString( ReportFormatter_t * pxFormatter,
+                                   const char * pcString,
+                                   uint32_t ulStringLength )
+{
+    configASSERT( pxFormatter != NULL );
+    configASSERT( pcString != NULL );
+
+    if( prvReserve( pxFormatter, ulStringLength ) == true )
+    {
+        ( void ) memcpy( &( pxFormatter->pcBuffer[ pxFormatter->ulLength ] ),
+                         pcString,
+                         ulStringLength );
+        pxFormatter->ulLength += ulStringLength;
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vReportFormatterAppendChar( ReportFormatter_t * pxFormatter,
+                                 char cCharacter )
+{
+    configASSERT( pxFormatter != NULL );
+
+    if( prvReserve( pxFormatter, 1U ) == true )
+    {
+        pxFormatter->pcBuffer[ pxFormatter->ulLength ] = cCharacter;
+        pxFormatter->ulLength += 1U;
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vReportFormatterAppendUInt32( ReportFormatter_t * pxFormatter,
+                                   uint32_t ulValue )
+{
+    uint32_t ulDigits;
+
+    configASSERT( pxFormatter != NULL );
+
+    ulDigits = prvCountDigits( ulValue );
+
+    if( prvReserve( pxFormatter, ulDigits ) == true )
+    {
+        pxFormatter->ulLength += ulDigits;
+        prvWriteDigits( &( pxFormatter->pcBuffer[ pxFormatter->ulLength ] ), ulValue );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vReportFormatterAppendIPv4( ReportFormatter_t * pxFormatter,
+                                 uint32_t ulIpAddress )
+{
+    uint32_t ulOctets[ 4 ], ulDigits[ 4 ];
+    uint32_t i, ulLength = 3U; /* The three dots. */
+    char * pcWritePos;
+
+    configASSERT( pxFormatter != NULL );
+
+    for( i = 0; i < 4U; i++ )
+    {
+        ulOctets[ i ] = ( ulIpAddress >> ( 24U - ( 8U * i ) ) ) & 0xFFUL;
+        ulDigits[ i ] = prvCountDigits( ulOctets[ i ] );
+        ulLength += ulDigits[ i ];
+    }
+
+    if( prvReserve( pxFormatter, ulLength ) == true )
+    {
+        pcWritePos = &( pxFormatter->pcBuffer[ pxFormatter->ulLength ] );
+
+        for( i = 0; i < 4U; i++ )
+        {
+            if( i != 0U )
+            {
+                *pcWritePos = '.';
+                pcWritePos += 1;
+            }
+
+            pcWritePos += ulDigits[ i ];
+            prvWriteDigits( pcWritePos, ulOctets[ i ] );
+        }
+
+        pxFormatter->ulLength += ulLength;
+    }
+}
+/*-----------------------------------------------------------*/
+
+eReportFormatterStatus eReportFormatterFinish( ReportFormatter_t * pxFormatter,
+                                               uint32_t * pulOutLength )
+{
+    eReportFormatterStatus eStatus = eReportFormatterSuccess;
+
+    configASSERT( pxFormatter != NULL );
+
+    /* There is always space for the NULL terminator as it is excluded from
+     * the capacity. */
+    pxFormatter->pcBuffer[ pxFormatter->ulLength ] = '\0';
+
+    if( pxFormatter->xOverflowed == true )
+    {
+        eStatus = eReportFormatterBufferTooSmall;
+    }
+
+    if( pulOutLength != NULL )
+    {
+        *pulOutLength = pxFormatter->ulLength;
+    }
+
+    return eStatus;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,152 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file report_formatter.h
+ *
+ * @brief Functions used by the report builders to format text into a
+ * fixed size buffer without the printf family of functions.
+ *
+ * Text is appended to the buffer through a ReportFormatter_t.  Each append
+ * checks the remaining space once and, if the text does not fit, writes
+ * nothing and marks the formatter as overflowed.  Later appends are ignored, so
+ * callers can append a whole report and check for overflow once at the end.
+ */
+
+#ifndef REPORT_FORMATTER_H_
+#define REPORT_FORMATTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Maximum number of characters written for a uint32_t.
+ */
+#define reportformatterMAX_UINT32_LENGTH    ( 10U )
+
+/**
+ * @brief Maximum number of characters written for an IPv4 address.
+ */
+#define reportformatterMAX_IPV4_LENGTH      ( 15U )
+
+/**
+ * @brief Append a string literal, whose length is known at compile time.
+ */
+#define reportformatterAPPEND_LITERAL( pxFormatter, pcLiteral ) \
+    vReportFormatterAppendString( ( pxFormatter ), ( pcLiteral ), ( uint32_t ) ( sizeof( pcLiteral ) - 1U ) )
+
+/**
+ * @brief Return codes from report formatter APIs.
+ */
+typedef enum
+{
+    eReportFormatterSuccess = 0,
+    eReportFormatterBufferTooSmall
+} eReportFormatterStatus;
+
+/**
+ * @brief State of a buffer being formatted.
+ *
+ * The members must only be accessed through the functions in this file.
+ */
+typedef struct ReportFormatter
+{
+    char * pcBuffer;      /**< The buffer being written. */
+    uint32_t ulCapacity;  /**< Characters that can be written, excluding the NULL terminator. */
+    uint32_t ulLength;    /**< Characters written so far. */
+    bool xOverflowed;     /**< Set when an append did not fit in the buffer. */
+} ReportFormatter_t;
+
+/**
+ * @brief Start formatting into a buffer.
+ *
+ * One character of the buffer is reserved for the NULL terminator written by
+ * eReportFormatterFinish().
+ *
+ * @param[in] pxFormatter The formatter to initialize.
+ * @param[in] pcBuffer The buffer to write to.
+ * @param[in] ulBufferLength The length of the buffer. Must not be zero.
+ */
+void vReportFormatterInit( ReportFormatter_t * pxFormatter,
+                           char * pcBuffer,
+                           uint32_t ulBufferLength );
+
+/**
+ * @brief Append a string.
+ *
+ * @param[in] pxFormatter The formatter.
+ * @param[in] pcString The string to append. Need not be NULL terminated.
+ * @param[in] ulStringLength The length of pcString.
+ */
+void vReportFormatterAppendString( ReportFormatter_t * pxFormatter,
+                                   const char * pcString,
+                                   uint32_t ulStringLength );
+
+/**
+ * @brief Append a single character.
+ *
+ * @param[in] pxFormatter The formatter.
+ * @param[in] cCharacter The character to append.
+ */
+void vReportFormatterAppendChar( ReportFormatter_t * pxFormatter,
+                                 char cCharacter );
+
+/**
+ * @brief Append the decimal representation of an unsigned integer.
+ *
+ * @param[in] pxFormatter The formatter.
+ * @param[in] ulValue The value to append.
+ */
+void vReportFormatterAppendUInt32( ReportFormatter_t * pxFormatter,
+                                   uint32_t ulValue );
+
+/**
+ * @brief Append an IPv4 address in dotted decimal notation.
+ *
+ * @param[in] pxFormatter The formatter.
+ * @param[in] ulIpAddress The address, with the first octet in the most
+ * significant byte, as stored in Connection_t.
+ */
+void vReportFormatterAppendIPv4( ReportFormatter_t * pxFormatter,
+                                 uint32_t ulIpAddress );
+
+/**
+ * @brief Finish formatting.
+ *
+ * Writes the NULL terminator after the formatted text.
+ *
+ * @param[in] pxFormatter The formatter.
+ * @param[out] pulOutLength The number of characters written, excluding the
+ * NULL terminator. Can be NULL if not needed.
+ *
+ * @return #eReportFormatterSuccess if all the appended text fit in the buffer;
+ * #eReportFormatterBufferTooSmall otherwise.
+ */
+eReportFormatterStatus eReportFormatterFinish( ReportFormatter_t * pxFormatter,
+                                               uint32_t * pulOutLength );
+
+#endif /* ifndef REPORT_FORMATTER_H_ */
@@ -0,0 +1,140 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * This file implements a task that moves the virtual clock of
+ * source/clock-tools forward, so the keep-alive of the MQTT agent is driven
+ * by the harness instead of by the passing of time.  Every
+ * clockskipINTERVAL_MS the task adds clockskipSKIP_SECONDS, more than the
+ * keep-alive interval of the agent, to the clock with
+ * vClockSimulatedAdvanceUs(), waits for the agent to notice, then logs the
+ * packets the broker simulator received in the meantime.  The agent must have
+ * sent at least one packet, a PINGREQ if it had nothing else to send, or the
+ * keep-alive is not following the clock and a warning is logged.  A CONNECT
+ * means the connection was lost and the agent reconnected after its backoff,
+ * which is measured with the same clock.
+ *
+ * Only available with democonfigUSE_SIMULATED_CLOCK set to 1, as the broker
+ * simulator is the only peer that measures time with the virtual clock.
+ * Setting clockconfigSIMULATED_US_PER_TICK to 0 stops the clock between
+ * skips, so the task is the only source of time.
+ */
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Demo Specific configs. */
+#include "demo_config.h"
+
+/* Clock include. */
+#include "clock_source.h"
+
+#if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+    /* Broker simulator include, for its counters. */
+    #include "mqtt_broker_simulator.h"
+#endif
+
+/**
+ * @brief Real time in milliseconds between skips.
+ */
+#define clockskipINTERVAL_MS      ( 5000U )
+
+/**
+ * @brief Time in seconds added to the clock by each skip.  More than the 60
+ * second keep-alive interval of the MQTT agent, see mqtt-agent-task.c.
+ */
+#define clockskipSKIP_SECONDS     ( 90U )
+
+/**
+ * @brief Real time in milliseconds to wait after a skip before reading the
+ * counters of the broker simulator.  More than the time the MQTT agent waits
+ * for a command before it checks the keep-alive.
+ */
+#define clockskipSETTLE_MS        ( 2000U )
+
+/*-----------------------------------------------------------*/
+
+#if ( democonfigCREATE_CLOCK_SKIP_TASK == 1 )
+
+/**
+ * @brief The task that moves the clock forward.
+ *
+ * @param[in] pvParameters Unused.
+ */
+    static void prvClockSkipTask( void * pvParameters );
+
+/*-----------------------------------------------------------*/
+
+    void vStartClockSkipTask( configSTACK_DEPTH_TYPE uxStackSize,
+                              UBaseType_t uxPriority )
+    {
+        xTaskCreate( prvClockSkipTask,
+                     "ClockSkip",
+                     uxStackSize,
+                     NULL,
+                     uxPriority,
+                     NULL );
+    }
+/*-----------------------------------------------------------*/
+
+    static void prvClockSkipTask( void * pvParameters )
+    {
+        BrokerSimulatorStats_t xBefore, xAfter;
+        uint32_t ulSkips = 0, ulSilentSkips = 0;
+
+        ( void ) pvParameters;
+
+        for( ; ; )
+        {
+            vTaskDelay( pdMS_TO_TICKS( clockskipINTERVAL_MS ) );
+
+            vBrokerSimulatorGetStats( &xBefore );
+            vClockSimulatedAdvanceUs( ( uint64_t ) clockskipSKIP_SECONDS * 1000000ULL );
+            ulSkips++;
+
+            vTaskDelay( pdMS_TO_TICKS( clockskipSETTLE_MS ) );
+            vBrokerSimulatorGetStats( &xAfter );
+
+            if( xAfter.ulPacketsReceived == xBefore.ulPacketsReceived )
+            {
+                ulSilentSkips++;
+                LogWarn( ( "The agent sent nothing after the clock skipped %u s, past its keep-alive interval.",
+                           clockskipSKIP_SECONDS ) );
+            }
+
+            LogInfo( ( "Clock at %lu s after skip %lu: %lu packets, %lu PINGREQ, %lu CONNECT received.  %lu skips without a packet.",
+                       ( unsigned long ) ( ullClockGetTimeUs() / 1000000ULL ),
+                       ( unsigned long ) ulSkips,
+                       ( unsigned long ) ( xAfter.ulPacketsReceived - xBefore.ulPacketsReceived ),
+                       ( unsigned long ) ( xAfter.ulPingsReceived - xBefore.ulPingsReceived ),
+                       ( unsigned long ) ( xAfter.ulConnects - xBefore.ulConnects ),
+                       ( unsigned long ) ulSilentSkips ) );
+        }
+    }
+
+#endif /* if ( democonfigCREATE_CLOCK_SKIP_TASK == 1 ) */
@@ -46,6 +46,9 @@
  * timestamp.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleDefender
+
 /* Standard includes. */
 #include <stdlib.h>
 #include <string.h>
@@ -65,8 +68,8 @@
 /* Subscription manager header include. */
 #include "subscription_manager.h"
 
-/* JSON Library. */
-#include "core_json.h"
+/* JSON extractor. */
+#include "json_extractor.h"
 
 /* Device Defender Client Library. */
 #include "defender.h"
@@ -77,6 +80,14 @@
 /* Report builder. */
 #include "report_builder.h"
 
+/* Metrics aggregator. */
+#include "metrics_aggregator.h"
+
+#if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 )
+    /* tinycbor, used to parse the CBOR responses. */
+    #include "cbor.h"
+#endif
+
 /**
  * democonfigCLIENT_IDENTIFIER is required. Throw compilation error if it is not defined.
  */
@@ -120,7 +131,7 @@
  *
  * If the generated report is larger than this, it is rejected.
  */
-#define defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE      1000
+#define defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE      2048
 
 /**
  * @brief Major version number of the device defender report.
@@ -133,10 +144,60 @@
 #define defenderexampleDEVICE_METRICS_REPORT_MINOR_VERSION    0
 
 /**
- * @brief Time in ms to wait between consecutive defender reports
+ * @brief Time in ms to wait between the first two defender reports.  The time
+ * between later reports adapts to how much the sampled metrics change, within
+ * #defenderexampleMIN_MS_BETWEEN_REPORTS and
+ * #defenderexampleMAX_MS_BETWEEN_REPORTS.
  */
 #define defenderexampleMS_BETWEEN_REPORTS                     ( 15000U )
 
+/**
+ * @brief Bounds of the time between reports.  The time doubles after each
+ * report in which no sampled metric changed significantly, and drops to the
+ * minimum after a report in which one did.  A significant change also brings
+ * the next report forward, once the minimum time has passed.
+ */
+#define defenderexampleMIN_MS_BETWEEN_REPORTS                 ( 5000U )
+#define defenderexampleMAX_MS_BETWEEN_REPORTS                 ( 120000U )
+
+/**
+ * @brief Time in ms between samples of the free heap and MQTT agent state.
+ * Each report carries the minimum, maximum, mean and last sample taken since
+ * the previous report, so peaks between reports are not lost.  The network
+ * stats are only sampled when a report is collected, as reading them walks
+ * the socket lists of FreeRTOS+TCP.
+ */
+#define defenderexampleMS_BETWEEN_SAMPLES                     ( 1000U )
+
+/**
+ * @brief Percentage by which a sample must differ from the mean of the recent
+ * samples of the same metric to count as a significant change.
+ */
+#define defenderexampleSHARP_CHANGE_PERCENT                   ( 100U )
+
+/**
+ * @brief Free heap, in bytes, below which the device is short of memory.
+ */
+#define defenderexampleHEAP_FREE_LOW_THRESHOLD                ( configTOTAL_HEAP_SIZE / 10U )
+
+/**
+ * @brief Number of commands waiting for the MQTT agent above which the agent
+ * is falling behind.
+ */
+#define defenderexampleAGENT_QUEUE_DEPTH_HIGH_THRESHOLD       ( 10U )
+
+/**
+ * @brief Number of values sent for each sampled metric - the minimum,
+ * maximum, mean and last sample, in that order.
+ */
+#define defenderexampleWINDOW_VALUES_LENGTH                   ( 4U )
+
+/**
+ * @brief Name of a sampled metric followed by its length, for
+ * SampledMetricInfo_t.
+ */
+#define defenderexampleSAMPLED_METRIC_NAME( name )            name, ( sizeof( name ) - 1U )
+
 /**
  * @brief This demo uses task notifications to signal tasks from MQTT callback
  * functions.  defenderexampleMS_TO_WAIT_FOR_NOTIFICATION defines the time, in ticks,
@@ -158,9 +219,39 @@
 #define defenderexampleRESPONSE_REPORT_ID_FIELD               "reportId"
 
 /**
- * @brief The length of #defenderexampleRESPONSE_REPORT_ID_FIELD.
+ * @brief Number of reports generated with each of the JSON and CBOR report
+ * builders when comparing their encode time and report size.  The comparison
+ * runs once per reporting interval using the collected metrics.  Set to 0 to
+ * disable the comparison.
  */
-#define defenderexampleRESPONSE_REPORT_ID_FIELD_LENGTH        ( sizeof( defenderexampleRESPONSE_REPORT_ID_FIELD ) - 1 )
+#define defenderexampleREPORT_BENCHMARK_ITERATIONS            ( 0U )
+
+/**
+ * @brief Maximum number of consecutive reports in which unchanged sections are
+ * reduced to their totals or left out.  The report after that is always a full
+ * report.  Set to 1 to send a full report every interval.
+ */
+#define defenderexampleREPORTS_PER_FULL_REPORT                ( 20U )
+
+/**
+ * @brief Topics to publish reports to and receive responses on.  CBOR and JSON
+ * reports use separate topics.
+ */
+#if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 )
+    #define defenderexampleREPORT_PUBLISH_TOPIC               DEFENDER_API_CBOR_PUBLISH( democonfigCLIENT_IDENTIFIER )
+    #define defenderexampleREPORT_PUBLISH_TOPIC_LENGTH        DEFENDER_API_LENGTH_CBOR_PUBLISH( democonfigCLIENT_IDENTIFIER_LENGTH )
+    #define defenderexampleREPORT_ACCEPTED_TOPIC              DEFENDER_API_CBOR_ACCEPTED( democonfigCLIENT_IDENTIFIER )
+    #define defenderexampleREPORT_ACCEPTED_TOPIC_LENGTH       DEFENDER_API_LENGTH_CBOR_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH )
+    #define defenderexampleREPORT_REJECTED_TOPIC              DEFENDER_API_CBOR_REJECTED( democonfigCLIENT_IDENTIFIER )
+    #define defenderexampleREPORT_REJECTED_TOPIC_LENGTH       DEFENDER_API_LENGTH_CBOR_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH )
+#else
+    #define defenderexampleREPORT_PUBLISH_TOPIC               DEFENDER_API_JSON_PUBLISH( democonfigCLIENT_IDENTIFIER )
+    #define defenderexampleREPORT_PUBLISH_TOPIC_LENGTH        DEFENDER_API_LENGTH_JSON_PUBLISH( democonfigCLIENT_IDENTIFIER_LENGTH )
+    #define defenderexampleREPORT_ACCEPTED_TOPIC              DEFENDER_API_JSON_ACCEPTED( democonfigCLIENT_IDENTIFIER )
+    #define defenderexampleREPORT_ACCEPTED_TOPIC_LENGTH       DEFENDER_API_LENGTH_JSON_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH )
+    #define defenderexampleREPORT_REJECTED_TOPIC              DEFENDER_API_JSON_REJECTED( democonfigCLIENT_IDENTIFIER )
+    #define defenderexampleREPORT_REJECTED_TOPIC_LENGTH       DEFENDER_API_LENGTH_JSON_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH )
+#endif
 
 /**
  * @brief Defines the structure to use as the command callback context in this
@@ -182,6 +273,49 @@ typedef enum
     ReportStatusRejected
 } ReportStatus_t;
 
+/**
+ * @brief Metrics sampled between reports.
+ */
+typedef enum
+{
+    SampledBytesReceived = 0,
+    SampledBytesSent,
+    SampledPacketsReceived,
+    SampledPacketsSent,
+    SampledHeapFree,
+    SampledAgentQueueDepth,
+    SampledAgentInFlight,
+    SampledMetricCount
+} SampledMetric_t;
+
+/**
+ * @brief Name under which a sampled metric is reported, and the settings that
+ * decide which of its samples are significant.
+ */
+typedef struct SampledMetricInfo
+{
+    const char * pcName;
+    uint32_t ulNameLength;
+    AggregatedMetricConfig_t xConfig;
+} SampledMetricInfo_t;
+
+/**
+ * @brief Copy of the metric lists sent in the last report accepted by the AWS
+ * IoT Device Defender service.  Lists that have not changed since then are not
+ * sent again until the next full report.
+ */
+typedef struct ReportSnapshot
+{
+    uint16_t pusOpenTcpPorts[ defenderexampleOPEN_TCP_PORTS_ARRAY_SIZE ];
+    uint32_t ulOpenTcpPortsLength;
+    uint16_t pusOpenUdpPorts[ defenderexampleOPEN_UDP_PORTS_ARRAY_SIZE ];
+    uint32_t ulOpenUdpPortsLength;
+    Connection_t pxEstablishedConnections[ defenderexampleESTABLISHED_CONNECTIONS_ARRAY_SIZE ];
+    uint32_t ulEstablishedConnectionsLength;
+    uint32_t pulTaskNumbers[ defenderexampleCUSTOM_METRICS_TASKS_ARRAY_SIZE ];
+    uint32_t ulTaskNumbersLength;
+} ReportSnapshot_t;
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -215,6 +349,86 @@ static TaskStatus_t pxTaskList[ defenderexampleCUSTOM_METRICS_TASKS_ARRAY_SIZE ]
  */
 static uint32_t pulCustomMetricsTaskNumbers[ defenderexampleCUSTOM_METRICS_TASKS_ARRAY_SIZE ];
 
+/**
+ * @brief Custom metric array for the percentage of CPU time used by each task
+ * in pulCustomMetricsTaskNumbers.
+ */
+static uint32_t pulCustomMetricsTaskCpuPercent[ defenderexampleCUSTOM_METRICS_TASKS_ARRAY_SIZE ];
+
+/**
+ * @brief Custom metric array for the stack high water mark of each task in
+ * pulCustomMetricsTaskNumbers.
+ */
+static uint32_t pulCustomMetricsTaskStackHighWaterMarks[ defenderexampleCUSTOM_METRICS_TASKS_ARRAY_SIZE ];
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+/**
+ * @brief Run time counters of the tasks when the metrics were last collected,
+ * used to calculate the CPU usage over each reporting interval.
+ */
+    static TaskStatus_t pxPreviousTaskList[ defenderexampleCUSTOM_METRICS_TASKS_ARRAY_SIZE ];
+
+/**
+ * @brief Number of valid entries in #pxPreviousTaskList.
+ */
+    static UBaseType_t uxPreviousTaskCount = 0U;
+
+/**
+ * @brief Total run time when the metrics were last collected.
+ */
+    static uint32_t ulPreviousTotalRunTime = 0UL;
+#endif
+
+/**
+ * @brief Names and settings of the sampled metrics, indexed by
+ * SampledMetric_t.  The network stats are sampled as the average rate per
+ * second since the previous report, so their windows hold one sample.
+ */
+static const SampledMetricInfo_t pxSampledMetricInfo[ SampledMetricCount ] =
+{
+    /* Name,                                                          { Low threshold,                          High threshold,                                   Change %,                            Minimum change } */
+    { defenderexampleSAMPLED_METRIC_NAME( "bytes_in_window" ),               { 0U,                                     metricsaggregatorNO_HIGH_THRESHOLD,               defenderexampleSHARP_CHANGE_PERCENT, 1024U } },
+    { defenderexampleSAMPLED_METRIC_NAME( "bytes_out_window" ),              { 0U,                                     metricsaggregatorNO_HIGH_THRESHOLD,               defenderexampleSHARP_CHANGE_PERCENT, 1024U } },
+    { defenderexampleSAMPLED_METRIC_NAME( "packets_in_window" ),             { 0U,                                     metricsaggregatorNO_HIGH_THRESHOLD,               defenderexampleSHARP_CHANGE_PERCENT, 10U   } },
+    { defenderexampleSAMPLED_METRIC_NAME( "packets_out_window" ),            { 0U,                                     metricsaggregatorNO_HIGH_THRESHOLD,               defenderexampleSHARP_CHANGE_PERCENT, 10U   } },
+    { defenderexampleSAMPLED_METRIC_NAME( "heap_free_bytes_window" ),        { defenderexampleHEAP_FREE_LOW_THRESHOLD, metricsaggregatorNO_HIGH_THRESHOLD,               0U,                                  0U    } },
+    { defenderexampleSAMPLED_METRIC_NAME( "mqtt_agent_queue_depth_window" ), { 0U,                                     defenderexampleAGENT_QUEUE_DEPTH_HIGH_THRESHOLD, 0U,                                  0U    } },
+    { defenderexampleSAMPLED_METRIC_NAME( "mqtt_agent_in_flight_window" ),   { 0U,                                     metricsaggregatorNO_HIGH_THRESHOLD,               defenderexampleSHARP_CHANGE_PERCENT, 4U    } }
+};
+
+/**
+ * @brief Samples of the sampled metrics, indexed by SampledMetric_t.
+ */
+static AggregatedMetric_t pxSampledMetrics[ SampledMetricCount ];
+
+/**
+ * @brief Minimum, maximum, mean and last sample of each sampled metric since
+ * the previous report.
+ */
+static uint32_t pulSampledMetricWindows[ SampledMetricCount ][ defenderexampleWINDOW_VALUES_LENGTH ];
+
+/**
+ * @brief Custom metrics carrying #pulSampledMetricWindows in the report.
+ */
+static ReportNumberListMetric_t pxSampledMetricReports[ SampledMetricCount ];
+
+/**
+ * @brief Network stats at the previous sample, and the time it was taken.
+ */
+static NetworkStats_t xPreviousSampleNetworkStats;
+static TickType_t xPreviousSampleNetworkTime;
+
+/**
+ * @brief Whether #xPreviousSampleNetworkStats holds a sample.
+ */
+static bool xPreviousSampleNetworkStatsValid = false;
+
+/**
+ * @brief Time in ms to wait between the current and the next report.
+ */
+static uint32_t ulMsBetweenReports = defenderexampleMS_BETWEEN_REPORTS;
+
 /**
  * @brief All the metrics sent in the device defender report.
  */
@@ -228,14 +442,34 @@ static ReportStatus_t xReportStatus;
 /**
  * @brief Buffer for generating the device defender report.
  */
-static char pcDeviceMetricsJsonReport[ defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE ];
+static char pcDeviceMetricsReport[ defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE ];
 
 /**
  * @brief Report Id sent in the defender report.
  */
 static uint32_t ulReportId = 0UL;
 
+/**
+ * @brief Metric lists of the last accepted report.
+ */
+static ReportSnapshot_t xLastAcceptedReport;
+
+/**
+ * @brief Whether #xLastAcceptedReport holds the lists of an accepted report.
+ * Cleared when a report is not accepted so that the next report is a full
+ * report.
+ */
+static bool xLastAcceptedReportValid = false;
+
+/**
+ * @brief Number of reports accepted since the last accepted full report.
+ */
+static uint32_t ulReportsSinceFullReport = 0UL;
+
 extern MQTTAgentContext_t xGlobalMqttAgentContext;
+
+extern UBaseType_t uxGetMQTTAgentQueueDepth( void );
+extern UBaseType_t uxGetMQTTAgentInFlightCount( void );
 /*-----------------------------------------------------------*/
 
 /**
@@ -293,6 +527,121 @@ static void prvIncomingRejectedPublishCallback( void * pxSubscriptionContext,
  */
 static bool prvCollectDeviceMetrics( void );
 
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+/**
+ * @brief Calculate the percentage of CPU time used by each task in
+ * #pxTaskList since the metrics were last collected.
+ *
+ * Tasks that did not exist when the metrics were last collected are credited
+ * with all the run time they have accumulated.
+ *
+ * @param[in] uxTaskCount Number of valid entries in #pxTaskList.
+ * @param[in] ulTotalRunTime Total run time returned by uxTaskGetSystemState().
+ */
+    static void prvCalculateTaskCpuPercent( UBaseType_t uxTaskCount,
+                                            uint32_t ulTotalRunTime );
+#endif
+
+/**
+ * @brief Compare the collected metric lists with those of the last accepted
+ * report and set the ulUnchangedSections member of the device metrics.
+ *
+ * A full report is selected when there is no accepted report to compare with,
+ * when #defenderexampleREPORTS_PER_FULL_REPORT reports have been sent since
+ * the last full report, or when a port that was not open in the last accepted
+ * report has been opened.
+ */
+static void prvSelectReportSections( void );
+
+/**
+ * @brief Check whether a metric list is the same as in the last accepted
+ * report.
+ *
+ * @param[in] pvCurrent The collected list.
+ * @param[in] ulCurrentLength Number of elements in the collected list.
+ * @param[in] pvPrevious The list from the last accepted report.
+ * @param[in] ulPreviousLength Number of elements in the previous list.
+ * @param[in] xElementSize Size of each element in bytes.
+ *
+ * @return true if the lists are the same;
+ * false otherwise.
+ */
+static bool prvListUnchanged( const void * pvCurrent,
+                              uint32_t ulCurrentLength,
+                              const void * pvPrevious,
+                              uint32_t ulPreviousLength,
+                              size_t xElementSize );
+
+/**
+ * @brief Check whether a port list contains a port that is not in the list
+ * from the last accepted report.
+ *
+ * @param[in] pusCurrentPorts The collected ports.
+ * @param[in] ulCurrentPortsLength Number of collected ports.
+ * @param[in] pusPreviousPorts The ports from the last accepted report.
+ * @param[in] ulPreviousPortsLength Number of ports in the last accepted report.
+ *
+ * @return true if a new port has been opened;
+ * false otherwise.
+ */
+static bool prvNewPortOpened( const uint16_t * pusCurrentPorts,
+                              uint32_t ulCurrentPortsLength,
+                              const uint16_t * pusPreviousPorts,
+                              uint32_t ulPreviousPortsLength );
+
+/**
+ * @brief Initialize the sampled metrics.
+ */
+static void prvInitSampledMetrics( void );
+
+/**
+ * @brief Return the average rate per second of a change over a time.
+ *
+ * @param[in] ulChange The change.
+ * @param[in] ulElapsedMs The time over which it happened, in ms.  Not 0.
+ */
+static uint32_t prvRatePerSecond( uint32_t ulChange,
+                                  uint32_t ulElapsedMs );
+
+/**
+ * @brief Take one sample of each sampled network metric, from network stats
+ * that have already been read.  The first sample only sets the starting point.
+ *
+ * @param[in] pxNetworkStats The network stats.
+ */
+static void prvSampleNetworkStats( const NetworkStats_t * pxNetworkStats );
+
+/**
+ * @brief Take one sample of each sampled metric other than the network
+ * stats.
+ *
+ * @return true if any sample is a significant change;
+ * false otherwise.
+ */
+static bool prvSampleMetrics( void );
+
+/**
+ * @brief Close the sampling window of each sampled metric, ready to send the
+ * windows in the next report, and adapt the time until the report after it.
+ */
+static void prvCloseSampleWindows( void );
+
+/**
+ * @brief Keep sampling metrics until the next report is due.
+ *
+ * The next report is due #ulMsBetweenReports after this function is called, or
+ * earlier if a significant change is sampled after at least
+ * #defenderexampleMIN_MS_BETWEEN_REPORTS.
+ */
+static void prvSampleUntilNextReport( void );
+
+/**
+ * @brief Record the metric lists of an accepted report to compare the next
+ * report with.
+ */
+static void prvSaveAcceptedReport( void );
+
 /**
  * @brief Generate the device defender report.
  *
@@ -303,6 +652,16 @@ static bool prvCollectDeviceMetrics( void );
  */
 static bool prvGenerateDeviceMetricsReport( uint32_t * pulOutReportLength );
 
+#if ( defenderexampleREPORT_BENCHMARK_ITERATIONS > 0 )
+
+/**
+ * @brief Generate #defenderexampleREPORT_BENCHMARK_ITERATIONS reports from the
+ * collected metrics with each of the JSON and CBOR report builders and log the
+ * time taken and the size of the reports.
+ */
+    static void prvBenchmarkReportBuilders( void );
+#endif
+
 /**
  * @brief Publish the generated device defender report.
  *
@@ -316,8 +675,9 @@ static bool prvPublishDeviceMetricsReport( uint32_t ulReportLength );
 /**
  * @brief Validate the response received from the AWS IoT Device Defender Service.
  *
- * This functions checks that a valid JSON is received and the report ID
- * is same as was sent in the published report.
+ * This functions checks that a valid JSON, or CBOR when
+ * democonfigDEFENDER_USE_CBOR_REPORTS is 1, is received and the report ID is
+ * same as was sent in the published report.
  *
  * @param[in] pcDefenderResponse The defender response to validate.
  * @param[in] ulDefenderResponseLength Length of the defender response.
@@ -381,12 +741,12 @@ static bool prvSubscribeToDefenderTopics( void )
     xApplicationDefinedContext.xReturnStatus = MQTTBadParameter;
 
     /* Subscribe to defender topic for responses for accepted reports. */
-    xSubscribeInfo[ 0 ].pTopicFilter = DEFENDER_API_JSON_ACCEPTED( democonfigCLIENT_IDENTIFIER );
-    xSubscribeInfo[ 0 ].topicFilterLength = DEFENDER_API_LENGTH_JSON_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH );
+    xSubscribeInfo[ 0 ].pTopicFilter = defenderexampleREPORT_ACCEPTED_TOPIC;
+    xSubscribeInfo[ 0 ].topicFilterLength = defenderexampleREPORT_ACCEPTED_TOPIC_LENGTH;
     xSubscribeInfo[ 0 ].qos = MQTTQoS1;
     /* Subscribe to defender topic for responses for rejected reports. */
-    xSubscribeInfo[ 1 ].pTopicFilter = DEFENDER_API_JSON_REJECTED( democonfigCLIENT_IDENTIFIER );
-    xSubscribeInfo[ 1 ].topicFilterLength = DEFENDER_API_LENGTH_JSON_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH );
+    xSubscribeInfo[ 1 ].pTopicFilter = defenderexampleREPORT_REJECTED_TOPIC;
+    xSubscribeInfo[ 1 ].topicFilterLength = defenderexampleREPORT_REJECTED_TOPIC_LENGTH;
     xSubscribeInfo[ 1 ].qos = MQTTQoS1;
 
     /* Complete the subscribe information.  The topic string must persist for
@@ -449,29 +809,29 @@ static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandCo
         /* Add subscription so that incoming publishes are routed to the application
          * callback. */
         xSubscriptionAdded = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
-                                              DEFENDER_API_JSON_ACCEPTED( democonfigCLIENT_IDENTIFIER ),
-                                              DEFENDER_API_LENGTH_JSON_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
+                                              defenderexampleREPORT_ACCEPTED_TOPIC,
+                                              defenderexampleREPORT_ACCEPTED_TOPIC_LENGTH,
                                               prvIncomingAcceptedPublishCallback,
                                               pxCommandContext );
 
         if( xSubscriptionAdded == false )
         {
             LogError( ( "Failed to register an incoming publish callback for topic %.*s.",
-                        DEFENDER_API_LENGTH_JSON_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                        DEFENDER_API_JSON_ACCEPTED( democonfigCLIENT_IDENTIFIER ) ) );
+                        defenderexampleREPORT_ACCEPTED_TOPIC_LENGTH,
+                        defenderexampleREPORT_ACCEPTED_TOPIC ) );
         }
 
         xSubscriptionAdded = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
-                                              DEFENDER_API_JSON_REJECTED( democonfigCLIENT_IDENTIFIER ),
-                                              DEFENDER_API_LENGTH_JSON_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
+                                              defenderexampleREPORT_REJECTED_TOPIC,
+                                              defenderexampleREPORT_REJECTED_TOPIC_LENGTH,
                                               prvIncomingRejectedPublishCallback,
                                               pxCommandContext );
 
         if( xSubscriptionAdded == false )
         {
             LogError( ( "Failed to register an incoming publish callback for topic %.*s.",
-                        DEFENDER_API_LENGTH_JSON_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                        DEFENDER_API_JSON_REJECTED( democonfigCLIENT_IDENTIFIER ) ) );
+                        defenderexampleREPORT_REJECTED_TOPIC_LENGTH,
+                        defenderexampleREPORT_REJECTED_TOPIC ) );
         }
     }
 
@@ -493,9 +853,14 @@ static void prvIncomingAcceptedPublishCallback( void * pxSubscriptionContext,
 
     if( xValidationResult == true )
     {
-        LogInfo( ( "The defender report was accepted by the service. Response: %.*s.",
-                   ( int ) pxPublishInfo->payloadLength,
-                   ( const char * ) pxPublishInfo->pPayload ) );
+        #if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 )
+            LogInfo( ( "The defender report was accepted by the service. Response length: %u.",
+                       ( unsigned int ) pxPublishInfo->payloadLength ) );
+        #else
+            LogInfo( ( "The defender report was accepted by the service. Response: %.*s.",
+                       ( int ) pxPublishInfo->payloadLength,
+                       ( const char * ) pxPublishInfo->pPayload ) );
+        #endif
         xReportStatus = ReportStatusAccepted;
     }
 
@@ -519,9 +884,14 @@ static void prvIncomingRejectedPublishCallback( void * pxSubscriptionContext,
 
     if( xValidationResult == true )
     {
-        LogError( ( "The defender report was rejected by the service. Response: %.*s.",
-                    ( int ) pxPublishInfo->payloadLength,
-                    ( const char * ) pxPublishInfo->pPayload ) );
+        #if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 )
+            LogError( ( "The defender report was rejected by the service. Response length: %u.",
+                        ( unsigned int ) pxPublishInfo->payloadLength ) );
+        #else
+            LogError( ( "The defender report was rejected by the service. Response: %.*s.",
+                        ( int ) pxPublishInfo->payloadLength,
+                        ( const char * ) pxPublishInfo->pPayload ) );
+        #endif
         xReportStatus = ReportStatusRejected;
     }
 
@@ -536,64 +906,36 @@ static bool prvCollectDeviceMetrics( void )
 {
     bool xStatus = false;
     eMetricsCollectorStatus eMetricsCollectorStatus;
-    uint32_t ulNumOpenTcpPorts = 0UL, ulNumOpenUdpPorts = 0UL, ulNumEstablishedConnections = 0UL, i;
+    AllMetrics_t xAllMetrics = { 0 };
+    uint32_t i;
     UBaseType_t uxTasksWritten = { 0 };
     TaskStatus_t pxTaskStatus = { 0 };
-
-    /* Collect bytes and packets sent and received. */
-    eMetricsCollectorStatus = eGetNetworkStats( &( xNetworkStats ) );
+    uint32_t ulTotalRunTime = 0UL;
+    HeapStats_t xHeapStats = { 0 };
+
+    /* Collect bytes and packets sent and received, the open TCP and UDP
+     * ports, and the established connections from a single snapshot of the
+     * TCP stack. */
+    xAllMetrics.pxNetworkStats = &( xNetworkStats );
+    xAllMetrics.pusTcpPortsArray = &( pusOpenTcpPorts[ 0 ] );
+    xAllMetrics.ulTcpPortsArrayLength = defenderexampleOPEN_TCP_PORTS_ARRAY_SIZE;
+    xAllMetrics.pusUdpPortsArray = &( pusOpenUdpPorts[ 0 ] );
+    xAllMetrics.ulUdpPortsArrayLength = defenderexampleOPEN_UDP_PORTS_ARRAY_SIZE;
+    xAllMetrics.pxConnectionsArray = &( pxEstablishedConnections[ 0 ] );
+    xAllMetrics.ulConnectionsArrayLength = defenderexampleESTABLISHED_CONNECTIONS_ARRAY_SIZE;
+
+    eMetricsCollectorStatus = eCollectAllMetrics( &( xAllMetrics ) );
 
     if( eMetricsCollectorStatus != eMetricsCollectorSuccess )
     {
-        LogError( ( "xGetNetworkStats failed. Status: %d.",
+        LogError( ( "eCollectAllMetrics failed. Status: %d.",
                     eMetricsCollectorStatus ) );
     }
 
-    /* Collect a list of open TCP ports. */
-    if( eMetricsCollectorStatus == eMetricsCollectorSuccess )
-    {
-        eMetricsCollectorStatus = eGetOpenTcpPorts( &( pusOpenTcpPorts[ 0 ] ),
-                                                    defenderexampleOPEN_TCP_PORTS_ARRAY_SIZE,
-                                                    &( ulNumOpenTcpPorts ) );
-
-        if( eMetricsCollectorStatus != eMetricsCollectorSuccess )
-        {
-            LogError( ( "xGetOpenTcpPorts failed. Status: %d.",
-                        eMetricsCollectorStatus ) );
-        }
-    }
-
-    /* Collect a list of open UDP ports. */
-    if( eMetricsCollectorStatus == eMetricsCollectorSuccess )
-    {
-        eMetricsCollectorStatus = eGetOpenUdpPorts( &( pusOpenUdpPorts[ 0 ] ),
-                                                    defenderexampleOPEN_UDP_PORTS_ARRAY_SIZE,
-                                                    &( ulNumOpenUdpPorts ) );
-
-        if( eMetricsCollectorStatus != eMetricsCollectorSuccess )
-        {
-            LogError( ( "xGetOpenUdpPorts failed. Status: %d.",
-                        eMetricsCollectorStatus ) );
-        }
-    }
-
-    /* Collect a list of established connections. */
-    if( eMetricsCollectorStatus == eMetricsCollectorSuccess )
-    {
-        eMetricsCollectorStatus = eGetEstablishedConnections( &( pxEstablishedConnections[ 0 ] ),
-                                                              defenderexampleESTABLISHED_CONNECTIONS_ARRAY_SIZE,
-                                                              &( ulNumEstablishedConnections ) );
-
-        if( eMetricsCollectorStatus != eMetricsCollectorSuccess )
-        {
-            LogError( ( "GetEstablishedConnections failed. Status: %d.",
-                        eMetricsCollectorStatus ) );
-        }
-    }
-
     /* Collect custom metrics. This demo sends this tasks stack high water mark
-     * as a number type custom metric and the current task ids as a list of
-     * numbers type custom metric. */
+     * as a number type custom metric, and the current task ids with the CPU
+     * usage and stack high water mark of each task as list of numbers type
+     * custom metrics. */
     if( eMetricsCollectorStatus == eMetricsCollectorSuccess )
     {
         vTaskGetInfo(
@@ -604,7 +946,7 @@ static bool prvCollectDeviceMetrics( void )
             pdTRUE,
             /* Don't include the task state in the TaskStatus_t structure. */
             0 );
-        uxTasksWritten = uxTaskGetSystemState( pxTaskList, defenderexampleCUSTOM_METRICS_TASKS_ARRAY_SIZE, NULL );
+        uxTasksWritten = uxTaskGetSystemState( pxTaskList, defenderexampleCUSTOM_METRICS_TASKS_ARRAY_SIZE, &( ulTotalRunTime ) );
 
         if( uxTasksWritten == 0 )
         {
@@ -617,24 +959,61 @@ static bool prvCollectDeviceMetrics( void )
             for( i = 0; i < uxTasksWritten; i++ )
             {
                 pulCustomMetricsTaskNumbers[ i ] = pxTaskList[ i ].xTaskNumber;
+                pulCustomMetricsTaskStackHighWaterMarks[ i ] = pxTaskList[ i ].usStackHighWaterMark;
             }
+
+            #if ( configGENERATE_RUN_TIME_STATS == 1 )
+                prvCalculateTaskCpuPercent( uxTasksWritten, ulTotalRunTime );
+            #else
+                ( void ) ulTotalRunTime;
+            #endif
         }
     }
 
+    /* Collect heap usage, and the number of commands queued to and waiting to
+     * be acknowledged by the MQTT agent. A command queue that stays full or a
+     * shrinking largest free block show a device under pressure before
+     * allocations start to fail. */
+    if( eMetricsCollectorStatus == eMetricsCollectorSuccess )
+    {
+        vPortGetHeapStats( &( xHeapStats ) );
+    }
+
+    /* The network stats were read by eCollectAllMetrics(), so sampling them
+     * here does not walk the socket lists again. */
+    if( eMetricsCollectorStatus == eMetricsCollectorSuccess )
+    {
+        prvSampleNetworkStats( &( xNetworkStats ) );
+        prvCloseSampleWindows();
+    }
+
     /* Populate device metrics. */
     if( eMetricsCollectorStatus == eMetricsCollectorSuccess )
     {
         xStatus = true;
         xDeviceMetrics.pxNetworkStats = &( xNetworkStats );
         xDeviceMetrics.pusOpenTcpPortsArray = &( pusOpenTcpPorts[ 0 ] );
-        xDeviceMetrics.ulOpenTcpPortsArrayLength = ulNumOpenTcpPorts;
+        xDeviceMetrics.ulOpenTcpPortsArrayLength = xAllMetrics.ulNumTcpOpenPorts;
         xDeviceMetrics.pusOpenUdpPortsArray = &( pusOpenUdpPorts[ 0 ] );
-        xDeviceMetrics.ulOpenUdpPortsArrayLength = ulNumOpenUdpPorts;
+        xDeviceMetrics.ulOpenUdpPortsArrayLength = xAllMetrics.ulNumUdpOpenPorts;
         xDeviceMetrics.pxEstablishedConnectionsArray = &( pxEstablishedConnections[ 0 ] );
-        xDeviceMetrics.ulEstablishedConnectionsArrayLength = ulNumEstablishedConnections;
+        xDeviceMetrics.ulEstablishedConnectionsArrayLength = xAllMetrics.ulNumEstablishedConnections;
         xDeviceMetrics.ulStackHighWaterMark = pxTaskStatus.usStackHighWaterMark;
         xDeviceMetrics.pulTaskIdsArray = pulCustomMetricsTaskNumbers;
         xDeviceMetrics.ulTaskIdsArrayLength = uxTasksWritten;
+        #if ( configGENERATE_RUN_TIME_STATS == 1 )
+            xDeviceMetrics.pulTaskCpuPercentArray = pulCustomMetricsTaskCpuPercent;
+        #else
+            xDeviceMetrics.pulTaskCpuPercentArray = NULL;
+        #endif
+        xDeviceMetrics.pulTaskStackHighWaterMarkArray = pulCustomMetricsTaskStackHighWaterMarks;
+        xDeviceMetrics.ulHeapFreeBytes = ( uint32_t ) xHeapStats.xAvailableHeapSpaceInBytes;
+        xDeviceMetrics.ulHeapMinimumEverFreeBytes = ( uint32_t ) xHeapStats.xMinimumEverFreeBytesRemaining;
+        xDeviceMetrics.ulHeapLargestFreeBlockBytes = ( uint32_t ) xHeapStats.xSizeOfLargestFreeBlockInBytes;
+        xDeviceMetrics.ulAgentQueueDepth = ( uint32_t ) uxGetMQTTAgentQueueDepth();
+        xDeviceMetrics.ulAgentInFlight = ( uint32_t ) uxGetMQTTAgentInFlightCount();
+        xDeviceMetrics.pxNumberListMetricsArray = pxSampledMetricReports;
+        xDeviceMetrics.ulNumberListMetricsArrayLength = SampledMetricCount;
     }
 
     return xStatus;
@@ -642,6 +1021,354 @@ static bool prvCollectDeviceMetrics( void )
 
 /*-----------------------------------------------------------*/
 
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+    static void prvCalculateTaskCpuPercent( UBaseType_t uxTaskCount,
+                                            uint32_t ulTotalRunTime )
+    {
+        UBaseType_t uxTask, uxPreviousTask;
+        uint32_t ulTaskRunTime;
+        uint32_t ulIntervalRunTime;
+
+        /* The run time counter wraps, so only differences between readings are
+         * meaningful. Unsigned subtraction gives the right result as long as the
+         * reporting interval is shorter than the wrap period. Divide by 100 so
+         * that the division below gives a percentage, as vTaskGetRunTimeStats()
+         * does. */
+        ulIntervalRunTime = ( ulTotalRunTime - ulPreviousTotalRunTime ) / 100UL;
+
+        for( uxTask = 0; uxTask < uxTaskCount; uxTask++ )
+        {
+            ulTaskRunTime = pxTaskList[ uxTask ].ulRunTimeCounter;
+
+            /* Tasks are not reported in a fixed order, so look the task up by
+             * its number. */
+            for( uxPreviousTask = 0; uxPreviousTask < uxPreviousTaskCount; uxPreviousTask++ )
+            {
+                if( pxPreviousTaskList[ uxPreviousTask ].xTaskNumber == pxTaskList[ uxTask ].xTaskNumber )
+                {
+                    ulTaskRunTime -= pxPreviousTaskList[ uxPreviousTask ].ulRunTimeCounter;
+                    break;
+                }
+            }
+
+            if( ulIntervalRunTime > 0UL )
+            {
+                pulCustomMetricsTaskCpuPercent[ uxTask ] = ulTaskRunTime / ulIntervalRunTime;
+            }
+            else
+            {
+                pulCustomMetricsTaskCpuPercent[ uxTask ] = 0UL;
+            }
+        }
+
+        ( void ) memcpy( pxPreviousTaskList, pxTaskList, uxTaskCount * sizeof( TaskStatus_t ) );
+        uxPreviousTaskCount = uxTaskCount;
+        ulPreviousTotalRunTime = ulTotalRunTime;
+    }
+
+#endif /* if ( configGENERATE_RUN_TIME_STATS == 1 ) */
+/*-----------------------------------------------------------*/
+
+static bool prvListUnchanged( const void * pvCurrent,
+                              uint32_t ulCurrentLength,
+                              const void * pvPrevious,
+                              uint32_t ulPreviousLength,
+                              size_t xElementSize )
+{
+    bool xUnchanged = false;
+
+    if( ulCurrentLength == ulPreviousLength )
+    {
+        xUnchanged = ( memcmp( pvCurrent, pvPrevious, ( size_t ) ulCurrentLength * xElementSize ) == 0 );
+    }
+
+    return xUnchanged;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvNewPortOpened( const uint16_t * pusCurrentPorts,
+                              uint32_t ulCurrentPortsLength,
+                              const uint16_t * pusPreviousPorts,
+                              uint32_t ulPreviousPortsLength )
+{
+    bool xNewPortOpened = false;
+    bool xFound;
+    uint32_t i, j;
+
+    for( i = 0; ( i < ulCurrentPortsLength ) && ( xNewPortOpened == false ); i++ )
+    {
+        xFound = false;
+
+        for( j = 0; ( j < ulPreviousPortsLength ) && ( xFound == false ); j++ )
+        {
+            xFound = ( pusCurrentPorts[ i ] == pusPreviousPorts[ j ] );
+        }
+
+        xNewPortOpened = ( xFound == false );
+    }
+
+    return xNewPortOpened;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSelectReportSections( void )
+{
+    uint32_t ulUnchangedSections = 0UL;
+
+    if( ( xLastAcceptedReportValid == true ) &&
+        ( ( ulReportsSinceFullReport + 1UL ) < defenderexampleREPORTS_PER_FULL_REPORT ) )
+    {
+        if( prvListUnchanged( xDeviceMetrics.pusOpenTcpPortsArray,
+                              xDeviceMetrics.ulOpenTcpPortsArrayLength,
+                              xLastAcceptedReport.pusOpenTcpPorts,
+                              xLastAcceptedReport.ulOpenTcpPortsLength,
+                              sizeof( uint16_t ) ) == true )
+        {
+            ulUnchangedSections |= reportbuilderUNCHANGED_TCP_PORTS;
+        }
+
+        if( prvListUnchanged( xDeviceMetrics.pusOpenUdpPortsArray,
+                              xDeviceMetrics.ulOpenUdpPortsArrayLength,
+                              xLastAcceptedReport.pusOpenUdpPorts,
+                              xLastAcceptedReport.ulOpenUdpPortsLength,
+                              sizeof( uint16_t ) ) == true )
+        {
+            ulUnchangedSections |= reportbuilderUNCHANGED_UDP_PORTS;
+        }
+
+        if( prvListUnchanged( xDeviceMetrics.pxEstablishedConnectionsArray,
+                              xDeviceMetrics.ulEstablishedConnectionsArrayLength,
+                              xLastAcceptedReport.pxEstablishedConnections,
+                              xLastAcceptedReport.ulEstablishedConnectionsLength,
+                              sizeof( Connection_t ) ) == true )
+        {
+            ulUnchangedSections |= reportbuilderUNCHANGED_CONNECTIONS;
+        }
+
+        if( prvListUnchanged( xDeviceMetrics.pulTaskIdsArray,
+                              xDeviceMetrics.ulTaskIdsArrayLength,
+                              xLastAcceptedReport.pulTaskNumbers,
+                              xLastAcceptedReport.ulTaskNumbersLength,
+                              sizeof( uint32_t ) ) == true )
+        {
+            ulUnchangedSections |= reportbuilderUNCHANGED_TASK_NUMBERS;
+        }
+
+        /* A newly opened port is the kind of change the service is most
+         * interested in, so report it together with all the other metrics. */
+        if( ( prvNewPortOpened( xDeviceMetrics.pusOpenTcpPortsArray,
+                                xDeviceMetrics.ulOpenTcpPortsArrayLength,
+                                xLastAcceptedReport.pusOpenTcpPorts,
+                                xLastAcceptedReport.ulOpenTcpPortsLength ) == true ) ||
+            ( prvNewPortOpened( xDeviceMetrics.pusOpenUdpPortsArray,
+                                xDeviceMetrics.ulOpenUdpPortsArrayLength,
+                                xLastAcceptedReport.pusOpenUdpPorts,
+                                xLastAcceptedReport.ulOpenUdpPortsLength ) == true ) )
+        {
+            LogInfo( ( "New open port detected, sending a full report." ) );
+            ulUnchangedSections = 0UL;
+        }
+    }
+
+    xDeviceMetrics.ulUnchangedSections = ulUnchangedSections;
+
+    LogDebug( ( "Unchanged report sections: 0x%02x.", ( unsigned int ) ulUnchangedSections ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSaveAcceptedReport( void )
+{
+    /* Sections left out of the report were the same as in the snapshot, so
+     * copying every list keeps the snapshot equal to what the service holds. */
+    ( void ) memcpy( xLastAcceptedReport.pusOpenTcpPorts,
+                     xDeviceMetrics.pusOpenTcpPortsArray,
+                     xDeviceMetrics.ulOpenTcpPortsArrayLength * sizeof( uint16_t ) );
+    xLastAcceptedReport.ulOpenTcpPortsLength = xDeviceMetrics.ulOpenTcpPortsArrayLength;
+
+    ( void ) memcpy( xLastAcceptedReport.pusOpenUdpPorts,
+                     xDeviceMetrics.pusOpenUdpPortsArray,
+                     xDeviceMetrics.ulOpenUdpPortsArrayLength * sizeof( uint16_t ) );
+    xLastAcceptedReport.ulOpenUdpPortsLength = xDeviceMetrics.ulOpenUdpPortsArrayLength;
+
+    ( void ) memcpy( xLastAcceptedReport.pxEstablishedConnections,
+                     xDeviceMetrics.pxEstablishedConnectionsArray,
+                     xDeviceMetrics.ulEstablishedConnectionsArrayLength * sizeof( Connection_t ) );
+    xLastAcceptedReport.ulEstablishedConnectionsLength = xDeviceMetrics.ulEstablishedConnectionsArrayLength;
+
+    ( void ) memcpy( xLastAcceptedReport.pulTaskNumbers,
+                     xDeviceMetrics.pulTaskIdsArray,
+                     xDeviceMetrics.ulTaskIdsArrayLength * sizeof( uint32_t ) );
+    xLastAcceptedReport.ulTaskNumbersLength = xDeviceMetrics.ulTaskIdsArrayLength;
+
+    if( xDeviceMetrics.ulUnchangedSections == 0UL )
+    {
+        ulReportsSinceFullReport = 0UL;
+    }
+    else
+    {
+        ulReportsSinceFullReport++;
+    }
+
+    xLastAcceptedReportValid = true;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvInitSampledMetrics( void )
+{
+    NetworkStats_t xNetworkStatsSample = { 0 };
+    uint32_t i;
+
+    for( i = 0; i < SampledMetricCount; i++ )
+    {
+        vMetricsAggregatorInit( &( pxSampledMetrics[ i ] ), &( pxSampledMetricInfo[ i ].xConfig ) );
+
+        pxSampledMetricReports[ i ].pcName = pxSampledMetricInfo[ i ].pcName;
+        pxSampledMetricReports[ i ].ulNameLength = pxSampledMetricInfo[ i ].ulNameLength;
+        pxSampledMetricReports[ i ].pulNumbersArray = &( pulSampledMetricWindows[ i ][ 0 ] );
+        pxSampledMetricReports[ i ].ulNumbersArrayLength = defenderexampleWINDOW_VALUES_LENGTH;
+    }
+
+    xPreviousSampleNetworkStatsValid = false;
+    ulMsBetweenReports = defenderexampleMS_BETWEEN_REPORTS;
+
+    if( eGetNetworkStats( &( xNetworkStatsSample ) ) == eMetricsCollectorSuccess )
+    {
+        prvSampleNetworkStats( &( xNetworkStatsSample ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvRatePerSecond( uint32_t ulChange,
+                                  uint32_t ulElapsedMs )
+{
+    return ( uint32_t ) ( ( ( uint64_t ) ulChange * 1000U ) / ulElapsedMs );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSampleNetworkStats( const NetworkStats_t * pxNetworkStats )
+{
+    TickType_t xNow = xTaskGetTickCount();
+    uint32_t ulElapsedMs = ( uint32_t ) ( xNow - xPreviousSampleNetworkTime ) * portTICK_PERIOD_MS;
+
+    /* The network stats are running totals, so sample the rate at which they
+     * changed since the previous sample, which keeps the samples comparable
+     * while the time between reports changes. */
+    if( ( xPreviousSampleNetworkStatsValid == true ) && ( ulElapsedMs > 0U ) )
+    {
+        ( void ) xMetricsAggregatorAddSample( &( pxSampledMetrics[ SampledBytesReceived ] ),
+                                              prvRatePerSecond( pxNetworkStats->ulBytesReceived - xPreviousSampleNetworkStats.ulBytesReceived, ulElapsedMs ) );
+        ( void ) xMetricsAggregatorAddSample( &( pxSampledMetrics[ SampledBytesSent ] ),
+                                              prvRatePerSecond( pxNetworkStats->ulBytesSent - xPreviousSampleNetworkStats.ulBytesSent, ulElapsedMs ) );
+        ( void ) xMetricsAggregatorAddSample( &( pxSampledMetrics[ SampledPacketsReceived ] ),
+                                              prvRatePerSecond( pxNetworkStats->ulPacketsReceived - xPreviousSampleNetworkStats.ulPacketsReceived, ulElapsedMs ) );
+        ( void ) xMetricsAggregatorAddSample( &( pxSampledMetrics[ SampledPacketsSent ] ),
+                                              prvRatePerSecond( pxNetworkStats->ulPacketsSent - xPreviousSampleNetworkStats.ulPacketsSent, ulElapsedMs ) );
+    }
+
+    xPreviousSampleNetworkStats = *pxNetworkStats;
+    xPreviousSampleNetworkTime = xNow;
+    xPreviousSampleNetworkStatsValid = true;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSampleMetrics( void )
+{
+    bool xSignificant = false;
+
+    xSignificant |= xMetricsAggregatorAddSample( &( pxSampledMetrics[ SampledHeapFree ] ),
+                                                 ( uint32_t ) xPortGetFreeHeapSize() );
+    xSignificant |= xMetricsAggregatorAddSample( &( pxSampledMetrics[ SampledAgentQueueDepth ] ),
+                                                 ( uint32_t ) uxGetMQTTAgentQueueDepth() );
+    xSignificant |= xMetricsAggregatorAddSample( &( pxSampledMetrics[ SampledAgentInFlight ] ),
+                                                 ( uint32_t ) uxGetMQTTAgentInFlightCount() );
+
+    return xSignificant;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvCloseSampleWindows( void )
+{
+    uint32_t i;
+    MetricWindow_t xWindow;
+    bool xSignificantChange = false;
+
+    for( i = 0; i < SampledMetricCount; i++ )
+    {
+        vMetricsAggregatorCloseWindow( &( pxSampledMetrics[ i ] ), &( xWindow ) );
+
+        pulSampledMetricWindows[ i ][ 0 ] = xWindow.ulMin;
+        pulSampledMetricWindows[ i ][ 1 ] = xWindow.ulMax;
+        pulSampledMetricWindows[ i ][ 2 ] = xWindow.ulMean;
+        pulSampledMetricWindows[ i ][ 3 ] = xWindow.ulLast;
+
+        if( xWindow.xSignificantChange == true )
+        {
+            xSignificantChange = true;
+        }
+    }
+
+    /* Report often while metrics are changing, and back off while they are
+     * stable. */
+    if( xSignificantChange == true )
+    {
+        ulMsBetweenReports = defenderexampleMIN_MS_BETWEEN_REPORTS;
+    }
+    else if( ulMsBetweenReports < ( defenderexampleMAX_MS_BETWEEN_REPORTS / 2U ) )
+    {
+        ulMsBetweenReports *= 2U;
+    }
+    else
+    {
+        ulMsBetweenReports = defenderexampleMAX_MS_BETWEEN_REPORTS;
+    }
+
+    LogDebug( ( "Next report in %u ms.", ( unsigned int ) ulMsBetweenReports ) );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSampleUntilNextReport( void )
+{
+    TickType_t xStartTime = xTaskGetTickCount();
+    TickType_t xElapsedTime = 0U;
+    bool xSignificantChange = false;
+    bool xReportDue = false;
+
+    while( xReportDue == false )
+    {
+        vTaskDelay( pdMS_TO_TICKS( defenderexampleMS_BETWEEN_SAMPLES ) );
+
+        if( prvSampleMetrics() == true )
+        {
+            xSignificantChange = true;
+        }
+
+        xElapsedTime = xTaskGetTickCount() - xStartTime;
+
+        if( xElapsedTime >= pdMS_TO_TICKS( ulMsBetweenReports ) )
+        {
+            xReportDue = true;
+        }
+        else if( ( xSignificantChange == true ) &&
+                 ( xElapsedTime >= pdMS_TO_TICKS( defenderexampleMIN_MS_BETWEEN_REPORTS ) ) )
+        {
+            LogInfo( ( "Significant change in sampled metrics, reporting early." ) );
+            xReportDue = true;
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static bool prvGenerateDeviceMetricsReport( uint32_t * pulOutReportLength )
 {
     bool xStatus = false;
@@ -649,24 +1376,39 @@ static bool prvGenerateDeviceMetricsReport( uint32_t * pulOutReportLength )
 
     /* Generate the metrics report in the format expected by the AWS IoT Device
      * Defender Service. */
-    eReportBuilderStatus = eGenerateJsonReport( &( pcDeviceMetricsJsonReport[ 0 ] ),
-                                                defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE,
-                                                &( xDeviceMetrics ),
-                                                defenderexampleDEVICE_METRICS_REPORT_MAJOR_VERSION,
-                                                defenderexampleDEVICE_METRICS_REPORT_MINOR_VERSION,
-                                                ulReportId,
-                                                pulOutReportLength );
+    #if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 )
+        eReportBuilderStatus = eGenerateCborReport( ( uint8_t * ) &( pcDeviceMetricsReport[ 0 ] ),
+                                                    defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE,
+                                                    &( xDeviceMetrics ),
+                                                    defenderexampleDEVICE_METRICS_REPORT_MAJOR_VERSION,
+                                                    defenderexampleDEVICE_METRICS_REPORT_MINOR_VERSION,
+                                                    ulReportId,
+                                                    pulOutReportLength );
+    #else
+        eReportBuilderStatus = eGenerateJsonReport( &( pcDeviceMetricsReport[ 0 ] ),
+                                                    defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE,
+                                                    &( xDeviceMetrics ),
+                                                    defenderexampleDEVICE_METRICS_REPORT_MAJOR_VERSION,
+                                                    defenderexampleDEVICE_METRICS_REPORT_MINOR_VERSION,
+                                                    ulReportId,
+                                                    pulOutReportLength );
+    #endif
 
     if( eReportBuilderStatus != eReportBuilderSuccess )
     {
-        LogError( ( "GenerateJsonReport failed. Status: %d.",
+        LogError( ( "Generating the report failed. Status: %d.",
                     eReportBuilderStatus ) );
     }
     else
     {
-        LogDebug( ( "Generated Report: %.*s.",
-                    *pulOutReportLength,
-                    &( pcDeviceMetricsJsonReport[ 0 ] ) ) );
+        #if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 )
+            LogDebug( ( "Generated CBOR report of %u bytes.",
+                        *pulOutReportLength ) );
+        #else
+            LogDebug( ( "Generated Report: %.*s.",
+                        *pulOutReportLength,
+                        &( pcDeviceMetricsReport[ 0 ] ) ) );
+        #endif
         xStatus = true;
     }
 
@@ -675,6 +1417,83 @@ static bool prvGenerateDeviceMetricsReport( uint32_t * pulOutReportLength )
 
 /*-----------------------------------------------------------*/
 
+#if ( defenderexampleREPORT_BENCHMARK_ITERATIONS > 0 )
+
+    static void prvBenchmarkReportBuilders( void )
+    {
+        /* Scratch buffer so the report to be published is not overwritten. */
+        static uint8_t ucBenchmarkBuffer[ defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE ];
+        eReportBuilderStatus eJsonStatus = eReportBuilderSuccess, eCborStatus = eReportBuilderSuccess;
+        uint32_t i, ulJsonLength = 0UL, ulCborLength = 0UL;
+        TickType_t xStartTime, xJsonTicks, xCborTicks;
+
+        xStartTime = xTaskGetTickCount();
+
+        for( i = 0; ( ( i < defenderexampleREPORT_BENCHMARK_ITERATIONS ) && ( eJsonStatus == eReportBuilderSuccess ) ); i++ )
+        {
+            eJsonStatus = eGenerateJsonReport( ( char * ) &( ucBenchmarkBuffer[ 0 ] ),
+                                               defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE,
+                                               &( xDeviceMetrics ),
+                                               defenderexampleDEVICE_METRICS_REPORT_MAJOR_VERSION,
+                                               defenderexampleDEVICE_METRICS_REPORT_MINOR_VERSION,
+                                               ulReportId,
+                                               &( ulJsonLength ) );
+        }
+
+        xJsonTicks = xTaskGetTickCount() - xStartTime;
+        xStartTime = xTaskGetTickCount();
+
+        for( i = 0; ( ( i < defenderexampleREPORT_BENCHMARK_ITERATIONS ) && ( eCborStatus == eReportBuilderSuccess ) ); i++ )
+        {
+            eCborStatus = eGenerateCborReport( &( ucBenchmarkBuffer[ 0 ] ),
+                                               defenderexampleDEVICE_METRICS_REPORT_BUFFER_SIZE,
+                                               &( xDeviceMetrics ),
+                                               defenderexampleDEVICE_METRICS_REPORT_MAJOR_VERSION,
+                                               defenderexampleDEVICE_METRICS_REPORT_MINOR_VERSION,
+                                               ulReportId,
+                                               &( ulCborLength ) );
+        }
+
+        xCborTicks = xTaskGetTickCount() - xStartTime;
+
+        if( ( eJsonStatus != eReportBuilderSuccess ) || ( eCborStatus != eReportBuilderSuccess ) )
+        {
+            LogError( ( "Report builder comparison failed. JSON status: %d, CBOR status: %d.",
+                        eJsonStatus,
+                        eCborStatus ) );
+        }
+        else
+        {
+            /* Time per report in microseconds, computed in 64 bits as the
+             * intermediate product overflows 32 bits after a few seconds. */
+            LogInfo( ( "Report builder comparison over %u reports: "
+                       "JSON %u bytes in %u us per report, "
+                       "CBOR %u bytes in %u us per report.",
+                       ( unsigned int ) defenderexampleREPORT_BENCHMARK_ITERATIONS,
+                       ( unsigned int ) ulJsonLength,
+                       ( unsigned int ) ( ( ( uint64_t ) xJsonTicks * 1000000ULL ) /
+                                          ( ( uint64_t ) configTICK_RATE_HZ * defenderexampleREPORT_BENCHMARK_ITERATIONS ) ),
+                       ( unsigned int ) ulCborLength,
+                       ( unsigned int ) ( ( ( uint64_t ) xCborTicks * 1000000ULL ) /
+                                          ( ( uint64_t ) configTICK_RATE_HZ * defenderexampleREPORT_BENCHMARK_ITERATIONS ) ) ) );
+
+            /* Where the CPU clock is known, also express the cost in CPU
+             * cycles, which is comparable across targets and tick rates.  The
+             * benchmark can be preempted, so this is an upper bound. */
+            #ifdef configCPU_CLOCK_HZ
+                LogInfo( ( "Report builder cycles per report: JSON %u, CBOR %u.",
+                           ( unsigned int ) ( ( ( uint64_t ) xJsonTicks * ( configCPU_CLOCK_HZ / configTICK_RATE_HZ ) ) /
+                                              defenderexampleREPORT_BENCHMARK_ITERATIONS ),
+                           ( unsigned int ) ( ( ( uint64_t ) xCborTicks * ( configCPU_CLOCK_HZ / configTICK_RATE_HZ ) ) /
+                                              defenderexampleREPORT_BENCHMARK_ITERATIONS ) ) );
+            #endif
+        }
+    }
+
+#endif /* if ( defenderexampleREPORT_BENCHMARK_ITERATIONS > 0 ) */
+
+/*-----------------------------------------------------------*/
+
 static bool prvPublishDeviceMetricsReport( uint32_t reportLength )
 {
     static MQTTPublishInfo_t xPublishInfo = { 0 };
@@ -682,9 +1501,9 @@ static bool prvPublishDeviceMetricsReport( uint32_t reportLength )
     MQTTStatus_t xCommandAdded;
 
     xPublishInfo.qos = MQTTQoS1;
-    xPublishInfo.pTopicName = DEFENDER_API_JSON_PUBLISH( democonfigCLIENT_IDENTIFIER );
-    xPublishInfo.topicNameLength = DEFENDER_API_LENGTH_JSON_PUBLISH( democonfigCLIENT_IDENTIFIER_LENGTH );
-    xPublishInfo.pPayload = &( pcDeviceMetricsJsonReport[ 0 ] );
+    xPublishInfo.pTopicName = defenderexampleREPORT_PUBLISH_TOPIC;
+    xPublishInfo.topicNameLength = defenderexampleREPORT_PUBLISH_TOPIC_LENGTH;
+    xPublishInfo.pPayload = &( pcDeviceMetricsReport[ 0 ] );
     xPublishInfo.payloadLength = reportLength;
 
     xCommandParams.blockTimeMs = defenderexampleMAX_COMMAND_SEND_BLOCK_TIME_MS;
@@ -702,74 +1521,144 @@ static bool prvPublishDeviceMetricsReport( uint32_t reportLength )
 
 /*-----------------------------------------------------------*/
 
-static bool prvValidateDefenderResponse( const char * pcDefenderResponse,
-                                         uint32_t ulDefenderResponseLength )
-{
-    bool xStatus = false;
-    JSONStatus_t eJsonResult = JSONSuccess;
-    char * ucReportIdString = NULL;
-    size_t xReportIdStringLength;
-    uint32_t ulReportIdInResponse;
+#if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 )
 
-    configASSERT( pcDefenderResponse != NULL );
+    static bool prvValidateDefenderResponse( const char * pcDefenderResponse,
+                                             uint32_t ulDefenderResponseLength )
+    {
+        bool xStatus = false;
+        CborError xCborResult;
+        CborParser xParser;
+        CborValue xResponse, xReportIdValue;
+        uint64_t ullReportIdInResponse = 0ULL;
+
+        configASSERT( pcDefenderResponse != NULL );
+
+        /* Is the response a CBOR map? */
+        xCborResult = cbor_parser_init( ( const uint8_t * ) pcDefenderResponse,
+                                        ulDefenderResponseLength,
+                                        0,
+                                        &( xParser ),
+                                        &( xResponse ) );
+
+        if( ( xCborResult == CborNoError ) && !cbor_value_is_map( &( xResponse ) ) )
+        {
+            xCborResult = CborErrorIllegalType;
+        }
 
-    /* Is the response a valid JSON? */
-    eJsonResult = JSON_Validate( pcDefenderResponse, ulDefenderResponseLength );
+        if( xCborResult != CborNoError )
+        {
+            LogError( ( "Invalid response of length %u from AWS IoT Device Defender Service.",
+                        ulDefenderResponseLength ) );
+        }
 
-    if( eJsonResult != JSONSuccess )
-    {
-        LogError( ( "Invalid response from AWS IoT Device Defender Service: %.*s.",
-                    ( int ) ulDefenderResponseLength,
-                    pcDefenderResponse ) );
-    }
+        if( xCborResult == CborNoError )
+        {
+            /* Search the ReportId key in the response. */
+            xCborResult = cbor_value_map_find_value( &( xResponse ),
+                                                     defenderexampleRESPONSE_REPORT_ID_FIELD,
+                                                     &( xReportIdValue ) );
 
-    if( eJsonResult == JSONSuccess )
-    {
-        /* Search the ReportId key in the response. */
-        eJsonResult = JSON_Search( ( char * ) pcDefenderResponse,
-                                   ulDefenderResponseLength,
-                                   defenderexampleRESPONSE_REPORT_ID_FIELD,
-                                   defenderexampleRESPONSE_REPORT_ID_FIELD_LENGTH,
-                                   &( ucReportIdString ),
-                                   &( xReportIdStringLength ) );
-
-        if( eJsonResult != JSONSuccess )
+            if( ( xCborResult == CborNoError ) && !cbor_value_is_unsigned_integer( &( xReportIdValue ) ) )
+            {
+                xCborResult = CborErrorIllegalType;
+            }
+
+            if( xCborResult != CborNoError )
+            {
+                LogError( ( "%s key not found in the response from the "
+                            "AWS IoT Device Defender Service.",
+                            defenderexampleRESPONSE_REPORT_ID_FIELD ) );
+            }
+        }
+
+        if( xCborResult == CborNoError )
         {
-            LogError( ( "%s key not found in the response from the"
-                        "AWS IoT Device Defender Service: %.*s.",
-                        defenderexampleRESPONSE_REPORT_ID_FIELD,
-                        ( int ) ulDefenderResponseLength,
-                        pcDefenderResponse ) );
+            ( void ) cbor_value_get_uint64( &( xReportIdValue ), &( ullReportIdInResponse ) );
+
+            /* Is the report ID present in the response same as was sent in the
+             * published report? */
+            if( ullReportIdInResponse == ( uint64_t ) ulReportId )
+            {
+                LogInfo( ( "A valid response with report ID %u received from the "
+                           "AWS IoT Device Defender Service.", ulReportId ) );
+                xStatus = true;
+            }
+            else
+            {
+                LogError( ( "Unexpected %s found in the response from the AWS "
+                            "IoT Device Defender Service. Expected: %u, Found: %u.",
+                            defenderexampleRESPONSE_REPORT_ID_FIELD,
+                            ulReportId,
+                            ( uint32_t ) ullReportIdInResponse ) );
+            }
         }
+
+        return xStatus;
     }
 
-    if( eJsonResult == JSONSuccess )
+#else /* if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 ) */
+
+    static bool prvValidateDefenderResponse( const char * pcDefenderResponse,
+                                             uint32_t ulDefenderResponseLength )
     {
-        ulReportIdInResponse = ( uint32_t ) strtoul( ucReportIdString, NULL, 10 );
+        bool xStatus = false;
+        eJsonExtractorStatus eJsonResult;
+        JsonExtractorKey_t xReportIdKey = jsonextractorKEY( defenderexampleRESPONSE_REPORT_ID_FIELD );
+        uint32_t ulReportIdInResponse;
+
+        configASSERT( pcDefenderResponse != NULL );
+
+        /* Is the response a valid JSON?  The ReportId is extracted in the same
+         * pass over the response. */
+        eJsonResult = eJsonExtract( pcDefenderResponse,
+                                    ulDefenderResponseLength,
+                                    &( xReportIdKey ),
+                                    1 );
 
-        /* Is the report ID present in the response same as was sent in the
-         * published report? */
-        if( ulReportIdInResponse == ulReportId )
+        if( eJsonResult != eJsonExtractorSuccess )
         {
-            LogInfo( ( "A valid response with report ID %u received from the "
-                       "AWS IoT Device Defender Service.", ulReportId ) );
-            xStatus = true;
+            LogError( ( "Invalid response from AWS IoT Device Defender Service: %.*s.",
+                        ( int ) ulDefenderResponseLength,
+                        pcDefenderResponse ) );
         }
-        else
+        else if( xReportIdKey.eValueType == JsonExtractorValueNotFound )
         {
-            LogError( ( "Unexpected %s found in the response from the AWS"
-                        "IoT Device Defender Service. Expected: %u, Found: %u, "
-                        "Complete Response: %.*s.",
+            LogError( ( "%s key not found in the response from the"
+                        "AWS IoT Device Defender Service: %.*s.",
                         defenderexampleRESPONSE_REPORT_ID_FIELD,
-                        ulReportId,
-                        ulReportIdInResponse,
                         ( int ) ulDefenderResponseLength,
                         pcDefenderResponse ) );
         }
+        else
+        {
+            ulReportIdInResponse = ( uint32_t ) strtoul( xReportIdKey.pcValue, NULL, 10 );
+
+            /* Is the report ID present in the response same as was sent in the
+             * published report? */
+            if( ulReportIdInResponse == ulReportId )
+            {
+                LogInfo( ( "A valid response with report ID %u received from the "
+                           "AWS IoT Device Defender Service.", ulReportId ) );
+                xStatus = true;
+            }
+            else
+            {
+                LogError( ( "Unexpected %s found in the response from the AWS"
+                            "IoT Device Defender Service. Expected: %u, Found: %u, "
+                            "Complete Response: %.*s.",
+                            defenderexampleRESPONSE_REPORT_ID_FIELD,
+                            ulReportId,
+                            ulReportIdInResponse,
+                            ( int ) ulDefenderResponseLength,
+                            pcDefenderResponse ) );
+            }
+        }
+
+        return xStatus;
     }
 
-    return xStatus;
-}
+#endif /* if ( democonfigDEFENDER_USE_CBOR_REPORTS == 1 ) */
 
 /*-----------------------------------------------------------*/
 
@@ -788,9 +1677,10 @@ void prvDefenderDemoTask( void * pvParameters )
     /******************** Subscribe to Defender topics. *******************/
 
     /* Attempt to subscribe to the AWS IoT Device Defender topics.
-     * Since this demo is using JSON, in prvSubscribeToDefenderTopics() we
-     * subscribe to the topics to which accepted and rejected responses are
-     * received from after publishing a JSON report.
+     * In prvSubscribeToDefenderTopics() we subscribe to the topics to which
+     * accepted and rejected responses are received from after publishing a
+     * report - the JSON topics by default, or the CBOR topics when
+     * democonfigDEFENDER_USE_CBOR_REPORTS is set to 1.
      *
      * This demo uses a constant #democonfigCLIENT_IDENTIFIER known at compile time
      * therefore we use macros to assemble defender topic strings.
@@ -821,6 +1711,12 @@ void prvDefenderDemoTask( void * pvParameters )
     LogInfo( ( "Subscribing to defender topics..." ) );
     xStatus = prvSubscribeToDefenderTopics();
 
+    /* Take a first sample so the first report has values for the heap and
+     * MQTT agent.  prvInitSampledMetrics() sets the starting point of the
+     * network stats. */
+    prvInitSampledMetrics();
+    ( void ) prvSampleMetrics();
+
     if( xStatus == true )
     {
         for( ; ; )
@@ -857,10 +1753,18 @@ void prvDefenderDemoTask( void * pvParameters )
                 }
             }
 
+            /* Lists that have not changed since the last accepted report are
+             * only sent as totals, which keeps most reports small. */
+            if( xStatus == true )
+            {
+                prvSelectReportSections();
+            }
+
             /********************** Generate defender report. *********************/
 
-            /* The data needs to be incorporated into a JSON formatted report,
-             * which follows the format expected by the Device Defender service.
+            /* The data needs to be incorporated into a JSON or CBOR formatted
+             * report, which follows the format expected by the Device Defender
+             * service.
              * This format is documented here:
              * https://docs.aws.amazon.com/iot/latest/developerguide/detect-device-side-metrics.html
              */
@@ -875,10 +1779,18 @@ void prvDefenderDemoTask( void * pvParameters )
                 }
             }
 
+            #if ( defenderexampleREPORT_BENCHMARK_ITERATIONS > 0 )
+                if( xStatus == true )
+                {
+                    prvBenchmarkReportBuilders();
+                }
+            #endif
+
             /********************** Publish defender report. **********************/
 
             /* The report is then published to the Device Defender service. This report
-             * is published to the MQTT topic for publishing JSON reports. As before,
+             * is published to the MQTT topic for publishing JSON or CBOR reports, matching
+             * the format of the report. As before,
              * we use the defender library macros to create the topic string, though
              * #Defender_GetTopic could be used if the Thing name is acquired at
              * run time */
@@ -909,8 +1821,19 @@ void prvDefenderDemoTask( void * pvParameters )
                 }
             }
 
-            LogDebug( ( "Sleeping until next report." ) );
-            vTaskDelay( pdMS_TO_TICKS( defenderexampleMS_BETWEEN_REPORTS ) );
+            /* The next report is only reduced against a report the service is
+             * known to have received. */
+            if( ( xStatus == true ) && ( xReportStatus == ReportStatusAccepted ) )
+            {
+                prvSaveAcceptedReport();
+            }
+            else
+            {
+                xLastAcceptedReportValid = false;
+            }
+
+            LogDebug( ( "Sampling metrics until next report." ) );
+            prvSampleUntilNextReport();
         }
     }
 }
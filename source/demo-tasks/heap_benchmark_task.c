@@ -0,0 +1,353 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+
+/*
+ * This file implements a task that measures the FreeRTOS heap linked into the
+ * image.  The task allocates and frees blocks of random sizes in random order
+ * for as long as it runs, timing each call to pvPortMalloc() and vPortFree()
+ * with the run time stats counter, and periodically logs the worst and mean
+ * times and the fragmentation of the free heap space.  The sequence of sizes
+ * is the same on every run, so building once with the default heap_4.c and
+ * once with HEAP=tlsf (see source/heap-tools/heap_tlsf.h) compares the two
+ * heaps on the same workload.  Most blocks are small, some are a few kilobytes
+ * and a few are larger, mimicking the mix of message buffers, TLS records and
+ * OTA blocks allocated by the other demos.
+ *
+ * The task runs at idle priority with the scheduler suspended around each
+ * timed call, so the times include interrupts but not other tasks.  The other
+ * tasks in the image keep allocating and freeing at the same time, so their
+ * blocks fragment the heap too.
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Demo Specific configs. */
+#include "demo_config.h"
+
+/**
+ * @brief Number of blocks that can be allocated by the task at once.
+ */
+#define heapbenchMAX_BLOCKS                 ( 64U )
+
+/**
+ * @brief Percentage of the free heap space, when the task starts, that can be
+ * allocated by the task at once.
+ */
+#define heapbenchMAX_LIVE_PERCENT           ( 50U )
+
+/**
+ * @brief Number of calls to pvPortMalloc() or vPortFree() between reports.
+ */
+#define heapbenchOPERATIONS_PER_REPORT      ( 20000UL )
+
+/**
+ * @brief Time in milliseconds to pause after each report, to let the rest of
+ * the system run.
+ */
+#define heapbenchREPORT_DELAY_MS            ( 1000U )
+
+/**
+ * @brief Seed of the pseudo random number generator.  Fixed so every run
+ * performs the same sequence of operations.
+ */
+#define heapbenchSEED                       ( 0x2545F491UL )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Worst and total time of the calls to a heap function.
+ */
+typedef struct HeapBenchTimes
+{
+    uint32_t ulWorst;
+    uint64_t ullTotal;
+    uint32_t ulCalls;
+} HeapBenchTimes_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Generate a pseudo random number with a xorshift generator.  uxRand()
+ * is not used as its sequence depends on the time the image started.
+ *
+ * @return The next number in the sequence.
+ */
+static uint32_t prvNextRandom( void );
+
+/**
+ * @brief Pick the size of the next block to allocate.
+ *
+ * @return 16 to 256 bytes 75% of the time, 512 to 4096 bytes 22% of the time
+ * and 8192 to 16384 bytes 3% of the time.
+ */
+static size_t prvRandomBlockSize( void );
+
+/**
+ * @brief Record the time taken by a call.
+ *
+ * @param[in] pxTimes The times of the function called.
+ * @param[in] ulTime The time taken, in run time stats counter ticks.
+ */
+static void prvRecordTime( HeapBenchTimes_t * pxTimes,
+                           uint32_t ulTime );
+
+/**
+ * @brief Log the times and fragmentation since the previous report.
+ */
+static void prvReport( void );
+
+/**
+ * @brief The task that allocates and frees blocks.
+ *
+ * @param[in] pvParameters Unused.
+ */
+static void prvHeapBenchmarkTask( void * pvParameters );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief State of the pseudo random number generator.
+ */
+static uint32_t ulRandomState = heapbenchSEED;
+
+/**
+ * @brief The blocks allocated by the task, and their sizes.
+ */
+static void * pvBlocks[ heapbenchMAX_BLOCKS ];
+static size_t xBlockSizes[ heapbenchMAX_BLOCKS ];
+
+/**
+ * @brief Times since the previous report.
+ */
+static HeapBenchTimes_t xMallocTimes;
+static HeapBenchTimes_t xFreeTimes;
+
+/**
+ * @brief Worst times since the task started.
+ */
+static uint32_t ulWorstMallocTimeEver = 0;
+static uint32_t ulWorstFreeTimeEver = 0;
+
+/**
+ * @brief Number of allocations that failed since the task started.
+ */
+static uint32_t ulFailedAllocations = 0;
+
+/*-----------------------------------------------------------*/
+
+void vStartHeapBenchmarkTask( configSTACK_DEPTH_TYPE uxStackSize,
+                              UBaseType_t uxPriority )
+{
+    xTaskCreate( prvHeapBenchmarkTask,
+                 "HeapBench",
+                 uxStackSize,
+                 NULL,
+                 uxPriority,
+                 NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvNextRandom( void )
+{
+    ulRandomState ^= ulRandomState << 13;
+    ulRandomState ^= ulRandomState >> 17;
+    ulRandomState ^= ulRandomState << 5;
+
+    return ulRandomState;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvRandomBlockSize( void )
+{
+    uint32_t ulClass = prvNextRandom() % 100UL;
+    size_t xSize;
+
+    if( ulClass < 75UL )
+    {
+        xSize = 16U + ( size_t ) ( prvNextRandom() % 241UL );
+    }
+    else if( ulClass < 97UL )
+    {
+        xSize = 512U + ( size_t ) ( prvNextRandom() % 3585UL );
+    }
+    else
+    {
+        xSize = 8192U + ( size_t ) ( prvNextRandom() % 8193UL );
+    }
+
+    return xSize;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvRecordTime( HeapBenchTimes_t * pxTimes,
+                           uint32_t ulTime )
+{
+    if( ulTime > pxTimes->ulWorst )
+    {
+        pxTimes->ulWorst = ulTime;
+    }
+
+    pxTimes->ullTotal += ulTime;
+    pxTimes->ulCalls++;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvReport( void )
+{
+    HeapStats_t xHeapStats;
+    uint32_t ulFragmentationPercent = 0;
+
+    vPortGetHeapStats( &xHeapStats );
+
+    if( xHeapStats.xAvailableHeapSpaceInBytes > 0U )
+    {
+        ulFragmentationPercent = ( uint32_t ) ( 100U - ( ( ( uint64_t ) xHeapStats.xSizeOfLargestFreeBlockInBytes * 100U ) / xHeapStats.xAvailableHeapSpaceInBytes ) );
+    }
+
+    if( xMallocTimes.ulWorst > ulWorstMallocTimeEver )
+    {
+        ulWorstMallocTimeEver = xMallocTimes.ulWorst;
+    }
+
+    if( xFreeTimes.ulWorst > ulWorstFreeTimeEver )
+    {
+        ulWorstFreeTimeEver = xFreeTimes.ulWorst;
+    }
+
+    LogInfo( ( "Heap benchmark: pvPortMalloc() worst %lu (ever %lu) mean %lu, "
+               "vPortFree() worst %lu (ever %lu) mean %lu run time counts.",
+               ( unsigned long ) xMallocTimes.ulWorst,
+               ( unsigned long ) ulWorstMallocTimeEver,
+               ( unsigned long ) ( ( xMallocTimes.ulCalls > 0UL ) ? ( xMallocTimes.ullTotal / xMallocTimes.ulCalls ) : 0U ),
+               ( unsigned long ) xFreeTimes.ulWorst,
+               ( unsigned long ) ulWorstFreeTimeEver,
+               ( unsigned long ) ( ( xFreeTimes.ulCalls > 0UL ) ? ( xFreeTimes.ullTotal / xFreeTimes.ulCalls ) : 0U ) ) );
+
+    LogInfo( ( "Heap benchmark: %lu bytes free (minimum ever %lu), largest free block %lu, "
+               "%lu free blocks, %lu%% of the free space outside the largest block, "
+               "%lu failed allocations.",
+               ( unsigned long ) xHeapStats.xAvailableHeapSpaceInBytes,
+               ( unsigned long ) xHeapStats.xMinimumEverFreeBytesRemaining,
+               ( unsigned long ) xHeapStats.xSizeOfLargestFreeBlockInBytes,
+               ( unsigned long ) xHeapStats.xNumberOfFreeBlocks,
+               ( unsigned long ) ulFragmentationPercent,
+               ( unsigned long ) ulFailedAllocations ) );
+
+    xMallocTimes.ulWorst = 0;
+    xMallocTimes.ullTotal = 0;
+    xMallocTimes.ulCalls = 0;
+    xFreeTimes.ulWorst = 0;
+    xFreeTimes.ullTotal = 0;
+    xFreeTimes.ulCalls = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvHeapBenchmarkTask( void * pvParameters )
+{
+    size_t xLiveBytes = 0U, xMaxLiveBytes, xSize;
+    uint32_t ulBlock, ulStart, ulTime, ulOperations = 0;
+    void * pvBlock;
+
+    ( void ) pvParameters;
+
+    xMaxLiveBytes = ( xPortGetFreeHeapSize() / 100U ) * heapbenchMAX_LIVE_PERCENT;
+
+    LogInfo( ( "Heap benchmark started, using at most %lu bytes in %u blocks.",
+               ( unsigned long ) xMaxLiveBytes,
+               ( unsigned int ) heapbenchMAX_BLOCKS ) );
+
+    for( ; ; )
+    {
+        ulBlock = prvNextRandom() % heapbenchMAX_BLOCKS;
+
+        if( pvBlocks[ ulBlock ] != NULL )
+        {
+            vTaskSuspendAll();
+            {
+                ulStart = portGET_RUN_TIME_COUNTER_VALUE();
+                vPortFree( pvBlocks[ ulBlock ] );
+                ulTime = portGET_RUN_TIME_COUNTER_VALUE() - ulStart;
+            }
+            ( void ) xTaskResumeAll();
+
+            prvRecordTime( &xFreeTimes, ulTime );
+            xLiveBytes -= xBlockSizes[ ulBlock ];
+            pvBlocks[ ulBlock ] = NULL;
+            ulOperations++;
+        }
+        else
+        {
+            xSize = prvRandomBlockSize();
+
+            /* Blocks that would take the task over its share of the heap are
+             * skipped, so failed allocations measure fragmentation rather than
+             * exhaustion. */
+            if( ( xLiveBytes + xSize ) <= xMaxLiveBytes )
+            {
+                vTaskSuspendAll();
+                {
+                    ulStart = portGET_RUN_TIME_COUNTER_VALUE();
+                    pvBlock = pvPortMalloc( xSize );
+                    ulTime = portGET_RUN_TIME_COUNTER_VALUE() - ulStart;
+                }
+                ( void ) xTaskResumeAll();
+
+                prvRecordTime( &xMallocTimes, ulTime );
+                ulOperations++;
+
+                if( pvBlock != NULL )
+                {
+                    pvBlocks[ ulBlock ] = pvBlock;
+                    xBlockSizes[ ulBlock ] = xSize;
+                    xLiveBytes += xSize;
+                }
+                else
+                {
+                    ulFailedAllocations++;
+                }
+            }
+        }
+
+        if( ulOperations >= heapbenchOPERATIONS_PER_REPORT )
+        {
+            prvReport();
+            ulOperations = 0;
+            vTaskDelay( pdMS_TO_TICKS( heapbenchREPORT_DELAY_MS ) );
+        }
+    }
+}
@@ -39,6 +39,9 @@
  * exactly.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModulePubSub
+
 /* Standard includes. */
 #include <string.h>
 #include <stdio.h>
@@ -0,0 +1,259 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/*
+ * This file implements a task that lets the logging level of each module be
+ * changed at runtime.  The task subscribes to the topic
+ * democonfigCLIENT_IDENTIFIER "/log/level", then deletes itself.  The payload
+ * of every message published to the topic is passed to xLoggingSetLevels(),
+ * so for example publishing "tls=debug,ota=warn" enables the debug messages of
+ * the TLS transport and disables the informational messages of the OTA demo,
+ * and publishing "*=info" sets every module back to the info level.  See
+ * logging_config.h for the list of modules.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdbool.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Demo Specific configs. */
+#include "demo_config.h"
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/* MQTT agent include. */
+#include "core_mqtt_agent.h"
+
+/* Subscription manager header include. */
+#include "subscription_manager.h"
+
+/**
+ * @brief The topic the logging levels are set by.
+ */
+#define logcontrolTOPIC                              democonfigCLIENT_IDENTIFIER "/log/level"
+
+/**
+ * @brief Length of #logcontrolTOPIC.
+ */
+#define logcontrolTOPIC_LENGTH                       ( ( uint16_t ) ( sizeof( logcontrolTOPIC ) - 1U ) )
+
+/**
+ * @brief The maximum amount of time in milliseconds to wait for the subscribe
+ * command to be posted to the MQTT agent should the MQTT agent's command queue
+ * be full.
+ */
+#define logcontrolMAX_COMMAND_SEND_BLOCK_TIME_MS     ( 500 )
+
+/**
+ * @brief Time to wait for the SUBACK, in milliseconds.
+ */
+#define logcontrolMS_TO_WAIT_FOR_SUBACK              ( 10000 )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Defines the structure to use as the command callback context in this
+ * demo.
+ */
+struct MQTTAgentCommandContext
+{
+    TaskHandle_t xTaskToNotify;
+    bool xReturnStatus;
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Passed into MQTTAgent_Subscribe() as the callback to execute when the
+ * broker ACKs the SUBSCRIBE message.  It routes publishes to the topic to
+ * prvIncomingPublishCallback() and notifies the subscribing task.
+ *
+ * @param[in] pxCommandContext Context of the initial command.
+ * @param[in] pxReturnInfo The result of the command.
+ */
+static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
+                                         MQTTAgentReturnInfo_t * pxReturnInfo );
+
+/**
+ * @brief The callback registered with the subscription manager for the topic.
+ * It applies the logging levels in the payload.
+ *
+ * @param[in] pvIncomingPublishCallbackContext Unused.
+ * @param[in] pxPublishInfo Deserialized publish.
+ */
+static void prvIncomingPublishCallback( void * pvIncomingPublishCallbackContext,
+                                        MQTTPublishInfo_t * pxPublishInfo );
+
+/**
+ * @brief The task that subscribes to the topic.
+ *
+ * @param[in] pvParameters Unused.
+ */
+static void prvLogControlTask( void * pvParameters );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The MQTT agent manages the MQTT contexts.  This set the handle to the
+ * context used by this demo.
+ */
+extern MQTTAgentContext_t xGlobalMqttAgentContext;
+
+/*-----------------------------------------------------------*/
+
+void vStartLogControlTask( configSTACK_DEPTH_TYPE uxStackSize,
+                           UBaseType_t uxPriority )
+{
+    xTaskCreate( prvLogControlTask,
+                 "LogControl",
+                 uxStackSize,
+                 NULL,
+                 uxPriority,
+                 NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
+                                         MQTTAgentReturnInfo_t * pxReturnInfo )
+{
+    bool xSuccess = false;
+
+    /* Check if the subscribe operation is a success. */
+    if( pxReturnInfo->returnCode == MQTTSuccess )
+    {
+        /* Add the subscription so that incoming publishes are routed to the
+         * callback that applies them. */
+        xSuccess = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
+                                    logcontrolTOPIC,
+                                    logcontrolTOPIC_LENGTH,
+                                    prvIncomingPublishCallback,
+                                    NULL );
+
+        if( xSuccess == false )
+        {
+            LogError( ( "Failed to register an incoming publish callback for topic %s.", logcontrolTOPIC ) );
+        }
+    }
+
+    /* Store the result in the application defined context so the calling task
+     * can check it. */
+    pxCommandContext->xReturnStatus = xSuccess;
+
+    xTaskNotifyGive( pxCommandContext->xTaskToNotify );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvIncomingPublishCallback( void * pvIncomingPublishCallbackContext,
+                                        MQTTPublishInfo_t * pxPublishInfo )
+{
+    int32_t xSettings;
+
+    ( void ) pvIncomingPublishCallbackContext;
+
+    xSettings = xLoggingSetLevels( ( const char * ) pxPublishInfo->pPayload, pxPublishInfo->payloadLength );
+
+    /* Logged as a warning so it is seen whatever levels are set. */
+    if( xSettings < 0 )
+    {
+        LogWarn( ( "Ignored invalid logging levels: %.*s",
+                   ( int ) pxPublishInfo->payloadLength,
+                   ( const char * ) pxPublishInfo->pPayload ) );
+    }
+    else
+    {
+        LogWarn( ( "Applied %d logging level settings: %.*s",
+                   ( int ) xSettings,
+                   ( int ) pxPublishInfo->payloadLength,
+                   ( const char * ) pxPublishInfo->pPayload ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvLogControlTask( void * pvParameters )
+{
+    MQTTStatus_t xStatus;
+    uint32_t ulNotificationValue;
+    MQTTAgentCommandInfo_t xCommandParams = { 0 };
+
+    /* These must persist until the command is processed. */
+    MQTTAgentSubscribeArgs_t xSubscribeArgs = { 0 };
+    MQTTSubscribeInfo_t xSubscribeInfo;
+    MQTTAgentCommandContext_t xApplicationDefinedContext = { 0 };
+
+    ( void ) pvParameters;
+
+    xSubscribeInfo.pTopicFilter = logcontrolTOPIC;
+    xSubscribeInfo.topicFilterLength = logcontrolTOPIC_LENGTH;
+    xSubscribeInfo.qos = MQTTQoS1;
+    xSubscribeArgs.pSubscribeInfo = &xSubscribeInfo;
+    xSubscribeArgs.numSubscriptions = 1;
+
+    xApplicationDefinedContext.xTaskToNotify = xTaskGetCurrentTaskHandle();
+
+    /* Loop in case the queue used to communicate with the MQTT agent is full and
+     * attempts to post to it time out.  The queue will not become full if the
+     * priority of the MQTT agent task is higher than the priority of the task
+     * calling this function. */
+    xTaskNotifyStateClear( NULL );
+    xCommandParams.blockTimeMs = logcontrolMAX_COMMAND_SEND_BLOCK_TIME_MS;
+    xCommandParams.cmdCompleteCallback = prvSubscribeCommandCallback;
+    xCommandParams.pCmdCompleteCallbackContext = &xApplicationDefinedContext;
+    LogInfo( ( "Sending subscribe request to agent for topic filter: %s", logcontrolTOPIC ) );
+
+    do
+    {
+        xStatus = MQTTAgent_Subscribe( &xGlobalMqttAgentContext,
+                                       &xSubscribeArgs,
+                                       &xCommandParams );
+    } while( xStatus != MQTTSuccess );
+
+    /* Wait for the SUBACK.  The context is on this task's stack, so the wait
+     * must not time out before the callback has run. */
+    ulNotificationValue = ulTaskNotifyTake( pdFALSE, pdMS_TO_TICKS( logcontrolMS_TO_WAIT_FOR_SUBACK ) );
+    configASSERT( ulNotificationValue != 0UL );
+
+    if( xApplicationDefinedContext.xReturnStatus == false )
+    {
+        LogError( ( "Failed to subscribe to topic %s.", logcontrolTOPIC ) );
+    }
+    else
+    {
+        LogInfo( ( "Logging levels can be set by publishing to topic %s.", logcontrolTOPIC ) );
+    }
+
+    /* The levels are set from the MQTT agent task, so this task has nothing
+     * left to do. */
+    vTaskDelete( NULL );
+}
@@ -40,6 +40,9 @@
  * See https://freertos.org/ota/ota-mqtt-agent-demo.html
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleOta
+
 /* Standard includes. */
 #include <string.h>
 #include <stdio.h>
@@ -49,7 +52,12 @@
 /* Kernel includes. */
 #include "FreeRTOS.h"
 #include "task.h"
-#include "semphr.h"
+
+/* Heap accounting include. */
+#include "heap_tags.h"
+
+/* Object pool include. */
+#include "object_pool.h"
 
 #include "ota_config.h"
 #include "demo_config.h"
@@ -74,6 +82,12 @@
 /* Include platform abstraction header. */
 #include "ota_pal.h"
 
+#if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+    /* In-process stand-in for the AWS IoT Jobs and Streams services. */
+    #include "ota_stream_simulator.h"
+    #include "ota_simulator_config.h"
+#endif
+
 /*------------- Demo configurations -------------------------*/
 
 #ifndef democonfigCLIENT_IDENTIFIER
@@ -267,7 +281,7 @@ static OtaMqttStatus_t prvMQTTUnsubscribe( const char * pTopicFilter,
  * Demo uses a simple statically allocated array of fixed size event buffers. The
  * number of event buffers is configured by the param otaconfigMAX_NUM_OTA_DATA_BUFFERS
  * within ota_config.h. This function is used to fetch a free buffer from the pool for processing
- * by the OTA agent task. It uses a mutex for thread safe access to the pool.
+ * by the OTA agent task. The pool is lock-free, so the function does not block.
  *
  * @return A pointer to an unused buffer. NULL if there are no buffers available.
  */
@@ -279,13 +293,29 @@ static OtaEventData_t * prvOTAEventBufferGet( void );
  * OTA demo uses a statically allocated array of fixed size event buffers . The
  * number of event buffers is configured by the param otaconfigMAX_NUM_OTA_DATA_BUFFERS
  * within ota_config.h. The function is used by the OTA application callback to free a buffer,
- * after OTA agent has completed processing with the event. The access to the pool is made thread safe
- * using a mutex.
+ * after OTA agent has completed processing with the event.
  *
  * @param[in] pxBuffer Pointer to the buffer to be freed.
  */
 static void prvOTAEventBufferFree( OtaEventData_t * const pxBuffer );
 
+/**
+ * @brief Allocate memory for the OTA library.  Used in place of
+ * Malloc_FreeRTOS() so the memory is accounted to the OTA heap tag.
+ *
+ * @param[in] size Number of bytes to allocate.
+ *
+ * @return The memory, or NULL if it could not be allocated.
+ */
+static void * prvOTAMalloc( size_t size );
+
+/**
+ * @brief Free memory allocated by prvOTAMalloc().
+ *
+ * @param[in] ptr The memory to free.
+ */
+static void prvOTAFree( void * ptr );
+
 /**
  * @brief The function which runs the OTA agent task.
  *
@@ -370,6 +400,44 @@ static bool prvMatchClientIdentifierInTopic( const char * pTopic,
 bool vOTAProcessMessage( void * pvIncomingPublishCallbackContext,
                          MQTTPublishInfo_t * pxPublishInfo );
 
+#if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+
+/**
+ * @brief Deliver a message from the OTA simulator as if it had been received
+ * from the broker.
+ *
+ * @param[in] pvIncomingPublishCallbackContext Context registered with the simulator.
+ * @param[in] pxPublishInfo The simulated message.
+ */
+    static void prvProcessSimulatedMessage( void * pvIncomingPublishCallbackContext,
+                                            MQTTPublishInfo_t * pxPublishInfo );
+
+/**
+ * @brief Wrapper around the PAL close file function that records how long
+ * the image signature verification takes.
+ *
+ * @param[in] pxFileContext OTA file context passed to the PAL.
+ * @return The status returned by otaPal_CloseFile().
+ */
+    static OtaPalStatus_t prvTimedCloseFile( OtaFileContext_t * const pxFileContext );
+
+/**
+ * @brief Log the time taken to download and verify the simulated image along
+ * with the simulator counters.  Only the first call logs anything.
+ *
+ * @param[in] pcOutcome Description of how the job ended.
+ */
+    static void prvLogSimulatorBenchmark( const char * pcOutcome );
+
+/**
+ * @brief Tick counts captured for the simulator benchmark.
+ */
+    static TickType_t xBenchmarkStartTime = 0;
+    static TickType_t xVerifyStartTime = 0;
+    static TickType_t xVerifyEndTime = 0;
+    static BaseType_t xBenchmarkReported = pdFALSE;
+#endif /* if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 ) */
+
 /**
  * @brief Buffer used to store the firmware image file path.
  * Buffer is passed to the OTA agent during initialization.
@@ -407,12 +475,7 @@ static uint8_t bitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
  * The size of each buffer is determined by the maximum size of firmware image
  * chunk, and other metadata send along with the chunk.
  */
-static OtaEventData_t eventBuffer[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ] = { 0 };
-
-/*
- * @brief Mutex used to manage thread safe access of OTA event buffers.
- */
-static SemaphoreHandle_t xBufferSemaphore;
+objectpoolDEFINE( xEventBufferPool, OtaEventData_t, otaconfigMAX_NUM_OTA_DATA_BUFFERS );
 
 /**
  * @brief Static handle used for MQTT agent context.
@@ -451,14 +514,9 @@ const AppVersion32_t appFirmwareVersion =
 
 static void prvOTAEventBufferFree( OtaEventData_t * const pxBuffer )
 {
-    if( xSemaphoreTake( xBufferSemaphore, portMAX_DELAY ) == pdTRUE )
-    {
-        pxBuffer->bufferUsed = false;
-        ( void ) xSemaphoreGive( xBufferSemaphore );
-    }
-    else
+    if( xObjectPoolRelease( &xEventBufferPool, pxBuffer ) != pdPASS )
     {
-        LogError( ( "Failed to get buffer semaphore." ) );
+        LogError( ( "Freed an event buffer that is not in use." ) );
     }
 }
 
@@ -466,29 +524,21 @@ static void prvOTAEventBufferFree( OtaEventData_t * const pxBuffer )
 
 static OtaEventData_t * prvOTAEventBufferGet( void )
 {
-    uint32_t ulIndex = 0;
-    OtaEventData_t * pFreeBuffer = NULL;
+    return pvObjectPoolAcquire( &xEventBufferPool, 0U );
+}
 
-    if( xSemaphoreTake( xBufferSemaphore, portMAX_DELAY ) == pdTRUE )
-    {
-        for( ulIndex = 0; ulIndex < otaconfigMAX_NUM_OTA_DATA_BUFFERS; ulIndex++ )
-        {
-            if( eventBuffer[ ulIndex ].bufferUsed == false )
-            {
-                eventBuffer[ ulIndex ].bufferUsed = true;
-                pFreeBuffer = &eventBuffer[ ulIndex ];
-                break;
-            }
-        }
+/*-----------------------------------------------------------*/
 
-        ( void ) xSemaphoreGive( xBufferSemaphore );
-    }
-    else
-    {
-        LogError( ( "Failed to get buffer semaphore." ) );
-    }
+static void * prvOTAMalloc( size_t size )
+{
+    return heaptagsMALLOC( eHeapTagOta, size );
+}
 
-    return pFreeBuffer;
+/*-----------------------------------------------------------*/
+
+static void prvOTAFree( void * ptr )
+{
+    heaptagsFREE( ptr );
 }
 
 /*-----------------------------------------------------------*/
@@ -533,6 +583,10 @@ static void otaAppCallback( OtaJobEvent_t event,
              * Activate the new firmware image immediately. Applications can choose to postpone
              * the activation to a later stage if needed.
              */
+            #if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+                prvLogSimulatorBenchmark( "image verified" );
+            #endif
+
             err = OTA_ActivateNewImage();
 
             /**
@@ -556,6 +610,10 @@ static void otaAppCallback( OtaJobEvent_t event,
              */
             LogInfo( ( "Received an OtaJobEventFail notification from OTA Agent." ) );
 
+            #if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+                prvLogSimulatorBenchmark( "job failed" );
+            #endif
+
             break;
 
         case OtaJobEventStartTest:
@@ -999,6 +1057,81 @@ static OtaMqttStatus_t prvMQTTUnsubscribe( const char * pTopicFilter,
 
 /*-----------------------------------------------------------*/
 
+#if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+
+    static void prvProcessSimulatedMessage( void * pvIncomingPublishCallbackContext,
+                                            MQTTPublishInfo_t * pxPublishInfo )
+    {
+        if( vOTAProcessMessage( pvIncomingPublishCallbackContext, pxPublishInfo ) == false )
+        {
+            LogWarn( ( "Simulated message on %.*s was not processed by OTA.",
+                       pxPublishInfo->topicNameLength,
+                       pxPublishInfo->pTopicName ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static OtaPalStatus_t prvTimedCloseFile( OtaFileContext_t * const pxFileContext )
+    {
+        OtaPalStatus_t xStatus;
+
+        xVerifyStartTime = xTaskGetTickCount();
+        xStatus = otaPal_CloseFile( pxFileContext );
+        xVerifyEndTime = xTaskGetTickCount();
+
+        return xStatus;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvLogSimulatorBenchmark( const char * pcOutcome )
+    {
+        OtaSimulatorStats_t xSimulatorStats;
+        uint32_t ulDownloadMs, ulVerifyMs = 0, ulTotalMs;
+
+        if( xBenchmarkReported == pdFALSE )
+        {
+            xBenchmarkReported = pdTRUE;
+
+            ulTotalMs = ( uint32_t ) ( ( xTaskGetTickCount() - xBenchmarkStartTime ) * portTICK_PERIOD_MS );
+            ulDownloadMs = ulTotalMs;
+
+            /* The verify times are only set if the download reached the point
+             * of closing the file. */
+            if( xVerifyEndTime != 0 )
+            {
+                ulDownloadMs = ( uint32_t ) ( ( xVerifyStartTime - xBenchmarkStartTime ) * portTICK_PERIOD_MS );
+                ulVerifyMs = ( uint32_t ) ( ( xVerifyEndTime - xVerifyStartTime ) * portTICK_PERIOD_MS );
+            }
+
+            vOtaSimulatorGetStats( &xSimulatorStats );
+
+            LogInfo( ( "OTA simulator benchmark (%s): image %lu bytes, download %lu ms, "
+                       "verify %lu ms, total %lu ms, throughput %lu bytes/s.",
+                       pcOutcome,
+                       ( unsigned long ) otasimconfigIMAGE_SIZE,
+                       ( unsigned long ) ulDownloadMs,
+                       ( unsigned long ) ulVerifyMs,
+                       ( unsigned long ) ulTotalMs,
+                       ( unsigned long ) ( ( ulDownloadMs > 0U ) ? ( ( otasimconfigIMAGE_SIZE * 1000UL ) / ulDownloadMs ) : 0UL ) ) );
+            LogInfo( ( "OTA simulator counters: job requests %u, stream requests %u, blocks served %u, "
+                       "dropped %u, reordered %u, duplicated %u, delivered %u, overflows %u.",
+                       xSimulatorStats.ulJobRequests,
+                       xSimulatorStats.ulStreamRequests,
+                       xSimulatorStats.ulBlocksServed,
+                       xSimulatorStats.ulBlocksDropped,
+                       xSimulatorStats.ulBlocksReordered,
+                       xSimulatorStats.ulBlocksDuplicated,
+                       xSimulatorStats.ulMessagesDelivered,
+                       xSimulatorStats.ulOverflows ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 ) */
+
 static void setOtaInterfaces( OtaInterfaces_t * pOtaInterfaces )
 {
     configASSERT( pOtaInterfaces != NULL );
@@ -1011,20 +1144,30 @@ static void setOtaInterfaces( OtaInterfaces_t * pOtaInterfaces )
     pOtaInterfaces->os.timer.start = OtaStartTimer_FreeRTOS;
     pOtaInterfaces->os.timer.stop = OtaStopTimer_FreeRTOS;
     pOtaInterfaces->os.timer.delete = OtaDeleteTimer_FreeRTOS;
-    pOtaInterfaces->os.mem.malloc = Malloc_FreeRTOS;
-    pOtaInterfaces->os.mem.free = Free_FreeRTOS;
+    pOtaInterfaces->os.mem.malloc = prvOTAMalloc;
+    pOtaInterfaces->os.mem.free = prvOTAFree;
 
     /* Initialize the OTA library MQTT Interface.*/
-    pOtaInterfaces->mqtt.subscribe = prvMQTTSubscribe;
-    pOtaInterfaces->mqtt.publish = prvMQTTPublish;
-    pOtaInterfaces->mqtt.unsubscribe = prvMQTTUnsubscribe;
+    #if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+        pOtaInterfaces->mqtt.subscribe = eOtaSimulatorSubscribe;
+        pOtaInterfaces->mqtt.publish = eOtaSimulatorPublish;
+        pOtaInterfaces->mqtt.unsubscribe = eOtaSimulatorUnsubscribe;
+    #else
+        pOtaInterfaces->mqtt.subscribe = prvMQTTSubscribe;
+        pOtaInterfaces->mqtt.publish = prvMQTTPublish;
+        pOtaInterfaces->mqtt.unsubscribe = prvMQTTUnsubscribe;
+    #endif
 
     /* Initialize the OTA library PAL Interface.*/
     pOtaInterfaces->pal.getPlatformImageState = otaPal_GetPlatformImageState;
     pOtaInterfaces->pal.setPlatformImageState = otaPal_SetPlatformImageState;
     pOtaInterfaces->pal.writeBlock = otaPal_WriteBlock;
     pOtaInterfaces->pal.activate = otaPal_ActivateNewImage;
-    pOtaInterfaces->pal.closeFile = otaPal_CloseFile;
+    #if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+        pOtaInterfaces->pal.closeFile = prvTimedCloseFile;
+    #else
+        pOtaInterfaces->pal.closeFile = otaPal_CloseFile;
+    #endif
     pOtaInterfaces->pal.reset = otaPal_ResetDevice;
     pOtaInterfaces->pal.abort = otaPal_Abort;
     pOtaInterfaces->pal.createFile = otaPal_CreateFileForRx;
@@ -1060,17 +1203,20 @@ static void prvOTADemoTask( void * pvParam )
                appFirmwareVersion.u.x.build ) );
     /****************************** Init OTA Library. ******************************/
 
-    xBufferSemaphore = xSemaphoreCreateMutex();
+    objectpoolINIT( xEventBufferPool, "ota events", pdFALSE );
 
-    if( xBufferSemaphore == NULL )
-    {
-        xResult = pdFAIL;
-    }
+    #if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+        if( xResult == pdPASS )
+        {
+            if( eOtaSimulatorInit( prvProcessSimulatedMessage, NULL ) != eOtaSimulatorSuccess )
+            {
+                xResult = pdFAIL;
+            }
+        }
+    #endif
 
     if( xResult == pdPASS )
     {
-        memset( eventBuffer, 0x00, sizeof( eventBuffer ) );
-
         if( ( otaRet = OTA_Init( &otaBuffer,
                                  &otaInterfaces,
                                  ( const uint8_t * ) ( democonfigCLIENT_IDENTIFIER ),
@@ -1102,6 +1248,9 @@ static void prvOTADemoTask( void * pvParam )
     if( xResult == pdPASS )
     {
         /* Start the OTA Agent.*/
+        #if ( democonfigOTA_USE_STREAM_SIMULATOR == 1 )
+            xBenchmarkStartTime = xTaskGetTickCount();
+        #endif
         eventMsg.eventId = OtaAgentEventStart;
         OTA_SignalEvent( &eventMsg );
 
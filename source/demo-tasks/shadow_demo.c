@@ -36,6 +36,9 @@
  * shadow. This serves to create events for the first task to react to for demonstration purposes.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleShadow
+
 /* Kernel includes. */
 #include "FreeRTOS.h"
 #include "task.h"
@@ -33,18 +33,28 @@
  * This example assumes there is a powerOn state in the device shadow. It does the
  * following operations:
  * 1. Assemble strings for the MQTT topics of device shadow, by using macros defined by the Device Shadow library.
- * 2. Subscribe to those MQTT topics using the MQTT Agent.
- * 3. Register callbacks for incoming shadow topic publishes with the subsciption_manager.
- * 3. Publish to report the current state of powerOn.
- * 5. Check if powerOn has been changed and send an update if so.
- * 6. If a publish to update reported state was sent, wait until either prvIncomingPublishUpdateAcceptedCallback
- *    or prvIncomingPublishUpdateRejectedCallback handle the response.
- * 7. Wait until time for next check and repeat from step 5.
+ * 2. Register a handler for the classic shadow with the shadow service, which subscribes to the
+ *    response topics of every shadow of the thing with one SUBSCRIBE using wildcard filters.
+ * 3. Route the messages the service passes to the handler to the callback for their topic.
+ * 4. Publish to report the current state of powerOn.
+ * 5. Apply any desired state received in a delta to the device, and once the
+ *    local changes have been coalesced for shadowexampleMS_COALESCING_WINDOW, send
+ *    an update containing only the properties that differ from the last accepted
+ *    reported state.
+ * 6. Record each update in a request table keyed on its client token, without
+ *    waiting for the response. prvIncomingPublishUpdateAcceptedCallback and
+ *    prvIncomingPublishUpdateRejectedCallback pass responses to the table, which
+ *    calls prvReportCompleteCallback for the matching update.
+ * 7. Wait until a delta or response arrives, the coalescing window closes or an
+ *    update times out, and repeat from step 5.
  *
  * Meanwhile, when prvIncomingPublishUpdateDeltaCallback receives changes to the shadow state,
- * it will apply them on the device.
+ * it records them in the local shadow cache and wakes the task to apply them.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleShadow
+
 /* Standard includes. */
 #include <stdlib.h>
 #include <string.h>
@@ -60,11 +70,21 @@
 /* MQTT library includes. */
 #include "core_mqtt_agent.h"
 
-/* Subscription manager header include. */
-#include "subscription_manager.h"
-
 /* JSON library includes. */
 #include "core_json.h"
+#include "json_extractor.h"
+
+/* Shadow cache include. */
+#include "shadow_cache.h"
+
+/* Shadow schema include. */
+#include "shadow_schema.h"
+
+/* Shadow request table include. */
+#include "shadow_request_table.h"
+
+/* Shadow service include. */
+#include "shadow_service.h"
 
 /* Shadow API header. */
 #include "shadow.h"
@@ -77,9 +97,10 @@
 #endif
 
 /**
- * @brief Format string representing a Shadow document with a "reported" state.
+ * @brief Size of the buffer holding a reported state update.
  *
- * The real json document will look like this:
+ * The update will look like this, with only the properties that changed since
+ * the last accepted update:
  * {
  *   "state": {
  *     "reported": {
@@ -91,47 +112,41 @@
  *
  * Note the client token, which is optional. The token is used to identify the
  * response to an update. The client token must be unique at any given time,
- * but may be reused once the update is completed. For this demo, a timestamp
- * is used for a client token.
+ * but may be reused once the update is completed. For this demo, the token is
+ * issued by the shadow request table the update is recorded in.
  */
-#define shadowexampleSHADOW_REPORTED_JSON \
-    "{"                                   \
-    "\"state\":{"                         \
-    "\"reported\":{"                      \
-    "\"powerOn\":%1u"                     \
-    "}"                                   \
-    "},"                                  \
-    "\"clientToken\":\"%06lu\""           \
-    "}"
+#define shadowexampleUPDATE_DOCUMENT_LENGTH            ( 128U )
 
 /**
- * @brief The expected size of #SHADOW_REPORTED_JSON.
- *
- * Since all of the format specifiers in #SHADOW_REPORTED_JSON include a length,
- * its actual size can be precalculated at compile time from the difference between
- * the lengths of the format strings and their formatted output. We must subtract 2
- * from the length as according the following formula:
- * 1. The length of the format string "%1u" is 3.
- * 2. The length of the format string "%06lu" is 5.
- * 3. The formatted length in case 1. is 1 ( for the state of powerOn ).
- * 4. The formatted length in case 2. is 6 ( for the clientToken length ).
- * 5. Thus the additional size of our format is 2 = 3 + 5 - 1 - 6 + 1 (termination character).
- *
- * Custom applications may calculate the length of the JSON document with the same method.
+ * @brief Longest time in ms the task sleeps when there is nothing to report.
+ * The task pings the broker each time it wakes with nothing to report.
  */
-#define shadowexampleSHADOW_REPORTED_JSON_LENGTH       ( sizeof( shadowexampleSHADOW_REPORTED_JSON ) - 2 )
+#define shadowexampleMS_BETWEEN_REPORTS                ( 15000U )
 
 /**
- * @brief Time in ms to wait between checking for updates to report.
+ * @brief Time in ms local changes are collected before they are reported.
+ * Changes made within the window are sent in a single update, and changes that
+ * are reverted within it are not sent at all.
  */
-#define shadowexampleMS_BETWEEN_REPORTS                ( 15000U )
+#define shadowexampleMS_COALESCING_WINDOW              ( 1000U )
+
+/**
+ * @brief Index of the powerOn property in #xShadowProperties.
+ */
+#define shadowexamplePOWER_ON_PROPERTY                 ( ShadowSchemaIndex_powerOn )
 
 /**
- * @brief This demo uses task notifications to signal tasks from MQTT callback
- * functions. shadowexampleMS_TO_WAIT_FOR_NOTIFICATION defines the time, in ticks,
- * to wait for such a callback.
+ * @brief Time in ms to wait for the response to a reported state update before
+ * it times out.
  */
-#define shadowexampleMS_TO_WAIT_FOR_NOTIFICATION       ( 5000 )
+#define shadowexampleMS_TO_WAIT_FOR_RESPONSE           ( 5000U )
+
+/**
+ * @brief Identifier of this task's shadow request table.  It must differ from
+ * the identifier used by the shadow update task, as both tasks receive the
+ * responses to each other's updates.
+ */
+#define shadowexampleREQUEST_TABLE_ID                  ( 1U )
 
 /**
  * @brief The maximum amount of time in milliseconds to wait for the commands
@@ -141,41 +156,37 @@
 #define shadowexampleMAX_COMMAND_SEND_BLOCK_TIME_MS    ( 200 )
 
 /**
- * @brief An invalid value for the powerOn state. This is used to set the last
- * reported state to a value that will not match the current state. As we only
- * set the powerOn state to 0 or 1, any other value will suffice.
+ * @brief Number of times each sample shadow document is parsed when comparing
+ * eJsonExtract() with JSON_Validate() followed by one JSON_Search() per key.
+ * The comparison runs once when the task starts.  Set to 0 to disable the
+ * comparison.
  */
-#define shadowexampleINVALID_POWERON_STATE             ( 2 )
-
-/**
- * @brief Defines the structure to use as the command callback context in this
- * demo.
- */
-struct MQTTAgentCommandContext
-{
-    bool xReturnStatus;
-};
+#define shadowexampleJSON_BENCHMARK_ITERATIONS         ( 0U )
 
 extern MQTTAgentContext_t xGlobalMqttAgentContext;
 
 /*-----------------------------------------------------------*/
 
 /**
- * @brief The simulated device current power on state.
+ * @brief The properties of the simulated device held in the shadow, generated
+ * from the list in shadow_schema_config.h.
  */
-static uint32_t ulCurrentPowerOnState = 0;
+static const ShadowCacheProperty_t xShadowProperties[] =
+{
+    shadowschemaPROPERTIES( shadowschemaCACHE_PROPERTY )
+};
 
 /**
- * @brief The last reported state. It is initialized to an invalid value so that
- * an update is initially sent.
+ * @brief Local copy of the simulated device's shadow.  It holds the device's
+ * current state, the desired state received in deltas and the last reported
+ * state accepted by the Device Shadow service.
  */
-static uint32_t ulReportedPowerOnState = shadowexampleINVALID_POWERON_STATE;
+static ShadowCache_t xShadowCache;
 
 /**
- * @brief Match the received clientToken with the one sent in a device shadow
- * update. Set to 0 when not waiting on a response.
+ * @brief The updates waiting for a response, keyed on their client token.
  */
-static uint32_t ulClientToken = 0U;
+static ShadowRequestTable_t xShadowRequests;
 
 /**
  * @brief The handle of this task. It is used by callbacks to notify this task.
@@ -185,34 +196,21 @@ static TaskHandle_t xShadowDeviceTaskHandle;
 /*-----------------------------------------------------------*/
 
 /**
- * @brief Subscribe to the used device shadow topics.
- *
- * @return true if the subscribe is successful;
- * false otherwise.
- */
-static bool prvSubscribeToShadowUpdateTopics( void );
-
-/**
- * @brief Passed into MQTTAgent_Subscribe() as the callback to execute when the
- * broker ACKs the SUBSCRIBE message. Its implementation sends a notification
- * to the task that called MQTTAgent_Subscribe() to let the task know the
- * SUBSCRIBE operation completed. It also sets the xReturnStatus of the
- * structure passed in as the command's context to the value of the
- * xReturnStatus parameter - which enables the task to check the status of the
- * operation.
- *
- * See https://freertos.org/mqtt/mqtt-agent-demo.html#example_mqtt_api_call
+ * @brief The handler registered with the shadow service for the classic
+ * shadow.  It passes each message to the callback for its topic.
  *
- * @param[in] pxCommandContext Context of the initial command.
- * @param[in] pxReturnInfo The result of the command.
+ * @param[in] pvContext Unused.
+ * @param[in] eMessageType The kind of message.
+ * @param[in] pxPublishInfo Deserialized publish.
  */
-static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
-                                         MQTTAgentReturnInfo_t * pxReturnInfo );
+static void prvShadowMessageCallback( void * pvContext,
+                                      ShadowMessageType_t eMessageType,
+                                      MQTTPublishInfo_t * pxPublishInfo );
 
 /**
  * @brief The callback to execute when there is an incoming publish on the
- * topic for delta updates. It verifies the document and sets the
- * powerOn state accordingly.
+ * topic for delta updates. It records the desired state in the shadow cache
+ * and notifies the task to apply it.
  *
  * @param[in] pvIncomingPublishCallbackContext Context of the initial command.
  * @param[in] pxPublishInfo Deserialized publish.
@@ -222,9 +220,8 @@ static void prvIncomingPublishUpdateDeltaCallback( void * pxSubscriptionContext,
 
 /**
  * @brief The callback to execute when there is an incoming publish on the
- * topic for accepted requests. It verifies the document is valid and is being waited on.
- * If so it updates the last reported state and notifies the task to inform completion
- * of the update request.
+ * topic for accepted requests. It passes the response to the request table,
+ * which completes the update the response belongs to, if it is one of ours.
  *
  * @param[in] pvIncomingPublishCallbackContext Context of the initial command.
  * @param[in] pxPublishInfo Deserialized publish.
@@ -235,8 +232,8 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
 
 /**
  * @brief The callback to execute when there is an incoming publish on the
- * topic for rejected requests. It verifies the document is valid and is being waited on.
- * If so it notifies the task to inform completion of the update request.
+ * topic for rejected requests. It passes the response to the request table,
+ * which completes the update the response belongs to, if it is one of ours.
  *
  * @param[in] pvIncomingPublishCallbackContext Context of the initial command.
  * @param[in] pxPublishInfo Deserialized publish.
@@ -244,18 +241,62 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
 static void prvIncomingPublishUpdateRejectedCallback( void * pxSubscriptionContext,
                                                       MQTTPublishInfo_t * pxPublishInfo );
 
+#if ( shadowexampleJSON_BENCHMARK_ITERATIONS > 0 )
+
+/**
+ * @brief Compare the time taken to validate a document and extract a list of
+ * keys from it using eJsonExtract() and using JSON_Validate() followed by one
+ * JSON_Search() per key, and check both find the same values.
+ *
+ * @param[in] pcName Name of the document used in the log.
+ * @param[in] pcDocument The document, NULL terminated.
+ * @param[in] pxKeys The keys to extract.
+ * @param[in] xKeyCount Number of entries in pxKeys.
+ */
+    static void prvBenchmarkJsonDocument( const char * pcName,
+                                          const char * pcDocument,
+                                          JsonExtractorKey_t * pxKeys,
+                                          size_t xKeyCount );
+
+/**
+ * @brief Run prvBenchmarkJsonDocument() on sample documents like those
+ * received on the /update/delta, /update/accepted and /update/rejected topics.
+ */
+    static void prvBenchmarkJsonExtraction( void );
+
+#endif /* if ( shadowexampleJSON_BENCHMARK_ITERATIONS > 0 ) */
+
+/**
+ * @brief Called by the request table when an update is accepted, rejected or
+ * times out.  It records the outcome in the shadow cache and notifies the task
+ * so that any properties still to be reported are sent.
+ *
+ * @param[in] pvContext Unused.
+ * @param[in] ulClientToken The client token of the update.
+ * @param[in] eType The kind of request, always #ShadowRequestUpdate.
+ * @param[in] pxResponse The response.
+ */
+static void prvReportCompleteCallback( void * pvContext,
+                                       uint32_t ulClientToken,
+                                       ShadowRequestType_t eType,
+                                       const ShadowResponse_t * pxResponse );
+
+/**
+ * @brief Simulate the device applying the desired state received in deltas,
+ * by setting its current state in the shadow cache to the desired state.
+ */
+static void prvApplyDesiredState( void );
+
 /**
  * @brief Entry point of shadow demo.
  *
  * This main function demonstrates how to use the macros provided by the
  * Device Shadow library to assemble strings for the MQTT topics defined
- * by AWS IoT Device Shadow. It uses these macros for topics to subscribe
- * to:
- * - SHADOW_TOPIC_STRING_UPDATE_DELTA for "$aws/things/thingName/shadow/update/delta"
- * - SHADOW_TOPIC_STRING_UPDATE_ACCEPTED for "$aws/things/thingName/shadow/update/accepted"
- * - SHADOW_TOPIC_STRING_UPDATE_REJECTED for "$aws/things/thingName/shadow/update/rejected"
+ * by AWS IoT Device Shadow. The topics it receives messages on, such as
+ * "$aws/things/thingName/shadow/update/accepted", are subscribed to by the
+ * shadow service with the wildcard filter "$aws/things/thingName/shadow/+/+".
  *
- * It also uses these macros for topics to publish to:
+ * It uses these macros for topics to publish to:
  * - SHADOW_TOPIC_STIRNG_DELETE for "$aws/things/thingName/shadow/delete"
  * - SHADOW_TOPIC_STRING_UPDATE for "$aws/things/thingName/shadow/update"
  */
@@ -263,138 +304,30 @@ void vShadowDeviceTask( void * pvParameters );
 
 /*-----------------------------------------------------------*/
 
-static bool prvSubscribeToShadowUpdateTopics( void )
+static void prvShadowMessageCallback( void * pvContext,
+                                      ShadowMessageType_t eMessageType,
+                                      MQTTPublishInfo_t * pxPublishInfo )
 {
-    bool xReturnStatus = false;
-    MQTTStatus_t xStatus;
-    uint32_t ulNotificationValue;
-    MQTTAgentCommandInfo_t xCommandParams = { 0 };
-
-    /* These must persist until the command is processed. */
-    MQTTAgentSubscribeArgs_t xSubscribeArgs = { 0 };
-    MQTTSubscribeInfo_t xSubscribeInfo[ 3 ];
-    MQTTAgentCommandContext_t xApplicationDefinedContext = { 0 };
-
-    /* Subscribe to shadow topic for responses for incoming delta updates. */
-    xSubscribeInfo[ 0 ].pTopicFilter = SHADOW_TOPIC_STRING_UPDATE_DELTA( democonfigCLIENT_IDENTIFIER );
-    xSubscribeInfo[ 0 ].topicFilterLength = SHADOW_TOPIC_LENGTH_UPDATE_DELTA( democonfigCLIENT_IDENTIFIER_LENGTH );
-    xSubscribeInfo[ 0 ].qos = MQTTQoS1;
-    /* Subscribe to shadow topic for accepted responses for submitted updates. */
-    xSubscribeInfo[ 1 ].pTopicFilter = SHADOW_TOPIC_STRING_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER );
-    xSubscribeInfo[ 1 ].topicFilterLength = SHADOW_TOPIC_LENGTH_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH );
-    xSubscribeInfo[ 1 ].qos = MQTTQoS1;
-    /* Subscribe to shadow topic for rejected responses for submitted updates. */
-    xSubscribeInfo[ 2 ].pTopicFilter = SHADOW_TOPIC_STRING_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER );
-    xSubscribeInfo[ 2 ].topicFilterLength = SHADOW_TOPIC_LENGTH_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH );
-    xSubscribeInfo[ 2 ].qos = MQTTQoS1;
-
-    /* Complete the subscribe information. The topic string must persist for
-     * duration of subscription - although in this case it is a static const so
-     * will persist for the lifetime of the application. */
-    xSubscribeArgs.pSubscribeInfo = xSubscribeInfo;
-    xSubscribeArgs.numSubscriptions = 3;
-
-    /* Loop in case the queue used to communicate with the MQTT agent is full and
-     * attempts to post to it time out.  The queue will not become full if the
-     * priority of the MQTT agent task is higher than the priority of the task
-     * calling this function. */
-    xTaskNotifyStateClear( NULL );
-    xCommandParams.blockTimeMs = shadowexampleMAX_COMMAND_SEND_BLOCK_TIME_MS;
-    xCommandParams.cmdCompleteCallback = prvSubscribeCommandCallback;
-    xCommandParams.pCmdCompleteCallbackContext = &xApplicationDefinedContext;
-    LogInfo( ( "Sending subscribe request to agent for shadow topics." ) );
+    /* Remove compiler warnings about unused parameters. */
+    ( void ) pvContext;
 
-    do
+    if( eMessageType == ShadowMessageTypeUpdateDelta )
     {
-        /* If this fails, the agent's queue is full, so we retry until the agent
-         * has more space in the queue. */
-        xStatus = MQTTAgent_Subscribe( &xGlobalMqttAgentContext,
-                                       &( xSubscribeArgs ),
-                                       &xCommandParams );
-    } while( xStatus != MQTTSuccess );
-
-    /* Wait for acks from subscribe messages - this is optional.  If the
-     * returned value is zero then the wait timed out. */
-    ulNotificationValue = ulTaskNotifyTake( pdFALSE, pdMS_TO_TICKS( shadowexampleMS_TO_WAIT_FOR_NOTIFICATION ) );
-    configASSERT( ulNotificationValue != 0UL );
-
-    /* The callback sets the xReturnStatus member of the context. */
-    if( xApplicationDefinedContext.xReturnStatus != true )
-    {
-        LogError( ( "Failed to subscribe to shadow update topics." ) );
+        prvIncomingPublishUpdateDeltaCallback( NULL, pxPublishInfo );
     }
-    else
+    else if( eMessageType == ShadowMessageTypeUpdateAccepted )
     {
-        LogInfo( ( "Successfully subscribed to shadow update topics." ) );
-        xReturnStatus = true;
+        prvIncomingPublishUpdateAcceptedCallback( NULL, pxPublishInfo );
     }
-
-    return xReturnStatus;
-}
-
-/*-----------------------------------------------------------*/
-
-static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
-                                         MQTTAgentReturnInfo_t * pxReturnInfo )
-{
-    bool xSuccess = false;
-
-    /* Check if the subscribe operation is a success. */
-    if( pxReturnInfo->returnCode == MQTTSuccess )
+    else if( eMessageType == ShadowMessageTypeUpdateRejected )
     {
-        /* Add subscriptions so that incoming publishes are routed to the application
-         * callback. */
-        xSuccess = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
-                                    SHADOW_TOPIC_STRING_UPDATE_DELTA( democonfigCLIENT_IDENTIFIER ),
-                                    SHADOW_TOPIC_LENGTH_UPDATE_DELTA( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                                    prvIncomingPublishUpdateDeltaCallback,
-                                    NULL );
-
-        if( xSuccess == false )
-        {
-            LogError( ( "Failed to register an incoming publish callback for topic %.*s.",
-                        SHADOW_TOPIC_LENGTH_UPDATE_DELTA( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                        SHADOW_TOPIC_STRING_UPDATE_DELTA( democonfigCLIENT_IDENTIFIER ) ) );
-        }
-    }
-
-    if( xSuccess == true )
-    {
-        xSuccess = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
-                                    SHADOW_TOPIC_STRING_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER ),
-                                    SHADOW_TOPIC_LENGTH_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                                    prvIncomingPublishUpdateAcceptedCallback,
-                                    NULL );
-
-        if( xSuccess == false )
-        {
-            LogError( ( "Failed to register an incoming publish callback for topic %.*s.",
-                        SHADOW_TOPIC_LENGTH_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                        SHADOW_TOPIC_STRING_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER ) ) );
-        }
+        prvIncomingPublishUpdateRejectedCallback( NULL, pxPublishInfo );
     }
-
-    if( xSuccess == true )
+    else
     {
-        xSuccess = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
-                                    SHADOW_TOPIC_STRING_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER ),
-                                    SHADOW_TOPIC_LENGTH_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                                    prvIncomingPublishUpdateRejectedCallback,
-                                    NULL );
-
-        if( xSuccess == false )
-        {
-            LogError( ( "Failed to register an incoming publish callback for topic %.*s.",
-                        SHADOW_TOPIC_LENGTH_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                        SHADOW_TOPIC_STRING_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER ) ) );
-        }
+        /* Responses to get and delete requests, and update documents, are
+         * not used by this task. */
     }
-
-    /* Store the result in the application defined context so the calling task
-     * can check it. */
-    pxCommandContext->xReturnStatus = xSuccess;
-
-    xTaskNotifyGive( xShadowDeviceTaskHandle );
 }
 
 /*-----------------------------------------------------------*/
@@ -402,12 +335,10 @@ static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandCo
 static void prvIncomingPublishUpdateDeltaCallback( void * pxSubscriptionContext,
                                                    MQTTPublishInfo_t * pxPublishInfo )
 {
-    static uint32_t ulCurrentVersion = 0; /* Remember the latest version number we've received */
-    uint32_t ulVersion = 0UL;
-    uint32_t ulNewState = 0UL;
-    char * pcOutValue = NULL;
-    uint32_t ulOutValueLength = 0UL;
-    JSONStatus_t result = JSONSuccess;
+    eShadowCacheStatus eCacheStatus;
+    ShadowSchemaState_t xDesiredState;
+    uint32_t pulDesiredValues[ ShadowSchemaPropertyCount ];
+    uint32_t ulChangedMask = 0UL, ulPresentMask = 0UL, ulVersion = 0UL;
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pxSubscriptionContext;
@@ -435,78 +366,47 @@ static void prvIncomingPublishUpdateDeltaCallback( void * pxSubscriptionContext,
      *  }
      */
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pxPublishInfo->pPayload,
-                            pxPublishInfo->payloadLength );
-
-    if( result != JSONSuccess )
+    /* Extract the version and every property of the schema in one pass over
+     * the delta, then record the desired state of the properties found.  The
+     * cache discards deltas with a version that is not newer than the latest
+     * one received.  In this demo, we discard such messages; your application
+     * may use a different approach. */
+    if( eShadowSchemaParseDelta( pxPublishInfo->pPayload,
+                                 pxPublishInfo->payloadLength,
+                                 &xDesiredState,
+                                 &ulPresentMask,
+                                 &ulVersion ) != eShadowSchemaSuccess )
     {
-        LogError( ( "Invalid JSON document recieved!" ) );
+        eCacheStatus = eShadowCacheInvalidDocument;
     }
     else
     {
-        /* Obtain the version value. */
-        result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                              pxPublishInfo->payloadLength,
-                              "version",
-                              sizeof( "version" ) - 1,
-                              &pcOutValue,
-                              ( size_t * ) &ulOutValueLength );
-
-        if( result != JSONSuccess )
-        {
-            LogError( ( "Version field not found in JSON document!" ) );
-        }
-        else
-        {
-            /* Convert the extracted value to an unsigned integer value. */
-            ulVersion = ( uint32_t ) strtoul( pcOutValue, NULL, 10 );
+        vShadowSchemaGetValues( &xDesiredState, pulDesiredValues );
+        eCacheStatus = eShadowCacheApplyDesired( &xShadowCache,
+                                                 ulVersion,
+                                                 pulDesiredValues,
+                                                 ulPresentMask,
+                                                 &ulChangedMask );
+    }
 
-            /* Make sure the version is newer than the last one we received. */
-            if( ulVersion <= ulCurrentVersion )
-            {
-                /* In this demo, we discard the incoming message
-                 * if the version number is not newer than the latest
-                 * that we've received before. Your application may use a
-                 * different approach.
-                 */
-                LogWarn( ( "Recieved unexpected delta update with version %u. Current version is %u",
-                           ( unsigned int ) ulVersion,
-                           ( unsigned int ) ulCurrentVersion ) );
-            }
-            else
-            {
-                LogInfo( ( "Recieved delta update with version %.*s.",
-                           ulOutValueLength,
-                           pcOutValue ) );
-
-                /* Set received version as the current version. */
-                ulCurrentVersion = ulVersion;
-
-                /* Get powerOn state from json documents. */
-                result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                                      pxPublishInfo->payloadLength,
-                                      "state.powerOn",
-                                      sizeof( "state.powerOn" ) - 1,
-                                      &pcOutValue,
-                                      ( size_t * ) &ulOutValueLength );
-
-                if( result != JSONSuccess )
-                {
-                    LogError( ( "powerOn field not found in JSON document!" ) );
-                }
-                else
-                {
-                    /* Convert the powerOn state value to an unsigned integer value. */
-                    ulNewState = ( uint32_t ) strtoul( pcOutValue, NULL, 10 );
+    if( eCacheStatus == eShadowCacheStaleVersion )
+    {
+        LogWarn( ( "Recieved unexpected delta update with an old version." ) );
+    }
+    else if( eCacheStatus != eShadowCacheSuccess )
+    {
+        LogError( ( "Invalid delta document recieved!" ) );
+    }
+    else if( ulChangedMask != 0UL )
+    {
+        LogInfo( ( "Recieved delta update." ) );
 
-                    LogInfo( ( "Setting powerOn state to %u.",
-                               ( unsigned int ) ulNewState ) );
-                    /* Set the new powerOn state. */
-                    ulCurrentPowerOnState = ulNewState;
-                }
-            }
-        }
+        /* Wake up the shadow task to apply the desired state. */
+        xTaskNotifyGive( xShadowDeviceTaskHandle );
+    }
+    else
+    {
+        LogDebug( ( "Ignoring delta update with no known properties." ) );
     }
 }
 
@@ -515,10 +415,7 @@ static void prvIncomingPublishUpdateDeltaCallback( void * pxSubscriptionContext,
 static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionContext,
                                                       MQTTPublishInfo_t * pxPublishInfo )
 {
-    char * pcOutValue = NULL;
-    uint32_t ulOutValueLength = 0UL;
-    uint32_t ulReceivedToken = 0UL;
-    JSONStatus_t result = JSONSuccess;
+    eShadowRequestStatus eStatus;
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pxSubscriptionContext;
@@ -531,8 +428,9 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
                 ( const char * ) pxPublishInfo->pPayload ) );
 
     /* Handle the reported state with state change in /update/accepted topic.
-     * Thus we will retrieve the client token from the JSON document to see if
-     * it's the same one we sent with reported state on the /update topic.
+     * The request table retrieves the client token from the JSON document and
+     * completes the update we sent with that token on the /update topic, if
+     * it is still waiting for a response.
      * The payload will look similar to this:
      *  {
      *      "state": {
@@ -552,70 +450,24 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
      *      "clientToken": "022485"
      *  }
      */
+    eStatus = eShadowRequestHandleResponse( &xShadowRequests,
+                                            ShadowRequestAccepted,
+                                            pxPublishInfo->pPayload,
+                                            pxPublishInfo->payloadLength );
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pxPublishInfo->pPayload,
-                            pxPublishInfo->payloadLength );
-
-    if( result != JSONSuccess )
+    if( eStatus == eShadowRequestInvalidDocument )
     {
         LogError( ( "Invalid JSON document recieved!" ) );
     }
-    else
-    {
-        /* Get clientToken from json documents. */
-        result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                              pxPublishInfo->payloadLength,
-                              "clientToken",
-                              sizeof( "clientToken" ) - 1,
-                              &pcOutValue,
-                              ( size_t * ) &ulOutValueLength );
-    }
-
-    if( result != JSONSuccess )
+    else if( eStatus == eShadowRequestNotFound )
     {
-        LogDebug( ( "Ignoring publish on /update/accepted with no clientToken field." ) );
+        /* The response is for the other shadow task, or arrived after we
+         * timed out waiting for it. */
+        LogDebug( ( "Ignoring publish on /update/accepted for an update that is not waiting for a response." ) );
     }
     else
     {
-        /* Convert the code to an unsigned integer value. */
-        ulReceivedToken = ( uint32_t ) strtoul( pcOutValue, NULL, 10 );
-
-        /* If we are waiting for a response, ulClientToken will be the token for the response
-         * we are waiting for, else it will be 0. ulRecievedToken may not match if the response is
-         * not for us or if it is is a response that arrived after we timed out
-         * waiting for it.
-         */
-        if( ulReceivedToken != ulClientToken )
-        {
-            LogDebug( ( "Ignoring publish on /update/accepted with clientToken %lu.", ( unsigned long ) ulReceivedToken ) );
-        }
-        else
-        {
-            LogInfo( ( "Received accepted response for update with token %lu. ", ( unsigned long ) ulClientToken ) );
-
-            /*  Obtain the accepted state from the response and update our last sent state. */
-            result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                                  pxPublishInfo->payloadLength,
-                                  "state.reported.powerOn",
-                                  sizeof( "state.reported.powerOn" ) - 1,
-                                  &pcOutValue,
-                                  ( size_t * ) &ulOutValueLength );
-
-            if( result != JSONSuccess )
-            {
-                LogError( ( "powerOn field not found in JSON document!" ) );
-            }
-            else
-            {
-                /* Convert the powerOn state value to an unsigned integer value and
-                 * save the new last reported value*/
-                ulReportedPowerOnState = ( uint32_t ) strtoul( pcOutValue, NULL, 10 );
-            }
-
-            /* Wake up the shadow task which is waiting for this response. */
-            xTaskNotifyGive( xShadowDeviceTaskHandle );
-        }
+        /* The update was completed by prvReportCompleteCallback. */
     }
 }
 
@@ -624,10 +476,7 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
 static void prvIncomingPublishUpdateRejectedCallback( void * pxSubscriptionContext,
                                                       MQTTPublishInfo_t * pxPublishInfo )
 {
-    JSONStatus_t result = JSONSuccess;
-    char * pcOutValue = NULL;
-    uint32_t ulOutValueLength = 0UL;
-    uint32_t ulReceivedToken = 0UL;
+    eShadowRequestStatus eStatus;
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pxSubscriptionContext;
@@ -647,84 +496,225 @@ static void prvIncomingPublishUpdateRejectedCallback( void * pxSubscriptionConte
      *    "clientToken": "token"
      * }
      */
+    eStatus = eShadowRequestHandleResponse( &xShadowRequests,
+                                            ShadowRequestRejected,
+                                            pxPublishInfo->pPayload,
+                                            pxPublishInfo->payloadLength );
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pxPublishInfo->pPayload,
-                            pxPublishInfo->payloadLength );
-
-    if( result != JSONSuccess )
+    if( eStatus == eShadowRequestInvalidDocument )
     {
         LogError( ( "Invalid JSON document recieved!" ) );
     }
+    else if( eStatus == eShadowRequestNotFound )
+    {
+        LogDebug( ( "Ignoring publish on /update/rejected for an update that is not waiting for a response." ) );
+    }
     else
     {
-        /* Get clientToken from json documents. */
-        result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                              pxPublishInfo->payloadLength,
-                              "clientToken",
-                              sizeof( "clientToken" ) - 1,
-                              &pcOutValue,
-                              ( size_t * ) &ulOutValueLength );
+        /* The update was completed by prvReportCompleteCallback. */
     }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvReportCompleteCallback( void * pvContext,
+                                       uint32_t ulClientToken,
+                                       ShadowRequestType_t eType,
+                                       const ShadowResponse_t * pxResponse )
+{
+    /* Remove compiler warnings about unused parameters. */
+    ( void ) pvContext;
+    ( void ) eType;
+
+    configASSERT( pxResponse != NULL );
+
+    if( pxResponse->eResult == ShadowRequestAccepted )
+    {
+        LogInfo( ( "Received accepted response for update with token %lu. ", ( unsigned long ) ulClientToken ) );
 
-    if( result != JSONSuccess )
+        /* The reported state in the update is now the last accepted
+         * reported state. */
+        vShadowCacheUpdateAccepted( &xShadowCache, pxResponse->ulVersion );
+    }
+    else if( pxResponse->eResult == ShadowRequestRejected )
     {
-        LogDebug( ( "Ignoring publish on /update/rejected with clientToken %lu.", ( unsigned long ) ulReceivedToken ) );
+        LogWarn( ( "Received rejected response for update with token %lu and error code %lu.",
+                   ( unsigned long ) ulClientToken,
+                   ( unsigned long ) pxResponse->ulErrorCode ) );
+
+        vShadowCacheUpdateRejected( &xShadowCache );
     }
     else
     {
-        /* Convert the code to an unsigned integer value. */
-        ulReceivedToken = ( uint32_t ) strtoul( pcOutValue, NULL, 10 );
-
-        /* If we are waiting for a response, ulClientToken will be the token for the response
-         * we are waiting for, else it will be 0. ulRecievedToken may not match if the response is
-         * not for us or if it is is a response that arrived after we timed out
-         * waiting for it.
-         */
-        if( ulReceivedToken != ulClientToken )
+        LogError( ( "Timed out waiting for response to update with token %lu.", ( unsigned long ) ulClientToken ) );
+
+        /* If we time out waiting for a response and then the report is accepted, the
+         * state may be out of sync. The cache forgets the reported state of the properties
+         * in the update so they are sent again. */
+        vShadowCacheUpdateTimedOut( &xShadowCache );
+    }
+
+    /* Wake up the shadow task so it can send any changes that were held back
+     * while the update was waiting for a response. */
+    xTaskNotifyGive( xShadowDeviceTaskHandle );
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvApplyDesiredState( void )
+{
+    uint32_t ulDesiredValue;
+
+    if( xShadowCacheTakeDesired( &xShadowCache, shadowexamplePOWER_ON_PROPERTY, &ulDesiredValue ) == true )
+    {
+        LogInfo( ( "Setting powerOn state to %u.",
+                   ( unsigned int ) ulDesiredValue ) );
+        vShadowCacheSetLocal( &xShadowCache, shadowexamplePOWER_ON_PROPERTY, ulDesiredValue );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#if ( shadowexampleJSON_BENCHMARK_ITERATIONS > 0 )
+
+    static void prvBenchmarkJsonDocument( const char * pcName,
+                                          const char * pcDocument,
+                                          JsonExtractorKey_t * pxKeys,
+                                          size_t xKeyCount )
+    {
+        size_t xDocumentLength = strlen( pcDocument );
+        eJsonExtractorStatus eExtractStatus = eJsonExtractorSuccess;
+        JSONStatus_t eSearchStatus = JSONSuccess;
+        char * pcValue = NULL;
+        size_t xValueLength = 0U;
+        bool xResultsMatch = true;
+        uint32_t i;
+        size_t j;
+        TickType_t xStartTime, xExtractTicks, xSearchTicks;
+
+        xStartTime = xTaskGetTickCount();
+
+        for( i = 0; ( ( i < shadowexampleJSON_BENCHMARK_ITERATIONS ) && ( eExtractStatus == eJsonExtractorSuccess ) ); i++ )
         {
-            LogDebug( ( "Ignoring publish on /update/rejected with clientToken %lu.", ( unsigned long ) ulReceivedToken ) );
+            eExtractStatus = eJsonExtract( pcDocument, xDocumentLength, pxKeys, xKeyCount );
         }
-        else
+
+        xExtractTicks = xTaskGetTickCount() - xStartTime;
+        xStartTime = xTaskGetTickCount();
+
+        for( i = 0; ( ( i < shadowexampleJSON_BENCHMARK_ITERATIONS ) && ( eSearchStatus == JSONSuccess ) ); i++ )
         {
-            /*  Obtain the error code. */
-            result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                                  pxPublishInfo->payloadLength,
-                                  "code",
-                                  sizeof( "code" ) - 1,
-                                  &pcOutValue,
-                                  ( size_t * ) &ulOutValueLength );
-
-            if( result != JSONSuccess )
-            {
-                LogWarn( ( "Received rejected response for update with token %lu and no error code.", ( unsigned long ) ulClientToken ) );
-            }
-            else
+            eSearchStatus = JSON_Validate( pcDocument, xDocumentLength );
+
+            for( j = 0; ( ( j < xKeyCount ) && ( eSearchStatus == JSONSuccess ) ); j++ )
             {
-                LogWarn( ( "Received rejected response for update with token %lu and error code %.*s.", ( unsigned long ) ulClientToken,
-                           ulOutValueLength,
-                           pcOutValue ) );
+                eSearchStatus = JSON_Search( ( char * ) pcDocument,
+                                             xDocumentLength,
+                                             pxKeys[ j ].pcKeyPath,
+                                             pxKeys[ j ].xKeyPathLength,
+                                             &pcValue,
+                                             &xValueLength );
+
+                /* Both approaches return pointers into the same document, so
+                 * the results match when the pointers and lengths match. */
+                if( ( eSearchStatus != JSONSuccess ) ||
+                    ( pcValue != pxKeys[ j ].pcValue ) ||
+                    ( xValueLength != pxKeys[ j ].xValueLength ) )
+                {
+                    xResultsMatch = false;
+                }
             }
+        }
+
+        xSearchTicks = xTaskGetTickCount() - xStartTime;
 
-            /* Wake up the shadow task which is waiting for this response. */
-            xTaskNotifyGive( xShadowDeviceTaskHandle );
+        if( ( eExtractStatus != eJsonExtractorSuccess ) || ( eSearchStatus != JSONSuccess ) || ( xResultsMatch == false ) )
+        {
+            LogError( ( "JSON extraction comparison failed for the %s document. "
+                        "Extractor status: %d, coreJSON status: %d, results match: %d.",
+                        pcName,
+                        eExtractStatus,
+                        eSearchStatus,
+                        xResultsMatch ) );
+        }
+        else
+        {
+            /* Time per document in microseconds, computed in 64 bits as the
+             * intermediate product overflows 32 bits after a few seconds. */
+            LogInfo( ( "JSON extraction of %u keys from the %u byte %s document over %u iterations: "
+                       "single pass %u us, validate and search %u us per document.",
+                       ( unsigned int ) xKeyCount,
+                       ( unsigned int ) xDocumentLength,
+                       pcName,
+                       ( unsigned int ) shadowexampleJSON_BENCHMARK_ITERATIONS,
+                       ( unsigned int ) ( ( ( uint64_t ) xExtractTicks * 1000000ULL ) /
+                                          ( ( uint64_t ) configTICK_RATE_HZ * shadowexampleJSON_BENCHMARK_ITERATIONS ) ),
+                       ( unsigned int ) ( ( ( uint64_t ) xSearchTicks * 1000000ULL ) /
+                                          ( ( uint64_t ) configTICK_RATE_HZ * shadowexampleJSON_BENCHMARK_ITERATIONS ) ) ) );
         }
     }
-}
+
+/*-----------------------------------------------------------*/
+
+    static void prvBenchmarkJsonExtraction( void )
+    {
+        /* A delta for a device reporting several properties, including the
+         * metadata the service adds for each of them. */
+        static const char pcDeltaDocument[] =
+            "{\"version\":2471,\"timestamp\":1596573647,"
+            "\"state\":{\"brightness\":80,\"colour\":\"warm white\",\"schedule\":{\"on\":\"07:00\",\"off\":\"23:30\"},\"powerOn\":1},"
+            "\"metadata\":{\"brightness\":{\"timestamp\":1596573647},\"colour\":{\"timestamp\":1596573647},"
+            "\"schedule\":{\"on\":{\"timestamp\":1596573640},\"off\":{\"timestamp\":1596573640}},\"powerOn\":{\"timestamp\":1596573647}},"
+            "\"clientToken\":\"388062\"}";
+        static const char pcAcceptedDocument[] =
+            "{\"state\":{\"reported\":{\"brightness\":80,\"colour\":\"warm white\",\"firmware\":\"1.4.2\","
+            "\"rssi\":-61,\"uptime\":86412,\"powerOn\":1}},"
+            "\"metadata\":{\"reported\":{\"brightness\":{\"timestamp\":1596573647},\"colour\":{\"timestamp\":1596573647},"
+            "\"firmware\":{\"timestamp\":1596573647},\"rssi\":{\"timestamp\":1596573647},\"uptime\":{\"timestamp\":1596573647},"
+            "\"powerOn\":{\"timestamp\":1596573647}}},"
+            "\"version\":14698,\"timestamp\":1596573647,\"clientToken\":\"022485\"}";
+        static const char pcRejectedDocument[] =
+            "{\"code\":409,\"message\":\"Version conflict\",\"timestamp\":1596573647,\"clientToken\":\"022485\"}";
+        JsonExtractorKey_t xDeltaKeys[ 2 ] =
+        {
+            jsonextractorKEY( "version" ),
+            jsonextractorKEY( "state.powerOn" )
+        };
+        JsonExtractorKey_t xAcceptedKeys[ 2 ] =
+        {
+            jsonextractorKEY( "clientToken" ),
+            jsonextractorKEY( "state.reported.powerOn" )
+        };
+        JsonExtractorKey_t xRejectedKeys[ 2 ] =
+        {
+            jsonextractorKEY( "clientToken" ),
+            jsonextractorKEY( "code" )
+        };
+
+        prvBenchmarkJsonDocument( "delta", pcDeltaDocument, xDeltaKeys, 2 );
+        prvBenchmarkJsonDocument( "accepted", pcAcceptedDocument, xAcceptedKeys, 2 );
+        prvBenchmarkJsonDocument( "rejected", pcRejectedDocument, xRejectedKeys, 2 );
+    }
+
+#endif /* if ( shadowexampleJSON_BENCHMARK_ITERATIONS > 0 ) */
 
 /*-----------------------------------------------------------*/
 
 void vShadowDeviceTask( void * pvParameters )
 {
     bool xStatus = true;
-    uint32_t ulNotificationValue;
     static MQTTPublishInfo_t xPublishInfo = { 0 };
     MQTTAgentCommandInfo_t xCommandParams = { 0 };
     MQTTStatus_t xCommandAdded;
+    eShadowCacheStatus eCacheStatus;
+    eShadowRequestStatus eRequestStatus;
+    size_t xUpdateLength = 0U;
+    uint32_t ulClientToken = 0U;
+    TickType_t xTicksToWait, xTicksToNextTimeout;
 
     /* A buffer containing the update document. It has static duration to prevent
      * it from being placed on the call stack. */
-    static char pcUpdateDocument[ shadowexampleSHADOW_REPORTED_JSON_LENGTH + 1 ] = { 0 };
+    static char pcUpdateDocument[ shadowexampleUPDATE_DOCUMENT_LENGTH ] = { 0 };
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pvParameters;
@@ -733,6 +723,22 @@ void vShadowDeviceTask( void * pvParameters )
      * send a notification to this task. */
     xShadowDeviceTaskHandle = xTaskGetCurrentTaskHandle();
 
+    #if ( shadowexampleJSON_BENCHMARK_ITERATIONS > 0 )
+        prvBenchmarkJsonExtraction();
+    #endif
+
+    /* The cache must be ready before the delta callback can be called. */
+    xStatus = ( eShadowCacheInit( &xShadowCache,
+                                  xShadowProperties,
+                                  sizeof( xShadowProperties ) / sizeof( xShadowProperties[ 0 ] ),
+                                  shadowexampleMS_COALESCING_WINDOW ) == eShadowCacheSuccess );
+    configASSERT( xStatus == true );
+
+    /* The request table must be ready before the accepted and rejected
+     * callbacks can be called. */
+    xStatus = ( eShadowRequestTableInit( &xShadowRequests, shadowexampleREQUEST_TABLE_ID ) == eShadowRequestSuccess );
+    configASSERT( xStatus == true );
+
     /* Set up the MQTTAgentCommandInfo_t for the demo loop.
      * We do not need a completion callback here since for publishes, we expect to get a
      * response on the appropriate topics for accepted or rejected reports, and for pings
@@ -745,46 +751,88 @@ void vShadowDeviceTask( void * pvParameters )
     xPublishInfo.pTopicName = SHADOW_TOPIC_STRING_UPDATE( democonfigCLIENT_IDENTIFIER );
     xPublishInfo.topicNameLength = SHADOW_TOPIC_LENGTH_UPDATE( democonfigCLIENT_IDENTIFIER_LENGTH );
     xPublishInfo.pPayload = pcUpdateDocument;
-    xPublishInfo.payloadLength = ( shadowexampleSHADOW_REPORTED_JSON_LENGTH + 1 );
 
-    /* Subscribe to Shadow topics. */
-    xStatus = prvSubscribeToShadowUpdateTopics();
+    /* Receive the messages of the classic shadow through the shadow service,
+     * which shares one subscription between all the shadows of the thing. */
+    xStatus = ( eShadowServiceRegister( NULL, 0U, prvShadowMessageCallback, NULL ) == eShadowServiceSuccess );
+
+    if( xStatus == true )
+    {
+        xStatus = ( eShadowServiceStart( democonfigCLIENT_IDENTIFIER,
+                                         democonfigCLIENT_IDENTIFIER_LENGTH ) == eShadowServiceSuccess );
+    }
 
     if( xStatus == true )
     {
         for( ; ; )
         {
-            if( ulCurrentPowerOnState == ulReportedPowerOnState )
+            prvApplyDesiredState();
+
+            /* Complete any updates whose response did not arrive in time. */
+            xTicksToNextTimeout = xShadowRequestProcessTimeouts( &xShadowRequests );
+
+            /* Record the update in the request table to get its client token.
+             * The cache only lets one update wait for a response at a time, so
+             * the table is not full unless updates are being leaked. */
+            eRequestStatus = eShadowRequestAdd( &xShadowRequests,
+                                                ShadowRequestUpdate,
+                                                shadowexampleMS_TO_WAIT_FOR_RESPONSE,
+                                                prvReportCompleteCallback,
+                                                NULL,
+                                                &ulClientToken );
+
+            if( eRequestStatus != eShadowRequestSuccess )
             {
-                LogInfo( ( "No change in powerOn state since last report. Current state is %u.", ulCurrentPowerOnState ) );
+                LogError( ( "Failed to add update to the request table: %d.", eRequestStatus ) );
+
+                /* Try again once an outstanding update completes. */
+                eCacheStatus = eShadowCacheUpdateInFlight;
+            }
+            else
+            {
+                /* Generate an update holding the properties that changed since the
+                 * last accepted update, if the coalescing window has closed. */
+                eCacheStatus = eShadowCacheBuildUpdate( &xShadowCache,
+                                                        ulClientToken,
+                                                        pcUpdateDocument,
+                                                        sizeof( pcUpdateDocument ),
+                                                        &xUpdateLength );
+
+                if( eCacheStatus != eShadowCacheSuccess )
+                {
+                    /* Nothing will be sent with the token. */
+                    ( void ) eShadowRequestCancel( &xShadowRequests, ulClientToken );
+                }
+            }
+
+            if( eCacheStatus == eShadowCacheNoUpdate )
+            {
+                LogInfo( ( "No change in reported state to send. Current powerOn state is %u. Suppressed updates: %u.",
+                           ( unsigned int ) ulShadowCacheGetLocal( &xShadowCache, shadowexamplePOWER_ON_PROPERTY ),
+                           ( unsigned int ) ulShadowCacheGetSuppressedUpdates( &xShadowCache ) ) );
 
                 /* The following line is only needed for winsim. Due to an inaccurate tick rate, the connection
                  * times out as the keepalive packets are not sent at the expected interval. */
                 MQTTAgent_Ping( &xGlobalMqttAgentContext,
                                 &xCommandParams );
             }
+            else if( eCacheStatus == eShadowCacheUpdateInFlight )
+            {
+                LogDebug( ( "Waiting for the response to the previous update before sending changes." ) );
+            }
+            else if( eCacheStatus != eShadowCacheSuccess )
+            {
+                LogError( ( "Failed to generate update report: %d.", eCacheStatus ) );
+            }
             else
             {
-                LogInfo( ( "PowerOn state is now %u. Sending new report.", ( unsigned int ) ulCurrentPowerOnState ) );
-
-                /* Create a new client token and save it for use in the update accepted and rejected callbacks. */
-                ulClientToken = ( xTaskGetTickCount() % 1000000 );
-
-                /* Generate update report. */
-                ( void ) memset( pcUpdateDocument,
-                                 0x00,
-                                 sizeof( pcUpdateDocument ) );
-
-                snprintf( pcUpdateDocument,
-                          shadowexampleSHADOW_REPORTED_JSON_LENGTH + 1,
-                          shadowexampleSHADOW_REPORTED_JSON,
-                          ( unsigned int ) ulCurrentPowerOnState,
-                          ( long unsigned ) ulClientToken );
-
-                /* Send update. */
+                /* Send update. The response is handled by prvReportCompleteCallback
+                 * when it arrives on /update/accepted or /update/rejected, so the
+                 * task does not wait for it here. */
                 LogInfo( ( "Publishing to /update with following client token %lu.", ( long unsigned ) ulClientToken ) );
-                LogDebug( ( "Publish content: %.*s", shadowexampleSHADOW_REPORTED_JSON_LENGTH, pcUpdateDocument ) );
+                LogDebug( ( "Publish content: %.*s", ( int ) xUpdateLength, pcUpdateDocument ) );
 
+                xPublishInfo.payloadLength = xUpdateLength;
                 xCommandAdded = MQTTAgent_Publish( &xGlobalMqttAgentContext,
                                                    &xPublishInfo,
                                                    &xCommandParams );
@@ -792,30 +840,32 @@ void vShadowDeviceTask( void * pvParameters )
                 if( xCommandAdded != MQTTSuccess )
                 {
                     LogInfo( ( "Failed to publish report to shadow." ) );
+                    ( void ) eShadowRequestCancel( &xShadowRequests, ulClientToken );
+                    vShadowCacheUpdateTimedOut( &xShadowCache );
                 }
                 else
                 {
-                    /* Wait for the response to our report. When the Device shadow service receives the request it will
-                     * publish a response to  the /update/accepted or update/rejected */
-                    ulNotificationValue = ulTaskNotifyTake( pdFALSE, pdMS_TO_TICKS( shadowexampleMS_TO_WAIT_FOR_NOTIFICATION ) );
-
-                    if( ulNotificationValue == 0 )
-                    {
-                        LogError( ( "Timed out waiting for response to report." ) );
-
-                        /* If we time out waiting for a response and then the report is accepted, the
-                         * state may be out of sync. Set the reported state as to ensure we resend the
-                         * report. */
-                        ulReportedPowerOnState = shadowexampleINVALID_POWERON_STATE;
-                    }
+                    xTicksToNextTimeout = xShadowRequestProcessTimeouts( &xShadowRequests );
                 }
+            }
+
+            /* Sleep until the coalescing window of pending changes closes, a
+             * delta or response arrives, or an update times out, checking in at
+             * least every shadowexampleMS_BETWEEN_REPORTS. */
+            xTicksToWait = xShadowCacheGetTicksUntilUpdate( &xShadowCache );
+
+            if( xTicksToWait > xTicksToNextTimeout )
+            {
+                xTicksToWait = xTicksToNextTimeout;
+            }
 
-                /* Clear the client token */
-                ulClientToken = 0;
+            if( xTicksToWait > pdMS_TO_TICKS( shadowexampleMS_BETWEEN_REPORTS ) )
+            {
+                xTicksToWait = pdMS_TO_TICKS( shadowexampleMS_BETWEEN_REPORTS );
             }
 
             LogDebug( ( "Sleeping until next update check." ) );
-            vTaskDelay( pdMS_TO_TICKS( shadowexampleMS_BETWEEN_REPORTS ) );
+            ( void ) ulTaskNotifyTake( pdTRUE, xTicksToWait );
         }
     }
 }
@@ -31,19 +31,24 @@
  * This example assumes there is a powerOn state in the device shadow. It does the
  * following operations:
  * 1. Assemble strings for the MQTT topics of device shadow, by using macros defined by the Device Shadow library.
- * 2. Subscribe to those MQTT topics using the MQTT Agent.
- * 3. Register callbacks for incoming shadow topic publishes with the subsciption_manager.
+ * 2. Register a handler for the classic shadow with the shadow service, which subscribes to the
+ *    response topics of every shadow of the thing with one SUBSCRIBE using wildcard filters.
+ * 3. Route the messages the service passes to the handler to the callback for their topic.
  * 4. Wait until it is time to publish a requested change.
  * 5. Publish a desired state of powerOn. That will cause a delta message to be sent to device.
- * 6. Wait until either prvIncomingPublishUpdateAcceptedCallback or prvIncomingPublishUpdateRejectedCallback handle
- *    the response.
+ * 6. Record the update in a request table keyed on its client token. The task does not wait for the
+ *    response - prvIncomingPublishUpdateAcceptedCallback and prvIncomingPublishUpdateRejectedCallback
+ *    pass responses to the table, which calls prvDesiredUpdateCompleteCallback for the matching update,
+ *    so several updates can be waiting for a response at once.
  * 7. Repeat from step 4.
  */
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleShadow
+
 /* Standard includes. */
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 
 /* Kernel includes. */
 #include "FreeRTOS.h"
@@ -55,11 +60,14 @@
 /* MQTT library includes. */
 #include "core_mqtt_agent.h"
 
-/* Subscription manager header include. */
-#include "subscription_manager.h"
+/* Shadow request table include. */
+#include "shadow_request_table.h"
+
+/* Shadow schema include. */
+#include "shadow_schema.h"
 
-/* JSON library includes. */
-#include "core_json.h"
+/* Shadow service include. */
+#include "shadow_service.h"
 
 /* Shadow API header. */
 #include "shadow.h"
@@ -71,50 +79,25 @@
     #error "Please define democonfigCLIENT_IDENTIFIER in demo_config.h to the thing name registered with AWS IoT Core."
 #endif
 
-/**
- * @brief Format string representing a Shadow document with a "desired" state.
- *
- * The real json document will look like this:
+/*
+ * The desired state is published in a document built from the shadow schema,
+ * which looks like this:
  * {
  *   "state": {
  *     "desired": {
- *       "powerOn": 1
+ *       "powerOn":          1
  *     }
  *   },
- *   "clientToken": "021909"
+ *   "clientToken": "0000021909"
  * }
  *
- * Note the client token, which is optional. The token is used to identify the
- * response to an update. The client token must be unique at any given time,
- * but may be reused once the update is completed. For this demo, a timestamp
- * is used for a client token.
+ * The template of the document is copied once, and only the value of powerOn
+ * and the client token are rewritten for each request.  The client token,
+ * which is optional, is used to identify the response to an update. The client
+ * token must be unique at any given time, but may be reused once the update is
+ * completed. For this demo, the token is issued by the shadow request table
+ * the update is recorded in.
  */
-#define shadowexampleSHADOW_DESIRED_JSON \
-    "{"                                  \
-    "\"state\":{"                        \
-    "\"desired\":{"                      \
-    "\"powerOn\":%1u"                    \
-    "}"                                  \
-    "},"                                 \
-    "\"clientToken\":\"%06lu\""          \
-    "}"
-
-/**
- * @brief The expected size of #SHADOW_DESIRED_JSON.
- *
- * Since all of the format specifiers in #SHADOW_DESIRED_JSON include a length,
- * its actual size can be precalculated at compile time from the difference between
- * the lengths of the format strings and their formatted output. We must subtract 2
- * from the length as according the following formula:
- * 1. The length of the format string "%1u" is 3.
- * 2. The length of the format string "%06lu" is 5.
- * 3. The formatted length in case 1. is 1 ( for the state of powerOn ).
- * 4. The formatted length in case 2. is 6 ( for the clientToken length ).
- * 5. Thus the additional size of our format is 2 = 3 + 5 - 1 - 6 + 1 (termination character).
- *
- * Custom applications may calculate the length of the JSON document with the same method.
- */
-#define shadowexampleSHADOW_DESIRED_JSON_LENGTH    ( sizeof( shadowexampleSHADOW_DESIRED_JSON ) - 2 )
 
 
 /**
@@ -123,11 +106,17 @@
 #define shadowexampleMS_BETWEEN_REQUESTS               ( 40000U )
 
 /**
- * @brief This demo uses task notifications to signal tasks from MQTT callback
- * functions. shadowexampleMS_TO_WAIT_FOR_NOTIFICATION defines the time, in ticks,
- * to wait for such a callback.
+ * @brief Time in ms to wait for the response to a desired state update before
+ * it times out.
+ */
+#define shadowexampleMS_TO_WAIT_FOR_RESPONSE           ( 5000U )
+
+/**
+ * @brief Identifier of this task's shadow request table.  It must differ from
+ * the identifier used by the shadow device task, as both tasks receive the
+ * responses to each other's updates.
  */
-#define shadowexampleMS_TO_WAIT_FOR_NOTIFICATION       ( 5000 )
+#define shadowexampleREQUEST_TABLE_ID                  ( 2U )
 
 /**
  * @brief The maximum amount of time in milliseconds to wait for the commands
@@ -136,24 +125,15 @@
  */
 #define shadowexampleMAX_COMMAND_SEND_BLOCK_TIME_MS    ( 200 )
 
-/**
- * @brief Defines the structure to use as the command callback context in this
- * demo.
- */
-struct MQTTAgentCommandContext
-{
-    bool xReturnStatus;
-};
-
 extern MQTTAgentContext_t xGlobalMqttAgentContext;
 
 /*-----------------------------------------------------------*/
 
 /**
- * @brief Match the received clientToken with the one sent in a device shadow
- * update. Set to 0 when not waiting on a response.
+ * @brief The desired state updates waiting for a response, keyed on their
+ * client token.
  */
-static uint32_t ulClientToken = 0U;
+static ShadowRequestTable_t xShadowRequests;
 
 /**
  * @brief The handle of this task. It is used by callbacks to notify this task.
@@ -163,34 +143,21 @@ static TaskHandle_t xShadowUpdateTaskHandle;
 /*-----------------------------------------------------------*/
 
 /**
- * @brief Subscribe to the used device shadow topics.
+ * @brief The handler registered with the shadow service for the classic
+ * shadow.  It passes each message to the callback for its topic.
  *
- * @return true if the subscribe is successful;
- * false otherwise.
- */
-static bool prvSubscribeToShadowUpdateTopics( void );
-
-/**
- * @brief Passed into MQTTAgent_Subscribe() as the callback to execute when the
- * broker ACKs the SUBSCRIBE message. Its implementation sends a notification
- * to the task that called MQTTAgent_Subscribe() to let the task know the
- * SUBSCRIBE operation completed. It also sets the xReturnStatus of the
- * structure passed in as the command's context to the value of the
- * xReturnStatus parameter - which enables the task to check the status of the
- * operation.
- *
- * See https://freertos.org/mqtt/mqtt-agent-demo.html#example_mqtt_api_call
- *
- * @param[in] pxCommandContext Context of the initial command.
- * @param[in] pxReturnInfo The result of the command.
+ * @param[in] pvContext Unused.
+ * @param[in] eMessageType The kind of message.
+ * @param[in] pxPublishInfo Deserialized publish.
  */
-static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
-                                         MQTTAgentReturnInfo_t * pxReturnInfo );
+static void prvShadowMessageCallback( void * pvContext,
+                                      ShadowMessageType_t eMessageType,
+                                      MQTTPublishInfo_t * pxPublishInfo );
 
 /**
  * @brief The callback to execute when there is an incoming publish on the
- * topic for accepted requests. It verifies the document is valid and is being waited on.
- * If so it notifies the task to inform completion of the update request.
+ * topic for accepted requests. It passes the response to the request table,
+ * which completes the update the response belongs to, if it is one of ours.
  *
  * @param[in] pvIncomingPublishCallbackContext Context of the initial command.
  * @param[in] pxPublishInfo Deserialized publish.
@@ -202,8 +169,8 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
 
 /**
  * @brief The callback to execute when there is an incoming publish on the
- * topic for rejected requests. It verifies the document is valid and is being waited on.
- * If so it notifies the task to inform completion of the update request.
+ * topic for rejected requests. It passes the response to the request table,
+ * which completes the update the response belongs to, if it is one of ours.
  *
  * @param[in] pvIncomingPublishCallbackContext Context of the initial command.
  * @param[in] pxPublishInfo Deserialized publish.
@@ -211,18 +178,30 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
 static void prvIncomingPublishUpdateRejectedCallback( void * pxSubscriptionContext,
                                                       MQTTPublishInfo_t * pxPublishInfo );
 
+/**
+ * @brief Called by the request table when a desired state update is accepted,
+ * rejected or times out.  It logs the outcome.
+ *
+ * @param[in] pvContext Unused.
+ * @param[in] ulClientToken The client token of the update.
+ * @param[in] eType The kind of request, always #ShadowRequestUpdate.
+ * @param[in] pxResponse The response.
+ */
+static void prvDesiredUpdateCompleteCallback( void * pvContext,
+                                              uint32_t ulClientToken,
+                                              ShadowRequestType_t eType,
+                                              const ShadowResponse_t * pxResponse );
+
 /**
  * @brief Entry point of shadow demo.
  *
  * This main function demonstrates how to use the macros provided by the
  * Device Shadow library to assemble strings for the MQTT topics defined
- * by AWS IoT Device Shadow. It uses these macros for topics to subscribe
- * to:
- * - SHADOW_TOPIC_STRING_UPDATE_DELTA for "$aws/things/thingName/shadow/update/delta"
- * - SHADOW_TOPIC_STRING_UPDATE_ACCEPTED for "$aws/things/thingName/shadow/update/accepted"
- * - SHADOW_TOPIC_STRING_UPDATE_REJECTED for "$aws/things/thingName/shadow/update/rejected"
+ * by AWS IoT Device Shadow. The topics it receives messages on, such as
+ * "$aws/things/thingName/shadow/update/accepted", are subscribed to by the
+ * shadow service with the wildcard filter "$aws/things/thingName/shadow/+/+".
  *
- * It also uses these macros for topics to publish to:
+ * It uses these macros for topics to publish to:
  * - SHADOW_TOPIC_STIRNG_DELETE for "$aws/things/thingName/shadow/delete"
  * - SHADOW_TOPIC_STRING_UPDATE for "$aws/things/thingName/shadow/update"
  */
@@ -230,130 +209,34 @@ void vShadowUpdateTask( void * pvParameters );
 
 /*-----------------------------------------------------------*/
 
-static bool prvSubscribeToShadowUpdateTopics( void )
+static void prvShadowMessageCallback( void * pvContext,
+                                      ShadowMessageType_t eMessageType,
+                                      MQTTPublishInfo_t * pxPublishInfo )
 {
-    bool xReturnStatus = false;
-    MQTTStatus_t xStatus;
-    uint32_t ulNotificationValue;
-    MQTTAgentCommandInfo_t xCommandParams = { 0 };
-
-    /* These must persist until the command is processed. */
-    MQTTAgentSubscribeArgs_t xSubscribeArgs;
-    MQTTSubscribeInfo_t xSubscribeInfo[ 2 ];
-    MQTTAgentCommandContext_t xApplicationDefinedContext = { 0 };
-
-    /* Subscribe to shadow topic for accepted responses for submitted updates. */
-    xSubscribeInfo[ 0 ].pTopicFilter = SHADOW_TOPIC_STRING_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER );
-    xSubscribeInfo[ 0 ].topicFilterLength = SHADOW_TOPIC_LENGTH_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH );
-    xSubscribeInfo[ 0 ].qos = MQTTQoS1;
-    /* Subscribe to shadow topic for rejected responses for submitted updates. */
-    xSubscribeInfo[ 1 ].pTopicFilter = SHADOW_TOPIC_STRING_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER );
-    xSubscribeInfo[ 1 ].topicFilterLength = SHADOW_TOPIC_LENGTH_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH );
-    xSubscribeInfo[ 1 ].qos = MQTTQoS1;
-
-    /* Complete the subscribe information.  The topic string must persist for
-     * duration of subscription - although in this case is it a static const so
-     * will persist for the lifetime of the application. */
-    xSubscribeArgs.pSubscribeInfo = xSubscribeInfo;
-    xSubscribeArgs.numSubscriptions = 2;
-
-    /* Loop in case the queue used to communicate with the MQTT agent is full and
-     * attempts to post to it time out.  The queue will not become full if the
-     * priority of the MQTT agent task is higher than the priority of the task
-     * calling this function. */
-    xTaskNotifyStateClear( NULL );
-    xCommandParams.blockTimeMs = shadowexampleMAX_COMMAND_SEND_BLOCK_TIME_MS;
-    xCommandParams.cmdCompleteCallback = prvSubscribeCommandCallback;
-    xCommandParams.pCmdCompleteCallbackContext = &xApplicationDefinedContext;
-    LogInfo( ( "Sending subscribe request to agent for shadow topics." ) );
+    /* Remove compiler warnings about unused parameters. */
+    ( void ) pvContext;
 
-    do
-    {
-        /* If this fails, the agent's queue is full, so we retry until the agent
-         * has more space in the queue. */
-        xStatus = MQTTAgent_Subscribe( &xGlobalMqttAgentContext,
-                                       &( xSubscribeArgs ),
-                                       &xCommandParams );
-    } while( xStatus != MQTTSuccess );
-
-    /* Wait for acks from subscribe messages - this is optional.  If the
-     * returned value is zero then the wait timed out. */
-    ulNotificationValue = ulTaskNotifyTake( pdFALSE, pdMS_TO_TICKS( shadowexampleMS_TO_WAIT_FOR_NOTIFICATION ) );
-    configASSERT( ulNotificationValue != 0UL );
-
-    /* The callback sets the xReturnStatus member of the context. */
-    if( xApplicationDefinedContext.xReturnStatus != true )
+    if( eMessageType == ShadowMessageTypeUpdateAccepted )
     {
-        LogError( ( "Failed to subscribe to shadow update topics." ) );
+        prvIncomingPublishUpdateAcceptedCallback( NULL, pxPublishInfo );
     }
-    else
-    {
-        LogInfo( ( "Received subscribe ack for shadow update topics." ) );
-        xReturnStatus = true;
-    }
-
-    return xReturnStatus;
-}
-
-/*-----------------------------------------------------------*/
-
-static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
-                                         MQTTAgentReturnInfo_t * pxReturnInfo )
-{
-    bool xSuccess = false;
-
-    /* Check if the subscribe operation is a success. */
-    if( pxReturnInfo->returnCode == MQTTSuccess )
+    else if( eMessageType == ShadowMessageTypeUpdateRejected )
     {
-        /* Add subscriptions so that incoming publishes are routed to the application
-         * callback. */
-        xSuccess = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
-                                    SHADOW_TOPIC_STRING_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER ),
-                                    SHADOW_TOPIC_LENGTH_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                                    prvIncomingPublishUpdateAcceptedCallback,
-                                    NULL );
-
-        if( xSuccess == false )
-        {
-            LogError( ( "Failed to register an incoming publish callback for topic %.*s.",
-                        SHADOW_TOPIC_LENGTH_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                        SHADOW_TOPIC_STRING_UPDATE_ACCEPTED( democonfigCLIENT_IDENTIFIER ) ) );
-        }
+        prvIncomingPublishUpdateRejectedCallback( NULL, pxPublishInfo );
     }
-
-    if( xSuccess == true )
+    else
     {
-        xSuccess = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
-                                    SHADOW_TOPIC_STRING_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER ),
-                                    SHADOW_TOPIC_LENGTH_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                                    prvIncomingPublishUpdateRejectedCallback,
-                                    NULL );
-
-        if( xSuccess == false )
-        {
-            LogError( ( "Failed to register an incoming publish callback for topic %.*s.",
-                        SHADOW_TOPIC_LENGTH_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER_LENGTH ),
-                        SHADOW_TOPIC_STRING_UPDATE_REJECTED( democonfigCLIENT_IDENTIFIER ) ) );
-        }
+        /* Responses to get and delete requests, and deltas and update
+         * documents, are not used by this task. */
     }
-
-    /* Store the result in the application defined context so the calling task
-     * can check it. */
-    pxCommandContext->xReturnStatus = xSuccess;
-
-    xTaskNotifyGive( xShadowUpdateTaskHandle );
 }
 
-
 /*-----------------------------------------------------------*/
 
 static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionContext,
                                                       MQTTPublishInfo_t * pxPublishInfo )
 {
-    char * pcOutValue = NULL;
-    uint32_t ulOutValueLength = 0U;
-    uint32_t ulReceivedToken = 0U;
-    JSONStatus_t result = JSONSuccess;
+    eShadowRequestStatus eStatus;
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pxSubscriptionContext;
@@ -365,9 +248,10 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
                 pxPublishInfo->payloadLength,
                 ( const char * ) pxPublishInfo->pPayload ) );
 
-    /* Handle the reported state with state change in /update/accepted topic.
-     * Thus we will retrieve the client token from the JSON document to see if
-     * it's the same one we sent with reported state on the /update topic.
+    /* Handle the desired state with state change in /update/accepted topic.
+     * The request table retrieves the client token from the JSON document and
+     * completes the update we sent with that token on the /update topic, if
+     * it is still waiting for a response.
      * The payload will look similar to this:
      *  {
      *      "state": {
@@ -387,51 +271,24 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
      *      "clientToken": "022485"
      *  }
      */
+    eStatus = eShadowRequestHandleResponse( &xShadowRequests,
+                                            ShadowRequestAccepted,
+                                            pxPublishInfo->pPayload,
+                                            pxPublishInfo->payloadLength );
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pxPublishInfo->pPayload,
-                            pxPublishInfo->payloadLength );
-
-    if( result != JSONSuccess )
+    if( eStatus == eShadowRequestInvalidDocument )
     {
         LogError( ( "Invalid JSON document recieved!" ) );
     }
-    else
+    else if( eStatus == eShadowRequestNotFound )
     {
-        /* Get clientToken from json documents. */
-        result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                              pxPublishInfo->payloadLength,
-                              "clientToken",
-                              sizeof( "clientToken" ) - 1,
-                              &pcOutValue,
-                              ( size_t * ) &ulOutValueLength );
-    }
-
-    if( result != JSONSuccess )
-    {
-        LogDebug( ( "Ignoring publish on /update/accepted with no clientToken field." ) );
+        /* The response is for the other shadow task, or arrived after we
+         * timed out waiting for it. */
+        LogDebug( ( "Ignoring publish on /update/accepted for an update that is not waiting for a response." ) );
     }
     else
     {
-        /* Convert the code to an unsigned integer value. */
-        ulReceivedToken = ( uint32_t ) strtoul( pcOutValue, NULL, 10 );
-
-        /* If we are waiting for a response, ulClientToken will be the token for the response
-         * we are waiting for, else it will be 0. ulRecievedToken may not match if the response is
-         * not for us or if it is is a response that arrived after we timed out
-         * waiting for it.
-         */
-        if( ulReceivedToken != ulClientToken )
-        {
-            LogDebug( ( "Ignoring publish on /update/accepted with clientToken %lu.", ( unsigned long ) ulReceivedToken ) );
-        }
-        else
-        {
-            LogInfo( ( "Received accepted response for update with token %lu. ", ( unsigned long ) ulClientToken ) );
-
-            /* Wake up the shadow task which is waiting for this response. */
-            xTaskNotifyGive( xShadowUpdateTaskHandle );
-        }
+        /* The update was completed by prvDesiredUpdateCompleteCallback. */
     }
 }
 
@@ -440,10 +297,7 @@ static void prvIncomingPublishUpdateAcceptedCallback( void * pxSubscriptionConte
 static void prvIncomingPublishUpdateRejectedCallback( void * pxSubscriptionContext,
                                                       MQTTPublishInfo_t * pxPublishInfo )
 {
-    JSONStatus_t result = JSONSuccess;
-    char * pcOutValue = NULL;
-    uint32_t ulOutValueLength = 0UL;
-    uint32_t ulReceivedToken = 0U;
+    eShadowRequestStatus eStatus;
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pxSubscriptionContext;
@@ -463,68 +317,51 @@ static void prvIncomingPublishUpdateRejectedCallback( void * pxSubscriptionConte
      *    "clientToken": "token"
      * }
      */
+    eStatus = eShadowRequestHandleResponse( &xShadowRequests,
+                                            ShadowRequestRejected,
+                                            pxPublishInfo->pPayload,
+                                            pxPublishInfo->payloadLength );
 
-    /* Make sure the payload is a valid json document. */
-    result = JSON_Validate( pxPublishInfo->pPayload,
-                            pxPublishInfo->payloadLength );
-
-    if( result != JSONSuccess )
+    if( eStatus == eShadowRequestInvalidDocument )
     {
         LogError( ( "Invalid JSON document recieved!" ) );
     }
+    else if( eStatus == eShadowRequestNotFound )
+    {
+        LogDebug( ( "Ignoring publish on /update/rejected for an update that is not waiting for a response." ) );
+    }
     else
     {
-        /* Get clientToken from json documents. */
-        result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                              pxPublishInfo->payloadLength,
-                              "clientToken",
-                              sizeof( "clientToken" ) - 1,
-                              &pcOutValue,
-                              ( size_t * ) &ulOutValueLength );
+        /* The update was completed by prvDesiredUpdateCompleteCallback. */
     }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvDesiredUpdateCompleteCallback( void * pvContext,
+                                              uint32_t ulClientToken,
+                                              ShadowRequestType_t eType,
+                                              const ShadowResponse_t * pxResponse )
+{
+    /* Remove compiler warnings about unused parameters. */
+    ( void ) pvContext;
+    ( void ) eType;
+
+    configASSERT( pxResponse != NULL );
 
-    if( result != JSONSuccess )
+    if( pxResponse->eResult == ShadowRequestAccepted )
     {
-        LogDebug( ( "Ignoring publish on /update/rejected with clientToken %lu.", ( unsigned long ) ulReceivedToken ) );
+        LogInfo( ( "Received accepted response for update with token %lu. ", ( unsigned long ) ulClientToken ) );
+    }
+    else if( pxResponse->eResult == ShadowRequestRejected )
+    {
+        LogWarn( ( "Received rejected response for update with token %lu and error code %lu.",
+                   ( unsigned long ) ulClientToken,
+                   ( unsigned long ) pxResponse->ulErrorCode ) );
     }
     else
     {
-        /* Convert the code to an unsigned integer value. */
-        ulReceivedToken = ( uint32_t ) strtoul( pcOutValue, NULL, 10 );
-
-        /* If we are waiting for a response, ulClientToken will be the token for the response
-         * we are waiting for, else it will be 0. ulRecievedToken may not match if the response is
-         * not for us or if it is is a response that arrived after we timed out
-         * waiting for it.
-         */
-        if( ulReceivedToken != ulClientToken )
-        {
-            LogDebug( ( "Ignoring publish on /update/rejected with clientToken %lu.", ( unsigned long ) ulReceivedToken ) );
-        }
-        else
-        {
-            /*  Obtain the error code. */
-            result = JSON_Search( ( char * ) pxPublishInfo->pPayload,
-                                  pxPublishInfo->payloadLength,
-                                  "code",
-                                  sizeof( "code" ) - 1,
-                                  &pcOutValue,
-                                  ( size_t * ) &ulOutValueLength );
-
-            if( result != JSONSuccess )
-            {
-                LogWarn( ( "Received rejected response for update with token %lu and no error code.", ( unsigned long ) ulClientToken ) );
-            }
-            else
-            {
-                LogWarn( ( "Received rejected response for update with token %lu and error code %.*s.", ( unsigned long ) ulClientToken,
-                           ulOutValueLength,
-                           pcOutValue ) );
-            }
-
-            /* Wake up the shadow task which is waiting for this response. */
-            xTaskNotifyGive( xShadowUpdateTaskHandle );
-        }
+        LogError( ( "Timed out waiting for response to update with token %lu.", ( unsigned long ) ulClientToken ) );
     }
 }
 
@@ -533,15 +370,18 @@ static void prvIncomingPublishUpdateRejectedCallback( void * pxSubscriptionConte
 void vShadowUpdateTask( void * pvParameters )
 {
     bool xStatus = true;
-    uint32_t ulNotificationValue;
     static MQTTPublishInfo_t xPublishInfo = { 0 };
     MQTTAgentCommandInfo_t xCommandParams = { 0 };
     MQTTStatus_t xCommandAdded;
+    eShadowRequestStatus eRequestStatus;
+    uint32_t ulClientToken = 0U;
     uint32_t desiredState = 0;
+    TickType_t xLastRequestTime, xElapsed, xTicksToWait;
+    const TickType_t xTicksBetweenRequests = pdMS_TO_TICKS( shadowexampleMS_BETWEEN_REQUESTS );
 
-    /* A buffer containing the desired document. It has static duration to prevent
-     * it from being placed on the call stack. */
-    static char pcDesiredDocument[ shadowexampleSHADOW_DESIRED_JSON_LENGTH + 1 ] = { 0 };
+    /* The desired document. It has static duration to prevent it from being
+     * placed on the call stack. */
+    static ShadowSchemaDocument_t xDesiredDocument;
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pvParameters;
@@ -550,72 +390,105 @@ void vShadowUpdateTask( void * pvParameters )
      * send a notification to this task. */
     xShadowUpdateTaskHandle = xTaskGetCurrentTaskHandle();
 
+    /* The request table must be ready before the accepted and rejected
+     * callbacks can be called. */
+    xStatus = ( eShadowRequestTableInit( &xShadowRequests, shadowexampleREQUEST_TABLE_ID ) == eShadowRequestSuccess );
+    configASSERT( xStatus == true );
+
     /* Set up the MQTTAgentCommandInfo_t for the demo loop.
      * We do not need a completion callback here since for publishes, we expect to get a
      * response on the appropriate topics for accepted or rejected reports. */
     xCommandParams.blockTimeMs = shadowexampleMAX_COMMAND_SEND_BLOCK_TIME_MS;
     xCommandParams.cmdCompleteCallback = NULL;
 
+    /* Compile the desired document.  Its length does not change
+     * when the values in it are rewritten. */
+    vShadowSchemaInitDocument( &xDesiredDocument, ShadowSchemaSectionDesired );
+
     /* Set up MQTTPublishInfo_t for the desired updates. */
     xPublishInfo.qos = MQTTQoS1;
     xPublishInfo.pTopicName = SHADOW_TOPIC_STRING_UPDATE( democonfigCLIENT_IDENTIFIER );
     xPublishInfo.topicNameLength = SHADOW_TOPIC_LENGTH_UPDATE( democonfigCLIENT_IDENTIFIER_LENGTH );
-    xPublishInfo.pPayload = pcDesiredDocument;
-    xPublishInfo.payloadLength = ( shadowexampleSHADOW_DESIRED_JSON_LENGTH + 1 );
+    xPublishInfo.pPayload = xDesiredDocument.xPayload.pcPayload;
+    xPublishInfo.payloadLength = xDesiredDocument.xPayload.xLength;
 
-    /* Subscribe to Shadow topics. */
-    xStatus = prvSubscribeToShadowUpdateTopics();
+    /* Receive the messages of the classic shadow through the shadow service,
+     * which shares one subscription between all the shadows of the thing. */
+    xStatus = ( eShadowServiceRegister( NULL, 0U, prvShadowMessageCallback, NULL ) == eShadowServiceSuccess );
 
     if( xStatus == true )
     {
-        for( ; ; )
-        {
-            vTaskDelay( pdMS_TO_TICKS( shadowexampleMS_BETWEEN_REQUESTS ) );
-
-
-            /* Create a new client token and save it for use in the update accepted and rejected callbacks. */
-            ulClientToken = ( xTaskGetTickCount() % 1000000 );
-
-            /* Generate update report. */
-            ( void ) memset( pcDesiredDocument,
-                             0x00,
-                             sizeof( pcDesiredDocument ) );
-
-            snprintf( pcDesiredDocument,
-                      shadowexampleSHADOW_DESIRED_JSON_LENGTH + 1,
-                      shadowexampleSHADOW_DESIRED_JSON,
-                      ( unsigned int ) desiredState,
-                      ( long unsigned ) ulClientToken );
+        xStatus = ( eShadowServiceStart( democonfigCLIENT_IDENTIFIER,
+                                         democonfigCLIENT_IDENTIFIER_LENGTH ) == eShadowServiceSuccess );
+    }
 
-            /* Send desired state. */
-            LogInfo( ( "Publishing to /update with following client token %lu.", ( long unsigned ) ulClientToken ) );
-            LogDebug( ( "Publish content: %.*s", shadowexampleSHADOW_DESIRED_JSON_LENGTH, pcDesiredDocument ) );
+    if( xStatus == true )
+    {
+        xLastRequestTime = xTaskGetTickCount();
 
-            xCommandAdded = MQTTAgent_Publish( &xGlobalMqttAgentContext,
-                                               &xPublishInfo,
-                                               &xCommandParams );
+        for( ; ; )
+        {
+            /* Complete any updates whose response did not arrive in time. */
+            xTicksToWait = xShadowRequestProcessTimeouts( &xShadowRequests );
+            xElapsed = xTaskGetTickCount() - xLastRequestTime;
 
-            if( xCommandAdded != MQTTSuccess )
-            {
-                LogInfo( ( "Failed to publish to shadow update." ) );
-            }
-            else
+            if( xElapsed >= xTicksBetweenRequests )
             {
-                /* Wait for the response to our report. When the Device shadow service receives the request it will
-                 * publish a response to  the /update/accepted or update/rejected */
-                ulNotificationValue = ulTaskNotifyTake( pdFALSE, pdMS_TO_TICKS( shadowexampleMS_TO_WAIT_FOR_NOTIFICATION ) );
-
-                if( ulNotificationValue == 0 )
+                xLastRequestTime += xTicksBetweenRequests;
+                xElapsed -= xTicksBetweenRequests;
+
+                /* Record the update in the request table to get its client token.
+                 * Updates already waiting for a response are not waited for, so
+                 * the next request is sent on time even if the service is slow. */
+                eRequestStatus = eShadowRequestAdd( &xShadowRequests,
+                                                    ShadowRequestUpdate,
+                                                    shadowexampleMS_TO_WAIT_FOR_RESPONSE,
+                                                    prvDesiredUpdateCompleteCallback,
+                                                    NULL,
+                                                    &ulClientToken );
+
+                if( eRequestStatus != eShadowRequestSuccess )
+                {
+                    LogError( ( "Too many updates waiting for a response to send another: %d.", eRequestStatus ) );
+                }
+                else
                 {
-                    LogError( ( "Timed out waiting for response to report." ) );
+                    /* Generate update report by patching the value and the
+                     * token into the desired document. */
+                    vShadowSchemaSetValue( &xDesiredDocument, ShadowSchemaIndex_powerOn, desiredState );
+                    vShadowSchemaSetClientToken( &xDesiredDocument, ulClientToken );
+
+                    /* Send desired state. */
+                    LogInfo( ( "Publishing to /update with following client token %lu.", ( long unsigned ) ulClientToken ) );
+                    LogDebug( ( "Publish content: %.*s", ( int ) xDesiredDocument.xPayload.xLength, xDesiredDocument.xPayload.pcPayload ) );
+
+                    xCommandAdded = MQTTAgent_Publish( &xGlobalMqttAgentContext,
+                                                       &xPublishInfo,
+                                                       &xCommandParams );
+
+                    if( xCommandAdded != MQTTSuccess )
+                    {
+                        LogInfo( ( "Failed to publish to shadow update." ) );
+                        ( void ) eShadowRequestCancel( &xShadowRequests, ulClientToken );
+                    }
+                    else
+                    {
+                        xTicksToWait = xShadowRequestProcessTimeouts( &xShadowRequests );
+                    }
+
+                    desiredState = !desiredState;
                 }
             }
 
-            /* Clear the client token */
-            ulClientToken = 0;
+            /* Sleep until it is time for the next request or an update times
+             * out. */
+            if( xTicksToWait > ( xTicksBetweenRequests - xElapsed ) )
+            {
+                xTicksToWait = xTicksBetweenRequests - xElapsed;
+            }
 
-            desiredState = !desiredState;
             LogDebug( ( "Sleeping until time for next publish." ) );
+            ( void ) ulTaskNotifyTake( pdTRUE, xTicksToWait );
         }
     }
 }
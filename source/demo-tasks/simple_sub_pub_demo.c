@@ -38,9 +38,24 @@
  * task checks the number it receives from the callback equals the number it
  * previously set in the command context before printing out either a success
  * or failure message.
+ *
+ * Set democonfigSIMPLE_SUB_PUB_LOAD_MODE to 1 in demo_config.h to run the tasks
+ * as a load generator instead.  The tasks then publish to their topics at a
+ * combined rate of mqttexampleLOAD_MESSAGES_PER_SECOND without waiting for each
+ * publish to complete, with payloads of random length and a random QoS.  Each
+ * payload starts with the number of the task, a sequence number and the time
+ * it was sent, so when the message is echoed back by the broker the round trip
+ * time is recorded and missing, reordered and duplicate messages are counted.
+ * The first task logs a summary of the load, including the 50th, 99th and
+ * 99.9th percentiles of the round trip time, every
+ * mqttexampleLOAD_REPORT_INTERVAL_MS.  Times are measured with the run time
+ * stats counter, which counts microseconds in the Linux build.
  */
 
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModulePubSub
+
 /* Standard includes. */
 #include <string.h>
 #include <stdio.h>
@@ -63,6 +78,12 @@
 /* Subscription manager header include. */
 #include "subscription_manager.h"
 
+/* Payload template include. */
+#include "payload_template.h"
+
+/* Latency histogram include. */
+#include "latency_histogram.h"
+
 /**
  * @brief This demo uses task notifications to signal tasks from MQTT callback
  * functions.  mqttexampleMS_TO_WAIT_FOR_NOTIFICATION defines the time, in ticks,
@@ -76,6 +97,14 @@
  */
 #define mqttexampleSTRING_BUFFER_LENGTH                   ( 100 )
 
+/**
+ * @brief Pattern of the payload published by each task.  The task name is
+ * written once and only the message number is rewritten for each publish.
+ * The task names, "Publisher" followed by the task number, fit in the 20
+ * character name slot.
+ */
+#define mqttexamplePAYLOAD_PATTERN                        "%20s publishing message %u"
+
 /**
  * @brief Delay for the synchronous publisher task between publishes.
  */
@@ -93,6 +122,59 @@
  */
 #define mqttexampleMAX_COMMAND_SEND_BLOCK_TIME_MS         ( 500 )
 
+/**
+ * @brief The load generated when democonfigSIMPLE_SUB_PUB_LOAD_MODE is 1.  The
+ * message rate is shared equally between the tasks.  Payload lengths are
+ * spread evenly over the powers of two between the minimum and maximum, so
+ * short payloads are the most common.  Messages not sent with
+ * QoS 1 or 2 are sent with QoS 0.
+ */
+#define mqttexampleLOAD_MESSAGES_PER_SECOND               ( 100U )
+#define mqttexampleLOAD_MIN_PAYLOAD_LENGTH                ( 16U )
+#define mqttexampleLOAD_MAX_PAYLOAD_LENGTH                ( 1024U )
+#define mqttexampleLOAD_QOS1_PERCENT                      ( 40U )
+#define mqttexampleLOAD_QOS2_PERCENT                      ( 0U )
+
+/**
+ * @brief The number of publishes each task can have outstanding in the load
+ * generator mode.  A task that falls further behind its schedule than this
+ * skips the publishes it could not send and counts them as behind schedule.
+ * Must be less than 32.
+ */
+#define mqttexampleLOAD_MAX_IN_FLIGHT                     ( 4U )
+
+/**
+ * @brief Time between the summaries logged in the load generator mode.
+ */
+#define mqttexampleLOAD_REPORT_INTERVAL_MS                ( 10000U )
+
+/**
+ * @brief Length of the task number, sequence number and send time at the start
+ * of each payload in the load generator mode.
+ */
+#define mqttexampleLOAD_HEADER_LENGTH                     ( 12U )
+
+#if ( mqttexampleLOAD_MIN_PAYLOAD_LENGTH < mqttexampleLOAD_HEADER_LENGTH ) || ( mqttexampleLOAD_MIN_PAYLOAD_LENGTH > mqttexampleLOAD_MAX_PAYLOAD_LENGTH )
+    #error "mqttexampleLOAD_MIN_PAYLOAD_LENGTH must be between mqttexampleLOAD_HEADER_LENGTH and mqttexampleLOAD_MAX_PAYLOAD_LENGTH."
+#endif
+
+#if ( mqttexampleLOAD_MAX_IN_FLIGHT < 1U ) || ( mqttexampleLOAD_MAX_IN_FLIGHT > 31U )
+    #error "mqttexampleLOAD_MAX_IN_FLIGHT must be between 1 and 31."
+#endif
+
+#if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 ) && ( democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE < 1 )
+    #error "The load generator mode needs democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE to be at least 1."
+#endif
+
+/**
+ * @brief The callback registered for the publishes echoed back to the tasks.
+ */
+#if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 )
+    #define mqttexampleINCOMING_PUBLISH_CALLBACK          prvLoadIncomingPublishCallback
+#else
+    #define mqttexampleINCOMING_PUBLISH_CALLBACK          prvIncomingPublishCallback
+#endif
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -107,6 +189,43 @@ struct MQTTAgentCommandContext
     void * pArgs;
 };
 
+#if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 )
+
+/**
+ * @brief A publish of the load generator that may be outstanding.
+ */
+    typedef struct LoadPublish
+    {
+        MQTTAgentCommandContext_t xCommandContext;
+        MQTTPublishInfo_t xPublishInfo;
+        uint8_t ucPayload[ mqttexampleLOAD_MAX_PAYLOAD_LENGTH ];
+    } LoadPublish_t;
+
+/**
+ * @brief Counters of the load generator, reset by each summary.
+ */
+    typedef struct LoadStats
+    {
+        uint32_t ulSent;
+        uint32_t ulPublishFailures;
+        uint32_t ulBehindSchedule;
+        LatencyHistogram_t xLatency;
+    } LoadStats_t;
+
+/**
+ * @brief The sequence numbers received by a task in the load generator mode.
+ */
+    typedef struct LoadSequence
+    {
+        uint32_t ulNext;    /**< One more than the highest sequence number received. */
+        uint64_t ullWindow; /**< Bit n is set if ulNext - 1 - n has been received. */
+        uint32_t ulMissing; /**< Sequence numbers below ulNext not received. */
+        uint32_t ulReordered;
+        uint32_t ulDuplicates;
+    } LoadSequence_t;
+
+#endif /* if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 ) */
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -189,6 +308,46 @@ static bool prvSubscribeToTopic( MQTTQoS_t xQoS,
  */
 static void prvSimpleSubscribePublishTask( void * pvParameters );
 
+#if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 )
+
+/**
+ * @brief Passed into MQTTAgent_Publish() by the load generator as the callback
+ * to execute when a publish completes.  Counts failures and notifies the task
+ * that the publish can be reused.
+ */
+    static void prvLoadPublishCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
+                                               MQTTAgentReturnInfo_t * pxReturnInfo );
+
+/**
+ * @brief The incoming publish callback of the load generator.  Records the
+ * round trip time and the sequence number of the echoed message.
+ */
+    static void prvLoadIncomingPublishCallback( void * pvIncomingPublishCallbackContext,
+                                                MQTTPublishInfo_t * pxPublishInfo );
+
+/**
+ * @brief Pick the length of the next payload.
+ */
+    static size_t prvLoadPayloadLength( void );
+
+/**
+ * @brief Record a sequence number received by a task.
+ */
+    static void prvLoadTrackSequence( LoadSequence_t * pxSequence,
+                                      uint32_t ulSequenceNumber );
+
+/**
+ * @brief Log the summary of the load since the previous one.
+ */
+    static void prvLoadReport( TickType_t xInterval );
+
+/**
+ * @brief The task that implements the load generator mode.
+ */
+    static void prvLoadGeneratorTask( void * pvParameters );
+
+#endif /* if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 ) */
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -224,6 +383,25 @@ extern MQTTAgentContext_t xGlobalMqttAgentContext;
     static volatile uint32_t ulQoS0PassCount[ 1 ] = { 0UL }, ulQoS1PassCount[ 1 ] = { 0UL };
 #endif
 
+#if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 )
+
+/**
+ * @brief The publishes of each task in the load generator mode, and the
+ * sequence numbers each task has received.
+ */
+    static LoadPublish_t xLoadPublishes[ democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ][ mqttexampleLOAD_MAX_IN_FLIGHT ];
+    static LoadSequence_t xLoadSequences[ democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE ];
+
+/**
+ * @brief The counters of the load generator, and the copy taken by each
+ * summary.  Updated in critical sections as they are written by the tasks and
+ * by the MQTT agent task.
+ */
+    static LoadStats_t xLoadStats;
+    static LoadStats_t xLoadReportStats;
+
+#endif /* if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 ) */
+
 /*-----------------------------------------------------------*/
 
 void vStartSimpleSubscribePublishTask( uint32_t ulNumberToCreate,
@@ -232,6 +410,11 @@ void vStartSimpleSubscribePublishTask( uint32_t ulNumberToCreate,
 {
     char pcTaskNameBuf[ 15 ];
     uint32_t ulTaskNumber;
+    TaskFunction_t pxTaskCode = prvSimpleSubscribePublishTask;
+
+    #if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 )
+        pxTaskCode = prvLoadGeneratorTask;
+    #endif
 
     /* Each instance of prvSimpleSubscribePublishTask() generates a unique name
      * and topic filter for itself from the number passed in as the task
@@ -241,10 +424,10 @@ void vStartSimpleSubscribePublishTask( uint32_t ulNumberToCreate,
     {
         memset( pcTaskNameBuf, 0x00, sizeof( pcTaskNameBuf ) );
         snprintf( pcTaskNameBuf, 10, "SubPub%d", ( int ) ulTaskNumber );
-        xTaskCreate( prvSimpleSubscribePublishTask,
+        xTaskCreate( pxTaskCode,
                      pcTaskNameBuf,
                      uxStackSize,
-                     ( void * ) ulTaskNumber,
+                     ( void * ) ( uintptr_t ) ulTaskNumber,
                      uxPriority,
                      NULL );
     }
@@ -293,7 +476,7 @@ static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandCo
         xSubscriptionAdded = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
                                               pxSubscribeArgs->pSubscribeInfo->pTopicFilter,
                                               pxSubscribeArgs->pSubscribeInfo->topicFilterLength,
-                                              prvIncomingPublishCallback,
+                                              mqttexampleINCOMING_PUBLISH_CALLBACK,
                                               NULL );
 
         if( xSubscriptionAdded == false )
@@ -436,12 +619,14 @@ static void prvSimpleSubscribePublishTask( void * pvParameters )
 {
     extern UBaseType_t uxRand( void );
     MQTTPublishInfo_t xPublishInfo = { 0UL };
+    PayloadTemplate_t xPayload;
+    ePayloadTemplateStatus ePayloadStatus;
     char payloadBuf[ mqttexampleSTRING_BUFFER_LENGTH ];
     char taskName[ mqttexampleSTRING_BUFFER_LENGTH ];
     MQTTAgentCommandContext_t xCommandContext;
     uint32_t ulNotification = 0U, ulValueToNotify = 0UL;
     MQTTStatus_t xCommandAdded;
-    uint32_t ulTaskNumber = ( uint32_t ) pvParameters;
+    uint32_t ulTaskNumber = ( uint32_t ) ( uintptr_t ) pvParameters;
     MQTTQoS_t xQoS;
     TickType_t xTicksToDelay;
     MQTTAgentCommandInfo_t xCommandParams = { 0UL };
@@ -460,6 +645,13 @@ static void prvSimpleSubscribePublishTask( void * pvParameters )
     /* Create a topic name for this task to publish to. */
     snprintf( pcTopicBuffer, mqttexampleSTRING_BUFFER_LENGTH, "/filter/%s", taskName );
 
+    /* Compile the payload pattern and write the task name into it.  Only the
+     * incrementing number changes from one publish to the next. */
+    ePayloadStatus = ePayloadTemplateCompile( &xPayload, mqttexamplePAYLOAD_PATTERN, payloadBuf, sizeof( payloadBuf ) );
+    configASSERT( ePayloadStatus == ePayloadTemplateSuccess );
+    ePayloadStatus = ePayloadTemplateSetString( &xPayload, 0U, taskName, strlen( taskName ) );
+    configASSERT( ePayloadStatus == ePayloadTemplateSuccess );
+
     /* Subscribe to the same topic to which this task will publish.  That will
      * result in each published message being published from the server back to
      * the target. */
@@ -487,13 +679,10 @@ static void prvSimpleSubscribePublishTask( void * pvParameters )
     {
         /* Create a payload to send with the publish message.  This contains
          * the task name and an incrementing number. */
-        snprintf( payloadBuf,
-                  mqttexampleSTRING_BUFFER_LENGTH,
-                  "%s publishing message %d",
-                  taskName,
-                  ( int ) ulValueToNotify );
+        ePayloadStatus = ePayloadTemplateSetNumber( &xPayload, 1U, ulValueToNotify );
+        configASSERT( ePayloadStatus == ePayloadTemplateSuccess );
 
-        xPublishInfo.payloadLength = ( uint16_t ) strlen( payloadBuf );
+        xPublishInfo.payloadLength = ( uint16_t ) xPayload.xLength;
 
         /* Also store the incrementing number in the command context so it can
          * be accessed by the callback that executes when the publish operation
@@ -553,3 +742,318 @@ static void prvSimpleSubscribePublishTask( void * pvParameters )
     LogInfo( ( "Task %s completed.", taskName ) );
     vTaskDelete( NULL );
 }
+
+/*-----------------------------------------------------------*/
+
+#if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 )
+
+    static void prvLoadPublishCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
+                                               MQTTAgentReturnInfo_t * pxReturnInfo )
+    {
+        if( pxReturnInfo->returnCode != MQTTSuccess )
+        {
+            taskENTER_CRITICAL();
+            {
+                xLoadStats.ulPublishFailures++;
+            }
+            taskEXIT_CRITICAL();
+        }
+
+        /* The notification value is the bit of the publish in the task's set of
+         * free publishes. */
+        xTaskNotify( pxCommandContext->xTaskToNotify,
+                     pxCommandContext->ulNotificationValue,
+                     eSetBits );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvLoadIncomingPublishCallback( void * pvIncomingPublishCallbackContext,
+                                                MQTTPublishInfo_t * pxPublishInfo )
+    {
+        uint32_t ulNow = portGET_RUN_TIME_COUNTER_VALUE();
+        const uint8_t * pucPayload = ( const uint8_t * ) pxPublishInfo->pPayload;
+        uint32_t ulTaskNumber = democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE;
+        uint32_t ulSequenceNumber = 0, ulLatency = 0;
+
+        if( pxPublishInfo->payloadLength >= mqttexampleLOAD_HEADER_LENGTH )
+        {
+            ulTaskNumber = ( ( uint32_t ) pucPayload[ 0 ] << 24 ) | ( ( uint32_t ) pucPayload[ 1 ] << 16 ) |
+                           ( ( uint32_t ) pucPayload[ 2 ] << 8 ) | ( uint32_t ) pucPayload[ 3 ];
+            ulSequenceNumber = ( ( uint32_t ) pucPayload[ 4 ] << 24 ) | ( ( uint32_t ) pucPayload[ 5 ] << 16 ) |
+                               ( ( uint32_t ) pucPayload[ 6 ] << 8 ) | ( uint32_t ) pucPayload[ 7 ];
+            ulLatency = ulNow - ( ( ( uint32_t ) pucPayload[ 8 ] << 24 ) | ( ( uint32_t ) pucPayload[ 9 ] << 16 ) |
+                                  ( ( uint32_t ) pucPayload[ 10 ] << 8 ) | ( uint32_t ) pucPayload[ 11 ] );
+        }
+
+        if( ulTaskNumber < democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE )
+        {
+            taskENTER_CRITICAL();
+            {
+                prvLoadTrackSequence( &( xLoadSequences[ ulTaskNumber ] ), ulSequenceNumber );
+                vLatencyHistogramRecord( &( xLoadStats.xLatency ), ulLatency );
+            }
+            taskEXIT_CRITICAL();
+        }
+        else
+        {
+            /* Not sent by the load generator. */
+            prvIncomingPublishCallback( pvIncomingPublishCallbackContext, pxPublishInfo );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t prvLoadPayloadLength( void )
+    {
+        extern UBaseType_t uxRand( void );
+        uint32_t ulRanges = 1U, ulRange, ulLow, ulHigh;
+
+        /* Count the powers of two that start between the minimum and maximum
+         * lengths, then pick one of them and a length within it.  The last
+         * range ends at the maximum length. */
+        while( ( ( uint32_t ) mqttexampleLOAD_MIN_PAYLOAD_LENGTH << ulRanges ) < mqttexampleLOAD_MAX_PAYLOAD_LENGTH )
+        {
+            ulRanges++;
+        }
+
+        ulRange = ( uint32_t ) uxRand() % ulRanges;
+        ulLow = ( uint32_t ) mqttexampleLOAD_MIN_PAYLOAD_LENGTH << ulRange;
+        ulHigh = ( ulLow * 2U ) - 1U;
+
+        if( ( ulRange == ( ulRanges - 1U ) ) || ( ulHigh > mqttexampleLOAD_MAX_PAYLOAD_LENGTH ) )
+        {
+            ulHigh = mqttexampleLOAD_MAX_PAYLOAD_LENGTH;
+        }
+
+        return ( size_t ) ( ulLow + ( ( uint32_t ) uxRand() % ( ulHigh - ulLow + 1U ) ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvLoadTrackSequence( LoadSequence_t * pxSequence,
+                                      uint32_t ulSequenceNumber )
+    {
+        uint32_t ulDistance;
+
+        if( ulSequenceNumber >= pxSequence->ulNext )
+        {
+            /* The messages skipped over are missing until they arrive. */
+            ulDistance = ulSequenceNumber - pxSequence->ulNext + 1U;
+            pxSequence->ulMissing += ulDistance - 1U;
+            pxSequence->ullWindow = ( ulDistance < 64U ) ? ( pxSequence->ullWindow << ulDistance ) : 0U;
+            pxSequence->ullWindow |= 1U;
+            pxSequence->ulNext = ulSequenceNumber + 1U;
+        }
+        else
+        {
+            ulDistance = pxSequence->ulNext - 1U - ulSequenceNumber;
+
+            if( ( ulDistance < 64U ) && ( ( pxSequence->ullWindow & ( 1ULL << ulDistance ) ) != 0U ) )
+            {
+                pxSequence->ulDuplicates++;
+            }
+            else
+            {
+                /* A message older than the window is assumed not to be a
+                 * duplicate. */
+                if( ulDistance < 64U )
+                {
+                    pxSequence->ullWindow |= 1ULL << ulDistance;
+                }
+
+                pxSequence->ulReordered++;
+
+                if( pxSequence->ulMissing > 0U )
+                {
+                    pxSequence->ulMissing--;
+                }
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvLoadReport( TickType_t xInterval )
+    {
+        uint32_t ulMissing = 0, ulReordered = 0, ulDuplicates = 0, i;
+
+        taskENTER_CRITICAL();
+        {
+            xLoadReportStats = xLoadStats;
+            memset( &xLoadStats, 0x00, sizeof( xLoadStats ) );
+
+            for( i = 0; i < democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE; i++ )
+            {
+                ulMissing += xLoadSequences[ i ].ulMissing;
+                ulReordered += xLoadSequences[ i ].ulReordered;
+                ulDuplicates += xLoadSequences[ i ].ulDuplicates;
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        LogInfo( ( "Load over %lu ms: %lu sent, %lu received, %lu publish failures, %lu behind schedule.",
+                   ( unsigned long ) ( ( xInterval * 1000U ) / configTICK_RATE_HZ ),
+                   ( unsigned long ) xLoadReportStats.ulSent,
+                   ( unsigned long ) xLoadReportStats.xLatency.ulCount,
+                   ( unsigned long ) xLoadReportStats.ulPublishFailures,
+                   ( unsigned long ) xLoadReportStats.ulBehindSchedule ) );
+        LogInfo( ( "Load round trip time p50 %lu, p99 %lu, p99.9 %lu, max %lu; since start %lu missing, %lu reordered, %lu duplicates.",
+                   ( unsigned long ) ulLatencyHistogramPercentile( &( xLoadReportStats.xLatency ), 500U ),
+                   ( unsigned long ) ulLatencyHistogramPercentile( &( xLoadReportStats.xLatency ), 990U ),
+                   ( unsigned long ) ulLatencyHistogramPercentile( &( xLoadReportStats.xLatency ), 999U ),
+                   ( unsigned long ) xLoadReportStats.xLatency.ulMax,
+                   ( unsigned long ) ulMissing,
+                   ( unsigned long ) ulReordered,
+                   ( unsigned long ) ulDuplicates ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvLoadGeneratorTask( void * pvParameters )
+    {
+        extern UBaseType_t uxRand( void );
+        uint32_t ulTaskNumber = ( uint32_t ) ( uintptr_t ) pvParameters;
+        LoadPublish_t * pxPublishes = xLoadPublishes[ ulTaskNumber ];
+        LoadPublish_t * pxPublish;
+        char * pcTopicBuffer = topicBuf[ ulTaskNumber ];
+        MQTTAgentCommandInfo_t xCommandParams = { 0UL };
+        MQTTQoS_t xSubscribeQoS = MQTTQoS0;
+        uint32_t ulFreePublishes = ( 1UL << mqttexampleLOAD_MAX_IN_FLIGHT ) - 1UL;
+        uint32_t ulReleased = 0, ulSequenceNumber = 0, ulTimestamp, ulRandom, ulSlot, i;
+        uint64_t ullScheduled, ullConsumed = 0;
+        TickType_t xStartTime, xLastReportTime, xNow;
+
+        if( mqttexampleLOAD_QOS2_PERCENT > 0U )
+        {
+            xSubscribeQoS = MQTTQoS2;
+        }
+        else if( mqttexampleLOAD_QOS1_PERCENT > 0U )
+        {
+            xSubscribeQoS = MQTTQoS1;
+        }
+
+        /* Subscribe at the highest QoS published with, so each message is
+         * echoed back with the QoS it was published with. */
+        snprintf( pcTopicBuffer, mqttexampleSTRING_BUFFER_LENGTH, "/filter/Publisher%d", ( int ) ulTaskNumber );
+        prvSubscribeToTopic( xSubscribeQoS, pcTopicBuffer );
+
+        /* Fill the payloads once.  Only the header is rewritten for each
+         * publish. */
+        for( ulSlot = 0; ulSlot < mqttexampleLOAD_MAX_IN_FLIGHT; ulSlot++ )
+        {
+            pxPublish = &( pxPublishes[ ulSlot ] );
+
+            for( i = mqttexampleLOAD_HEADER_LENGTH; i < mqttexampleLOAD_MAX_PAYLOAD_LENGTH; i++ )
+            {
+                pxPublish->ucPayload[ i ] = ( uint8_t ) ( 'a' + ( i % 26U ) );
+            }
+
+            pxPublish->xPublishInfo.pTopicName = pcTopicBuffer;
+            pxPublish->xPublishInfo.topicNameLength = ( uint16_t ) strlen( pcTopicBuffer );
+            pxPublish->xPublishInfo.pPayload = pxPublish->ucPayload;
+            pxPublish->xCommandContext.xTaskToNotify = xTaskGetCurrentTaskHandle();
+            pxPublish->xCommandContext.ulNotificationValue = 1UL << ulSlot;
+        }
+
+        /* Don't wait for space in the command queue, so the task keeps to its
+         * schedule. */
+        xCommandParams.blockTimeMs = 0U;
+        xCommandParams.cmdCompleteCallback = prvLoadPublishCommandCallback;
+
+        /* Discard the notification value left by the subscribe, as the
+         * publishes set bits in it. */
+        xTaskNotifyStateClear( NULL );
+        ( void ) xTaskNotifyWait( UINT32_MAX, 0U, NULL, 0U );
+        xStartTime = xTaskGetTickCount();
+        xLastReportTime = xStartTime;
+
+        for( ; ; )
+        {
+            xNow = xTaskGetTickCount();
+            ullScheduled = ( ( uint64_t ) ( xNow - xStartTime ) * mqttexampleLOAD_MESSAGES_PER_SECOND ) /
+                           ( ( uint64_t ) configTICK_RATE_HZ * democonfigNUM_SIMPLE_SUB_PUB_TASKS_TO_CREATE );
+
+            if( ( ullScheduled - ullConsumed ) > mqttexampleLOAD_MAX_IN_FLIGHT )
+            {
+                taskENTER_CRITICAL();
+                {
+                    xLoadStats.ulBehindSchedule += ( uint32_t ) ( ullScheduled - ullConsumed - mqttexampleLOAD_MAX_IN_FLIGHT );
+                }
+                taskEXIT_CRITICAL();
+
+                ullConsumed = ullScheduled - mqttexampleLOAD_MAX_IN_FLIGHT;
+            }
+
+            while( ( ullConsumed < ullScheduled ) && ( ulFreePublishes != 0U ) )
+            {
+                for( ulSlot = 0; ( ulFreePublishes & ( 1UL << ulSlot ) ) == 0U; ulSlot++ )
+                {
+                }
+
+                pxPublish = &( pxPublishes[ ulSlot ] );
+                ulRandom = ( ( uint32_t ) uxRand() % 100U ) + 1U;
+
+                if( ulRandom <= mqttexampleLOAD_QOS2_PERCENT )
+                {
+                    pxPublish->xPublishInfo.qos = MQTTQoS2;
+                }
+                else if( ulRandom <= ( mqttexampleLOAD_QOS2_PERCENT + mqttexampleLOAD_QOS1_PERCENT ) )
+                {
+                    pxPublish->xPublishInfo.qos = MQTTQoS1;
+                }
+                else
+                {
+                    pxPublish->xPublishInfo.qos = MQTTQoS0;
+                }
+
+                pxPublish->xPublishInfo.payloadLength = prvLoadPayloadLength();
+
+                /* Write the header: task number, sequence number and send
+                 * time, most significant byte first. */
+                ulTimestamp = portGET_RUN_TIME_COUNTER_VALUE();
+
+                for( i = 0; i < 4U; i++ )
+                {
+                    pxPublish->ucPayload[ i ] = ( uint8_t ) ( ulTaskNumber >> ( 24U - ( i * 8U ) ) );
+                    pxPublish->ucPayload[ i + 4U ] = ( uint8_t ) ( ulSequenceNumber >> ( 24U - ( i * 8U ) ) );
+                    pxPublish->ucPayload[ i + 8U ] = ( uint8_t ) ( ulTimestamp >> ( 24U - ( i * 8U ) ) );
+                }
+
+                xCommandParams.pCmdCompleteCallbackContext = &( pxPublish->xCommandContext );
+
+                if( MQTTAgent_Publish( &xGlobalMqttAgentContext,
+                                       &( pxPublish->xPublishInfo ),
+                                       &xCommandParams ) != MQTTSuccess )
+                {
+                    /* The command queue or pool is full.  Try again on the
+                     * next tick. */
+                    break;
+                }
+
+                ulFreePublishes &= ~( 1UL << ulSlot );
+                ulSequenceNumber++;
+                ullConsumed++;
+
+                taskENTER_CRITICAL();
+                {
+                    xLoadStats.ulSent++;
+                }
+                taskEXIT_CRITICAL();
+            }
+
+            if( ( ulTaskNumber == 0U ) && ( ( xNow - xLastReportTime ) >= pdMS_TO_TICKS( mqttexampleLOAD_REPORT_INTERVAL_MS ) ) )
+            {
+                prvLoadReport( xNow - xLastReportTime );
+                xLastReportTime = xNow;
+            }
+
+            /* Wait for the next tick, or for publishes to complete. */
+            if( xTaskNotifyWait( 0U, UINT32_MAX, &ulReleased, 1U ) == pdTRUE )
+            {
+                ulFreePublishes |= ulReleased;
+            }
+        }
+    }
+
+#endif /* if ( democonfigSIMPLE_SUB_PUB_LOAD_MODE == 1 ) */
@@ -0,0 +1,1501 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file fleet_simulator.c
+ *
+ * @brief Simulator of a fleet of devices, run by one task as an event loop.
+ *
+ * Each device uses coreMQTT directly, with a transport of its own that reads
+ * from a buffer filled when the device's socket is readable and writes into a
+ * buffer sent once the device has been serviced.  MQTT_ProcessLoop() is only
+ * called with a whole packet in the receive buffer, so a call never waits for
+ * the rest of a packet and one slow device cannot hold up the others.  The
+ * exception is the connection, which coreMQTT establishes by waiting for the
+ * CONNACK, so while a device connects its transport uses the socket directly.
+ */
+
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleFleet
+
+/* Standard includes. */
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+/* Host includes. */
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Demo config. */
+#include "demo_config.h"
+#include "fleet_simulator_config.h"
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/* Exponential backoff retry include. */
+#include "backoff_algorithm.h"
+
+/* Sockets of the host. */
+#include "sockets_wrapper.h"
+
+/* Shadow, payload and statistics tools. */
+#include "shadow_cache.h"
+#include "shadow_request_table.h"
+#include "payload_template.h"
+#include "latency_histogram.h"
+
+/* Interface include. */
+#include "fleet_simulator.h"
+
+/**
+ * @brief Length of the longest client identifier, the prefix followed by up to
+ * ten digits.
+ */
+#define fleetsimMAX_CLIENT_IDENTIFIER_LENGTH    ( sizeof( fleetsimconfigCLIENT_IDENTIFIER_PREFIX ) - 1U + 10U )
+
+/**
+ * @brief Size of the buffer the topic names and filters of a device are
+ * written into.
+ */
+#define fleetsimMAX_TOPIC_LENGTH                ( fleetsimMAX_CLIENT_IDENTIFIER_LENGTH + 40U )
+
+/**
+ * @brief The topics of the classic shadow of a device, formatted with its
+ * client identifier as the thing name.  The devices subscribe to the update
+ * responses with one wildcard filter.
+ */
+#define fleetsimSHADOW_UPDATE_TOPIC_FORMAT      "$aws/things/%s/shadow/update"
+#define fleetsimSHADOW_RESPONSE_FILTER_FORMAT   "$aws/things/%s/shadow/update/+"
+
+/**
+ * @brief The topic of the telemetry of a device, and the telemetry it sends.
+ */
+#define fleetsimTELEMETRY_TOPIC_FORMAT          "%s/telemetry"
+#define fleetsimTELEMETRY_PATTERN               "{\"sequence\":%u,\"temperature\":%u,\"powerOn\":%u,\"uptime\":%u}"
+#define fleetsimTELEMETRY_BUFFER_LENGTH         ( 128U )
+
+/**
+ * @brief Size of the buffer a shadow update is built in.
+ */
+#define fleetsimSHADOW_UPDATE_BUFFER_LENGTH     ( 128U )
+
+/**
+ * @brief Time between the keep-alive checks of a device that has nothing to
+ * receive, and the time the send buffer of a device may stay full before the
+ * device is disconnected.
+ */
+#define fleetsimKEEP_ALIVE_CHECK_MS             ( 1000U )
+#define fleetsimSEND_TIMEOUT_MS                 ( 1000U )
+
+/**
+ * @brief The backoff between the attempts of a device to connect.  The
+ * attempts start again from the base once the maximum number is reached.
+ */
+#define fleetsimRETRY_MAX_ATTEMPTS              ( 10U )
+#define fleetsimRETRY_BACKOFF_BASE_MS           ( 500U )
+#define fleetsimRETRY_MAX_BACKOFF_DELAY_MS      ( 30000U )
+
+/**
+ * @brief The setpoint a device starts with, and the range its temperature
+ * moves around the setpoint in.
+ */
+#define fleetsimINITIAL_SETPOINT                ( 20U )
+#define fleetsimTEMPERATURE_RANGE               ( 3U )
+
+/**
+ * @brief Index of each property in #xShadowProperties.
+ */
+#define fleetsimPOWER_ON_PROPERTY               ( 0U )
+#define fleetsimSETPOINT_PROPERTY               ( 1U )
+
+#if ( fleetsimconfigTELEMETRY_QOS > 1U )
+    #error "fleetsimconfigTELEMETRY_QOS must be 0 or 1."
+#endif
+
+#if ( fleetsimconfigTELEMETRY_JITTER_PERCENT > 100U )
+    #error "fleetsimconfigTELEMETRY_JITTER_PERCENT must be at most 100."
+#endif
+
+#if ( fleetsimconfigMAX_OUTSTANDING_PUBLISHES < 1U )
+    #error "fleetsimconfigMAX_OUTSTANDING_PUBLISHES must be at least 1."
+#endif
+
+/**
+ * @brief The connection state of a device.
+ */
+typedef enum
+{
+    eFleetDeviceDisconnected = 0, /**< Waiting for its next attempt to connect. */
+    eFleetDeviceConnected
+} FleetDeviceState_t;
+
+/**
+ * @brief A QoS 1 publish waiting for its PUBACK.
+ */
+typedef struct FleetPublish
+{
+    uint16_t usPacketId; /**< 0 if the slot is free. */
+    uint32_t ulSentTime; /**< Run time counter when the publish was sent. */
+} FleetPublish_t;
+
+/**
+ * @brief The transport of a device.  Bytes are read from the socket into
+ * ucReceiveBuffer by the event loop, and bytes written by coreMQTT are held in
+ * ucSendBuffer until the device has been serviced.
+ */
+struct NetworkContext
+{
+    Socket_t xSocket;
+    BaseType_t xDirect;         /**< pdTRUE while connecting, when the socket is read and written directly. */
+    BaseType_t xFailed;         /**< The socket had an error or was closed by the broker. */
+    size_t xReceiveStart;       /**< Offset of the first unread byte in ucReceiveBuffer. */
+    size_t xReceiveEnd;         /**< Offset after the last byte read into ucReceiveBuffer. */
+    size_t xSendLength;         /**< Bytes waiting in ucSendBuffer. */
+    uint8_t ucReceiveBuffer[ fleetsimconfigRECEIVE_BUFFER_SIZE ];
+    uint8_t ucSendBuffer[ fleetsimconfigSEND_BUFFER_SIZE ];
+};
+
+/**
+ * @brief The state of one simulated device.  xMqttContext is the first member
+ * so the device of the context passed to the event callback is found with a
+ * cast.
+ */
+typedef struct FleetDevice
+{
+    MQTTContext_t xMqttContext;
+    NetworkContext_t xNetworkContext;
+    uint8_t ucNetworkBuffer[ fleetsimconfigNETWORK_BUFFER_SIZE ];
+    char cClientIdentifier[ fleetsimMAX_CLIENT_IDENTIFIER_LENGTH + 1U ];
+    FleetDeviceState_t eState;
+    BackoffAlgorithmContext_t xReconnectParams;
+    TickType_t xNextConnectTime;
+    TickType_t xConnectTime;
+    TickType_t xNextTelemetryTime;
+    TickType_t xNextChangeTime;
+    TickType_t xNextKeepAliveTime;
+    uint32_t ulTelemetrySequence;
+    ShadowCache_t xShadowCache;
+    ShadowRequestTable_t xShadowRequests;
+    FleetPublish_t xOutstanding[ fleetsimconfigMAX_OUTSTANDING_PUBLISHES ];
+    uint32_t ulLatencyCount; /**< QoS 1 publishes acknowledged since the last report. */
+    uint32_t ulMaxLatency;   /**< Longest round trip time since the last report. */
+    uint64_t ullLatencySum;  /**< Sum of the round trip times since the last report. */
+} FleetDevice_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The task that runs the event loop of the fleet.
+ */
+static void prvFleetSimulatorTask( void * pvParameters );
+
+/**
+ * @brief Set up the devices, the telemetry template and the epoll instance.
+ *
+ * @return pdPASS if the fleet is ready to run, else pdFAIL.
+ */
+static BaseType_t prvInitFleet( void );
+
+/**
+ * @brief Connect a device to the broker and subscribe to its shadow
+ * responses.  Schedules the next attempt if the connection fails.
+ */
+static void prvConnectDevice( FleetDevice_t * pxDevice,
+                              TickType_t xNow );
+
+/**
+ * @brief Close the connection of a device and schedule its reconnection.
+ */
+static void prvDisconnectDevice( FleetDevice_t * pxDevice,
+                                 TickType_t xNow );
+
+/**
+ * @brief Set the time of the next attempt of a device to connect.
+ */
+static void prvScheduleReconnect( FleetDevice_t * pxDevice,
+                                  TickType_t xNow );
+
+/**
+ * @brief Process the packets received by a device, send its telemetry and
+ * shadow updates when they are due, then send the bytes it wrote.
+ */
+static void prvServiceDevice( FleetDevice_t * pxDevice,
+                              TickType_t xNow );
+
+/**
+ * @brief Publish the next telemetry message of a device.
+ *
+ * @return The status of MQTT_Publish(), or MQTTSuccess if the message was
+ * skipped.
+ */
+static MQTTStatus_t prvSendTelemetry( FleetDevice_t * pxDevice,
+                                      TickType_t xNow );
+
+/**
+ * @brief Publish the shadow update of a device if the coalescing window of its
+ * pending changes has closed.
+ *
+ * @return The status of MQTT_Publish(), or MQTTSuccess if nothing was sent.
+ */
+static MQTTStatus_t prvSendShadowUpdate( FleetDevice_t * pxDevice );
+
+/**
+ * @brief Change the state of a device at random, as if it was operated
+ * locally.
+ */
+static void prvChangeDeviceState( FleetDevice_t * pxDevice );
+
+/**
+ * @brief Called by coreMQTT for each packet a device receives.
+ */
+static void prvEventCallback( MQTTContext_t * pxMqttContext,
+                              MQTTPacketInfo_t * pxPacketInfo,
+                              MQTTDeserializedInfo_t * pxDeserializedInfo );
+
+/**
+ * @brief Pass a publish received on the shadow response topics of a device to
+ * its shadow.
+ */
+static void prvHandleShadowPublish( FleetDevice_t * pxDevice,
+                                    const MQTTPublishInfo_t * pxPublishInfo );
+
+/**
+ * @brief Called by the shadow request table when an update of a device
+ * completes.
+ */
+static void prvShadowUpdateCompleteCallback( void * pvContext,
+                                             uint32_t ulClientToken,
+                                             ShadowRequestType_t eType,
+                                             const ShadowResponse_t * pxResponse );
+
+/**
+ * @brief Find a free slot for a QoS 1 publish of a device.
+ *
+ * @return The slot, or NULL if fleetsimconfigMAX_OUTSTANDING_PUBLISHES
+ * publishes are waiting for a PUBACK.
+ */
+static FleetPublish_t * prvGetPublishSlot( FleetDevice_t * pxDevice );
+
+/**
+ * @brief Transport functions of the devices, see transport_interface.h.
+ */
+static int32_t prvTransportRecv( NetworkContext_t * pxNetworkContext,
+                                 void * pvBuffer,
+                                 size_t xBytesToRecv );
+static int32_t prvTransportSend( NetworkContext_t * pxNetworkContext,
+                                 const void * pvBuffer,
+                                 size_t xBytesToSend );
+
+/**
+ * @brief Read what the socket of a device holds into its receive buffer.
+ */
+static void prvReadSocket( NetworkContext_t * pxNetworkContext );
+
+/**
+ * @brief Send the bytes in the send buffer of a device.
+ *
+ * @param[in] pxNetworkContext The transport of the device.
+ * @param[in] xWait pdTRUE to wait for the socket to become writable until
+ * the buffer is sent, pdFALSE to send what the socket accepts now.
+ */
+static void prvFlushSocket( NetworkContext_t * pxNetworkContext,
+                            BaseType_t xWait );
+
+/**
+ * @brief Check whether the receive buffer of a device holds a whole packet.
+ */
+static BaseType_t prvPacketReceived( const NetworkContext_t * pxNetworkContext );
+
+/**
+ * @brief Return the current time in milliseconds, for coreMQTT.
+ */
+static uint32_t prvGetTimeMs( void );
+
+/**
+ * @brief Return pdTRUE if xTime is not after xNow.
+ */
+static BaseType_t prvIsDue( TickType_t xNow,
+                            TickType_t xTime );
+
+/**
+ * @brief Return an interval moved at random by up to ulPercent percent.
+ */
+static TickType_t prvJitteredTicks( uint32_t ulIntervalMs,
+                                    uint32_t ulPercent );
+
+/**
+ * @brief Record the round trip time of a publish.
+ */
+static void prvRecordLatency( FleetDevice_t * pxDevice,
+                              uint32_t ulLatency );
+
+/**
+ * @brief Return a count over an interval as a count per second.
+ */
+static uint32_t prvPerSecond( uint64_t ullCount,
+                              TickType_t xInterval );
+
+/**
+ * @brief Log the summary of the fleet since the previous one.
+ */
+static void prvReport( TickType_t xInterval );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The shadow properties of every device.
+ */
+static const ShadowCacheProperty_t xShadowProperties[] =
+{
+    shadowcachePROPERTY( "powerOn" ),
+    shadowcachePROPERTY( "setpoint" )
+};
+
+/**
+ * @brief The devices.  Only accessed by the simulator task.
+ */
+static FleetDevice_t xDevices[ fleetsimconfigDEVICE_COUNT ];
+
+/**
+ * @brief The epoll instance the sockets of the connected devices are
+ * registered with.
+ */
+static int lEpollFd = -1;
+
+/**
+ * @brief The telemetry message, compiled once and filled in for each device.
+ */
+static PayloadTemplate_t xTelemetryTemplate;
+static char cTelemetryBuffer[ fleetsimTELEMETRY_BUFFER_LENGTH ];
+
+/**
+ * @brief Topic names and filters are written here while a packet is
+ * serialized, as coreMQTT does not need them afterwards.
+ */
+static char cTopicBuffer[ fleetsimMAX_TOPIC_LENGTH ];
+
+/**
+ * @brief The counters, written only by the simulator task, and their values at
+ * the last report.
+ */
+static FleetSimulatorStats_t xStats;
+static FleetSimulatorStats_t xReportedStats;
+
+/**
+ * @brief Round trip times of the QoS 1 publishes since the last report.
+ */
+static LatencyHistogram_t xLatency;
+
+/*-----------------------------------------------------------*/
+
+void vStartFleetSimulator( configSTACK_DEPTH_TYPE uxStackSize,
+                           UBaseType_t uxPriority )
+{
+    xTaskCreate( prvFleetSimulatorTask,
+                 "FleetSim",
+                 uxStackSize,
+                 NULL,
+                 uxPriority,
+                 NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vFleetSimulatorGetStats( FleetSimulatorStats_t * pxStats )
+{
+    configASSERT( pxStats != NULL );
+
+    /* The simulator task is not preempted part way through updating a
+     * counter while the copy is made. */
+    taskENTER_CRITICAL();
+    {
+        *pxStats = xStats;
+    }
+    taskEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+static void prvFleetSimulatorTask( void * pvParameters )
+{
+    static struct epoll_event xEvents[ fleetsimconfigMAX_EVENTS_PER_POLL ];
+    TickType_t xNow, xLastTime, xLastReportTime;
+    const TickType_t xReportInterval = pdMS_TO_TICKS( fleetsimconfigREPORT_INTERVAL_MS );
+    const TickType_t xConnectCost = configTICK_RATE_HZ;
+    TickType_t xConnectCredit = 0;
+    FleetDevice_t * pxDevice;
+    int lEvents, i;
+    uint32_t ulDevice;
+
+    ( void ) pvParameters;
+
+    if( prvInitFleet() != pdPASS )
+    {
+        vTaskDelete( NULL );
+    }
+
+    LogInfo( ( "Starting %u devices, connecting %u per second to %s:%u.",
+               ( unsigned int ) fleetsimconfigDEVICE_COUNT,
+               ( unsigned int ) fleetsimconfigCONNECTS_PER_SECOND,
+               democonfigMQTT_BROKER_ENDPOINT,
+               ( unsigned int ) democonfigMQTT_BROKER_PORT ) );
+
+    xLastTime = xTaskGetTickCount();
+    xLastReportTime = xLastTime;
+
+    for( ; ; )
+    {
+        xNow = xTaskGetTickCount();
+
+        /* Connections are paced by a credit that grows by
+         * fleetsimconfigCONNECTS_PER_SECOND every second, up to one second's
+         * worth, and a connection attempt spends one tick rate of it. */
+        xConnectCredit += ( TickType_t ) ( xNow - xLastTime ) * fleetsimconfigCONNECTS_PER_SECOND;
+
+        if( xConnectCredit > ( xConnectCost * fleetsimconfigCONNECTS_PER_SECOND ) )
+        {
+            xConnectCredit = xConnectCost * fleetsimconfigCONNECTS_PER_SECOND;
+        }
+
+        xLastTime = xNow;
+
+        /* Read from every socket that has data, without waiting. */
+        lEvents = epoll_wait( lEpollFd, xEvents, ( int ) fleetsimconfigMAX_EVENTS_PER_POLL, 0 );
+
+        for( i = 0; i < lEvents; i++ )
+        {
+            pxDevice = ( FleetDevice_t * ) xEvents[ i ].data.ptr;
+
+            if( pxDevice->eState == eFleetDeviceConnected )
+            {
+                prvReadSocket( &( pxDevice->xNetworkContext ) );
+            }
+        }
+
+        for( ulDevice = 0; ulDevice < fleetsimconfigDEVICE_COUNT; ulDevice++ )
+        {
+            pxDevice = &( xDevices[ ulDevice ] );
+
+            if( pxDevice->eState == eFleetDeviceConnected )
+            {
+                prvServiceDevice( pxDevice, xNow );
+            }
+            else if( ( xConnectCredit >= xConnectCost ) && ( prvIsDue( xNow, pxDevice->xNextConnectTime ) == pdTRUE ) )
+            {
+                xConnectCredit -= xConnectCost;
+                prvConnectDevice( pxDevice, xNow );
+            }
+            else
+            {
+                /* Waiting to reconnect. */
+            }
+        }
+
+        if( ( TickType_t ) ( xNow - xLastReportTime ) >= xReportInterval )
+        {
+            prvReport( ( TickType_t ) ( xNow - xLastReportTime ) );
+            xLastReportTime = xNow;
+        }
+
+        /* A full batch of events means more sockets are probably readable, so
+         * go round again straight away.  Otherwise let the other tasks run,
+         * as the POSIX port must not block in a system call. */
+        if( lEvents < ( int ) fleetsimconfigMAX_EVENTS_PER_POLL )
+        {
+            vTaskDelay( 1U );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvInitFleet( void )
+{
+    BaseType_t xStatus = pdPASS;
+    FleetDevice_t * pxDevice;
+    uint32_t ulDevice;
+
+    lEpollFd = epoll_create1( EPOLL_CLOEXEC );
+
+    if( lEpollFd < 0 )
+    {
+        LogError( ( "Failed to create the epoll instance of the fleet, errno %d.", errno ) );
+        xStatus = pdFAIL;
+    }
+    else if( ePayloadTemplateCompile( &xTelemetryTemplate,
+                                      fleetsimTELEMETRY_PATTERN,
+                                      cTelemetryBuffer,
+                                      sizeof( cTelemetryBuffer ) ) != ePayloadTemplateSuccess )
+    {
+        LogError( ( "Failed to compile the telemetry template of the fleet." ) );
+        xStatus = pdFAIL;
+    }
+    else
+    {
+        for( ulDevice = 0; ( ulDevice < fleetsimconfigDEVICE_COUNT ) && ( xStatus == pdPASS ); ulDevice++ )
+        {
+            pxDevice = &( xDevices[ ulDevice ] );
+
+            ( void ) snprintf( pxDevice->cClientIdentifier,
+                               sizeof( pxDevice->cClientIdentifier ),
+                               "%s%lu",
+                               fleetsimconfigCLIENT_IDENTIFIER_PREFIX,
+                               ( unsigned long ) ulDevice );
+            pxDevice->xNetworkContext.xSocket = SOCKETS_INVALID_SOCKET;
+            pxDevice->eState = eFleetDeviceDisconnected;
+
+            BackoffAlgorithm_InitializeParams( &( pxDevice->xReconnectParams ),
+                                               fleetsimRETRY_BACKOFF_BASE_MS,
+                                               fleetsimRETRY_MAX_BACKOFF_DELAY_MS,
+                                               fleetsimRETRY_MAX_ATTEMPTS );
+
+            if( ( eShadowCacheInit( &( pxDevice->xShadowCache ),
+                                    xShadowProperties,
+                                    sizeof( xShadowProperties ) / sizeof( xShadowProperties[ 0 ] ),
+                                    fleetsimconfigSHADOW_COALESCING_WINDOW_MS ) != eShadowCacheSuccess ) ||
+                ( eShadowRequestTableInit( &( pxDevice->xShadowRequests ), 0U ) != eShadowRequestSuccess ) )
+            {
+                LogError( ( "Failed to initialize the shadow of device %s.", pxDevice->cClientIdentifier ) );
+                xStatus = pdFAIL;
+            }
+            else
+            {
+                vShadowCacheSetLocal( &( pxDevice->xShadowCache ), fleetsimPOWER_ON_PROPERTY, 1U );
+                vShadowCacheSetLocal( &( pxDevice->xShadowCache ), fleetsimSETPOINT_PROPERTY, fleetsimINITIAL_SETPOINT );
+            }
+        }
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void prvConnectDevice( FleetDevice_t * pxDevice,
+                              TickType_t xNow )
+{
+    NetworkContext_t * pxNetworkContext = &( pxDevice->xNetworkContext );
+    TransportInterface_t xTransport;
+    MQTTFixedBuffer_t xFixedBuffer;
+    MQTTConnectInfo_t xConnectInfo;
+    MQTTSubscribeInfo_t xSubscribeInfo;
+    struct epoll_event xEvent;
+    MQTTStatus_t xResult = MQTTSuccess;
+    bool xSessionPresent = false;
+    BaseType_t xSocketConnected = pdFALSE;
+
+    extern UBaseType_t uxRand( void );
+
+    pxNetworkContext->xReceiveStart = 0U;
+    pxNetworkContext->xReceiveEnd = 0U;
+    pxNetworkContext->xSendLength = 0U;
+    pxNetworkContext->xFailed = pdFALSE;
+
+    /* coreMQTT waits for the CONNACK, so the transport uses the socket
+     * directly until the device is connected and subscribed. */
+    pxNetworkContext->xDirect = pdTRUE;
+
+    if( Sockets_Connect( &( pxNetworkContext->xSocket ),
+                         democonfigMQTT_BROKER_ENDPOINT,
+                         democonfigMQTT_BROKER_PORT,
+                         fleetsimconfigCONNECT_TIMEOUT_MS ) != 0 )
+    {
+        xResult = MQTTSendFailed;
+    }
+    else
+    {
+        xSocketConnected = pdTRUE;
+
+        xTransport.pNetworkContext = pxNetworkContext;
+        xTransport.send = prvTransportSend;
+        xTransport.recv = prvTransportRecv;
+
+        xFixedBuffer.pBuffer = pxDevice->ucNetworkBuffer;
+        xFixedBuffer.size = sizeof( pxDevice->ucNetworkBuffer );
+
+        /* The context is initialized again for each connection as the
+         * session is not resumed. */
+        xResult = MQTT_Init( &( pxDevice->xMqttContext ),
+                             &xTransport,
+                             prvGetTimeMs,
+                             prvEventCallback,
+                             &xFixedBuffer );
+    }
+
+    if( xResult == MQTTSuccess )
+    {
+        memset( &xConnectInfo, 0x00, sizeof( xConnectInfo ) );
+        xConnectInfo.cleanSession = true;
+        xConnectInfo.pClientIdentifier = pxDevice->cClientIdentifier;
+        xConnectInfo.clientIdentifierLength = ( uint16_t ) strlen( pxDevice->cClientIdentifier );
+        xConnectInfo.keepAliveSeconds = fleetsimconfigKEEP_ALIVE_SECONDS;
+
+        xResult = MQTT_Connect( &( pxDevice->xMqttContext ),
+                                &xConnectInfo,
+                                NULL,
+                                fleetsimconfigCONNECT_TIMEOUT_MS,
+                                &xSessionPresent );
+    }
+
+    if( xResult == MQTTSuccess )
+    {
+        /* The SUBACK is processed by the event loop. */
+        ( void ) snprintf( cTopicBuffer, sizeof( cTopicBuffer ), fleetsimSHADOW_RESPONSE_FILTER_FORMAT, pxDevice->cClientIdentifier );
+        xSubscribeInfo.qos = MQTTQoS1;
+        xSubscribeInfo.pTopicFilter = cTopicBuffer;
+        xSubscribeInfo.topicFilterLength = ( uint16_t ) strlen( cTopicBuffer );
+
+        xResult = MQTT_Subscribe( &( pxDevice->xMqttContext ),
+                                  &xSubscribeInfo,
+                                  1U,
+                                  MQTT_GetPacketId( &( pxDevice->xMqttContext ) ) );
+    }
+
+    if( xResult == MQTTSuccess )
+    {
+        xEvent.events = EPOLLIN;
+        xEvent.data.ptr = pxDevice;
+
+        if( epoll_ctl( lEpollFd, EPOLL_CTL_ADD, pxNetworkContext->xSocket, &xEvent ) != 0 )
+        {
+            LogError( ( "Failed to add the socket of device %s to the epoll instance, errno %d.",
+                        pxDevice->cClientIdentifier,
+                        errno ) );
+            xResult = MQTTSendFailed;
+        }
+    }
+
+    if( xResult == MQTTSuccess )
+    {
+        pxNetworkContext->xDirect = pdFALSE;
+        pxDevice->eState = eFleetDeviceConnected;
+        pxDevice->xConnectTime = xNow;
+        memset( pxDevice->xOutstanding, 0x00, sizeof( pxDevice->xOutstanding ) );
+
+        /* The first message is sent at a random point in the interval so the
+         * devices that connect together do not publish together. */
+        pxDevice->xNextTelemetryTime = xNow + ( TickType_t ) ( uxRand() % ( pdMS_TO_TICKS( fleetsimconfigTELEMETRY_INTERVAL_MS ) + 1U ) );
+        pxDevice->xNextChangeTime = xNow + prvJitteredTicks( fleetsimconfigSHADOW_CHANGE_INTERVAL_MS, 50U );
+        pxDevice->xNextKeepAliveTime = xNow + pdMS_TO_TICKS( fleetsimKEEP_ALIVE_CHECK_MS );
+
+        BackoffAlgorithm_InitializeParams( &( pxDevice->xReconnectParams ),
+                                           fleetsimRETRY_BACKOFF_BASE_MS,
+                                           fleetsimRETRY_MAX_BACKOFF_DELAY_MS,
+                                           fleetsimRETRY_MAX_ATTEMPTS );
+
+        xStats.ulConnectedDevices++;
+        xStats.ulConnects++;
+    }
+    else
+    {
+        LogDebug( ( "Device %s failed to connect, status %s.",
+                    pxDevice->cClientIdentifier,
+                    MQTT_Status_strerror( xResult ) ) );
+        xStats.ulConnectFailures++;
+
+        if( xSocketConnected == pdTRUE )
+        {
+            ( void ) close( pxNetworkContext->xSocket );
+            pxNetworkContext->xSocket = SOCKETS_INVALID_SOCKET;
+        }
+
+        prvScheduleReconnect( pxDevice, xNow );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvDisconnectDevice( FleetDevice_t * pxDevice,
+                                 TickType_t xNow )
+{
+    NetworkContext_t * pxNetworkContext = &( pxDevice->xNetworkContext );
+
+    ( void ) epoll_ctl( lEpollFd, EPOLL_CTL_DEL, pxNetworkContext->xSocket, NULL );
+
+    /* Closed without the graceful shutdown of Sockets_Disconnect(), which
+     * waits for the broker to close its side and would hold up the other
+     * devices. */
+    ( void ) close( pxNetworkContext->xSocket );
+    pxNetworkContext->xSocket = SOCKETS_INVALID_SOCKET;
+
+    pxDevice->eState = eFleetDeviceDisconnected;
+    xStats.ulConnectedDevices--;
+    xStats.ulDisconnects++;
+
+    prvScheduleReconnect( pxDevice, xNow );
+}
+/*-----------------------------------------------------------*/
+
+static void prvScheduleReconnect( FleetDevice_t * pxDevice,
+                                  TickType_t xNow )
+{
+    uint16_t usNextRetryBackOff = 0U;
+
+    extern UBaseType_t uxRand( void );
+
+    if( BackoffAlgorithm_GetNextBackoff( &( pxDevice->xReconnectParams ),
+                                         ( uint32_t ) uxRand(),
+                                         &usNextRetryBackOff ) != BackoffAlgorithmSuccess )
+    {
+        /* Devices never give up, so start again from the base. */
+        BackoffAlgorithm_InitializeParams( &( pxDevice->xReconnectParams ),
+                                           fleetsimRETRY_BACKOFF_BASE_MS,
+                                           fleetsimRETRY_MAX_BACKOFF_DELAY_MS,
+                                           fleetsimRETRY_MAX_ATTEMPTS );
+        usNextRetryBackOff = fleetsimRETRY_MAX_BACKOFF_DELAY_MS;
+    }
+
+    pxDevice->xNextConnectTime = xNow + pdMS_TO_TICKS( usNextRetryBackOff );
+}
+/*-----------------------------------------------------------*/
+
+static void prvServiceDevice( FleetDevice_t * pxDevice,
+                              TickType_t xNow )
+{
+    NetworkContext_t * pxNetworkContext = &( pxDevice->xNetworkContext );
+    MQTTStatus_t xResult = MQTTSuccess;
+
+    /* Each call processes one packet, and is only made with a whole packet
+     * buffered so it never waits for the rest of one. */
+    while( ( xResult == MQTTSuccess ) && ( prvPacketReceived( pxNetworkContext ) == pdTRUE ) )
+    {
+        xResult = MQTT_ProcessLoop( &( pxDevice->xMqttContext ), 0U );
+    }
+
+    if( ( xResult == MQTTSuccess ) &&
+        ( ( pxNetworkContext->xReceiveEnd - pxNetworkContext->xReceiveStart ) == sizeof( pxNetworkContext->ucReceiveBuffer ) ) )
+    {
+        LogError( ( "Device %s received a packet larger than its receive buffer.", pxDevice->cClientIdentifier ) );
+        pxNetworkContext->xFailed = pdTRUE;
+    }
+
+    /* With nothing buffered, the process loop sends a PINGREQ if the
+     * connection has been idle for the keep-alive interval, and fails if the
+     * PINGRESP is late. */
+    if( ( xResult == MQTTSuccess ) &&
+        ( prvIsDue( xNow, pxDevice->xNextKeepAliveTime ) == pdTRUE ) &&
+        ( pxNetworkContext->xReceiveStart == pxNetworkContext->xReceiveEnd ) )
+    {
+        xResult = MQTT_ProcessLoop( &( pxDevice->xMqttContext ), 0U );
+        pxDevice->xNextKeepAliveTime = xNow + pdMS_TO_TICKS( fleetsimKEEP_ALIVE_CHECK_MS );
+    }
+
+    if( ( xResult == MQTTSuccess ) && ( prvIsDue( xNow, pxDevice->xNextTelemetryTime ) == pdTRUE ) )
+    {
+        xResult = prvSendTelemetry( pxDevice, xNow );
+        pxDevice->xNextTelemetryTime = xNow + prvJitteredTicks( fleetsimconfigTELEMETRY_INTERVAL_MS,
+                                                                fleetsimconfigTELEMETRY_JITTER_PERCENT );
+    }
+
+    if( prvIsDue( xNow, pxDevice->xNextChangeTime ) == pdTRUE )
+    {
+        prvChangeDeviceState( pxDevice );
+        pxDevice->xNextChangeTime = xNow + prvJitteredTicks( fleetsimconfigSHADOW_CHANGE_INTERVAL_MS, 50U );
+    }
+
+    /* Complete the updates whose response did not arrive in time, which lets
+     * the changes made since be sent. */
+    ( void ) xShadowRequestProcessTimeouts( &( pxDevice->xShadowRequests ) );
+
+    if( ( xResult == MQTTSuccess ) && ( xShadowCacheGetTicksUntilUpdate( &( pxDevice->xShadowCache ) ) == 0U ) )
+    {
+        xResult = prvSendShadowUpdate( pxDevice );
+    }
+
+    /* Send everything the device wrote while it was serviced in one go. */
+    if( xResult == MQTTSuccess )
+    {
+        prvFlushSocket( pxNetworkContext, pdFALSE );
+    }
+
+    if( ( xResult != MQTTSuccess ) || ( pxNetworkContext->xFailed == pdTRUE ) )
+    {
+        LogDebug( ( "Device %s lost its connection, status %s.",
+                    pxDevice->cClientIdentifier,
+                    MQTT_Status_strerror( xResult ) ) );
+        prvDisconnectDevice( pxDevice, xNow );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t prvSendTelemetry( FleetDevice_t * pxDevice,
+                                      TickType_t xNow )
+{
+    MQTTPublishInfo_t xPublishInfo;
+    FleetPublish_t * pxSlot = NULL;
+    MQTTStatus_t xResult = MQTTSuccess;
+    uint16_t usPacketId = 0U;
+    uint32_t ulTemperature;
+
+    extern UBaseType_t uxRand( void );
+
+    #if ( fleetsimconfigTELEMETRY_QOS == 1U )
+        {
+            pxSlot = prvGetPublishSlot( pxDevice );
+        }
+    #endif
+
+    if( ( fleetsimconfigTELEMETRY_QOS == 1U ) && ( pxSlot == NULL ) )
+    {
+        xStats.ulTelemetrySkipped++;
+    }
+    else
+    {
+        ulTemperature = ulShadowCacheGetLocal( &( pxDevice->xShadowCache ), fleetsimSETPOINT_PROPERTY ) +
+                        ( ( uint32_t ) uxRand() % fleetsimTEMPERATURE_RANGE );
+
+        ( void ) ePayloadTemplateSetNumber( &xTelemetryTemplate, 0U, pxDevice->ulTelemetrySequence );
+        ( void ) ePayloadTemplateSetNumber( &xTelemetryTemplate, 1U, ulTemperature );
+        ( void ) ePayloadTemplateSetNumber( &xTelemetryTemplate, 2U, ulShadowCacheGetLocal( &( pxDevice->xShadowCache ), fleetsimPOWER_ON_PROPERTY ) );
+        ( void ) ePayloadTemplateSetNumber( &xTelemetryTemplate, 3U, ( uint32_t ) ( ( TickType_t ) ( xNow - pxDevice->xConnectTime ) / configTICK_RATE_HZ ) );
+
+        ( void ) snprintf( cTopicBuffer, sizeof( cTopicBuffer ), fleetsimTELEMETRY_TOPIC_FORMAT, pxDevice->cClientIdentifier );
+
+        memset( &xPublishInfo, 0x00, sizeof( xPublishInfo ) );
+        xPublishInfo.qos = ( MQTTQoS_t ) fleetsimconfigTELEMETRY_QOS;
+        xPublishInfo.pTopicName = cTopicBuffer;
+        xPublishInfo.topicNameLength = ( uint16_t ) strlen( cTopicBuffer );
+        xPublishInfo.pPayload = xTelemetryTemplate.pcPayload;
+        xPublishInfo.payloadLength = xTelemetryTemplate.xLength;
+
+        if( pxSlot != NULL )
+        {
+            usPacketId = MQTT_GetPacketId( &( pxDevice->xMqttContext ) );
+        }
+
+        xResult = MQTT_Publish( &( pxDevice->xMqttContext ), &xPublishInfo, usPacketId );
+
+        if( xResult == MQTTSuccess )
+        {
+            pxDevice->ulTelemetrySequence++;
+            xStats.ulPublishesSent++;
+
+            if( pxSlot != NULL )
+            {
+                pxSlot->usPacketId = usPacketId;
+                pxSlot->ulSentTime = ( uint32_t ) portGET_RUN_TIME_COUNTER_VALUE();
+            }
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t prvSendShadowUpdate( FleetDevice_t * pxDevice )
+{
+    static char cUpdateDocument[ fleetsimSHADOW_UPDATE_BUFFER_LENGTH ];
+    MQTTPublishInfo_t xPublishInfo;
+    FleetPublish_t * pxSlot;
+    MQTTStatus_t xResult = MQTTSuccess;
+    eShadowCacheStatus eCacheStatus = eShadowCacheNoUpdate;
+    uint32_t ulClientToken = 0U;
+    size_t xUpdateLength = 0U;
+    uint16_t usPacketId;
+
+    /* The update waits for a free slot if too many publishes are waiting for
+     * a PUBACK.  The cache only lets one update wait for a response at a
+     * time, so the request table is not full unless updates are leaked. */
+    pxSlot = prvGetPublishSlot( pxDevice );
+
+    if( ( pxSlot != NULL ) &&
+        ( eShadowRequestAdd( &( pxDevice->xShadowRequests ),
+                             ShadowRequestUpdate,
+                             fleetsimconfigSHADOW_RESPONSE_TIMEOUT_MS,
+                             prvShadowUpdateCompleteCallback,
+                             pxDevice,
+                             &ulClientToken ) == eShadowRequestSuccess ) )
+    {
+        eCacheStatus = eShadowCacheBuildUpdate( &( pxDevice->xShadowCache ),
+                                                ulClientToken,
+                                                cUpdateDocument,
+                                                sizeof( cUpdateDocument ),
+                                                &xUpdateLength );
+
+        if( eCacheStatus != eShadowCacheSuccess )
+        {
+            /* Nothing will be sent with the token. */
+            ( void ) eShadowRequestCancel( &( pxDevice->xShadowRequests ), ulClientToken );
+        }
+    }
+
+    if( eCacheStatus == eShadowCacheSuccess )
+    {
+        ( void ) snprintf( cTopicBuffer, sizeof( cTopicBuffer ), fleetsimSHADOW_UPDATE_TOPIC_FORMAT, pxDevice->cClientIdentifier );
+
+        memset( &xPublishInfo, 0x00, sizeof( xPublishInfo ) );
+        xPublishInfo.qos = MQTTQoS1;
+        xPublishInfo.pTopicName = cTopicBuffer;
+        xPublishInfo.topicNameLength = ( uint16_t ) strlen( cTopicBuffer );
+        xPublishInfo.pPayload = cUpdateDocument;
+        xPublishInfo.payloadLength = xUpdateLength;
+
+        usPacketId = MQTT_GetPacketId( &( pxDevice->xMqttContext ) );
+        xResult = MQTT_Publish( &( pxDevice->xMqttContext ), &xPublishInfo, usPacketId );
+
+        if( xResult == MQTTSuccess )
+        {
+            pxSlot->usPacketId = usPacketId;
+            pxSlot->ulSentTime = ( uint32_t ) portGET_RUN_TIME_COUNTER_VALUE();
+            xStats.ulPublishesSent++;
+            xStats.ulShadowUpdatesSent++;
+        }
+        else
+        {
+            ( void ) eShadowRequestCancel( &( pxDevice->xShadowRequests ), ulClientToken );
+            vShadowCacheUpdateTimedOut( &( pxDevice->xShadowCache ) );
+        }
+    }
+
+    return xResult;
+}
+/*-----------------------------------------------------------*/
+
+static void prvChangeDeviceState( FleetDevice_t * pxDevice )
+{
+    uint32_t ulPowerOn;
+
+    extern UBaseType_t uxRand( void );
+
+    /* Either switch the device on or off, or move its setpoint by up to two
+     * degrees from the initial one. */
+    if( ( uxRand() % 3U ) == 0U )
+    {
+        ulPowerOn = ulShadowCacheGetLocal( &( pxDevice->xShadowCache ), fleetsimPOWER_ON_PROPERTY );
+        vShadowCacheSetLocal( &( pxDevice->xShadowCache ), fleetsimPOWER_ON_PROPERTY, ( ulPowerOn == 0U ) ? 1U : 0U );
+    }
+    else
+    {
+        vShadowCacheSetLocal( &( pxDevice->xShadowCache ),
+                              fleetsimSETPOINT_PROPERTY,
+                              fleetsimINITIAL_SETPOINT - 2U + ( ( uint32_t ) uxRand() % 5U ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvEventCallback( MQTTContext_t * pxMqttContext,
+                              MQTTPacketInfo_t * pxPacketInfo,
+                              MQTTDeserializedInfo_t * pxDeserializedInfo )
+{
+    FleetDevice_t * pxDevice = ( FleetDevice_t * ) pxMqttContext;
+    uint32_t ulNow = ( uint32_t ) portGET_RUN_TIME_COUNTER_VALUE();
+    size_t i;
+
+    configASSERT( pxPacketInfo != NULL );
+    configASSERT( pxDeserializedInfo != NULL );
+
+    if( ( pxPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        xStats.ulPublishesReceived++;
+        prvHandleShadowPublish( pxDevice, pxDeserializedInfo->pPublishInfo );
+    }
+    else if( pxPacketInfo->type == MQTT_PACKET_TYPE_PUBACK )
+    {
+        xStats.ulPublishesAcknowledged++;
+
+        for( i = 0; i < fleetsimconfigMAX_OUTSTANDING_PUBLISHES; i++ )
+        {
+            if( pxDevice->xOutstanding[ i ].usPacketId == pxDeserializedInfo->packetIdentifier )
+            {
+                prvRecordLatency( pxDevice, ulNow - pxDevice->xOutstanding[ i ].ulSentTime );
+                pxDevice->xOutstanding[ i ].usPacketId = 0U;
+                break;
+            }
+        }
+    }
+    else
+    {
+        /* The SUBACK and PINGRESP need no action. */
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandleShadowPublish( FleetDevice_t * pxDevice,
+                                    const MQTTPublishInfo_t * pxPublishInfo )
+{
+    const char * pcSuffix;
+    size_t xPrefixLength, xSuffixLength, xProperty;
+    uint32_t ulChangedMask = 0U, ulValue;
+
+    configASSERT( pxPublishInfo != NULL );
+
+    ( void ) snprintf( cTopicBuffer, sizeof( cTopicBuffer ), fleetsimSHADOW_UPDATE_TOPIC_FORMAT "/", pxDevice->cClientIdentifier );
+    xPrefixLength = strlen( cTopicBuffer );
+
+    if( ( pxPublishInfo->topicNameLength <= xPrefixLength ) ||
+        ( strncmp( pxPublishInfo->pTopicName, cTopicBuffer, xPrefixLength ) != 0 ) )
+    {
+        LogDebug( ( "Device %s ignored a publish on %.*s.",
+                    pxDevice->cClientIdentifier,
+                    ( int ) pxPublishInfo->topicNameLength,
+                    pxPublishInfo->pTopicName ) );
+    }
+    else
+    {
+        pcSuffix = &( pxPublishInfo->pTopicName[ xPrefixLength ] );
+        xSuffixLength = pxPublishInfo->topicNameLength - xPrefixLength;
+
+        if( ( xSuffixLength == ( sizeof( "accepted" ) - 1U ) ) && ( strncmp( pcSuffix, "accepted", xSuffixLength ) == 0 ) )
+        {
+            /* Responses to updates that already timed out are ignored. */
+            ( void ) eShadowRequestHandleResponse( &( pxDevice->xShadowRequests ),
+                                                   ShadowRequestAccepted,
+                                                   pxPublishInfo->pPayload,
+                                                   pxPublishInfo->payloadLength );
+        }
+        else if( ( xSuffixLength == ( sizeof( "rejected" ) - 1U ) ) && ( strncmp( pcSuffix, "rejected", xSuffixLength ) == 0 ) )
+        {
+            ( void ) eShadowRequestHandleResponse( &( pxDevice->xShadowRequests ),
+                                                   ShadowRequestRejected,
+                                                   pxPublishInfo->pPayload,
+                                                   pxPublishInfo->payloadLength );
+        }
+        else if( ( xSuffixLength == ( sizeof( "delta" ) - 1U ) ) && ( strncmp( pcSuffix, "delta", xSuffixLength ) == 0 ) )
+        {
+            /* Apply the desired state straight away, which is reported back
+             * once the coalescing window closes. */
+            if( eShadowCacheApplyDelta( &( pxDevice->xShadowCache ),
+                                        pxPublishInfo->pPayload,
+                                        pxPublishInfo->payloadLength,
+                                        &ulChangedMask ) == eShadowCacheSuccess )
+            {
+                xStats.ulShadowDeltasApplied++;
+
+                for( xProperty = 0; xProperty < ( sizeof( xShadowProperties ) / sizeof( xShadowProperties[ 0 ] ) ); xProperty++ )
+                {
+                    if( xShadowCacheTakeDesired( &( pxDevice->xShadowCache ), xProperty, &ulValue ) == true )
+                    {
+                        vShadowCacheSetLocal( &( pxDevice->xShadowCache ), xProperty, ulValue );
+                    }
+                }
+            }
+        }
+        else
+        {
+            /* Other update responses, such as /documents, are not used. */
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvShadowUpdateCompleteCallback( void * pvContext,
+                                             uint32_t ulClientToken,
+                                             ShadowRequestType_t eType,
+                                             const ShadowResponse_t * pxResponse )
+{
+    FleetDevice_t * pxDevice = ( FleetDevice_t * ) pvContext;
+
+    /* Remove compiler warnings about unused parameters. */
+    ( void ) ulClientToken;
+    ( void ) eType;
+
+    configASSERT( pxDevice != NULL );
+    configASSERT( pxResponse != NULL );
+
+    if( pxResponse->eResult == ShadowRequestAccepted )
+    {
+        vShadowCacheUpdateAccepted( &( pxDevice->xShadowCache ), pxResponse->ulVersion );
+        xStats.ulShadowUpdatesAccepted++;
+    }
+    else if( pxResponse->eResult == ShadowRequestRejected )
+    {
+        vShadowCacheUpdateRejected( &( pxDevice->xShadowCache ) );
+        xStats.ulShadowUpdatesRejected++;
+    }
+    else
+    {
+        vShadowCacheUpdateTimedOut( &( pxDevice->xShadowCache ) );
+        xStats.ulShadowUpdatesTimedOut++;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static FleetPublish_t * prvGetPublishSlot( FleetDevice_t * pxDevice )
+{
+    FleetPublish_t * pxSlot = NULL;
+    size_t i;
+
+    for( i = 0; i < fleetsimconfigMAX_OUTSTANDING_PUBLISHES; i++ )
+    {
+        if( pxDevice->xOutstanding[ i ].usPacketId == 0U )
+        {
+            pxSlot = &( pxDevice->xOutstanding[ i ] );
+            break;
+        }
+    }
+
+    return pxSlot;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvTransportRecv( NetworkContext_t * pxNetworkContext,
+                                 void * pvBuffer,
+                                 size_t xBytesToRecv )
+{
+    size_t xAvailable;
+    int32_t lReceived = -1;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pvBuffer != NULL );
+
+    if( ( pxNetworkContext->xDirect == pdTRUE ) &&
+        ( pxNetworkContext->xReceiveStart == pxNetworkContext->xReceiveEnd ) )
+    {
+        prvReadSocket( pxNetworkContext );
+
+        /* coreMQTT calls again until the CONNACK arrives, so wait a tick for
+         * it rather than spinning. */
+        if( ( pxNetworkContext->xReceiveStart == pxNetworkContext->xReceiveEnd ) &&
+            ( pxNetworkContext->xFailed == pdFALSE ) )
+        {
+            ( void ) Sockets_Wait( pxNetworkContext->xSocket, POLLIN, 1U );
+        }
+    }
+
+    xAvailable = pxNetworkContext->xReceiveEnd - pxNetworkContext->xReceiveStart;
+
+    /* Bytes received before an error are still processed. */
+    if( ( xAvailable > 0U ) || ( pxNetworkContext->xFailed == pdFALSE ) )
+    {
+        if( xAvailable > xBytesToRecv )
+        {
+            xAvailable = xBytesToRecv;
+        }
+
+        memcpy( pvBuffer, &( pxNetworkContext->ucReceiveBuffer[ pxNetworkContext->xReceiveStart ] ), xAvailable );
+        pxNetworkContext->xReceiveStart += xAvailable;
+        lReceived = ( int32_t ) xAvailable;
+    }
+
+    return lReceived;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvTransportSend( NetworkContext_t * pxNetworkContext,
+                                 const void * pvBuffer,
+                                 size_t xBytesToSend )
+{
+    const uint8_t * pucData = ( const uint8_t * ) pvBuffer;
+    size_t xRemaining = xBytesToSend, xCopy;
+
+    configASSERT( pxNetworkContext != NULL );
+    configASSERT( pvBuffer != NULL );
+
+    while( ( xRemaining > 0U ) && ( pxNetworkContext->xFailed == pdFALSE ) )
+    {
+        if( pxNetworkContext->xSendLength == sizeof( pxNetworkContext->ucSendBuffer ) )
+        {
+            prvFlushSocket( pxNetworkContext, pdTRUE );
+        }
+
+        xCopy = sizeof( pxNetworkContext->ucSendBuffer ) - pxNetworkContext->xSendLength;
+
+        if( xCopy > xRemaining )
+        {
+            xCopy = xRemaining;
+        }
+
+        memcpy( &( pxNetworkContext->ucSendBuffer[ pxNetworkContext->xSendLength ] ), pucData, xCopy );
+        pxNetworkContext->xSendLength += xCopy;
+        pucData += xCopy;
+        xRemaining -= xCopy;
+    }
+
+    if( pxNetworkContext->xDirect == pdTRUE )
+    {
+        prvFlushSocket( pxNetworkContext, pdTRUE );
+    }
+
+    return ( pxNetworkContext->xFailed == pdFALSE ) ? ( int32_t ) xBytesToSend : -1;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReadSocket( NetworkContext_t * pxNetworkContext )
+{
+    ssize_t xResult;
+
+    /* Move the unread bytes to the start of the buffer, which is normally
+     * empty by the time the socket is read again. */
+    if( pxNetworkContext->xReceiveStart > 0U )
+    {
+        memmove( pxNetworkContext->ucReceiveBuffer,
+                 &( pxNetworkContext->ucReceiveBuffer[ pxNetworkContext->xReceiveStart ] ),
+                 pxNetworkContext->xReceiveEnd - pxNetworkContext->xReceiveStart );
+        pxNetworkContext->xReceiveEnd -= pxNetworkContext->xReceiveStart;
+        pxNetworkContext->xReceiveStart = 0U;
+    }
+
+    if( ( pxNetworkContext->xReceiveEnd < sizeof( pxNetworkContext->ucReceiveBuffer ) ) &&
+        ( pxNetworkContext->xFailed == pdFALSE ) )
+    {
+        xResult = recv( pxNetworkContext->xSocket,
+                        &( pxNetworkContext->ucReceiveBuffer[ pxNetworkContext->xReceiveEnd ] ),
+                        sizeof( pxNetworkContext->ucReceiveBuffer ) - pxNetworkContext->xReceiveEnd,
+                        MSG_DONTWAIT );
+        xStats.ulReceiveCalls++;
+
+        if( xResult > 0 )
+        {
+            pxNetworkContext->xReceiveEnd += ( size_t ) xResult;
+            xStats.ullBytesReceived += ( uint64_t ) xResult;
+        }
+        else if( ( xResult == 0 ) ||
+                 ( ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) && ( errno != EINTR ) ) )
+        {
+            /* The broker closed the connection, or the socket has an
+             * error. */
+            pxNetworkContext->xFailed = pdTRUE;
+        }
+        else
+        {
+            /* Nothing to read yet. */
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvFlushSocket( NetworkContext_t * pxNetworkContext,
+                            BaseType_t xWait )
+{
+    size_t xSent = 0U;
+    ssize_t xResult;
+
+    while( ( xSent < pxNetworkContext->xSendLength ) && ( pxNetworkContext->xFailed == pdFALSE ) )
+    {
+        xResult = send( pxNetworkContext->xSocket,
+                        &( pxNetworkContext->ucSendBuffer[ xSent ] ),
+                        pxNetworkContext->xSendLength - xSent,
+                        MSG_DONTWAIT | MSG_NOSIGNAL );
+        xStats.ulSendCalls++;
+
+        if( xResult > 0 )
+        {
+            xSent += ( size_t ) xResult;
+            xStats.ullBytesSent += ( uint64_t ) xResult;
+        }
+        else if( ( xResult < 0 ) && ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) || ( errno == EINTR ) ) )
+        {
+            if( xWait == pdFALSE )
+            {
+                /* The rest is sent the next time the device is serviced. */
+                break;
+            }
+
+            if( Sockets_Wait( pxNetworkContext->xSocket, POLLOUT, pdMS_TO_TICKS( fleetsimSEND_TIMEOUT_MS ) ) == pdFALSE )
+            {
+                pxNetworkContext->xFailed = pdTRUE;
+            }
+        }
+        else
+        {
+            pxNetworkContext->xFailed = pdTRUE;
+        }
+    }
+
+    if( xSent > 0U )
+    {
+        memmove( pxNetworkContext->ucSendBuffer,
+                 &( pxNetworkContext->ucSendBuffer[ xSent ] ),
+                 pxNetworkContext->xSendLength - xSent );
+        pxNetworkContext->xSendLength -= xSent;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvPacketReceived( const NetworkContext_t * pxNetworkContext )
+{
+    const uint8_t * pucPacket = &( pxNetworkContext->ucReceiveBuffer[ pxNetworkContext->xReceiveStart ] );
+    size_t xAvailable = pxNetworkContext->xReceiveEnd - pxNetworkContext->xReceiveStart;
+    size_t xIndex = 1U, xRemainingLength = 0U, xMultiplier = 1U;
+    BaseType_t xLengthDecoded = pdFALSE, xReceived = pdFALSE;
+
+    /* The packet type byte is followed by the remaining length, encoded in
+     * one to four bytes of seven bits each. */
+    while( ( xIndex < xAvailable ) && ( xIndex <= 4U ) && ( xLengthDecoded == pdFALSE ) )
+    {
+        xRemainingLength += ( size_t ) ( pucPacket[ xIndex ] & 0x7FU ) * xMultiplier;
+        xMultiplier *= 128U;
+        xLengthDecoded = ( ( pucPacket[ xIndex ] & 0x80U ) == 0U ) ? pdTRUE : pdFALSE;
+        xIndex++;
+    }
+
+    if( xLengthDecoded == pdTRUE )
+    {
+        xReceived = ( ( xAvailable - xIndex ) >= xRemainingLength ) ? pdTRUE : pdFALSE;
+    }
+    else if( xIndex > 4U )
+    {
+        /* The length is malformed, which coreMQTT reports. */
+        xReceived = pdTRUE;
+    }
+    else
+    {
+        /* The length is not complete yet. */
+    }
+
+    return xReceived;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvGetTimeMs( void )
+{
+    return ( uint32_t ) xTaskGetTickCount() * ( 1000U / configTICK_RATE_HZ );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvIsDue( TickType_t xNow,
+                            TickType_t xTime )
+{
+    return ( ( TickType_t ) ( xNow - xTime ) < ( portMAX_DELAY / 2U ) ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static TickType_t prvJitteredTicks( uint32_t ulIntervalMs,
+                                    uint32_t ulPercent )
+{
+    uint32_t ulSpread = ( uint32_t ) ( ( ( uint64_t ) ulIntervalMs * ulPercent ) / 100U );
+
+    extern UBaseType_t uxRand( void );
+
+    return pdMS_TO_TICKS( ulIntervalMs - ulSpread + ( ( uint32_t ) uxRand() % ( ( 2U * ulSpread ) + 1U ) ) );
+}
+/*-----------------------------------------------------------*/
+
+static void prvRecordLatency( FleetDevice_t * pxDevice,
+                              uint32_t ulLatency )
+{
+    vLatencyHistogramRecord( &xLatency, ulLatency );
+
+    pxDevice->ulLatencyCount++;
+    pxDevice->ullLatencySum += ulLatency;
+
+    if( ulLatency > pxDevice->ulMaxLatency )
+    {
+        pxDevice->ulMaxLatency = ulLatency;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvPerSecond( uint64_t ullCount,
+                              TickType_t xInterval )
+{
+    return ( uint32_t ) ( ( ullCount * configTICK_RATE_HZ ) / xInterval );
+}
+/*-----------------------------------------------------------*/
+
+static void prvReport( TickType_t xInterval )
+{
+    static LatencyHistogram_t xDeviceLatency;
+    const FleetSimulatorStats_t * pxLast = &xReportedStats;
+    FleetDevice_t * pxDevice, * pxSlowest = NULL;
+    uint32_t ulMean, ulSlowestMean = 0U, ulSendCalls, ulReceiveCalls, ulDevice;
+    uint64_t ullBytesSent, ullBytesReceived;
+
+    /* The spread of the mean round trip time of each device shows whether
+     * some devices are served more slowly than others. */
+    memset( &xDeviceLatency, 0x00, sizeof( xDeviceLatency ) );
+
+    for( ulDevice = 0; ulDevice < fleetsimconfigDEVICE_COUNT; ulDevice++ )
+    {
+        pxDevice = &( xDevices[ ulDevice ] );
+
+        if( pxDevice->ulLatencyCount > 0U )
+        {
+            ulMean = ( uint32_t ) ( pxDevice->ullLatencySum / pxDevice->ulLatencyCount );
+            vLatencyHistogramRecord( &xDeviceLatency, ulMean );
+
+            if( ulMean >= ulSlowestMean )
+            {
+                ulSlowestMean = ulMean;
+                pxSlowest = pxDevice;
+            }
+        }
+    }
+
+    ulSendCalls = xStats.ulSendCalls - pxLast->ulSendCalls;
+    ulReceiveCalls = xStats.ulReceiveCalls - pxLast->ulReceiveCalls;
+    ullBytesSent = xStats.ullBytesSent - pxLast->ullBytesSent;
+    ullBytesReceived = xStats.ullBytesReceived - pxLast->ullBytesReceived;
+
+    LogInfo( ( "%lu of %u devices connected, %lu connects, %lu failed connects and %lu disconnects in %lu ms.",
+               ( unsigned long ) xStats.ulConnectedDevices,
+               ( unsigned int ) fleetsimconfigDEVICE_COUNT,
+               ( unsigned long ) ( xStats.ulConnects - pxLast->ulConnects ),
+               ( unsigned long ) ( xStats.ulConnectFailures - pxLast->ulConnectFailures ),
+               ( unsigned long ) ( xStats.ulDisconnects - pxLast->ulDisconnects ),
+               ( unsigned long ) ( ( ( uint64_t ) xInterval * 1000U ) / configTICK_RATE_HZ ) ) );
+    LogInfo( ( "Publishes per second: %lu sent, %lu acknowledged, %lu received.  %lu telemetry messages skipped.",
+               ( unsigned long ) prvPerSecond( xStats.ulPublishesSent - pxLast->ulPublishesSent, xInterval ),
+               ( unsigned long ) prvPerSecond( xStats.ulPublishesAcknowledged - pxLast->ulPublishesAcknowledged, xInterval ),
+               ( unsigned long ) prvPerSecond( xStats.ulPublishesReceived - pxLast->ulPublishesReceived, xInterval ),
+               ( unsigned long ) ( xStats.ulTelemetrySkipped - pxLast->ulTelemetrySkipped ) ) );
+    LogInfo( ( "Bytes per second: %lu sent, %lu per send() call, %lu received, %lu per recv() call.",
+               ( unsigned long ) prvPerSecond( ullBytesSent, xInterval ),
+               ( unsigned long ) ( ( ulSendCalls > 0U ) ? ( ullBytesSent / ulSendCalls ) : 0U ),
+               ( unsigned long ) prvPerSecond( ullBytesReceived, xInterval ),
+               ( unsigned long ) ( ( ulReceiveCalls > 0U ) ? ( ullBytesReceived / ulReceiveCalls ) : 0U ) ) );
+    LogInfo( ( "PUBACK round trip time of %lu publishes in us: p50 %lu, p99 %lu, p99.9 %lu, max %lu.",
+               ( unsigned long ) xLatency.ulCount,
+               ( unsigned long ) ulLatencyHistogramPercentile( &xLatency, 500U ),
+               ( unsigned long ) ulLatencyHistogramPercentile( &xLatency, 990U ),
+               ( unsigned long ) ulLatencyHistogramPercentile( &xLatency, 999U ),
+               ( unsigned long ) xLatency.ulMax ) );
+
+    if( pxSlowest != NULL )
+    {
+        LogInfo( ( "Mean round trip time of %lu devices in us: p50 %lu, p99 %lu.  Slowest device %s, mean %lu, max %lu.",
+                   ( unsigned long ) xDeviceLatency.ulCount,
+                   ( unsigned long ) ulLatencyHistogramPercentile( &xDeviceLatency, 500U ),
+                   ( unsigned long ) ulLatencyHistogramPercentile( &xDeviceLatency, 990U ),
+                   pxSlowest->cClientIdentifier,
+                   ( unsigned long ) ulSlowestMean,
+                   ( unsigned long ) pxSlowest->ulMaxLatency ) );
+    }
+
+    LogInfo( ( "Shadow updates: %lu sent, %lu accepted, %lu rejected, %lu timed out.  %lu deltas applied.",
+               ( unsigned long ) ( xStats.ulShadowUpdatesSent - pxLast->ulShadowUpdatesSent ),
+               ( unsigned long ) ( xStats.ulShadowUpdatesAccepted - pxLast->ulShadowUpdatesAccepted ),
+               ( unsigned long ) ( xStats.ulShadowUpdatesRejected - pxLast->ulShadowUpdatesRejected ),
+               ( unsigned long ) ( xStats.ulShadowUpdatesTimedOut - pxLast->ulShadowUpdatesTimedOut ),
+               ( unsigned long ) ( xStats.ulShadowDeltasApplied - pxLast->ulShadowDeltasApplied ) ) );
+
+    /* Start the next interval. */
+    for( ulDevice = 0; ulDevice < fleetsimconfigDEVICE_COUNT; ulDevice++ )
+    {
+        xDevices[ ulDevice ].ulLatencyCount = 0U;
+        xDevices[ ulDevice ].ullLatencySum = 0U;
+        xDevices[ ulDevice ].ulMaxLatency = 0U;
+    }
+
+    memset( &xLatency, 0x00, sizeof( xLatency ) );
+    xReportedStats = xStats;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,99 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file fleet_simulator.h
+ *
+ * @brief Simulator of a fleet of devices that each connect to the MQTT broker,
+ * to load test brokers and the services behind them with the traffic of many
+ * devices from one process.
+ *
+ * Each device has its own client identifier, MQTT connection, shadow and
+ * telemetry schedule.  A device publishes telemetry at a jittered interval,
+ * changes its state at random and reports the changes to its shadow, and
+ * applies the desired state the Device Shadow service sends it.  All the
+ * devices are run by one task as an event loop rather than by a task each:
+ * the sockets of the devices are polled together, the bytes read from a socket
+ * are buffered so every packet they hold is processed in one go, and the
+ * packets a device writes while it is serviced are sent with one system call.
+ * The simulator logs the aggregate throughput and the round trip time of the
+ * QoS 1 publishes, both over the whole fleet and per device.
+ *
+ * The simulator connects with plain text TCP to democonfigMQTT_BROKER_ENDPOINT
+ * and democonfigMQTT_BROKER_PORT, with the sockets of the host, so is only
+ * available in the Linux build.
+ */
+
+#ifndef FLEET_SIMULATOR_H_
+#define FLEET_SIMULATOR_H_
+
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief Counters maintained by the simulator since it started.
+ */
+typedef struct FleetSimulatorStats
+{
+    uint32_t ulConnectedDevices;      /**< Number of devices connected now. */
+    uint32_t ulConnects;              /**< Number of connections established. */
+    uint32_t ulConnectFailures;       /**< Number of connection attempts that failed. */
+    uint32_t ulDisconnects;           /**< Number of connections lost. */
+    uint32_t ulPublishesSent;         /**< Number of PUBLISH packets sent, including shadow updates. */
+    uint32_t ulPublishesAcknowledged; /**< Number of PUBACK packets received. */
+    uint32_t ulPublishesReceived;     /**< Number of PUBLISH packets received. */
+    uint32_t ulTelemetrySkipped;      /**< Number of telemetry messages not sent as too many publishes were waiting for a PUBACK. */
+    uint32_t ulShadowUpdatesSent;     /**< Number of shadow updates sent. */
+    uint32_t ulShadowUpdatesAccepted; /**< Number of shadow updates accepted. */
+    uint32_t ulShadowUpdatesRejected; /**< Number of shadow updates rejected. */
+    uint32_t ulShadowUpdatesTimedOut; /**< Number of shadow updates that had no response. */
+    uint32_t ulShadowDeltasApplied;   /**< Number of shadow deltas applied. */
+    uint64_t ullBytesSent;            /**< Number of bytes sent. */
+    uint64_t ullBytesReceived;        /**< Number of bytes received. */
+    uint32_t ulSendCalls;             /**< Number of calls to send(). */
+    uint32_t ulReceiveCalls;          /**< Number of calls to recv(). */
+} FleetSimulatorStats_t;
+
+/**
+ * @brief Create the task that runs the simulated devices.
+ *
+ * @param[in] uxStackSize Stack size of the task, in words.
+ * @param[in] uxPriority Priority of the task.
+ */
+void vStartFleetSimulator( configSTACK_DEPTH_TYPE uxStackSize,
+                           UBaseType_t uxPriority );
+
+/**
+ * @brief Get a copy of the counters of the simulator.
+ *
+ * @param[out] pxStats The counters.
+ */
+void vFleetSimulatorGetStats( FleetSimulatorStats_t * pxStats );
+
+#endif /* FLEET_SIMULATOR_H_ */
@@ -0,0 +1,379 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+
+/**
+ * @file heap_tags.c
+ *
+ * @brief Accounting of the FreeRTOS heap by subsystem, and the optional
+ * allocation trace.  See heap_tags.h.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "heap_tags.h"
+
+/**
+ * @brief Value in the top bits of the tag in the header of a tagged
+ * allocation, to catch memory freed with heaptagsFREE() that was not
+ * allocated with heaptagsMALLOC().
+ */
+#define heaptagsMAGIC         ( 0x7A6B5C00UL )
+#define heaptagsMAGIC_MASK    ( 0xFFFFFF00UL )
+
+/**
+ * @brief Name of each tag.
+ */
+#define heaptagsTAG_NAME( xName, pcName )    pcName,
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The header in front of the memory returned by pvHeapTagsMalloc().
+ */
+typedef struct HeapTagsHeader
+{
+    size_t xSize;     /**< Size requested by the caller. */
+    uint32_t ulTag;   /**< heaptagsMAGIC ORed with the tag. */
+} HeapTagsHeader_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Record an operation in the trace.
+ *
+ * @param[in] eOperation The operation.
+ * @param[in] pvAddress The memory allocated or freed.
+ * @param[in] xSize The size reported by the heap.
+ */
+#if ( heaptagsTRACE_LENGTH > 0 )
+    static void prvTraceRecord( HeapTraceOperation_t eOperation,
+                                void * pvAddress,
+                                size_t xSize );
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Size of the header, rounded up to keep the memory returned by
+ * pvHeapTagsMalloc() aligned like the memory returned by pvPortMalloc().
+ */
+static const size_t xHeaderSize = ( sizeof( HeapTagsHeader_t ) + ( ( size_t ) portBYTE_ALIGNMENT_MASK ) ) & ~( ( size_t ) portBYTE_ALIGNMENT_MASK );
+
+static const char * const pcTagNames[ eHeapTagCount ] =
+{
+    heaptagsTAGS( heaptagsTAG_NAME )
+};
+
+/**
+ * @brief Accounting of each tag.  Only changed with the scheduler suspended.
+ */
+static HeapTagStats_t xTagStats[ eHeapTagCount ];
+
+/**
+ * @brief Total of the current bytes of every tag.
+ */
+static size_t xTaggedBytes = 0;
+
+/**
+ * @brief Tag of the allocation or free being made by pvHeapTagsMalloc() or
+ * vHeapTagsFree(), read by the trace.  Both keep the scheduler suspended while
+ * they call the heap, so it can not be changed by another task before the
+ * trace reads it.
+ */
+static HeapTag_t eCurrentTag = eHeapTagOther;
+
+#if ( heaptagsTRACE_LENGTH > 0 )
+
+/**
+ * @brief The trace, and the number of records written to it since the start.
+ * The record with sequence number n is at index n % heaptagsTRACE_LENGTH.
+ */
+    static HeapTraceRecord_t xTrace[ heaptagsTRACE_LENGTH ];
+    static uint32_t ulTraceCount = 0;
+#endif
+
+/*-----------------------------------------------------------*/
+
+void * pvHeapTagsMalloc( HeapTag_t eTag,
+                         size_t xSize )
+{
+    HeapTagsHeader_t * pxHeader = NULL;
+    HeapTagStats_t * pxStats;
+    void * pvReturn = NULL;
+
+    configASSERT( eTag < eHeapTagCount );
+
+    vTaskSuspendAll();
+    {
+        pxStats = &( xTagStats[ eTag ] );
+
+        /* Sizes that would overflow with the header added fail, as the heap
+         * could never hold them anyway. */
+        if( xSize <= ( ( ( size_t ) -1 ) - xHeaderSize ) )
+        {
+            eCurrentTag = eTag;
+            pxHeader = ( HeapTagsHeader_t * ) pvPortMalloc( xSize + xHeaderSize );
+            eCurrentTag = eHeapTagOther;
+        }
+
+        if( pxHeader != NULL )
+        {
+            pxHeader->xSize = xSize;
+            pxHeader->ulTag = heaptagsMAGIC | ( uint32_t ) eTag;
+
+            pxStats->xCurrentBytes += xSize;
+            pxStats->ulAllocations++;
+            xTaggedBytes += xSize;
+
+            if( pxStats->xCurrentBytes > pxStats->xPeakBytes )
+            {
+                pxStats->xPeakBytes = pxStats->xCurrentBytes;
+            }
+
+            pvReturn = ( void * ) ( ( ( uint8_t * ) pxHeader ) + xHeaderSize );
+        }
+        else
+        {
+            pxStats->ulFailures++;
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    return pvReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vHeapTagsFree( void * pv )
+{
+    HeapTagsHeader_t * pxHeader;
+    HeapTag_t eTag;
+
+    if( pv != NULL )
+    {
+        pxHeader = ( HeapTagsHeader_t * ) ( ( ( uint8_t * ) pv ) - xHeaderSize );
+
+        /* Check the memory was allocated by pvHeapTagsMalloc() and has not
+         * already been freed. */
+        configASSERT( ( pxHeader->ulTag & heaptagsMAGIC_MASK ) == heaptagsMAGIC );
+        eTag = ( HeapTag_t ) ( pxHeader->ulTag & ~heaptagsMAGIC_MASK );
+        configASSERT( eTag < eHeapTagCount );
+
+        vTaskSuspendAll();
+        {
+            xTagStats[ eTag ].xCurrentBytes -= pxHeader->xSize;
+            xTagStats[ eTag ].ulFrees++;
+            xTaggedBytes -= pxHeader->xSize;
+            pxHeader->ulTag = 0;
+
+            eCurrentTag = eTag;
+            vPortFree( pxHeader );
+            eCurrentTag = eHeapTagOther;
+        }
+        ( void ) xTaskResumeAll();
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vHeapTagsGetStats( HeapTag_t eTag,
+                        HeapTagStats_t * pxStats )
+{
+    size_t xHeapUsed;
+
+    configASSERT( eTag < eHeapTagCount );
+    configASSERT( pxStats != NULL );
+
+    vTaskSuspendAll();
+    {
+        if( eTag == eHeapTagOther )
+        {
+            ( void ) memset( pxStats, 0x00, sizeof( HeapTagStats_t ) );
+
+            /* Includes the headers of the tagged allocations. */
+            xHeapUsed = configTOTAL_HEAP_SIZE - xPortGetFreeHeapSize();
+            pxStats->xCurrentBytes = ( xHeapUsed > xTaggedBytes ) ? ( xHeapUsed - xTaggedBytes ) : 0U;
+            pxStats->xPeakBytes = pxStats->xCurrentBytes;
+        }
+        else
+        {
+            *pxStats = xTagStats[ eTag ];
+        }
+    }
+    ( void ) xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
+void vHeapTagsLogStats( void )
+{
+    HeapTagStats_t xStats;
+    uint32_t ulTag;
+
+    LogInfo( ( "Heap: %lu bytes free, minimum ever %lu.",
+               ( unsigned long ) xPortGetFreeHeapSize(),
+               ( unsigned long ) xPortGetMinimumEverFreeHeapSize() ) );
+
+    for( ulTag = 0; ulTag < ( uint32_t ) eHeapTagCount; ulTag++ )
+    {
+        vHeapTagsGetStats( ( HeapTag_t ) ulTag, &xStats );
+
+        LogInfo( ( "Heap %s: %lu bytes, peak %lu, %lu allocations, %lu frees, %lu failed.",
+                   pcTagNames[ ulTag ],
+                   ( unsigned long ) xStats.xCurrentBytes,
+                   ( unsigned long ) xStats.xPeakBytes,
+                   ( unsigned long ) xStats.ulAllocations,
+                   ( unsigned long ) xStats.ulFrees,
+                   ( unsigned long ) xStats.ulFailures ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+size_t xHeapTagsReadTrace( uint32_t ulFirstSequence,
+                           HeapTraceRecord_t * pxRecords,
+                           size_t xMaxRecords )
+{
+    size_t xCopied = 0;
+
+    configASSERT( ( pxRecords != NULL ) || ( xMaxRecords == 0U ) );
+
+    #if ( heaptagsTRACE_LENGTH > 0 )
+        {
+            uint32_t ulSequence = ulFirstSequence;
+
+            vTaskSuspendAll();
+            {
+                /* Skip the records that have been overwritten. */
+                if( ( ulTraceCount - ulSequence ) > ( uint32_t ) heaptagsTRACE_LENGTH )
+                {
+                    ulSequence = ulTraceCount - ( uint32_t ) heaptagsTRACE_LENGTH;
+                }
+
+                while( ( ulSequence != ulTraceCount ) && ( xCopied < xMaxRecords ) )
+                {
+                    pxRecords[ xCopied ] = xTrace[ ulSequence % ( uint32_t ) heaptagsTRACE_LENGTH ];
+                    xCopied++;
+                    ulSequence++;
+                }
+            }
+            ( void ) xTaskResumeAll();
+        }
+    #else /* if ( heaptagsTRACE_LENGTH > 0 ) */
+        {
+            ( void ) ulFirstSequence;
+            ( void ) pxRecords;
+            ( void ) xMaxRecords;
+        }
+    #endif /* if ( heaptagsTRACE_LENGTH > 0 ) */
+
+    return xCopied;
+}
+/*-----------------------------------------------------------*/
+
+void vHeapTagsDumpTrace( void )
+{
+    HeapTraceRecord_t xRecord;
+    uint32_t ulSequence = 0, ulEnd;
+
+    /* Only the records written before the dump started are logged, so the
+     * allocations made while the dump runs do not keep it going. */
+    #if ( heaptagsTRACE_LENGTH > 0 )
+        vTaskSuspendAll();
+        {
+            ulEnd = ulTraceCount;
+        }
+        ( void ) xTaskResumeAll();
+    #else
+        ulEnd = 0;
+    #endif
+
+    LogInfo( ( "heaptrace begin %lu", ( unsigned long ) ulEnd ) );
+
+    while( ( ulSequence != ulEnd ) && ( xHeapTagsReadTrace( ulSequence, &xRecord, 1U ) == 1U ) )
+    {
+        if( ( xRecord.ulSequence - ulSequence ) >= ( ulEnd - ulSequence ) )
+        {
+            /* Written after the dump started. */
+            break;
+        }
+
+        LogInfo( ( "heaptrace %lu %lu %c %s %p %lu",
+                   ( unsigned long ) xRecord.ulSequence,
+                   ( unsigned long ) xRecord.xTime,
+                   ( char ) xRecord.ucOperation,
+                   pcTagNames[ xRecord.ucTag ],
+                   xRecord.pvAddress,
+                   ( unsigned long ) xRecord.xSize ) );
+
+        ulSequence = xRecord.ulSequence + 1UL;
+
+        #if ( LOG_RATE_LIMIT == 1 )
+            vTaskDelay( pdMS_TO_TICKS( LOG_RATE_LIMIT_INTERVAL_MS ) );
+        #endif
+    }
+
+    LogInfo( ( "heaptrace end" ) );
+}
+/*-----------------------------------------------------------*/
+
+#if ( heaptagsTRACE_LENGTH > 0 )
+
+    static void prvTraceRecord( HeapTraceOperation_t eOperation,
+                                void * pvAddress,
+                                size_t xSize )
+    {
+        HeapTraceRecord_t * pxRecord = &( xTrace[ ulTraceCount % ( uint32_t ) heaptagsTRACE_LENGTH ] );
+
+        pxRecord->ulSequence = ulTraceCount;
+        pxRecord->xTime = xTaskGetTickCount();
+        pxRecord->pvAddress = pvAddress;
+        pxRecord->xSize = xSize;
+        pxRecord->ucOperation = ( uint8_t ) eOperation;
+        pxRecord->ucTag = ( uint8_t ) eCurrentTag;
+
+        ulTraceCount++;
+    }
+/*-----------------------------------------------------------*/
+
+    void vHeapTagsTraceMalloc( void * pvAddress,
+                               size_t xSize )
+    {
+        prvTraceRecord( ( pvAddress != NULL ) ? eHeapTraceMalloc : eHeapTraceFailed, pvAddress, xSize );
+    }
+/*-----------------------------------------------------------*/
+
+    void vHeapTagsTraceFree( void * pvAddress,
+                             size_t xSize )
+    {
+        prvTraceRecord( eHeapTraceFree, pvAddress, xSize );
+    }
+
+#endif /* if ( heaptagsTRACE_LENGTH > 0 ) */
@@ -0,0 +1,214 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+
+/**
+ * @file heap_tags.h
+ *
+ * @brief Accounting of the FreeRTOS heap by subsystem, and an optional trace
+ * of every allocation and free.
+ *
+ * pvPortMalloc() does not know who calls it, so a subsystem that allocates
+ * through heaptagsMALLOC() and heaptagsFREE() instead has its allocations
+ * tagged.  Each tagged allocation carries a small header holding its tag and
+ * size, and the current bytes, peak bytes and number of allocations, frees and
+ * failed allocations are kept for every tag.  The memory used by callers of
+ * pvPortMalloc() that are not tagged, kernel objects other than tasks, and the
+ * overhead of the heap itself are reported together as "other".
+ *
+ * Libraries that cannot be edited are tagged by compiling their source with
+ * heap_tags_redirect.h forced in - see that file.  The QEMU build and the Visual
+ * Studio project tag the stacks and control blocks allocated by the kernel's
+ * tasks.c as "tasks" and the network buffers allocated by FreeRTOS+TCP's
+ * BufferAllocation_2.c as "network".
+ *
+ * When heaptagsTRACE_LENGTH is not 0 the last heaptagsTRACE_LENGTH
+ * allocations and frees made by any caller are kept in a ring buffer, which
+ * vHeapTagsDumpTrace() logs in the format read by heap_trace_analyze.py.
+ */
+
+#ifndef HEAP_TAGS_H_
+#define HEAP_TAGS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief Set to 0 in FreeRTOSConfig.h to have heaptagsMALLOC() and
+ * heaptagsFREE() call pvPortMalloc() and vPortFree() directly.
+ */
+#ifndef heaptagsENABLED
+    #define heaptagsENABLED    1
+#endif
+
+/**
+ * @brief Number of allocations and frees kept in the trace, or 0 to disable
+ * the trace.  Set in FreeRTOSConfig.h, which also routes the kernel's
+ * traceMALLOC() and traceFREE() macros to the trace when it is not 0.
+ */
+#ifndef heaptagsTRACE_LENGTH
+    #define heaptagsTRACE_LENGTH    0
+#endif
+
+/**
+ * @brief The tags, and the names they are logged with.  eHeapTagOther is the
+ * tag of allocations made directly with pvPortMalloc().
+ */
+#define heaptagsTAGS( X )       \
+    X( Other, "other" )         \
+    X( Tasks, "tasks" )         \
+    X( Network, "network" )     \
+    X( Tls, "tls" )             \
+    X( Ota, "ota" )
+
+#define heaptagsTAG_ENUMERATOR( xName, pcName )    eHeapTag ## xName,
+
+typedef enum
+{
+    heaptagsTAGS( heaptagsTAG_ENUMERATOR )
+    eHeapTagCount
+} HeapTag_t;
+
+/**
+ * @brief Accounting of the allocations made with a tag.
+ */
+typedef struct HeapTagStats
+{
+    size_t xCurrentBytes;  /**< Bytes currently allocated, as requested by the callers. */
+    size_t xPeakBytes;     /**< Highest value of xCurrentBytes. */
+    uint32_t ulAllocations; /**< Number of successful allocations. */
+    uint32_t ulFrees;       /**< Number of frees. */
+    uint32_t ulFailures;    /**< Number of failed allocations. */
+} HeapTagStats_t;
+
+/**
+ * @brief Operations recorded in the trace.
+ */
+typedef enum
+{
+    eHeapTraceMalloc = 'M', /**< Successful allocation. */
+    eHeapTraceFree = 'F',   /**< Free. */
+    eHeapTraceFailed = 'X'  /**< Failed allocation. */
+} HeapTraceOperation_t;
+
+/**
+ * @brief An allocation or free recorded in the trace.
+ */
+typedef struct HeapTraceRecord
+{
+    uint32_t ulSequence;  /**< Position of the record in the trace since the start. */
+    TickType_t xTime;     /**< Tick count when the operation was made. */
+    void * pvAddress;     /**< Address of the memory, or NULL for a failed allocation. */
+    size_t xSize;         /**< Size passed to traceMALLOC() or traceFREE() by the heap. */
+    uint8_t ucOperation;  /**< One of #HeapTraceOperation_t. */
+    uint8_t ucTag;        /**< One of #HeapTag_t. */
+} HeapTraceRecord_t;
+
+/**
+ * @brief Allocate memory with a tag.  Use heaptagsMALLOC() rather than calling
+ * this directly.
+ *
+ * @param[in] eTag The tag of the allocation.
+ * @param[in] xSize The number of bytes to allocate.
+ *
+ * @return The memory, or NULL if it could not be allocated.
+ */
+void * pvHeapTagsMalloc( HeapTag_t eTag,
+                         size_t xSize );
+
+/**
+ * @brief Free memory allocated by pvHeapTagsMalloc().  Use heaptagsFREE()
+ * rather than calling this directly.
+ *
+ * @param[in] pv The memory to free, or NULL.
+ */
+void vHeapTagsFree( void * pv );
+
+#if ( heaptagsENABLED == 1 )
+    #define heaptagsMALLOC( eTag, xSize )    pvHeapTagsMalloc( ( eTag ), ( xSize ) )
+    #define heaptagsFREE( pv )               vHeapTagsFree( pv )
+#else
+    #define heaptagsMALLOC( eTag, xSize )    pvPortMalloc( xSize )
+    #define heaptagsFREE( pv )               vPortFree( pv )
+#endif
+
+/**
+ * @brief Get the accounting of a tag.  The bytes of eHeapTagOther are the
+ * bytes of the heap in use that are not allocated with another tag, and its
+ * counts are always 0.
+ *
+ * @param[in] eTag The tag.
+ * @param[out] pxStats The accounting.
+ */
+void vHeapTagsGetStats( HeapTag_t eTag,
+                        HeapTagStats_t * pxStats );
+
+/**
+ * @brief Log the accounting of every tag, one line per tag.
+ */
+void vHeapTagsLogStats( void );
+
+/**
+ * @brief Copy the records in the trace.
+ *
+ * @param[in] ulFirstSequence Sequence number of the first record to copy.
+ * Records that have already been overwritten are skipped.
+ * @param[out] pxRecords The records, oldest first.
+ * @param[in] xMaxRecords Number of records pxRecords can hold.
+ *
+ * @return The number of records copied.  0 if there are no more records, or
+ * if the trace is disabled.
+ */
+size_t xHeapTagsReadTrace( uint32_t ulFirstSequence,
+                           HeapTraceRecord_t * pxRecords,
+                           size_t xMaxRecords );
+
+/**
+ * @brief Log every record in the trace.
+ *
+ * The calling task is delayed between records so that none of them is
+ * dropped by the logging rate limit, so dumping a full trace takes
+ * heaptagsTRACE_LENGTH times LOG_RATE_LIMIT_INTERVAL_MS milliseconds.
+ */
+void vHeapTagsDumpTrace( void );
+
+/**
+ * @brief Record an allocation or free in the trace.  Called by the kernel's
+ * traceMALLOC() and traceFREE() macros, with the scheduler suspended.
+ *
+ * @param[in] pvAddress The memory allocated or freed.
+ * @param[in] xSize The size reported by the heap.
+ */
+void vHeapTagsTraceMalloc( void * pvAddress,
+                           size_t xSize );
+void vHeapTagsTraceFree( void * pvAddress,
+                         size_t xSize );
+
+#endif /* HEAP_TAGS_H_ */
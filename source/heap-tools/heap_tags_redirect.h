@@ -0,0 +1,62 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+
+/**
+ * @file heap_tags_redirect.h
+ *
+ * @brief Tags the allocations made by a source file that can not be edited,
+ * such as a file of a library included as a submodule.
+ *
+ * Compile the file with heaptagsREDIRECT_TAG defined to the tag and this
+ * header forced in before its first line, for example with GCC:
+ *
+ * -DheaptagsREDIRECT_TAG=eHeapTagNetwork -include heap_tags_redirect.h
+ *
+ * The header includes FreeRTOS.h so pvPortMalloc() and vPortFree() are
+ * declared before they are redefined, then every call to them in the file
+ * goes to heaptagsMALLOC() and heaptagsFREE() instead.  The file must free
+ * only memory it allocated itself, and its memory must not be freed anywhere
+ * else.
+ */
+
+#ifndef HEAP_TAGS_REDIRECT_H_
+#define HEAP_TAGS_REDIRECT_H_
+
+#ifndef heaptagsREDIRECT_TAG
+    #error "Define heaptagsREDIRECT_TAG to the tag of the allocations made by the file."
+#endif
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+#include "heap_tags.h"
+
+#define pvPortMalloc( xSize )    heaptagsMALLOC( heaptagsREDIRECT_TAG, xSize )
+#define vPortFree( pv )          heaptagsFREE( pv )
+
+#endif /* HEAP_TAGS_REDIRECT_H_ */
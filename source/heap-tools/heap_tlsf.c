@@ -0,0 +1,660 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file heap_tlsf.c
+ *
+ * @brief A two level segregated fit (TLSF) implementation of pvPortMalloc()
+ * and vPortFree() that can be used in place of the kernel's heap_4.c.
+ *
+ * Every block starts with a header holding its size and the address of the
+ * block before it in memory, so a freed block is merged with both of its
+ * neighbours without searching.  Free blocks are kept in lists indexed by a
+ * first level, the power of 2 below the block size, and a second level that
+ * splits each power of 2 into 16 equal ranges.  Blocks smaller than 16 times
+ * portBYTE_ALIGNMENT are all in the first level 0 lists, 1 list per multiple
+ * of portBYTE_ALIGNMENT.  One bitmap records the first levels that have a
+ * non-empty list and one bitmap per first level records its non-empty lists,
+ * so a list whose blocks are all large enough for a request is found with two
+ * bit scans.
+ *
+ * See heap_tlsf.h for the fragmentation metrics, and heap_4.c for the
+ * behaviour shared with the other heap implementations.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Defining MPU_WRAPPERS_INCLUDED_FROM_API_FILE prevents task.h from redefining
+ * all the API functions to use the MPU wrappers.  That should only be done when
+ * task.h is included from an application file. */
+#define MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#undef MPU_WRAPPERS_INCLUDED_FROM_API_FILE
+
+#include "heap_tlsf.h"
+
+#if ( configSUPPORT_DYNAMIC_ALLOCATION == 0 )
+    #error This file must not be used if configSUPPORT_DYNAMIC_ALLOCATION is 0
+#endif
+
+#if ( portBYTE_ALIGNMENT == 4 )
+    #define heapALIGNMENT_LOG2    ( 2 )
+#elif ( portBYTE_ALIGNMENT == 8 )
+    #define heapALIGNMENT_LOG2    ( 3 )
+#elif ( portBYTE_ALIGNMENT == 16 )
+    #define heapALIGNMENT_LOG2    ( 4 )
+#elif ( portBYTE_ALIGNMENT == 32 )
+    #define heapALIGNMENT_LOG2    ( 5 )
+#else
+    #error "heap_tlsf.c does not support this portBYTE_ALIGNMENT."
+#endif
+
+/* Number of second level lists per first level, and its base 2 logarithm. */
+#define heapSL_COUNT_LOG2           ( 4 )
+#define heapSL_COUNT                ( 1U << heapSL_COUNT_LOG2 )
+
+/* Blocks smaller than heapSMALL_BLOCK_SIZE are in first level 0.  Larger
+ * blocks are in the first level given by the position of their highest set
+ * bit, less heapFL_SHIFT - 1. */
+#define heapFL_SHIFT                ( heapSL_COUNT_LOG2 + heapALIGNMENT_LOG2 )
+#define heapSMALL_BLOCK_SIZE        ( ( size_t ) 1 << heapFL_SHIFT )
+
+/* Number of first levels. */
+#define heapFL_COUNT                ( heaptlsfMAX_BLOCK_SIZE_LOG2 - heapFL_SHIFT + 1 )
+
+#if ( heapFL_COUNT < 2 ) || ( heapFL_COUNT > 31 )
+    #error "heaptlsfMAX_BLOCK_SIZE_LOG2 is out of range."
+#endif
+
+/* Blocks can only be allocated if they are smaller than this. */
+#define heapMAX_BLOCK_SIZE          ( ( size_t ) 1 << heaptlsfMAX_BLOCK_SIZE_LOG2 )
+
+/* Set in the size of a block while it is free.  Sizes are multiples of
+ * portBYTE_ALIGNMENT, so the bit is otherwise always clear. */
+#define heapBLOCK_FREE_BIT          ( ( size_t ) 1 )
+
+/*-----------------------------------------------------------*/
+
+/* Allocate the memory for the heap. */
+#if ( configAPPLICATION_ALLOCATED_HEAP == 1 )
+
+/* The application writer has already defined the array used for the RTOS
+* heap - probably so it can be placed in a special segment or address. */
+    extern uint8_t ucHeap[ configTOTAL_HEAP_SIZE ];
+#else
+    PRIVILEGED_DATA static uint8_t ucHeap[ configTOTAL_HEAP_SIZE ];
+#endif /* configAPPLICATION_ALLOCATED_HEAP */
+
+/* The header at the start of every block.  pxNextFree and pxPreviousFree are
+ * only used while the block is free, so an allocated block starts at
+ * pxNextFree. */
+typedef struct A_TLSF_BLOCK
+{
+    struct A_TLSF_BLOCK * pxPreviousPhysical; /*<< The block before this one in memory, or NULL for the first block. */
+    size_t xBlockSize;                        /*<< The size of the block, including this header, with heapBLOCK_FREE_BIT set while it is free. */
+    struct A_TLSF_BLOCK * pxNextFree;         /*<< The next block in the same free list. */
+    struct A_TLSF_BLOCK * pxPreviousFree;     /*<< The previous block in the same free list. */
+} TlsfBlock_t;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Called automatically to set up the heap on the first call to
+ * pvPortMalloc().
+ */
+static void prvHeapInit( void ) PRIVILEGED_FUNCTION;
+
+/*
+ * Position of the highest and lowest set bits of a non-zero value.
+ */
+static uint32_t prvHighestBit( size_t xValue );
+static uint32_t prvLowestBit( uint32_t ulValue );
+
+/*
+ * Get the free list a block of xBlockSize bytes is kept in.
+ */
+static void prvMapping( size_t xBlockSize,
+                        uint32_t * pulFirstLevel,
+                        uint32_t * pulSecondLevel );
+
+/*
+ * Add a block to, and remove a block from, the free list of its size.
+ */
+static void prvInsertFreeBlock( TlsfBlock_t * pxBlock ) PRIVILEGED_FUNCTION;
+static void prvRemoveFreeBlock( TlsfBlock_t * pxBlock ) PRIVILEGED_FUNCTION;
+
+/*
+ * Find a free block of at least xBlockSize bytes and remove it from its free
+ * list.  Returns NULL if there is none.
+ */
+static TlsfBlock_t * prvTakeFreeBlock( size_t xBlockSize ) PRIVILEGED_FUNCTION;
+
+/*
+ * Walk the free lists to measure the free blocks, with the scheduler
+ * suspended.  Also returns the size of the smallest free block.
+ */
+static size_t prvMeasureFreeBlocks( HeapFragmentation_t * pxFragmentation ) PRIVILEGED_FUNCTION;
+
+/*-----------------------------------------------------------*/
+
+/* The size of the header of an allocated block, rounded up to keep the memory
+ * returned by pvPortMalloc() correctly byte aligned. */
+static const size_t xHeapStructSize = ( offsetof( TlsfBlock_t, pxNextFree ) + ( ( size_t ) ( portBYTE_ALIGNMENT - 1 ) ) ) & ~( ( size_t ) portBYTE_ALIGNMENT_MASK );
+
+/* The smallest block, which must hold the header of a free block. */
+static const size_t xMinimumBlockSize = ( sizeof( TlsfBlock_t ) + ( ( size_t ) ( portBYTE_ALIGNMENT - 1 ) ) ) & ~( ( size_t ) portBYTE_ALIGNMENT_MASK );
+
+/* The free lists, and the bitmaps of the non-empty ones. */
+PRIVILEGED_DATA static TlsfBlock_t * pxFreeLists[ heapFL_COUNT ][ heapSL_COUNT ];
+PRIVILEGED_DATA static uint32_t ulFirstLevelBitmap = 0;
+PRIVILEGED_DATA static uint32_t ulSecondLevelBitmaps[ heapFL_COUNT ];
+
+/* Header at the end of the heap, which is never free, so the last block is
+ * never merged with it. */
+PRIVILEGED_DATA static TlsfBlock_t * pxEnd = NULL;
+
+/* Keeps track of the number of calls to allocate and free memory as well as the
+ * number of free bytes remaining, but says nothing about fragmentation. */
+PRIVILEGED_DATA static size_t xFreeBytesRemaining = 0U;
+PRIVILEGED_DATA static size_t xMinimumEverFreeBytesRemaining = 0U;
+PRIVILEGED_DATA static size_t xNumberOfSuccessfulAllocations = 0;
+PRIVILEGED_DATA static size_t xNumberOfSuccessfulFrees = 0;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvHighestBit( size_t xValue )
+{
+    uint32_t ulBit;
+
+    #if defined( __GNUC__ )
+        ulBit = ( uint32_t ) ( ( sizeof( unsigned long ) * 8U ) - 1U ) - ( uint32_t ) __builtin_clzl( ( unsigned long ) xValue );
+    #elif defined( _MSC_VER )
+        unsigned long ulIndex;
+
+        ( void ) _BitScanReverse( &ulIndex, ( unsigned long ) xValue );
+        ulBit = ( uint32_t ) ulIndex;
+    #else
+        ulBit = 0;
+
+        while( ( xValue >> ulBit ) > ( size_t ) 1 )
+        {
+            ulBit++;
+        }
+    #endif
+
+    return ulBit;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvLowestBit( uint32_t ulValue )
+{
+    uint32_t ulBit;
+
+    #if defined( __GNUC__ )
+        ulBit = ( uint32_t ) __builtin_ctzl( ( unsigned long ) ulValue );
+    #elif defined( _MSC_VER )
+        unsigned long ulIndex;
+
+        ( void ) _BitScanForward( &ulIndex, ( unsigned long ) ulValue );
+        ulBit = ( uint32_t ) ulIndex;
+    #else
+        ulBit = 0;
+
+        while( ( ulValue & ( 1UL << ulBit ) ) == 0UL )
+        {
+            ulBit++;
+        }
+    #endif
+
+    return ulBit;
+}
+/*-----------------------------------------------------------*/
+
+static void prvMapping( size_t xBlockSize,
+                        uint32_t * pulFirstLevel,
+                        uint32_t * pulSecondLevel )
+{
+    uint32_t ulHighestBit;
+
+    if( xBlockSize < heapSMALL_BLOCK_SIZE )
+    {
+        *pulFirstLevel = 0;
+        *pulSecondLevel = ( uint32_t ) ( xBlockSize >> heapALIGNMENT_LOG2 );
+    }
+    else
+    {
+        ulHighestBit = prvHighestBit( xBlockSize );
+        *pulFirstLevel = ulHighestBit - ( heapFL_SHIFT - 1U );
+        *pulSecondLevel = ( uint32_t ) ( xBlockSize >> ( ulHighestBit - heapSL_COUNT_LOG2 ) ) ^ heapSL_COUNT;
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvInsertFreeBlock( TlsfBlock_t * pxBlock )
+{
+    uint32_t ulFirstLevel, ulSecondLevel;
+
+    prvMapping( pxBlock->xBlockSize & ~heapBLOCK_FREE_BIT, &ulFirstLevel, &ulSecondLevel );
+
+    pxBlock->pxPreviousFree = NULL;
+    pxBlock->pxNextFree = pxFreeLists[ ulFirstLevel ][ ulSecondLevel ];
+
+    if( pxBlock->pxNextFree != NULL )
+    {
+        pxBlock->pxNextFree->pxPreviousFree = pxBlock;
+    }
+
+    pxFreeLists[ ulFirstLevel ][ ulSecondLevel ] = pxBlock;
+    ulFirstLevelBitmap |= ( 1UL << ulFirstLevel );
+    ulSecondLevelBitmaps[ ulFirstLevel ] |= ( 1UL << ulSecondLevel );
+}
+/*-----------------------------------------------------------*/
+
+static void prvRemoveFreeBlock( TlsfBlock_t * pxBlock )
+{
+    uint32_t ulFirstLevel, ulSecondLevel;
+
+    prvMapping( pxBlock->xBlockSize & ~heapBLOCK_FREE_BIT, &ulFirstLevel, &ulSecondLevel );
+
+    if( pxBlock->pxNextFree != NULL )
+    {
+        pxBlock->pxNextFree->pxPreviousFree = pxBlock->pxPreviousFree;
+    }
+
+    if( pxBlock->pxPreviousFree != NULL )
+    {
+        pxBlock->pxPreviousFree->pxNextFree = pxBlock->pxNextFree;
+    }
+    else
+    {
+        /* The block is the head of its list. */
+        pxFreeLists[ ulFirstLevel ][ ulSecondLevel ] = pxBlock->pxNextFree;
+
+        if( pxBlock->pxNextFree == NULL )
+        {
+            ulSecondLevelBitmaps[ ulFirstLevel ] &= ~( 1UL << ulSecondLevel );
+
+            if( ulSecondLevelBitmaps[ ulFirstLevel ] == 0UL )
+            {
+                ulFirstLevelBitmap &= ~( 1UL << ulFirstLevel );
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static TlsfBlock_t * prvTakeFreeBlock( size_t xBlockSize )
+{
+    TlsfBlock_t * pxBlock = NULL;
+    uint32_t ulFirstLevel, ulSecondLevel, ulBitmap;
+    size_t xSearchSize = xBlockSize;
+
+    /* Round the size up to the next list boundary, so every block in the list
+     * found is large enough.  Blocks in the first level 0 lists all have the
+     * size of their list. */
+    if( xSearchSize >= heapSMALL_BLOCK_SIZE )
+    {
+        xSearchSize += ( ( size_t ) 1 << ( prvHighestBit( xSearchSize ) - heapSL_COUNT_LOG2 ) ) - ( size_t ) 1;
+    }
+
+    if( xSearchSize < heapMAX_BLOCK_SIZE )
+    {
+        prvMapping( xSearchSize, &ulFirstLevel, &ulSecondLevel );
+
+        /* The smallest non-empty list at or above the rounded size, first in
+         * the same first level, then in the levels above it. */
+        ulBitmap = ulSecondLevelBitmaps[ ulFirstLevel ] & ( ~0UL << ulSecondLevel );
+
+        if( ulBitmap == 0UL )
+        {
+            ulBitmap = ulFirstLevelBitmap & ( ~0UL << ( ulFirstLevel + 1U ) );
+
+            if( ulBitmap != 0UL )
+            {
+                ulFirstLevel = prvLowestBit( ulBitmap );
+                ulBitmap = ulSecondLevelBitmaps[ ulFirstLevel ];
+            }
+        }
+
+        if( ulBitmap != 0UL )
+        {
+            ulSecondLevel = prvLowestBit( ulBitmap );
+            pxBlock = pxFreeLists[ ulFirstLevel ][ ulSecondLevel ];
+            prvRemoveFreeBlock( pxBlock );
+        }
+    }
+
+    return pxBlock;
+}
+/*-----------------------------------------------------------*/
+
+void * pvPortMalloc( size_t xWantedSize )
+{
+    TlsfBlock_t * pxBlock, * pxRemainder, * pxNext;
+    size_t xBlockSize, xRemainingSize;
+    void * pvReturn = NULL;
+
+    vTaskSuspendAll();
+    {
+        /* If this is the first call to malloc then the heap will require
+         * initialisation to setup the free lists. */
+        if( pxEnd == NULL )
+        {
+            prvHeapInit();
+        }
+
+        /* Requests that would overflow the block size are larger than any
+         * block, so fail. */
+        if( ( xWantedSize > 0U ) && ( xWantedSize < heapMAX_BLOCK_SIZE ) )
+        {
+            /* The block must hold the header as well as the requested bytes,
+             * correctly aligned, and must be able to hold the header of a free
+             * block once it is freed. */
+            xBlockSize = ( xWantedSize + xHeapStructSize + ( ( size_t ) ( portBYTE_ALIGNMENT - 1 ) ) ) & ~( ( size_t ) portBYTE_ALIGNMENT_MASK );
+
+            if( xBlockSize < xMinimumBlockSize )
+            {
+                xBlockSize = xMinimumBlockSize;
+            }
+
+            pxBlock = prvTakeFreeBlock( xBlockSize );
+
+            if( pxBlock != NULL )
+            {
+                xRemainingSize = ( pxBlock->xBlockSize & ~heapBLOCK_FREE_BIT ) - xBlockSize;
+
+                if( xRemainingSize >= xMinimumBlockSize )
+                {
+                    /* Split off the end of the block.  Its neighbours are both
+                     * allocated, as free blocks are always merged. */
+                    pxRemainder = ( TlsfBlock_t * ) ( ( ( uint8_t * ) pxBlock ) + xBlockSize );
+                    pxRemainder->pxPreviousPhysical = pxBlock;
+                    pxRemainder->xBlockSize = xRemainingSize | heapBLOCK_FREE_BIT;
+
+                    pxNext = ( TlsfBlock_t * ) ( ( ( uint8_t * ) pxRemainder ) + xRemainingSize );
+                    pxNext->pxPreviousPhysical = pxRemainder;
+
+                    prvInsertFreeBlock( pxRemainder );
+                }
+                else
+                {
+                    xBlockSize = pxBlock->xBlockSize & ~heapBLOCK_FREE_BIT;
+                }
+
+                /* The block is being returned - it is allocated and owned by
+                 * the application, which owns everything after xBlockSize. */
+                pxBlock->xBlockSize = xBlockSize;
+
+                xFreeBytesRemaining -= xBlockSize;
+
+                if( xFreeBytesRemaining < xMinimumEverFreeBytesRemaining )
+                {
+                    xMinimumEverFreeBytesRemaining = xFreeBytesRemaining;
+                }
+                else
+                {
+                    mtCOVERAGE_TEST_MARKER();
+                }
+
+                xNumberOfSuccessfulAllocations++;
+                pvReturn = ( void * ) ( ( ( uint8_t * ) pxBlock ) + xHeapStructSize );
+            }
+            else
+            {
+                mtCOVERAGE_TEST_MARKER();
+            }
+        }
+        else
+        {
+            mtCOVERAGE_TEST_MARKER();
+        }
+
+        traceMALLOC( pvReturn, xWantedSize );
+    }
+    ( void ) xTaskResumeAll();
+
+    #if ( configUSE_MALLOC_FAILED_HOOK == 1 )
+        {
+            if( pvReturn == NULL )
+            {
+                extern void vApplicationMallocFailedHook( void );
+                vApplicationMallocFailedHook();
+            }
+            else
+            {
+                mtCOVERAGE_TEST_MARKER();
+            }
+        }
+    #endif /* if ( configUSE_MALLOC_FAILED_HOOK == 1 ) */
+
+    configASSERT( ( ( ( size_t ) pvReturn ) & ( size_t ) portBYTE_ALIGNMENT_MASK ) == 0 );
+    return pvReturn;
+}
+/*-----------------------------------------------------------*/
+
+void vPortFree( void * pv )
+{
+    TlsfBlock_t * pxBlock, * pxNeighbour;
+    size_t xBlockSize;
+
+    if( pv != NULL )
+    {
+        /* The memory being freed will have a header immediately before it. */
+        pxBlock = ( TlsfBlock_t * ) ( ( ( uint8_t * ) pv ) - xHeapStructSize );
+
+        /* Check the block is actually allocated. */
+        configASSERT( ( pxBlock->xBlockSize & heapBLOCK_FREE_BIT ) == 0 );
+        configASSERT( pxBlock->xBlockSize >= xMinimumBlockSize );
+
+        vTaskSuspendAll();
+        {
+            xBlockSize = pxBlock->xBlockSize;
+
+            /* Add this block to the free bytes. */
+            xFreeBytesRemaining += xBlockSize;
+            traceFREE( pv, xBlockSize );
+            xNumberOfSuccessfulFrees++;
+
+            /* Merge with the block after this one if it is free. */
+            pxNeighbour = ( TlsfBlock_t * ) ( ( ( uint8_t * ) pxBlock ) + xBlockSize );
+
+            if( ( pxNeighbour->xBlockSize & heapBLOCK_FREE_BIT ) != 0U )
+            {
+                prvRemoveFreeBlock( pxNeighbour );
+                xBlockSize += pxNeighbour->xBlockSize & ~heapBLOCK_FREE_BIT;
+            }
+
+            /* Merge with the block before this one if it is free. */
+            pxNeighbour = pxBlock->pxPreviousPhysical;
+
+            if( ( pxNeighbour != NULL ) && ( ( pxNeighbour->xBlockSize & heapBLOCK_FREE_BIT ) != 0U ) )
+            {
+                prvRemoveFreeBlock( pxNeighbour );
+                xBlockSize += pxNeighbour->xBlockSize & ~heapBLOCK_FREE_BIT;
+                pxBlock = pxNeighbour;
+            }
+
+            pxBlock->xBlockSize = xBlockSize | heapBLOCK_FREE_BIT;
+
+            pxNeighbour = ( TlsfBlock_t * ) ( ( ( uint8_t * ) pxBlock ) + xBlockSize );
+            pxNeighbour->pxPreviousPhysical = pxBlock;
+
+            prvInsertFreeBlock( pxBlock );
+        }
+        ( void ) xTaskResumeAll();
+    }
+}
+/*-----------------------------------------------------------*/
+
+size_t xPortGetFreeHeapSize( void )
+{
+    return xFreeBytesRemaining;
+}
+/*-----------------------------------------------------------*/
+
+size_t xPortGetMinimumEverFreeHeapSize( void )
+{
+    return xMinimumEverFreeBytesRemaining;
+}
+/*-----------------------------------------------------------*/
+
+void vPortInitialiseBlocks( void )
+{
+    /* This just exists to keep the linker quiet. */
+}
+/*-----------------------------------------------------------*/
+
+static void prvHeapInit( void ) /* PRIVILEGED_FUNCTION */
+{
+    TlsfBlock_t * pxFirstBlock;
+    size_t uxAddress, xTotalHeapSize = configTOTAL_HEAP_SIZE;
+
+    /* Ensure the heap starts on a correctly aligned boundary. */
+    uxAddress = ( size_t ) ucHeap;
+
+    if( ( uxAddress & portBYTE_ALIGNMENT_MASK ) != 0 )
+    {
+        uxAddress += ( portBYTE_ALIGNMENT - 1 );
+        uxAddress &= ~( ( size_t ) portBYTE_ALIGNMENT_MASK );
+        xTotalHeapSize -= uxAddress - ( size_t ) ucHeap;
+    }
+
+    xTotalHeapSize &= ~( ( size_t ) portBYTE_ALIGNMENT_MASK );
+
+    /* The heap starts as one free block, followed by the end header. */
+    pxFirstBlock = ( TlsfBlock_t * ) uxAddress;
+    pxFirstBlock->pxPreviousPhysical = NULL;
+    pxFirstBlock->xBlockSize = ( xTotalHeapSize - xHeapStructSize ) | heapBLOCK_FREE_BIT;
+
+    /* The heap must fit in the largest block size class. */
+    configASSERT( ( xTotalHeapSize - xHeapStructSize ) < heapMAX_BLOCK_SIZE );
+
+    pxEnd = ( TlsfBlock_t * ) ( uxAddress + xTotalHeapSize - xHeapStructSize );
+    pxEnd->pxPreviousPhysical = pxFirstBlock;
+    pxEnd->xBlockSize = 0;
+
+    prvInsertFreeBlock( pxFirstBlock );
+
+    /* Only one block exists - and it covers the entire usable heap space. */
+    xMinimumEverFreeBytesRemaining = xTotalHeapSize - xHeapStructSize;
+    xFreeBytesRemaining = xTotalHeapSize - xHeapStructSize;
+}
+/*-----------------------------------------------------------*/
+
+static size_t prvMeasureFreeBlocks( HeapFragmentation_t * pxFragmentation )
+{
+    TlsfBlock_t * pxBlock;
+    uint32_t ulFirstLevel, ulSecondLevel;
+    size_t xBlockSize, xSmallest = portMAX_DELAY, xBucket;
+
+    ( void ) memset( pxFragmentation, 0x00, sizeof( HeapFragmentation_t ) );
+
+    vTaskSuspendAll();
+    {
+        if( pxEnd != NULL )
+        {
+            for( ulFirstLevel = 0; ulFirstLevel < heapFL_COUNT; ulFirstLevel++ )
+            {
+                for( ulSecondLevel = 0; ulSecondLevel < heapSL_COUNT; ulSecondLevel++ )
+                {
+                    for( pxBlock = pxFreeLists[ ulFirstLevel ][ ulSecondLevel ]; pxBlock != NULL; pxBlock = pxBlock->pxNextFree )
+                    {
+                        xBlockSize = pxBlock->xBlockSize & ~heapBLOCK_FREE_BIT;
+
+                        pxFragmentation->xFreeBytes += xBlockSize;
+                        pxFragmentation->xNumberOfFreeBlocks++;
+
+                        if( xBlockSize > pxFragmentation->xLargestFreeBlock )
+                        {
+                            pxFragmentation->xLargestFreeBlock = xBlockSize;
+                        }
+
+                        if( xBlockSize < xSmallest )
+                        {
+                            xSmallest = xBlockSize;
+                        }
+
+                        /* Blocks are at least 16 bytes, the size of the
+                         * header of a free block on a 32-bit target. */
+                        xBucket = ( xBlockSize < ( size_t ) 32 ) ? 0U : ( size_t ) prvHighestBit( xBlockSize ) - 4U;
+
+                        if( xBucket >= heaptlsfHISTOGRAM_BUCKETS )
+                        {
+                            xBucket = heaptlsfHISTOGRAM_BUCKETS - 1U;
+                        }
+
+                        pxFragmentation->xFreeBlockHistogram[ xBucket ]++;
+                    }
+                }
+            }
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    if( pxFragmentation->xFreeBytes > 0U )
+    {
+        pxFragmentation->ulFragmentationPercent = ( uint32_t ) ( 100U - ( ( ( uint64_t ) pxFragmentation->xLargestFreeBlock * 100U ) / pxFragmentation->xFreeBytes ) );
+    }
+
+    if( pxFragmentation->xNumberOfFreeBlocks == 0U )
+    {
+        xSmallest = 0U;
+    }
+
+    return xSmallest;
+}
+/*-----------------------------------------------------------*/
+
+void vPortGetHeapFragmentation( HeapFragmentation_t * pxFragmentation )
+{
+    configASSERT( pxFragmentation != NULL );
+
+    ( void ) prvMeasureFreeBlocks( pxFragmentation );
+}
+/*-----------------------------------------------------------*/
+
+void vPortGetHeapStats( HeapStats_t * pxHeapStats )
+{
+    HeapFragmentation_t xFragmentation;
+
+    pxHeapStats->xSizeOfSmallestFreeBlockInBytes = prvMeasureFreeBlocks( &xFragmentation );
+    pxHeapStats->xSizeOfLargestFreeBlockInBytes = xFragmentation.xLargestFreeBlock;
+    pxHeapStats->xNumberOfFreeBlocks = xFragmentation.xNumberOfFreeBlocks;
+
+    taskENTER_CRITICAL();
+    {
+        pxHeapStats->xAvailableHeapSpaceInBytes = xFreeBytesRemaining;
+        pxHeapStats->xNumberOfSuccessfulAllocations = xNumberOfSuccessfulAllocations;
+        pxHeapStats->xNumberOfSuccessfulFrees = xNumberOfSuccessfulFrees;
+        pxHeapStats->xMinimumEverFreeBytesRemaining = xMinimumEverFreeBytesRemaining;
+    }
+    taskEXIT_CRITICAL();
+}
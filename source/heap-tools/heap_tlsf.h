@@ -0,0 +1,91 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file heap_tlsf.h
+ *
+ * @brief Fragmentation metrics of heap_tlsf.c, a two level segregated fit
+ * (TLSF) implementation of pvPortMalloc() and vPortFree().
+ *
+ * heap_tlsf.c is a drop-in replacement for the kernel's heap_4.c.  Free blocks
+ * are kept in a table of lists indexed by size class, with a bitmap of the
+ * non-empty lists, so both pvPortMalloc() and vPortFree() take a bounded time
+ * however fragmented the heap is.  Neighbouring free blocks are merged
+ * immediately, as in heap_4.c.  A request is served from the first non-empty
+ * list whose blocks are all large enough, so a block can be up to one size
+ * class (1/16 of its size) larger than a best fit, and a request fails if the
+ * only large enough free blocks are in the same size class as the request.
+ *
+ * Build with HEAP=tlsf on the make command line to use it in the QEMU build.
+ */
+
+#ifndef HEAP_TLSF_H_
+#define HEAP_TLSF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Base 2 logarithm of the size above which blocks cannot be allocated.
+ * The whole heap starts as one free block, so configTOTAL_HEAP_SIZE must be
+ * smaller than this.  Each power of 2 below it costs 16 list heads.  Can be
+ * overridden in FreeRTOSConfig.h.
+ */
+#ifndef heaptlsfMAX_BLOCK_SIZE_LOG2
+    #define heaptlsfMAX_BLOCK_SIZE_LOG2    22
+#endif
+
+/**
+ * @brief Number of buckets in the free block histogram.  Bucket i counts the
+ * free blocks whose size is at least 2^(i + 4) bytes and less than
+ * 2^(i + 5) bytes.  The last bucket also counts every larger block.
+ */
+#define heaptlsfHISTOGRAM_BUCKETS    ( 16 )
+
+/**
+ * @brief Fragmentation of the free heap space.
+ */
+typedef struct HeapFragmentation
+{
+    size_t xFreeBytes;                                         /**< Total size of the free blocks. */
+    size_t xLargestFreeBlock;                                  /**< Size of the largest free block. */
+    size_t xNumberOfFreeBlocks;                                /**< Number of free blocks. */
+    uint32_t ulFragmentationPercent;                           /**< Percentage of the free bytes outside the largest free block. */
+    size_t xFreeBlockHistogram[ heaptlsfHISTOGRAM_BUCKETS ];   /**< Number of free blocks in each size bucket. */
+} HeapFragmentation_t;
+
+/**
+ * @brief Get the fragmentation of the free heap space.
+ *
+ * Walks every free block with the scheduler suspended, so the time taken grows
+ * with the number of free blocks.
+ *
+ * @param[out] pxFragmentation The fragmentation metrics.
+ */
+void vPortGetHeapFragmentation( HeapFragmentation_t * pxFragmentation );
+
+#endif /* HEAP_TLSF_H_ */
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+#
+# Analyze an allocation trace logged by vHeapTagsDumpTrace() - see heap_tags.h.
+#
+# Reads the log output from a file, or from stdin when no file is given, and
+# reports the allocations and frees of each tag, the allocations that were
+# never freed with the oldest first, and, when the trace starts at the first
+# allocation since boot, the holes between the blocks still allocated.  For
+# example:
+#
+#   python3 heap_trace_analyze.py capture.txt
+#
+# Lines that are not part of a trace are ignored, so the whole log can be
+# passed in.  If the log holds several dumps, only the last one is analyzed.
+
+import re
+import sys
+
+RECORD = re.compile(r'heaptrace (\d+) (\d+) ([MFX]) (\w+) (\S+) (\d+)')
+BEGIN = re.compile(r'heaptrace begin (\d+)')
+
+# Number of allocations never freed to list.
+MAX_LEAKS_LISTED = 20
+
+
+def read_records(stream):
+    records = []
+    for line in stream:
+        if BEGIN.search(line):
+            records = []
+            continue
+
+        match = RECORD.search(line)
+        if match:
+            sequence, time, operation, tag, address, size = match.groups()
+            # printf() implementations print NULL in different ways.
+            try:
+                address = int(address, 16)
+            except ValueError:
+                address = 0
+            records.append((int(sequence), int(time), operation, tag,
+                            address, int(size)))
+
+    return records
+
+
+def analyze(records, output):
+    if not records:
+        output.write('No heap trace records found.\n')
+        return
+
+    first_sequence = records[0][0]
+    missing = 0
+    previous = first_sequence - 1
+    for record in records:
+        missing += record[0] - previous - 1
+        previous = record[0]
+
+    output.write('%u records, sequence %u to %u, ticks %u to %u.\n' %
+                 (len(records), first_sequence, records[-1][0],
+                  records[0][1], records[-1][1]))
+    if missing:
+        output.write('%u records are missing from the log.\n' % missing)
+
+    counts = {}
+    live = {}
+    frees_before_trace = 0
+
+    for sequence, time, operation, tag, address, size in records:
+        tag_counts = counts.setdefault(tag, [0, 0, 0, 0])
+
+        if operation == 'M':
+            tag_counts[0] += 1
+            live[address] = (sequence, time, tag, size)
+        elif operation == 'F':
+            tag_counts[1] += 1
+            if live.pop(address, None) is None:
+                frees_before_trace += 1
+        else:
+            tag_counts[2] += 1
+
+    for address, (_, _, tag, size) in live.items():
+        counts.setdefault(tag, [0, 0, 0, 0])[3] += size
+
+    output.write('\n%-10s %12s %12s %12s %14s\n' %
+                 ('tag', 'allocations', 'frees', 'failed', 'bytes not freed'))
+    for tag in sorted(counts):
+        allocations, frees, failed, live_bytes = counts[tag]
+        output.write('%-10s %12u %12u %12u %14u\n' %
+                     (tag, allocations, frees, failed, live_bytes))
+
+    if frees_before_trace:
+        output.write('\n%u frees of memory allocated before the trace starts.\n' %
+                     frees_before_trace)
+
+    last_time = records[-1][1]
+    oldest = sorted(live.items(), key=lambda item: item[1][0])
+    output.write('\n%u allocations not freed by the end of the trace' % len(oldest))
+    if oldest:
+        output.write(', oldest first:\n')
+        for address, (sequence, time, tag, size) in oldest[:MAX_LEAKS_LISTED]:
+            output.write('  0x%08x %8u bytes  %-10s sequence %u, %u ticks old\n' %
+                         (address, size, tag, sequence, last_time - time))
+    else:
+        output.write('.\n')
+
+    # The holes between blocks are only known if every block still allocated
+    # is in the trace.
+    if first_sequence == 0 and missing == 0 and len(oldest) > 1:
+        blocks = sorted((address, size) for address, (_, _, _, size) in live.items())
+        holes = []
+        for (address, size), (next_address, _) in zip(blocks, blocks[1:]):
+            hole = next_address - (address + size)
+            if hole > 0:
+                holes.append(hole)
+
+        output.write('\n%u holes between the blocks not freed, %u bytes in '
+                     'total, largest %u bytes.  Holes include the headers '
+                     'of the heap.\n' %
+                     (len(holes), sum(holes), max(holes) if holes else 0))
+
+
+def main():
+    if len(sys.argv) > 2:
+        sys.stderr.write('usage: %s [log]\n' % sys.argv[0])
+        sys.exit(1)
+
+    if len(sys.argv) == 2:
+        with open(sys.argv[1], 'r', errors='replace') as log:
+            records = read_records(log)
+    else:
+        records = read_records(sys.stdin)
+
+    analyze(records, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
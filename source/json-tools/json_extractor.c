@@ -0,0 +1,1038 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file json_extractor.c
+ *
+ * @brief Implementation of the single pass JSON validator and key extractor.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Interface include. */
+#include "json_extractor.h"
+
+/**
+ * @brief States of a key during a parse.
+ */
+#define jsonextractorKEY_SEARCHING    ( 0U ) /**< The enclosing members match the key path so far. */
+#define jsonextractorKEY_PENDING      ( 1U ) /**< The value of the key is being parsed. */
+#define jsonextractorKEY_RESOLVED     ( 2U ) /**< The key has been found, or cannot be found anymore. */
+
+/**
+ * @brief Progress of the parser towards one of the requested keys.
+ */
+typedef struct KeyState
+{
+    size_t xComponentStart;  /**< Offset in the key path of the key to match at the next level. */
+    size_t xComponentLength; /**< Length of that key. */
+    size_t xMatchedDepth;    /**< Number of leading keys of the path matched by the enclosing members. */
+    size_t xValueStart;      /**< Offset in the document of the value of a pending key. */
+    uint8_t ucState;         /**< One of the jsonextractorKEY_* states. */
+} KeyState_t;
+
+/**
+ * @brief State of a parse.
+ */
+typedef struct ExtractorParser
+{
+    const char * pcDocument;                         /**< The document being parsed. */
+    size_t xDocumentLength;                          /**< Length of the document. */
+    size_t xIndex;                                   /**< Offset of the next character to parse. */
+    JsonExtractorKey_t * pxKeys;                     /**< The keys to extract. */
+    size_t xKeyCount;                                /**< Number of keys to extract. */
+    size_t xUnresolvedKeys;                          /**< Number of keys not yet in the jsonextractorKEY_RESOLVED state. */
+    KeyState_t xKeyStates[ jsonextractorMAX_KEYS ];  /**< Progress towards each key. */
+    char cContainers[ jsonextractorMAX_DEPTH ];      /**< Opening bracket of each enclosing object or array. */
+} ExtractorParser_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check the key paths and prepare the keys for a parse.
+ *
+ * @param[in] pxParser The parser holding the keys.
+ *
+ * @return true if every key path is valid; false otherwise.
+ */
+static bool prvInitKeys( ExtractorParser_t * pxParser );
+
+/**
+ * @brief Select the key of a path that is matched at the next level.
+ *
+ * @param[in] pxKey The key whose path is split.
+ * @param[in] pxState The progress towards the key.
+ * @param[in] xStart Offset in the key path of the key to select.
+ */
+static void prvSelectComponent( const JsonExtractorKey_t * pxKey,
+                                KeyState_t * pxState,
+                                size_t xStart );
+
+/**
+ * @brief Advance the keys whose path continues with the key of an object
+ * member the parser has reached.
+ *
+ * @param[in] pxParser The parser.
+ * @param[in] xLevel Nesting level of the object containing the member.
+ * @param[in] xKeyStart Offset in the document of the member key, without its
+ * quotes.
+ * @param[in] xKeyLength Length of the member key.
+ */
+static void prvStartMember( ExtractorParser_t * pxParser,
+                            size_t xLevel,
+                            size_t xKeyStart,
+                            size_t xKeyLength );
+
+/**
+ * @brief Record the values of the keys that end with an object member whose
+ * value the parser has just skipped, and resolve the keys that can no longer
+ * be found.
+ *
+ * @param[in] pxParser The parser.
+ * @param[in] xLevel Nesting level of the object containing the member.
+ */
+static void prvEndMember( ExtractorParser_t * pxParser,
+                          size_t xLevel );
+
+/**
+ * @brief Parse the key of an object member and the separator after it, up to
+ * the start of its value.
+ *
+ * @param[in] pxParser The parser.
+ * @param[in] xLevel Nesting level of the object containing the member.
+ *
+ * @return true if the key is valid; false otherwise.
+ */
+static bool prvParseMemberKey( ExtractorParser_t * pxParser,
+                               size_t xLevel );
+
+/**
+ * @brief Skip space, tab, line feed and carriage return characters.
+ *
+ * @param[in] pxParser The parser.
+ */
+static void prvSkipWhitespace( ExtractorParser_t * pxParser );
+
+/**
+ * @brief Skip a string, including its quotes.
+ *
+ * @param[in] pxParser The parser, positioned on the opening quote.
+ *
+ * @return true if the string is valid; false otherwise.
+ */
+static bool prvSkipString( ExtractorParser_t * pxParser );
+
+/**
+ * @brief Skip an escape sequence within a string.
+ *
+ * @param[in] pxParser The parser, positioned on the backslash.
+ *
+ * @return true if the escape sequence is valid; false otherwise.
+ */
+static bool prvSkipEscape( ExtractorParser_t * pxParser );
+
+/**
+ * @brief Read the four hexadecimal digits of a \\u escape sequence.
+ *
+ * @param[in] pxParser The parser, positioned on the backslash.
+ * @param[out] pulValue The code unit.
+ *
+ * @return true if the escape sequence is valid; false otherwise.
+ */
+static bool prvReadUnicodeEscape( ExtractorParser_t * pxParser,
+                                  uint32_t * pulValue );
+
+/**
+ * @brief Skip a multi-byte UTF-8 character within a string.
+ *
+ * @param[in] pxParser The parser, positioned on the first byte.
+ *
+ * @return true if the character is encoded correctly; false otherwise.
+ */
+static bool prvSkipUtf8Character( ExtractorParser_t * pxParser );
+
+/**
+ * @brief Skip a string, number, true, false or null value.
+ *
+ * @param[in] pxParser The parser, positioned on the first character.
+ *
+ * @return true if the value is valid; false otherwise.
+ */
+static bool prvSkipScalar( ExtractorParser_t * pxParser );
+
+/**
+ * @brief Skip a number.
+ *
+ * @param[in] pxParser The parser, positioned on the first character.
+ *
+ * @return true if the number is valid; false otherwise.
+ */
+static bool prvSkipNumber( ExtractorParser_t * pxParser );
+
+/**
+ * @brief Skip a run of decimal digits.
+ *
+ * @param[in] pxParser The parser.
+ *
+ * @return true if at least one digit is skipped; false otherwise.
+ */
+static bool prvSkipDigits( ExtractorParser_t * pxParser );
+
+/**
+ * @brief Skip one of the literals true, false and null.
+ *
+ * @param[in] pxParser The parser, positioned on the first character.
+ * @param[in] pcLiteral The expected literal.
+ * @param[in] xLiteralLength Length of pcLiteral.
+ *
+ * @return true if the document contains the literal; false otherwise.
+ */
+static bool prvSkipLiteral( ExtractorParser_t * pxParser,
+                            const char * pcLiteral,
+                            size_t xLiteralLength );
+
+/**
+ * @brief Validate the whole document, extracting the keys on the way.
+ *
+ * @param[in] pxParser The parser.
+ *
+ * @return #eJsonExtractorSuccess, #eJsonExtractorInvalidDocument or
+ * #eJsonExtractorMaxDepthExceeded.
+ */
+static eJsonExtractorStatus prvParseDocument( ExtractorParser_t * pxParser );
+
+/*-----------------------------------------------------------*/
+
+static bool prvInitKeys( ExtractorParser_t * pxParser )
+{
+    bool xStatus = true;
+    JsonExtractorKey_t * pxKey;
+    size_t i, j;
+
+    for( i = 0; ( ( i < pxParser->xKeyCount ) && ( xStatus == true ) ); i++ )
+    {
+        pxKey = &( pxParser->pxKeys[ i ] );
+        pxKey->pcValue = NULL;
+        pxKey->xValueLength = 0U;
+        pxKey->eValueType = JsonExtractorValueNotFound;
+
+        if( ( pxKey->pcKeyPath == NULL ) || ( pxKey->xKeyPathLength == 0U ) )
+        {
+            xStatus = false;
+        }
+        else
+        {
+            /* Reject empty keys, which would be a leading, trailing or
+             * repeated separator. */
+            for( j = 0; ( ( j < pxKey->xKeyPathLength ) && ( xStatus == true ) ); j++ )
+            {
+                if( ( pxKey->pcKeyPath[ j ] == '.' ) &&
+                    ( ( j == 0U ) ||
+                      ( j == ( pxKey->xKeyPathLength - 1U ) ) ||
+                      ( pxKey->pcKeyPath[ j + 1U ] == '.' ) ) )
+                {
+                    xStatus = false;
+                }
+            }
+        }
+
+        if( xStatus == true )
+        {
+            pxParser->xKeyStates[ i ].xMatchedDepth = 0U;
+            pxParser->xKeyStates[ i ].xValueStart = 0U;
+            pxParser->xKeyStates[ i ].ucState = jsonextractorKEY_SEARCHING;
+            prvSelectComponent( pxKey, &( pxParser->xKeyStates[ i ] ), 0U );
+        }
+    }
+
+    pxParser->xUnresolvedKeys = pxParser->xKeyCount;
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSelectComponent( const JsonExtractorKey_t * pxKey,
+                                KeyState_t * pxState,
+                                size_t xStart )
+{
+    size_t xEnd = xStart;
+
+    while( ( xEnd < pxKey->xKeyPathLength ) && ( pxKey->pcKeyPath[ xEnd ] != '.' ) )
+    {
+        xEnd++;
+    }
+
+    pxState->xComponentStart = xStart;
+    pxState->xComponentLength = xEnd - xStart;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvStartMember( ExtractorParser_t * pxParser,
+                            size_t xLevel,
+                            size_t xKeyStart,
+                            size_t xKeyLength )
+{
+    const JsonExtractorKey_t * pxKey;
+    KeyState_t * pxState;
+    size_t i, xComponentEnd;
+
+    for( i = 0; ( ( i < pxParser->xKeyCount ) && ( pxParser->xUnresolvedKeys > 0U ) ); i++ )
+    {
+        pxKey = &( pxParser->pxKeys[ i ] );
+        pxState = &( pxParser->xKeyStates[ i ] );
+
+        /* Only the first member with a matching key is used, so a key stops
+         * searching at a level as soon as it matches there. */
+        if( ( pxState->ucState == jsonextractorKEY_SEARCHING ) &&
+            ( pxState->xMatchedDepth == xLevel ) &&
+            ( pxState->xComponentLength == xKeyLength ) &&
+            ( memcmp( &( pxParser->pcDocument[ xKeyStart ] ),
+                      &( pxKey->pcKeyPath[ pxState->xComponentStart ] ),
+                      xKeyLength ) == 0 ) )
+        {
+            xComponentEnd = pxState->xComponentStart + pxState->xComponentLength;
+
+            if( xComponentEnd == pxKey->xKeyPathLength )
+            {
+                pxState->ucState = jsonextractorKEY_PENDING;
+                pxState->xValueStart = pxParser->xIndex;
+            }
+            else
+            {
+                /* Continue with the next key of the path inside the value of
+                 * this member, skipping the separator. */
+                pxState->xMatchedDepth++;
+                prvSelectComponent( pxKey, pxState, xComponentEnd + 1U );
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvEndMember( ExtractorParser_t * pxParser,
+                          size_t xLevel )
+{
+    JsonExtractorKey_t * pxKey;
+    KeyState_t * pxState;
+    const char * pcValue;
+    size_t i, xValueLength;
+
+    for( i = 0; ( ( i < pxParser->xKeyCount ) && ( pxParser->xUnresolvedKeys > 0U ) ); i++ )
+    {
+        pxKey = &( pxParser->pxKeys[ i ] );
+        pxState = &( pxParser->xKeyStates[ i ] );
+
+        if( ( pxState->ucState == jsonextractorKEY_PENDING ) &&
+            ( pxState->xMatchedDepth == xLevel ) )
+        {
+            pcValue = &( pxParser->pcDocument[ pxState->xValueStart ] );
+            xValueLength = pxParser->xIndex - pxState->xValueStart;
+
+            switch( pcValue[ 0 ] )
+            {
+                case '"':
+                    /* Return strings without their quotes, as JSON_Search()
+                     * does. */
+                    pxKey->eValueType = JsonExtractorValueString;
+                    pcValue++;
+                    xValueLength -= 2U;
+                    break;
+
+                case '{':
+                    pxKey->eValueType = JsonExtractorValueObject;
+                    break;
+
+                case '[':
+                    pxKey->eValueType = JsonExtractorValueArray;
+                    break;
+
+                case 't':
+                    pxKey->eValueType = JsonExtractorValueTrue;
+                    break;
+
+                case 'f':
+                    pxKey->eValueType = JsonExtractorValueFalse;
+                    break;
+
+                case 'n':
+                    pxKey->eValueType = JsonExtractorValueNull;
+                    break;
+
+                default:
+                    pxKey->eValueType = JsonExtractorValueNumber;
+                    break;
+            }
+
+            pxKey->pcValue = pcValue;
+            pxKey->xValueLength = xValueLength;
+            pxState->ucState = jsonextractorKEY_RESOLVED;
+            pxParser->xUnresolvedKeys--;
+        }
+        else if( ( pxState->ucState == jsonextractorKEY_SEARCHING ) &&
+                 ( pxState->xMatchedDepth > xLevel ) )
+        {
+            /* The member that matched the start of the path has ended without
+             * the rest of the path being found in it. */
+            pxState->ucState = jsonextractorKEY_RESOLVED;
+            pxParser->xUnresolvedKeys--;
+        }
+        else
+        {
+            /* The key does not end with this member. */
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvParseMemberKey( ExtractorParser_t * pxParser,
+                               size_t xLevel )
+{
+    bool xStatus = false;
+    size_t xKeyStart, xKeyLength;
+
+    if( ( pxParser->xIndex < pxParser->xDocumentLength ) &&
+        ( pxParser->pcDocument[ pxParser->xIndex ] == '"' ) )
+    {
+        xKeyStart = pxParser->xIndex + 1U;
+
+        if( prvSkipString( pxParser ) == true )
+        {
+            /* The key excludes the closing quote. */
+            xKeyLength = pxParser->xIndex - xKeyStart - 1U;
+            prvSkipWhitespace( pxParser );
+
+            if( ( pxParser->xIndex < pxParser->xDocumentLength ) &&
+                ( pxParser->pcDocument[ pxParser->xIndex ] == ':' ) )
+            {
+                pxParser->xIndex++;
+                prvSkipWhitespace( pxParser );
+                prvStartMember( pxParser, xLevel, xKeyStart, xKeyLength );
+                xStatus = true;
+            }
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSkipWhitespace( ExtractorParser_t * pxParser )
+{
+    char c;
+
+    while( pxParser->xIndex < pxParser->xDocumentLength )
+    {
+        c = pxParser->pcDocument[ pxParser->xIndex ];
+
+        if( ( c != ' ' ) && ( c != '\t' ) && ( c != '\n' ) && ( c != '\r' ) )
+        {
+            break;
+        }
+
+        pxParser->xIndex++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSkipString( ExtractorParser_t * pxParser )
+{
+    bool xStatus = true, xClosed = false;
+    uint8_t c;
+
+    /* Skip the opening quote. */
+    pxParser->xIndex++;
+
+    while( ( xStatus == true ) && ( xClosed == false ) )
+    {
+        if( pxParser->xIndex >= pxParser->xDocumentLength )
+        {
+            xStatus = false;
+        }
+        else
+        {
+            c = ( uint8_t ) pxParser->pcDocument[ pxParser->xIndex ];
+
+            if( c == ( uint8_t ) '"' )
+            {
+                pxParser->xIndex++;
+                xClosed = true;
+            }
+            else if( c == ( uint8_t ) '\\' )
+            {
+                xStatus = prvSkipEscape( pxParser );
+            }
+            else if( c < 0x20U )
+            {
+                /* Control characters must be escaped. */
+                xStatus = false;
+            }
+            else if( c < 0x80U )
+            {
+                pxParser->xIndex++;
+            }
+            else
+            {
+                xStatus = prvSkipUtf8Character( pxParser );
+            }
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSkipEscape( ExtractorParser_t * pxParser )
+{
+    bool xStatus = false;
+    uint32_t ulHigh = 0U, ulLow = 0U;
+
+    if( ( pxParser->xIndex + 1U ) < pxParser->xDocumentLength )
+    {
+        switch( pxParser->pcDocument[ pxParser->xIndex + 1U ] )
+        {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                pxParser->xIndex += 2U;
+                xStatus = true;
+                break;
+
+            case 'u':
+                xStatus = prvReadUnicodeEscape( pxParser, &ulHigh );
+
+                if( ( xStatus == true ) && ( ulHigh >= 0xD800U ) && ( ulHigh <= 0xDBFFU ) )
+                {
+                    /* A high surrogate must be followed by a low surrogate. */
+                    xStatus = prvReadUnicodeEscape( pxParser, &ulLow );
+
+                    if( ( xStatus == true ) && ( ( ulLow < 0xDC00U ) || ( ulLow > 0xDFFFU ) ) )
+                    {
+                        xStatus = false;
+                    }
+                }
+                else if( ( ulHigh >= 0xDC00U ) && ( ulHigh <= 0xDFFFU ) )
+                {
+                    xStatus = false;
+                }
+                else
+                {
+                    /* A character of the basic multilingual plane. */
+                }
+
+                break;
+
+            default:
+                xStatus = false;
+                break;
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvReadUnicodeEscape( ExtractorParser_t * pxParser,
+                                  uint32_t * pulValue )
+{
+    bool xStatus = false;
+    uint32_t ulValue = 0U;
+    size_t i;
+    char c;
+
+    if( ( ( pxParser->xIndex + 6U ) <= pxParser->xDocumentLength ) &&
+        ( pxParser->pcDocument[ pxParser->xIndex ] == '\\' ) &&
+        ( pxParser->pcDocument[ pxParser->xIndex + 1U ] == 'u' ) )
+    {
+        xStatus = true;
+
+        for( i = 2U; ( ( i < 6U ) && ( xStatus == true ) ); i++ )
+        {
+            c = pxParser->pcDocument[ pxParser->xIndex + i ];
+
+            if( ( c >= '0' ) && ( c <= '9' ) )
+            {
+                ulValue = ( ulValue << 4 ) | ( uint32_t ) ( c - '0' );
+            }
+            else if( ( c >= 'a' ) && ( c <= 'f' ) )
+            {
+                ulValue = ( ulValue << 4 ) | ( uint32_t ) ( c - 'a' + 10 );
+            }
+            else if( ( c >= 'A' ) && ( c <= 'F' ) )
+            {
+                ulValue = ( ulValue << 4 ) | ( uint32_t ) ( c - 'A' + 10 );
+            }
+            else
+            {
+                xStatus = false;
+            }
+        }
+    }
+
+    if( xStatus == true )
+    {
+        pxParser->xIndex += 6U;
+        *pulValue = ulValue;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSkipUtf8Character( ExtractorParser_t * pxParser )
+{
+    bool xStatus = true;
+    uint8_t c = ( uint8_t ) pxParser->pcDocument[ pxParser->xIndex ];
+    uint32_t ulCodePoint = 0U;
+    size_t i, xContinuationBytes = 0U;
+
+    /* Lead bytes 0xC0 and 0xC1 could only start overlong encodings, and lead
+     * bytes above 0xF4 encode values beyond U+10FFFF. */
+    if( ( c >= 0xC2U ) && ( c <= 0xDFU ) )
+    {
+        xContinuationBytes = 1U;
+        ulCodePoint = c & 0x1FU;
+    }
+    else if( ( c >= 0xE0U ) && ( c <= 0xEFU ) )
+    {
+        xContinuationBytes = 2U;
+        ulCodePoint = c & 0x0FU;
+    }
+    else if( ( c >= 0xF0U ) && ( c <= 0xF4U ) )
+    {
+        xContinuationBytes = 3U;
+        ulCodePoint = c & 0x07U;
+    }
+    else
+    {
+        xStatus = false;
+    }
+
+    if( ( xStatus == true ) &&
+        ( ( pxParser->xIndex + xContinuationBytes ) >= pxParser->xDocumentLength ) )
+    {
+        xStatus = false;
+    }
+
+    for( i = 1U; ( ( i <= xContinuationBytes ) && ( xStatus == true ) ); i++ )
+    {
+        c = ( uint8_t ) pxParser->pcDocument[ pxParser->xIndex + i ];
+
+        if( ( c & 0xC0U ) != 0x80U )
+        {
+            xStatus = false;
+        }
+        else
+        {
+            ulCodePoint = ( ulCodePoint << 6 ) | ( c & 0x3FU );
+        }
+    }
+
+    if( xStatus == true )
+    {
+        /* Reject overlong encodings, surrogates and values beyond U+10FFFF. */
+        if( ( ( xContinuationBytes == 2U ) &&
+              ( ( ulCodePoint < 0x800U ) || ( ( ulCodePoint >= 0xD800U ) && ( ulCodePoint <= 0xDFFFU ) ) ) ) ||
+            ( ( xContinuationBytes == 3U ) &&
+              ( ( ulCodePoint < 0x10000U ) || ( ulCodePoint > 0x10FFFFU ) ) ) )
+        {
+            xStatus = false;
+        }
+        else
+        {
+            pxParser->xIndex += xContinuationBytes + 1U;
+        }
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSkipScalar( ExtractorParser_t * pxParser )
+{
+    bool xStatus;
+
+    switch( pxParser->pcDocument[ pxParser->xIndex ] )
+    {
+        case '"':
+            xStatus = prvSkipString( pxParser );
+            break;
+
+        case 't':
+            xStatus = prvSkipLiteral( pxParser, "true", sizeof( "true" ) - 1U );
+            break;
+
+        case 'f':
+            xStatus = prvSkipLiteral( pxParser, "false", sizeof( "false" ) - 1U );
+            break;
+
+        case 'n':
+            xStatus = prvSkipLiteral( pxParser, "null", sizeof( "null" ) - 1U );
+            break;
+
+        default:
+            xStatus = prvSkipNumber( pxParser );
+            break;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSkipNumber( ExtractorParser_t * pxParser )
+{
+    bool xStatus = true;
+
+    if( pxParser->pcDocument[ pxParser->xIndex ] == '-' )
+    {
+        pxParser->xIndex++;
+    }
+
+    /* The integer part has no leading zeros. */
+    if( ( pxParser->xIndex < pxParser->xDocumentLength ) &&
+        ( pxParser->pcDocument[ pxParser->xIndex ] == '0' ) )
+    {
+        pxParser->xIndex++;
+    }
+    else
+    {
+        xStatus = prvSkipDigits( pxParser );
+    }
+
+    if( ( xStatus == true ) &&
+        ( pxParser->xIndex < pxParser->xDocumentLength ) &&
+        ( pxParser->pcDocument[ pxParser->xIndex ] == '.' ) )
+    {
+        pxParser->xIndex++;
+        xStatus = prvSkipDigits( pxParser );
+    }
+
+    if( ( xStatus == true ) &&
+        ( pxParser->xIndex < pxParser->xDocumentLength ) &&
+        ( ( pxParser->pcDocument[ pxParser->xIndex ] == 'e' ) ||
+          ( pxParser->pcDocument[ pxParser->xIndex ] == 'E' ) ) )
+    {
+        pxParser->xIndex++;
+
+        if( ( pxParser->xIndex < pxParser->xDocumentLength ) &&
+            ( ( pxParser->pcDocument[ pxParser->xIndex ] == '+' ) ||
+              ( pxParser->pcDocument[ pxParser->xIndex ] == '-' ) ) )
+        {
+            pxParser->xIndex++;
+        }
+
+        xStatus = prvSkipDigits( pxParser );
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSkipDigits( ExtractorParser_t * pxParser )
+{
+    size_t xStart = pxParser->xIndex;
+
+    while( ( pxParser->xIndex < pxParser->xDocumentLength ) &&
+           ( pxParser->pcDocument[ pxParser->xIndex ] >= '0' ) &&
+           ( pxParser->pcDocument[ pxParser->xIndex ] <= '9' ) )
+    {
+        pxParser->xIndex++;
+    }
+
+    return( pxParser->xIndex > xStart );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSkipLiteral( ExtractorParser_t * pxParser,
+                            const char * pcLiteral,
+                            size_t xLiteralLength )
+{
+    bool xStatus = false;
+
+    if( ( ( pxParser->xIndex + xLiteralLength ) <= pxParser->xDocumentLength ) &&
+        ( memcmp( &( pxParser->pcDocument[ pxParser->xIndex ] ), pcLiteral, xLiteralLength ) == 0 ) )
+    {
+        pxParser->xIndex += xLiteralLength;
+        xStatus = true;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static eJsonExtractorStatus prvParseDocument( ExtractorParser_t * pxParser )
+{
+    eJsonExtractorStatus eStatus = eJsonExtractorSuccess;
+    bool xValueExpected = true, xDone = false;
+    size_t xDepth = 0U;
+    char c, cClosing;
+
+    /* Objects and arrays are tracked on an explicit stack rather than by
+     * recursion so the stack usage does not depend on the document. */
+    while( ( eStatus == eJsonExtractorSuccess ) && ( xDone == false ) )
+    {
+        if( xValueExpected == true )
+        {
+            prvSkipWhitespace( pxParser );
+
+            if( pxParser->xIndex >= pxParser->xDocumentLength )
+            {
+                eStatus = eJsonExtractorInvalidDocument;
+            }
+            else
+            {
+                c = pxParser->pcDocument[ pxParser->xIndex ];
+
+                if( ( c == '{' ) || ( c == '[' ) )
+                {
+                    if( xDepth == jsonextractorMAX_DEPTH )
+                    {
+                        eStatus = eJsonExtractorMaxDepthExceeded;
+                    }
+                    else
+                    {
+                        pxParser->cContainers[ xDepth ] = c;
+                        xDepth++;
+                        pxParser->xIndex++;
+                        prvSkipWhitespace( pxParser );
+                        cClosing = ( c == '{' ) ? '}' : ']';
+
+                        if( ( pxParser->xIndex < pxParser->xDocumentLength ) &&
+                            ( pxParser->pcDocument[ pxParser->xIndex ] == cClosing ) )
+                        {
+                            /* Empty object or array. */
+                            pxParser->xIndex++;
+                            xDepth--;
+                            xValueExpected = false;
+                        }
+                        else if( ( c == '{' ) && ( prvParseMemberKey( pxParser, xDepth - 1U ) == false ) )
+                        {
+                            eStatus = eJsonExtractorInvalidDocument;
+                        }
+                        else
+                        {
+                            /* The first member or element value is parsed
+                             * next. */
+                        }
+                    }
+                }
+                else if( prvSkipScalar( pxParser ) == true )
+                {
+                    xValueExpected = false;
+                }
+                else
+                {
+                    eStatus = eJsonExtractorInvalidDocument;
+                }
+            }
+        }
+        else if( xDepth == 0U )
+        {
+            /* The top level value has ended; only whitespace may follow. */
+            prvSkipWhitespace( pxParser );
+
+            if( pxParser->xIndex != pxParser->xDocumentLength )
+            {
+                eStatus = eJsonExtractorInvalidDocument;
+            }
+
+            xDone = true;
+        }
+        else
+        {
+            /* A member or element value has ended. */
+            c = pxParser->cContainers[ xDepth - 1U ];
+            cClosing = ( c == '{' ) ? '}' : ']';
+
+            if( c == '{' )
+            {
+                prvEndMember( pxParser, xDepth - 1U );
+            }
+
+            prvSkipWhitespace( pxParser );
+
+            if( pxParser->xIndex >= pxParser->xDocumentLength )
+            {
+                eStatus = eJsonExtractorInvalidDocument;
+            }
+            else if( pxParser->pcDocument[ pxParser->xIndex ] == ',' )
+            {
+                pxParser->xIndex++;
+                xValueExpected = true;
+
+                if( c == '{' )
+                {
+                    prvSkipWhitespace( pxParser );
+
+                    if( prvParseMemberKey( pxParser, xDepth - 1U ) == false )
+                    {
+                        eStatus = eJsonExtractorInvalidDocument;
+                    }
+                }
+            }
+            else if( pxParser->pcDocument[ pxParser->xIndex ] == cClosing )
+            {
+                /* The object or array is itself a value that has ended. */
+                pxParser->xIndex++;
+                xDepth--;
+            }
+            else
+            {
+                eStatus = eJsonExtractorInvalidDocument;
+            }
+        }
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+eJsonExtractorStatus eJsonExtract( const char * pcDocument,
+                                   size_t xDocumentLength,
+                                   JsonExtractorKey_t * pxKeys,
+                                   size_t xKeyCount )
+{
+    ExtractorParser_t xParser;
+    eJsonExtractorStatus eStatus = eJsonExtractorSuccess;
+    size_t i;
+
+    if( ( pcDocument == NULL ) || ( xDocumentLength == 0U ) ||
+        ( ( pxKeys == NULL ) && ( xKeyCount > 0U ) ) ||
+        ( xKeyCount > jsonextractorMAX_KEYS ) )
+    {
+        eStatus = eJsonExtractorBadParameter;
+    }
+    else
+    {
+        xParser.pcDocument = pcDocument;
+        xParser.xDocumentLength = xDocumentLength;
+        xParser.xIndex = 0U;
+        xParser.pxKeys = pxKeys;
+        xParser.xKeyCount = xKeyCount;
+
+        if( prvInitKeys( &xParser ) == false )
+        {
+            eStatus = eJsonExtractorBadParameter;
+        }
+    }
+
+    if( eStatus == eJsonExtractorSuccess )
+    {
+        eStatus = prvParseDocument( &xParser );
+
+        if( eStatus != eJsonExtractorSuccess )
+        {
+            /* Do not return values from a document that is not valid. */
+            for( i = 0; i < xKeyCount; i++ )
+            {
+                pxKeys[ i ].pcValue = NULL;
+                pxKeys[ i ].xValueLength = 0U;
+                pxKeys[ i ].eValueType = JsonExtractorValueNotFound;
+            }
+        }
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+bool xJsonExtractorGetUint32( const JsonExtractorKey_t * pxKey,
+                              uint32_t * pulOutValue )
+{
+    bool xStatus = false;
+    uint64_t ullValue = 0U;
+    size_t i;
+
+    if( ( pxKey != NULL ) && ( pulOutValue != NULL ) )
+    {
+        if( ( pxKey->eValueType == JsonExtractorValueTrue ) ||
+            ( pxKey->eValueType == JsonExtractorValueFalse ) )
+        {
+            *pulOutValue = ( pxKey->eValueType == JsonExtractorValueTrue ) ? 1U : 0U;
+            xStatus = true;
+        }
+        else if( ( pxKey->eValueType == JsonExtractorValueNumber ) &&
+                 ( pxKey->xValueLength > 0U ) &&
+                 ( pxKey->xValueLength <= 10U ) )
+        {
+            /* The extractor has already checked the number is well formed, so
+             * any character other than a digit is a sign, fraction or
+             * exponent. */
+            xStatus = true;
+
+            for( i = 0; ( i < pxKey->xValueLength ) && ( xStatus == true ); i++ )
+            {
+                if( ( pxKey->pcValue[ i ] < '0' ) || ( pxKey->pcValue[ i ] > '9' ) )
+                {
+                    xStatus = false;
+                }
+                else
+                {
+                    ullValue = ( ullValue * 10U ) + ( uint64_t ) ( pxKey->pcValue[ i ] - '0' );
+                }
+            }
+
+            if( ( xStatus == true ) && ( ullValue <= UINT32_MAX ) )
+            {
+                *pulOutValue = ( uint32_t ) ullValue;
+            }
+            else
+            {
+                xStatus = false;
+            }
+        }
+        else
+        {
+            /* Not found, or a string, object, array or null. */
+        }
+    }
+
+    return xStatus;
+}
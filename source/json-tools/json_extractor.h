@@ -0,0 +1,155 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file json_extractor.h
+ *
+ * @brief Validate a JSON document and extract the values of several keys in a
+ * single pass over it.
+ *
+ * Calling JSON_Validate() and then JSON_Search() once for each key parses the
+ * start of the document once per key in addition to the validation pass.  The
+ * extractor instead tracks the path to the member being parsed while it
+ * validates the document, and records the value of every requested key as the
+ * parser reaches it.  No memory is allocated and values are returned as
+ * pointers into the document.
+ */
+
+#ifndef JSON_EXTRACTOR_H_
+#define JSON_EXTRACTOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Maximum nesting depth of objects and arrays in a document.  Deeper
+ * documents are rejected.  Can be overridden in demo_config.h.
+ */
+#ifndef jsonextractorMAX_DEPTH
+    #define jsonextractorMAX_DEPTH    ( 32U )
+#endif
+
+/**
+ * @brief Maximum number of keys that can be extracted by one call to
+ * eJsonExtract().  Can be overridden in demo_config.h.
+ */
+#ifndef jsonextractorMAX_KEYS
+    #define jsonextractorMAX_KEYS     ( 8U )
+#endif
+
+/**
+ * @brief Return codes from JSON extractor APIs.
+ */
+typedef enum
+{
+    eJsonExtractorSuccess = 0,
+    eJsonExtractorBadParameter,
+    eJsonExtractorInvalidDocument,
+    eJsonExtractorMaxDepthExceeded
+} eJsonExtractorStatus;
+
+/**
+ * @brief Type of an extracted value.
+ */
+typedef enum
+{
+    JsonExtractorValueNotFound = 0,
+    JsonExtractorValueString,
+    JsonExtractorValueNumber,
+    JsonExtractorValueObject,
+    JsonExtractorValueArray,
+    JsonExtractorValueTrue,
+    JsonExtractorValueFalse,
+    JsonExtractorValueNull
+} JsonExtractorValueType_t;
+
+/**
+ * @brief A key to extract, and the value found for it.
+ *
+ * The key path uses the same syntax as the query passed to JSON_Search(), for
+ * example "state.reported.powerOn", except that array indexes are not
+ * supported.  As with JSON_Search(), only the first member with a matching
+ * key is used, string values are returned without their quotes and object and
+ * array values are returned with their brackets.
+ */
+typedef struct JsonExtractorKey
+{
+    const char * pcKeyPath;              /**< Keys separated by '.'. Set by the caller. */
+    size_t xKeyPathLength;               /**< Length of pcKeyPath. Set by the caller. */
+    const char * pcValue;                /**< Start of the value within the document. NULL when the key is not found. */
+    size_t xValueLength;                 /**< Length of the value. */
+    JsonExtractorValueType_t eValueType; /**< Type of the value, or #JsonExtractorValueNotFound. */
+} JsonExtractorKey_t;
+
+/**
+ * @brief Initializer for a #JsonExtractorKey_t whose key path is a string
+ * literal.
+ */
+#define jsonextractorKEY( pcKeyPathLiteral ) \
+    { ( pcKeyPathLiteral ), sizeof( pcKeyPathLiteral ) - 1U, NULL, 0U, JsonExtractorValueNotFound }
+
+/**
+ * @brief Validate a JSON document and extract the values of a list of keys.
+ *
+ * Keys that are not in the document are reported with an eValueType of
+ * #JsonExtractorValueNotFound, which is not an error.  The values are only
+ * meaningful when the document is valid.
+ *
+ * @param[in] pcDocument The document to parse.
+ * @param[in] xDocumentLength Length of pcDocument.
+ * @param[in,out] pxKeys The keys to extract.  The value fields are written.
+ * @param[in] xKeyCount Number of entries in pxKeys, at most
+ * #jsonextractorMAX_KEYS.
+ *
+ * @return #eJsonExtractorSuccess if the document is valid JSON;
+ * #eJsonExtractorBadParameter if invalid parameters are passed;
+ * #eJsonExtractorInvalidDocument if the document is not valid JSON;
+ * #eJsonExtractorMaxDepthExceeded if the document is nested deeper than
+ * #jsonextractorMAX_DEPTH.
+ */
+eJsonExtractorStatus eJsonExtract( const char * pcDocument,
+                                   size_t xDocumentLength,
+                                   JsonExtractorKey_t * pxKeys,
+                                   size_t xKeyCount );
+
+/**
+ * @brief Read an extracted value as an unsigned 32-bit integer.
+ *
+ * Numbers are accepted if they are integers without a sign, fraction or
+ * exponent that fit in 32 bits.  true is read as 1 and false as 0.
+ *
+ * @param[in] pxKey A key filled in by eJsonExtract().
+ * @param[out] pulOutValue The value.
+ *
+ * @return true if the value is read; false if the key was not found or its
+ * value is of another type or out of range.
+ */
+bool xJsonExtractorGetUint32( const JsonExtractorKey_t * pxKey,
+                              uint32_t * pulOutValue );
+
+#endif /* JSON_EXTRACTOR_H_ */
@@ -0,0 +1,375 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file logging_levels.c
+ *
+ * @brief Runtime logging level of each module and per call site rate limiting
+ * of log messages.  The prototypes are in logging_config.h, which the logging
+ * macros are defined in.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * @brief Initial level of each module.
+ */
+#define loglevelsINITIAL_LEVEL( xName, pcName )    LOG_LEVEL,
+
+/**
+ * @brief Name of each module.
+ */
+#define loglevelsMODULE_NAME( xName, pcName )      pcName,
+
+/**
+ * @brief Time between the refills of one token, in ticks.  At least one tick.
+ */
+#define loglevelsREFILL_TICKS                                              \
+    ( ( pdMS_TO_TICKS( LOG_RATE_LIMIT_INTERVAL_MS ) > ( TickType_t ) 0 ) ? \
+      pdMS_TO_TICKS( LOG_RATE_LIMIT_INTERVAL_MS ) : ( TickType_t ) 1 )
+
+/**
+ * @brief Module name that selects every module.
+ */
+#define loglevelsALL_MODULES    "*"
+
+/*-----------------------------------------------------------*/
+
+uint8_t ucLoggingModuleLevels[ eLogModuleCount ] = { logMODULES( loglevelsINITIAL_LEVEL ) };
+
+/**
+ * @brief Names of the modules, indexed by LogModule_t.
+ */
+static const char * const pcModuleNames[ eLogModuleCount ] = { logMODULES( loglevelsMODULE_NAME ) };
+
+/**
+ * @brief Names of the levels, indexed by level.
+ */
+static const char * const pcLevelNames[] = { "none", "error", "warn", "info", "debug" };
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Check whether a string that is not NULL terminated equals a NULL
+ * terminated string.
+ *
+ * @param[in] pcString The string.
+ * @param[in] xLength Length of pcString.
+ * @param[in] pcTerminated The NULL terminated string.
+ *
+ * @return 1 if the strings are equal; 0 otherwise.
+ */
+static int32_t prvEquals( const char * pcString,
+                          size_t xLength,
+                          const char * pcTerminated );
+
+/**
+ * @brief Check whether a character is white space.
+ *
+ * @param[in] cCharacter The character.
+ *
+ * @return 1 if the character is a space, tab, carriage return or line feed;
+ * 0 otherwise.
+ */
+static int32_t prvIsSpace( char cCharacter );
+
+/**
+ * @brief Parse one module=level setting.
+ *
+ * @param[in] pcSetting The setting.
+ * @param[in] xLength Length of pcSetting.
+ * @param[out] plModule The module, or -1 for every module.
+ * @param[out] pucLevel The level, reduced to LOG_LEVEL.
+ *
+ * @return 1 if the setting is valid; 0 otherwise.
+ */
+static int32_t prvParseSetting( const char * pcSetting,
+                                size_t xLength,
+                                int32_t * plModule,
+                                uint8_t * pucLevel );
+
+/**
+ * @brief Parse and optionally apply every setting of a list.
+ *
+ * @param[in] pcSettings The list.
+ * @param[in] xSettingsLength Length of pcSettings.
+ * @param[in] xApply Apply the settings if non-zero, only validate them
+ * otherwise.
+ *
+ * @return The number of settings, or -1 if a setting is invalid.
+ */
+static int32_t prvProcessSettings( const char * pcSettings,
+                                   size_t xSettingsLength,
+                                   int32_t xApply );
+
+/*-----------------------------------------------------------*/
+
+static int32_t prvEquals( const char * pcString,
+                          size_t xLength,
+                          const char * pcTerminated )
+{
+    return ( ( strlen( pcTerminated ) == xLength ) &&
+             ( strncmp( pcString, pcTerminated, xLength ) == 0 ) ) ? 1 : 0;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvIsSpace( char cCharacter )
+{
+    return ( ( cCharacter == ' ' ) || ( cCharacter == '\t' ) ||
+             ( cCharacter == '\r' ) || ( cCharacter == '\n' ) ) ? 1 : 0;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvParseSetting( const char * pcSetting,
+                                size_t xLength,
+                                int32_t * plModule,
+                                uint8_t * pucLevel )
+{
+    const char * pcLevel;
+    size_t xModuleLength = 0U, xLevelLength, xIndex;
+    uint32_t ulLevel = 0UL;
+    int32_t xValid = 1;
+
+    while( ( xModuleLength < xLength ) && ( pcSetting[ xModuleLength ] != '=' ) )
+    {
+        xModuleLength++;
+    }
+
+    if( xModuleLength == xLength )
+    {
+        xValid = 0;
+    }
+    else
+    {
+        pcLevel = &( pcSetting[ xModuleLength + 1U ] );
+        xLevelLength = xLength - xModuleLength - 1U;
+
+        /* Find the module. */
+        if( prvEquals( pcSetting, xModuleLength, loglevelsALL_MODULES ) != 0 )
+        {
+            *plModule = -1;
+        }
+        else
+        {
+            *plModule = ( int32_t ) eLogModuleCount;
+
+            for( xIndex = 0U; xIndex < ( size_t ) eLogModuleCount; xIndex++ )
+            {
+                if( prvEquals( pcSetting, xModuleLength, pcModuleNames[ xIndex ] ) != 0 )
+                {
+                    *plModule = ( int32_t ) xIndex;
+                }
+            }
+
+            if( *plModule == ( int32_t ) eLogModuleCount )
+            {
+                xValid = 0;
+            }
+        }
+
+        /* Find the level, by name or by number. */
+        if( ( xValid != 0 ) && ( xLevelLength > 0U ) &&
+            ( pcLevel[ 0 ] >= '0' ) && ( pcLevel[ 0 ] <= '9' ) )
+        {
+            for( xIndex = 0U; ( xIndex < xLevelLength ) && ( xValid != 0 ); xIndex++ )
+            {
+                if( ( pcLevel[ xIndex ] < '0' ) || ( pcLevel[ xIndex ] > '9' ) || ( ulLevel > LOG_DEBUG ) )
+                {
+                    xValid = 0;
+                }
+                else
+                {
+                    ulLevel = ( ulLevel * 10UL ) + ( uint32_t ) ( pcLevel[ xIndex ] - '0' );
+                }
+            }
+        }
+        else if( xValid != 0 )
+        {
+            ulLevel = sizeof( pcLevelNames ) / sizeof( pcLevelNames[ 0 ] );
+
+            for( xIndex = 0U; xIndex < ( sizeof( pcLevelNames ) / sizeof( pcLevelNames[ 0 ] ) ); xIndex++ )
+            {
+                if( prvEquals( pcLevel, xLevelLength, pcLevelNames[ xIndex ] ) != 0 )
+                {
+                    ulLevel = ( uint32_t ) xIndex;
+                }
+            }
+        }
+        else
+        {
+            /* The module is not valid. */
+        }
+
+        if( ( xValid != 0 ) && ( ulLevel > LOG_DEBUG ) )
+        {
+            xValid = 0;
+        }
+    }
+
+    if( xValid != 0 )
+    {
+        /* Messages above LOG_LEVEL are compiled out. */
+        *pucLevel = ( ulLevel > LOG_LEVEL ) ? ( uint8_t ) LOG_LEVEL : ( uint8_t ) ulLevel;
+    }
+
+    return xValid;
+}
+/*-----------------------------------------------------------*/
+
+static int32_t prvProcessSettings( const char * pcSettings,
+                                   size_t xSettingsLength,
+                                   int32_t xApply )
+{
+    size_t xStart = 0U, xEnd, xLast;
+    int32_t lModule, xCount = 0;
+    uint8_t ucLevel;
+
+    while( ( xStart < xSettingsLength ) && ( xCount >= 0 ) )
+    {
+        xEnd = xStart;
+
+        while( ( xEnd < xSettingsLength ) && ( pcSettings[ xEnd ] != ',' ) )
+        {
+            xEnd++;
+        }
+
+        /* Ignore white space around the setting. */
+        while( ( xStart < xEnd ) && ( prvIsSpace( pcSettings[ xStart ] ) != 0 ) )
+        {
+            xStart++;
+        }
+
+        xLast = xEnd;
+
+        while( ( xLast > xStart ) && ( prvIsSpace( pcSettings[ xLast - 1U ] ) != 0 ) )
+        {
+            xLast--;
+        }
+
+        if( prvParseSetting( &( pcSettings[ xStart ] ), xLast - xStart, &lModule, &ucLevel ) == 0 )
+        {
+            xCount = -1;
+        }
+        else
+        {
+            if( xApply != 0 )
+            {
+                if( lModule < 0 )
+                {
+                    ( void ) memset( ucLoggingModuleLevels, ucLevel, sizeof( ucLoggingModuleLevels ) );
+                }
+                else
+                {
+                    ucLoggingModuleLevels[ lModule ] = ucLevel;
+                }
+            }
+
+            xCount++;
+            xStart = xEnd + 1U;
+        }
+    }
+
+    return xCount;
+}
+/*-----------------------------------------------------------*/
+
+int32_t xLoggingSetLevels( const char * pcSettings,
+                           size_t xSettingsLength )
+{
+    int32_t xCount = -1;
+
+    if( pcSettings != NULL )
+    {
+        /* Validate every setting before applying any of them. */
+        xCount = prvProcessSettings( pcSettings, xSettingsLength, 0 );
+
+        if( xCount >= 0 )
+        {
+            ( void ) prvProcessSettings( pcSettings, xSettingsLength, 1 );
+        }
+    }
+
+    return xCount;
+}
+/*-----------------------------------------------------------*/
+
+int32_t xLoggingRateLimit( LogRateLimit_t * pxRateLimit,
+                           uint32_t * pulSuppressed )
+{
+    TickType_t xNow, xRefills;
+    int32_t xAllowed = 0;
+
+    configASSERT( pxRateLimit != NULL );
+    configASSERT( pulSuppressed != NULL );
+
+    *pulSuppressed = 0UL;
+    xNow = xTaskGetTickCount();
+
+    /* Several tasks can log from the same call site. */
+    taskENTER_CRITICAL();
+    {
+        /* Return the tokens refilled since the last refill.  A bucket that has
+         * not been used since it was last full is full. */
+        xRefills = ( xNow - ( TickType_t ) pxRateLimit->ulLastRefillTime ) / loglevelsREFILL_TICKS;
+
+        if( xRefills >= ( TickType_t ) pxRateLimit->usTokensUsed )
+        {
+            pxRateLimit->usTokensUsed = 0U;
+            pxRateLimit->ulLastRefillTime = ( uint32_t ) xNow;
+        }
+        else
+        {
+            pxRateLimit->usTokensUsed -= ( uint16_t ) xRefills;
+            pxRateLimit->ulLastRefillTime += ( uint32_t ) ( xRefills * loglevelsREFILL_TICKS );
+        }
+
+        if( pxRateLimit->usTokensUsed < LOG_RATE_LIMIT_BURST )
+        {
+            pxRateLimit->usTokensUsed++;
+            *pulSuppressed = pxRateLimit->usSuppressed;
+            pxRateLimit->usSuppressed = 0U;
+            xAllowed = 1;
+        }
+        else if( pxRateLimit->usSuppressed < UINT16_MAX )
+        {
+            pxRateLimit->usSuppressed++;
+        }
+        else
+        {
+            /* The count saturates. */
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xAllowed;
+}
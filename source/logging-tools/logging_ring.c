@@ -0,0 +1,759 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+
+/**
+ * @file logging_ring.c
+ *
+ * @brief Logging through a ring of log records, shared by the GCC builds.
+ *
+ * This logging example uses two function calls per logged message.  First
+ * xLoggingPrintMetadata() records the level of the message in the calling
+ * task's thread local storage.  Second vLoggingPrintf() claims a record in a
+ * ring of log records, formats the metadata and the message into it, then
+ * marks it ready.  A low priority drain task writes ready records out, through
+ * the vLoggingOutputWrite() of the build, in the order they were claimed.  A
+ * message too long for one record is formatted into a buffer protected by a
+ * mutex, then written to several consecutive records.
+ *
+ * Tasks that log never wait for the output or for each other.  Records are
+ * claimed with an atomic compare and swap on the head of the ring, so several
+ * tasks can format messages at the same time.  When every record is waiting to
+ * be written the message is dropped and counted instead.  Messages longer than
+ * dlMAX_MESSAGE_LENGTH, or too long for the records that are free, are
+ * truncated and counted.  The drain task reports the number of dropped and
+ * truncated messages the next time it writes.
+ *
+ * When LOG_BINARY is set to 1 in logging_config.h the logging macros call
+ * vLoggingPrintBinary() instead.  It writes a binary record holding the
+ * identifier of the format string and the raw argument values into the same
+ * ring, so nothing is formatted on the device.  decode_binary_log.py formats
+ * the records on the host.  Only the QEMU build links the format strings
+ * where decode_binary_log.py can find them.
+ *
+ * The prototypes for these functions are in demo_config.h so they can be
+ * adjusted for more or less metadata as required.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+
+/* FreeRTOS includes. */
+#include <FreeRTOS.h>
+#include "task.h"
+#include "semphr.h"
+
+/* Binary logging include, for the format of binary log records. */
+#include "logging_binary.h"
+
+#include "logging_ring.h"
+
+/*-----------------------------------------------------------*/
+
+/* Number of records in the ring - see logging_ring.h. */
+#define dlRING_RECORD_COUNT          ( ( uint32_t ) loggingringRECORD_COUNT )
+
+#if ( ( loggingringRECORD_COUNT & ( loggingringRECORD_COUNT - 1 ) ) != 0 )
+    #error loggingringRECORD_COUNT must be a power of 2.
+#endif
+
+/* Maximum number of characters in a record, including the metadata and the
+ * line ending.  Longer messages are written to several records. */
+#define dlMAX_RECORD_LENGTH          ( 200 )
+
+/* Maximum number of characters in a message, including the metadata and the
+ * line ending.  Longer messages are truncated. */
+#define dlMAX_MESSAGE_LENGTH         ( 2048 )
+
+#if ( dlMAX_MESSAGE_LENGTH > ( dlMAX_RECORD_LENGTH * loggingringRECORD_COUNT ) )
+    #error dlMAX_MESSAGE_LENGTH must fit in the records of the ring.
+#endif
+
+/* Number of characters in the line ending of a text message. */
+#define dlLINE_ENDING_LENGTH         ( ( int32_t ) sizeof( loggingringLINE_ENDING ) - 1 )
+
+/* Maximum amount of time to wait for the semaphores that protect the buffers
+ * used to format TCP/IP stack messages and long messages. */
+#define dlMAX_SEMAPHORE_WAIT_TIME    ( pdMS_TO_TICKS( 2000UL ) )
+
+/* Maximum time the drain task waits for a notification before checking the
+ * ring again.  Bounds the delay when a record is marked ready between the
+ * drain task finding it not ready and blocking. */
+#define dlDRAIN_POLL_TIME            ( pdMS_TO_TICKS( 100UL ) )
+
+/* Stack size and priority of the drain task.  It runs at the idle priority so
+ * writing the output never delays the tasks that log. */
+#define dlDRAIN_TASK_STACK_SIZE      ( configMINIMAL_STACK_SIZE )
+#define dlDRAIN_TASK_PRIORITY        ( tskIDLE_PRIORITY )
+
+/* Length of the fixed part of a binary record: the marker, level, argument
+ * count and record length bytes followed by the format identifier, message
+ * number, tick count and string mask. */
+#define dlBINARY_HEADER_LENGTH       ( 18 )
+
+/* Index of the thread local storage pointer holding the level passed to
+ * xLoggingPrintMetadata(). */
+#define dlLEVEL_STORAGE_INDEX        ( 0 )
+
+/* A record in the ring.  ulSequence is the ticket of the message that may
+ * next claim the record, or that ticket plus one once the message is ready to
+ * be written. */
+typedef struct LogRecord
+{
+    uint32_t ulSequence;
+    uint32_t ulLength;
+    char cText[ dlMAX_RECORD_LENGTH ];
+} LogRecord_t;
+
+static LogRecord_t xLogRing[ dlRING_RECORD_COUNT ];
+
+/* Ticket of the next record to be claimed.  Updated by the tasks that log. */
+static uint32_t ulRingHead = 0;
+
+/* Ticket of the next record to be written.  Only updated by the drain task. */
+static uint32_t ulRingTail = 0;
+
+/* Number of messages dropped because no record was free. */
+static uint32_t ulDroppedMessages = 0;
+
+/* Number of messages truncated to fit in the records. */
+static uint32_t ulTruncatedMessages = 0;
+
+/* Number of messages logged through xLoggingPrintMetadata(). */
+static uint32_t ulMessageNumber = 0;
+
+/* Level of a message logged before the scheduler starts, when there is no
+ * thread local storage and only one thread of execution. */
+static const char * pcLevelBeforeScheduler = NULL;
+
+static TaskHandle_t xDrainTask = NULL;
+
+/* Protects cTCPPrintString. */
+static SemaphoreHandle_t xTCPMutex = NULL;
+static char cTCPPrintString[ dlMAX_RECORD_LENGTH ];
+
+/* Protects cLongMessage. */
+static SemaphoreHandle_t xLongMessageMutex = NULL;
+static char cLongMessage[ dlMAX_MESSAGE_LENGTH ];
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Claim the next ulCount records of the ring, and set *pulTicket to the ticket
+ * of the first.  Returns pdFALSE if any of them is still waiting to be
+ * written.
+ */
+static BaseType_t prvClaimRecords( uint32_t ulCount,
+                                   uint32_t * pulTicket );
+
+/*
+ * Claim the next record of the ring.  Returns NULL, and counts the message as
+ * dropped, if every record is still waiting to be written.
+ */
+static LogRecord_t * prvClaimRecord( void );
+
+/*
+ * Mark a claimed record ready to be written and wake the drain task.
+ */
+static void prvReleaseRecord( LogRecord_t * pxRecord );
+
+/*
+ * Write ready records out in the order they were claimed.
+ */
+static void prvLogDrainTask( void * pvParameters );
+
+/*
+ * Log a message that did not fit in pxRecord, which holds iMetadataLength
+ * characters of metadata, by formatting it into cLongMessage then writing it
+ * to consecutive records.  Returns pdFALSE, without releasing pxRecord, if
+ * cLongMessage could not be used.
+ */
+static BaseType_t prvLogLongMessage( LogRecord_t * pxRecord,
+                                     int32_t iMetadataLength,
+                                     const char * pcFormat,
+                                     va_list args );
+
+/*
+ * Write ulValue into pucBuffer as 4 little endian bytes.
+ */
+static void prvWriteUint32( uint8_t * pucBuffer,
+                            uint32_t ulValue );
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvClaimRecords( uint32_t ulCount,
+                                   uint32_t * pulTicket )
+{
+    uint32_t ulTicket, ulLast, ulSequence;
+    int32_t lDifference;
+    BaseType_t xClaimed = pdFALSE, xFull = pdFALSE;
+
+    ulTicket = __atomic_load_n( &ulRingHead, __ATOMIC_RELAXED );
+
+    while( ( xClaimed == pdFALSE ) && ( xFull == pdFALSE ) )
+    {
+        /* The drain task frees records in ticket order, so if the last
+         * record is free for its ticket then so are the ones before it. */
+        ulLast = ulTicket + ulCount - 1UL;
+        ulSequence = __atomic_load_n( &( xLogRing[ ulLast & ( dlRING_RECORD_COUNT - 1UL ) ].ulSequence ), __ATOMIC_ACQUIRE );
+        lDifference = ( int32_t ) ( ulSequence - ulLast );
+
+        if( lDifference == 0 )
+        {
+            /* The records are free for these tickets.  Take the tickets unless
+             * another task took the first one first, in which case ulTicket is
+             * updated to the current head and the loop tries again. */
+            xClaimed = __atomic_compare_exchange_n( &ulRingHead, &ulTicket, ulTicket + ulCount, pdFALSE,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED );
+        }
+        else if( lDifference < 0 )
+        {
+            /* The record still holds a message from the previous pass around
+             * the ring, so the ring is full. */
+            xFull = pdTRUE;
+        }
+        else
+        {
+            /* Another task claimed the record after the head was read. */
+            ulTicket = __atomic_load_n( &ulRingHead, __ATOMIC_RELAXED );
+        }
+    }
+
+    *pulTicket = ulTicket;
+
+    return xClaimed;
+}
+/*-----------------------------------------------------------*/
+
+static LogRecord_t * prvClaimRecord( void )
+{
+    LogRecord_t * pxRecord = NULL;
+    uint32_t ulTicket;
+
+    if( prvClaimRecords( 1UL, &ulTicket ) != pdFALSE )
+    {
+        pxRecord = &( xLogRing[ ulTicket & ( dlRING_RECORD_COUNT - 1UL ) ] );
+    }
+    else
+    {
+        ( void ) __atomic_fetch_add( &ulDroppedMessages, 1UL, __ATOMIC_RELAXED );
+    }
+
+    return pxRecord;
+}
+/*-----------------------------------------------------------*/
+
+static void prvReleaseRecord( LogRecord_t * pxRecord )
+{
+    /* The record is free for its ticket until it is claimed, so its sequence
+     * number is the ticket. */
+    __atomic_store_n( &( pxRecord->ulSequence ), pxRecord->ulSequence + 1UL, __ATOMIC_RELEASE );
+
+    if( ( xDrainTask != NULL ) && ( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING ) )
+    {
+        xTaskNotifyGive( xDrainTask );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvLogDrainTask( void * pvParameters )
+{
+    LogRecord_t * pxRecord;
+    uint32_t ulDropped, ulReportedDrops = 0;
+    uint32_t ulTruncated, ulReportedTruncations = 0;
+    int32_t iLength;
+    char cReportString[ 80 ];
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        pxRecord = &( xLogRing[ ulRingTail & ( dlRING_RECORD_COUNT - 1UL ) ] );
+
+        if( __atomic_load_n( &( pxRecord->ulSequence ), __ATOMIC_ACQUIRE ) == ( ulRingTail + 1UL ) )
+        {
+            vLoggingOutputWrite( pxRecord->cText, pxRecord->ulLength );
+
+            /* Free the record for the ticket one pass around the ring later. */
+            __atomic_store_n( &( pxRecord->ulSequence ), ulRingTail + dlRING_RECORD_COUNT, __ATOMIC_RELEASE );
+            ulRingTail++;
+
+            ulDropped = __atomic_load_n( &ulDroppedMessages, __ATOMIC_RELAXED );
+            ulTruncated = __atomic_load_n( &ulTruncatedMessages, __ATOMIC_RELAXED );
+
+            if( ( ulDropped != ulReportedDrops ) || ( ulTruncated != ulReportedTruncations ) )
+            {
+                iLength = snprintf( cReportString, sizeof( cReportString ), "--- %lu log messages dropped, %lu truncated ---" loggingringLINE_ENDING,
+                                    ( unsigned long ) ( ulDropped - ulReportedDrops ),
+                                    ( unsigned long ) ( ulTruncated - ulReportedTruncations ) );
+                vLoggingOutputWrite( cReportString, ( size_t ) iLength );
+                ulReportedDrops = ulDropped;
+                ulReportedTruncations = ulTruncated;
+            }
+        }
+        else
+        {
+            ( void ) ulTaskNotifyTake( pdTRUE, dlDRAIN_POLL_TIME );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvWriteUint32( uint8_t * pucBuffer,
+                            uint32_t ulValue )
+{
+    pucBuffer[ 0 ] = ( uint8_t ) ulValue;
+    pucBuffer[ 1 ] = ( uint8_t ) ( ulValue >> 8 );
+    pucBuffer[ 2 ] = ( uint8_t ) ( ulValue >> 16 );
+    pucBuffer[ 3 ] = ( uint8_t ) ( ulValue >> 24 );
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvLogLongMessage( LogRecord_t * pxRecord,
+                                     int32_t iMetadataLength,
+                                     const char * pcFormat,
+                                     va_list args )
+{
+    BaseType_t xLogged = pdFALSE, xTruncated = pdFALSE;
+    uint32_t ulTicket, ulCount, ulLength, ulOffset, ulChunk;
+    int32_t iMessageLength;
+    LogRecord_t * pxChained;
+
+    if( ( xLongMessageMutex != NULL ) && ( xSemaphoreTake( xLongMessageMutex, dlMAX_SEMAPHORE_WAIT_TIME ) != pdFAIL ) )
+    {
+        /* Release the first record empty, so the drain task can pass it while
+         * the message is formatted. */
+        memcpy( cLongMessage, pxRecord->cText, ( size_t ) iMetadataLength );
+        pxRecord->ulLength = 0;
+        prvReleaseRecord( pxRecord );
+
+        /* Leave room for the line ending. */
+        iMessageLength = vsnprintf( &( cLongMessage[ iMetadataLength ] ), dlMAX_MESSAGE_LENGTH - dlLINE_ENDING_LENGTH - iMetadataLength, pcFormat, args );
+        ulLength = ( uint32_t ) iMetadataLength + ( ( iMessageLength > 0 ) ? ( uint32_t ) iMessageLength : 0UL );
+
+        if( ulLength > ( uint32_t ) ( dlMAX_MESSAGE_LENGTH - dlLINE_ENDING_LENGTH - 1 ) )
+        {
+            ulLength = ( uint32_t ) ( dlMAX_MESSAGE_LENGTH - dlLINE_ENDING_LENGTH - 1 );
+            xTruncated = pdTRUE;
+        }
+
+        memcpy( &( cLongMessage[ ulLength ] ), loggingringLINE_ENDING, dlLINE_ENDING_LENGTH );
+        ulLength += ( uint32_t ) dlLINE_ENDING_LENGTH;
+
+        ulCount = ( ulLength + dlMAX_RECORD_LENGTH - 1UL ) / dlMAX_RECORD_LENGTH;
+
+        if( prvClaimRecords( ulCount, &ulTicket ) == pdFALSE )
+        {
+            /* Not enough records in a row are free, so write as much of the
+             * message as fits in one. */
+            ulCount = 1UL;
+
+            if( ulLength > dlMAX_RECORD_LENGTH )
+            {
+                ulLength = dlMAX_RECORD_LENGTH;
+                memcpy( &( cLongMessage[ dlMAX_RECORD_LENGTH - dlLINE_ENDING_LENGTH ] ), loggingringLINE_ENDING, dlLINE_ENDING_LENGTH );
+                xTruncated = pdTRUE;
+            }
+
+            if( prvClaimRecords( ulCount, &ulTicket ) == pdFALSE )
+            {
+                ulCount = 0UL;
+                ( void ) __atomic_fetch_add( &ulDroppedMessages, 1UL, __ATOMIC_RELAXED );
+            }
+        }
+
+        for( ulOffset = 0UL; ulCount > 0UL; ulCount-- )
+        {
+            ulChunk = ulLength - ulOffset;
+
+            if( ulChunk > dlMAX_RECORD_LENGTH )
+            {
+                ulChunk = dlMAX_RECORD_LENGTH;
+            }
+
+            pxChained = &( xLogRing[ ulTicket & ( dlRING_RECORD_COUNT - 1UL ) ] );
+            memcpy( pxChained->cText, &( cLongMessage[ ulOffset ] ), ulChunk );
+            pxChained->ulLength = ulChunk;
+            prvReleaseRecord( pxChained );
+
+            ulOffset += ulChunk;
+            ulTicket++;
+        }
+
+        if( xTruncated != pdFALSE )
+        {
+            ( void ) __atomic_fetch_add( &ulTruncatedMessages, 1UL, __ATOMIC_RELAXED );
+        }
+
+        xSemaphoreGive( xLongMessageMutex );
+        xLogged = pdTRUE;
+    }
+
+    return xLogged;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * The prototype for this function, and the macros that call this function, are
+ * both in demo_config.h.  Update the macros and prototype to pass in additional
+ * meta data if required - for example the name of the function that called the
+ * log message can be passed in by adding an additional parameter to the function
+ * then updating the macro to pass __FUNCTION__ as the parameter value.  See the
+ * comments in demo_config.h for more information.
+ */
+int32_t xLoggingPrintMetadata( const char * const pcLevel )
+{
+    /* The metadata is formatted with the message, into the same record, so
+     * only the level is recorded here. */
+    if( xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED )
+    {
+        vTaskSetThreadLocalStoragePointer( NULL, dlLEVEL_STORAGE_INDEX, ( void * ) pcLevel );
+    }
+    else
+    {
+        pcLevelBeforeScheduler = pcLevel;
+    }
+
+    return 0;
+}
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * const pcFormat,
+                     ... )
+{
+    LogRecord_t * pxRecord;
+    const char * pcLevel;
+    const char * pcTaskName;
+    int32_t iLength, iMessageLength;
+    BaseType_t xLogged = pdFALSE;
+    va_list args;
+
+    if( xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED )
+    {
+        pcLevel = ( const char * ) pvTaskGetThreadLocalStoragePointer( NULL, dlLEVEL_STORAGE_INDEX );
+        vTaskSetThreadLocalStoragePointer( NULL, dlLEVEL_STORAGE_INDEX, NULL );
+        pcTaskName = pcTaskGetName( NULL );
+    }
+    else
+    {
+        pcLevel = pcLevelBeforeScheduler;
+        pcLevelBeforeScheduler = NULL;
+        pcTaskName = "None";
+    }
+
+    /* Only proceed if the preceding call to xLoggingPrintMetadata() recorded
+     * a level. */
+    if( pcLevel != NULL )
+    {
+        pxRecord = prvClaimRecord();
+
+        if( pxRecord != NULL )
+        {
+            iLength = snprintf( pxRecord->cText, dlMAX_RECORD_LENGTH, "%s: %s %lu %lu --- ",
+                                pcLevel,
+                                pcTaskName,
+                                ( unsigned long ) __atomic_fetch_add( &ulMessageNumber, 1UL, __ATOMIC_RELAXED ),
+                                ( unsigned long ) xTaskGetTickCount() );
+
+            /* Leave room for the line ending. */
+            if( iLength > ( dlMAX_RECORD_LENGTH - dlLINE_ENDING_LENGTH - 1 ) )
+            {
+                iLength = dlMAX_RECORD_LENGTH - dlLINE_ENDING_LENGTH - 1;
+            }
+
+            /* There are a variable number of parameters. */
+            va_start( args, pcFormat );
+            iMessageLength = vsnprintf( &( pxRecord->cText[ iLength ] ), dlMAX_RECORD_LENGTH - dlLINE_ENDING_LENGTH - iLength, pcFormat, args );
+            va_end( args );
+
+            if( iMessageLength >= ( dlMAX_RECORD_LENGTH - dlLINE_ENDING_LENGTH - iLength ) )
+            {
+                /* The message did not fit, so format it again to write it to
+                 * several records. */
+                va_start( args, pcFormat );
+                xLogged = prvLogLongMessage( pxRecord, iLength, pcFormat, args );
+                va_end( args );
+
+                if( xLogged == pdFALSE )
+                {
+                    ( void ) __atomic_fetch_add( &ulTruncatedMessages, 1UL, __ATOMIC_RELAXED );
+                }
+            }
+
+            if( xLogged == pdFALSE )
+            {
+                if( iMessageLength > 0 )
+                {
+                    iLength += iMessageLength;
+
+                    if( iLength > ( dlMAX_RECORD_LENGTH - dlLINE_ENDING_LENGTH - 1 ) )
+                    {
+                        iLength = dlMAX_RECORD_LENGTH - dlLINE_ENDING_LENGTH - 1;
+                    }
+                }
+
+                memcpy( &( pxRecord->cText[ iLength ] ), loggingringLINE_ENDING, dlLINE_ENDING_LENGTH );
+                pxRecord->ulLength = ( uint32_t ) ( iLength + dlLINE_ENDING_LENGTH );
+
+                prvReleaseRecord( pxRecord );
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * Called by the logging macros when LOG_BINARY is 1.  A binary record is
+ * written instead of text:
+ *
+ * byte 0       logbinaryRECORD_MARKER
+ * byte 1       level
+ * byte 2       number of arguments
+ * byte 3       length of the record in bytes, including these 4 bytes
+ * bytes 4-7    format identifier
+ * bytes 8-11   message number
+ * bytes 12-15  tick count
+ * bytes 16-17  string mask - bit i is set if argument i is a string
+ *
+ * followed by each argument in turn - a string argument as a length byte and
+ * up to logbinaryMAX_STRING_LENGTH characters, any other argument as 4 bytes.
+ * Multi-byte values are little endian.  Strings are truncated further if the
+ * record would not otherwise fit.
+ */
+void vLoggingPrintBinary( uint32_t ulLevel,
+                          uint32_t ulFormatId,
+                          uint32_t ulArgumentCount,
+                          uint32_t ulStringMask,
+                          ... )
+{
+    LogRecord_t * pxRecord;
+    uint8_t * pucRecord;
+    const char * pcString;
+    uint32_t ulArgument, ulValue, ulLength, ulStringLength, ulMaxStringLength;
+    BaseType_t xTruncated = pdFALSE;
+    va_list args;
+
+    configASSERT( ulArgumentCount <= logbinaryMAX_ARGUMENTS );
+
+    pxRecord = prvClaimRecord();
+
+    if( pxRecord != NULL )
+    {
+        pucRecord = ( uint8_t * ) pxRecord->cText;
+        pucRecord[ 0 ] = logbinaryRECORD_MARKER;
+        pucRecord[ 1 ] = ( uint8_t ) ulLevel;
+        pucRecord[ 2 ] = ( uint8_t ) ulArgumentCount;
+        prvWriteUint32( &( pucRecord[ 4 ] ), ulFormatId );
+        prvWriteUint32( &( pucRecord[ 8 ] ), __atomic_fetch_add( &ulMessageNumber, 1UL, __ATOMIC_RELAXED ) );
+        prvWriteUint32( &( pucRecord[ 12 ] ), ( uint32_t ) xTaskGetTickCount() );
+        pucRecord[ 16 ] = ( uint8_t ) ulStringMask;
+        pucRecord[ 17 ] = ( uint8_t ) ( ulStringMask >> 8 );
+        ulLength = dlBINARY_HEADER_LENGTH;
+
+        va_start( args, ulStringMask );
+
+        for( ulArgument = 0; ulArgument < ulArgumentCount; ulArgument++ )
+        {
+            ulValue = va_arg( args, uint32_t );
+
+            if( ( ulStringMask & ( 1UL << ulArgument ) ) != 0UL )
+            {
+                /* Keep room for the length byte of the string and for the
+                 * remaining arguments, assuming they are not strings. */
+                ulMaxStringLength = dlMAX_RECORD_LENGTH - ulLength - 1UL - ( 4UL * ( ulArgumentCount - ulArgument - 1UL ) );
+
+                if( ulMaxStringLength > logbinaryMAX_STRING_LENGTH )
+                {
+                    ulMaxStringLength = logbinaryMAX_STRING_LENGTH;
+                }
+
+                pcString = ( const char * ) ( uintptr_t ) ulValue;
+                ulStringLength = 0;
+
+                if( pcString != NULL )
+                {
+                    while( ( ulStringLength < ulMaxStringLength ) && ( pcString[ ulStringLength ] != '\0' ) )
+                    {
+                        ulStringLength++;
+                    }
+
+                    /* Strings longer than logbinaryMAX_STRING_LENGTH are
+                     * truncated by design, so only count the ones truncated to
+                     * fit in the record. */
+                    if( ( ulMaxStringLength < logbinaryMAX_STRING_LENGTH ) && ( pcString[ ulStringLength ] != '\0' ) )
+                    {
+                        xTruncated = pdTRUE;
+                    }
+
+                    memcpy( &( pucRecord[ ulLength + 1UL ] ), pcString, ulStringLength );
+                }
+
+                pucRecord[ ulLength ] = ( uint8_t ) ulStringLength;
+                ulLength += ulStringLength + 1UL;
+            }
+            else
+            {
+                prvWriteUint32( &( pucRecord[ ulLength ] ), ulValue );
+                ulLength += 4UL;
+            }
+        }
+
+        va_end( args );
+
+        pucRecord[ 3 ] = ( uint8_t ) ulLength;
+        pxRecord->ulLength = ulLength;
+
+        prvReleaseRecord( pxRecord );
+
+        if( xTruncated != pdFALSE )
+        {
+            ( void ) __atomic_fetch_add( &ulTruncatedMessages, 1UL, __ATOMIC_RELAXED );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * The TCP/IP stack logging pre-dates the mechanism used by the other libraries
+ * and performs a little more work to beutify any IP addresses.  This is called
+ * without first calling xLoggingPrintMetadata().  The message is formatted into
+ * a buffer protected by a mutex, then copied into a record with IP addresses
+ * converted to dot notation on the way.  The mutex is not held while the
+ * message is written out.
+ */
+void vTCPLoggingPrintf( const char * const pcFormat,
+                        ... )
+{
+    LogRecord_t * pxRecord;
+    char * pcSource, * pcTarget, * pcBegin, * pcEnd;
+    int32_t rc;
+    BaseType_t xTruncated;
+    va_list args;
+    uint32_t ulIPAddress;
+
+    configASSERT( xTCPMutex );
+
+    if( xSemaphoreTake( xTCPMutex, dlMAX_SEMAPHORE_WAIT_TIME ) != pdFAIL )
+    {
+        pxRecord = prvClaimRecord();
+
+        if( pxRecord != NULL )
+        {
+            /* There are a variable number of parameters. */
+            va_start( args, pcFormat );
+            rc = vsnprintf( cTCPPrintString, dlMAX_RECORD_LENGTH, pcFormat, args );
+            va_end( args );
+            xTruncated = ( rc >= dlMAX_RECORD_LENGTH ) ? pdTRUE : pdFALSE;
+
+            /* For ease of viewing, copy the string into the record, converting
+             * IP addresses to dot notation on the way.  Stop early enough to
+             * leave room for an address and the line ending. */
+            pcSource = cTCPPrintString;
+            pcTarget = pxRecord->cText;
+            pcEnd = &( pxRecord->cText[ dlMAX_RECORD_LENGTH - 18 ] );
+
+            while( ( ( *pcSource ) != '\0' ) && ( pcTarget < pcEnd ) )
+            {
+                *pcTarget = *pcSource;
+                pcTarget++;
+                pcSource++;
+
+                /* Look forward for an IP address denoted by 'ip'. */
+                if( ( isxdigit( ( int ) pcSource[ 0 ] ) != pdFALSE ) && ( pcSource[ 1 ] == 'i' ) && ( pcSource[ 2 ] == 'p' ) )
+                {
+                    *pcTarget = *pcSource;
+                    pcTarget++;
+                    *pcTarget = '\0';
+                    pcBegin = pcTarget - 8;
+
+                    while( ( pcTarget > pcBegin ) && ( pcTarget > pxRecord->cText ) && ( isxdigit( ( int ) pcTarget[ -1 ] ) != pdFALSE ) )
+                    {
+                        pcTarget--;
+                    }
+
+                    sscanf( pcTarget, "%8X", ( unsigned int * ) &ulIPAddress );
+                    rc = sprintf( pcTarget, "%lu.%lu.%lu.%lu",
+                                  ( unsigned long ) ( ulIPAddress >> 24UL ),
+                                  ( unsigned long ) ( ( ulIPAddress >> 16UL ) & 0xffUL ),
+                                  ( unsigned long ) ( ( ulIPAddress >> 8UL ) & 0xffUL ),
+                                  ( unsigned long ) ( ulIPAddress & 0xffUL ) );
+                    pcTarget += rc;
+                    pcSource += 3; /* skip "<n>ip" */
+                }
+            }
+
+            if( *pcSource != '\0' )
+            {
+                xTruncated = pdTRUE;
+            }
+
+            memcpy( pcTarget, loggingringLINE_ENDING, dlLINE_ENDING_LENGTH );
+            pcTarget += dlLINE_ENDING_LENGTH;
+
+            /* How far through the record was written? */
+            pxRecord->ulLength = ( uint32_t ) ( pcTarget - pxRecord->cText );
+
+            prvReleaseRecord( pxRecord );
+
+            if( xTruncated != pdFALSE )
+            {
+                ( void ) __atomic_fetch_add( &ulTruncatedMessages, 1UL, __ATOMIC_RELAXED );
+            }
+        }
+
+        xSemaphoreGive( xTCPMutex );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void vLoggingInit( void )
+{
+    uint32_t ulRecord;
+
+    /* Every record starts free for the ticket of its first use. */
+    for( ulRecord = 0; ulRecord < dlRING_RECORD_COUNT; ulRecord++ )
+    {
+        xLogRing[ ulRecord ].ulSequence = ulRecord;
+    }
+
+    /* Create the semaphores used to protect the buffers used to format TCP/IP
+     * stack messages and long messages. */
+    xTCPMutex = xSemaphoreCreateMutex();
+    xLongMessageMutex = xSemaphoreCreateMutex();
+
+    /* Create the task that writes log records out.  Records logged
+     * before the scheduler starts are written once it runs. */
+    ( void ) xTaskCreate( prvLogDrainTask,
+                          "LogDrain",
+                          dlDRAIN_TASK_STACK_SIZE,
+                          NULL,
+                          dlDRAIN_TASK_PRIORITY,
+                          &xDrainTask );
+}
@@ -0,0 +1,74 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file logging_ring.h
+ *
+ * @brief Configuration of the ring of log records shared by the GCC builds,
+ * and the function each build provides to write the records out.
+ *
+ * logging_ring.c implements the logging functions declared in
+ * logging_config.h.  Tasks that log format their messages into records of a
+ * ring, and a low priority drain task passes the records to
+ * vLoggingOutputWrite(), which each build implements in its
+ * logging_output_*.c - the QEMU build writes to the UART and the Linux build
+ * writes to the standard output.  The number of records and the line ending
+ * can be overridden in FreeRTOSConfig.h.
+ */
+
+#ifndef LOGGING_RING_H_
+#define LOGGING_RING_H_
+
+#include <stddef.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief Number of records in the ring.  Must be a power of 2.  A message
+ * longer than a record of 200 characters takes several records, so the ring
+ * must hold at least 16 records.
+ */
+#ifndef loggingringRECORD_COUNT
+    #define loggingringRECORD_COUNT    ( 32U )
+#endif
+
+/**
+ * @brief Characters that end every text message.  At most 2 characters.
+ */
+#ifndef loggingringLINE_ENDING
+    #define loggingringLINE_ENDING    "\r\n"
+#endif
+
+/*
+ * Write xLength bytes of log output.  Only called by the drain task, so the
+ * implementation can block and need not be thread safe.
+ */
+void vLoggingOutputWrite( const char * pcBuffer,
+                          size_t xLength );
+
+#endif /* LOGGING_RING_H_ */
@@ -37,14 +37,39 @@
 /* FreeRTOS includes. */
 #include <FreeRTOS.h>
 #include "task.h"
-
-/* TCP/IP stack includes. */
-#include "FreeRTOS_IP.h"
-#include "FreeRTOS_Sockets.h"
+#include "timers.h"
 
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+/* TCP/IP stack includes.  The Linux build uses the sockets of the host. */
+#if ( democonfigUSE_POSIX_SOCKETS == 0 )
+    #include "FreeRTOS_IP.h"
+    #include "FreeRTOS_Sockets.h"
+#endif
+
+/* Heap accounting include. */
+#include "heap_tags.h"
+
+/* Clock include. */
+#include "clock_source.h"
+
+#ifndef democonfigCREATE_HEAP_BENCHMARK_TASK
+    #error Please define democonfigCREATE_HEAP_BENCHMARK_TASK to 1 or 0 in demo_config.h - determines if vStartHeapBenchmarkTask() gets called or not.
+#endif
+
+#if ( democonfigCREATE_HEAP_BENCHMARK_TASK != 0 ) && !defined( democonfigHEAP_BENCHMARK_TASK_STACK_SIZE )
+    #error Please define democonfigHEAP_BENCHMARK_TASK_STACK_SIZE in demo_config.h to set the stack size (in words, not bytes) for the task created by vStartHeapBenchmarkTask().
+#endif
+
+#ifndef democonfigCREATE_FLEET_SIMULATOR
+    #error Please define democonfigCREATE_FLEET_SIMULATOR to 1 or 0 in demo_config.h - determines if vStartFleetSimulator() gets called or not.
+#endif
+
+#if ( democonfigCREATE_FLEET_SIMULATOR != 0 ) && !defined( democonfigFLEET_SIMULATOR_TASK_STACK_SIZE )
+    #error Please define democonfigFLEET_SIMULATOR_TASK_STACK_SIZE in demo_config.h to set the stack size (in words, not bytes) for the task created by vStartFleetSimulator().
+#endif
+
 /*
  * Prototypes for the demos that can be started from this project.  Note the
  * MQTT demo is not actually started until the network is already, which is
@@ -53,6 +78,20 @@
  */
 extern void vStartMQTTAgentDemo( void );
 
+/*
+ * Prototype for the heap benchmark, which does not use the network so is
+ * started before the scheduler.
+ */
+extern void vStartHeapBenchmarkTask( configSTACK_DEPTH_TYPE uxStackSize,
+                                     UBaseType_t uxPriority );
+
+/*
+ * Prototype for the fleet simulator, which connects with the sockets of the
+ * host so is only available in the Linux build.
+ */
+extern void vStartFleetSimulator( configSTACK_DEPTH_TYPE uxStackSize,
+                                  UBaseType_t uxPriority );
+
 /*
  * Just seeds the simple pseudo random number generator.
  *
@@ -68,22 +107,32 @@ static void prvSRand( UBaseType_t ulSeed );
  */
 static void prvMiscInitialisation( void );
 
-/* The default IP and MAC address used by the demo.  The address configuration
- * defined here will be used if ipconfigUSE_DHCP is 0, or if ipconfigUSE_DHCP is
- * 1 but a DHCP server could not be contacted.  See the online documentation for
- * more information. */
-static const uint8_t ucIPAddress[ 4 ] = { configIP_ADDR0, configIP_ADDR1, configIP_ADDR2, configIP_ADDR3 };
-static const uint8_t ucNetMask[ 4 ] = { configNET_MASK0, configNET_MASK1, configNET_MASK2, configNET_MASK3 };
-static const uint8_t ucGatewayAddress[ 4 ] = { configGATEWAY_ADDR0, configGATEWAY_ADDR1, configGATEWAY_ADDR2, configGATEWAY_ADDR3 };
-static const uint8_t ucDNSServerAddress[ 4 ] = { configDNS_SERVER_ADDR0, configDNS_SERVER_ADDR1, configDNS_SERVER_ADDR2, configDNS_SERVER_ADDR3 };
+/*
+ * Log that an allocation failed, and which subsystems hold the heap.  Has the
+ * signature of a function pended with xTimerPendFunctionCall().
+ */
+static void prvLogMallocFailure( void * pvParameter1,
+                                 uint32_t ulParameter2 );
+
+#if ( democonfigUSE_POSIX_SOCKETS == 0 )
 
+    /* The default IP and MAC address used by the demo.  The address configuration
+     * defined here will be used if ipconfigUSE_DHCP is 0, or if ipconfigUSE_DHCP is
+     * 1 but a DHCP server could not be contacted.  See the online documentation for
+     * more information. */
+    static const uint8_t ucIPAddress[ 4 ] = { configIP_ADDR0, configIP_ADDR1, configIP_ADDR2, configIP_ADDR3 };
+    static const uint8_t ucNetMask[ 4 ] = { configNET_MASK0, configNET_MASK1, configNET_MASK2, configNET_MASK3 };
+    static const uint8_t ucGatewayAddress[ 4 ] = { configGATEWAY_ADDR0, configGATEWAY_ADDR1, configGATEWAY_ADDR2, configGATEWAY_ADDR3 };
+    static const uint8_t ucDNSServerAddress[ 4 ] = { configDNS_SERVER_ADDR0, configDNS_SERVER_ADDR1, configDNS_SERVER_ADDR2, configDNS_SERVER_ADDR3 };
 
-/* Default MAC address configuration.  The demo creates a virtual network
- * connection that uses this MAC address by accessing the raw Ethernet data
- * to and from a real network connection on the host PC.  See the
- * configNETWORK_INTERFACE_TO_USE definition for information on how to configure
- * the real network connection to use. */
-const uint8_t ucMACAddress[ 6 ] = { configMAC_ADDR0, configMAC_ADDR1, configMAC_ADDR2, configMAC_ADDR3, configMAC_ADDR4, configMAC_ADDR5 };
+
+    /* Default MAC address configuration.  The demo creates a virtual network
+     * connection that uses this MAC address by accessing the raw Ethernet data
+     * to and from a real network connection on the host PC.  See the
+     * configNETWORK_INTERFACE_TO_USE definition for information on how to configure
+     * the real network connection to use. */
+    const uint8_t ucMACAddress[ 6 ] = { configMAC_ADDR0, configMAC_ADDR1, configMAC_ADDR2, configMAC_ADDR3, configMAC_ADDR4, configMAC_ADDR5 };
+#endif /* if ( democonfigUSE_POSIX_SOCKETS == 0 ) */
 
 /* Use by the pseudo random number generator. */
 static UBaseType_t ulNextRand;
@@ -101,14 +150,38 @@ int main( void )
      * the random number generator. */
     prvMiscInitialisation();
 
-    /* Initialize the network interface.
-     *
-     ***NOTE*** Tasks that use the network are created in the network event hook
-     * when the network is connected and ready for use (see the implementation of
-     * vApplicationIPNetworkEventHook() below).  The address values passed in here
-     * are used if ipconfigUSE_DHCP is set to 0, or if ipconfigUSE_DHCP is set to 1
-     * but a DHCP server cannot be contacted. */
-    FreeRTOS_IPInit( ucIPAddress, ucNetMask, ucGatewayAddress, ucDNSServerAddress, ucMACAddress );
+    #if ( democonfigUSE_POSIX_SOCKETS == 1 )
+        {
+            /* The network of the host is already up, so the demos that use
+             * the network can be created straight away. */
+            LogInfo( ( "---------STARTING DEMO---------\r\n" ) );
+            vStartMQTTAgentDemo();
+
+            #if ( democonfigCREATE_FLEET_SIMULATOR == 1 )
+                {
+                    vStartFleetSimulator( democonfigFLEET_SIMULATOR_TASK_STACK_SIZE,
+                                          tskIDLE_PRIORITY );
+                }
+            #endif
+        }
+    #else
+
+        /* Initialize the network interface.
+         *
+         ***NOTE*** Tasks that use the network are created in the network event hook
+         * when the network is connected and ready for use (see the implementation of
+         * vApplicationIPNetworkEventHook() below).  The address values passed in here
+         * are used if ipconfigUSE_DHCP is set to 0, or if ipconfigUSE_DHCP is set to 1
+         * but a DHCP server cannot be contacted. */
+        FreeRTOS_IPInit( ucIPAddress, ucNetMask, ucGatewayAddress, ucDNSServerAddress, ucMACAddress );
+    #endif /* if ( democonfigUSE_POSIX_SOCKETS == 1 ) */
+
+    #if ( democonfigCREATE_HEAP_BENCHMARK_TASK == 1 )
+        {
+            vStartHeapBenchmarkTask( democonfigHEAP_BENCHMARK_TASK_STACK_SIZE,
+                                     tskIDLE_PRIORITY );
+        }
+    #endif
 
     /* Start the RTOS scheduler. */
     vTaskStartScheduler();
@@ -125,44 +198,47 @@ int main( void )
 }
 /*-----------------------------------------------------------*/
 
-/* Called by FreeRTOS+TCP when the network connects or disconnects.  Disconnect
- * events are only received if implemented in the MAC driver. */
-void vApplicationIPNetworkEventHook( eIPCallbackEvent_t eNetworkEvent )
-{
-    uint32_t ulIPAddress, ulNetMask, ulGatewayAddress, ulDNSServerAddress;
-    char cBuffer[ 16 ];
-    static BaseType_t xTasksAlreadyCreated = pdFALSE;
+#if ( democonfigUSE_POSIX_SOCKETS == 0 )
 
-    /* If the network has just come up...*/
-    if( eNetworkEvent == eNetworkUp )
+    /* Called by FreeRTOS+TCP when the network connects or disconnects.  Disconnect
+     * events are only received if implemented in the MAC driver. */
+    void vApplicationIPNetworkEventHook( eIPCallbackEvent_t eNetworkEvent )
     {
-        /* Create the tasks that use the IP stack if they have not already been
-         * created. */
-        if( xTasksAlreadyCreated == pdFALSE )
+        uint32_t ulIPAddress, ulNetMask, ulGatewayAddress, ulDNSServerAddress;
+        char cBuffer[ 16 ];
+        static BaseType_t xTasksAlreadyCreated = pdFALSE;
+
+        /* If the network has just come up...*/
+        if( eNetworkEvent == eNetworkUp )
         {
-            /* Demos that use the network are created after the network is
-             * up. */
-            LogInfo( ( "---------STARTING DEMO---------\r\n" ) );
-            vStartMQTTAgentDemo();
-            xTasksAlreadyCreated = pdTRUE;
+            /* Create the tasks that use the IP stack if they have not already been
+             * created. */
+            if( xTasksAlreadyCreated == pdFALSE )
+            {
+                /* Demos that use the network are created after the network is
+                 * up. */
+                LogInfo( ( "---------STARTING DEMO---------\r\n" ) );
+                vStartMQTTAgentDemo();
+                xTasksAlreadyCreated = pdTRUE;
+            }
+
+            /* Print out the network configuration, which may have come from a DHCP
+             * server. */
+            FreeRTOS_GetAddressConfiguration( &ulIPAddress, &ulNetMask, &ulGatewayAddress, &ulDNSServerAddress );
+            FreeRTOS_inet_ntoa( ulIPAddress, cBuffer );
+            LogInfo( ( "\r\n\r\nIP Address: %s\r\n", cBuffer ) );
+
+            FreeRTOS_inet_ntoa( ulNetMask, cBuffer );
+            LogInfo( ( "Subnet Mask: %s\r\n", cBuffer ) );
+
+            FreeRTOS_inet_ntoa( ulGatewayAddress, cBuffer );
+            LogInfo( ( "Gateway Address: %s\r\n", cBuffer ) );
+
+            FreeRTOS_inet_ntoa( ulDNSServerAddress, cBuffer );
+            LogInfo( ( "DNS Server Address: %s\r\n\r\n\r\n", cBuffer ) );
         }
-
-        /* Print out the network configuration, which may have come from a DHCP
-         * server. */
-        FreeRTOS_GetAddressConfiguration( &ulIPAddress, &ulNetMask, &ulGatewayAddress, &ulDNSServerAddress );
-        FreeRTOS_inet_ntoa( ulIPAddress, cBuffer );
-        LogInfo( ( "\r\n\r\nIP Address: %s\r\n", cBuffer ) );
-
-        FreeRTOS_inet_ntoa( ulNetMask, cBuffer );
-        LogInfo( ( "Subnet Mask: %s\r\n", cBuffer ) );
-
-        FreeRTOS_inet_ntoa( ulGatewayAddress, cBuffer );
-        LogInfo( ( "Gateway Address: %s\r\n", cBuffer ) );
-
-        FreeRTOS_inet_ntoa( ulDNSServerAddress, cBuffer );
-        LogInfo( ( "DNS Server Address: %s\r\n\r\n\r\n", cBuffer ) );
     }
-}
+#endif /* if ( democonfigUSE_POSIX_SOCKETS == 0 ) */
 /*-----------------------------------------------------------*/
 
 void vAssertCalled( const char * pcFile,
@@ -224,6 +300,13 @@ static void prvMiscInitialisation( void )
         }
     #endif
 
+    /* Select the clock before any task measures time with it. */
+    #if ( democonfigUSE_SIMULATED_CLOCK == 1 )
+        {
+            vClockSetSource( &xClockSimulatedSource );
+        }
+    #endif
+
     vLoggingInit();
 
     /*
@@ -236,7 +319,7 @@ static void prvMiscInitialisation( void )
     time( &xTimeNow );
     LogDebug( ( "Seed for randomizer: %lu\n", xTimeNow ) );
     prvSRand( ( uint32_t ) xTimeNow );
-    LogDebug( ( "Random numbers: %08X %08X %08X %08X\n", ipconfigRAND32(), ipconfigRAND32(), ipconfigRAND32(), ipconfigRAND32() ) );
+    LogDebug( ( "Random numbers: %08X %08X %08X %08X\n", uxRand(), uxRand(), uxRand(), uxRand() ) );
 }
 /*-----------------------------------------------------------*/
 
@@ -330,9 +413,33 @@ void vApplicationGetTimerTaskMemory( StaticTask_t ** ppxTimerTaskTCBBuffer,
 }
 /*-----------------------------------------------------------*/
 
-void vApplicationMallocFailedHook( void )
+static void prvLogMallocFailure( void * pvParameter1,
+                                 uint32_t ulParameter2 )
 {
+    ( void ) pvParameter1;
+    ( void ) ulParameter2;
+
     LogDebug( ( "Malloc failed\n" ) );
+
+    /* Show which subsystems hold the heap. */
+    vHeapTagsLogStats();
+}
+/*-----------------------------------------------------------*/
+
+void vApplicationMallocFailedHook( void )
+{
+    /* pvHeapTagsMalloc() calls the heap with the scheduler suspended, and the
+     * logging may block on a mutex, which is not allowed while the scheduler
+     * is suspended.  In that case the timer task logs the failure instead.
+     * The log is lost if the timer command queue is full. */
+    if( xTaskGetSchedulerState() == taskSCHEDULER_SUSPENDED )
+    {
+        ( void ) xTimerPendFunctionCall( prvLogMallocFailure, NULL, 0U, 0U );
+    }
+    else
+    {
+        prvLogMallocFailure( NULL, 0U );
+    }
 }
 /*-----------------------------------------------------------*/
 
@@ -51,6 +51,9 @@
  */
 
 
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleAgent
+
 /* Standard includes. */
 #include <string.h>
 #include <stdio.h>
@@ -61,13 +64,16 @@
 #include "queue.h"
 #include "task.h"
 
-/* FreeRTOS+TCP includes. */
-#include "FreeRTOS_IP.h"
-#include "FreeRTOS_Sockets.h"
-
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+/* FreeRTOS+TCP includes.  The Linux build uses the sockets of the host, and
+ * the broker simulator uses no sockets. */
+#if ( democonfigUSE_POSIX_SOCKETS == 0 ) && ( democonfigUSE_BROKER_SIMULATOR == 0 )
+    #include "FreeRTOS_IP.h"
+    #include "FreeRTOS_Sockets.h"
+#endif
+
 /* MQTT library includes. */
 #include "core_mqtt.h"
 
@@ -78,18 +84,23 @@
 #include "freertos_agent_message.h"
 #include "freertos_command_pool.h"
 
+/* MQTT agent instance include. */
+#include "mqtt-agent-task.h"
+
 /* Exponential backoff retry include. */
 #include "backoff_algorithm.h"
 
 /* Subscription manager header include. */
 #include "subscription_manager.h"
 
+/* Clock include. */
+#include "clock_source.h"
+
 
-/* Transport interface include. */
-#if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
-    #include "using_mbedtls.h"
-#else
-    #include "using_plaintext.h"
+/* The transport interface is included by mqtt-agent-task.h.  The wakeup
+ * callback of the broker simulator is passed the connection with data. */
+#if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+    typedef BrokerSimulatorConnection_t * Socket_t;
 #endif
 
 /* This demo uses compile time options to select the demo tasks to created.
@@ -135,13 +146,20 @@
     #error Please define democonfigSHADOW_TASK_STACK_SIZE in demo_config.h to set the stack size (in words, not bytes) for the tasks created by vStartShadowDemo().
 #endif
 
-/**
- * @brief Dimensions the buffer used to serialize and deserialize MQTT packets.
- * @note Specified in bytes.  Must be large enough to hold the maximum
- * anticipated MQTT payload.
- */
-#ifndef MQTT_AGENT_NETWORK_BUFFER_SIZE
-    #define MQTT_AGENT_NETWORK_BUFFER_SIZE    ( 5000 )
+#ifndef democonfigCREATE_LOG_CONTROL_TASK
+    #error Please define democonfigCREATE_LOG_CONTROL_TASK to 1 or 0 in demo_config.h - determines if vStartLogControlTask() gets called or not.
+#endif
+
+#if ( democonfigCREATE_LOG_CONTROL_TASK != 0 ) && !defined( democonfigLOG_CONTROL_TASK_STACK_SIZE )
+    #error Please define democonfigLOG_CONTROL_TASK_STACK_SIZE in demo_config.h to set the stack size (in words, not bytes) for the task created by vStartLogControlTask().
+#endif
+
+#ifndef democonfigCREATE_CLOCK_SKIP_TASK
+    #error Please define democonfigCREATE_CLOCK_SKIP_TASK to 1 or 0 in demo_config.h - determines if vStartClockSkipTask() gets called or not.
+#endif
+
+#if ( democonfigCREATE_CLOCK_SKIP_TASK != 0 ) && !defined( democonfigCLOCK_SKIP_TASK_STACK_SIZE )
+    #error Please define democonfigCLOCK_SKIP_TASK_STACK_SIZE in demo_config.h to set the stack size (in words, not bytes) for the task created by vStartClockSkipTask().
 #endif
 
 /**
@@ -187,12 +205,6 @@
  */
 #define mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS    ( 750 )
 
-/**
- * @brief Used to convert times to/from ticks and milliseconds.
- */
-#define mqttexampleMILLISECONDS_PER_SECOND           ( 1000U )
-#define mqttexampleMILLISECONDS_PER_TICK             ( mqttexampleMILLISECONDS_PER_SECOND / configTICK_RATE_HZ )
-
 /**
  * @brief The MQTT agent manages the MQTT contexts.  This set the handle to the
  * context used by this demo.
@@ -222,38 +234,41 @@
  * @brief Initializes an MQTT context, including transport interface and
  * network buffer.
  *
+ * @param[in] pxInstance The connection to initialize.
+ *
  * @return `MQTTSuccess` if the initialization succeeds, else `MQTTBadParameter`.
  */
-static MQTTStatus_t prvMQTTInit( void );
+static MQTTStatus_t prvMQTTInit( MQTTAgentInstance_t * pxInstance );
 
 /**
  * @brief Sends an MQTT Connect packet over the already connected TCP socket.
  *
- * @param[in] pxMQTTContext MQTT context pointer.
+ * @param[in] pxInstance The connection to connect.
  * @param[in] xCleanSession If a clean session should be established.
  *
  * @return `MQTTSuccess` if connection succeeds, else appropriate error code
  * from MQTT_Connect.
  */
-static MQTTStatus_t prvMQTTConnect( bool xCleanSession );
+static MQTTStatus_t prvMQTTConnect( MQTTAgentInstance_t * pxInstance,
+                                    bool xCleanSession );
 
 /**
  * @brief Connect a TCP socket to the MQTT broker.
  *
- * @param[in] pxNetworkContext Network context.
+ * @param[in] pxInstance The connection whose socket to connect.
  *
  * @return `pdPASS` if connection succeeds, else `pdFAIL`.
  */
-static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext );
+static BaseType_t prvSocketConnect( MQTTAgentInstance_t * pxInstance );
 
 /**
  * @brief Disconnect a TCP connection.
  *
- * @param[in] pxNetworkContext Network context.
+ * @param[in] pxInstance The connection whose socket to disconnect.
  *
  * @return `pdPASS` if disconnect succeeds, else `pdFAIL`.
  */
-static BaseType_t prvSocketDisconnect( NetworkContext_t * pxNetworkContext );
+static BaseType_t prvSocketDisconnect( MQTTAgentInstance_t * pxInstance );
 
 /**
  * @brief Callback executed when there is activity on the TCP socket that is
@@ -262,9 +277,41 @@ static BaseType_t prvSocketDisconnect( NetworkContext_t * pxNetworkContext );
  * task unblocks and can therefore process whatever is necessary on the socket
  * (if anything) as quickly as possible.
  *
- * @param[in] pxSocket Socket with data, unused.
+ * @param[in] pxSocket Socket with data.
+ * @param[in] pvContext The connection that owns the socket.
+ *
+ * @note With the sockets of the host the callback is called from the task
+ * that polls the sockets, see Sockets_SetWakeupCallback(), and with the broker
+ * simulator from the timer service task.
+ */
+static void prvMQTTClientSocketWakeupCallback( Socket_t pxSocket,
+                                               void * pvContext );
+
+#if ( democonfigUSE_POSIX_SOCKETS == 0 ) && ( democonfigUSE_BROKER_SIMULATOR == 0 )
+
+/**
+ * @brief The callback set with the FREERTOS_SO_WAKEUP_CALLBACK socket option,
+ * which is not passed a context.  Finds the connection that owns the socket
+ * in pxConnectedInstances and calls prvMQTTClientSocketWakeupCallback().
+ *
+ * @param[in] pxSocket Socket with data.
+ */
+    static void prvFreeRTOSSocketWakeupCallback( Socket_t pxSocket );
+
+/**
+ * @brief Add a connection to pxConnectedInstances if it is not in the list.
+ *
+ * @param[in] pxInstance The connection.
  */
-static void prvMQTTClientSocketWakeupCallback( Socket_t pxSocket );
+    static void prvAddConnectedInstance( MQTTAgentInstance_t * pxInstance );
+
+/**
+ * @brief Remove a connection from pxConnectedInstances if it is in the list.
+ *
+ * @param[in] pxInstance The connection.
+ */
+    static void prvRemoveConnectedInstance( MQTTAgentInstance_t * pxInstance );
+#endif
 
 /**
  * @brief Fan out the incoming publishes to the callbacks registered by different
@@ -288,10 +335,12 @@ static void prvIncomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
  * enqueue commands to the MQTT Agent queue and will be processed once the
  * command loop starts.
  *
+ * @param[in] pxInstance The connection to resubscribe.
+ *
  * @return `MQTTSuccess` if adding subscribes to the command queue succeeds, else
  * appropriate error code from MQTTAgent_Subscribe.
  * */
-static MQTTStatus_t prvHandleResubscribe( void );
+static MQTTStatus_t prvHandleResubscribe( MQTTAgentInstance_t * pxInstance );
 
 /**
  * @brief Passed into MQTTAgent_Subscribe() as the callback to execute when the
@@ -301,27 +350,13 @@ static MQTTStatus_t prvHandleResubscribe( void );
  *
  * See https://freertos.org/mqtt/mqtt-agent-demo.html#example_mqtt_api_call
  *
- * @param[in] pxCommandContext Context of the initial command.
+ * @param[in] pxCommandContext Context of the initial command, which is the
+ * connection that resubscribed.
  * @param[in] pxReturnInfo The result of the command.
  */
 static void prvSubscriptionCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
                                             MQTTAgentReturnInfo_t * pxReturnInfo );
 
-/**
- * @brief Task used to run the MQTT agent.  In this example the first task that
- * is created is responsible for creating all the other demo tasks.  Then,
- * rather than create prvMQTTAgentTask() as a separate task, it simply calls
- * prvMQTTAgentTask() to become the agent task itself.
- *
- * This task calls MQTTAgent_CommandLoop() in a loop, until MQTTAgent_Terminate()
- * is called. If an error occurs in the command loop, then it will reconnect the
- * TCP and MQTT connections.
- *
- * @param[in] pvParameters Parameters as passed at the time of task creation. Not
- * used in this example.
- */
-static void prvMQTTAgentTask( void * pvParameters );
-
 /**
  * @brief The main task used in the MQTT demo.
  *
@@ -336,18 +371,14 @@ static void prvMQTTAgentTask( void * pvParameters );
 static void prvConnectAndCreateDemoTasks( void * pvParameters );
 
 /**
- * @brief The timer query function provided to the MQTT context.
+ * @brief The timer query function provided to the MQTT context.  Reads the
+ * clock selected in clock_source.h, so keep-alive and the MQTT timeouts run
+ * in virtual time when the simulated clock is used.
  *
  * @return Time in milliseconds.
  */
 static uint32_t prvGetTimeMs( void );
 
-/**
- * @brief Connects a TCP socket to the MQTT broker, then creates and MQTT
- * connection to the same.
- */
-static void prvConnectToMQTTBroker( void );
-
 /*
  * Functions that start the tasks demonstrated by this project.
  */
@@ -370,13 +401,13 @@ extern void vStartDefenderDemo( configSTACK_DEPTH_TYPE uxStackSize,
 
 extern void vStartShadowDemo( configSTACK_DEPTH_TYPE uxStackSize,
                               UBaseType_t uxPriority );
-/*-----------------------------------------------------------*/
 
-/**
- * @brief The network context used by the MQTT library transport interface.
- * See https://www.freertos.org/network-interface.html
- */
-static NetworkContext_t xNetworkContext;
+extern void vStartLogControlTask( configSTACK_DEPTH_TYPE uxStackSize,
+                                  UBaseType_t uxPriority );
+
+extern void vStartClockSkipTask( configSTACK_DEPTH_TYPE uxStackSize,
+                                 UBaseType_t uxPriority );
+/*-----------------------------------------------------------*/
 
 /**
  * @brief Global entry time into the application to use as a reference timestamp
@@ -386,22 +417,34 @@ static NetworkContext_t xNetworkContext;
  */
 static uint32_t ulGlobalEntryTimeMs;
 
+/**
+ * @brief The context of the agent that manages the demo's connection, through
+ * which the demo tasks share the connection.
+ */
 MQTTAgentContext_t xGlobalMqttAgentContext;
 
-static uint8_t xNetworkBuffer[ MQTT_AGENT_NETWORK_BUFFER_SIZE ];
+/**
+ * @brief The demo's connection to the MQTT broker.
+ *
+ * @note No thread safety is required for the subscription list, since the
+ * updates to its elements are done only from one task at a time.  The
+ * subscription manager expects the list to be initialized to 0, which it is as
+ * the instance is statically allocated.
+ */
+static MQTTAgentInstance_t xDemoAgentInstance =
+{
+    .pxAgentContext     = &xGlobalMqttAgentContext,
+    .pcClientIdentifier = democonfigCLIENT_IDENTIFIER
+};
 
-static MQTTAgentMessageContext_t xCommandQueue;
+#if ( democonfigUSE_POSIX_SOCKETS == 0 ) && ( democonfigUSE_BROKER_SIMULATOR == 0 )
 
 /**
- * @brief The global array of subscription elements.
- *
- * @note No thread safety is required to this array, since the updates the array
- * elements are done only from one task at a time. The subscription manager
- * implementation expects that the array of the subscription elements used for
- * storing subscriptions to be initialized to 0. As this is a global array, it
- * will be initialized to 0 by default.
+ * @brief The connections whose socket is connected, linked through their
+ * pxNext member.  Only accessed in critical sections.
  */
-SubscriptionElement_t xGlobalSubscriptionList[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];
+    static MQTTAgentInstance_t * pxConnectedInstances = NULL;
+#endif
 
 /*-----------------------------------------------------------*/
 
@@ -423,13 +466,103 @@ void vStartMQTTAgentDemo( void )
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t prvMQTTInit( void )
+/*
+ * @brief Return the number of commands waiting in the MQTT agent's command
+ * queue.
+ */
+UBaseType_t uxGetMQTTAgentQueueDepth( void )
+{
+    UBaseType_t uxQueueDepth = 0U;
+
+    if( xDemoAgentInstance.xCommandQueue.queue != NULL )
+    {
+        uxQueueDepth = uxQueueMessagesWaiting( xDemoAgentInstance.xCommandQueue.queue );
+    }
+
+    return uxQueueDepth;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * @brief Return the number of commands the MQTT agent has sent to the broker
+ * and is waiting to be acknowledged.
+ *
+ * The array of pending acknowledgments is owned by the MQTT agent task and is
+ * read here without synchronization, so the count may be out of date by the
+ * time it is returned.  This is acceptable for its use as a metric.
+ */
+UBaseType_t uxGetMQTTAgentInFlightCount( void )
+{
+    UBaseType_t uxInFlight = 0U;
+    size_t i;
+
+    for( i = 0; i < MQTT_AGENT_MAX_OUTSTANDING_ACKS; i++ )
+    {
+        if( xDemoAgentInstance.pxAgentContext->pPendingAcks[ i ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            uxInFlight++;
+        }
+    }
+
+    return uxInFlight;
+}
+
+/*-----------------------------------------------------------*/
+
+void vMQTTAgentInstanceInit( MQTTAgentInstance_t * pxInstance,
+                             MQTTAgentContext_t * pxAgentContext,
+                             const char * pcClientIdentifier )
+{
+    configASSERT( ( pxInstance != NULL ) && ( pxAgentContext != NULL ) && ( pcClientIdentifier != NULL ) );
+
+    /* The subscription manager expects the list to be initialized to 0. */
+    memset( pxInstance, 0x00, sizeof( MQTTAgentInstance_t ) );
+    pxInstance->pxAgentContext = pxAgentContext;
+    pxInstance->pcClientIdentifier = pcClientIdentifier;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xMQTTAgentInstanceConnect( MQTTAgentInstance_t * pxInstance )
+{
+    BaseType_t xReturn;
+    MQTTStatus_t xMQTTStatus;
+
+    /* Connect a TCP socket to the broker. */
+    xReturn = prvSocketConnect( pxInstance );
+
+    if( xReturn == pdPASS )
+    {
+        /* Initialize the MQTT context with the buffer and transport interface,
+         * then form an MQTT connection without a persistent session. */
+        xMQTTStatus = prvMQTTInit( pxInstance );
+
+        if( xMQTTStatus == MQTTSuccess )
+        {
+            xMQTTStatus = prvMQTTConnect( pxInstance, true );
+        }
+
+        if( xMQTTStatus != MQTTSuccess )
+        {
+            LogError( ( "Failed to connect %s to the broker. xMQTTStatus=%s.",
+                        pxInstance->pcClientIdentifier,
+                        MQTT_Status_strerror( xMQTTStatus ) ) );
+            ( void ) prvSocketDisconnect( pxInstance );
+            xReturn = pdFAIL;
+        }
+    }
+
+    return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t prvMQTTInit( MQTTAgentInstance_t * pxInstance )
 {
     TransportInterface_t xTransport;
     MQTTStatus_t xReturn;
-    MQTTFixedBuffer_t xFixedBuffer = { .pBuffer = xNetworkBuffer, .size = MQTT_AGENT_NETWORK_BUFFER_SIZE };
-    static uint8_t staticQueueStorageArea[ MQTT_AGENT_COMMAND_QUEUE_LENGTH * sizeof( MQTTAgentCommand_t * ) ];
-    static StaticQueue_t staticQueueStructure;
+    MQTTFixedBuffer_t xFixedBuffer = { .pBuffer = pxInstance->ucNetworkBuffer, .size = MQTT_AGENT_NETWORK_BUFFER_SIZE };
     MQTTAgentMessageInterface_t messageInterface =
     {
         .pMsgCtx        = NULL,
@@ -440,19 +573,22 @@ static MQTTStatus_t prvMQTTInit( void )
     };
 
     LogDebug( ( "Creating command queue." ) );
-    xCommandQueue.queue = xQueueCreateStatic( MQTT_AGENT_COMMAND_QUEUE_LENGTH,
-                                              sizeof( MQTTAgentCommand_t * ),
-                                              staticQueueStorageArea,
-                                              &staticQueueStructure );
-    configASSERT( xCommandQueue.queue );
-    messageInterface.pMsgCtx = &xCommandQueue;
-
-    /* Initialize the task pool. */
+    pxInstance->xCommandQueue.queue = xQueueCreateStatic( MQTT_AGENT_COMMAND_QUEUE_LENGTH,
+                                                          sizeof( MQTTAgentCommand_t * ),
+                                                          pxInstance->ucCommandQueueStorage,
+                                                          &( pxInstance->xCommandQueueStructure ) );
+    configASSERT( pxInstance->xCommandQueue.queue );
+    messageInterface.pMsgCtx = &( pxInstance->xCommandQueue );
+
+    /* Initialize the task pool, which is shared by all the connections. */
     Agent_InitializePool();
 
     /* Fill in Transport Interface send and receive function pointers. */
-    xTransport.pNetworkContext = &xNetworkContext;
-    #if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
+    xTransport.pNetworkContext = &( pxInstance->xNetworkContext );
+    #if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+        xTransport.send = lBrokerSimulatorSend;
+        xTransport.recv = lBrokerSimulatorRecv;
+    #elif defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
         xTransport.send = TLS_FreeRTOS_send;
         xTransport.recv = TLS_FreeRTOS_recv;
     #else
@@ -461,21 +597,22 @@ static MQTTStatus_t prvMQTTInit( void )
     #endif
 
     /* Initialize MQTT library. */
-    xReturn = MQTTAgent_Init( &xGlobalMqttAgentContext,
+    xReturn = MQTTAgent_Init( pxInstance->pxAgentContext,
                               &messageInterface,
                               &xFixedBuffer,
                               &xTransport,
                               prvGetTimeMs,
                               prvIncomingPublishCallback,
                               /* Context to pass into the callback. Passing the pointer to subscription array. */
-                              xGlobalSubscriptionList );
+                              pxInstance->xSubscriptionList );
 
     return xReturn;
 }
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t prvMQTTConnect( bool xCleanSession )
+static MQTTStatus_t prvMQTTConnect( MQTTAgentInstance_t * pxInstance,
+                                    bool xCleanSession )
 {
     MQTTStatus_t xResult;
     MQTTConnectInfo_t xConnectInfo;
@@ -493,8 +630,8 @@ static MQTTStatus_t prvMQTTConnect( bool xCleanSession )
     /* The client identifier is used to uniquely identify this MQTT client to
      * the MQTT broker. In a production device the identifier can be something
      * unique, such as a device serial number. */
-    xConnectInfo.pClientIdentifier = democonfigCLIENT_IDENTIFIER;
-    xConnectInfo.clientIdentifierLength = ( uint16_t ) strlen( democonfigCLIENT_IDENTIFIER );
+    xConnectInfo.pClientIdentifier = pxInstance->pcClientIdentifier;
+    xConnectInfo.clientIdentifierLength = ( uint16_t ) strlen( pxInstance->pcClientIdentifier );
 
     /* Set MQTT keep-alive period. It is the responsibility of the application
      * to ensure that the interval between Control Packets being sent does not
@@ -528,7 +665,7 @@ static MQTTStatus_t prvMQTTConnect( bool xCleanSession )
 
     /* Send MQTT CONNECT packet to broker. MQTT's Last Will and Testament feature
      * is not used in this demo, so it is passed as NULL. */
-    xResult = MQTT_Connect( &( xGlobalMqttAgentContext.mqttContext ),
+    xResult = MQTT_Connect( &( pxInstance->pxAgentContext->mqttContext ),
                             &xConnectInfo,
                             NULL,
                             mqttexampleCONNACK_RECV_TIMEOUT_MS,
@@ -539,12 +676,12 @@ static MQTTStatus_t prvMQTTConnect( bool xCleanSession )
     /* Resume a session if desired. */
     if( ( xResult == MQTTSuccess ) && ( xCleanSession == false ) )
     {
-        xResult = MQTTAgent_ResumeSession( &xGlobalMqttAgentContext, xSessionPresent );
+        xResult = MQTTAgent_ResumeSession( pxInstance->pxAgentContext, xSessionPresent );
 
         /* Resubscribe to all the subscribed topics. */
         if( ( xResult == MQTTSuccess ) && ( xSessionPresent == false ) )
         {
-            xResult = prvHandleResubscribe();
+            xResult = prvHandleResubscribe( pxInstance );
         }
     }
 
@@ -553,16 +690,18 @@ static MQTTStatus_t prvMQTTConnect( bool xCleanSession )
 
 /*-----------------------------------------------------------*/
 
-static MQTTStatus_t prvHandleResubscribe( void )
+static MQTTStatus_t prvHandleResubscribe( MQTTAgentInstance_t * pxInstance )
 {
     MQTTStatus_t xResult = MQTTBadParameter;
     uint32_t ulIndex = 0U;
     uint16_t usNumSubscriptions = 0U;
 
-    /* These variables need to stay in scope until command completes. */
-    static MQTTAgentSubscribeArgs_t xSubArgs = { 0 };
-    static MQTTSubscribeInfo_t xSubInfo[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ] = { 0 };
-    static MQTTAgentCommandInfo_t xCommandParams = { 0 };
+    /* These variables need to stay in scope until command completes, so are
+     * held in the instance. */
+    MQTTAgentSubscribeArgs_t * pxSubArgs = &( pxInstance->xResubscribeArgs );
+    MQTTSubscribeInfo_t * pxSubInfo = pxInstance->xResubscribeInfo;
+    MQTTAgentCommandInfo_t * pxCommandParams = &( pxInstance->xResubscribeCommandInfo );
+    SubscriptionElement_t * pxSubscriptionList = pxInstance->xSubscriptionList;
 
     /* Loop through each subscription in the subscription list and add a subscribe
      * command to the command queue. */
@@ -570,17 +709,17 @@ static MQTTStatus_t prvHandleResubscribe( void )
     {
         /* Check if there is a subscription in the subscription list. This demo
          * doesn't check for duplicate subscriptions. */
-        if( xGlobalSubscriptionList[ ulIndex ].usFilterStringLength != 0 )
+        if( pxSubscriptionList[ ulIndex ].usFilterStringLength != 0 )
         {
-            xSubInfo[ usNumSubscriptions ].pTopicFilter = xGlobalSubscriptionList[ ulIndex ].pcSubscriptionFilterString;
-            xSubInfo[ usNumSubscriptions ].topicFilterLength = xGlobalSubscriptionList[ ulIndex ].usFilterStringLength;
+            pxSubInfo[ usNumSubscriptions ].pTopicFilter = pxSubscriptionList[ ulIndex ].pcSubscriptionFilterString;
+            pxSubInfo[ usNumSubscriptions ].topicFilterLength = pxSubscriptionList[ ulIndex ].usFilterStringLength;
 
             /* QoS1 is used for all the subscriptions in this demo. */
-            xSubInfo[ usNumSubscriptions ].qos = MQTTQoS1;
+            pxSubInfo[ usNumSubscriptions ].qos = MQTTQoS1;
 
             LogInfo( ( "Resubscribe to the topic %.*s will be attempted.",
-                       xSubInfo[ usNumSubscriptions ].topicFilterLength,
-                       xSubInfo[ usNumSubscriptions ].pTopicFilter ) );
+                       pxSubInfo[ usNumSubscriptions ].topicFilterLength,
+                       pxSubInfo[ usNumSubscriptions ].pTopicFilter ) );
 
             usNumSubscriptions++;
         }
@@ -588,17 +727,17 @@ static MQTTStatus_t prvHandleResubscribe( void )
 
     if( usNumSubscriptions > 0U )
     {
-        xSubArgs.pSubscribeInfo = xSubInfo;
-        xSubArgs.numSubscriptions = usNumSubscriptions;
+        pxSubArgs->pSubscribeInfo = pxSubInfo;
+        pxSubArgs->numSubscriptions = usNumSubscriptions;
 
         /* The block time can be 0 as the command loop is not running at this point. */
-        xCommandParams.blockTimeMs = 0U;
-        xCommandParams.cmdCompleteCallback = prvSubscriptionCommandCallback;
-        xCommandParams.pCmdCompleteCallbackContext = ( void * ) &xSubArgs;
+        pxCommandParams->blockTimeMs = 0U;
+        pxCommandParams->cmdCompleteCallback = prvSubscriptionCommandCallback;
+        pxCommandParams->pCmdCompleteCallbackContext = ( void * ) pxInstance;
 
         /* Enqueue subscribe to the command queue. These commands will be processed only
          * when command loop starts. */
-        xResult = MQTTAgent_Subscribe( &xGlobalMqttAgentContext, &xSubArgs, &xCommandParams );
+        xResult = MQTTAgent_Subscribe( pxInstance->pxAgentContext, pxSubArgs, pxCommandParams );
     }
     else
     {
@@ -621,7 +760,8 @@ static void prvSubscriptionCommandCallback( MQTTAgentCommandContext_t * pxComman
                                             MQTTAgentReturnInfo_t * pxReturnInfo )
 {
     size_t lIndex = 0;
-    MQTTAgentSubscribeArgs_t * pxSubscribeArgs = ( MQTTAgentSubscribeArgs_t * ) pxCommandContext;
+    MQTTAgentInstance_t * pxInstance = ( MQTTAgentInstance_t * ) pxCommandContext;
+    MQTTAgentSubscribeArgs_t * pxSubscribeArgs = &( pxInstance->xResubscribeArgs );
 
     /* If the return code is success, no further action is required as all the topic filters
      * are already part of the subscription list. */
@@ -637,7 +777,7 @@ static void prvSubscriptionCommandCallback( MQTTAgentCommandContext_t * pxComman
                             pxSubscribeArgs->pSubscribeInfo[ lIndex ].topicFilterLength,
                             pxSubscribeArgs->pSubscribeInfo[ lIndex ].pTopicFilter ) );
                 /* Remove subscription callback for unsubscribe. */
-                removeSubscription( xGlobalSubscriptionList,
+                removeSubscription( pxInstance->xSubscriptionList,
                                     pxSubscribeArgs->pSubscribeInfo[ lIndex ].pTopicFilter,
                                     pxSubscribeArgs->pSubscribeInfo[ lIndex ].topicFilterLength );
             }
@@ -651,15 +791,18 @@ static void prvSubscriptionCommandCallback( MQTTAgentCommandContext_t * pxComman
 
 /*-----------------------------------------------------------*/
 
-static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext )
+static BaseType_t prvSocketConnect( MQTTAgentInstance_t * pxInstance )
 {
+    NetworkContext_t * pxNetworkContext = &( pxInstance->xNetworkContext );
     BaseType_t xConnected = pdFAIL;
     BackoffAlgorithmStatus_t xBackoffAlgStatus = BackoffAlgorithmSuccess;
     BackoffAlgorithmContext_t xReconnectParams = { 0 };
     uint16_t usNextRetryBackOff = 0U;
     const TickType_t xTransportTimeout = 0UL;
 
-    #if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
+    #if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+        eBrokerSimulatorStatus xNetworkStatus = eBrokerSimulatorInit();
+    #elif defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
         TlsTransportStatus_t xNetworkStatus = TLS_TRANSPORT_CONNECT_FAILURE;
         NetworkCredentials_t xNetworkCredentials = { 0 };
 
@@ -688,9 +831,9 @@ static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext )
             xNetworkCredentials.privateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
         #endif
         xNetworkCredentials.disableSni = democonfigDISABLE_SNI;
-    #else /* if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 ) */
+    #else /* if ( democonfigUSE_BROKER_SIMULATOR == 1 ) */
         PlaintextTransportStatus_t xNetworkStatus = PLAINTEXT_TRANSPORT_CONNECT_FAILURE;
-    #endif /* if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 ) */
+    #endif /* if ( democonfigUSE_BROKER_SIMULATOR == 1 ) */
 
     /* We will use a retry mechanism with an exponential backoff mechanism and
      * jitter.  That is done to prevent a fleet of IoT devices all trying to
@@ -710,7 +853,17 @@ static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext )
         /* Establish a TCP connection with the MQTT broker. This example connects to
          * the MQTT broker as specified in democonfigMQTT_BROKER_ENDPOINT and
          * democonfigMQTT_BROKER_PORT at the top of this file. */
-        #if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
+        #if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+            LogInfo( ( "Connecting to the broker simulator." ) );
+
+            if( xNetworkStatus == eBrokerSimulatorSuccess )
+            {
+                xNetworkStatus = eBrokerSimulatorConnect( pxNetworkContext,
+                                                          mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS );
+            }
+
+            xConnected = ( xNetworkStatus == eBrokerSimulatorSuccess ) ? pdPASS : pdFAIL;
+        #elif defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
             LogInfo( ( "Creating a TLS connection to %s:%d.",
                        democonfigMQTT_BROKER_ENDPOINT,
                        democonfigMQTT_BROKER_PORT ) );
@@ -721,7 +874,7 @@ static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext )
                                                    mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS,
                                                    mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS );
             xConnected = ( xNetworkStatus == TLS_TRANSPORT_SUCCESS ) ? pdPASS : pdFAIL;
-        #else /* if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 ) */
+        #else /* if ( democonfigUSE_BROKER_SIMULATOR == 1 ) */
             LogInfo( ( "Creating a TCP connection to %s:%d.",
                        democonfigMQTT_BROKER_ENDPOINT,
                        democonfigMQTT_BROKER_PORT ) );
@@ -731,7 +884,7 @@ static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext )
                                                          mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS,
                                                          mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS );
             xConnected = ( xNetworkStatus == PLAINTEXT_TRANSPORT_SUCCESS ) ? pdPASS : pdFAIL;
-        #endif /* if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 ) */
+        #endif /* if ( democonfigUSE_BROKER_SIMULATOR == 1 ) */
 
         if( !xConnected )
         {
@@ -743,7 +896,7 @@ static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext )
                 LogWarn( ( "Connection to the broker failed. "
                            "Retrying connection in %hu ms.",
                            usNextRetryBackOff ) );
-                vTaskDelay( pdMS_TO_TICKS( usNextRetryBackOff ) );
+                vClockDelayMs( usNextRetryBackOff );
             }
         }
 
@@ -756,17 +909,39 @@ static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext )
     /* Set the socket wakeup callback and ensure the read block time. */
     if( xConnected )
     {
-        ( void ) FreeRTOS_setsockopt( pxNetworkContext->tcpSocket,
-                                      0, /* Level - Unused. */
-                                      FREERTOS_SO_WAKEUP_CALLBACK,
-                                      ( void * ) prvMQTTClientSocketWakeupCallback,
-                                      sizeof( &( prvMQTTClientSocketWakeupCallback ) ) );
-
-        ( void ) FreeRTOS_setsockopt( pxNetworkContext->tcpSocket,
-                                      0,
-                                      FREERTOS_SO_RCVTIMEO,
-                                      &xTransportTimeout,
-                                      sizeof( TickType_t ) );
+        #if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+            {
+                vBrokerSimulatorSetWakeupCallback( pxNetworkContext->pxConnection,
+                                                   prvMQTTClientSocketWakeupCallback,
+                                                   pxInstance );
+
+                pxNetworkContext->xReceiveTimeout = xTransportTimeout;
+            }
+        #elif ( democonfigUSE_POSIX_SOCKETS == 1 )
+            {
+                ( void ) Sockets_SetWakeupCallback( pxNetworkContext->tcpSocket,
+                                                    prvMQTTClientSocketWakeupCallback,
+                                                    pxInstance );
+
+                pxNetworkContext->receiveTimeout = xTransportTimeout;
+            }
+        #else
+            {
+                prvAddConnectedInstance( pxInstance );
+
+                ( void ) FreeRTOS_setsockopt( pxNetworkContext->tcpSocket,
+                                              0, /* Level - Unused. */
+                                              FREERTOS_SO_WAKEUP_CALLBACK,
+                                              ( void * ) prvFreeRTOSSocketWakeupCallback,
+                                              sizeof( &( prvFreeRTOSSocketWakeupCallback ) ) );
+
+                ( void ) FreeRTOS_setsockopt( pxNetworkContext->tcpSocket,
+                                              0,
+                                              FREERTOS_SO_RCVTIMEO,
+                                              &xTransportTimeout,
+                                              sizeof( TickType_t ) );
+            }
+        #endif /* if ( democonfigUSE_BROKER_SIMULATOR == 1 ) */
     }
 
     return xConnected;
@@ -774,18 +949,37 @@ static BaseType_t prvSocketConnect( NetworkContext_t * pxNetworkContext )
 
 /*-----------------------------------------------------------*/
 
-static BaseType_t prvSocketDisconnect( NetworkContext_t * pxNetworkContext )
+static BaseType_t prvSocketDisconnect( MQTTAgentInstance_t * pxInstance )
 {
+    NetworkContext_t * pxNetworkContext = &( pxInstance->xNetworkContext );
     BaseType_t xDisconnected = pdFAIL;
 
     /* Set the wakeup callback to NULL since the socket will disconnect. */
-    ( void ) FreeRTOS_setsockopt( pxNetworkContext->tcpSocket,
-                                  0, /* Level - Unused. */
-                                  FREERTOS_SO_WAKEUP_CALLBACK,
-                                  ( void * ) NULL,
-                                  sizeof( void * ) );
+    #if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+        {
+            vBrokerSimulatorSetWakeupCallback( pxNetworkContext->pxConnection, NULL, NULL );
+        }
+    #elif ( democonfigUSE_POSIX_SOCKETS == 1 )
+        {
+            ( void ) Sockets_SetWakeupCallback( pxNetworkContext->tcpSocket, NULL, NULL );
+        }
+    #else
+        {
+            ( void ) FreeRTOS_setsockopt( pxNetworkContext->tcpSocket,
+                                          0, /* Level - Unused. */
+                                          FREERTOS_SO_WAKEUP_CALLBACK,
+                                          ( void * ) NULL,
+                                          sizeof( void * ) );
 
-    #if defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
+            prvRemoveConnectedInstance( pxInstance );
+        }
+    #endif
+
+    #if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+        LogInfo( ( "Disconnecting from the broker simulator.\n" ) );
+        eBrokerSimulatorStatus xNetworkStatus = eBrokerSimulatorDisconnect( pxNetworkContext );
+        xDisconnected = ( xNetworkStatus == eBrokerSimulatorSuccess ) ? pdPASS : pdFAIL;
+    #elif defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
         LogInfo( ( "Disconnecting TLS connection.\n" ) );
         TLS_FreeRTOS_Disconnect( pxNetworkContext );
         xDisconnected = pdPASS;
@@ -800,26 +994,110 @@ static BaseType_t prvSocketDisconnect( NetworkContext_t * pxNetworkContext )
 
 /*-----------------------------------------------------------*/
 
-static void prvMQTTClientSocketWakeupCallback( Socket_t pxSocket )
+static void prvMQTTClientSocketWakeupCallback( Socket_t pxSocket,
+                                               void * pvContext )
 {
+    MQTTAgentInstance_t * pxInstance = ( MQTTAgentInstance_t * ) pvContext;
     MQTTAgentCommandInfo_t xCommandParams = { 0 };
-
-    /* Just to avoid compiler warnings.  The socket is not used but the function
-     * prototype cannot be changed because this is a callback function. */
-    ( void ) pxSocket;
+    int32_t lBytesWaiting;
 
     /* A socket used by the MQTT task may need attention.  Send an event
-     * to the MQTT task to make sure the task is not blocked on xCommandQueue. */
-    if( ( uxQueueMessagesWaiting( xCommandQueue.queue ) == 0U ) && ( FreeRTOS_recvcount( pxSocket ) > 0 ) )
+     * to the MQTT task to make sure the task is not blocked on its command
+     * queue. */
+    #if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+        lBytesWaiting = lBrokerSimulatorRecvCount( pxSocket );
+    #elif ( democonfigUSE_POSIX_SOCKETS == 1 )
+        lBytesWaiting = Sockets_RecvCount( pxSocket );
+    #else
+        lBytesWaiting = ( int32_t ) FreeRTOS_recvcount( pxSocket );
+    #endif
+
+    if( ( uxQueueMessagesWaiting( pxInstance->xCommandQueue.queue ) == 0U ) && ( lBytesWaiting > 0 ) )
     {
-        /* Don't block as this is called from the context of the IP task. */
+        /* Don't block as this is called from the context of the IP task, of
+         * the task that polls the sockets of the host, or of the timer service
+         * task when the broker simulator is used. */
         xCommandParams.blockTimeMs = 0U;
-        MQTTAgent_ProcessLoop( &xGlobalMqttAgentContext, &xCommandParams );
+        MQTTAgent_ProcessLoop( pxInstance->pxAgentContext, &xCommandParams );
     }
 }
 
 /*-----------------------------------------------------------*/
 
+#if ( democonfigUSE_POSIX_SOCKETS == 0 ) && ( democonfigUSE_BROKER_SIMULATOR == 0 )
+
+    static void prvFreeRTOSSocketWakeupCallback( Socket_t pxSocket )
+    {
+        MQTTAgentInstance_t * pxInstance;
+
+        taskENTER_CRITICAL();
+        {
+            for( pxInstance = pxConnectedInstances; pxInstance != NULL; pxInstance = pxInstance->pxNext )
+            {
+                if( pxInstance->xNetworkContext.tcpSocket == pxSocket )
+                {
+                    break;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        if( pxInstance != NULL )
+        {
+            prvMQTTClientSocketWakeupCallback( pxSocket, pxInstance );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvAddConnectedInstance( MQTTAgentInstance_t * pxInstance )
+    {
+        MQTTAgentInstance_t * pxListed;
+
+        taskENTER_CRITICAL();
+        {
+            for( pxListed = pxConnectedInstances; pxListed != NULL; pxListed = pxListed->pxNext )
+            {
+                if( pxListed == pxInstance )
+                {
+                    break;
+                }
+            }
+
+            if( pxListed == NULL )
+            {
+                pxInstance->pxNext = pxConnectedInstances;
+                pxConnectedInstances = pxInstance;
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void prvRemoveConnectedInstance( MQTTAgentInstance_t * pxInstance )
+    {
+        MQTTAgentInstance_t ** ppxLink;
+
+        taskENTER_CRITICAL();
+        {
+            for( ppxLink = &pxConnectedInstances; *ppxLink != NULL; ppxLink = &( ( *ppxLink )->pxNext ) )
+            {
+                if( *ppxLink == pxInstance )
+                {
+                    *ppxLink = pxInstance->pxNext;
+                    pxInstance->pxNext = NULL;
+                    break;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+/*-----------------------------------------------------------*/
+
+#endif /* if ( democonfigUSE_POSIX_SOCKETS == 0 ) && ( democonfigUSE_BROKER_SIMULATOR == 0 ) */
+
 static void prvIncomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
                                         uint16_t packetId,
                                         MQTTPublishInfo_t * pxPublishInfo )
@@ -838,9 +1116,10 @@ static void prvIncomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
     #if ( democonfigCREATE_CODE_SIGNING_OTA_DEMO == 1 )
 
         /*
-         * Check if the incoming publish is for OTA agent.
+         * Check if the incoming publish is for OTA agent, which only uses the
+         * demo's connection.
          */
-        if( xPublishHandled != true )
+        if( ( xPublishHandled != true ) && ( pMqttAgentContext == &xGlobalMqttAgentContext ) )
         {
             xPublishHandled = vOTAProcessMessage( pMqttAgentContext->pIncomingCallbackContext, pxPublishInfo );
         }
@@ -862,13 +1141,11 @@ static void prvIncomingPublishCallback( MQTTAgentContext_t * pMqttAgentContext,
 
 /*-----------------------------------------------------------*/
 
-static void prvMQTTAgentTask( void * pvParameters )
+void vMQTTAgentInstanceRun( MQTTAgentInstance_t * pxInstance )
 {
     BaseType_t xNetworkResult = pdFAIL;
     MQTTStatus_t xMQTTStatus = MQTTSuccess, xConnectStatus = MQTTSuccess;
-    MQTTContext_t * pMqttContext = &( xGlobalMqttAgentContext.mqttContext );
-
-    ( void ) pvParameters;
+    MQTTContext_t * pMqttContext = &( pxInstance->pxAgentContext->mqttContext );
 
     do
     {
@@ -877,37 +1154,40 @@ static void prvMQTTAgentTask( void * pvParameters )
          * which could be a disconnect.  If an error occurs the MQTT context on
          * which the error happened is returned so there can be an attempt to
          * clean up and reconnect however the application writer prefers. */
-        xMQTTStatus = MQTTAgent_CommandLoop( &xGlobalMqttAgentContext );
+        xMQTTStatus = MQTTAgent_CommandLoop( pxInstance->pxAgentContext );
 
         /* Success is returned for disconnect or termination. The socket should
          * be disconnected. */
         if( xMQTTStatus == MQTTSuccess )
         {
             /* MQTT Disconnect. Disconnect the socket. */
-            xNetworkResult = prvSocketDisconnect( &xNetworkContext );
+            xNetworkResult = prvSocketDisconnect( pxInstance );
         }
         /* Error. */
         else
         {
             #if ( democonfigCREATE_CODE_SIGNING_OTA_DEMO == 1 )
                 {
-                    vSuspendOTACodeSigningDemo();
+                    if( pxInstance == &xDemoAgentInstance )
+                    {
+                        vSuspendOTACodeSigningDemo();
+                    }
                 }
             #endif
 
             /* Reconnect TCP. */
-            xNetworkResult = prvSocketDisconnect( &xNetworkContext );
+            xNetworkResult = prvSocketDisconnect( pxInstance );
             configASSERT( xNetworkResult == pdPASS );
-            xNetworkResult = prvSocketConnect( &xNetworkContext );
+            xNetworkResult = prvSocketConnect( pxInstance );
             configASSERT( xNetworkResult == pdPASS );
             pMqttContext->connectStatus = MQTTNotConnected;
             /* MQTT Connect with a persistent session. */
-            xConnectStatus = prvMQTTConnect( false );
+            xConnectStatus = prvMQTTConnect( pxInstance, false );
             configASSERT( xConnectStatus == MQTTSuccess );
 
             #if ( democonfigCREATE_CODE_SIGNING_OTA_DEMO == 1 )
                 {
-                    if( xMQTTStatus == MQTTSuccess )
+                    if( ( xMQTTStatus == MQTTSuccess ) && ( pxInstance == &xDemoAgentInstance ) )
                     {
                         vResumeOTACodeSigningDemo();
                     }
@@ -919,27 +1199,12 @@ static void prvMQTTAgentTask( void * pvParameters )
 
 /*-----------------------------------------------------------*/
 
-static void prvConnectToMQTTBroker( void )
-{
-    BaseType_t xNetworkStatus = pdFAIL;
-    MQTTStatus_t xMQTTStatus;
-
-    /* Connect a TCP socket to the broker. */
-    xNetworkStatus = prvSocketConnect( &xNetworkContext );
-    configASSERT( xNetworkStatus == pdPASS );
-
-    /* Initialize the MQTT context with the buffer and transport interface. */
-    xMQTTStatus = prvMQTTInit();
-    configASSERT( xMQTTStatus == MQTTSuccess );
-
-    /* Form an MQTT connection without a persistent session. */
-    xMQTTStatus = prvMQTTConnect( true );
-    configASSERT( xMQTTStatus == MQTTSuccess );
-}
 /*-----------------------------------------------------------*/
 
 static void prvConnectAndCreateDemoTasks( void * pvParameters )
 {
+    BaseType_t xConnected;
+
     ( void ) pvParameters;
 
     /* Miscellaneous initialization. */
@@ -947,7 +1212,8 @@ static void prvConnectAndCreateDemoTasks( void * pvParameters )
 
     /* Create the TCP connection to the broker, then the MQTT connection to the
      * same. */
-    prvConnectToMQTTBroker();
+    xConnected = xMQTTAgentInstanceConnect( &xDemoAgentInstance );
+    configASSERT( xConnected == pdPASS );
 
     /* Selectively create demo tasks as per the compile time constant settings. */
     #if ( democonfigCREATE_LARGE_MESSAGE_SUB_PUB_TASK == 1 )
@@ -986,13 +1252,27 @@ static void prvConnectAndCreateDemoTasks( void * pvParameters )
         }
     #endif
 
+    #if ( democonfigCREATE_LOG_CONTROL_TASK == 1 )
+        {
+            vStartLogControlTask( democonfigLOG_CONTROL_TASK_STACK_SIZE,
+                                  tskIDLE_PRIORITY );
+        }
+    #endif
+
+    #if ( democonfigCREATE_CLOCK_SKIP_TASK == 1 )
+        {
+            vStartClockSkipTask( democonfigCLOCK_SKIP_TASK_STACK_SIZE,
+                                 tskIDLE_PRIORITY );
+        }
+    #endif
+
     /* This task has nothing left to do, so rather than create the MQTT
      * agent as a separate thread, it simply calls the function that implements
      * the agent - in effect turning itself into the agent. */
-    prvMQTTAgentTask( NULL );
+    vMQTTAgentInstanceRun( &xDemoAgentInstance );
 
     /* Should not get here.  Force an assert if the task returns from
-     * prvMQTTAgentTask(). */
+     * vMQTTAgentInstanceRun(). */
     configASSERT( pvParameters == ( void * ) ~1 );
 }
 
@@ -1000,14 +1280,10 @@ static void prvConnectAndCreateDemoTasks( void * pvParameters )
 
 static uint32_t prvGetTimeMs( void )
 {
-    TickType_t xTickCount = 0;
     uint32_t ulTimeMs = 0UL;
 
-    /* Get the current tick count. */
-    xTickCount = xTaskGetTickCount();
-
-    /* Convert the ticks to milliseconds. */
-    ulTimeMs = ( uint32_t ) xTickCount * mqttexampleMILLISECONDS_PER_TICK;
+    /* Get the current time of the clock. */
+    ulTimeMs = ulClockGetTimeMs();
 
     /* Reduce ulGlobalEntryTimeMs from obtained time so as to always return the
      * elapsed time in the application. */
@@ -0,0 +1,143 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file mqtt-agent-task.h
+ *
+ * @brief An MQTT connection managed by the MQTT agent.
+ *
+ * The demo runs one connection, whose agent context is xGlobalMqttAgentContext
+ * and through which the demo tasks share the connection.  A build can run more
+ * connections, each with its own agent context, client identifier and task:
+ * the task initializes an instance with vMQTTAgentInstanceInit(), connects it
+ * with xMQTTAgentInstanceConnect() and then becomes its agent by calling
+ * vMQTTAgentInstanceRun().  The connections share the pool of agent commands,
+ * see freertos_command_pool.h.
+ */
+
+#ifndef MQTT_AGENT_TASK_H_
+#define MQTT_AGENT_TASK_H_
+
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "queue.h"
+
+/* Demo Specific configs. */
+#include "demo_config.h"
+
+/* MQTT agent include. */
+#include "core_mqtt_agent.h"
+
+/* MQTT Agent ports. */
+#include "freertos_agent_message.h"
+
+/* Subscription manager header include. */
+#include "subscription_manager.h"
+
+/* Transport interface include. */
+#if ( democonfigUSE_BROKER_SIMULATOR == 1 )
+    #include "mqtt_broker_simulator.h"
+#elif defined( democonfigUSE_TLS ) && ( democonfigUSE_TLS == 1 )
+    #include "using_mbedtls.h"
+#else
+    #include "using_plaintext.h"
+#endif
+
+/**
+ * @brief Dimensions the buffer used to serialize and deserialize MQTT packets.
+ * @note Specified in bytes.  Must be large enough to hold the maximum
+ * anticipated MQTT payload.
+ */
+#ifndef MQTT_AGENT_NETWORK_BUFFER_SIZE
+    #define MQTT_AGENT_NETWORK_BUFFER_SIZE    ( 5000 )
+#endif
+
+/**
+ * @brief The state of one MQTT connection managed by the MQTT agent.  The
+ * members are private to mqtt-agent-task.c.
+ */
+typedef struct MQTTAgentInstance
+{
+    MQTTAgentContext_t * pxAgentContext;     /**< The context of the agent, used by the tasks that share the connection. */
+    const char * pcClientIdentifier;         /**< The client identifier sent in the CONNECT packet. */
+    NetworkContext_t xNetworkContext;        /**< The network context used by the MQTT library transport interface. */
+    MQTTAgentMessageContext_t xCommandQueue; /**< The queue of commands sent to the agent. */
+    StaticQueue_t xCommandQueueStructure;
+    uint8_t ucCommandQueueStorage[ MQTT_AGENT_COMMAND_QUEUE_LENGTH * sizeof( MQTTAgentCommand_t * ) ];
+    uint8_t ucNetworkBuffer[ MQTT_AGENT_NETWORK_BUFFER_SIZE ];                        /**< Buffer used to serialize and deserialize MQTT packets. */
+    SubscriptionElement_t xSubscriptionList[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ]; /**< The subscriptions, zero initialized. */
+
+    /* The resubscribe command sent after a reconnection, which must stay in
+     * scope until the command completes. */
+    MQTTAgentSubscribeArgs_t xResubscribeArgs;
+    MQTTSubscribeInfo_t xResubscribeInfo[ SUBSCRIPTION_MANAGER_MAX_SUBSCRIPTIONS ];
+    MQTTAgentCommandInfo_t xResubscribeCommandInfo;
+
+    /* The wakeup callback of FreeRTOS+TCP is not passed a context, so it
+     * finds the instance of its socket in a list of the connected instances. */
+    #if ( democonfigUSE_POSIX_SOCKETS == 0 ) && ( democonfigUSE_BROKER_SIMULATOR == 0 )
+        struct MQTTAgentInstance * pxNext;
+    #endif
+} MQTTAgentInstance_t;
+
+/**
+ * @brief Prepare an instance to connect.  Must be called before the other
+ * functions are called on the instance, and not while it is connected.
+ *
+ * @param[in] pxInstance The instance, which must stay in scope while it is
+ * connected.
+ * @param[in] pxAgentContext The context of the agent, through which the tasks
+ * that share the connection send commands to the agent.
+ * @param[in] pcClientIdentifier The client identifier sent in the CONNECT
+ * packet.  Must stay in scope while the instance is connected.
+ */
+void vMQTTAgentInstanceInit( MQTTAgentInstance_t * pxInstance,
+                             MQTTAgentContext_t * pxAgentContext,
+                             const char * pcClientIdentifier );
+
+/**
+ * @brief Connect a socket to the MQTT broker, retrying with backoff, then
+ * create an MQTT connection without a persistent session over it.
+ *
+ * @param[in] pxInstance The instance to connect.
+ *
+ * @return pdPASS if the instance is connected, else pdFAIL.
+ */
+BaseType_t xMQTTAgentInstanceConnect( MQTTAgentInstance_t * pxInstance );
+
+/**
+ * @brief Run the agent of a connected instance in the calling task.  Calls
+ * MQTTAgent_CommandLoop() until MQTTAgent_Disconnect() or MQTTAgent_Terminate()
+ * is called, reconnecting with a persistent session if an error occurs.
+ *
+ * @param[in] pxInstance The instance, connected by xMQTTAgentInstanceConnect().
+ */
+void vMQTTAgentInstanceRun( MQTTAgentInstance_t * pxInstance );
+
+#endif /* ifndef MQTT_AGENT_TASK_H_ */
@@ -0,0 +1,889 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file ota_stream_simulator.c
+ *
+ * @brief In-process stand-in for the AWS IoT Jobs and Streams services.
+ *
+ * Every response produced by the simulator is written into one of a fixed
+ * number of pending message slots, stamped with the time at which it should be
+ * delivered, and handed to the incoming publish callback by the simulator task
+ * once that time has passed.  Loss, reordering and duplication are applied to
+ * stream data blocks only so a lost job document does not stall the
+ * benchmark for the full OTA request timeout.  Latency applies to every
+ * message.
+ */
+
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleOta
+
+/* Standard includes. */
+#include <string.h>
+#include <stdio.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Demo config. */
+#include "demo_config.h"
+#include "ota_config.h"
+#include "ota_simulator_config.h"
+
+/* JSON library include. */
+#include "core_json.h"
+
+/* CBOR library include. */
+#include "cbor.h"
+
+/* Object pool include. */
+#include "object_pool.h"
+
+/* Interface include. */
+#include "ota_stream_simulator.h"
+
+/**
+ * @brief Prefix shared by every topic used by the OTA library.
+ */
+#define otasimTOPIC_PREFIX                "$aws/things/"
+
+/**
+ * @brief Length of #otasimTOPIC_PREFIX.
+ */
+#define otasimTOPIC_PREFIX_LENGTH         ( sizeof( otasimTOPIC_PREFIX ) - 1U )
+
+/**
+ * @brief Suffixes, following the thing name, of the topics the OTA library
+ * publishes to.
+ */
+#define otasimJOB_GET_NEXT_SUFFIX         "/jobs/$next/get"
+#define otasimJOB_UPDATE_SUFFIX           "/update"
+#define otasimSTREAM_GET_SUFFIX           "/get/cbor"
+#define otasimSTREAM_DATA_SUFFIX          "/data/cbor"
+#define otasimSTREAMS_SEGMENT             "/streams/"
+
+/**
+ * @brief Identifiers of the simulated job and stream.
+ */
+#define otasimJOB_ID                      "AFR_OTA-simulated-job"
+#define otasimSTREAM_NAME                 "ota-simulator-stream"
+
+/**
+ * @brief The job document returned the first time the OTA agent asks for the
+ * next pending job.  Parameters are the client token, timestamp and file size.
+ */
+#define otasimJOB_DOCUMENT_FORMAT                                                                      \
+    "{\"clientToken\":\"%.*s\",\"timestamp\":%lu,\"execution\":{\"jobId\":\"" otasimJOB_ID "\","       \
+    "\"status\":\"QUEUED\",\"queuedAt\":%lu,\"lastUpdatedAt\":%lu,\"versionNumber\":1,"                \
+    "\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],"                    \
+    "\"streamname\":\"" otasimSTREAM_NAME "\",\"files\":[{\"filepath\":\"" otasimconfigIMAGE_FILE_PATH \
+    "\",\"filesize\":%lu,\"fileid\":0,\"certfile\":\"" otasimconfigCERTIFICATE_FILE_PATH               \
+    "\",\"sig-sha256-ecdsa\":\"" otasimconfigIMAGE_SIGNATURE "\"}]}}}}"
+
+/**
+ * @brief The response returned once the simulated job has been served.
+ */
+#define otasimNO_JOB_DOCUMENT_FORMAT      "{\"clientToken\":\"%.*s\",\"timestamp\":%lu}"
+
+/**
+ * @brief Keys used in the CBOR stream request and response messages.
+ */
+#define otasimCBOR_FILE_ID_KEY            "f"
+#define otasimCBOR_BLOCK_ID_KEY           "i"
+#define otasimCBOR_BLOCK_SIZE_KEY         "l"
+#define otasimCBOR_BLOCK_PAYLOAD_KEY      "p"
+#define otasimCBOR_BLOCK_OFFSET_KEY       "o"
+#define otasimCBOR_BLOCK_BITMAP_KEY       "b"
+#define otasimCBOR_NUMBER_OF_BLOCKS_KEY   "n"
+
+/**
+ * @brief Number of keys in a CBOR stream response.
+ */
+#define otasimCBOR_RESPONSE_KEY_COUNT     ( 4U )
+
+/**
+ * @brief The number of blocks the synthetic image is split into.
+ */
+#define otasimNUM_BLOCKS                  ( ( otasimconfigIMAGE_SIZE + otaconfigFILE_BLOCK_SIZE - 1U ) / otaconfigFILE_BLOCK_SIZE )
+
+/**
+ * @brief Size of the block bitmap sent in a stream request.
+ */
+#define otasimBITMAP_SIZE                 ( ( otasimNUM_BLOCKS + 7U ) / 8U )
+
+/**
+ * @brief Size of the topic and payload buffers of each pending message.  The
+ * payload buffer holds a full data block plus the CBOR framing around it.
+ */
+#define otasimMAX_TOPIC_LENGTH            ( 256U )
+#define otasimMAX_PAYLOAD_LENGTH          ( otaconfigFILE_BLOCK_SIZE + 64U )
+
+/**
+ * @brief A message waiting to be delivered to the device.
+ */
+typedef struct OtaSimulatorMessage
+{
+    uint32_t ulSequence;   /**< Used to deliver messages that are due at the same time in order. */
+    TickType_t xQueuedTime;
+    TickType_t xDelay;
+    uint16_t usTopicLength;
+    uint32_t ulPayloadLength;
+    char cTopic[ otasimMAX_TOPIC_LENGTH ];
+    uint8_t ucPayload[ otasimMAX_PAYLOAD_LENGTH ];
+} OtaSimulatorMessage_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return a random number in the range 0 to ulRange - 1.
+ */
+static uint32_t prvRandom( uint32_t ulRange );
+
+/**
+ * @brief Return pdTRUE with a probability of ulPercent percent.
+ */
+static BaseType_t prvChance( uint32_t ulPercent );
+
+/**
+ * @brief Take a free message slot from xMessagePool.
+ *
+ * @return The slot, or NULL if all slots are in use.
+ */
+static OtaSimulatorMessage_t * prvAllocateMessage( void );
+
+/**
+ * @brief Queue a previously allocated message for delivery after the simulated
+ * latency plus xExtraDelay.
+ */
+static void prvSendMessage( OtaSimulatorMessage_t * pxMessage,
+                            TickType_t xExtraDelay );
+
+/**
+ * @brief Return a message slot to xMessagePool.
+ */
+static void prvFreeMessage( OtaSimulatorMessage_t * pxMessage );
+
+/**
+ * @brief Increment one of the counters in xStats.  Takes the mutex, under
+ * which vOtaSimulatorGetStats() reads the counters.
+ */
+static void prvIncrementStat( uint32_t * pulStat );
+
+/**
+ * @brief Answer a request for the next pending job.
+ *
+ * @param[in] pcTopic The topic the request was published to.
+ * @param[in] usTopicLength Length of pcTopic.
+ * @param[in] pcMessage The JSON request.
+ * @param[in] ulMessageSize Length of pcMessage.
+ *
+ * @return OtaMqttSuccess if the response is queued, OtaMqttPublishFailed otherwise.
+ */
+static OtaMqttStatus_t prvHandleJobRequest( const char * pcTopic,
+                                            uint16_t usTopicLength,
+                                            const char * pcMessage,
+                                            uint32_t ulMessageSize );
+
+/**
+ * @brief Answer a request for stream data blocks.
+ *
+ * @param[in] pcTopic The topic the request was published to.
+ * @param[in] usTopicLength Length of pcTopic.
+ * @param[in] pucMessage The CBOR request.
+ * @param[in] ulMessageSize Length of pucMessage.
+ *
+ * @return OtaMqttSuccess if the request is decoded, OtaMqttPublishFailed otherwise.
+ */
+static OtaMqttStatus_t prvHandleStreamRequest( const char * pcTopic,
+                                               uint16_t usTopicLength,
+                                               const uint8_t * pucMessage,
+                                               uint32_t ulMessageSize );
+
+/**
+ * @brief Encode one block of the synthetic image as a CBOR stream response
+ * and pass it through the simulated channel.
+ */
+static void prvServeBlock( const char * pcTopic,
+                           uint16_t usTopicLength,
+                           int32_t lFileId,
+                           uint32_t ulBlockId );
+
+/**
+ * @brief The task that delivers queued messages once they are due.
+ */
+static void prvOtaSimulatorTask( void * pvParameters );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The pool of message slots.  A slot is taken when a response is
+ * generated and returned once it is delivered or discarded.
+ */
+objectpoolDEFINE( xMessagePool, OtaSimulatorMessage_t, otasimconfigMAX_PENDING_MESSAGES );
+
+/**
+ * @brief The messages waiting for their delivery time, in no particular
+ * order, and the number of them.  Protected by xSimulatorMutex.
+ */
+static OtaSimulatorMessage_t * pxPendingMessages[ otasimconfigMAX_PENDING_MESSAGES ];
+static uint32_t ulPendingCount = 0;
+
+/**
+ * @brief Scratch buffer the contents of a block are generated into before
+ * encoding.  Only used from the context of the OTA agent's publish call.
+ */
+static uint8_t ucBlockBuffer[ otaconfigFILE_BLOCK_SIZE ];
+
+/**
+ * @brief Scratch buffer the bitmap of a stream request is decoded into.
+ */
+static uint8_t ucBitmap[ otasimBITMAP_SIZE ];
+
+/**
+ * @brief Mutex protecting the pending messages and the counters.
+ */
+static SemaphoreHandle_t xSimulatorMutex = NULL;
+
+/**
+ * @brief Handle of the task that delivers simulated messages.
+ */
+static TaskHandle_t xSimulatorTask = NULL;
+
+/**
+ * @brief Callback and context used to deliver messages to the device.
+ */
+static IncomingPubCallback_t pxDeliverCallback = NULL;
+static void * pvDeliverCallbackContext = NULL;
+
+/**
+ * @brief Counters returned by vOtaSimulatorGetStats().
+ */
+static OtaSimulatorStats_t xStats;
+
+/**
+ * @brief Sequence number given to the next queued message.
+ */
+static uint32_t ulNextSequence = 0;
+
+/**
+ * @brief Set once the job document has been sent so subsequent job requests
+ * are told there is no pending job.
+ */
+static BaseType_t xJobServed = pdFALSE;
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvRandom( uint32_t ulRange )
+{
+    extern UBaseType_t uxRand( void );
+    uint32_t ulValue = 0;
+
+    if( ulRange > 0U )
+    {
+        ulValue = ( uint32_t ) uxRand() % ulRange;
+    }
+
+    return ulValue;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvChance( uint32_t ulPercent )
+{
+    return ( prvRandom( 100U ) < ulPercent ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+static OtaSimulatorMessage_t * prvAllocateMessage( void )
+{
+    OtaSimulatorMessage_t * pxMessage;
+
+    pxMessage = pvObjectPoolAcquire( &xMessagePool, 0U );
+
+    if( pxMessage == NULL )
+    {
+        prvIncrementStat( &( xStats.ulOverflows ) );
+        LogWarn( ( "OTA simulator has no free message slots, response discarded." ) );
+    }
+
+    return pxMessage;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSendMessage( OtaSimulatorMessage_t * pxMessage,
+                            TickType_t xExtraDelay )
+{
+    uint32_t ulLatencyMs;
+
+    ulLatencyMs = otasimconfigMIN_LATENCY_MS +
+                  prvRandom( otasimconfigMAX_LATENCY_MS - otasimconfigMIN_LATENCY_MS + 1U );
+
+    ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+    {
+        pxMessage->ulSequence = ulNextSequence++;
+        pxMessage->xQueuedTime = xTaskGetTickCount();
+        pxMessage->xDelay = pdMS_TO_TICKS( ulLatencyMs ) + xExtraDelay;
+
+        /* Every pending message holds a slot of xMessagePool, so there is
+         * always room for it. */
+        pxPendingMessages[ ulPendingCount ] = pxMessage;
+        ulPendingCount++;
+    }
+    ( void ) xSemaphoreGive( xSimulatorMutex );
+
+    xTaskNotifyGive( xSimulatorTask );
+}
+/*-----------------------------------------------------------*/
+
+static void prvFreeMessage( OtaSimulatorMessage_t * pxMessage )
+{
+    if( xObjectPoolRelease( &xMessagePool, pxMessage ) != pdPASS )
+    {
+        LogError( ( "Freed an OTA simulator message slot that is not in use." ) );
+    }
+}
+/*-----------------------------------------------------------*/
+
+static void prvIncrementStat( uint32_t * pulStat )
+{
+    ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+    {
+        ( *pulStat )++;
+    }
+    ( void ) xSemaphoreGive( xSimulatorMutex );
+}
+/*-----------------------------------------------------------*/
+
+static OtaMqttStatus_t prvHandleJobRequest( const char * pcTopic,
+                                            uint16_t usTopicLength,
+                                            const char * pcMessage,
+                                            uint32_t ulMessageSize )
+{
+    OtaMqttStatus_t xStatus = OtaMqttPublishFailed;
+    OtaSimulatorMessage_t * pxMessage;
+    char * pcClientToken = "";
+    size_t xClientTokenLength = 0;
+    unsigned long ulTimestamp;
+    int lLength;
+
+    /* Echo the client token back so the response looks like the one sent by
+     * the Jobs service. */
+    if( JSON_Validate( pcMessage, ulMessageSize ) == JSONSuccess )
+    {
+        if( JSON_Search( ( char * ) pcMessage,
+                         ulMessageSize,
+                         "clientToken",
+                         sizeof( "clientToken" ) - 1U,
+                         &pcClientToken,
+                         &xClientTokenLength ) != JSONSuccess )
+        {
+            pcClientToken = "";
+            xClientTokenLength = 0;
+        }
+    }
+
+    pxMessage = prvAllocateMessage();
+
+    if( pxMessage != NULL )
+    {
+        ulTimestamp = ( unsigned long ) ( xTaskGetTickCount() / configTICK_RATE_HZ );
+
+        pxMessage->usTopicLength = ( uint16_t ) snprintf( pxMessage->cTopic,
+                                                          otasimMAX_TOPIC_LENGTH,
+                                                          "%.*s/accepted",
+                                                          usTopicLength,
+                                                          pcTopic );
+
+        if( xJobServed == pdFALSE )
+        {
+            lLength = snprintf( ( char * ) pxMessage->ucPayload,
+                                otasimMAX_PAYLOAD_LENGTH,
+                                otasimJOB_DOCUMENT_FORMAT,
+                                ( int ) xClientTokenLength,
+                                pcClientToken,
+                                ulTimestamp,
+                                ulTimestamp,
+                                ulTimestamp,
+                                ( unsigned long ) otasimconfigIMAGE_SIZE );
+        }
+        else
+        {
+            lLength = snprintf( ( char * ) pxMessage->ucPayload,
+                                otasimMAX_PAYLOAD_LENGTH,
+                                otasimNO_JOB_DOCUMENT_FORMAT,
+                                ( int ) xClientTokenLength,
+                                pcClientToken,
+                                ulTimestamp );
+        }
+
+        if( ( lLength > 0 ) && ( lLength < ( int ) otasimMAX_PAYLOAD_LENGTH ) &&
+            ( pxMessage->usTopicLength < otasimMAX_TOPIC_LENGTH ) )
+        {
+            LogInfo( ( "OTA simulator sending %s.",
+                       ( xJobServed == pdFALSE ) ? "job document" : "empty job response" ) );
+
+            pxMessage->ulPayloadLength = ( uint32_t ) lLength;
+            xJobServed = pdTRUE;
+            prvSendMessage( pxMessage, 0 );
+            xStatus = OtaMqttSuccess;
+        }
+        else
+        {
+            LogError( ( "OTA simulator job response does not fit in the message buffer." ) );
+            prvFreeMessage( pxMessage );
+        }
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void prvServeBlock( const char * pcTopic,
+                           uint16_t usTopicLength,
+                           int32_t lFileId,
+                           uint32_t ulBlockId )
+{
+    OtaSimulatorMessage_t * pxMessage;
+    OtaSimulatorMessage_t * pxDuplicate;
+    CborEncoder xEncoder, xMapEncoder;
+    CborError xCborResult;
+    uint32_t ulOffset, ulBlockSize, i;
+    TickType_t xExtraDelay = 0;
+    int lLength;
+
+    ulOffset = ulBlockId * otaconfigFILE_BLOCK_SIZE;
+    ulBlockSize = otasimconfigIMAGE_SIZE - ulOffset;
+
+    if( ulBlockSize > otaconfigFILE_BLOCK_SIZE )
+    {
+        ulBlockSize = otaconfigFILE_BLOCK_SIZE;
+    }
+
+    prvIncrementStat( &( xStats.ulBlocksServed ) );
+
+    if( prvChance( otasimconfigLOSS_PERCENT ) == pdTRUE )
+    {
+        LogDebug( ( "OTA simulator dropped block %u.", ( unsigned ) ulBlockId ) );
+        prvIncrementStat( &( xStats.ulBlocksDropped ) );
+    }
+    else
+    {
+        pxMessage = prvAllocateMessage();
+
+        if( pxMessage != NULL )
+        {
+            /* The content of the image is a function of the byte offset so
+             * the downloaded file can be checked if required. */
+            for( i = 0; i < ulBlockSize; i++ )
+            {
+                ucBlockBuffer[ i ] = ( uint8_t ) ( ( ( ulOffset + i ) * 31U ) ^ ( ( ulOffset + i ) >> 8 ) );
+            }
+
+            cbor_encoder_init( &xEncoder, pxMessage->ucPayload, otasimMAX_PAYLOAD_LENGTH, 0 );
+
+            xCborResult = cbor_encoder_create_map( &xEncoder, &xMapEncoder, otasimCBOR_RESPONSE_KEY_COUNT );
+            xCborResult |= cbor_encode_text_stringz( &xMapEncoder, otasimCBOR_FILE_ID_KEY );
+            xCborResult |= cbor_encode_int( &xMapEncoder, lFileId );
+            xCborResult |= cbor_encode_text_stringz( &xMapEncoder, otasimCBOR_BLOCK_ID_KEY );
+            xCborResult |= cbor_encode_int( &xMapEncoder, ( int64_t ) ulBlockId );
+            xCborResult |= cbor_encode_text_stringz( &xMapEncoder, otasimCBOR_BLOCK_SIZE_KEY );
+            xCborResult |= cbor_encode_int( &xMapEncoder, ( int64_t ) ulBlockSize );
+            xCborResult |= cbor_encode_text_stringz( &xMapEncoder, otasimCBOR_BLOCK_PAYLOAD_KEY );
+            xCborResult |= cbor_encode_byte_string( &xMapEncoder, ucBlockBuffer, ulBlockSize );
+            xCborResult |= cbor_encoder_close_container_checked( &xEncoder, &xMapEncoder );
+
+            lLength = snprintf( pxMessage->cTopic,
+                                otasimMAX_TOPIC_LENGTH,
+                                "%.*s" otasimSTREAM_DATA_SUFFIX,
+                                ( int ) ( usTopicLength - ( sizeof( otasimSTREAM_GET_SUFFIX ) - 1U ) ),
+                                pcTopic );
+
+            if( ( xCborResult == CborNoError ) && ( lLength > 0 ) && ( lLength < ( int ) otasimMAX_TOPIC_LENGTH ) )
+            {
+                pxMessage->usTopicLength = ( uint16_t ) lLength;
+                pxMessage->ulPayloadLength = ( uint32_t ) cbor_encoder_get_buffer_size( &xEncoder, pxMessage->ucPayload );
+
+                if( prvChance( otasimconfigDUPLICATE_PERCENT ) == pdTRUE )
+                {
+                    pxDuplicate = prvAllocateMessage();
+
+                    if( pxDuplicate != NULL )
+                    {
+                        pxDuplicate->usTopicLength = pxMessage->usTopicLength;
+                        pxDuplicate->ulPayloadLength = pxMessage->ulPayloadLength;
+                        memcpy( pxDuplicate->cTopic, pxMessage->cTopic, pxMessage->usTopicLength );
+                        memcpy( pxDuplicate->ucPayload, pxMessage->ucPayload, pxMessage->ulPayloadLength );
+                        prvIncrementStat( &( xStats.ulBlocksDuplicated ) );
+                        prvSendMessage( pxDuplicate, 0 );
+                    }
+                }
+
+                if( prvChance( otasimconfigREORDER_PERCENT ) == pdTRUE )
+                {
+                    xExtraDelay = pdMS_TO_TICKS( otasimconfigREORDER_DELAY_MS );
+                    prvIncrementStat( &( xStats.ulBlocksReordered ) );
+                }
+
+                prvSendMessage( pxMessage, xExtraDelay );
+            }
+            else
+            {
+                LogError( ( "OTA simulator failed to encode block %u.", ( unsigned ) ulBlockId ) );
+                prvFreeMessage( pxMessage );
+            }
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+static OtaMqttStatus_t prvHandleStreamRequest( const char * pcTopic,
+                                               uint16_t usTopicLength,
+                                               const uint8_t * pucMessage,
+                                               uint32_t ulMessageSize )
+{
+    OtaMqttStatus_t xStatus = OtaMqttPublishFailed;
+    CborParser xParser;
+    CborValue xMap, xValue;
+    CborError xCborResult;
+    int lFileId = 0, lBlockOffset = 0, lNumBlocks = 0;
+    size_t xBitmapLength = sizeof( ucBitmap );
+    uint32_t ulBit, ulBlockId, ulServed = 0;
+
+    xCborResult = cbor_parser_init( pucMessage, ulMessageSize, 0, &xParser, &xMap );
+
+    if( ( xCborResult == CborNoError ) && ( cbor_value_is_map( &xMap ) == false ) )
+    {
+        xCborResult = CborErrorIllegalType;
+    }
+
+    if( xCborResult == CborNoError )
+    {
+        xCborResult = cbor_value_map_find_value( &xMap, otasimCBOR_FILE_ID_KEY, &xValue );
+        xCborResult |= cbor_value_get_int( &xValue, &lFileId );
+    }
+
+    if( xCborResult == CborNoError )
+    {
+        xCborResult = cbor_value_map_find_value( &xMap, otasimCBOR_BLOCK_OFFSET_KEY, &xValue );
+        xCborResult |= cbor_value_get_int( &xValue, &lBlockOffset );
+    }
+
+    if( xCborResult == CborNoError )
+    {
+        xCborResult = cbor_value_map_find_value( &xMap, otasimCBOR_NUMBER_OF_BLOCKS_KEY, &xValue );
+        xCborResult |= cbor_value_get_int( &xValue, &lNumBlocks );
+    }
+
+    if( xCborResult == CborNoError )
+    {
+        xCborResult = cbor_value_map_find_value( &xMap, otasimCBOR_BLOCK_BITMAP_KEY, &xValue );
+
+        if( ( xCborResult == CborNoError ) && ( cbor_value_is_byte_string( &xValue ) == false ) )
+        {
+            xCborResult = CborErrorIllegalType;
+        }
+
+        if( xCborResult == CborNoError )
+        {
+            xCborResult = cbor_value_copy_byte_string( &xValue, ucBitmap, &xBitmapLength, NULL );
+        }
+    }
+
+    if( ( xCborResult == CborNoError ) && ( lFileId == 0 ) && ( lBlockOffset >= 0 ) && ( lNumBlocks > 0 ) )
+    {
+        prvIncrementStat( &( xStats.ulStreamRequests ) );
+
+        /* Bit n of the bitmap, least significant bit first, is set if block
+         * ( offset + n ) is requested.  Serve the first lNumBlocks of them. */
+        for( ulBit = 0; ( ulBit < ( xBitmapLength * 8U ) ) && ( ulServed < ( uint32_t ) lNumBlocks ); ulBit++ )
+        {
+            ulBlockId = ( uint32_t ) lBlockOffset + ulBit;
+
+            if( ulBlockId >= otasimNUM_BLOCKS )
+            {
+                break;
+            }
+
+            if( ( ucBitmap[ ulBit >> 3 ] & ( 1U << ( ulBit & 7U ) ) ) != 0U )
+            {
+                prvServeBlock( pcTopic, usTopicLength, ( int32_t ) lFileId, ulBlockId );
+                ulServed++;
+            }
+        }
+
+        xStatus = OtaMqttSuccess;
+    }
+    else
+    {
+        LogError( ( "OTA simulator received an invalid stream request, CBOR error %d.", ( int ) xCborResult ) );
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void prvOtaSimulatorTask( void * pvParameters )
+{
+    OtaSimulatorMessage_t * pxNext, * pxMessage;
+    MQTTPublishInfo_t xPublishInfo;
+    TickType_t xNow, xElapsed, xWait, xLate, xNextLate;
+    uint32_t i, ulNextIndex = 0;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        pxNext = NULL;
+        xNextLate = 0;
+        xWait = portMAX_DELAY;
+
+        ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+        {
+            xNow = xTaskGetTickCount();
+
+            /* Pick the message whose delivery time passed longest ago, or
+             * work out how long to sleep until the next one is due. */
+            for( i = 0; i < ulPendingCount; i++ )
+            {
+                pxMessage = pxPendingMessages[ i ];
+                xElapsed = xNow - pxMessage->xQueuedTime;
+
+                if( xElapsed >= pxMessage->xDelay )
+                {
+                    xLate = xElapsed - pxMessage->xDelay;
+
+                    if( ( pxNext == NULL ) ||
+                        ( xLate > xNextLate ) ||
+                        ( ( xLate == xNextLate ) && ( pxMessage->ulSequence < pxNext->ulSequence ) ) )
+                    {
+                        pxNext = pxMessage;
+                        ulNextIndex = i;
+                        xNextLate = xLate;
+                    }
+                }
+                else if( ( pxMessage->xDelay - xElapsed ) < xWait )
+                {
+                    xWait = pxMessage->xDelay - xElapsed;
+                }
+            }
+
+            if( pxNext != NULL )
+            {
+                /* Fill the gap with the last pending message. */
+                ulPendingCount--;
+                pxPendingMessages[ ulNextIndex ] = pxPendingMessages[ ulPendingCount ];
+                xStats.ulMessagesDelivered++;
+            }
+        }
+        ( void ) xSemaphoreGive( xSimulatorMutex );
+
+        if( pxNext != NULL )
+        {
+            memset( &xPublishInfo, 0x00, sizeof( xPublishInfo ) );
+            xPublishInfo.qos = MQTTQoS0;
+            xPublishInfo.pTopicName = pxNext->cTopic;
+            xPublishInfo.topicNameLength = pxNext->usTopicLength;
+            xPublishInfo.pPayload = pxNext->ucPayload;
+            xPublishInfo.payloadLength = pxNext->ulPayloadLength;
+
+            pxDeliverCallback( pvDeliverCallbackContext, &xPublishInfo );
+
+            prvFreeMessage( pxNext );
+        }
+        else
+        {
+            ( void ) ulTaskNotifyTake( pdTRUE, xWait );
+        }
+    }
+}
+/*-----------------------------------------------------------*/
+
+eOtaSimulatorStatus eOtaSimulatorInit( IncomingPubCallback_t pxIncomingPublishCallback,
+                                       void * pvIncomingPublishCallbackContext )
+{
+    eOtaSimulatorStatus eStatus = eOtaSimulatorSuccess;
+
+    if( pxIncomingPublishCallback == NULL )
+    {
+        LogError( ( "Invalid parameter. pxIncomingPublishCallback: %p", pxIncomingPublishCallback ) );
+        eStatus = eOtaSimulatorBadParameter;
+    }
+
+    if( eStatus == eOtaSimulatorSuccess )
+    {
+        objectpoolINIT( xMessagePool, "ota simulator", pdFALSE );
+        ulPendingCount = 0;
+        memset( &xStats, 0x00, sizeof( xStats ) );
+        xJobServed = pdFALSE;
+        pxDeliverCallback = pxIncomingPublishCallback;
+        pvDeliverCallbackContext = pvIncomingPublishCallbackContext;
+
+        xSimulatorMutex = xSemaphoreCreateMutex();
+
+        if( xSimulatorMutex == NULL )
+        {
+            LogError( ( "Failed to create the OTA simulator mutex." ) );
+            eStatus = eOtaSimulatorInitFailed;
+        }
+    }
+
+    if( eStatus == eOtaSimulatorSuccess )
+    {
+        if( xTaskCreate( prvOtaSimulatorTask,
+                         "OTASimulator",
+                         otasimconfigTASK_STACK_SIZE,
+                         NULL,
+                         otasimconfigTASK_PRIORITY,
+                         &xSimulatorTask ) != pdPASS )
+        {
+            LogError( ( "Failed to create the OTA simulator task." ) );
+            eStatus = eOtaSimulatorInitFailed;
+        }
+    }
+
+    if( eStatus == eOtaSimulatorSuccess )
+    {
+        LogInfo( ( "OTA simulator serving a %lu byte image in %lu blocks, loss %u%%, "
+                   "reorder %u%%, duplicate %u%%, latency %u-%u ms.",
+                   ( unsigned long ) otasimconfigIMAGE_SIZE,
+                   ( unsigned long ) otasimNUM_BLOCKS,
+                   otasimconfigLOSS_PERCENT,
+                   otasimconfigREORDER_PERCENT,
+                   otasimconfigDUPLICATE_PERCENT,
+                   otasimconfigMIN_LATENCY_MS,
+                   otasimconfigMAX_LATENCY_MS ) );
+    }
+
+    return eStatus;
+}
+/*-----------------------------------------------------------*/
+
+OtaMqttStatus_t eOtaSimulatorSubscribe( const char * pcTopicFilter,
+                                        uint16_t usTopicFilterLength,
+                                        uint8_t ucQoS )
+{
+    configASSERT( pcTopicFilter != NULL );
+
+    ( void ) ucQoS;
+
+    LogInfo( ( "OTA simulator subscribed to %.*s.", usTopicFilterLength, pcTopicFilter ) );
+
+    return OtaMqttSuccess;
+}
+/*-----------------------------------------------------------*/
+
+OtaMqttStatus_t eOtaSimulatorUnsubscribe( const char * pcTopicFilter,
+                                          uint16_t usTopicFilterLength,
+                                          uint8_t ucQoS )
+{
+    configASSERT( pcTopicFilter != NULL );
+
+    ( void ) ucQoS;
+
+    LogInfo( ( "OTA simulator unsubscribed from %.*s.", usTopicFilterLength, pcTopicFilter ) );
+
+    return OtaMqttSuccess;
+}
+/*-----------------------------------------------------------*/
+
+OtaMqttStatus_t eOtaSimulatorPublish( const char * const pcTopic,
+                                      uint16_t usTopicLength,
+                                      const char * pcMessage,
+                                      uint32_t ulMessageSize,
+                                      uint8_t ucQoS )
+{
+    OtaMqttStatus_t xStatus = OtaMqttSuccess;
+    const char * pcThingEnd = NULL;
+    const char * pcTopicEnd;
+    size_t xRemaining;
+
+    configASSERT( pcTopic != NULL );
+    configASSERT( xSimulatorTask != NULL );
+
+    ( void ) ucQoS;
+
+    pcTopicEnd = pcTopic + usTopicLength;
+
+    if( ( usTopicLength > otasimTOPIC_PREFIX_LENGTH ) &&
+        ( strncmp( pcTopic, otasimTOPIC_PREFIX, otasimTOPIC_PREFIX_LENGTH ) == 0 ) )
+    {
+        pcThingEnd = memchr( pcTopic + otasimTOPIC_PREFIX_LENGTH, '/', usTopicLength - otasimTOPIC_PREFIX_LENGTH );
+    }
+
+    if( pcThingEnd == NULL )
+    {
+        LogWarn( ( "OTA simulator ignored publish to %.*s.", usTopicLength, pcTopic ) );
+    }
+    else
+    {
+        xRemaining = ( size_t ) ( pcTopicEnd - pcThingEnd );
+
+        if( ( xRemaining == ( sizeof( otasimJOB_GET_NEXT_SUFFIX ) - 1U ) ) &&
+            ( strncmp( pcThingEnd, otasimJOB_GET_NEXT_SUFFIX, xRemaining ) == 0 ) )
+        {
+            prvIncrementStat( &( xStats.ulJobRequests ) );
+            xStatus = prvHandleJobRequest( pcTopic, usTopicLength, pcMessage, ulMessageSize );
+        }
+        else if( ( xRemaining > ( sizeof( otasimSTREAMS_SEGMENT ) - 1U ) + ( sizeof( otasimSTREAM_GET_SUFFIX ) - 1U ) ) &&
+                 ( strncmp( pcThingEnd, otasimSTREAMS_SEGMENT, sizeof( otasimSTREAMS_SEGMENT ) - 1U ) == 0 ) &&
+                 ( strncmp( pcTopicEnd - ( sizeof( otasimSTREAM_GET_SUFFIX ) - 1U ),
+                            otasimSTREAM_GET_SUFFIX,
+                            sizeof( otasimSTREAM_GET_SUFFIX ) - 1U ) == 0 ) )
+        {
+            xStatus = prvHandleStreamRequest( pcTopic, usTopicLength, ( const uint8_t * ) pcMessage, ulMessageSize );
+        }
+        else if( ( xRemaining > ( sizeof( otasimJOB_UPDATE_SUFFIX ) - 1U ) ) &&
+                 ( strncmp( pcTopicEnd - ( sizeof( otasimJOB_UPDATE_SUFFIX ) - 1U ),
+                            otasimJOB_UPDATE_SUFFIX,
+                            sizeof( otasimJOB_UPDATE_SUFFIX ) - 1U ) == 0 ) )
+        {
+            LogInfo( ( "OTA simulator received job status update: %.*s",
+                       ( int ) ulMessageSize,
+                       pcMessage ) );
+        }
+        else
+        {
+            LogWarn( ( "OTA simulator ignored publish to %.*s.", usTopicLength, pcTopic ) );
+        }
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
+void vOtaSimulatorGetStats( OtaSimulatorStats_t * pxOutStats )
+{
+    configASSERT( pxOutStats != NULL );
+    configASSERT( xSimulatorMutex != NULL );
+
+    ( void ) xSemaphoreTake( xSimulatorMutex, portMAX_DELAY );
+    {
+        *pxOutStats = xStats;
+    }
+    ( void ) xSemaphoreGive( xSimulatorMutex );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,132 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/**
+ * @file ota_stream_simulator.h
+ *
+ * @brief In-process stand-in for the AWS IoT Jobs and Streams services used by
+ * the OTA demo.
+ *
+ * The simulator implements the MQTT interface expected by the OTA library.
+ * Publishes from the OTA agent never leave the device - job requests are
+ * answered with a job document describing a synthetic image, and stream
+ * requests are answered with CBOR encoded data blocks.  Responses are looped
+ * back to the device through the same callback used for messages received
+ * from the broker, after passing through a lossy channel with configurable
+ * loss, reordering, duplication and latency.
+ */
+
+#ifndef OTA_STREAM_SIMULATOR_H_
+#define OTA_STREAM_SIMULATOR_H_
+
+#include <stdint.h>
+
+/* OTA library MQTT interface include. */
+#include "ota_mqtt_interface.h"
+
+/* Subscription manager include for the incoming publish callback type. */
+#include "subscription_manager.h"
+
+/**
+ * @brief Return codes from OTA simulator APIs.
+ */
+typedef enum
+{
+    eOtaSimulatorSuccess = 0,
+    eOtaSimulatorBadParameter,
+    eOtaSimulatorInitFailed
+} eOtaSimulatorStatus;
+
+/**
+ * @brief Counters maintained by the simulator.
+ */
+typedef struct OtaSimulatorStats
+{
+    uint32_t ulJobRequests;       /**< Number of job document requests received. */
+    uint32_t ulStreamRequests;    /**< Number of stream data requests received. */
+    uint32_t ulBlocksServed;      /**< Number of data blocks encoded in response to stream requests. */
+    uint32_t ulBlocksDropped;     /**< Number of data blocks discarded by the simulated loss. */
+    uint32_t ulBlocksReordered;   /**< Number of data blocks held back so later blocks overtake them. */
+    uint32_t ulBlocksDuplicated;  /**< Number of data blocks delivered twice. */
+    uint32_t ulMessagesDelivered; /**< Number of messages passed to the incoming publish callback. */
+    uint32_t ulOverflows;         /**< Number of responses discarded because no pending message slot was free. */
+} OtaSimulatorStats_t;
+
+/**
+ * @brief Start the simulator.
+ *
+ * Creates the task that delivers simulated responses.  Must be called before
+ * the OTA agent is started.
+ *
+ * @param[in] pxIncomingPublishCallback Function called with every simulated
+ * message sent to the device, normally the function that routes OTA messages
+ * received from the broker.
+ * @param[in] pvIncomingPublishCallbackContext Context passed to
+ * pxIncomingPublishCallback.
+ *
+ * @return #eOtaSimulatorSuccess if the simulator is started;
+ * #eOtaSimulatorBadParameter if invalid parameters are passed;
+ * #eOtaSimulatorInitFailed if the RTOS objects could not be created.
+ */
+eOtaSimulatorStatus eOtaSimulatorInit( IncomingPubCallback_t pxIncomingPublishCallback,
+                                       void * pvIncomingPublishCallbackContext );
+
+/**
+ * @brief Subscribe function for the OTA library MQTT interface.
+ *
+ * The simulator serves every topic so subscriptions are only logged.
+ */
+OtaMqttStatus_t eOtaSimulatorSubscribe( const char * pcTopicFilter,
+                                        uint16_t usTopicFilterLength,
+                                        uint8_t ucQoS );
+
+/**
+ * @brief Unsubscribe function for the OTA library MQTT interface.
+ */
+OtaMqttStatus_t eOtaSimulatorUnsubscribe( const char * pcTopicFilter,
+                                          uint16_t usTopicFilterLength,
+                                          uint8_t ucQoS );
+
+/**
+ * @brief Publish function for the OTA library MQTT interface.
+ *
+ * Job and stream requests are answered by queuing the response for delivery
+ * by the simulator task.  Job status updates are accepted and discarded.
+ */
+OtaMqttStatus_t eOtaSimulatorPublish( const char * const pcTopic,
+                                      uint16_t usTopicLength,
+                                      const char * pcMessage,
+                                      uint32_t ulMessageSize,
+                                      uint8_t ucQoS );
+
+/**
+ * @brief Get a copy of the simulator counters.
+ *
+ * @param[out] pxOutStats The counters.
+ */
+void vOtaSimulatorGetStats( OtaSimulatorStats_t * pxOutStats );
+
+#endif /* OTA_STREAM_SIMULATOR_H_ */
@@ -0,0 +1,375 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file payload_template.c
+ *
+ * @brief Implementation of payloads compiled from a pattern and updated by
+ * rewriting only the fields that change.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/* Interface include. */
+#include "payload_template.h"
+
+/**
+ * @brief Character that starts a conversion specification in a pattern.
+ */
+#define payloadtemplateSPECIFIER    '%'
+
+/**
+ * @brief Largest width accepted in a conversion specification.  Bounds the
+ * width so that adding it to the payload length cannot overflow.
+ */
+#define payloadtemplateMAX_WIDTH    ( 0xFFFFU )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Write the decimal digits of a number to the end of a buffer.
+ *
+ * @param[out] pcDigits Buffer of #payloadtemplateMAX_NUMBER_LENGTH characters.
+ * The digits are written at its end.
+ * @param[in] ulValue The number.
+ *
+ * @return Number of digits written.
+ */
+static size_t prvWriteDigits( char * pcDigits,
+                              uint32_t ulValue );
+
+/**
+ * @brief Change the length of a variable length slot, moving the text after
+ * it and the slots that follow.
+ *
+ * @param[in] pxTemplate The template.
+ * @param[in] xSlot Index of the slot.
+ * @param[in] xNewLength New length of the slot, at most its maximum length.
+ */
+static void prvResizeSlot( PayloadTemplate_t * pxTemplate,
+                           size_t xSlot,
+                           size_t xNewLength );
+
+/**
+ * @brief Parse a conversion specification into a slot.
+ *
+ * @param[in,out] ppcPattern The character after the '%' that starts the
+ * specification, advanced past its last character.
+ * @param[out] pxSlot The slot.
+ *
+ * @return #ePayloadTemplateSuccess if the specification is parsed;
+ * #ePayloadTemplateInvalidPattern otherwise.
+ */
+static ePayloadTemplateStatus prvParseSlot( const char ** ppcPattern,
+                                            PayloadTemplateSlot_t * pxSlot );
+
+/*-----------------------------------------------------------*/
+
+static size_t prvWriteDigits( char * pcDigits,
+                              uint32_t ulValue )
+{
+    size_t xCount = 0U;
+
+    do
+    {
+        xCount++;
+        pcDigits[ payloadtemplateMAX_NUMBER_LENGTH - xCount ] = ( char ) ( '0' + ( ulValue % 10U ) );
+        ulValue /= 10U;
+    } while( ulValue != 0U );
+
+    return xCount;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvResizeSlot( PayloadTemplate_t * pxTemplate,
+                           size_t xSlot,
+                           size_t xNewLength )
+{
+    PayloadTemplateSlot_t * pxSlot = &( pxTemplate->xSlots[ xSlot ] );
+    size_t xOldEnd = pxSlot->xOffset + pxSlot->xLength;
+    size_t xNewEnd = pxSlot->xOffset + xNewLength;
+    size_t i;
+
+    if( xNewEnd != xOldEnd )
+    {
+        /* Move the rest of the payload, including the NULL terminator. */
+        ( void ) memmove( &( pxTemplate->pcPayload[ xNewEnd ] ),
+                          &( pxTemplate->pcPayload[ xOldEnd ] ),
+                          ( pxTemplate->xLength - xOldEnd ) + 1U );
+
+        for( i = xSlot + 1U; i < pxTemplate->xSlotCount; i++ )
+        {
+            pxTemplate->xSlots[ i ].xOffset = ( pxTemplate->xSlots[ i ].xOffset + xNewEnd ) - xOldEnd;
+        }
+
+        pxTemplate->xLength = ( pxTemplate->xLength + xNewEnd ) - xOldEnd;
+        pxSlot->xLength = xNewLength;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static ePayloadTemplateStatus prvParseSlot( const char ** ppcPattern,
+                                            PayloadTemplateSlot_t * pxSlot )
+{
+    ePayloadTemplateStatus eStatus = ePayloadTemplateSuccess;
+    const char * pcSpecification = *ppcPattern;
+    size_t xWidth = 0U;
+
+    pxSlot->cPadding = ' ';
+
+    if( *pcSpecification == '0' )
+    {
+        pxSlot->cPadding = '0';
+        pcSpecification++;
+    }
+
+    while( ( *pcSpecification >= '0' ) && ( *pcSpecification <= '9' ) && ( xWidth <= payloadtemplateMAX_WIDTH ) )
+    {
+        xWidth = ( xWidth * 10U ) + ( size_t ) ( *pcSpecification - '0' );
+        pcSpecification++;
+    }
+
+    if( xWidth > payloadtemplateMAX_WIDTH )
+    {
+        eStatus = ePayloadTemplateInvalidPattern;
+    }
+    else if( ( *pcSpecification == 'u' ) && ( xWidth == 0U ) && ( pxSlot->cPadding == ' ' ) )
+    {
+        pxSlot->eType = PayloadSlotNumber;
+        pxSlot->xWidth = payloadtemplateMAX_NUMBER_LENGTH;
+    }
+    else if( ( *pcSpecification == 'u' ) && ( xWidth != 0U ) )
+    {
+        pxSlot->eType = PayloadSlotFixedNumber;
+        pxSlot->xWidth = xWidth;
+    }
+    else if( ( *pcSpecification == 's' ) && ( xWidth != 0U ) && ( pxSlot->cPadding == ' ' ) )
+    {
+        pxSlot->eType = PayloadSlotString;
+        pxSlot->xWidth = xWidth;
+    }
+    else
+    {
+        eStatus = ePayloadTemplateInvalidPattern;
+    }
+
+    if( eStatus == ePayloadTemplateSuccess )
+    {
+        *ppcPattern = pcSpecification + 1;
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+ePayloadTemplateStatus ePayloadTemplateCompile( PayloadTemplate_t * pxTemplate,
+                                                const char * pcPattern,
+                                                char * pcBuffer,
+                                                size_t xBufferLength )
+{
+    ePayloadTemplateStatus eStatus = ePayloadTemplateSuccess;
+    PayloadTemplateSlot_t * pxSlot;
+    size_t xMaxLength = 0U;
+
+    if( ( pxTemplate == NULL ) || ( pcPattern == NULL ) || ( pcBuffer == NULL ) || ( xBufferLength == 0U ) )
+    {
+        eStatus = ePayloadTemplateBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pxTemplate, 0x00, sizeof( PayloadTemplate_t ) );
+        pxTemplate->pcPayload = pcBuffer;
+    }
+
+    /* The initial payload is never longer than the longest payload, so
+     * checking the longest length before each write also keeps every write
+     * within the buffer. */
+    while( ( eStatus == ePayloadTemplateSuccess ) && ( *pcPattern != '\0' ) )
+    {
+        if( ( pcPattern[ 0 ] != payloadtemplateSPECIFIER ) || ( pcPattern[ 1 ] == payloadtemplateSPECIFIER ) )
+        {
+            /* Constant text. */
+            if( ( xMaxLength + 1U ) >= xBufferLength )
+            {
+                eStatus = ePayloadTemplateBufferTooSmall;
+            }
+            else
+            {
+                pcBuffer[ pxTemplate->xLength ] = *pcPattern;
+                pxTemplate->xLength++;
+                xMaxLength++;
+                pcPattern += ( pcPattern[ 0 ] == payloadtemplateSPECIFIER ) ? 2 : 1;
+            }
+        }
+        else if( pxTemplate->xSlotCount == payloadtemplateMAX_SLOTS )
+        {
+            eStatus = ePayloadTemplateTooManySlots;
+        }
+        else
+        {
+            pcPattern++;
+            pxSlot = &( pxTemplate->xSlots[ pxTemplate->xSlotCount ] );
+            eStatus = prvParseSlot( &pcPattern, pxSlot );
+
+            if( ( eStatus == ePayloadTemplateSuccess ) && ( ( xMaxLength + pxSlot->xWidth ) >= xBufferLength ) )
+            {
+                eStatus = ePayloadTemplateBufferTooSmall;
+            }
+
+            if( eStatus == ePayloadTemplateSuccess )
+            {
+                pxSlot->xOffset = pxTemplate->xLength;
+                xMaxLength += pxSlot->xWidth;
+
+                /* Number slots start as 0 and string slots start empty. */
+                if( pxSlot->eType == PayloadSlotFixedNumber )
+                {
+                    ( void ) memset( &( pcBuffer[ pxSlot->xOffset ] ), pxSlot->cPadding, pxSlot->xWidth - 1U );
+                    pcBuffer[ pxSlot->xOffset + pxSlot->xWidth - 1U ] = '0';
+                    pxSlot->xLength = pxSlot->xWidth;
+                }
+                else if( pxSlot->eType == PayloadSlotNumber )
+                {
+                    pcBuffer[ pxSlot->xOffset ] = '0';
+                    pxSlot->xLength = 1U;
+                }
+                else
+                {
+                    pxSlot->xLength = 0U;
+                }
+
+                pxTemplate->xLength += pxSlot->xLength;
+                pxTemplate->xSlotCount++;
+            }
+        }
+    }
+
+    if( eStatus == ePayloadTemplateSuccess )
+    {
+        pcBuffer[ pxTemplate->xLength ] = '\0';
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+ePayloadTemplateStatus ePayloadTemplateSetNumber( PayloadTemplate_t * pxTemplate,
+                                                  size_t xSlot,
+                                                  uint32_t ulValue )
+{
+    ePayloadTemplateStatus eStatus = ePayloadTemplateSuccess;
+    PayloadTemplateSlot_t * pxSlot = NULL;
+    char cDigits[ payloadtemplateMAX_NUMBER_LENGTH ];
+    size_t xDigitCount;
+
+    if( ( pxTemplate == NULL ) || ( xSlot >= pxTemplate->xSlotCount ) )
+    {
+        eStatus = ePayloadTemplateBadParameter;
+    }
+    else
+    {
+        pxSlot = &( pxTemplate->xSlots[ xSlot ] );
+
+        if( pxSlot->eType == PayloadSlotString )
+        {
+            eStatus = ePayloadTemplateBadParameter;
+        }
+    }
+
+    if( ( eStatus == ePayloadTemplateSuccess ) && ( pxSlot->ulValue != ulValue ) )
+    {
+        xDigitCount = prvWriteDigits( cDigits, ulValue );
+
+        if( pxSlot->eType == PayloadSlotNumber )
+        {
+            prvResizeSlot( pxTemplate, xSlot, xDigitCount );
+        }
+        else if( xDigitCount > pxSlot->xWidth )
+        {
+            eStatus = ePayloadTemplateValueTooLarge;
+        }
+        else
+        {
+            /* Fixed width slots are right aligned. */
+            ( void ) memset( &( pxTemplate->pcPayload[ pxSlot->xOffset ] ),
+                             pxSlot->cPadding,
+                             pxSlot->xWidth - xDigitCount );
+        }
+
+        if( eStatus == ePayloadTemplateSuccess )
+        {
+            ( void ) memcpy( &( pxTemplate->pcPayload[ pxSlot->xOffset + pxSlot->xLength - xDigitCount ] ),
+                             &( cDigits[ payloadtemplateMAX_NUMBER_LENGTH - xDigitCount ] ),
+                             xDigitCount );
+            pxSlot->ulValue = ulValue;
+        }
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+ePayloadTemplateStatus ePayloadTemplateSetString( PayloadTemplate_t * pxTemplate,
+                                                  size_t xSlot,
+                                                  const char * pcString,
+                                                  size_t xStringLength )
+{
+    ePayloadTemplateStatus eStatus = ePayloadTemplateSuccess;
+
+    if( ( pxTemplate == NULL ) || ( xSlot >= pxTemplate->xSlotCount ) ||
+        ( ( pcString == NULL ) && ( xStringLength != 0U ) ) ||
+        ( pxTemplate->xSlots[ xSlot ].eType != PayloadSlotString ) )
+    {
+        eStatus = ePayloadTemplateBadParameter;
+    }
+    else if( xStringLength > pxTemplate->xSlots[ xSlot ].xWidth )
+    {
+        eStatus = ePayloadTemplateValueTooLarge;
+    }
+    else
+    {
+        prvResizeSlot( pxTemplate, xSlot, xStringLength );
+
+        if( xStringLength != 0U )
+        {
+            ( void ) memcpy( &( pxTemplate->pcPayload[ pxTemplate->xSlots[ xSlot ].xOffset ] ),
+                             pcString,
+                             xStringLength );
+        }
+    }
+
+    return eStatus;
+}
@@ -0,0 +1,187 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file payload_template.h
+ *
+ * @brief Payloads that are compiled once from a pattern and then updated by
+ * rewriting only the fields that change.
+ *
+ * A pattern is text in which each field, or slot, is written as a
+ * conversion specification:
+ *
+ * - "%u" is a number of variable length.
+ * - "%Nu" is a number right aligned in a field of N characters, padded with
+ *   spaces.  "%0Nu" pads with zeros.
+ * - "%Ns" is a string of at most N characters.
+ * - "%%" is a percent sign.
+ *
+ * Compiling a pattern writes the constant text into the payload buffer once
+ * and records the position of every slot.  Setting a slot then only rewrites
+ * that slot, so building a periodic payload costs time proportional to the
+ * fields that changed rather than to the length of the payload.  Fixed width
+ * slots never move.  When the length of a variable length slot changes, the
+ * text after it is moved, so such slots are best placed near the end of the
+ * pattern.
+ *
+ * The buffer must be large enough for the longest payload the pattern can
+ * produce, which is checked when the pattern is compiled, so setting a slot
+ * can never overflow the buffer.
+ */
+
+#ifndef PAYLOAD_TEMPLATE_H_
+#define PAYLOAD_TEMPLATE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Maximum number of slots in a pattern.  Can be overridden in
+ * demo_config.h.
+ */
+#ifndef payloadtemplateMAX_SLOTS
+    #define payloadtemplateMAX_SLOTS    ( 8U )
+#endif
+
+/**
+ * @brief Maximum number of characters in a number slot.  Wide enough for the
+ * 10 digits of UINT32_MAX.
+ */
+#define payloadtemplateMAX_NUMBER_LENGTH    ( 10U )
+
+/**
+ * @brief Return codes from payload template APIs.
+ */
+typedef enum
+{
+    ePayloadTemplateSuccess = 0,
+    ePayloadTemplateBadParameter,
+    ePayloadTemplateInvalidPattern,
+    ePayloadTemplateTooManySlots,
+    ePayloadTemplateBufferTooSmall,
+    ePayloadTemplateValueTooLarge
+} ePayloadTemplateStatus;
+
+/**
+ * @brief Type of a slot.
+ */
+typedef enum
+{
+    PayloadSlotNumber = 0,  /**< "%u". */
+    PayloadSlotFixedNumber, /**< "%Nu" or "%0Nu". */
+    PayloadSlotString       /**< "%Ns". */
+} PayloadSlotType_t;
+
+/**
+ * @brief A slot of a compiled pattern.
+ */
+typedef struct PayloadTemplateSlot
+{
+    size_t xOffset;          /**< Offset of the slot in the payload. */
+    size_t xLength;          /**< Number of characters in the slot. */
+    size_t xWidth;           /**< Width of a fixed width slot, or the maximum length of a variable length slot. */
+    uint32_t ulValue;        /**< Value last written to a number slot. */
+    PayloadSlotType_t eType; /**< Type of the slot. */
+    char cPadding;           /**< Character written before the number in a fixed width slot. */
+} PayloadTemplateSlot_t;
+
+/**
+ * @brief A compiled pattern and the payload built from it.
+ *
+ * pcPayload and xLength may be read to publish the payload.  The other fields
+ * are private to payload_template.c.
+ */
+typedef struct PayloadTemplate
+{
+    char * pcPayload;                                         /**< The payload, NULL terminated. */
+    size_t xLength;                                           /**< Length of the payload. */
+    PayloadTemplateSlot_t xSlots[ payloadtemplateMAX_SLOTS ]; /**< The slots, in the order they appear in the pattern. */
+    size_t xSlotCount;                                        /**< Number of slots. */
+} PayloadTemplate_t;
+
+/**
+ * @brief Compile a pattern into a payload buffer.
+ *
+ * Number slots are initially 0 and string slots are initially empty.
+ *
+ * @param[out] pxTemplate The template.
+ * @param[in] pcPattern The pattern, NULL terminated.
+ * @param[in] pcBuffer Buffer to hold the payload.  It must remain valid for as
+ * long as the template is used.
+ * @param[in] xBufferLength Length of pcBuffer.
+ *
+ * @return #ePayloadTemplateSuccess if the pattern is compiled;
+ * #ePayloadTemplateBadParameter if invalid parameters are passed;
+ * #ePayloadTemplateInvalidPattern if a conversion specification is not
+ * supported;
+ * #ePayloadTemplateTooManySlots if the pattern has more than
+ * #payloadtemplateMAX_SLOTS slots;
+ * #ePayloadTemplateBufferTooSmall if the longest payload of the pattern and
+ * its NULL terminator do not fit in pcBuffer.
+ */
+ePayloadTemplateStatus ePayloadTemplateCompile( PayloadTemplate_t * pxTemplate,
+                                                const char * pcPattern,
+                                                char * pcBuffer,
+                                                size_t xBufferLength );
+
+/**
+ * @brief Write a number into a number slot.  The payload is not changed if the
+ * slot already holds the number.
+ *
+ * @param[in] pxTemplate The template.
+ * @param[in] xSlot Index of the slot, counting from 0 in pattern order.
+ * @param[in] ulValue The number.
+ *
+ * @return #ePayloadTemplateSuccess if the number is written;
+ * #ePayloadTemplateBadParameter if invalid parameters are passed or the slot
+ * is not a number slot;
+ * #ePayloadTemplateValueTooLarge if the number is wider than a fixed width
+ * slot.
+ */
+ePayloadTemplateStatus ePayloadTemplateSetNumber( PayloadTemplate_t * pxTemplate,
+                                                  size_t xSlot,
+                                                  uint32_t ulValue );
+
+/**
+ * @brief Write a string into a string slot.
+ *
+ * @param[in] pxTemplate The template.
+ * @param[in] xSlot Index of the slot, counting from 0 in pattern order.
+ * @param[in] pcString The string.
+ * @param[in] xStringLength Length of pcString.
+ *
+ * @return #ePayloadTemplateSuccess if the string is written;
+ * #ePayloadTemplateBadParameter if invalid parameters are passed or the slot
+ * is not a string slot;
+ * #ePayloadTemplateValueTooLarge if the string is longer than the slot.
+ */
+ePayloadTemplateStatus ePayloadTemplateSetString( PayloadTemplate_t * pxTemplate,
+                                                  size_t xSlot,
+                                                  const char * pcString,
+                                                  size_t xStringLength );
+
+#endif /* PAYLOAD_TEMPLATE_H_ */
@@ -0,0 +1,439 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file object_pool.c
+ *
+ * @brief Fixed size pools of statically allocated objects.  See
+ * object_pool.h.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "object_pool.h"
+
+#if defined( _MSC_VER ) && !defined( __GNUC__ )
+    #include <intrin.h>
+#endif
+
+#if ( configSUPPORT_STATIC_ALLOCATION != 1 )
+    #error object_pool.c creates the semaphore of a blocking pool statically, so configSUPPORT_STATIC_ALLOCATION must be 1.
+#endif
+
+/**
+ * @brief The index that ends the free list, the index held in the free list
+ * entry of an acquired object, and the index held in it while the object is
+ * being released.
+ */
+#define objectpoolEND           ( 0xFFFFU )
+#define objectpoolACQUIRED      ( 0xFFFEU )
+#define objectpoolRELEASING     ( 0xFFFDU )
+
+/**
+ * @brief The fields of the head of the free list.
+ */
+#define objectpoolINDEX_MASK    ( 0x0000FFFFUL )
+#define objectpoolGENERATION    ( 0x00010000UL )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Atomically replace the value of a variable if it has not changed.
+ * Lock-free with GCC and MSVC, which compile it to LDREX/STREX on the
+ * Cortex-M3 and to a locked CMPXCHG on the Windows simulator.
+ *
+ * @param[in] pulTarget The variable.
+ * @param[in] ulExpected The value the variable must hold to be replaced.
+ * @param[in] ulDesired The value to replace it with.
+ *
+ * @return pdTRUE if the variable was replaced, otherwise pdFALSE.
+ */
+static BaseType_t prvCompareAndSwap( volatile uint32_t * pulTarget,
+                                     uint32_t ulExpected,
+                                     uint32_t ulDesired );
+
+/**
+ * @brief prvCompareAndSwap() for a 16-bit variable.
+ *
+ * @param[in] pusTarget The variable.
+ * @param[in] usExpected The value the variable must hold to be replaced.
+ * @param[in] usDesired The value to replace it with.
+ *
+ * @return pdTRUE if the variable was replaced, otherwise pdFALSE.
+ */
+static BaseType_t prvCompareAndSwap16( volatile uint16_t * pusTarget,
+                                       uint16_t usExpected,
+                                       uint16_t usDesired );
+
+/**
+ * @brief Atomically add to a variable.
+ *
+ * @param[in] pulTarget The variable.
+ * @param[in] lDelta The value to add.
+ *
+ * @return The new value of the variable.
+ */
+static uint32_t prvAtomicAdd( volatile uint32_t * pulTarget,
+                              int32_t lDelta );
+
+/**
+ * @brief Atomically raise a variable to a value if it is below it.
+ *
+ * @param[in] pulTarget The variable.
+ * @param[in] ulValue The value.
+ */
+static void prvAtomicMax( volatile uint32_t * pulTarget,
+                          uint32_t ulValue );
+
+/**
+ * @brief Take the object at the head of the free list.
+ *
+ * @param[in] pxPool The pool.
+ *
+ * @return The index of the object, or objectpoolEND if the list is empty.
+ */
+static uint16_t prvPopFree( ObjectPool_t * pxPool );
+
+/**
+ * @brief Put an object at the head of the free list.
+ *
+ * @param[in] pxPool The pool.
+ * @param[in] usIndex The index of the object.
+ */
+static void prvPushFree( ObjectPool_t * pxPool,
+                         uint16_t usIndex );
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvCompareAndSwap( volatile uint32_t * pulTarget,
+                                     uint32_t ulExpected,
+                                     uint32_t ulDesired )
+{
+    BaseType_t xSwapped;
+
+    #if defined( __GNUC__ )
+        xSwapped = __atomic_compare_exchange_n( pulTarget, &ulExpected, ulDesired, 0,
+                                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) ? pdTRUE : pdFALSE;
+    #elif defined( _MSC_VER )
+        xSwapped = ( ( uint32_t ) _InterlockedCompareExchange( ( volatile long * ) pulTarget,
+                                                               ( long ) ulDesired,
+                                                               ( long ) ulExpected ) == ulExpected ) ? pdTRUE : pdFALSE;
+    #else
+        /* No atomic operations are known for this compiler, so fall back to a
+         * critical section - the pool can then not be used from interrupts. */
+        taskENTER_CRITICAL();
+        {
+            xSwapped = ( *pulTarget == ulExpected ) ? pdTRUE : pdFALSE;
+
+            if( xSwapped == pdTRUE )
+            {
+                *pulTarget = ulDesired;
+            }
+        }
+        taskEXIT_CRITICAL();
+    #endif /* if defined( __GNUC__ ) */
+
+    return xSwapped;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvCompareAndSwap16( volatile uint16_t * pusTarget,
+                                       uint16_t usExpected,
+                                       uint16_t usDesired )
+{
+    BaseType_t xSwapped;
+
+    #if defined( __GNUC__ )
+        xSwapped = __atomic_compare_exchange_n( pusTarget, &usExpected, usDesired, 0,
+                                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) ? pdTRUE : pdFALSE;
+    #elif defined( _MSC_VER )
+        xSwapped = ( ( uint16_t ) _InterlockedCompareExchange16( ( volatile short * ) pusTarget,
+                                                                 ( short ) usDesired,
+                                                                 ( short ) usExpected ) == usExpected ) ? pdTRUE : pdFALSE;
+    #else
+        taskENTER_CRITICAL();
+        {
+            xSwapped = ( *pusTarget == usExpected ) ? pdTRUE : pdFALSE;
+
+            if( xSwapped == pdTRUE )
+            {
+                *pusTarget = usDesired;
+            }
+        }
+        taskEXIT_CRITICAL();
+    #endif /* if defined( __GNUC__ ) */
+
+    return xSwapped;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvAtomicAdd( volatile uint32_t * pulTarget,
+                              int32_t lDelta )
+{
+    uint32_t ulValue;
+
+    do
+    {
+        ulValue = *pulTarget;
+    } while( prvCompareAndSwap( pulTarget, ulValue, ulValue + ( uint32_t ) lDelta ) == pdFALSE );
+
+    return ulValue + ( uint32_t ) lDelta;
+}
+/*-----------------------------------------------------------*/
+
+static void prvAtomicMax( volatile uint32_t * pulTarget,
+                          uint32_t ulValue )
+{
+    uint32_t ulCurrent;
+
+    do
+    {
+        ulCurrent = *pulTarget;
+    } while( ( ulCurrent < ulValue ) &&
+             ( prvCompareAndSwap( pulTarget, ulCurrent, ulValue ) == pdFALSE ) );
+}
+/*-----------------------------------------------------------*/
+
+static uint16_t prvPopFree( ObjectPool_t * pxPool )
+{
+    uint32_t ulHead, ulNewHead;
+    uint16_t usIndex;
+
+    do
+    {
+        ulHead = pxPool->ulFreeHead;
+        usIndex = ( uint16_t ) ( ulHead & objectpoolINDEX_MASK );
+
+        if( usIndex == objectpoolEND )
+        {
+            break;
+        }
+
+        /* If another task or interrupt takes this object first the entry read
+         * here may be stale, but the generation in the head will then have
+         * changed and the swap fails. */
+        ulNewHead = ( ( ulHead & ~objectpoolINDEX_MASK ) + objectpoolGENERATION ) |
+                    ( uint32_t ) pxPool->pusNextFree[ usIndex ];
+    } while( prvCompareAndSwap( &( pxPool->ulFreeHead ), ulHead, ulNewHead ) == pdFALSE );
+
+    return usIndex;
+}
+/*-----------------------------------------------------------*/
+
+static void prvPushFree( ObjectPool_t * pxPool,
+                         uint16_t usIndex )
+{
+    uint32_t ulHead, ulNewHead;
+
+    do
+    {
+        ulHead = pxPool->ulFreeHead;
+        pxPool->pusNextFree[ usIndex ] = ( uint16_t ) ( ulHead & objectpoolINDEX_MASK );
+        ulNewHead = ( ( ulHead & ~objectpoolINDEX_MASK ) + objectpoolGENERATION ) |
+                    ( uint32_t ) usIndex;
+    } while( prvCompareAndSwap( &( pxPool->ulFreeHead ), ulHead, ulNewHead ) == pdFALSE );
+}
+/*-----------------------------------------------------------*/
+
+void vObjectPoolInit( ObjectPool_t * pxPool,
+                      void * pvObjects,
+                      size_t xObjectSize,
+                      uint16_t usObjectCount,
+                      uint16_t * pusNextFree,
+                      const char * pcName,
+                      BaseType_t xBlocking )
+{
+    uint16_t usIndex;
+
+    configASSERT( pxPool != NULL );
+    configASSERT( pvObjects != NULL );
+    configASSERT( pusNextFree != NULL );
+    configASSERT( xObjectSize > 0U );
+    configASSERT( ( usObjectCount > 0U ) && ( usObjectCount <= objectpoolMAX_OBJECTS ) );
+
+    memset( pxPool, 0x00, sizeof( ObjectPool_t ) );
+    pxPool->pucObjects = ( uint8_t * ) pvObjects;
+    pxPool->xObjectSize = xObjectSize;
+    pxPool->usObjectCount = usObjectCount;
+    pxPool->pusNextFree = pusNextFree;
+    pxPool->pcName = pcName;
+
+    for( usIndex = 0U; usIndex < usObjectCount; usIndex++ )
+    {
+        pusNextFree[ usIndex ] = ( uint16_t ) ( usIndex + 1U );
+    }
+
+    pusNextFree[ usObjectCount - 1U ] = objectpoolEND;
+    pxPool->ulFreeHead = 0UL;
+
+    #if ( objectpoolPOISON == 1 )
+        memset( pvObjects, objectpoolPOISON_BYTE, xObjectSize * usObjectCount );
+    #endif
+
+    if( xBlocking != pdFALSE )
+    {
+        pxPool->xFreeObjects = xSemaphoreCreateCountingStatic( usObjectCount,
+                                                               usObjectCount,
+                                                               &( pxPool->xFreeObjectsBuffer ) );
+        configASSERT( pxPool->xFreeObjects != NULL );
+    }
+}
+/*-----------------------------------------------------------*/
+
+void * pvObjectPoolAcquire( ObjectPool_t * pxPool,
+                            TickType_t xTicksToWait )
+{
+    uint16_t usIndex = objectpoolEND;
+    uint8_t * pucObject = NULL;
+
+    configASSERT( pxPool != NULL );
+    configASSERT( pxPool->pusNextFree != NULL );
+
+    if( pxPool->xFreeObjects != NULL )
+    {
+        if( xSemaphoreTake( pxPool->xFreeObjects, xTicksToWait ) == pdTRUE )
+        {
+            usIndex = prvPopFree( pxPool );
+
+            /* The semaphore counts the free objects, so taking it reserved
+             * one. */
+            configASSERT( usIndex != objectpoolEND );
+        }
+    }
+    else
+    {
+        configASSERT( xTicksToWait == 0U );
+        usIndex = prvPopFree( pxPool );
+    }
+
+    if( usIndex != objectpoolEND )
+    {
+        pxPool->pusNextFree[ usIndex ] = objectpoolACQUIRED;
+        pucObject = &( pxPool->pucObjects[ ( size_t ) usIndex * pxPool->xObjectSize ] );
+
+        #if ( objectpoolPOISON == 1 )
+        {
+            size_t x;
+
+            /* A byte that is not the poison byte was written after the
+             * object was released. */
+            for( x = 0U; x < pxPool->xObjectSize; x++ )
+            {
+                configASSERT( pucObject[ x ] == ( uint8_t ) objectpoolPOISON_BYTE );
+            }
+        }
+        #endif
+
+        prvAtomicMax( &( pxPool->ulPeakInUse ), prvAtomicAdd( &( pxPool->ulInUse ), 1 ) );
+        ( void ) prvAtomicAdd( &( pxPool->ulAcquisitions ), 1 );
+    }
+    else
+    {
+        ( void ) prvAtomicAdd( &( pxPool->ulFailures ), 1 );
+    }
+
+    return ( void * ) pucObject;
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xObjectPoolRelease( ObjectPool_t * pxPool,
+                               void * pvObject )
+{
+    BaseType_t xReturn = pdFAIL;
+    int32_t lIndex;
+
+    configASSERT( pxPool != NULL );
+
+    lIndex = lObjectPoolIndex( pxPool, pvObject );
+
+    /* Claim the object before releasing it, so if it is released twice at
+     * once only one of the releases puts it on the free list. */
+    if( ( lIndex >= 0 ) &&
+        ( prvCompareAndSwap16( &( pxPool->pusNextFree[ lIndex ] ), objectpoolACQUIRED, objectpoolRELEASING ) == pdTRUE ) )
+    {
+        #if ( objectpoolPOISON == 1 )
+            memset( pvObject, objectpoolPOISON_BYTE, pxPool->xObjectSize );
+        #endif
+
+        ( void ) prvAtomicAdd( &( pxPool->ulInUse ), -1 );
+        prvPushFree( pxPool, ( uint16_t ) lIndex );
+
+        if( pxPool->xFreeObjects != NULL )
+        {
+            ( void ) xSemaphoreGive( pxPool->xFreeObjects );
+        }
+
+        xReturn = pdPASS;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+int32_t lObjectPoolIndex( const ObjectPool_t * pxPool,
+                          const void * pvObject )
+{
+    const uint8_t * pucObject = ( const uint8_t * ) pvObject;
+    size_t xOffset;
+    int32_t lIndex = -1;
+
+    configASSERT( pxPool != NULL );
+
+    if( ( pucObject >= pxPool->pucObjects ) &&
+        ( pucObject < &( pxPool->pucObjects[ pxPool->xObjectSize * pxPool->usObjectCount ] ) ) )
+    {
+        xOffset = ( size_t ) ( pucObject - pxPool->pucObjects );
+
+        if( ( xOffset % pxPool->xObjectSize ) == 0U )
+        {
+            lIndex = ( int32_t ) ( xOffset / pxPool->xObjectSize );
+        }
+    }
+
+    return lIndex;
+}
+/*-----------------------------------------------------------*/
+
+void vObjectPoolGetStats( const ObjectPool_t * pxPool,
+                          ObjectPoolStats_t * pxStats )
+{
+    configASSERT( pxPool != NULL );
+    configASSERT( pxStats != NULL );
+
+    pxStats->ulObjectCount = pxPool->usObjectCount;
+    pxStats->ulInUse = pxPool->ulInUse;
+    pxStats->ulPeakInUse = pxPool->ulPeakInUse;
+    pxStats->ulAcquisitions = pxPool->ulAcquisitions;
+    pxStats->ulFailures = pxPool->ulFailures;
+}
@@ -0,0 +1,218 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file object_pool.h
+ *
+ * @brief Fixed size pools of statically allocated objects of one type.
+ *
+ * A pool is declared with objectpoolDEFINE(), which sizes its storage at
+ * compile time, and set up with objectpoolINIT() before it is used.  The free
+ * objects are kept on a list of 16-bit indices held apart from the objects,
+ * so acquiring and releasing an object is O(1) and does not touch the object
+ * itself.  The head of the list is changed with a single compare and swap, so
+ * acquiring from and releasing to a pool that is not blocking takes no lock
+ * and can be done from an interrupt.  A blocking pool also counts its free
+ * objects with a counting semaphore, which tasks wait on when the pool is
+ * empty.
+ *
+ * The head of the list holds a generation count that is incremented by every
+ * change to the list, so a compare and swap made with a stale head fails even
+ * if the same object is back at the head of the list.
+ *
+ * Set objectpoolPOISON to 1 to fill released objects with a known byte and
+ * check that it is intact when they are next acquired, which catches writes
+ * made through a pointer to an object after the object was released.
+ */
+
+#ifndef OBJECT_POOL_H_
+#define OBJECT_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+/**
+ * @brief Set to 1 in FreeRTOSConfig.h to poison released objects.
+ */
+#ifndef objectpoolPOISON
+    #define objectpoolPOISON    0
+#endif
+
+/**
+ * @brief The byte released objects are filled with when objectpoolPOISON is
+ * 1.
+ */
+#ifndef objectpoolPOISON_BYTE
+    #define objectpoolPOISON_BYTE    ( 0xD5U )
+#endif
+
+/**
+ * @brief The largest number of objects in a pool.  The three highest indices
+ * mark the end of the free list, an acquired object and an object being
+ * released.
+ */
+#define objectpoolMAX_OBJECTS    ( 0xFFFDU )
+
+/**
+ * @brief A pool.  Declare with objectpoolDEFINE(), and only access through
+ * the functions below.
+ */
+typedef struct ObjectPool
+{
+    volatile uint32_t ulFreeHead;       /**< Index of the first free object in the low 16 bits, generation in the high 16 bits. */
+    uint16_t * pusNextFree;             /**< Index of the next free object for each free object. */
+    uint8_t * pucObjects;               /**< The objects. */
+    size_t xObjectSize;                 /**< Size of an object, including the padding between objects. */
+    uint16_t usObjectCount;             /**< Number of objects. */
+    const char * pcName;                /**< Name of the pool, for logging. */
+    SemaphoreHandle_t xFreeObjects;     /**< Number of free objects, or NULL if the pool is not blocking. */
+    StaticSemaphore_t xFreeObjectsBuffer;
+    volatile uint32_t ulInUse;          /**< Number of objects acquired. */
+    volatile uint32_t ulPeakInUse;      /**< Highest value of ulInUse. */
+    volatile uint32_t ulAcquisitions;   /**< Number of successful acquisitions. */
+    volatile uint32_t ulFailures;       /**< Number of acquisitions that failed because the pool was empty. */
+} ObjectPool_t;
+
+/**
+ * @brief Usage statistics of a pool.
+ */
+typedef struct ObjectPoolStats
+{
+    uint32_t ulObjectCount;  /**< Number of objects. */
+    uint32_t ulInUse;        /**< Number of objects acquired. */
+    uint32_t ulPeakInUse;    /**< Highest number of objects acquired at once. */
+    uint32_t ulAcquisitions; /**< Number of successful acquisitions. */
+    uint32_t ulFailures;     /**< Number of acquisitions that failed because the pool was empty. */
+} ObjectPoolStats_t;
+
+/**
+ * @brief Declare a pool of uxCount objects of type xType, and its storage.
+ * Use at file scope, for example:
+ *
+ * objectpoolDEFINE( xMessagePool, Message_t, 8 );
+ *
+ * The declaration does not compile if uxCount is 0 or above
+ * objectpoolMAX_OBJECTS.
+ */
+#define objectpoolDEFINE( xPool, xType, uxCount )                                                               \
+    typedef char xPool ## SizeCheck_t[ ( ( ( uxCount ) > 0U ) && ( ( uxCount ) <= objectpoolMAX_OBJECTS ) ) ? 1 : -1 ]; \
+    static xType xPool ## Objects[ uxCount ];                                                                   \
+    static uint16_t xPool ## NextFree[ uxCount ];                                                               \
+    static ObjectPool_t xPool
+
+/**
+ * @brief Initialise a pool declared with objectpoolDEFINE(), putting every
+ * object on the free list.  Not thread safe - call before the pool is used.
+ *
+ * @param[in] xPool The name the pool was declared with.
+ * @param[in] pcName The name of the pool, for logging.
+ * @param[in] xBlocking pdTRUE if tasks can wait for an object to be released
+ * when the pool is empty, otherwise pdFALSE.
+ */
+#define objectpoolINIT( xPool, pcName, xBlocking )                                                         \
+    vObjectPoolInit( &( xPool ),                                                                           \
+                     ( void * ) ( xPool ## Objects ),                                                      \
+                     sizeof( ( xPool ## Objects )[ 0 ] ),                                                  \
+                     ( uint16_t ) ( sizeof( xPool ## Objects ) / sizeof( ( xPool ## Objects )[ 0 ] ) ),    \
+                     ( xPool ## NextFree ),                                                                \
+                     ( pcName ),                                                                           \
+                     ( xBlocking ) )
+
+/**
+ * @brief Initialise a pool.  Use objectpoolINIT() rather than calling this
+ * directly.
+ *
+ * @param[in] pxPool The pool.
+ * @param[in] pvObjects Storage for the objects.
+ * @param[in] xObjectSize Size of an object, including the padding between
+ * objects.
+ * @param[in] usObjectCount Number of objects.
+ * @param[in] pusNextFree Storage for usObjectCount indices.
+ * @param[in] pcName The name of the pool, for logging.
+ * @param[in] xBlocking pdTRUE if tasks can wait for an object.
+ */
+void vObjectPoolInit( ObjectPool_t * pxPool,
+                      void * pvObjects,
+                      size_t xObjectSize,
+                      uint16_t usObjectCount,
+                      uint16_t * pusNextFree,
+                      const char * pcName,
+                      BaseType_t xBlocking );
+
+/**
+ * @brief Take an object from a pool.
+ *
+ * The object holds whatever it held when it was released, or the poison byte
+ * if objectpoolPOISON is 1, so must be initialised by the caller.
+ *
+ * @param[in] pxPool The pool.
+ * @param[in] xTicksToWait The time to wait for an object to be released if
+ * the pool is empty.  Must be 0 if the pool is not blocking.
+ *
+ * @return The object, or NULL if none was free before xTicksToWait expired.
+ */
+void * pvObjectPoolAcquire( ObjectPool_t * pxPool,
+                            TickType_t xTicksToWait );
+
+/**
+ * @brief Return an object to its pool.
+ *
+ * @param[in] pxPool The pool.
+ * @param[in] pvObject The object.
+ *
+ * @return pdPASS if the object was returned.  pdFAIL, without changing the
+ * pool, if pvObject is not an object of the pool or is not acquired.
+ */
+BaseType_t xObjectPoolRelease( ObjectPool_t * pxPool,
+                               void * pvObject );
+
+/**
+ * @brief Get the index of an object in its pool.
+ *
+ * @param[in] pxPool The pool.
+ * @param[in] pvObject The object.
+ *
+ * @return The index of the object, or -1 if pvObject is not an object of the
+ * pool.
+ */
+int32_t lObjectPoolIndex( const ObjectPool_t * pxPool,
+                          const void * pvObject );
+
+/**
+ * @brief Get the usage statistics of a pool.
+ *
+ * @param[in] pxPool The pool.
+ * @param[out] pxStats The statistics.
+ */
+void vObjectPoolGetStats( const ObjectPool_t * pxPool,
+                          ObjectPoolStats_t * pxStats );
+
+#endif /* OBJECT_POOL_H_ */
@@ -0,0 +1,648 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_cache.c
+ *
+ * @brief Implementation of the local shadow state cache.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Interface include. */
+#include "shadow_cache.h"
+
+/**
+ * @brief Parts of a reported state update.  Properties are written between
+ * the start and the token start, and the client token between the token
+ * start and the end.
+ */
+#define shadowcacheUPDATE_START          "{\"state\":{\"reported\":{"
+#define shadowcacheUPDATE_TOKEN_START    "}},\"clientToken\":\""
+#define shadowcacheUPDATE_END            "\"}"
+
+/**
+ * @brief Minimum number of digits in the client token.  Shorter tokens are
+ * padded with leading zeros.
+ */
+#define shadowcacheTOKEN_MIN_DIGITS      ( 6U )
+
+/**
+ * @brief Key of the version in delta documents.
+ */
+#define shadowcacheVERSION_KEY     "version"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the properties whose local value differs from the last accepted
+ * reported value, or whose reported value is unknown.
+ *
+ * Must be called from within a critical section.
+ *
+ * @param[in] pxCache The cache.
+ *
+ * @return Bit i is set if property i differs.
+ */
+static uint32_t prvGetChangedMask( const ShadowCache_t * pxCache );
+
+/**
+ * @brief Write the properties of the update waiting for a response into a
+ * buffer.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] ulClientToken Client token placed in the update.
+ * @param[out] pcBuffer Buffer to write the update into.
+ * @param[in] xBufferLength Length of pcBuffer.
+ * @param[out] pxOutLength Length of the update.
+ *
+ * @return true if the update fits in the buffer; false otherwise.
+ */
+static bool prvSerializeUpdate( const ShadowCache_t * pxCache,
+                                uint32_t ulClientToken,
+                                char * pcBuffer,
+                                size_t xBufferLength,
+                                size_t * pxOutLength );
+
+/**
+ * @brief Append characters to a buffer.
+ *
+ * @param[out] pcBuffer The buffer.
+ * @param[in] xBufferLength Length of pcBuffer.
+ * @param[in,out] pxOffset Offset at which to write, advanced past the
+ * characters written.
+ * @param[in] pcCharacters The characters to append.
+ * @param[in] xLength Number of characters to append.
+ *
+ * @return true if the characters fit in the buffer; false otherwise.
+ */
+static bool prvAppend( char * pcBuffer,
+                       size_t xBufferLength,
+                       size_t * pxOffset,
+                       const char * pcCharacters,
+                       size_t xLength );
+
+/**
+ * @brief Append the decimal representation of a number to a buffer.
+ *
+ * @param[out] pcBuffer The buffer.
+ * @param[in] xBufferLength Length of pcBuffer.
+ * @param[in,out] pxOffset Offset at which to write, advanced past the
+ * characters written.
+ * @param[in] ulValue The number.
+ * @param[in] xMinDigits Minimum number of digits, padded with leading zeros.
+ *
+ * @return true if the number fits in the buffer; false otherwise.
+ */
+static bool prvAppendDecimal( char * pcBuffer,
+                              size_t xBufferLength,
+                              size_t * pxOffset,
+                              uint32_t ulValue,
+                              size_t xMinDigits );
+
+/**
+ * @brief Record that a local change is waiting to be reported, opening the
+ * coalescing window if none is open.
+ *
+ * Must be called from within a critical section.
+ *
+ * @param[in] pxCache The cache.
+ */
+static void prvMarkChangePending( ShadowCache_t * pxCache );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvGetChangedMask( const ShadowCache_t * pxCache )
+{
+    uint32_t ulChangedMask = 0U;
+    size_t i;
+
+    for( i = 0; i < pxCache->xPropertyCount; i++ )
+    {
+        if( ( ( pxCache->ulAcknowledgedMask & ( 1UL << i ) ) == 0U ) ||
+            ( pxCache->pulLocal[ i ] != pxCache->pulAcknowledged[ i ] ) )
+        {
+            ulChangedMask |= ( 1UL << i );
+        }
+    }
+
+    return ulChangedMask;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvAppend( char * pcBuffer,
+                       size_t xBufferLength,
+                       size_t * pxOffset,
+                       const char * pcCharacters,
+                       size_t xLength )
+{
+    bool xStatus = false;
+
+    if( ( xBufferLength - *pxOffset ) >= xLength )
+    {
+        ( void ) memcpy( &( pcBuffer[ *pxOffset ] ), pcCharacters, xLength );
+        *pxOffset += xLength;
+        xStatus = true;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvAppendDecimal( char * pcBuffer,
+                              size_t xBufferLength,
+                              size_t * pxOffset,
+                              uint32_t ulValue,
+                              size_t xMinDigits )
+{
+    /* Large enough for the 10 digits of UINT32_MAX. */
+    char cDigits[ 10 ];
+    size_t xDigitCount = 0U;
+
+    /* Write the digits from the least significant end of cDigits. */
+    do
+    {
+        xDigitCount++;
+        cDigits[ sizeof( cDigits ) - xDigitCount ] = ( char ) ( '0' + ( ulValue % 10U ) );
+        ulValue /= 10U;
+    } while( ( ulValue != 0U ) ||
+             ( ( xDigitCount < xMinDigits ) && ( xDigitCount < sizeof( cDigits ) ) ) );
+
+    return prvAppend( pcBuffer,
+                      xBufferLength,
+                      pxOffset,
+                      &( cDigits[ sizeof( cDigits ) - xDigitCount ] ),
+                      xDigitCount );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSerializeUpdate( const ShadowCache_t * pxCache,
+                                uint32_t ulClientToken,
+                                char * pcBuffer,
+                                size_t xBufferLength,
+                                size_t * pxOutLength )
+{
+    bool xStatus;
+    bool xFirstProperty = true;
+    size_t i, xOffset = 0U;
+
+    /* The update is assembled from constant fragments and the property values
+     * so that no format string is parsed while it is built. */
+    xStatus = prvAppend( pcBuffer, xBufferLength, &xOffset,
+                         shadowcacheUPDATE_START, sizeof( shadowcacheUPDATE_START ) - 1U );
+
+    for( i = 0; ( ( i < pxCache->xPropertyCount ) && ( xStatus == true ) ); i++ )
+    {
+        if( ( pxCache->ulInFlightMask & ( 1UL << i ) ) != 0U )
+        {
+            if( xFirstProperty == false )
+            {
+                xStatus = prvAppend( pcBuffer, xBufferLength, &xOffset, ",", 1U );
+            }
+
+            xStatus = xStatus &&
+                      prvAppend( pcBuffer, xBufferLength, &xOffset, "\"", 1U ) &&
+                      prvAppend( pcBuffer, xBufferLength, &xOffset,
+                                 pxCache->pxProperties[ i ].pcName,
+                                 pxCache->pxProperties[ i ].xNameLength ) &&
+                      prvAppend( pcBuffer, xBufferLength, &xOffset, "\":", 2U ) &&
+                      prvAppendDecimal( pcBuffer, xBufferLength, &xOffset, pxCache->pulInFlight[ i ], 1U );
+            xFirstProperty = false;
+        }
+    }
+
+    xStatus = xStatus &&
+              prvAppend( pcBuffer, xBufferLength, &xOffset,
+                         shadowcacheUPDATE_TOKEN_START, sizeof( shadowcacheUPDATE_TOKEN_START ) - 1U ) &&
+              prvAppendDecimal( pcBuffer, xBufferLength, &xOffset, ulClientToken, shadowcacheTOKEN_MIN_DIGITS ) &&
+              prvAppend( pcBuffer, xBufferLength, &xOffset,
+                         shadowcacheUPDATE_END, sizeof( shadowcacheUPDATE_END ) - 1U );
+
+    /* Keep the update NULL terminated for logging, as snprintf() did. */
+    xStatus = xStatus && ( xOffset < xBufferLength );
+
+    if( xStatus == true )
+    {
+        pcBuffer[ xOffset ] = '\0';
+        *pxOutLength = xOffset;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvMarkChangePending( ShadowCache_t * pxCache )
+{
+    if( pxCache->xChangePending == false )
+    {
+        pxCache->xChangePending = true;
+        pxCache->xFirstChangeTime = xTaskGetTickCount();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowCacheStatus eShadowCacheInit( ShadowCache_t * pxCache,
+                                     const ShadowCacheProperty_t * pxProperties,
+                                     size_t xPropertyCount,
+                                     uint32_t ulCoalescingWindowMs )
+{
+    eShadowCacheStatus eStatus = eShadowCacheSuccess;
+
+    if( ( pxCache == NULL ) || ( pxProperties == NULL ) ||
+        ( xPropertyCount == 0U ) || ( xPropertyCount > shadowcacheMAX_PROPERTIES ) )
+    {
+        eStatus = eShadowCacheBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pxCache, 0x00, sizeof( ShadowCache_t ) );
+        pxCache->pxProperties = pxProperties;
+        pxCache->xPropertyCount = xPropertyCount;
+        pxCache->xCoalescingTicks = pdMS_TO_TICKS( ulCoalescingWindowMs );
+
+        /* The reported state is unknown, so report every property as soon as
+         * possible. */
+        pxCache->xChangePending = true;
+        pxCache->xFirstChangeTime = xTaskGetTickCount() - pxCache->xCoalescingTicks;
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+void vShadowCacheSetLocal( ShadowCache_t * pxCache,
+                           size_t xProperty,
+                           uint32_t ulValue )
+{
+    configASSERT( pxCache != NULL );
+    configASSERT( xProperty < pxCache->xPropertyCount );
+
+    taskENTER_CRITICAL();
+    {
+        if( pxCache->pulLocal[ xProperty ] != ulValue )
+        {
+            pxCache->pulLocal[ xProperty ] = ulValue;
+            prvMarkChangePending( pxCache );
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulShadowCacheGetLocal( ShadowCache_t * pxCache,
+                                size_t xProperty )
+{
+    configASSERT( pxCache != NULL );
+    configASSERT( xProperty < pxCache->xPropertyCount );
+
+    return pxCache->pulLocal[ xProperty ];
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowCacheStatus eShadowCacheApplyDelta( ShadowCache_t * pxCache,
+                                           const char * pcDocument,
+                                           size_t xDocumentLength,
+                                           uint32_t * pulChangedMask )
+{
+    eShadowCacheStatus eStatus = eShadowCacheSuccess;
+    JsonExtractorKey_t xKeys[ shadowcacheMAX_PROPERTIES + 1U ];
+    uint32_t ulVersion = 0U, ulPresentMask = 0U;
+    uint32_t pulValues[ shadowcacheMAX_PROPERTIES ];
+    size_t i;
+
+    if( ( pxCache == NULL ) || ( pcDocument == NULL ) || ( pulChangedMask == NULL ) )
+    {
+        eStatus = eShadowCacheBadParameter;
+    }
+    else
+    {
+        /* Extract the version and every property in one pass over the
+         * delta. */
+        xKeys[ 0 ].pcKeyPath = shadowcacheVERSION_KEY;
+        xKeys[ 0 ].xKeyPathLength = sizeof( shadowcacheVERSION_KEY ) - 1U;
+
+        for( i = 0; i < pxCache->xPropertyCount; i++ )
+        {
+            xKeys[ i + 1U ].pcKeyPath = pxCache->pxProperties[ i ].pcDeltaPath;
+            xKeys[ i + 1U ].xKeyPathLength = pxCache->pxProperties[ i ].xDeltaPathLength;
+        }
+
+        if( ( eJsonExtract( pcDocument, xDocumentLength, xKeys, pxCache->xPropertyCount + 1U ) != eJsonExtractorSuccess ) ||
+            ( xKeys[ 0 ].eValueType != JsonExtractorValueNumber ) ||
+            ( xJsonExtractorGetUint32( &( xKeys[ 0 ] ), &ulVersion ) == false ) )
+        {
+            eStatus = eShadowCacheInvalidDocument;
+        }
+    }
+
+    if( eStatus == eShadowCacheSuccess )
+    {
+        for( i = 0; i < pxCache->xPropertyCount; i++ )
+        {
+            /* Properties that are not in the delta, or have a type the cache
+             * does not hold, are left out of the mask. */
+            if( xJsonExtractorGetUint32( &( xKeys[ i + 1U ] ), &( pulValues[ i ] ) ) == true )
+            {
+                ulPresentMask |= ( 1UL << i );
+            }
+        }
+
+        eStatus = eShadowCacheApplyDesired( pxCache, ulVersion, pulValues, ulPresentMask, pulChangedMask );
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowCacheStatus eShadowCacheApplyDesired( ShadowCache_t * pxCache,
+                                             uint32_t ulVersion,
+                                             const uint32_t * pulValues,
+                                             uint32_t ulPresentMask,
+                                             uint32_t * pulChangedMask )
+{
+    eShadowCacheStatus eStatus = eShadowCacheSuccess;
+    size_t i;
+
+    if( ( pxCache == NULL ) || ( pulValues == NULL ) || ( pulChangedMask == NULL ) )
+    {
+        eStatus = eShadowCacheBadParameter;
+    }
+    else
+    {
+        ulPresentMask &= ( uint32_t ) ( ( 1ULL << pxCache->xPropertyCount ) - 1U );
+
+        taskENTER_CRITICAL();
+        {
+            /* Deltas can arrive out of order, so only apply ones newer than
+             * the latest version seen. */
+            if( ulVersion <= pxCache->ulVersion )
+            {
+                eStatus = eShadowCacheStaleVersion;
+                ulPresentMask = 0U;
+            }
+            else
+            {
+                pxCache->ulVersion = ulVersion;
+
+                for( i = 0; i < pxCache->xPropertyCount; i++ )
+                {
+                    if( ( ulPresentMask & ( 1UL << i ) ) != 0U )
+                    {
+                        pxCache->pulDesired[ i ] = pulValues[ i ];
+                    }
+                }
+
+                pxCache->ulDesiredMask |= ulPresentMask;
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        *pulChangedMask = ulPresentMask;
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+bool xShadowCacheTakeDesired( ShadowCache_t * pxCache,
+                              size_t xProperty,
+                              uint32_t * pulValue )
+{
+    bool xDesiredWaiting = false;
+
+    configASSERT( pxCache != NULL );
+    configASSERT( xProperty < pxCache->xPropertyCount );
+    configASSERT( pulValue != NULL );
+
+    taskENTER_CRITICAL();
+    {
+        if( ( pxCache->ulDesiredMask & ( 1UL << xProperty ) ) != 0U )
+        {
+            pxCache->ulDesiredMask &= ~( 1UL << xProperty );
+            *pulValue = pxCache->pulDesired[ xProperty ];
+            xDesiredWaiting = true;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xDesiredWaiting;
+}
+
+/*-----------------------------------------------------------*/
+
+TickType_t xShadowCacheGetTicksUntilUpdate( ShadowCache_t * pxCache )
+{
+    TickType_t xTicksUntilUpdate = portMAX_DELAY, xElapsed;
+
+    configASSERT( pxCache != NULL );
+
+    taskENTER_CRITICAL();
+    {
+        if( ( pxCache->xChangePending == true ) && ( pxCache->ulInFlightMask == 0U ) )
+        {
+            xElapsed = xTaskGetTickCount() - pxCache->xFirstChangeTime;
+            xTicksUntilUpdate = ( xElapsed >= pxCache->xCoalescingTicks ) ? 0U : ( pxCache->xCoalescingTicks - xElapsed );
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return xTicksUntilUpdate;
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowCacheStatus eShadowCacheBuildUpdate( ShadowCache_t * pxCache,
+                                            uint32_t ulClientToken,
+                                            char * pcBuffer,
+                                            size_t xBufferLength,
+                                            size_t * pxOutLength )
+{
+    eShadowCacheStatus eStatus = eShadowCacheSuccess;
+    uint32_t ulChangedMask;
+    size_t i;
+
+    if( ( pxCache == NULL ) || ( pcBuffer == NULL ) || ( xBufferLength == 0U ) || ( pxOutLength == NULL ) )
+    {
+        eStatus = eShadowCacheBadParameter;
+    }
+    else
+    {
+        taskENTER_CRITICAL();
+        {
+            if( pxCache->ulInFlightMask != 0U )
+            {
+                eStatus = eShadowCacheUpdateInFlight;
+            }
+            else if( ( pxCache->xChangePending == false ) ||
+                     ( ( xTaskGetTickCount() - pxCache->xFirstChangeTime ) < pxCache->xCoalescingTicks ) )
+            {
+                eStatus = eShadowCacheNoUpdate;
+            }
+            else
+            {
+                /* Close the coalescing window and take a copy of the values to
+                 * report, so they can be marked as accepted even if the local
+                 * values change again before the response arrives. */
+                pxCache->xChangePending = false;
+                ulChangedMask = prvGetChangedMask( pxCache );
+
+                if( ulChangedMask == 0U )
+                {
+                    /* The changes in the window were reverted, so reporting
+                     * them would not change the reported state. */
+                    pxCache->ulSuppressedUpdates++;
+                    eStatus = eShadowCacheNoUpdate;
+                }
+                else
+                {
+                    for( i = 0; i < pxCache->xPropertyCount; i++ )
+                    {
+                        pxCache->pulInFlight[ i ] = pxCache->pulLocal[ i ];
+                    }
+
+                    pxCache->ulInFlightMask = ulChangedMask;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    /* The update is written outside of the critical section.  Only this
+     * function writes the in flight values, and the mask cannot be cleared
+     * before the update is published. */
+    if( eStatus == eShadowCacheSuccess )
+    {
+        if( prvSerializeUpdate( pxCache, ulClientToken, pcBuffer, xBufferLength, pxOutLength ) == false )
+        {
+            /* Reopen the window that was closed above without restarting it,
+             * so a larger buffer can be used straight away. */
+            taskENTER_CRITICAL();
+            {
+                pxCache->ulInFlightMask = 0U;
+                pxCache->xChangePending = true;
+            }
+            taskEXIT_CRITICAL();
+
+            eStatus = eShadowCacheBufferTooSmall;
+        }
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+bool xShadowCacheIsUpdateInFlight( ShadowCache_t * pxCache )
+{
+    configASSERT( pxCache != NULL );
+
+    return( pxCache->ulInFlightMask != 0U );
+}
+
+/*-----------------------------------------------------------*/
+
+void vShadowCacheUpdateAccepted( ShadowCache_t * pxCache,
+                                 uint32_t ulVersion )
+{
+    size_t i;
+
+    configASSERT( pxCache != NULL );
+
+    taskENTER_CRITICAL();
+    {
+        for( i = 0; i < pxCache->xPropertyCount; i++ )
+        {
+            if( ( pxCache->ulInFlightMask & ( 1UL << i ) ) != 0U )
+            {
+                pxCache->pulAcknowledged[ i ] = pxCache->pulInFlight[ i ];
+            }
+        }
+
+        pxCache->ulAcknowledgedMask |= pxCache->ulInFlightMask;
+        pxCache->ulInFlightMask = 0U;
+
+        if( ulVersion > pxCache->ulVersion )
+        {
+            pxCache->ulVersion = ulVersion;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+void vShadowCacheUpdateRejected( ShadowCache_t * pxCache )
+{
+    configASSERT( pxCache != NULL );
+
+    /* The acknowledged values are unchanged, so the properties still differ
+     * and are included in the update built after the next local change. */
+    taskENTER_CRITICAL();
+    {
+        pxCache->ulInFlightMask = 0U;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+void vShadowCacheUpdateTimedOut( ShadowCache_t * pxCache )
+{
+    configASSERT( pxCache != NULL );
+
+    taskENTER_CRITICAL();
+    {
+        pxCache->ulAcknowledgedMask &= ~( pxCache->ulInFlightMask );
+        pxCache->ulInFlightMask = 0U;
+        prvMarkChangePending( pxCache );
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulShadowCacheGetSuppressedUpdates( ShadowCache_t * pxCache )
+{
+    configASSERT( pxCache != NULL );
+
+    return pxCache->ulSuppressedUpdates;
+}
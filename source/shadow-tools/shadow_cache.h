@@ -0,0 +1,319 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_cache.h
+ *
+ * @brief Local copy of the desired and reported state of a device shadow.
+ *
+ * The cache holds the device's current value of each property, the desired
+ * value last received in a delta, the reported value last accepted by the
+ * Device Shadow service and the shadow version.  Local changes are coalesced:
+ * an update is only built once the first unreported change is older than the
+ * coalescing window, and it contains only the properties whose value differs
+ * from the last accepted reported state.  Changes that are reverted before the
+ * window closes therefore produce no update at all.
+ *
+ * Property values are unsigned 32-bit integers.  Only one update can be
+ * waiting for a response at a time.
+ */
+
+#ifndef SHADOW_CACHE_H_
+#define SHADOW_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/* JSON extractor include, for the maximum number of keys in a delta. */
+#include "json_extractor.h"
+
+/**
+ * @brief Maximum number of properties in a cache.  A delta is parsed in one
+ * pass for the version and every property, so this must be smaller than
+ * #jsonextractorMAX_KEYS.  Can be overridden in demo_config.h.
+ */
+#ifndef shadowcacheMAX_PROPERTIES
+    #define shadowcacheMAX_PROPERTIES    ( jsonextractorMAX_KEYS - 1U )
+#endif
+
+#if ( shadowcacheMAX_PROPERTIES >= jsonextractorMAX_KEYS ) || ( shadowcacheMAX_PROPERTIES > 32U )
+    #error "shadowcacheMAX_PROPERTIES must be smaller than jsonextractorMAX_KEYS and at most 32."
+#endif
+
+/**
+ * @brief Return codes from shadow cache APIs.
+ */
+typedef enum
+{
+    eShadowCacheSuccess = 0,
+    eShadowCacheBadParameter,
+    eShadowCacheNoUpdate,
+    eShadowCacheUpdateInFlight,
+    eShadowCacheBufferTooSmall,
+    eShadowCacheInvalidDocument,
+    eShadowCacheStaleVersion
+} eShadowCacheStatus;
+
+/**
+ * @brief Description of a property held in the cache.
+ */
+typedef struct ShadowCacheProperty
+{
+    const char * pcName;      /**< Name of the property in the state document. */
+    size_t xNameLength;       /**< Length of pcName. */
+    const char * pcDeltaPath; /**< Path of the property in a delta document. */
+    size_t xDeltaPathLength;  /**< Length of pcDeltaPath. */
+} ShadowCacheProperty_t;
+
+/**
+ * @brief Initializer for a #ShadowCacheProperty_t whose name is a string
+ * literal.
+ */
+#define shadowcachePROPERTY( pcNameLiteral )                 \
+    { ( pcNameLiteral ), sizeof( pcNameLiteral ) - 1U,       \
+      "state." pcNameLiteral, sizeof( "state." pcNameLiteral ) - 1U }
+
+/**
+ * @brief State of a shadow cache.  Fields are private to shadow_cache.c and
+ * are exposed only so the structure can be allocated statically.
+ */
+typedef struct ShadowCache
+{
+    const ShadowCacheProperty_t * pxProperties;
+    size_t xPropertyCount;
+    TickType_t xCoalescingTicks;
+    uint32_t pulLocal[ shadowcacheMAX_PROPERTIES ];
+    uint32_t pulDesired[ shadowcacheMAX_PROPERTIES ];
+    uint32_t pulAcknowledged[ shadowcacheMAX_PROPERTIES ];
+    uint32_t pulInFlight[ shadowcacheMAX_PROPERTIES ];
+    uint32_t ulDesiredMask;
+    uint32_t ulAcknowledgedMask;
+    uint32_t ulInFlightMask;
+    uint32_t ulVersion;
+    uint32_t ulSuppressedUpdates;
+    TickType_t xFirstChangeTime;
+    bool xChangePending;
+} ShadowCache_t;
+
+/**
+ * @brief Initialize a cache.
+ *
+ * All local values start at 0 and the reported state is unknown, so the first
+ * update reports every property.
+ *
+ * @param[out] pxCache The cache to initialize.
+ * @param[in] pxProperties The properties held in the cache.  Must remain valid
+ * while the cache is used.
+ * @param[in] xPropertyCount Number of entries in pxProperties, at most
+ * #shadowcacheMAX_PROPERTIES.
+ * @param[in] ulCoalescingWindowMs Time in milliseconds local changes are
+ * collected before an update is built.
+ *
+ * @return #eShadowCacheSuccess or #eShadowCacheBadParameter.
+ */
+eShadowCacheStatus eShadowCacheInit( ShadowCache_t * pxCache,
+                                     const ShadowCacheProperty_t * pxProperties,
+                                     size_t xPropertyCount,
+                                     uint32_t ulCoalescingWindowMs );
+
+/**
+ * @brief Set the device's current value of a property.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] xProperty Index of the property in the property list.
+ * @param[in] ulValue The new value.
+ */
+void vShadowCacheSetLocal( ShadowCache_t * pxCache,
+                           size_t xProperty,
+                           uint32_t ulValue );
+
+/**
+ * @brief Get the device's current value of a property.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] xProperty Index of the property in the property list.
+ *
+ * @return The value.
+ */
+uint32_t ulShadowCacheGetLocal( ShadowCache_t * pxCache,
+                                size_t xProperty );
+
+/**
+ * @brief Record the desired values in a delta document.
+ *
+ * Properties whose value is a number, true or false are recorded; true is
+ * recorded as 1 and false as 0.  Other properties in the delta are ignored.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] pcDocument The delta document.
+ * @param[in] xDocumentLength Length of pcDocument.
+ * @param[out] pulChangedMask Bit i is set if a desired value of property i
+ * was recorded.
+ *
+ * @return #eShadowCacheSuccess if the delta is recorded;
+ * #eShadowCacheBadParameter if invalid parameters are passed;
+ * #eShadowCacheInvalidDocument if the document is not valid JSON or has no
+ * version;
+ * #eShadowCacheStaleVersion if the version is not newer than the last one
+ * received.
+ */
+eShadowCacheStatus eShadowCacheApplyDelta( ShadowCache_t * pxCache,
+                                           const char * pcDocument,
+                                           size_t xDocumentLength,
+                                           uint32_t * pulChangedMask );
+
+/**
+ * @brief Record desired values already parsed from a delta document.
+ *
+ * Used when the delta is parsed by a caller that knows the shadow schema,
+ * so the document does not have to be scanned a second time.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] ulVersion Version of the delta document.
+ * @param[in] pulValues Desired values, indexed by property.
+ * @param[in] ulPresentMask Bit i is set if pulValues[ i ] is present in the
+ * delta.
+ * @param[out] pulChangedMask Bit i is set if a desired value of property i
+ * was recorded.
+ *
+ * @return #eShadowCacheSuccess if the values are recorded;
+ * #eShadowCacheBadParameter if invalid parameters are passed;
+ * #eShadowCacheStaleVersion if the version is not newer than the last one
+ * received.
+ */
+eShadowCacheStatus eShadowCacheApplyDesired( ShadowCache_t * pxCache,
+                                             uint32_t ulVersion,
+                                             const uint32_t * pulValues,
+                                             uint32_t ulPresentMask,
+                                             uint32_t * pulChangedMask );
+
+/**
+ * @brief Take the desired value of a property recorded from a delta and not
+ * yet taken.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] xProperty Index of the property in the property list.
+ * @param[out] pulValue The desired value.
+ *
+ * @return true if a desired value was waiting; false otherwise.
+ */
+bool xShadowCacheTakeDesired( ShadowCache_t * pxCache,
+                              size_t xProperty,
+                              uint32_t * pulValue );
+
+/**
+ * @brief Get the time until an update for the pending local changes can be
+ * built.
+ *
+ * @param[in] pxCache The cache.
+ *
+ * @return 0 if an update can be built now; portMAX_DELAY if no change is
+ * pending or an update is waiting for a response; otherwise the number of
+ * ticks left in the coalescing window.
+ */
+TickType_t xShadowCacheGetTicksUntilUpdate( ShadowCache_t * pxCache );
+
+/**
+ * @brief Build a reported state update for the pending local changes.
+ *
+ * The update contains only the properties whose local value differs from the
+ * last accepted reported value.  It is recorded as waiting for a response
+ * until one of vShadowCacheUpdateAccepted(), vShadowCacheUpdateRejected() or
+ * vShadowCacheUpdateTimedOut() is called.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] ulClientToken Client token placed in the update.
+ * @param[out] pcBuffer Buffer to write the update into.
+ * @param[in] xBufferLength Length of pcBuffer.
+ * @param[out] pxOutLength Length of the update, excluding the terminating
+ * NULL.
+ *
+ * @return #eShadowCacheSuccess if an update is built;
+ * #eShadowCacheBadParameter if invalid parameters are passed;
+ * #eShadowCacheNoUpdate if no change is pending, the coalescing window is
+ * still open or the pending changes leave the reported state unchanged;
+ * #eShadowCacheUpdateInFlight if the previous update has had no response;
+ * #eShadowCacheBufferTooSmall if the update does not fit in pcBuffer.
+ */
+eShadowCacheStatus eShadowCacheBuildUpdate( ShadowCache_t * pxCache,
+                                            uint32_t ulClientToken,
+                                            char * pcBuffer,
+                                            size_t xBufferLength,
+                                            size_t * pxOutLength );
+
+/**
+ * @brief Check whether an update is waiting for a response.
+ *
+ * @param[in] pxCache The cache.
+ *
+ * @return true if an update is waiting for a response; false otherwise.
+ */
+bool xShadowCacheIsUpdateInFlight( ShadowCache_t * pxCache );
+
+/**
+ * @brief Record that the update waiting for a response was accepted.
+ *
+ * @param[in] pxCache The cache.
+ * @param[in] ulVersion Shadow version in the accepted response, or 0 if the
+ * response has none.
+ */
+void vShadowCacheUpdateAccepted( ShadowCache_t * pxCache,
+                                 uint32_t ulVersion );
+
+/**
+ * @brief Record that the update waiting for a response was rejected.  The
+ * properties in it are reported again with the next local change.
+ *
+ * @param[in] pxCache The cache.
+ */
+void vShadowCacheUpdateRejected( ShadowCache_t * pxCache );
+
+/**
+ * @brief Record that no response was received for the update waiting for a
+ * response.  As the update may still have been applied, the reported state of
+ * the properties in it becomes unknown and they are reported again once the
+ * coalescing window closes.
+ *
+ * @param[in] pxCache The cache.
+ */
+void vShadowCacheUpdateTimedOut( ShadowCache_t * pxCache );
+
+/**
+ * @brief Get the number of updates that were not built because the pending
+ * local changes left the reported state unchanged.
+ *
+ * @param[in] pxCache The cache.
+ *
+ * @return The number of suppressed updates.
+ */
+uint32_t ulShadowCacheGetSuppressedUpdates( ShadowCache_t * pxCache );
+
+#endif /* SHADOW_CACHE_H_ */
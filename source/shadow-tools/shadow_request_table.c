@@ -0,0 +1,414 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_request_table.c
+ *
+ * @brief Implementation of the table of outstanding Device Shadow requests.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* JSON extractor include. */
+#include "json_extractor.h"
+
+/* Interface include. */
+#include "shadow_request_table.h"
+
+/**
+ * @brief Layout of a client token.  The low four bits hold the slot of the
+ * request, the next four the table identifier, and the rest a sequence number
+ * that changes every time a slot is reused.
+ */
+#define shadowrequestSLOT_MASK              ( 0x0FUL )
+#define shadowrequestTABLE_ID_SHIFT         ( 4U )
+#define shadowrequestTABLE_ID_MASK          ( 0xF0UL )
+#define shadowrequestSEQUENCE_SHIFT         ( 8U )
+#define shadowrequestSEQUENCE_MASK          ( 0x00FFFFFFUL )
+
+/**
+ * @brief Maximum number of characters in a client token.
+ */
+#define shadowrequestMAX_TOKEN_LENGTH       ( 10U )
+
+/**
+ * @brief Keys extracted from responses.
+ */
+#define shadowrequestCLIENT_TOKEN_KEY       "clientToken"
+#define shadowrequestVERSION_KEY            "version"
+#define shadowrequestCODE_KEY               "code"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Parse a client token received in a response.
+ *
+ * @param[in] pcToken The token, without quotes.
+ * @param[in] xTokenLength Length of pcToken.
+ * @param[out] pulOutClientToken The token.
+ *
+ * @return true if the token is a number that fits in 32 bits; false
+ * otherwise.
+ */
+static bool prvParseClientToken( const char * pcToken,
+                                 size_t xTokenLength,
+                                 uint32_t * pulOutClientToken );
+
+/**
+ * @brief Remove a request from the table and take a copy of it.
+ *
+ * Must be called from within a critical section.
+ *
+ * @param[in] pxTable The table.
+ * @param[in] ulClientToken The client token of the request.
+ * @param[out] pxOutRequest The removed request.  Can be NULL.
+ *
+ * @return true if the request is outstanding; false otherwise.
+ */
+static bool prvRemoveRequest( ShadowRequestTable_t * pxTable,
+                              uint32_t ulClientToken,
+                              ShadowRequest_t * pxOutRequest );
+
+/*-----------------------------------------------------------*/
+
+static bool prvParseClientToken( const char * pcToken,
+                                 size_t xTokenLength,
+                                 uint32_t * pulOutClientToken )
+{
+    bool xStatus = ( xTokenLength > 0U ) && ( xTokenLength <= shadowrequestMAX_TOKEN_LENGTH );
+    uint64_t ullToken = 0U;
+    size_t i;
+
+    for( i = 0; ( xStatus == true ) && ( i < xTokenLength ); i++ )
+    {
+        if( ( pcToken[ i ] < '0' ) || ( pcToken[ i ] > '9' ) )
+        {
+            xStatus = false;
+        }
+        else
+        {
+            ullToken = ( ullToken * 10U ) + ( uint64_t ) ( pcToken[ i ] - '0' );
+        }
+    }
+
+    if( ( xStatus == true ) && ( ullToken <= UINT32_MAX ) )
+    {
+        *pulOutClientToken = ( uint32_t ) ullToken;
+    }
+    else
+    {
+        xStatus = false;
+    }
+
+    return xStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvRemoveRequest( ShadowRequestTable_t * pxTable,
+                              uint32_t ulClientToken,
+                              ShadowRequest_t * pxOutRequest )
+{
+    bool xFound = false;
+    ShadowRequest_t * pxRequest;
+    uint32_t ulSlot = ulClientToken & shadowrequestSLOT_MASK;
+
+    /* The slot is part of the token, so a response is matched by checking a
+     * single entry.  The full token comparison rejects tokens issued by other
+     * tables and responses to requests that already completed. */
+    if( ulSlot < shadowrequestMAX_OUTSTANDING )
+    {
+        pxRequest = &( pxTable->xRequests[ ulSlot ] );
+
+        if( ( pxRequest->xInUse == true ) && ( pxRequest->ulClientToken == ulClientToken ) )
+        {
+            if( pxOutRequest != NULL )
+            {
+                *pxOutRequest = *pxRequest;
+            }
+
+            pxRequest->xInUse = false;
+            pxTable->xOutstanding--;
+            xFound = true;
+        }
+    }
+
+    return xFound;
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowRequestStatus eShadowRequestTableInit( ShadowRequestTable_t * pxTable,
+                                              uint32_t ulTableId )
+{
+    eShadowRequestStatus eStatus = eShadowRequestSuccess;
+
+    if( ( pxTable == NULL ) || ( ulTableId > shadowrequestMAX_TABLE_ID ) )
+    {
+        eStatus = eShadowRequestBadParameter;
+    }
+    else
+    {
+        memset( pxTable, 0x00, sizeof( ShadowRequestTable_t ) );
+        pxTable->ulTableId = ulTableId;
+        pxTable->ulNextSequence = 1U;
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowRequestStatus eShadowRequestAdd( ShadowRequestTable_t * pxTable,
+                                        ShadowRequestType_t eType,
+                                        uint32_t ulTimeoutMs,
+                                        ShadowRequestCallback_t pxCallback,
+                                        void * pvContext,
+                                        uint32_t * pulOutClientToken )
+{
+    eShadowRequestStatus eStatus = eShadowRequestTableFull;
+    ShadowRequest_t * pxRequest;
+    uint32_t ulSlot;
+
+    if( ( pxTable == NULL ) || ( pxCallback == NULL ) || ( pulOutClientToken == NULL ) )
+    {
+        eStatus = eShadowRequestBadParameter;
+    }
+    else
+    {
+        taskENTER_CRITICAL();
+        {
+            for( ulSlot = 0U; ulSlot < shadowrequestMAX_OUTSTANDING; ulSlot++ )
+            {
+                pxRequest = &( pxTable->xRequests[ ulSlot ] );
+
+                if( pxRequest->xInUse == false )
+                {
+                    pxRequest->ulClientToken = ( pxTable->ulNextSequence << shadowrequestSEQUENCE_SHIFT ) |
+                                               ( pxTable->ulTableId << shadowrequestTABLE_ID_SHIFT ) |
+                                               ulSlot;
+                    pxRequest->eType = eType;
+                    pxRequest->xStartTime = xTaskGetTickCount();
+                    pxRequest->xTimeoutTicks = pdMS_TO_TICKS( ulTimeoutMs );
+                    pxRequest->pxCallback = pxCallback;
+                    pxRequest->pvContext = pvContext;
+                    pxRequest->xInUse = true;
+                    pxTable->xOutstanding++;
+
+                    /* The sequence number is never 0 so no token is 0. */
+                    pxTable->ulNextSequence = ( pxTable->ulNextSequence + 1U ) & shadowrequestSEQUENCE_MASK;
+
+                    if( pxTable->ulNextSequence == 0U )
+                    {
+                        pxTable->ulNextSequence = 1U;
+                    }
+
+                    *pulOutClientToken = pxRequest->ulClientToken;
+                    eStatus = eShadowRequestSuccess;
+                    break;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowRequestStatus eShadowRequestCancel( ShadowRequestTable_t * pxTable,
+                                           uint32_t ulClientToken )
+{
+    eShadowRequestStatus eStatus = eShadowRequestNotFound;
+
+    if( pxTable == NULL )
+    {
+        eStatus = eShadowRequestBadParameter;
+    }
+    else
+    {
+        taskENTER_CRITICAL();
+        {
+            if( prvRemoveRequest( pxTable, ulClientToken, NULL ) == true )
+            {
+                eStatus = eShadowRequestSuccess;
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowRequestStatus eShadowRequestHandleResponse( ShadowRequestTable_t * pxTable,
+                                                   ShadowRequestResult_t eResult,
+                                                   const char * pcPayload,
+                                                   size_t xPayloadLength )
+{
+    eShadowRequestStatus eStatus = eShadowRequestSuccess;
+    JsonExtractorKey_t xKeys[] =
+    {
+        jsonextractorKEY( shadowrequestCLIENT_TOKEN_KEY ),
+        jsonextractorKEY( shadowrequestVERSION_KEY ),
+        jsonextractorKEY( shadowrequestCODE_KEY )
+    };
+    ShadowResponse_t xResponse = { 0 };
+    ShadowRequest_t xRequest;
+    uint32_t ulClientToken = 0U;
+    bool xFound = false;
+
+    if( ( pxTable == NULL ) || ( pcPayload == NULL ) ||
+        ( ( eResult != ShadowRequestAccepted ) && ( eResult != ShadowRequestRejected ) ) )
+    {
+        eStatus = eShadowRequestBadParameter;
+    }
+    else if( eJsonExtract( pcPayload, xPayloadLength, xKeys, sizeof( xKeys ) / sizeof( xKeys[ 0 ] ) ) != eJsonExtractorSuccess )
+    {
+        eStatus = eShadowRequestInvalidDocument;
+    }
+    else if( ( xKeys[ 0 ].eValueType != JsonExtractorValueString ) ||
+             ( prvParseClientToken( xKeys[ 0 ].pcValue, xKeys[ 0 ].xValueLength, &ulClientToken ) == false ) )
+    {
+        /* Responses to requests sent without a token, or with a token that
+         * was not issued by a request table, cannot be matched. */
+        eStatus = eShadowRequestNotFound;
+    }
+    else if( ( ( xKeys[ 1 ].eValueType != JsonExtractorValueNotFound ) &&
+               ( xJsonExtractorGetUint32( &( xKeys[ 1 ] ), &( xResponse.ulVersion ) ) == false ) ) ||
+             ( ( xKeys[ 2 ].eValueType != JsonExtractorValueNotFound ) &&
+               ( xJsonExtractorGetUint32( &( xKeys[ 2 ] ), &( xResponse.ulErrorCode ) ) == false ) ) )
+    {
+        /* The version or error code is not an unsigned 32-bit integer.  The
+         * request is left outstanding, so it times out. */
+        eStatus = eShadowRequestInvalidDocument;
+    }
+    else
+    {
+        taskENTER_CRITICAL();
+        {
+            xFound = prvRemoveRequest( pxTable, ulClientToken, &xRequest );
+        }
+        taskEXIT_CRITICAL();
+
+        if( xFound == false )
+        {
+            eStatus = eShadowRequestNotFound;
+        }
+    }
+
+    if( eStatus == eShadowRequestSuccess )
+    {
+        xResponse.eResult = eResult;
+        xResponse.pcPayload = pcPayload;
+        xResponse.xPayloadLength = xPayloadLength;
+
+        /* The callback is called outside the critical section, after the
+         * request is removed, so it can add a new request. */
+        xRequest.pxCallback( xRequest.pvContext, xRequest.ulClientToken, xRequest.eType, &xResponse );
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+TickType_t xShadowRequestProcessTimeouts( ShadowRequestTable_t * pxTable )
+{
+    TickType_t xTicksUntilNextTimeout = portMAX_DELAY;
+    TickType_t xNow, xElapsed, xRemaining;
+    ShadowResponse_t xResponse = { 0 };
+    ShadowRequest_t xRequest;
+    ShadowRequest_t * pxRequest;
+    uint32_t ulSlot;
+    bool xExpired;
+
+    configASSERT( pxTable != NULL );
+
+    xResponse.eResult = ShadowRequestTimedOut;
+
+    for( ulSlot = 0U; ulSlot < shadowrequestMAX_OUTSTANDING; ulSlot++ )
+    {
+        xExpired = false;
+        pxRequest = &( pxTable->xRequests[ ulSlot ] );
+
+        taskENTER_CRITICAL();
+        {
+            if( pxRequest->xInUse == true )
+            {
+                xNow = xTaskGetTickCount();
+                xElapsed = xNow - pxRequest->xStartTime;
+
+                if( xElapsed >= pxRequest->xTimeoutTicks )
+                {
+                    xExpired = prvRemoveRequest( pxTable, pxRequest->ulClientToken, &xRequest );
+                }
+                else
+                {
+                    xRemaining = pxRequest->xTimeoutTicks - xElapsed;
+
+                    if( xRemaining < xTicksUntilNextTimeout )
+                    {
+                        xTicksUntilNextTimeout = xRemaining;
+                    }
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+
+        if( xExpired == true )
+        {
+            xRequest.pxCallback( xRequest.pvContext, xRequest.ulClientToken, xRequest.eType, &xResponse );
+        }
+    }
+
+    return xTicksUntilNextTimeout;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t xShadowRequestGetOutstanding( ShadowRequestTable_t * pxTable )
+{
+    size_t xOutstanding;
+
+    configASSERT( pxTable != NULL );
+
+    taskENTER_CRITICAL();
+    {
+        xOutstanding = pxTable->xOutstanding;
+    }
+    taskEXIT_CRITICAL();
+
+    return xOutstanding;
+}
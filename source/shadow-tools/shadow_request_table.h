@@ -0,0 +1,252 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_request_table.h
+ *
+ * @brief Table of outstanding Device Shadow requests, keyed on the client
+ * token sent with each request.
+ *
+ * Each get, update or delete request is given a client token when it is added
+ * to the table, and a response carrying that token completes it.  The slot
+ * of a request is encoded in the low bits of its token so responses are
+ * matched without a search, and a sequence number in the high bits lets late
+ * responses to requests that already timed out be recognised and ignored.
+ * Several requests can be outstanding at once, each with its own timeout and
+ * completion callback.
+ *
+ * Response callbacks run in the context of the task that passes the response
+ * to the table, normally the MQTT agent task.  Timeout callbacks run in the
+ * context of the task that calls xShadowRequestProcessTimeouts().
+ */
+
+#ifndef SHADOW_REQUEST_TABLE_H_
+#define SHADOW_REQUEST_TABLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/**
+ * @brief Number of requests that can be outstanding in one table.  Can be
+ * overridden in demo_config.h, up to 16.
+ */
+#ifndef shadowrequestMAX_OUTSTANDING
+    #define shadowrequestMAX_OUTSTANDING    ( 8U )
+#endif
+
+#if ( shadowrequestMAX_OUTSTANDING > 16U )
+    #error "shadowrequestMAX_OUTSTANDING must be at most 16."
+#endif
+
+/**
+ * @brief Largest table identifier.  Tasks that receive the same responses
+ * must use tables with different identifiers so they never issue the same
+ * client token.
+ */
+#define shadowrequestMAX_TABLE_ID           ( 15U )
+
+/**
+ * @brief Return codes from shadow request table APIs.
+ */
+typedef enum
+{
+    eShadowRequestSuccess = 0,
+    eShadowRequestBadParameter,
+    eShadowRequestTableFull,
+    eShadowRequestNotFound,
+    eShadowRequestInvalidDocument
+} eShadowRequestStatus;
+
+/**
+ * @brief Kinds of Device Shadow request.
+ */
+typedef enum
+{
+    ShadowRequestGet = 0,
+    ShadowRequestUpdate,
+    ShadowRequestDelete
+} ShadowRequestType_t;
+
+/**
+ * @brief Outcome of a request.
+ */
+typedef enum
+{
+    ShadowRequestAccepted = 0,
+    ShadowRequestRejected,
+    ShadowRequestTimedOut
+} ShadowRequestResult_t;
+
+/**
+ * @brief Response to a request, passed to its completion callback.
+ */
+typedef struct ShadowResponse
+{
+    ShadowRequestResult_t eResult; /**< Outcome of the request. */
+    uint32_t ulVersion;            /**< Shadow version in the response, or 0 if it has none. */
+    uint32_t ulErrorCode;          /**< Error code of a rejected request, or 0 if it has none. */
+    const char * pcPayload;        /**< The response document, or NULL for a timeout. */
+    size_t xPayloadLength;         /**< Length of pcPayload. */
+} ShadowResponse_t;
+
+/**
+ * @brief Function called when a request completes.
+ *
+ * @param[in] pvContext The context passed when the request was added.
+ * @param[in] ulClientToken The client token of the request.
+ * @param[in] eType The kind of request.
+ * @param[in] pxResponse The response.  Only valid during the call.
+ */
+typedef void ( * ShadowRequestCallback_t )( void * pvContext,
+                                            uint32_t ulClientToken,
+                                            ShadowRequestType_t eType,
+                                            const ShadowResponse_t * pxResponse );
+
+/**
+ * @brief An outstanding request.  Fields are private to
+ * shadow_request_table.c.
+ */
+typedef struct ShadowRequest
+{
+    uint32_t ulClientToken;
+    ShadowRequestType_t eType;
+    TickType_t xStartTime;
+    TickType_t xTimeoutTicks;
+    ShadowRequestCallback_t pxCallback;
+    void * pvContext;
+    bool xInUse;
+} ShadowRequest_t;
+
+/**
+ * @brief State of a request table.  Fields are private to
+ * shadow_request_table.c and are exposed only so the structure can be
+ * allocated statically.
+ */
+typedef struct ShadowRequestTable
+{
+    ShadowRequest_t xRequests[ shadowrequestMAX_OUTSTANDING ];
+    uint32_t ulNextSequence;
+    uint32_t ulTableId;
+    size_t xOutstanding;
+} ShadowRequestTable_t;
+
+/**
+ * @brief Initialize an empty table.
+ *
+ * @param[out] pxTable The table to initialize.
+ * @param[in] ulTableId Identifier placed in every client token issued by the
+ * table, at most #shadowrequestMAX_TABLE_ID.
+ *
+ * @return #eShadowRequestSuccess or #eShadowRequestBadParameter.
+ */
+eShadowRequestStatus eShadowRequestTableInit( ShadowRequestTable_t * pxTable,
+                                              uint32_t ulTableId );
+
+/**
+ * @brief Add a request to the table and get the client token to send with it.
+ *
+ * @param[in] pxTable The table.
+ * @param[in] eType The kind of request.
+ * @param[in] ulTimeoutMs Time in milliseconds to wait for the response.
+ * @param[in] pxCallback Function called when the request completes.
+ * @param[in] pvContext Context passed to pxCallback.
+ * @param[out] pulOutClientToken The client token of the request, never 0.
+ *
+ * @return #eShadowRequestSuccess if the request is added;
+ * #eShadowRequestBadParameter if invalid parameters are passed;
+ * #eShadowRequestTableFull if the maximum number of requests is outstanding.
+ */
+eShadowRequestStatus eShadowRequestAdd( ShadowRequestTable_t * pxTable,
+                                        ShadowRequestType_t eType,
+                                        uint32_t ulTimeoutMs,
+                                        ShadowRequestCallback_t pxCallback,
+                                        void * pvContext,
+                                        uint32_t * pulOutClientToken );
+
+/**
+ * @brief Remove a request without calling its callback, for example because
+ * it could not be published.
+ *
+ * @param[in] pxTable The table.
+ * @param[in] ulClientToken The client token of the request.
+ *
+ * @return #eShadowRequestSuccess if the request is removed;
+ * #eShadowRequestNotFound if no request with the token is outstanding.
+ */
+eShadowRequestStatus eShadowRequestCancel( ShadowRequestTable_t * pxTable,
+                                           uint32_t ulClientToken );
+
+/**
+ * @brief Complete the request a response received on an accepted or rejected
+ * topic belongs to.
+ *
+ * The client token, version and error code are extracted from the response in
+ * one pass, and the callback of the matching request is called.
+ *
+ * @param[in] pxTable The table.
+ * @param[in] eResult #ShadowRequestAccepted or #ShadowRequestRejected,
+ * depending on the topic the response was received on.
+ * @param[in] pcPayload The response document.
+ * @param[in] xPayloadLength Length of pcPayload.
+ *
+ * @return #eShadowRequestSuccess if a request is completed;
+ * #eShadowRequestBadParameter if invalid parameters are passed;
+ * #eShadowRequestInvalidDocument if the response is not valid JSON, or its
+ * version or error code is not an unsigned 32-bit integer;
+ * #eShadowRequestNotFound if the response has no client token, or belongs to
+ * a request that is not outstanding in this table.
+ */
+eShadowRequestStatus eShadowRequestHandleResponse( ShadowRequestTable_t * pxTable,
+                                                   ShadowRequestResult_t eResult,
+                                                   const char * pcPayload,
+                                                   size_t xPayloadLength );
+
+/**
+ * @brief Complete the requests whose timeout has expired, calling their
+ * callbacks with a #ShadowRequestTimedOut result.
+ *
+ * @param[in] pxTable The table.
+ *
+ * @return The number of ticks until the next outstanding request times out,
+ * or portMAX_DELAY if no request is outstanding.
+ */
+TickType_t xShadowRequestProcessTimeouts( ShadowRequestTable_t * pxTable );
+
+/**
+ * @brief Get the number of outstanding requests.
+ *
+ * @param[in] pxTable The table.
+ *
+ * @return The number of outstanding requests.
+ */
+size_t xShadowRequestGetOutstanding( ShadowRequestTable_t * pxTable );
+
+#endif /* SHADOW_REQUEST_TABLE_H_ */
@@ -0,0 +1,224 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_schema.c
+ *
+ * @brief Implementation of the serializer and parser for the shadow
+ * properties listed in shadow_schema_config.h.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+
+/* JSON extractor include. */
+#include "json_extractor.h"
+
+/* Interface include. */
+#include "shadow_schema.h"
+
+/**
+ * @brief Parts of a document.  The properties are written between the header
+ * of the section and the token start, and the client token between the token
+ * start and the end.
+ */
+#define shadowschemaREPORTED_HEADER    "{\"state\":{\"reported\":{"
+#define shadowschemaDESIRED_HEADER     "{\"state\":{\"desired\":{"
+#define shadowschemaTOKEN_START        "}},\"clientToken\":\""
+#define shadowschemaEND                "\"}"
+
+/**
+ * @brief Key of the version in a delta document.
+ */
+#define shadowschemaVERSION_KEY        "version"
+
+/**
+ * @brief Pattern of the client token slot, matching shadowschemaTOKEN_WIDTH.
+ */
+#define shadowschemaTOKEN_PATTERN      "%010u"
+
+/**
+ * @brief Expands to the pattern of a property, matching the fields of
+ * shadowschemaLAYOUT_FIELDS.  The value slot is shadowschemaVALUE_WIDTH
+ * characters wide.
+ */
+#define shadowschemaPATTERN_PROPERTY( xName )     "\"" #xName "\":%10u,"
+
+/**
+ * @brief Expands to the key of a property in a delta document.
+ */
+#define shadowschemaDELTA_KEY( xName )            jsonextractorKEY( "state." #xName ),
+
+/**
+ * @brief Expands to a statement that reads the value of a property from the
+ * extracted keys of a delta document, in which the version is the first key.
+ */
+#define shadowschemaREAD_PROPERTY( xName )                                                       \
+    if( xJsonExtractorGetUint32( &( xKeys[ ShadowSchemaIndex_##xName + 1U ] ), &( pxState->xName ) ) == true ) \
+    {                                                                                            \
+        ulPresentMask |= ( 1UL << ShadowSchemaIndex_##xName );                                   \
+    }
+
+/**
+ * @brief Expands to a statement that copies the value of a property from a
+ * state to an array indexed by #ShadowSchemaIndex_t.
+ */
+#define shadowschemaGET_VALUE( xName )            pulValues[ ShadowSchemaIndex_##xName ] = pxState->xName;
+
+/**
+ * @brief Expands to a statement that writes the value of a property from a
+ * state into a document.
+ */
+#define shadowschemaSET_VALUE( xName )            vShadowSchemaSetValue( pxDocument, ShadowSchemaIndex_##xName, pxState->xName );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Pattern of a document for each section.  The separator after the last
+ * property is replaced with a space when the pattern is compiled.
+ */
+static const char * const pcDocumentPatterns[] =
+{
+    shadowschemaREPORTED_HEADER shadowschemaPROPERTIES( shadowschemaPATTERN_PROPERTY )
+    shadowschemaTOKEN_START shadowschemaTOKEN_PATTERN shadowschemaEND,
+    shadowschemaDESIRED_HEADER shadowschemaPROPERTIES( shadowschemaPATTERN_PROPERTY )
+    shadowschemaTOKEN_START shadowschemaTOKEN_PATTERN shadowschemaEND
+};
+
+/*-----------------------------------------------------------*/
+
+void vShadowSchemaInitDocument( ShadowSchemaDocument_t * pxDocument,
+                                ShadowSchemaSection_t eSection )
+{
+    ePayloadTemplateStatus eStatus;
+    const PayloadTemplateSlot_t * pxLastProperty;
+
+    configASSERT( pxDocument != NULL );
+    configASSERT( ( ( size_t ) ShadowSchemaPropertyCount + 1U ) <= payloadtemplateMAX_SLOTS );
+
+    eStatus = ePayloadTemplateCompile( &( pxDocument->xPayload ),
+                                       pcDocumentPatterns[ ( eSection == ShadowSchemaSectionReported ) ? 0 : 1 ],
+                                       pxDocument->cBuffer,
+                                       sizeof( pxDocument->cBuffer ) );
+
+    /* The buffer is sized from the same list as the pattern, so compiling only
+     * fails if the two do not match. */
+    configASSERT( eStatus == ePayloadTemplateSuccess );
+    ( void ) eStatus;
+
+    /* The separator is constant text after the fixed width value of the last
+     * property, so it never moves. */
+    pxLastProperty = &( pxDocument->xPayload.xSlots[ ShadowSchemaPropertyCount - 1 ] );
+    pxDocument->cBuffer[ pxLastProperty->xOffset + pxLastProperty->xLength ] = ' ';
+}
+
+/*-----------------------------------------------------------*/
+
+void vShadowSchemaSetValue( ShadowSchemaDocument_t * pxDocument,
+                            ShadowSchemaIndex_t eProperty,
+                            uint32_t ulValue )
+{
+    configASSERT( pxDocument != NULL );
+    configASSERT( ( size_t ) eProperty < ( size_t ) ShadowSchemaPropertyCount );
+
+    /* Every uint32_t fits in a value slot. */
+    ( void ) ePayloadTemplateSetNumber( &( pxDocument->xPayload ), ( size_t ) eProperty, ulValue );
+}
+
+/*-----------------------------------------------------------*/
+
+void vShadowSchemaSetState( ShadowSchemaDocument_t * pxDocument,
+                            const ShadowSchemaState_t * pxState )
+{
+    configASSERT( pxState != NULL );
+
+    shadowschemaPROPERTIES( shadowschemaSET_VALUE )
+}
+
+/*-----------------------------------------------------------*/
+
+void vShadowSchemaSetClientToken( ShadowSchemaDocument_t * pxDocument,
+                                  uint32_t ulClientToken )
+{
+    configASSERT( pxDocument != NULL );
+
+    ( void ) ePayloadTemplateSetNumber( &( pxDocument->xPayload ), ShadowSchemaPropertyCount, ulClientToken );
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowSchemaStatus eShadowSchemaParseDelta( const char * pcDocument,
+                                             size_t xDocumentLength,
+                                             ShadowSchemaState_t * pxState,
+                                             uint32_t * pulPresentMask,
+                                             uint32_t * pulVersion )
+{
+    eShadowSchemaStatus eStatus = eShadowSchemaSuccess;
+    uint32_t ulPresentMask = 0U;
+    JsonExtractorKey_t xKeys[ ShadowSchemaPropertyCount + 1U ] =
+    {
+        jsonextractorKEY( shadowschemaVERSION_KEY ),
+        shadowschemaPROPERTIES( shadowschemaDELTA_KEY )
+    };
+
+    configASSERT( ( size_t ) ShadowSchemaPropertyCount < jsonextractorMAX_KEYS );
+
+    if( ( pcDocument == NULL ) || ( pxState == NULL ) ||
+        ( pulPresentMask == NULL ) || ( pulVersion == NULL ) )
+    {
+        eStatus = eShadowSchemaBadParameter;
+    }
+    else if( ( eJsonExtract( pcDocument, xDocumentLength, xKeys, sizeof( xKeys ) / sizeof( xKeys[ 0 ] ) ) != eJsonExtractorSuccess ) ||
+             ( xKeys[ 0 ].eValueType != JsonExtractorValueNumber ) ||
+             ( xJsonExtractorGetUint32( &( xKeys[ 0 ] ), pulVersion ) == false ) )
+    {
+        eStatus = eShadowSchemaInvalidDocument;
+    }
+    else
+    {
+        /* Properties that are not in the delta, or have a type that is not
+         * held, are left out of the mask. */
+        shadowschemaPROPERTIES( shadowschemaREAD_PROPERTY )
+
+        *pulPresentMask = ulPresentMask;
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+void vShadowSchemaGetValues( const ShadowSchemaState_t * pxState,
+                             uint32_t * pulValues )
+{
+    configASSERT( ( pxState != NULL ) && ( pulValues != NULL ) );
+
+    shadowschemaPROPERTIES( shadowschemaGET_VALUE )
+}
@@ -0,0 +1,235 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_schema.h
+ *
+ * @brief Serializer and parser for the shadow properties listed in
+ * shadow_schema_config.h.
+ *
+ * The property list is expanded at compile time into an index for each
+ * property, a structure holding the value of each property, and a payload
+ * template pattern in which every value occupies a fixed width slot.  A
+ * document is compiled from the pattern once, after which only the value and
+ * client token slots are rewritten for each publish, so the length and the
+ * position of every field are known before the document is built.  Delta documents are
+ * parsed in a single pass that extracts the version and every property.
+ */
+
+#ifndef SHADOW_SCHEMA_H_
+#define SHADOW_SCHEMA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Payload template include. */
+#include "payload_template.h"
+
+/* Shadow properties include. */
+#include "shadow_schema_config.h"
+
+/**
+ * @brief Width of each value field in a document.  Wide enough for the 10
+ * digits of UINT32_MAX.  Values are right aligned and padded with spaces,
+ * which JSON permits before a number.
+ */
+#define shadowschemaVALUE_WIDTH           ( 10U )
+
+/**
+ * @brief Width of the client token field in a document.  Tokens are padded
+ * with leading zeros.
+ */
+#define shadowschemaTOKEN_WIDTH           ( 10U )
+
+/**
+ * @brief Fields of a property within the properties of a document: the
+ * quoted key and colon, the value, and a separator that is a comma for every
+ * property except the last.
+ */
+#define shadowschemaLAYOUT_FIELDS( xName )              \
+    char xName##Key[ sizeof( "\"" #xName "\":" ) - 1U ]; \
+    char xName[ shadowschemaVALUE_WIDTH ];               \
+    char xName##Separator[ 1 ];
+
+/**
+ * @brief Layout of the properties of a document.  It is never instantiated;
+ * its size is the length of the properties.
+ */
+typedef struct ShadowSchemaLayout
+{
+    shadowschemaPROPERTIES( shadowschemaLAYOUT_FIELDS )
+} ShadowSchemaLayout_t;
+
+/**
+ * @brief Expands to the index of a property.
+ */
+#define shadowschemaINDEX( xName )    ShadowSchemaIndex_##xName,
+
+/**
+ * @brief Index of each property, in the order of shadowschemaPROPERTIES.
+ */
+typedef enum
+{
+    shadowschemaPROPERTIES( shadowschemaINDEX )
+    ShadowSchemaPropertyCount
+} ShadowSchemaIndex_t;
+
+/**
+ * @brief Expands to the member of #ShadowSchemaState_t holding a property.
+ */
+#define shadowschemaMEMBER( xName )    uint32_t xName;
+
+/**
+ * @brief The value of every property, as members named after the properties.
+ */
+typedef struct ShadowSchemaState
+{
+    shadowschemaPROPERTIES( shadowschemaMEMBER )
+} ShadowSchemaState_t;
+
+/**
+ * @brief Expands to the shadow cache property of a property, so the list of
+ * cache properties can be written as
+ * { shadowschemaPROPERTIES( shadowschemaCACHE_PROPERTY ) }.  The cache index of
+ * each property is then its #ShadowSchemaIndex_t.
+ */
+#define shadowschemaCACHE_PROPERTY( xName )    shadowcachePROPERTY( #xName ),
+
+/**
+ * @brief The section of the state a document writes.
+ */
+typedef enum
+{
+    ShadowSchemaSectionReported = 0,
+    ShadowSchemaSectionDesired
+} ShadowSchemaSection_t;
+
+/**
+ * @brief Length of the longest document, without a terminating NULL.
+ */
+#define shadowschemaMAX_DOCUMENT_LENGTH                                    \
+    ( ( sizeof( "{\"state\":{\"reported\":{" ) - 1U ) +                    \
+      sizeof( ShadowSchemaLayout_t ) +                                     \
+      ( sizeof( "}},\"clientToken\":\"" ) - 1U ) + shadowschemaTOKEN_WIDTH + \
+      ( sizeof( "\"}" ) - 1U ) )
+
+/**
+ * @brief A document built from the template of one section.
+ *
+ * xPayload.pcPayload and xPayload.xLength may be read to publish the
+ * document.  The other fields are private to shadow_schema.c.
+ */
+typedef struct ShadowSchemaDocument
+{
+    PayloadTemplate_t xPayload;                           /**< The template holding the document. Slot i holds property i, and the last slot the client token. */
+    char cBuffer[ shadowschemaMAX_DOCUMENT_LENGTH + 1U ]; /**< Buffer of xPayload. */
+} ShadowSchemaDocument_t;
+
+/**
+ * @brief Return codes from shadow schema APIs.
+ */
+typedef enum
+{
+    eShadowSchemaSuccess = 0,
+    eShadowSchemaBadParameter,
+    eShadowSchemaInvalidDocument
+} eShadowSchemaStatus;
+
+/**
+ * @brief Compile the pattern of a section into a document.  Every value and the
+ * client token are 0 until they are set.
+ *
+ * @param[out] pxDocument The document.
+ * @param[in] eSection The section of the state the document writes.
+ */
+void vShadowSchemaInitDocument( ShadowSchemaDocument_t * pxDocument,
+                                ShadowSchemaSection_t eSection );
+
+/**
+ * @brief Write the value of one property into a document.
+ *
+ * @param[in] pxDocument The document.
+ * @param[in] eProperty The property.
+ * @param[in] ulValue The value.
+ */
+void vShadowSchemaSetValue( ShadowSchemaDocument_t * pxDocument,
+                            ShadowSchemaIndex_t eProperty,
+                            uint32_t ulValue );
+
+/**
+ * @brief Write the value of every property into a document.
+ *
+ * @param[in] pxDocument The document.
+ * @param[in] pxState The values.
+ */
+void vShadowSchemaSetState( ShadowSchemaDocument_t * pxDocument,
+                            const ShadowSchemaState_t * pxState );
+
+/**
+ * @brief Write the client token into a document.
+ *
+ * @param[in] pxDocument The document.
+ * @param[in] ulClientToken The client token.
+ */
+void vShadowSchemaSetClientToken( ShadowSchemaDocument_t * pxDocument,
+                                  uint32_t ulClientToken );
+
+/**
+ * @brief Extract the version and the properties of a delta document.
+ *
+ * Properties whose value is a number, true or false are read; true is read
+ * as 1 and false as 0.  Other members of the delta are ignored.
+ *
+ * @param[in] pcDocument The delta document.
+ * @param[in] xDocumentLength Length of pcDocument.
+ * @param[out] pxState The values of the properties read.  Members of other
+ * properties are not written.
+ * @param[out] pulPresentMask Bit i is set if property i was read.
+ * @param[out] pulVersion The version of the document.
+ *
+ * @return #eShadowSchemaSuccess if the delta is parsed;
+ * #eShadowSchemaBadParameter if invalid parameters are passed;
+ * #eShadowSchemaInvalidDocument if the document is not valid JSON or has no
+ * version.
+ */
+eShadowSchemaStatus eShadowSchemaParseDelta( const char * pcDocument,
+                                             size_t xDocumentLength,
+                                             ShadowSchemaState_t * pxState,
+                                             uint32_t * pulPresentMask,
+                                             uint32_t * pulVersion );
+
+/**
+ * @brief Copy the values of a state into an array indexed by
+ * #ShadowSchemaIndex_t, as used by the shadow cache.
+ *
+ * @param[in] pxState The values.
+ * @param[out] pulValues Array of #ShadowSchemaPropertyCount values.
+ */
+void vShadowSchemaGetValues( const ShadowSchemaState_t * pxState,
+                             uint32_t * pulValues );
+
+#endif /* SHADOW_SCHEMA_H_ */
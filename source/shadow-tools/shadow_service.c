@@ -0,0 +1,614 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_service.c
+ *
+ * @brief Implementation of the shared shadow response subscription.
+ */
+
+/* Logging module, see logging_config.h. */
+#define LOG_MODULE    eLogModuleShadow
+
+/* Standard includes. */
+#include <string.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Demo config. */
+#include "demo_config.h"
+
+/* MQTT library includes. */
+#include "core_mqtt_agent.h"
+
+/* Subscription manager header include. */
+#include "subscription_manager.h"
+
+/* Interface include. */
+#include "shadow_service.h"
+
+/**
+ * @brief Parts of the shadow topics of a thing.
+ */
+#define shadowserviceTOPIC_PREFIX                      "$aws/things/"
+#define shadowserviceTOPIC_SHADOW                      "/shadow/"
+#define shadowserviceTOPIC_NAME                        "name/"
+
+/**
+ * @brief Ends of the topic filters, appended to the prefix of the shadow
+ * topics of the thing.
+ */
+#define shadowserviceCLASSIC_FILTER_END                "+/+"
+#define shadowserviceNAMED_FILTER_END                  "name/+/+/+"
+
+/**
+ * @brief Size of the buffers holding the topic filters.
+ */
+#define shadowserviceMAX_FILTER_LENGTH                               \
+    ( sizeof( shadowserviceTOPIC_PREFIX ) - 1U +                     \
+      shadowserviceMAX_THING_NAME_LENGTH +                           \
+      sizeof( shadowserviceTOPIC_SHADOW ) - 1U +                     \
+      sizeof( shadowserviceNAMED_FILTER_END ) - 1U )
+
+/**
+ * @brief The maximum amount of time in milliseconds to wait for the commands
+ * to be posted to the MQTT agent should the MQTT agent's command queue be full.
+ * Tasks wait in the Blocked state, so don't use any CPU time.
+ */
+#define shadowserviceMAX_COMMAND_SEND_BLOCK_TIME_MS    ( 200 )
+
+/**
+ * @brief Time in ms to wait for the SUBACK.
+ */
+#define shadowserviceMS_TO_WAIT_FOR_SUBACK             ( 5000 )
+
+/**
+ * @brief Time in ms between checks made by tasks waiting for another task to
+ * finish subscribing.
+ */
+#define shadowserviceMS_BETWEEN_START_CHECKS           ( 100 )
+
+/**
+ * @brief Defines the structure to use as the command callback context.
+ */
+struct MQTTAgentCommandContext
+{
+    TaskHandle_t xTaskToNotify;
+    bool xReturnStatus;
+};
+
+/**
+ * @brief Subscription state of the service.
+ */
+typedef enum ShadowServiceState
+{
+    ShadowServiceIdle = 0,
+    ShadowServiceSubscribing,
+    ShadowServiceSubscribed
+} ShadowServiceState_t;
+
+/**
+ * @brief A registered handler.
+ */
+typedef struct ShadowServiceHandler
+{
+    const char * pcShadowName;
+    uint16_t usShadowNameLength;
+    ShadowServiceCallback_t pxCallback;
+    void * pvContext;
+} ShadowServiceHandler_t;
+
+/**
+ * @brief Suffix of a response topic after the shadow name, and the message
+ * type it maps to.
+ */
+typedef struct ShadowServiceOperation
+{
+    const char * pcSuffix;
+    size_t xSuffixLength;
+    ShadowMessageType_t eMessageType;
+} ShadowServiceOperation_t;
+
+extern MQTTAgentContext_t xGlobalMqttAgentContext;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The registered handlers.  A handler with no callback is free.
+ */
+static ShadowServiceHandler_t xHandlers[ shadowserviceMAX_HANDLERS ];
+
+/**
+ * @brief Subscription state.  Only accessed from within critical sections.
+ */
+static ShadowServiceState_t xServiceState = ShadowServiceIdle;
+
+/**
+ * @brief The thing the service is subscribed for.
+ */
+static char cServiceThingName[ shadowserviceMAX_THING_NAME_LENGTH ];
+static uint16_t usServiceThingNameLength = 0U;
+
+/**
+ * @brief The topic filters.  They must persist for the duration of the
+ * subscription as the subscription manager does not copy them.
+ */
+static char cClassicFilter[ shadowserviceMAX_FILTER_LENGTH ];
+static uint16_t usClassicFilterLength = 0U;
+static char cNamedFilter[ shadowserviceMAX_FILTER_LENGTH ];
+static uint16_t usNamedFilterLength = 0U;
+
+/**
+ * @brief Suffixes of the response topics.
+ */
+static const ShadowServiceOperation_t xOperations[] =
+{
+    { "get/accepted",       sizeof( "get/accepted" ) - 1U,       ShadowMessageTypeGetAccepted       },
+    { "get/rejected",       sizeof( "get/rejected" ) - 1U,       ShadowMessageTypeGetRejected       },
+    { "delete/accepted",    sizeof( "delete/accepted" ) - 1U,    ShadowMessageTypeDeleteAccepted    },
+    { "delete/rejected",    sizeof( "delete/rejected" ) - 1U,    ShadowMessageTypeDeleteRejected    },
+    { "update/accepted",    sizeof( "update/accepted" ) - 1U,    ShadowMessageTypeUpdateAccepted    },
+    { "update/rejected",    sizeof( "update/rejected" ) - 1U,    ShadowMessageTypeUpdateRejected    },
+    { "update/documents",   sizeof( "update/documents" ) - 1U,   ShadowMessageTypeUpdateDocuments   },
+    { "update/delta",       sizeof( "update/delta" ) - 1U,       ShadowMessageTypeUpdateDelta       }
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Write a topic filter for the shadows of the thing into a buffer.
+ *
+ * @param[in] pcFilterEnd The end of the filter.
+ * @param[in] xFilterEndLength Length of pcFilterEnd.
+ * @param[out] pcBuffer Buffer of #shadowserviceMAX_FILTER_LENGTH characters.
+ *
+ * @return The length of the filter.
+ */
+static uint16_t prvBuildFilter( const char * pcFilterEnd,
+                                size_t xFilterEndLength,
+                                char * pcBuffer );
+
+/**
+ * @brief Send the SUBSCRIBE for both topic filters and wait for the SUBACK.
+ *
+ * @return true if the subscribe is successful;
+ * false otherwise.
+ */
+static bool prvSubscribe( void );
+
+/**
+ * @brief Passed into MQTTAgent_Subscribe() as the callback to execute when the
+ * broker ACKs the SUBSCRIBE message.  It routes publishes that match the
+ * filters to prvIncomingPublishCallback() and notifies the subscribing task.
+ *
+ * @param[in] pxCommandContext Context of the initial command.
+ * @param[in] pxReturnInfo The result of the command.
+ */
+static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
+                                         MQTTAgentReturnInfo_t * pxReturnInfo );
+
+/**
+ * @brief Get the shadow name and message type of a topic.
+ *
+ * @param[in] pcTopic The topic.
+ * @param[in] usTopicLength Length of pcTopic.
+ * @param[out] ppcOutShadowName The shadow name, or NULL for the classic
+ * shadow.
+ * @param[out] pusOutShadowNameLength Length of the shadow name, or 0 for the
+ * classic shadow.
+ * @param[out] peOutMessageType The message type.
+ *
+ * @return true if the topic is a shadow response topic of the thing; false
+ * otherwise.
+ */
+static bool prvParseTopic( const char * pcTopic,
+                           uint16_t usTopicLength,
+                           const char ** ppcOutShadowName,
+                           uint16_t * pusOutShadowNameLength,
+                           ShadowMessageType_t * peOutMessageType );
+
+/**
+ * @brief The callback registered with the subscription manager for both
+ * filters.  It passes each publish to the handlers of its shadow.
+ *
+ * @param[in] pvIncomingPublishCallbackContext Unused.
+ * @param[in] pxPublishInfo Deserialized publish.
+ */
+static void prvIncomingPublishCallback( void * pvIncomingPublishCallbackContext,
+                                        MQTTPublishInfo_t * pxPublishInfo );
+
+/*-----------------------------------------------------------*/
+
+static uint16_t prvBuildFilter( const char * pcFilterEnd,
+                                size_t xFilterEndLength,
+                                char * pcBuffer )
+{
+    size_t xOffset = 0U;
+
+    ( void ) memcpy( &( pcBuffer[ xOffset ] ), shadowserviceTOPIC_PREFIX, sizeof( shadowserviceTOPIC_PREFIX ) - 1U );
+    xOffset += sizeof( shadowserviceTOPIC_PREFIX ) - 1U;
+    ( void ) memcpy( &( pcBuffer[ xOffset ] ), cServiceThingName, usServiceThingNameLength );
+    xOffset += usServiceThingNameLength;
+    ( void ) memcpy( &( pcBuffer[ xOffset ] ), shadowserviceTOPIC_SHADOW, sizeof( shadowserviceTOPIC_SHADOW ) - 1U );
+    xOffset += sizeof( shadowserviceTOPIC_SHADOW ) - 1U;
+    ( void ) memcpy( &( pcBuffer[ xOffset ] ), pcFilterEnd, xFilterEndLength );
+    xOffset += xFilterEndLength;
+
+    return ( uint16_t ) xOffset;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvSubscribe( void )
+{
+    MQTTStatus_t xStatus;
+    uint32_t ulNotificationValue;
+    MQTTAgentCommandInfo_t xCommandParams = { 0 };
+
+    /* These must persist until the command is processed. */
+    MQTTAgentSubscribeArgs_t xSubscribeArgs = { 0 };
+    MQTTSubscribeInfo_t xSubscribeInfo[ 2 ];
+    MQTTAgentCommandContext_t xApplicationDefinedContext = { 0 };
+
+    /* One filter for the responses of the classic shadow, and one for the
+     * responses of every named shadow. */
+    xSubscribeInfo[ 0 ].pTopicFilter = cClassicFilter;
+    xSubscribeInfo[ 0 ].topicFilterLength = usClassicFilterLength;
+    xSubscribeInfo[ 0 ].qos = MQTTQoS1;
+    xSubscribeInfo[ 1 ].pTopicFilter = cNamedFilter;
+    xSubscribeInfo[ 1 ].topicFilterLength = usNamedFilterLength;
+    xSubscribeInfo[ 1 ].qos = MQTTQoS1;
+
+    xSubscribeArgs.pSubscribeInfo = xSubscribeInfo;
+    xSubscribeArgs.numSubscriptions = 2;
+
+    xApplicationDefinedContext.xTaskToNotify = xTaskGetCurrentTaskHandle();
+
+    /* Loop in case the queue used to communicate with the MQTT agent is full and
+     * attempts to post to it time out.  The queue will not become full if the
+     * priority of the MQTT agent task is higher than the priority of the task
+     * calling this function. */
+    xTaskNotifyStateClear( NULL );
+    xCommandParams.blockTimeMs = shadowserviceMAX_COMMAND_SEND_BLOCK_TIME_MS;
+    xCommandParams.cmdCompleteCallback = prvSubscribeCommandCallback;
+    xCommandParams.pCmdCompleteCallbackContext = &xApplicationDefinedContext;
+    LogInfo( ( "Sending subscribe request to agent for shadow topics %.*s and %.*s.",
+               usClassicFilterLength, cClassicFilter,
+               usNamedFilterLength, cNamedFilter ) );
+
+    do
+    {
+        xStatus = MQTTAgent_Subscribe( &xGlobalMqttAgentContext,
+                                       &( xSubscribeArgs ),
+                                       &xCommandParams );
+    } while( xStatus != MQTTSuccess );
+
+    /* Wait for the SUBACK.  The context is on this task's stack, so the wait
+     * must not time out before the callback has run. */
+    ulNotificationValue = ulTaskNotifyTake( pdFALSE, pdMS_TO_TICKS( shadowserviceMS_TO_WAIT_FOR_SUBACK ) );
+    configASSERT( ulNotificationValue != 0UL );
+
+    return xApplicationDefinedContext.xReturnStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvSubscribeCommandCallback( MQTTAgentCommandContext_t * pxCommandContext,
+                                         MQTTAgentReturnInfo_t * pxReturnInfo )
+{
+    bool xSuccess = false;
+
+    /* Check if the subscribe operation is a success. */
+    if( pxReturnInfo->returnCode == MQTTSuccess )
+    {
+        /* Add subscriptions so that incoming publishes are routed to the
+         * handlers. */
+        xSuccess = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
+                                    cClassicFilter,
+                                    usClassicFilterLength,
+                                    prvIncomingPublishCallback,
+                                    NULL );
+
+        if( xSuccess == true )
+        {
+            xSuccess = addSubscription( ( SubscriptionElement_t * ) xGlobalMqttAgentContext.pIncomingCallbackContext,
+                                        cNamedFilter,
+                                        usNamedFilterLength,
+                                        prvIncomingPublishCallback,
+                                        NULL );
+        }
+
+        if( xSuccess == false )
+        {
+            LogError( ( "Failed to register an incoming publish callback for the shadow topics." ) );
+        }
+    }
+
+    /* Store the result in the application defined context so the calling task
+     * can check it. */
+    pxCommandContext->xReturnStatus = xSuccess;
+
+    xTaskNotifyGive( pxCommandContext->xTaskToNotify );
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvParseTopic( const char * pcTopic,
+                           uint16_t usTopicLength,
+                           const char ** ppcOutShadowName,
+                           uint16_t * pusOutShadowNameLength,
+                           ShadowMessageType_t * peOutMessageType )
+{
+    bool xMatched = false;
+    size_t xOffset = sizeof( shadowserviceTOPIC_PREFIX ) - 1U;
+    size_t xRemaining, i;
+
+    *ppcOutShadowName = NULL;
+    *pusOutShadowNameLength = 0U;
+
+    /* "$aws/things/<thing>/shadow/" */
+    if( ( usTopicLength > ( xOffset + usServiceThingNameLength + sizeof( shadowserviceTOPIC_SHADOW ) - 1U ) ) &&
+        ( memcmp( pcTopic, shadowserviceTOPIC_PREFIX, xOffset ) == 0 ) &&
+        ( memcmp( &( pcTopic[ xOffset ] ), cServiceThingName, usServiceThingNameLength ) == 0 ) &&
+        ( memcmp( &( pcTopic[ xOffset + usServiceThingNameLength ] ), shadowserviceTOPIC_SHADOW, sizeof( shadowserviceTOPIC_SHADOW ) - 1U ) == 0 ) )
+    {
+        xOffset += usServiceThingNameLength + sizeof( shadowserviceTOPIC_SHADOW ) - 1U;
+        xRemaining = usTopicLength - xOffset;
+        xMatched = true;
+
+        /* "name/<shadow name>/" for named shadows. */
+        if( ( xRemaining > ( sizeof( shadowserviceTOPIC_NAME ) - 1U ) ) &&
+            ( memcmp( &( pcTopic[ xOffset ] ), shadowserviceTOPIC_NAME, sizeof( shadowserviceTOPIC_NAME ) - 1U ) == 0 ) )
+        {
+            xOffset += sizeof( shadowserviceTOPIC_NAME ) - 1U;
+            *ppcOutShadowName = &( pcTopic[ xOffset ] );
+
+            while( ( xOffset < usTopicLength ) && ( pcTopic[ xOffset ] != '/' ) )
+            {
+                xOffset++;
+            }
+
+            *pusOutShadowNameLength = ( uint16_t ) ( &( pcTopic[ xOffset ] ) - *ppcOutShadowName );
+
+            if( ( *pusOutShadowNameLength == 0U ) || ( xOffset == usTopicLength ) )
+            {
+                xMatched = false;
+            }
+            else
+            {
+                /* Skip the '/'. */
+                xOffset++;
+                xRemaining = usTopicLength - xOffset;
+            }
+        }
+    }
+
+    /* "<operation>/<result>" */
+    if( xMatched == true )
+    {
+        xMatched = false;
+
+        for( i = 0U; i < ( sizeof( xOperations ) / sizeof( xOperations[ 0 ] ) ); i++ )
+        {
+            if( ( xOperations[ i ].xSuffixLength == xRemaining ) &&
+                ( memcmp( &( pcTopic[ xOffset ] ), xOperations[ i ].pcSuffix, xRemaining ) == 0 ) )
+            {
+                *peOutMessageType = xOperations[ i ].eMessageType;
+                xMatched = true;
+                break;
+            }
+        }
+    }
+
+    return xMatched;
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvIncomingPublishCallback( void * pvIncomingPublishCallbackContext,
+                                        MQTTPublishInfo_t * pxPublishInfo )
+{
+    const char * pcShadowName;
+    uint16_t usShadowNameLength;
+    ShadowMessageType_t eMessageType;
+    ShadowServiceHandler_t xHandler;
+    bool xHandled = false;
+    size_t i;
+
+    /* Remove compiler warnings about unused parameters. */
+    ( void ) pvIncomingPublishCallbackContext;
+
+    configASSERT( pxPublishInfo != NULL );
+
+    if( prvParseTopic( pxPublishInfo->pTopicName,
+                       pxPublishInfo->topicNameLength,
+                       &pcShadowName,
+                       &usShadowNameLength,
+                       &eMessageType ) == false )
+    {
+        LogDebug( ( "Ignoring publish on %.*s, which is not a shadow response topic.",
+                    pxPublishInfo->topicNameLength,
+                    pxPublishInfo->pTopicName ) );
+    }
+    else
+    {
+        for( i = 0U; i < shadowserviceMAX_HANDLERS; i++ )
+        {
+            /* Handlers can be registered by other tasks while publishes are
+             * routed, so take a consistent copy before calling it. */
+            taskENTER_CRITICAL();
+            {
+                xHandler = xHandlers[ i ];
+            }
+            taskEXIT_CRITICAL();
+
+            if( ( xHandler.pxCallback != NULL ) &&
+                ( xHandler.usShadowNameLength == usShadowNameLength ) &&
+                ( ( usShadowNameLength == 0U ) ||
+                  ( memcmp( xHandler.pcShadowName, pcShadowName, usShadowNameLength ) == 0 ) ) )
+            {
+                xHandler.pxCallback( xHandler.pvContext, eMessageType, pxPublishInfo );
+                xHandled = true;
+            }
+        }
+
+        if( xHandled == false )
+        {
+            LogDebug( ( "No handler registered for publish on %.*s.",
+                        pxPublishInfo->topicNameLength,
+                        pxPublishInfo->pTopicName ) );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowServiceStatus eShadowServiceRegister( const char * pcShadowName,
+                                             uint16_t usShadowNameLength,
+                                             ShadowServiceCallback_t pxCallback,
+                                             void * pvContext )
+{
+    eShadowServiceStatus eStatus = eShadowServiceNoMemory;
+    size_t i;
+
+    if( ( pxCallback == NULL ) ||
+        ( ( pcShadowName == NULL ) && ( usShadowNameLength != 0U ) ) ||
+        ( ( pcShadowName != NULL ) && ( ( usShadowNameLength == 0U ) || ( usShadowNameLength > shadowserviceMAX_SHADOW_NAME_LENGTH ) ) ) )
+    {
+        eStatus = eShadowServiceBadParameter;
+    }
+    else
+    {
+        taskENTER_CRITICAL();
+        {
+            for( i = 0U; i < shadowserviceMAX_HANDLERS; i++ )
+            {
+                if( xHandlers[ i ].pxCallback == NULL )
+                {
+                    xHandlers[ i ].pcShadowName = pcShadowName;
+                    xHandlers[ i ].usShadowNameLength = usShadowNameLength;
+                    xHandlers[ i ].pxCallback = pxCallback;
+                    xHandlers[ i ].pvContext = pvContext;
+                    eStatus = eShadowServiceSuccess;
+                    break;
+                }
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    return eStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+eShadowServiceStatus eShadowServiceStart( const char * pcThingName,
+                                          uint16_t usThingNameLength )
+{
+    eShadowServiceStatus eStatus = eShadowServiceSuccess;
+    ShadowServiceState_t xState = ShadowServiceSubscribing;
+    bool xSubscribeHere = false;
+
+    if( ( pcThingName == NULL ) ||
+        ( usThingNameLength == 0U ) ||
+        ( usThingNameLength > shadowserviceMAX_THING_NAME_LENGTH ) )
+    {
+        eStatus = eShadowServiceBadParameter;
+    }
+    else
+    {
+        /* Wait while another task is subscribing, then either subscribe if no
+         * task has yet, or use the existing subscription. */
+        while( xState == ShadowServiceSubscribing )
+        {
+            taskENTER_CRITICAL();
+            {
+                xState = xServiceState;
+
+                if( xState == ShadowServiceIdle )
+                {
+                    xServiceState = ShadowServiceSubscribing;
+                    xSubscribeHere = true;
+                }
+            }
+            taskEXIT_CRITICAL();
+
+            if( xState == ShadowServiceSubscribing )
+            {
+                vTaskDelay( pdMS_TO_TICKS( shadowserviceMS_BETWEEN_START_CHECKS ) );
+            }
+        }
+
+        if( xSubscribeHere == true )
+        {
+            /* No other task reads the thing name or the filters until the
+             * state is changed to subscribed. */
+            ( void ) memcpy( cServiceThingName, pcThingName, usThingNameLength );
+            usServiceThingNameLength = usThingNameLength;
+            usClassicFilterLength = prvBuildFilter( shadowserviceCLASSIC_FILTER_END,
+                                                    sizeof( shadowserviceCLASSIC_FILTER_END ) - 1U,
+                                                    cClassicFilter );
+            usNamedFilterLength = prvBuildFilter( shadowserviceNAMED_FILTER_END,
+                                                  sizeof( shadowserviceNAMED_FILTER_END ) - 1U,
+                                                  cNamedFilter );
+
+            if( prvSubscribe() == true )
+            {
+                LogInfo( ( "Successfully subscribed to shadow topics." ) );
+                xState = ShadowServiceSubscribed;
+            }
+            else
+            {
+                LogError( ( "Failed to subscribe to shadow topics." ) );
+                eStatus = eShadowServiceSubscribeFailed;
+                xState = ShadowServiceIdle;
+            }
+
+            taskENTER_CRITICAL();
+            {
+                xServiceState = xState;
+            }
+            taskEXIT_CRITICAL();
+        }
+        else if( ( usThingNameLength != usServiceThingNameLength ) ||
+                 ( memcmp( pcThingName, cServiceThingName, usThingNameLength ) != 0 ) )
+        {
+            LogError( ( "The shadow service is already subscribed for thing %.*s.",
+                        usServiceThingNameLength,
+                        cServiceThingName ) );
+            eStatus = eShadowServiceBadParameter;
+        }
+        else
+        {
+            /* Already subscribed by another task. */
+        }
+    }
+
+    return eStatus;
+}
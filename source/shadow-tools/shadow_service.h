@@ -0,0 +1,146 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file shadow_service.h
+ *
+ * @brief Shared subscription to the Device Shadow response topics of a thing,
+ * routed to handlers registered for each shadow.
+ *
+ * Rather than every shadow subscribing to its own accepted, rejected and delta
+ * topics, the service sends one SUBSCRIBE with two wildcard filters when it is
+ * started:
+ * - "$aws/things/<thing>/shadow/+/+" for the responses of the classic shadow.
+ * - "$aws/things/<thing>/shadow/name/+/+/+" for the responses of every named
+ *   shadow.
+ * The number of subscriptions is therefore the same however many shadows the
+ * device uses.  The shadow name and message type of each incoming publish are
+ * parsed from its topic, and the publish is passed to every handler registered
+ * for that shadow.  The request topics, such as ".../shadow/update", have one
+ * level less than the filters so publishes the device sends are never routed
+ * back to it.
+ */
+
+#ifndef SHADOW_SERVICE_H_
+#define SHADOW_SERVICE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/* Shadow API header, for the message types. */
+#include "shadow.h"
+
+/**
+ * @brief Number of handlers that can be registered.  Can be overridden in
+ * demo_config.h.
+ */
+#ifndef shadowserviceMAX_HANDLERS
+    #define shadowserviceMAX_HANDLERS              ( 8U )
+#endif
+
+/**
+ * @brief Longest thing name the service can subscribe for.  This is the limit
+ * set by AWS IoT.
+ */
+#define shadowserviceMAX_THING_NAME_LENGTH         ( 128U )
+
+/**
+ * @brief Longest shadow name a handler can be registered for.  This is the
+ * limit set by AWS IoT.
+ */
+#define shadowserviceMAX_SHADOW_NAME_LENGTH        ( 64U )
+
+/**
+ * @brief Return codes from shadow service APIs.
+ */
+typedef enum
+{
+    eShadowServiceSuccess = 0,
+    eShadowServiceBadParameter,
+    eShadowServiceNoMemory,
+    eShadowServiceSubscribeFailed
+} eShadowServiceStatus;
+
+/**
+ * @brief Function called with each publish received for a shadow.
+ *
+ * Called from the context of the MQTT agent task, so it must not block.
+ *
+ * @param[in] pvContext The context passed when the handler was registered.
+ * @param[in] eMessageType The kind of message, parsed from the topic.
+ * @param[in] pxPublishInfo Deserialized publish.
+ */
+typedef void ( * ShadowServiceCallback_t )( void * pvContext,
+                                            ShadowMessageType_t eMessageType,
+                                            MQTTPublishInfo_t * pxPublishInfo );
+
+/**
+ * @brief Register a handler for the messages of a shadow.
+ *
+ * Several handlers can be registered for the same shadow, in which case each
+ * message is passed to all of them.  Handlers can be registered before or
+ * after the service is started.
+ *
+ * @param[in] pcShadowName Name of the shadow, or NULL for the classic shadow.
+ * Must stay in scope while the handler is registered.
+ * @param[in] usShadowNameLength Length of pcShadowName, or 0 for the classic
+ * shadow.
+ * @param[in] pxCallback Function called with each message for the shadow.
+ * @param[in] pvContext Context passed to pxCallback.
+ *
+ * @return #eShadowServiceSuccess if the handler is registered;
+ * #eShadowServiceBadParameter if invalid parameters are passed;
+ * #eShadowServiceNoMemory if #shadowserviceMAX_HANDLERS are registered.
+ */
+eShadowServiceStatus eShadowServiceRegister( const char * pcShadowName,
+                                             uint16_t usShadowNameLength,
+                                             ShadowServiceCallback_t pxCallback,
+                                             void * pvContext );
+
+/**
+ * @brief Subscribe to the shadow response topics of a thing.
+ *
+ * Only the first call sends a SUBSCRIBE.  Calls made while it is waiting for
+ * the SUBACK wait for it too, and later calls return straight away with the
+ * result.  Must be called from a task other than the MQTT agent task, as it
+ * blocks until the subscription completes.
+ *
+ * @param[in] pcThingName Name of the thing.  The same name must be passed on
+ * every call.
+ * @param[in] usThingNameLength Length of pcThingName.
+ *
+ * @return #eShadowServiceSuccess if the service is subscribed;
+ * #eShadowServiceBadParameter if invalid parameters are passed;
+ * #eShadowServiceSubscribeFailed if the subscription failed.
+ */
+eShadowServiceStatus eShadowServiceStart( const char * pcThingName,
+                                          uint16_t usThingNameLength );
+
+#endif /* SHADOW_SERVICE_H_ */
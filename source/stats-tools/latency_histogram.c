@@ -0,0 +1,116 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file latency_histogram.c
+ *
+ * @brief Log-linear histograms of round trip times.  See
+ * latency_histogram.h.
+ */
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "latency_histogram.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Return the bucket of a time.
+ */
+static uint32_t prvBucket( uint32_t ulLatency );
+
+/**
+ * @brief Return the smallest time in a bucket.
+ */
+static uint32_t prvBucketValue( uint32_t ulBucket );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t prvBucket( uint32_t ulLatency )
+{
+    uint32_t ulBucket = ulLatency, ulMsb = 4U;
+
+    if( ulLatency >= 16U )
+    {
+        while( ( ulMsb < 31U ) && ( ( ulLatency >> ( ulMsb + 1U ) ) != 0U ) )
+        {
+            ulMsb++;
+        }
+
+        ulBucket = 16U + ( ( ulMsb - 4U ) * 8U ) + ( ( ulLatency >> ( ulMsb - 3U ) ) & 7U );
+    }
+
+    return ulBucket;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvBucketValue( uint32_t ulBucket )
+{
+    uint32_t ulValue = ulBucket;
+
+    if( ulBucket >= 16U )
+    {
+        ulValue = ( 8U + ( ( ulBucket - 16U ) % 8U ) ) << ( ( ( ulBucket - 16U ) / 8U ) + 1U );
+    }
+
+    return ulValue;
+}
+/*-----------------------------------------------------------*/
+
+void vLatencyHistogramRecord( LatencyHistogram_t * pxHistogram,
+                              uint32_t ulLatency )
+{
+    pxHistogram->ulCount++;
+    pxHistogram->ulBuckets[ prvBucket( ulLatency ) ]++;
+
+    if( ulLatency > pxHistogram->ulMax )
+    {
+        pxHistogram->ulMax = ulLatency;
+    }
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulLatencyHistogramPercentile( const LatencyHistogram_t * pxHistogram,
+                                       uint32_t ulPerMille )
+{
+    uint64_t ullTarget = ( ( ( uint64_t ) pxHistogram->ulCount * ulPerMille ) + 999U ) / 1000U;
+    uint64_t ullCount = 0;
+    uint32_t ulBucket;
+
+    for( ulBucket = 0; ulBucket < latencyhistogramBUCKETS; ulBucket++ )
+    {
+        ullCount += pxHistogram->ulBuckets[ ulBucket ];
+
+        if( ( ullCount >= ullTarget ) && ( ullCount > 0U ) )
+        {
+            break;
+        }
+    }
+
+    return ( ulBucket < latencyhistogramBUCKETS ) ? prvBucketValue( ulBucket ) : 0U;
+}
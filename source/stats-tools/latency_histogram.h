@@ -0,0 +1,84 @@
+/*
+ * FreeRTOS V202012.00
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file latency_histogram.h
+ *
+ * @brief Log-linear histograms of round trip times, used by the load
+ * generator of the simple publish subscribe demo and by the fleet simulator
+ * to report latency percentiles.
+ *
+ * Times below 16 have a bucket each, and each power of two above is split
+ * into 8 buckets, so a percentile is accurate to an eighth of its value
+ * whatever the unit of the times.  A histogram is a plain structure that is
+ * cleared with memset(), and is not thread safe - callers that record from
+ * several tasks must serialise access to it.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Number of buckets in a histogram, enough for any 32-bit time.
+ */
+#define latencyhistogramBUCKETS    ( 16U + ( 28U * 8U ) )
+
+/**
+ * @brief A histogram of round trip times.
+ */
+typedef struct LatencyHistogram
+{
+    uint32_t ulCount; /**< Number of times recorded. */
+    uint32_t ulMax;   /**< Longest time recorded. */
+    uint32_t ulBuckets[ latencyhistogramBUCKETS ];
+} LatencyHistogram_t;
+
+/**
+ * @brief Add a time to a histogram.
+ *
+ * @param[in] pxHistogram The histogram.
+ * @param[in] ulLatency The time, in any unit.
+ */
+void vLatencyHistogramRecord( LatencyHistogram_t * pxHistogram,
+                              uint32_t ulLatency );
+
+/**
+ * @brief Return the time below which ulPerMille thousandths of the times in a
+ * histogram fall, rounded down to the smallest time of its bucket.
+ *
+ * @param[in] pxHistogram The histogram.
+ * @param[in] ulPerMille The percentile in thousandths, for example 990 for
+ * the 99th percentile.
+ *
+ * @return The time, or 0 if the histogram is empty.
+ */
+uint32_t ulLatencyHistogramPercentile( const LatencyHistogram_t * pxHistogram,
+                                       uint32_t ulPerMille );
+
+#endif /* ifndef LATENCY_HISTOGRAM_H_ */